@@ -0,0 +1,108 @@
+package main
+
+import (
+	"io/fs"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+)
+
+// the first (warmup) run primes the OS file cache so that we measure
+// SumatraPDF, not the disk
+const benchStartupWarmupRuns = 1
+const benchStartupMeasuredRuns = 10
+
+var benchStartupExts = []string{".pdf", ".xps", ".djvu", ".epub", ".mobi", ".cbz", ".cbr"}
+
+func isBenchStartupDoc(path string) bool {
+	ext := strings.ToLower(filepath.Ext(path))
+	for _, e := range benchStartupExts {
+		if ext == e {
+			return true
+		}
+	}
+	return false
+}
+
+func collectBenchStartupDocs(path string) []string {
+	if !dirExists(path) {
+		panicIf(!fileExists(path), "'%s' doesn't exist", path)
+		return []string{path}
+	}
+	var res []string
+	filepath.WalkDir(path, func(p string, d fs.DirEntry, err error) error {
+		if err == nil && !d.IsDir() && isBenchStartupDoc(p) {
+			res = append(res, p)
+		}
+		return nil
+	})
+	sort.Strings(res)
+	return res
+}
+
+// nearest-rank percentile, timings must be sorted
+func percentileMs(timings []float64, p int) float64 {
+	n := len(timings)
+	idx := (n*p + 99) / 100
+	if idx > 0 {
+		idx--
+	}
+	return timings[idx]
+}
+
+func benchStartupRunOne(exePath, docPath, outPath, appDataDir string) float64 {
+	os.Remove(outPath)
+	cmd := exec.Command(exePath, "-appdata", appDataDir, "-startup-bench", outPath, docPath)
+	err := cmd.Run()
+	must(err)
+	d, err := os.ReadFile(outPath)
+	must(err)
+	ms, err := strconv.ParseFloat(strings.TrimSpace(string(d)), 64)
+	must(err)
+	return ms
+}
+
+// measures process-creation-to-first-document-paint for each document in
+// docsPath (a file or a directory) and reports percentile timings. This
+// is the regression gate for startup-latency work: run it on a reference
+// document set before and after a change and compare the p50 / p90
+func benchStartup(docsPath string) {
+	exePath := filepath.Join(rel64Dir, "SumatraPDF.exe")
+	if !fileExists(exePath) {
+		logf("'%s' doesn't exist, rebuilding\n", exePath)
+		buildJustPortableExe(rel64Dir, "Release", kPlatformIntel64)
+	}
+	docs := collectBenchStartupDocs(docsPath)
+	panicIf(len(docs) == 0, "no documents to benchmark in '%s'", docsPath)
+
+	// a private appdata dir so that runs don't restore the user's session
+	// (or pollute their file history) and all runs see the same settings
+	appDataDir, err := os.MkdirTemp("", "sumatra-bench-appdata")
+	must(err)
+	defer os.RemoveAll(appDataDir)
+	outPath := filepath.Join(os.TempDir(), "sumatra-startup-bench.txt")
+	defer os.Remove(outPath)
+
+	var all []float64
+	for _, doc := range docs {
+		for i := 0; i < benchStartupWarmupRuns; i++ {
+			benchStartupRunOne(exePath, doc, outPath, appDataDir)
+		}
+		var timings []float64
+		for i := 0; i < benchStartupMeasuredRuns; i++ {
+			timings = append(timings, benchStartupRunOne(exePath, doc, outPath, appDataDir))
+		}
+		all = append(all, timings...)
+		sort.Float64s(timings)
+		logf("%-40s p50: %6.1f ms  p90: %6.1f ms  max: %6.1f ms\n", filepath.Base(doc), percentileMs(timings, 50),
+			percentileMs(timings, 90), timings[len(timings)-1])
+	}
+	if len(docs) > 1 {
+		sort.Float64s(all)
+		logf("%-40s p50: %6.1f ms  p90: %6.1f ms  max: %6.1f ms\n", "all", percentileMs(all, 50),
+			percentileMs(all, 90), all[len(all)-1])
+	}
+}
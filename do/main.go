@@ -229,6 +229,7 @@ func main() {
 	)
 
 	var (
+		flgBenchStartup    string
 		flgBuildLogview    bool
 		flgBuildNo         int
 		flgBuildPreRelease bool
@@ -291,6 +292,7 @@ func main() {
 		flag.BoolVar(&flgDrMem, "drmem", false, "run drmemory of rel 64")
 		flag.BoolVar(&flgLogView, "logview", false, "run logview")
 		flag.BoolVar(&flgRunTests, "run-tests", false, "run test_util executable")
+		flag.StringVar(&flgBenchStartup, "bench-startup", "", "measure time to first document paint for a file or directory of documents")
 		flag.BoolVar(&flgExtractUtils, "extract-utils", false, "extract utils")
 		flag.BoolVar(&flgBuildLogview, "build-logview", false, "build logview-win. Use -upload to also upload it to backblaze")
 		flag.IntVar(&flgBuildNo, "build-no-info", 0, "print build number info for given build number")
@@ -557,6 +559,11 @@ func main() {
 		return
 	}
 
+	if flgBenchStartup != "" {
+		benchStartup(flgBenchStartup)
+		return
+	}
+
 	if flgRunTests {
 		buildTestUtil()
 		dir := filepath.Join("out", "rel64")
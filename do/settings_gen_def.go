@@ -296,6 +296,9 @@ var (
 		mkField("RememberStatePerDocument", Bool, true,
 			"if true, we store display settings for each document separately (i.e. everything "+
 				"after UseDefaultState in FileStates)"),
+		mkField("RenderCacheSizeInMB", Int, 0,
+			"maximum amount of memory (in MB) used for caching rendered pages. "+
+				"0 means automatic, scaled to the amount of installed RAM").setExpert().setVersion("3.6"),
 		mkField("RestoreSession", Bool, true,
 			"if true and SessionData isn't empty, that session will be restored at startup").setExpert(),
 		mkField("ReuseInstance", Bool, true,
@@ -317,6 +320,9 @@ var (
 			"width of favorites/bookmarks sidebar (if shown)"),
 		mkField("SmoothScroll", Bool, false,
 			"if true, implements smooth scrolling").setExpert(),
+		mkField("TabHibernationTimeoutInMin", Int, 0,
+			"if > 0, a document in a tab that wasn't looked at for that many minutes is unloaded "+
+				"to reclaim memory and reloaded when the tab is selected again. 0 disables this").setExpert().setVersion("3.6"),
 		mkField("TabWidth", Int, 300,
 			"maximum width of a single tab"),
 		mkField("Theme", String, "", "the name of the theme to use").setDoc("Valid themes: light, dark, darker").setVersion("3.5"),
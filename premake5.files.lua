@@ -39,8 +39,10 @@ function makelzsa_files()
     "StrFormat.*",
     "StrUtil.*",
     "StrVec.*",
+    "MpScQueue.*",
     "StrQueue.*",
     "TempAllocator.*",
+    "ThreadUtil.*",
     "Log.*",
     "WinDynCalls.*",
     "WinUtil.*",
@@ -639,14 +641,17 @@ function sumatrapdf_files()
     "FileHistory.*",
     "FileThumbnails.*",
     "Flags.*",
+    "FullTextIndex.*",
     "FzImgReader.*",
     "GlobalPrefs.*",
     "HomePage.*",
+    "InputReplay.*",
     "Installer.*",
     "InstallerCommon.cpp",
     "MainWindow.*",
     "Menu.*",
     "Notifications.*",
+    "Ocr.*",
     "PdfSync.*",
     "Print.*",
     "ProgressUpdateUI.*",
@@ -655,7 +660,9 @@ function sumatrapdf_files()
     "RegistryPreview.*",
     "RegistrySearchFilter.*",
     "resource.h",
+    "SearchAllTabs.*",
     "SearchAndDDE.*",
+    "SearchExpression.*",
     "Selection.*",
     "Settings.h",
     "SettingsStructs.*",
@@ -675,6 +682,7 @@ function sumatrapdf_files()
     "TextSearch.*",
     "TextSelection.*",
     "Theme.*",
+    "ThumbnailStrip.*",
     "Toolbar.*",
     "Translations.*",
     "TranslationLangs.cpp",
@@ -724,12 +732,14 @@ function utils_files()
     "AvifReader.*",
     "ApiHook.*",
     "Archive.*",
+    "AsyncTask.*",
     "BaseUtil.*",
     "BitReader.*",
     "BuildConfig.h",
     "ByteOrderDecoder.*",
     "ByteReader.*",
     "ByteWriter.*",
+    "CacheFile.*",
     "CmdLineArgsIter.*",
     "ColorUtil.*",
     "CryptoUtil.*",
@@ -751,6 +761,8 @@ function utils_files()
     "JsonParser.*",
     "Log.*",
     "LzmaSimpleArchive.*",
+    "PerfTrace.*",
+    "PixelConvert.*",
     "RegistryPaths.*",
     "Scoped.h",
     "ScopedWin.h",
@@ -760,6 +772,7 @@ function utils_files()
     "StrFormat.*",
     "StrUtil.*",
     "StrVec.*",
+    "MpScQueue.*",
     "StrQueue.*",
     "TempAllocator.*",
     "ThreadUtil.*",
@@ -1167,6 +1180,7 @@ function test_util_files()
     "StrFormat.*",
     "StrUtil.*",
     "StrVec.*",
+    "MpScQueue.*",
     "StrQueue.*",
     "SquareTreeParser.*",
     "TrivialHtmlParser.*",
@@ -1191,6 +1205,33 @@ function test_util_files()
   })
 end
 
+function utils_bench_files()
+  files_in_dir( "src/utils", {
+    "BaseUtil.*",
+    "BitManip.*",
+    "ColorUtil.*",
+    "CryptoUtil.*",
+    "Dict.*",
+    "Dpi.*",
+    "FileUtil.*",
+    "GeomUtil.*",
+    "Log.*",
+    "Scoped.*",
+    "StrconvUtil.*",
+    "StrFormat.*",
+    "StrUtil.*",
+    "StrVec.*",
+    "TempAllocator.*",
+    "Vec.*",
+    "WinUtil.*",
+    "WinDynCalls.*",
+  })
+  files_in_dir("src", {
+    "CrashHandlerNoOp.cpp",
+    "tools/utils_bench.cpp",
+  })
+end
+
 function plugin_test_files()
     files {
         "src/tools/plugin-test.cpp",
@@ -699,6 +699,18 @@ workspace "SumatraPDF"
     test_util_files()
     links { "gdiplus", "comctl32", "shlwapi", "Version", "wininet", "shcore", "wintrust", "crypt32" }
 
+  -- micro-benchmarks for the utils containers; prints JSON timings
+  -- that can be compared across commits
+  project "utils-bench"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++latest"
+    mixed_dbg_rel_conf()
+    disablewarnings { "4838" }
+    includedirs { "src" }
+    utils_bench_files()
+    links { "gdiplus", "comctl32", "shlwapi", "Version", "wininet", "shcore", "wintrust", "crypt32" }
+
   project "sizer"
     kind "ConsoleApp"
     language "C++"
@@ -819,6 +831,8 @@ workspace "SumatraPDF"
     linkoptions { "/DELAYLOAD:gdiplus.dll /DELAYLOAD:msimg32.dll /DELAYLOAD:shlwapi.dll" }
     linkoptions { "/DELAYLOAD:urlmon.dll /DELAYLOAD:wininet.dll" }
     linkoptions { "/DELAYLOAD:uiautomationcore.dll" }
+    -- those are not needed for first paint, delay-load to speed up startup
+    linkoptions { "/DELAYLOAD:version.dll /DELAYLOAD:windowscodecs.dll /DELAYLOAD:wintrust.dll" }
     filter "platforms:x64_asan"
       linkoptions { "/INFERASANLIBS" }
     filter {}
@@ -881,6 +895,8 @@ workspace "SumatraPDF"
     linkoptions { "/DELAYLOAD:gdiplus.dll /DELAYLOAD:msimg32.dll /DELAYLOAD:shlwapi.dll" }
     linkoptions { "/DELAYLOAD:urlmon.dll /DELAYLOAD:wininet.dll" }
     linkoptions { "/DELAYLOAD:uiautomationcore.dll" }
+    -- those are not needed for first paint, delay-load to speed up startup
+    linkoptions { "/DELAYLOAD:version.dll /DELAYLOAD:wintrust.dll /DELAYLOAD:crypt32.dll" }
     dependson { "PdfFilter", "PdfPreview", "test_util" }
     prebuildcommands { "cd %{cfg.targetdir} & ..\\..\\bin\\MakeLZSA.exe InstallerData.dat libmupdf.dll:libmupdf.dll PdfFilter.dll:PdfFilter.dll PdfPreview.dll:PdfPreview.dll"  }
 
@@ -521,7 +521,9 @@ static const char* getVirt(BYTE key, bool isEng) {
     return nullptr;
 }
 
-static TempStr AppendAccelKeyToMenuStringTemp(TempStr menuStr, const ACCEL& a) {
+// builds the "\tCtrl + O" suffix appended to menu item titles,
+// nullptr if we don't know how to name the key
+static char* AccelKeyStr(const ACCEL& a) {
     auto lang = trans::GetCurrentLangCode();
     bool isEng = str::IsEmpty(lang) || str::Eq(lang, "en");
     bool isGerman = str::Eq(lang, "de");
@@ -586,32 +588,111 @@ static TempStr AppendAccelKeyToMenuStringTemp(TempStr menuStr, const ACCEL& a) {
 
     logf("Unknown key: 0x%x, virt: 0x%x\n", key, virt);
     ReportIf(true);
-    return menuStr;
+    return nullptr;
 Exit:
-    TempStr res = str::JoinTemp(menuStr, str.Get());
-    return res;
+    return str::Dup(str.Get());
 }
 
-TempStr AppendAccelKeyToMenuStringTemp(TempStr menuStr, int cmdId) {
-    ACCEL a;
+// key suffixes pre-built once per language, parallel to gAccels.
+// menus are re-created on every open so without this we'd re-do the
+// string building for every menu item every time
+static char** gAccelStrs = nullptr;
+static const char* gAccelStrsLang = nullptr;
+
+static void FreeAccelStrs() {
+    if (!gAccelStrs) {
+        return;
+    }
     for (int i = 0; i < gAccelsCount; i++) {
-        a = gAccels[i];
-        if (a.cmd == cmdId) {
-            TempStr res = AppendAccelKeyToMenuStringTemp(menuStr, a);
-            return res;
+        str::Free(gAccelStrs[i]);
+    }
+    free(gAccelStrs);
+    gAccelStrs = nullptr;
+}
+
+static void BuildAccelStrs() {
+    gAccelStrsLang = trans::GetCurrentLangCode();
+    gAccelStrs = AllocArray<char*>(gAccelsCount);
+    for (int i = 0; i < gAccelsCount; i++) {
+        gAccelStrs[i] = AccelKeyStr(gAccels[i]);
+    }
+}
+
+// maps the cmd id of an accelerator to its index in gAccels so that
+// menu building doesn't scan the whole table for every menu item.
+// open-addressed, entries store index + 1, 0 means empty
+static u32* gAccelIdxForCmd = nullptr;
+static u32 gAccelIdxForCmdSize = 0;
+
+static void BuildAccelIdxForCmd() {
+    u32 size = 16;
+    while (size < (u32)gAccelsCount * 2) {
+        size *= 2;
+    }
+    gAccelIdxForCmd = AllocArray<u32>(size);
+    gAccelIdxForCmdSize = size;
+    for (int i = 0; i < gAccelsCount; i++) {
+        u32 cmd = (u32)gAccels[i].cmd;
+        u32 h = (cmd * 2654435761u) & (size - 1);
+        bool exists = false;
+        while (gAccelIdxForCmd[h]) {
+            if ((u32)gAccels[gAccelIdxForCmd[h] - 1].cmd == cmd) {
+                // several shortcuts for one command: the first one is
+                // the one shown in menus
+                exists = true;
+                break;
+            }
+            h = (h + 1) & (size - 1);
+        }
+        if (!exists) {
+            gAccelIdxForCmd[h] = (u32)i + 1;
         }
     }
-    return menuStr;
 }
 
-static bool SameAccelKey(const ACCEL& a1, const ACCEL& a2) {
-    if (a1.fVirt != a2.fVirt) {
-        return false;
+static void FreeAccelIdxForCmd() {
+    free(gAccelIdxForCmd);
+    gAccelIdxForCmd = nullptr;
+    gAccelIdxForCmdSize = 0;
+}
+
+static int FindAccelIdxForCmd(int cmdId) {
+    if (!gAccelIdxForCmd) {
+        return -1;
     }
-    if (a1.key != a2.key) {
-        return false;
+    u32 h = ((u32)cmdId * 2654435761u) & (gAccelIdxForCmdSize - 1);
+    while (gAccelIdxForCmd[h]) {
+        int idx = (int)gAccelIdxForCmd[h] - 1;
+        if ((int)gAccels[idx].cmd == cmdId) {
+            return idx;
+        }
+        h = (h + 1) & (gAccelIdxForCmdSize - 1);
     }
-    return true;
+    return -1;
+}
+
+TempStr AppendAccelKeyToMenuStringTemp(TempStr menuStr, int cmdId) {
+    if (gAccelsCount <= 0) {
+        return menuStr;
+    }
+    if (gAccelStrs && !str::Eq(gAccelStrsLang, trans::GetCurrentLangCode())) {
+        // key names are translated for some languages
+        FreeAccelStrs();
+    }
+    if (!gAccelStrs) {
+        BuildAccelStrs();
+    }
+    int i = FindAccelIdxForCmd(cmdId);
+    if (i < 0 || !gAccelStrs[i]) {
+        return menuStr;
+    }
+    return str::JoinTemp(menuStr, gAccelStrs[i]);
+}
+
+// the modifier + key combination packed into a u32, for hashing and
+// equality
+static u32 AccelHashKey(const ACCEL& a) {
+    return ((u32)a.fVirt << 16) | (u32)a.key;
 }
 
 // clang-format off
@@ -693,12 +774,38 @@ void CreateSumatraAcceleratorTable() {
     int nEditAccels = 0;
     int nTreeViewAccels = 0;
 
-    auto addShortcutIfNotExists = [&](ACCEL accel) -> void {
-        bool shortcutExists = false;
-        for (int i = 0; !shortcutExists && i < nAccels; i++) {
-            shortcutExists = SameAccelKey(accels[i], accel);
+    // open-addressed hash set of the keys added so far so that the
+    // conflict check is O(1) per shortcut instead of a scan over
+    // everything added before it
+    u32 seenSize = 16;
+    while (seenSize < (u32)nMax * 2) {
+        seenSize *= 2;
+    }
+    // entries store the packed key + 1, 0 means empty
+    u32* seenKeys = AllocArray<u32>(seenSize);
+    auto testAndSetKey = [&](ACCEL accel) -> bool {
+        u32 k = AccelHashKey(accel) + 1;
+        u32 h = (k * 2654435761u) & (seenSize - 1);
+        while (seenKeys[h]) {
+            if (seenKeys[h] == k) {
+                return true;
+            }
+            h = (h + 1) & (seenSize - 1);
         }
-        if (shortcutExists) {
+        seenKeys[h] = k;
+        return false;
+    };
+
+    auto addShortcutIfNotExists = [&](ACCEL accel, bool isBuiltIn) -> void {
+        if (testAndSetKey(accel)) {
+            if (isBuiltIn) {
+                // intended: a custom shortcut from the settings file
+                // takes over the key of a built-in one
+                logf("CreateSumatraAcceleratorTable: built-in shortcut of cmd %d shadowed by a custom shortcut\n",
+                     (int)accel.cmd);
+            } else {
+                logf("CreateSumatraAcceleratorTable: duplicate custom shortcut for cmd %d ignored\n", (int)accel.cmd);
+            }
             return;
         }
         accels[nAccels++] = accel;
@@ -718,7 +825,7 @@ void CreateSumatraAcceleratorTable() {
             ACCEL accel{};
             accel.cmd = curr->id;
             if (ParseShortcut(curr->key, accel)) {
-                addShortcutIfNotExists(accel);
+                addShortcutIfNotExists(accel, false);
             }
         }
         curr = curr->next;
@@ -726,11 +833,13 @@ void CreateSumatraAcceleratorTable() {
 
     // add built-in but only if the shortcut doesn't conflict with custom shortcut
     for (ACCEL accel : gBuiltInAccelerators) {
-        addShortcutIfNotExists(accel);
+        addShortcutIfNotExists(accel, true);
     }
+    free(seenKeys);
 
     gAccels = accels;
     gAccelsCount = nAccels;
+    BuildAccelIdxForCmd();
 
     gAccelTables[0] = CreateAcceleratorTableW(gAccels, gAccelsCount);
     ReportIf(gAccelTables[0] == nullptr);
@@ -743,12 +852,14 @@ void CreateSumatraAcceleratorTable() {
 }
 
 void FreeAcceleratorTables() {
+    FreeAccelStrs();
     DestroyAcceleratorTable(gAccelTables[0]);
     DestroyAcceleratorTable(gAccelTables[1]);
     DestroyAcceleratorTable(gAccelTables[2]);
     gAccelTables[0] = nullptr;
     gAccelTables[1] = nullptr;
     gAccelTables[2] = nullptr;
+    FreeAccelIdxForCmd();
     free(gAccels);
     gAccels = nullptr;
 }
@@ -5,6 +5,7 @@
 #include "utils/FileUtil.h"
 #include "utils/FileWatcher.h"
 #include "utils/UITask.h"
+#include "utils/ThreadUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
 #include "utils/Timer.h"
@@ -60,7 +61,7 @@ static void ResetCachedFonts() {
 }
 
 // number of weeks past since 2011-01-01
-static int GetWeekCount() {
+int GetWeekCount() {
     SYSTEMTIME date20110101{};
     date20110101.wYear = 2011;
     date20110101.wMonth = 1;
@@ -85,6 +86,148 @@ TempStr GetSettingsPathTemp() {
     return GetPathInAppDataDirTemp(GetSettingsFileNameTemp());
 }
 
+static TempStr GetSettingsSnapshotPathTemp() {
+    return GetPathInAppDataDirTemp("SumatraPDF-settings.bin");
+}
+
+/* The settings snapshot is a binary sidecar of SumatraPDF-settings.txt
+that loads with a single read and a flat decode, skipping the text
+parsing which dominates startup when the FileState history is large.
+
+The text file stays the source of truth: the snapshot records a hash of
+the text it was generated from and is ignored (and re-created) whenever
+the text was edited by hand or written by a different build. */
+
+// bump the last character when changing the snapshot layout
+constexpr u32 kSettingsSnapshotMagic = 0x31736253; // "Sbs1"
+
+struct SettingsSnapshotHeader {
+    u32 magic = 0;
+    // layout of the settings structs this was serialized with
+    u32 schemaFingerprint = 0;
+    // size and hash of the settings text this snapshot mirrors
+    u32 txtSize = 0;
+    u32 txtHash = 0;
+};
+
+static ByteSlice BuildSettingsSnapshot(GlobalPrefs* prefs, const ByteSlice& txtData) {
+    ByteSlice bin = SerializeGlobalPrefsToBin(prefs);
+    SettingsSnapshotHeader hdr;
+    hdr.magic = kSettingsSnapshotMagic;
+    hdr.schemaFingerprint = GetGlobalPrefsFingerprint();
+    hdr.txtSize = (u32)txtData.size();
+    hdr.txtHash = MurmurHash2(txtData.data(), txtData.size());
+    str::Str d(sizeof(hdr) + bin.size());
+    d.Append((const char*)&hdr, sizeof(hdr));
+    d.Append((const char*)bin.data(), bin.size());
+    bin.Free();
+    size_t n = d.size();
+    u8* data = (u8*)d.StealData();
+    return {data, n};
+}
+
+static void SaveSettingsSnapshot(GlobalPrefs* prefs, const ByteSlice& txtData) {
+    ByteSlice d = BuildSettingsSnapshot(prefs, txtData);
+    TempStr path = GetSettingsSnapshotPathTemp();
+    file::WriteFile(path, d);
+    d.Free();
+}
+
+// returns nullptr if there's no snapshot or it doesn't match txtData,
+// in which case the caller parses the text and re-creates the snapshot
+static GlobalPrefs* TryLoadSettingsSnapshot(const ByteSlice& txtData) {
+    if (txtData.empty()) {
+        return nullptr;
+    }
+    TempStr path = GetSettingsSnapshotPathTemp();
+    ByteSlice d = file::ReadFile(path);
+    defer {
+        d.Free();
+    };
+    if (d.size() <= sizeof(SettingsSnapshotHeader)) {
+        return nullptr;
+    }
+    SettingsSnapshotHeader hdr;
+    memcpy(&hdr, d.data(), sizeof(hdr));
+    if (hdr.magic != kSettingsSnapshotMagic || hdr.schemaFingerprint != GetGlobalPrefsFingerprint()) {
+        return nullptr;
+    }
+    if (hdr.txtSize != (u32)txtData.size() || hdr.txtHash != MurmurHash2(txtData.data(), txtData.size())) {
+        return nullptr;
+    }
+    ByteSlice payload(d.data() + sizeof(hdr), d.size() - sizeof(hdr));
+    return NewGlobalPrefsFromBin(payload);
+}
+
+/* The settings change journal makes the deferred save crash-safe.
+
+SaveSettings() captures state synchronously, but serializing and
+rewriting SumatraPDF-settings.txt (multi-megabyte with a large history)
+is coalesced and happens a couple of seconds later on a background
+thread. To not lose reading positions in a crash during that window, the
+FileState of every active tab is appended to a small journal file right
+away. The journal is deleted after every successful full write; if one
+still exists at startup, the last run crashed and its records are
+replayed over the loaded settings. */
+
+constexpr const char* kSettingsJournalRecordSep = "# FileState\r\n";
+
+static TempStr GetSettingsJournalPathTemp() {
+    return GetPathInAppDataDirTemp("SumatraPDF-settings-journal.txt");
+}
+
+// content of the settings file as last read or written; lets
+// WriteSettingsFile() preserve unknown fields and skip unchanged writes
+// without re-reading the file every time
+static char* gLastSettingsText = nullptr;
+
+// later records win: the active tab's state may have been journaled many
+// times during the session
+static void ReplaySettingsJournalRecord(GlobalPrefs* gprefs, const char* rec) {
+    FileState* fs = NewFileStateFromData(rec);
+    if (!fs->filePath || !*fs->filePath) {
+        DeleteDisplayState(fs);
+        return;
+    }
+    Vec<FileState*>* states = gprefs->fileStates;
+    int n = states->Size();
+    for (int i = 0; i < n; i++) {
+        FileState* prev = states->at(i);
+        if (str::EqI(prev->filePath, fs->filePath)) {
+            DeleteDisplayState(prev);
+            states->at(i) = fs;
+            return;
+        }
+    }
+    // the file was opened for the first time right before the crash
+    states->InsertAt(0, fs);
+}
+
+// if the last run crashed before its full settings rewrite, the journal
+// is still on disk: replay it. it's deleted only by the next successful
+// full write, so another crash replays it again
+static void ReplaySettingsJournal(GlobalPrefs* gprefs) {
+    TempStr path = GetSettingsJournalPathTemp();
+    ByteSlice d = file::ReadFile(path);
+    if (d.empty()) {
+        return;
+    }
+    defer {
+        d.Free();
+    };
+    int nRecords = 0;
+    const char* s = str::Find((const char*)d.data(), kSettingsJournalRecordSep);
+    while (s) {
+        s += str::Len(kSettingsJournalRecordSep);
+        const char* next = str::Find(s, kSettingsJournalRecordSep);
+        TempStr rec = next ? str::DupTemp(s, (size_t)(next - s)) : str::DupTemp(s);
+        ReplaySettingsJournalRecord(gprefs, rec);
+        nRecords++;
+        s = next;
+    }
+    logf("ReplaySettingsJournal: replayed %d records from '%s'\n", nRecords, path);
+}
+
 static void setMin(int& i, int minVal) {
     if (i < minVal) {
         i = minVal;
@@ -189,15 +332,30 @@ bool LoadSettings() {
 
     GlobalPrefs* gprefs = nullptr;
     TempStr settingsPath = GetSettingsPathTemp();
+    bool loadedSnapshot = false;
     {
         ByteSlice prefsData = file::ReadFile(settingsPath);
 
-        gGlobalPrefs = NewGlobalPrefs(prefsData);
+        gGlobalPrefs = TryLoadSettingsSnapshot(prefsData);
+        loadedSnapshot = gGlobalPrefs != nullptr;
+        if (!gGlobalPrefs) {
+            gGlobalPrefs = NewGlobalPrefs(prefsData);
+            if (gGlobalPrefs && prefsData.size() > 0) {
+                // so that the next startup skips the parsing
+                SaveSettingsSnapshot(gGlobalPrefs, prefsData);
+            }
+        }
         ReportIf(!gGlobalPrefs);
         gprefs = gGlobalPrefs;
-        prefsData.Free();
+        // keep the text for WriteSettingsFile() instead of re-reading it
+        str::Free(gLastSettingsText);
+        gLastSettingsText = (char*)prefsData.data();
     }
 
+    // recover FileState changes lost if the last run crashed before its
+    // full settings rewrite
+    ReplaySettingsJournal(gprefs);
+
     if (!gprefs->uiLanguage || !trans::ValidateLangCode(gprefs->uiLanguage)) {
         // guess the ui language on first start
         str::ReplaceWithCopy(&gprefs->uiLanguage, trans::DetectUserLang());
@@ -269,6 +427,9 @@ bool LoadSettings() {
     //    auto fontName = ToWStrTemp(gprefs->fixedPageUI.ebookFontName);
     //    SetDefaultEbookFont(fontName.Get(), gprefs->fixedPageUI.ebookFontSize);
 
+    // same directory as the thumbnails (GetThumbnailCacheDirTemp)
+    SetEbookPaginationCacheDir(GetPathInAppDataDirTemp("sumatrapdfcache"));
+
     ResetCachedFonts();
 
     // re-create commands
@@ -291,7 +452,8 @@ bool LoadSettings() {
         SaveSettings();
     }
 
-    logf("LoadSettings('%s') took %.2f ms\n", settingsPath, TimeSinceInMs(timeStart));
+    logf("LoadSettings('%s') took %.2f ms%s\n", settingsPath, TimeSinceInMs(timeStart),
+         loadedSnapshot ? " (from snapshot)" : "");
     return true;
 }
 
@@ -314,6 +476,12 @@ static void RememberSessionState() {
                 continue;
             }
             const char* fp = tab->filePath;
+            if (!tab->ctrl && tab->tabState) {
+                // lazy-loaded or hibernated tab that was never shown:
+                // preserve the state captured when it was last active
+                data->tabStates->Append(CloneTabState(tab->tabState));
+                continue;
+            }
             FileState* fs = NewDisplayState(fp);
             if (tab->ctrl) {
                 tab->ctrl->GetDisplayState(fs);
@@ -340,9 +508,163 @@ static void RememberSessionState() {
     }
 }
 
+constexpr int kSaveSettingsDelayInMs = 2000;
+
+// set while a coalesced settings write is scheduled, cleared when it runs
+static AtomicBool gSettingsSaveScheduled;
+// non-zero while a settings write is executing on a background thread
+static AtomicInt gSettingsWritesInFlight;
+// the app is exiting and FlushSettings() wrote the final state; late
+// scheduled writes must not run anymore
+static bool gSettingsFlushed = false;
+
+static void ScheduleSettingsWrite();
+
+struct SettingsWriteData {
+    AutoFreeStr path;
+    AutoFreeStr snapshotPath;
+    AutoFreeStr journalPath;
+    ByteSlice prefs;
+    ByteSlice snapshot;
+};
+
+static void SettingsWriteThread(SettingsWriteData* d) {
+    WatchedFileSetIgnore(gWatchedSettingsFile, true);
+    bool ok = file::WriteFile(d->path, d->prefs);
+    if (ok) {
+        gGlobalPrefs->lastPrefUpdate = file::GetModificationTime(d->path);
+        file::WriteFile(d->snapshotPath, d->snapshot);
+        // everything the journal guards against losing is in the file now
+        file::Delete(d->journalPath);
+    }
+    WatchedFileSetIgnore(gWatchedSettingsFile, false);
+    d->prefs.Free();
+    d->snapshot.Free();
+    delete d;
+    gSettingsWritesInFlight.Dec();
+}
+
+// serializes the settings (on the ui thread) and hands writing them out
+// to a pool thread; synchronous when flush is true, for shutdown
+static bool WriteSettingsFile(bool flush) {
+    TempStr path = GetSettingsPathTemp();
+    ReportIf(!path);
+    if (!path) {
+        return false;
+    }
+    ByteSlice prefs = SerializeGlobalPrefs(gGlobalPrefs, gLastSettingsText);
+    ReportIf(prefs.empty());
+    if (prefs.empty()) {
+        return false;
+    }
+
+    // only write if anything's changed at all
+    if (str::Eq((const char*)prefs.data(), gLastSettingsText)) {
+        str::Free(prefs.data());
+        // the journal only exists to recover changes not yet in the file
+        file::Delete(GetSettingsJournalPathTemp());
+        return true;
+    }
+    str::Free(gLastSettingsText);
+    gLastSettingsText = str::Dup((const char*)prefs.data());
+
+    auto d = new SettingsWriteData();
+    d->path.SetCopy(path);
+    d->snapshotPath.SetCopy(GetSettingsSnapshotPathTemp());
+    d->journalPath.SetCopy(GetSettingsJournalPathTemp());
+    d->prefs = prefs;
+    d->snapshot = BuildSettingsSnapshot(gGlobalPrefs, prefs);
+    gSettingsWritesInFlight.Inc();
+    if (flush) {
+        SettingsWriteThread(d);
+        return true;
+    }
+    auto fn = MkFunc0(SettingsWriteThread, d);
+    RunAsync(fn, "SettingsWriteThread");
+    return true;
+}
+
+static void RunScheduledSettingsWrite() {
+    gSettingsSaveScheduled.Set(false);
+    if (gSettingsFlushed) {
+        return;
+    }
+    if (gSettingsWritesInFlight.Get() > 0) {
+        // an earlier write is still on disk; writes must not overlap, so
+        // try again in a while
+        ScheduleSettingsWrite();
+        return;
+    }
+    WriteSettingsFile(false);
+}
+
+static void SettingsSaveDelayThread() {
+    Sleep(kSaveSettingsDelayInMs);
+    if (gSettingsFlushed) {
+        return;
+    }
+    auto fn = MkFunc0Void(RunScheduledSettingsWrite);
+    uitask::Post(fn, "TaskSaveSettings");
+}
+
+static void ScheduleSettingsWrite() {
+    if (gSettingsSaveScheduled.Set(true)) {
+        // already scheduled; it'll pick up the latest state when it runs
+        return;
+    }
+    auto fn = MkFunc0Void(SettingsSaveDelayThread);
+    RunAsync(fn, "SettingsSaveDelayThread");
+}
+
+static void SettingsJournalAppendThread(char* s) {
+    TempStr path = GetSettingsJournalPathTemp();
+    WCHAR* pathW = ToWStrTemp(path);
+    HANDLE h = CreateFileW(pathW, FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+    if (h != INVALID_HANDLE_VALUE) {
+        // a single WriteFile on a FILE_APPEND_DATA handle is atomic, so
+        // concurrent appends can't interleave records
+        DWORD nWritten = 0;
+        WriteFile(h, s, (DWORD)str::Len(s), &nWritten, nullptr);
+        CloseHandle(h);
+    }
+    str::Free(s);
+}
+
+// appends the FileState of every active tab to the journal; the records
+// are serialized here, on the ui thread, and written on a pool thread
+static void AppendToSettingsJournal() {
+    if (!gGlobalPrefs->rememberStatePerDocument || !gGlobalPrefs->rememberOpenedFiles) {
+        return;
+    }
+    str::Str recs;
+    for (MainWindow* win : gWindows) {
+        WindowTab* tab = win->CurrentTab();
+        if (!tab || tab->IsAboutTab()) {
+            continue;
+        }
+        FileState* fs = gFileHistory.FindByPath(tab->filePath);
+        if (!fs) {
+            continue;
+        }
+        ByteSlice rec = SerializeFileState(fs);
+        recs.Append(kSettingsJournalRecordSep);
+        recs.Append((const char*)rec.data(), rec.size());
+        rec.Free();
+    }
+    if (recs.IsEmpty()) {
+        return;
+    }
+    auto fn = MkFunc0(SettingsJournalAppendThread, recs.StealData());
+    RunAsync(fn, "SettingsJournalAppendThread");
+}
+
 // called whenever global preferences change or a file is
 // added or removed from gFileHistory (in order to keep
 // the list of recently opened documents in sync)
+// captures the state synchronously but defers rewriting the settings
+// file: the journal is appended right away and the full rewrite happens
+// coalesced, kSaveSettingsDelayInMs later, on a background thread
 bool SaveSettings() {
     if (!gDontSaveSettings) {
         // if we are exiting the application by File->Exit,
@@ -370,35 +692,25 @@ bool SaveSettings() {
     str::ReplaceWithCopy(&gGlobalPrefs->defaultDisplayMode, DisplayModeToString(gGlobalPrefs->defaultDisplayModeEnum));
     ZoomToString(&gGlobalPrefs->defaultZoom, gGlobalPrefs->defaultZoomFloat, nullptr);
 
-    TempStr path = GetSettingsPathTemp();
-    ReportIf(!path);
-    if (!path) {
-        return false;
-    }
-    ByteSlice prevPrefs = file::ReadFile(path);
-    const char* prevPrefsData = (char*)prevPrefs.data();
-    ByteSlice prefs = SerializeGlobalPrefs(gGlobalPrefs, prevPrefsData);
-    defer {
-        str::Free(prevPrefs.data());
-        str::Free(prefs.data());
-    };
-    ReportIf(prefs.empty());
-    if (prefs.empty()) {
-        return false;
-    }
+    AppendToSettingsJournal();
+    ScheduleSettingsWrite();
+    return true;
+}
 
-    // only save if anything's changed at all
-    if (prevPrefs.size() == prefs.size() && str::Eq(prefs, prevPrefs)) {
-        return true;
+// writes pending settings changes synchronously; called during shutdown
+// when a scheduled write might never get to run. doesn't re-capture
+// window state: windows may be (partially) destroyed by now and
+// SaveSettings() has already seen their final state
+void FlushSettings() {
+    if (!HasPermission(Perm::SavePreferences) || !gGlobalPrefs) {
+        return;
     }
-
-    WatchedFileSetIgnore(gWatchedSettingsFile, true);
-    bool ok = file::WriteFile(path, prefs);
-    if (ok) {
-        gGlobalPrefs->lastPrefUpdate = file::GetModificationTime(path);
+    gSettingsFlushed = true;
+    // wait out a write already in flight: ours must be the last
+    while (gSettingsWritesInFlight.Get() > 0) {
+        Sleep(1);
     }
-    WatchedFileSetIgnore(gWatchedSettingsFile, false);
-    return ok;
+    WriteSettingsFile(true);
 }
 
 // refresh the preferences when a different SumatraPDF process saves them
@@ -491,6 +803,28 @@ void UnregisterSettingsForFileChanges() {
     // TODO: memleak of gWatchedSettingsFile
 }
 
+// a coherent low-memory profile for constrained machines: no
+// speculative prerendering, a much smaller render cache budget, smaller
+// tiles and no whole-document text pre-extraction. the pref can force
+// it on or off; "auto" enables it below ~4.5 GB of installed RAM
+bool IsLowMemoryMode() {
+    const char* mode = gGlobalPrefs ? gGlobalPrefs->lowMemoryMode : nullptr;
+    if (str::EqI(mode, "on")) {
+        return true;
+    }
+    if (str::EqI(mode, "off")) {
+        return false;
+    }
+    static int hasLittleRam = -1;
+    if (hasLittleRam < 0) {
+        MEMORYSTATUSEX ms{};
+        ms.dwLength = sizeof(ms);
+        GlobalMemoryStatusEx(&ms);
+        hasLittleRam = ms.ullTotalPhys <= 4608ULL * 1024 * 1024 ? 1 : 0;
+    }
+    return hasLittleRam == 1;
+}
+
 constexpr int kMinFontSize = 9;
 
 int GetAppFontSize() {
@@ -14,8 +14,11 @@ extern bool gDontSaveSettings;
 TempStr GetSettingsPathTemp();
 TempStr GetSettingsFileNameTemp();
 
+bool IsLowMemoryMode();
+int GetWeekCount();
 bool LoadSettings();
 bool SaveSettings();
+void FlushSettings();
 void CleanUpSettings();
 void RegisterSettingsForFileChanges();
 void UnregisterSettingsForFileChanges();
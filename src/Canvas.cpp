@@ -6,6 +6,7 @@
 #include "utils/WinDynCalls.h"
 #include "utils/Dpi.h"
 #include "utils/FileUtil.h"
+#include "utils/FrameTimeoutCalculator.h"
 #include "utils/Timer.h"
 #include "utils/UITask.h"
 #include "utils/WinUtil.h"
@@ -59,15 +60,127 @@
 // impression of lag
 bool gNoFlickerRender = true;
 
+// if set, the composed frame is presented through a Direct2D hwnd render
+// target instead of the final GDI BitBlt in DoubleBuffer::Flush().
+// Direct2D synchronizes Present with vsync, which avoids tearing during
+// smooth scrolling and moves the final blit off the CPU on high-dpi
+// displays. off by default until it has seen more testing on
+// multi-monitor and remote desktop setups
+bool gUseDirect2DPresent = false;
+
 Kind kNotifAnnotation = "notifAnnotation";
 
 // Timer for mouse wheel smooth scrolling
 constexpr UINT_PTR kSmoothScrollTimerID = 6;
 
-// Smooth scrolling factor. This is a value between 0 and 1.
-// Each step, we scroll the needed delta times this factor.
-// Therefore, a higher factor makes smooth scrolling faster.
-static const double gSmoothScrollingFactor = 0.2;
+// smooth scrolling animates a critically damped spring towards
+// win->scrollTargetY: it moves fast while the target is far away and
+// lands on it without overshooting. omega is the spring's natural
+// frequency in 1/s; higher values settle faster (roughly 5/omega s)
+static const double kSmoothScrollOmega = 20.0;
+
+// paces invalidations driven by the smooth scroll timer to the display
+// rate when frames are presented through Direct2D. without this the timer
+// fires at USER_TIMER_MINIMUM and every extra frame just blocks on vsync
+static FrameTimeoutCalculator gD2DFrameTiming(60);
+
+static UINT SmoothScrollDelayInMs() {
+    if (!gUseDirect2DPresent) {
+        return USER_TIMER_MINIMUM;
+    }
+    UINT timeout = (UINT)gD2DFrameTiming.GetTimeoutInMilliseconds();
+    return std::max(timeout, (UINT)USER_TIMER_MINIMUM);
+}
+
+// (re-)target the smooth scroll animation. If it's already running it
+// picks up from its current position and velocity, so wheel flicks
+// build up speed naturally
+static void StartSmoothScroll(MainWindow* win, int targetY) {
+    if (!win->smoothScrollActive) {
+        win->smoothScrollY = (double)win->AsFixed()->yOffset();
+        win->smoothScrollVelocity = 0;
+        QueryPerformanceCounter(&win->smoothScrollLastStep);
+        win->smoothScrollActive = true;
+    }
+    win->scrollTargetY = targetY;
+    SetTimer(win->hwndCanvas, kSmoothScrollTimerID, SmoothScrollDelayInMs(), nullptr);
+}
+
+static void StopSmoothScroll(MainWindow* win) {
+    win->smoothScrollActive = false;
+    KillTimer(win->hwndCanvas, kSmoothScrollTimerID);
+}
+
+// drives the crossfade between slides in presentation mode
+constexpr UINT_PTR kPresentationFadeTimerID = 8;
+constexpr double kPresentationFadeDurationMs = 150;
+
+static void EndPresentationCrossfade(MainWindow* win) {
+    KillTimer(win->hwndCanvas, kPresentationFadeTimerID);
+    DeleteObject(win->presFadeBitmap);
+    win->presFadeBitmap = nullptr;
+}
+
+// called before the new slide is composed into the double buffer. On a
+// page turn it snapshots the previous slide's frame (still in the
+// buffer) and starts the crossfade; returns true while a fade is in
+// progress and the snapshot should be blended over the composed frame
+static bool MaybeStartPresentationCrossfade(MainWindow* win, HDC hdcBuffer) {
+    DisplayModel* dm = win->AsFixed();
+    if (!dm || !win->buffer) {
+        return false;
+    }
+    int pageNo = dm->CurrentPageNo();
+    if (pageNo == win->presFadeLastPageNo) {
+        return win->presFadeBitmap != nullptr;
+    }
+    int prevPageNo = win->presFadeLastPageNo;
+    win->presFadeLastPageNo = pageNo;
+    if (0 == prevPageNo) {
+        // the first slide painted after entering presentation mode
+        return false;
+    }
+    // only fade when the new slide can be blitted right away: fading
+    // into "Please wait - rendering..." looks worse than a hard cut
+    // (the neighboring slides are normally pre-rendered, so this only
+    // skips long jumps, e.g. via the ToC)
+    if (!gRenderCache->Exists(dm, pageNo, dm->GetRotation())) {
+        EndPresentationCrossfade(win);
+        return false;
+    }
+    Rect r = win->buffer->rect;
+    DeleteObject(win->presFadeBitmap);
+    win->presFadeBitmap = CreateCompatibleBitmap(win->buffer->hdcCanvas, r.dx, r.dy);
+    if (!win->presFadeBitmap) {
+        return false;
+    }
+    HDC hdcSnap = CreateCompatibleDC(hdcBuffer);
+    HGDIOBJ prevBmp = SelectObject(hdcSnap, win->presFadeBitmap);
+    BitBlt(hdcSnap, 0, 0, r.dx, r.dy, hdcBuffer, 0, 0, SRCCOPY);
+    SelectObject(hdcSnap, prevBmp);
+    DeleteDC(hdcSnap);
+    win->presFadeStart = TimeGet();
+    SetTimer(win->hwndCanvas, kPresentationFadeTimerID, USER_TIMER_MINIMUM, nullptr);
+    return true;
+}
+
+// blends the previous slide's snapshot over the freshly composed one,
+// with opacity falling off linearly over kPresentationFadeDurationMs
+static void DrawPresentationCrossfade(MainWindow* win, HDC hdcBuffer) {
+    double progress = TimeSinceInMs(win->presFadeStart) / kPresentationFadeDurationMs;
+    if (progress >= 1.0) {
+        EndPresentationCrossfade(win);
+        return;
+    }
+    BYTE alpha = (BYTE)(255.0 * (1.0 - progress));
+    Rect r = win->buffer->rect;
+    HDC hdcSnap = CreateCompatibleDC(hdcBuffer);
+    HGDIOBJ prevBmp = SelectObject(hdcSnap, win->presFadeBitmap);
+    BLENDFUNCTION bf = {AC_SRC_OVER, 0, alpha, 0};
+    AlphaBlend(hdcBuffer, 0, 0, r.dx, r.dy, hdcSnap, 0, 0, r.dx, r.dy, bf);
+    SelectObject(hdcSnap, prevBmp);
+    DeleteDC(hdcSnap);
+}
 
 // these can be global, as the mouse wheel can't affect more than one window at once
 static int gDeltaPerLine = 0;
@@ -150,8 +263,7 @@ static void OnVScroll(MainWindow* win, WPARAM wp) {
     // scroll the window and update it
     if (si.nPos != currPos || msg == SB_THUMBTRACK) {
         if (gGlobalPrefs->smoothScroll) {
-            win->scrollTargetY = si.nPos;
-            SetTimer(win->hwndCanvas, kSmoothScrollTimerID, USER_TIMER_MINIMUM, nullptr);
+            StartSmoothScroll(win, si.nPos);
         } else {
             win->AsFixed()->ScrollYTo(si.nPos);
         }
@@ -258,7 +370,10 @@ static bool StopDraggingAnnotation(MainWindow* win, int x, int y, bool aborted)
         // logf(" new rect: x=%.2f, y=%.2f, dx=%.2f, dy=%.2f\n", r.x, r.y, r.dx, r.dy);
         SetRect(annot, r);
         NotifyAnnotationsChanged(win->CurrentTab()->editAnnotsWindow);
-        MainWindowRerender(win);
+        // only the pixels at the old and the new position change,
+        // the rest of the page's cached bitmaps stays valid
+        RectF changed = ar.Union(r);
+        MainWindowRerenderPage(win, pageNo, &changed);
         ToolbarUpdateStateForWindow(win, true);
     }
     return true;
@@ -403,11 +518,18 @@ static void OnMouseMove(MainWindow* win, int x, int y, WPARAM) {
             [[fallthrough]];
         case MouseAction::Selecting: {
             win->annotationUnderCursor = nullptr;
+            // only repaint the area the selection change affects
+            // instead of the whole canvas (expensive at 4K)
+            Rect oldArea = SelectionScreenArea(win);
             win->selectionRect.dx = x - win->selectionRect.x;
             win->selectionRect.dy = y - win->selectionRect.y;
             win->selectionMeasure = dm->CvtFromScreen(win->selectionRect).Size();
             OnSelectionEdgeAutoscroll(win, x, y);
-            ScheduleRepaint(win, 0);
+            if (MouseAction::SelectingText == win->mouseAction) {
+                // update now so that the new text rectangles are known
+                UpdateTextSelection(win);
+            }
+            InvalidateSelectionChange(win, oldArea);
             break;
         }
         case MouseAction::Dragging: {
@@ -1066,6 +1188,229 @@ static bool DrawDocument(MainWindow* win, HDC hdc, RECT* rcArea) {
     return shouldPaint;
 }
 
+#include <d2d1.h>
+#pragma comment(lib, "d2d1.lib")
+
+// Presents the composed double buffer through a Direct2D render target.
+// The frame is blitted once into the render target via GDI interop and
+// Direct2D uploads it to a GPU texture; EndDraw() then waits for vsync
+// (D2D1_PRESENT_OPTIONS_NONE). a render target is bound to a single hwnd
+// so we only cache one: repaints of the foreground window dominate and
+// re-creating the target when another window paints is cheap
+struct D2DPresenter {
+    ID2D1Factory* factory = nullptr;
+    ID2D1HwndRenderTarget* renderTarget = nullptr;
+    ID2D1GdiInteropRenderTarget* gdiInterop = nullptr;
+    // cached GPU copy of the composed frame, only used by PresentScaled
+    ID2D1Bitmap* frameBitmap = nullptr;
+    HWND hwnd = nullptr;
+
+    void DiscardTarget();
+    bool EnsureTarget(HWND hwndCanvas);
+    bool Present(HWND hwndCanvas, const DoubleBuffer* buffer);
+    bool PresentScaled(HWND hwndCanvas, const DoubleBuffer* buffer, Rect dst, COLORREF bg);
+};
+
+static D2DPresenter gD2DPresenter;
+
+void D2DPresenter::DiscardTarget() {
+    if (frameBitmap) {
+        frameBitmap->Release();
+        frameBitmap = nullptr;
+    }
+    if (gdiInterop) {
+        gdiInterop->Release();
+        gdiInterop = nullptr;
+    }
+    if (renderTarget) {
+        renderTarget->Release();
+        renderTarget = nullptr;
+    }
+    hwnd = nullptr;
+}
+
+bool D2DPresenter::EnsureTarget(HWND hwndCanvas) {
+    if (!factory) {
+        HRESULT hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &factory);
+        if (FAILED(hr)) {
+            return false;
+        }
+    }
+
+    Rect rc = ClientRect(hwndCanvas);
+    D2D1_SIZE_U size = D2D1::SizeU((UINT32)rc.dx, (UINT32)rc.dy);
+    if (renderTarget && hwnd == hwndCanvas) {
+        if (renderTarget->GetPixelSize().width != size.width || renderTarget->GetPixelSize().height != size.height) {
+            if (FAILED(renderTarget->Resize(size))) {
+                DiscardTarget();
+            }
+        }
+    } else {
+        DiscardTarget();
+    }
+    if (renderTarget) {
+        return true;
+    }
+
+    // GDI_COMPATIBLE is needed for the interop blit out of the double buffer
+    D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_DEFAULT,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE), 0.0f, 0.0f,
+        D2D1_RENDER_TARGET_USAGE_GDI_COMPATIBLE);
+    D2D1_HWND_RENDER_TARGET_PROPERTIES hwndProps = D2D1::HwndRenderTargetProperties(hwndCanvas, size);
+    HRESULT hr = factory->CreateHwndRenderTarget(props, hwndProps, &renderTarget);
+    if (FAILED(hr)) {
+        return false;
+    }
+    hr = renderTarget->QueryInterface(__uuidof(ID2D1GdiInteropRenderTarget), (void**)&gdiInterop);
+    if (FAILED(hr)) {
+        DiscardTarget();
+        return false;
+    }
+    hwnd = hwndCanvas;
+    return true;
+}
+
+// returns false if the frame couldn't be presented; the caller is expected
+// to fall back to DoubleBuffer::Flush()
+bool D2DPresenter::Present(HWND hwndCanvas, const DoubleBuffer* buffer) {
+    if (!buffer->hdcBuffer) {
+        // painting went directly to the window DC, nothing to present
+        return false;
+    }
+    if (!EnsureTarget(hwndCanvas)) {
+        return false;
+    }
+
+    renderTarget->BeginDraw();
+    HDC hdc = nullptr;
+    HRESULT hr = gdiInterop->GetDC(D2D1_DC_INITIALIZE_MODE_CLEAR, &hdc);
+    if (SUCCEEDED(hr)) {
+        Rect rc = buffer->rect;
+        BitBlt(hdc, rc.x, rc.y, rc.dx, rc.dy, buffer->hdcBuffer, 0, 0, SRCCOPY);
+        RECT rcUpdate = ToRECT(rc);
+        gdiInterop->ReleaseDC(&rcUpdate);
+    }
+    hr = renderTarget->EndDraw();
+    if (hr == D2DERR_RECREATE_TARGET) {
+        // device loss (driver upgrade, remote session change etc.)
+        DiscardTarget();
+        return false;
+    }
+    if (FAILED(hr)) {
+        return false;
+    }
+    gD2DFrameTiming.Step();
+    return true;
+}
+
+// scales the composed frame on the GPU with linear filtering instead of
+// a HALFTONE StretchBlt, which filters on the CPU and dominates the
+// paint when a pinch zoom stretches the whole client area every frame.
+// the frame is uploaded once per paint (a copy, not a conversion) and
+// re-uses the bitmap allocation across frames
+bool D2DPresenter::PresentScaled(HWND hwndCanvas, const DoubleBuffer* buffer, Rect dst, COLORREF bg) {
+    if (!buffer->hdcBuffer || !buffer->bits) {
+        return false;
+    }
+    if (!EnsureTarget(hwndCanvas)) {
+        return false;
+    }
+    // make sure pending GDI drawing reached the dib bits
+    GdiFlush();
+    Rect rc = buffer->rect;
+    D2D1_SIZE_U size = D2D1::SizeU((UINT32)rc.dx, (UINT32)rc.dy);
+    if (frameBitmap) {
+        D2D1_SIZE_U prev = frameBitmap->GetPixelSize();
+        if (prev.width != size.width || prev.height != size.height) {
+            frameBitmap->Release();
+            frameBitmap = nullptr;
+        }
+    }
+    HRESULT hr;
+    if (!frameBitmap) {
+        D2D1_BITMAP_PROPERTIES bmpProps =
+            D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE));
+        hr = renderTarget->CreateBitmap(size, bmpProps, &frameBitmap);
+        if (FAILED(hr)) {
+            return false;
+        }
+    }
+    hr = frameBitmap->CopyFromMemory(nullptr, buffer->bits, (UINT32)rc.dx * 4);
+    if (FAILED(hr)) {
+        return false;
+    }
+    renderTarget->BeginDraw();
+    renderTarget->Clear(
+        D2D1::ColorF(GetRValue(bg) / 255.0f, GetGValue(bg) / 255.0f, GetBValue(bg) / 255.0f));
+    D2D1_RECT_F dstF = D2D1::RectF((float)dst.x, (float)dst.y, (float)(dst.x + dst.dx), (float)(dst.y + dst.dy));
+    renderTarget->DrawBitmap(frameBitmap, dstF, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, nullptr);
+    hr = renderTarget->EndDraw();
+    if (hr == D2DERR_RECREATE_TARGET) {
+        DiscardTarget();
+        return false;
+    }
+    if (FAILED(hr)) {
+        return false;
+    }
+    gD2DFrameTiming.Step();
+    return true;
+}
+
+// duration of the previous paint, shown by the render-stats HUD
+// (we can only know the full cost of a paint once it's done)
+static double gLastPaintTimeMs = 0;
+
+// paints a pinch zoom in progress: stretches the last composed frame
+// by the accumulated gesture factor around the gesture center. The
+// frame looks blocky when zooming in but tracks the fingers without
+// re-rendering; the exact zoom is committed when the gesture ends
+static void FlushScaledForZoomGesture(MainWindow* win, HDC hdc) {
+    DoubleBuffer* buffer = win->buffer;
+    float f = win->touchState.zoomGestureFactor;
+    Point c = win->touchState.zoomCenter;
+    Rect rc = buffer->rect;
+    int dx = (int)((float)rc.dx * f);
+    int dy = (int)((float)rc.dy * f);
+    int x = c.x - (int)((float)(c.x - rc.x) * f);
+    int y = c.y - (int)((float)(c.y - rc.y) * f);
+    auto col = ThemeMainWindowBackgroundColor();
+    if (gUseDirect2DPresent) {
+        Rect dst(x, y, dx, dy);
+        if (gD2DPresenter.PresentScaled(win->hwndCanvas, buffer, dst, col)) {
+            return;
+        }
+    }
+    if (f < 1.0f) {
+        // areas uncovered when zooming out
+        AutoDeleteBrush brush = CreateSolidBrush(col);
+        RECT rTmp = ToRECT(rc);
+        FillRect(hdc, &rTmp, brush);
+    }
+    SetStretchBltMode(hdc, HALFTONE);
+    StretchBlt(hdc, x, y, dx, dy, buffer->hdcBuffer, 0, 0, rc.dx, rc.dy, SRCCOPY);
+}
+
+// debug HUD for diagnosing rendering latency (CmdDebugToggleRenderStats):
+// paint time, request-to-bitmap latency, cache hit rate and render queue depth
+static void DrawRenderStats(HDC hdc) {
+    RenderCache* rc = gRenderCache;
+    int nPaints = rc->paintHits + rc->paintMisses;
+    double hitRate = nPaints > 0 ? (double)rc->paintHits * 100 / (double)nPaints : 0;
+    double avgLatencyMs = rc->renderedCount > 0 ? (double)rc->renderLatencyTotalMs / (double)rc->renderedCount : 0;
+    TempStr s = str::FormatTemp("paint: %.1f ms\nrender: %d ms (avg %.0f ms over %d)\ncache hits: %.0f%% of %d\nqueue: %d / %d",
+                                gLastPaintTimeMs, rc->lastRenderLatencyMs, avgLatencyMs, rc->renderedCount, hitRate,
+                                nPaints, rc->requestCount, MAX_PAGE_REQUESTS);
+    RECT r{8, 8, 8, 8};
+    HdcDrawText(hdc, s, &r, DT_CALCRECT | DT_NOPREFIX);
+    RECT bg = r;
+    InflateRect(&bg, 4, 4);
+    FillRect(hdc, &bg, GetStockBrush(WHITE_BRUSH));
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(0, 0, 0));
+    HdcDrawText(hdc, s, &r, DT_NOPREFIX);
+}
+
 static void OnPaintDocument(MainWindow* win) {
     auto t = TimeGet();
     PAINTSTRUCT ps;
@@ -1079,15 +1424,57 @@ static void OnPaintDocument(MainWindow* win) {
             FillRect(hdc, &ps.rcPaint, GetStockBrush(WHITE_BRUSH));
             break;
         default:
-            bool shouldFlush = DrawDocument(win, win->buffer->GetDC(), &ps.rcPaint);
+            if (win->touchState.zoomGestureActive && win->buffer->hdcBuffer) {
+                // the buffer still holds the pre-gesture frame; scale
+                // it instead of composing a new one
+                FlushScaledForZoomGesture(win, hdc);
+                break;
+            }
+            HDC hdcBuffer = win->buffer->GetDC();
+            bool presFade = false;
+            if (PM_ENABLED == win->presentation) {
+                presFade = MaybeStartPresentationCrossfade(win, hdcBuffer);
+            } else if (win->presFadeBitmap || win->presFadeLastPageNo) {
+                EndPresentationCrossfade(win);
+                win->presFadeLastPageNo = 0;
+            }
+            // the buffer still holds the previous frame, so only the
+            // dirty part has to be composed again; GDI clips the page
+            // blits and selection drawing to this rect
+            int savedDC = SaveDC(hdcBuffer);
+            IntersectClipRect(hdcBuffer, ps.rcPaint.left, ps.rcPaint.top, ps.rcPaint.right, ps.rcPaint.bottom);
+            bool shouldFlush = DrawDocument(win, hdcBuffer, &ps.rcPaint);
+            RestoreDC(hdcBuffer, savedDC);
+            if (presFade) {
+                DrawPresentationCrossfade(win, hdcBuffer);
+            }
             if (!gNoFlickerRender || shouldFlush) {
-                win->buffer->Flush(hdc);
+                bool presented = false;
+                if (gUseDirect2DPresent) {
+                    presented = gD2DPresenter.Present(win->hwndCanvas, win->buffer);
+                }
+                if (!presented) {
+                    win->buffer->Flush(hdc);
+                }
+            }
+            if (shouldFlush) {
+                // -startup-bench: document content has reached the screen
+                OnStartupBenchFirstPaint(win);
             }
     }
 
+    if (gShowRenderStats) {
+        DrawRenderStats(hdc);
+    }
+
     EndPaint(win->hwndCanvas, &ps);
+    // the scroll thumb paints over the search hit marks while it moves;
+    // every scroll also repaints the client area, so restore them here
+    PaintSearchHitMarks(win);
+    double durMs = TimeSinceInMs(t);
+    gLastPaintTimeMs = durMs;
     if (gShowFrameRate) {
-        win->frameRateWnd->ShowFrameRateDur(TimeSinceInMs(t));
+        win->frameRateWnd->ShowFrameRateDur(durMs);
     }
 }
 
@@ -1199,7 +1586,7 @@ static void ZoomByMouseWheel(MainWindow* win, WPARAM wp) {
     win->dragStartPending = false;
     // Kill the smooth scroll timer when zooming
     // We don't want to move to the new updated y offset after zooming
-    KillTimer(win->hwndCanvas, kSmoothScrollTimerID);
+    StopSmoothScroll(win);
 
     short delta = GET_WHEEL_DELTA_WPARAM(wp);
     Point pt = HwndGetCursorPos(win->hwndCanvas);
@@ -1468,13 +1855,27 @@ static LRESULT OnGesture(MainWindow* win, UINT msg, WPARAM wp, LPARAM lp) {
         case GID_ZOOM: {
             auto curr = (float)LowerU64(gi.ullArguments);
             bool isBegin = gi.dwFlags & GF_BEGIN;
-            if (!isBegin) {
+            bool isEnd = gi.dwFlags & GF_END;
+            if (isBegin) {
+                touchState.zoomGestureActive = true;
+                touchState.zoomGestureFactor = 1.0f;
+            } else if (curr > 0 && touchState.zoomIntermediate > 0) {
                 auto prev = (float)touchState.zoomIntermediate;
-                float factor = curr / prev;
+                touchState.zoomGestureFactor *= curr / prev;
                 Point pt{gi.ptsLocation.x, gi.ptsLocation.y};
                 HwndScreenToClient(win->hwndCanvas, pt);
-                float newZoom = ScaleZoomBy(win, factor);
-                SmartZoom(win, newZoom, &pt, false);
+                touchState.zoomCenter = pt;
+                if (isEnd) {
+                    // commit the exact zoom once, at gesture end
+                    touchState.zoomGestureActive = false;
+                    float newZoom = ScaleZoomBy(win, touchState.zoomGestureFactor);
+                    SmartZoom(win, newZoom, &pt, false);
+                } else {
+                    // while the fingers are down only repaint: the
+                    // paint path scales the cached frame, it doesn't
+                    // re-layout and re-render per gesture update
+                    InvalidateRect(win->hwndCanvas, nullptr, FALSE);
+                }
             }
             touchState.zoomIntermediate = curr;
             break;
@@ -1702,7 +2103,10 @@ static LRESULT WndProcCanvasFixedPageUI(MainWindow* win, HWND hwnd, UINT msg, WP
                 ShowScrollBar(win->hwndCanvas, requiredScrollAxes, !gGlobalPrefs->fixedPageUI.hideScrollbars);
             }
 
-            // allow default processing to continue
+            LRESULT res = DefWindowProc(hwnd, msg, wp, lp);
+            // overlay search hit marks on the freshly painted scrollbar
+            PaintSearchHitMarks(win);
+            return res;
         }
     }
     return DefWindowProc(hwnd, msg, wp, lp);
@@ -1787,8 +2191,12 @@ void ScheduleRepaint(MainWindow* win, int delayInMs) {
     data->delayInMs = delayInMs;
     auto fn = MkFunc0<RepaintTaskData>(RepaintTask, data);
     // even though RepaintAsync is mostly called from the UI thread,
-    // we depend on the repaint message to happen asynchronously
-    uitask::Post(fn, nullptr);
+    // we depend on the repaint message to happen asynchronously.
+    // render completions request a repaint per tile; coalesce them
+    // into a single task per window
+    if (!uitask::PostCoalesced(fn, nullptr, win)) {
+        delete data;
+    }
 }
 
 static void OnTimer(MainWindow* win, HWND hwnd, WPARAM timerId) {
@@ -1851,25 +2259,55 @@ static void OnTimer(MainWindow* win, HWND hwnd, WPARAM timerId) {
             break;
         }
 
-        case kSmoothScrollTimerID:
-            DisplayModel* dm = win->AsFixed();
-
-            int current = dm->yOffset();
-            int target = win->scrollTargetY;
-            int delta = target - current;
-
-            if (delta == 0) {
-                KillTimer(hwnd, kSmoothScrollTimerID);
+        case kPresentationFadeTimerID:
+            if (!win->presFadeBitmap) {
+                KillTimer(hwnd, kPresentationFadeTimerID);
             } else {
-                // logf("Smooth scrolling from %d to %d (delta %d)\n", current, target, delta);
+                // repaint the whole canvas; the blend covers all of it
+                win->RedrawAll();
+            }
+            break;
 
-                double step = delta * gSmoothScrollingFactor;
+        case kSmoothScrollTimerID: {
+            DisplayModel* dm = win->AsFixed();
 
-                // Round away from zero
-                int dy = step < 0 ? (int)floor(step) : (int)ceil(step);
-                dm->ScrollYTo(current + dy);
+            LARGE_INTEGER now, freq;
+            QueryPerformanceCounter(&now);
+            QueryPerformanceFrequency(&freq);
+            double dt = (double)(now.QuadPart - win->smoothScrollLastStep.QuadPart) / (double)freq.QuadPart;
+            win->smoothScrollLastStep = now;
+            // timers can stall (window drags, modal loops); cap the
+            // step so the animation doesn't jump after a stall
+            dt = std::min(dt, 0.1);
+
+            // exact solution of the critically damped spring over dt;
+            // stepping from measured elapsed time makes the motion the
+            // same whether the timer fires at 60Hz or 120Hz
+            double x = win->smoothScrollY - (double)win->scrollTargetY;
+            double v = win->smoothScrollVelocity;
+            double e = exp(-kSmoothScrollOmega * dt);
+            double newX = (x + (v + kSmoothScrollOmega * x) * dt) * e;
+            double newV = (v - kSmoothScrollOmega * (v + kSmoothScrollOmega * x) * dt) * e;
+            win->smoothScrollY = (double)win->scrollTargetY + newX;
+            win->smoothScrollVelocity = newV;
+
+            int yNew = (int)round(win->smoothScrollY);
+            // at rest when within half a pixel and nearly stopped
+            if (fabs(newX) < 0.5 && fabs(newV) < 1.0) {
+                yNew = win->scrollTargetY;
+                StopSmoothScroll(win);
+            } else if (gUseDirect2DPresent) {
+                // re-arm so that the next tick lands on the next vsync
+                SetTimer(hwnd, kSmoothScrollTimerID, SmoothScrollDelayInMs(), nullptr);
+            }
+            if (yNew != dm->yOffset()) {
+                // intermediate positions paint from cached tiles (with
+                // scaled substitutes where needed), so the animation
+                // doesn't wait for rendering
+                dm->ScrollYTo(yNew);
             }
             break;
+        }
     }
 }
 
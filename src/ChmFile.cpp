@@ -278,6 +278,11 @@ bool ChmFile::Load(const char* path) {
     if (!chmHandle) {
         return false;
     }
+    // the default of 5 cached blocks causes the same LZX reset intervals
+    // to be decompressed over and over when navigating a big CHM (every
+    // miss has to re-decompress from the preceding reset point); 64
+    // blocks is ~4 MB of decompressed data at the common 64 KB block size
+    chm_set_param(chmHandle, CHM_PARAM_MAX_BLOCKS_CACHED, 64);
 
     ParseWindowsData();
     if (!ParseSystemData()) {
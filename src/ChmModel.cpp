@@ -5,6 +5,7 @@
 #include "utils/Dict.h"
 #include "utils/UITask.h"
 #include "utils/ScopedWin.h"
+#include "utils/ThreadUtil.h"
 #include "utils/WinUtil.h"
 
 #include "wingui/HtmlWindow.h"
@@ -83,12 +84,17 @@ ChmModel::ChmModel(DocControllerCallback* cb) : DocController(cb) {
 }
 
 ChmModel::~ChmModel() {
-    EnterCriticalSection(&docAccess);
+    // the prefetch thread uses doc and urlDataCache
+    JoinTocPrefetchThread();
+    // deleting htmlWindow waits for in-flight protocol fetches, which
+    // call GetDataForUrl() and take docAccess, so it must happen
+    // before we take the lock
     // TODO: deleting htmlWindow seems to spin a modal loop which
     //       can lead to WM_PAINT being dispatched for the parent
     //       hwnd and then crashing in SumatraPDF.cpp's DrawDocument
     delete htmlWindow;
     delete htmlWindowCb;
+    EnterCriticalSection(&docAccess);
     delete doc;
     delete tocTrace;
     delete tocTree;
@@ -361,6 +367,41 @@ class ChmTocBuilder : public EbookTocVisitor {
     }
 };
 
+// don't fill urlDataCache with more than this much topic data;
+// big API-reference CHMs can have tens of thousands of topics
+#define MAX_TOC_PREFETCH_BYTES (16 * 1024 * 1024)
+
+// walks the pages found while parsing the ToC and loads their data into
+// urlDataCache, so that by the time the user navigates to a topic it's
+// usually already extracted; without this every topic switch extracts
+// from the CHM's LZX-compressed sections on demand
+void ChmModel::RunTocPrefetch() {
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    size_t nBytesPrefetched = 0;
+    int n = pages.Size();
+    for (int i = 0; i < n && !stopPrefetch.Get(); i++) {
+        ByteSlice d = GetDataForUrl(pages.At(i));
+        nBytesPrefetched += d.size();
+        if (nBytesPrefetched >= MAX_TOC_PREFETCH_BYTES) {
+            break;
+        }
+    }
+}
+
+static void TocPrefetchThread(ChmModel* cm) {
+    cm->RunTocPrefetch();
+}
+
+void ChmModel::JoinTocPrefetchThread() {
+    if (!prefetchThread) {
+        return;
+    }
+    stopPrefetch.Set(true);
+    WaitForSingleObject(prefetchThread, INFINITE);
+    CloseHandle(prefetchThread);
+    prefetchThread = nullptr;
+}
+
 bool ChmModel::Load(const char* fileName) {
     this->fileName.SetCopy(fileName);
     doc = ChmFile::CreateFromFile(fileName);
@@ -378,7 +419,15 @@ bool ChmModel::Load(const char* fileName) {
     ChmTocBuilder tmpTocBuilder(doc, &pages, tocTrace, &poolAlloc);
     doc->ParseToc(&tmpTocBuilder);
     ReportIf(pages.Size() == 0);
-    return pages.Size() > 0;
+    if (pages.Size() == 0) {
+        return false;
+    }
+
+    // pages doesn't change after this point, so the prefetch thread can
+    // walk it without locking (GetDataForUrl serializes on docAccess)
+    auto fn = MkFunc0(TocPrefetchThread, this);
+    prefetchThread = StartThread(fn, "ChmTocPrefetchThread");
+    return true;
 }
 
 struct ChmCacheEntry {
@@ -654,8 +703,11 @@ ChmThumbnailTask::ChmThumbnailTask(ChmFile* doc, HWND hwnd, Size size, const OnB
 }
 
 ChmThumbnailTask::~ChmThumbnailTask() {
-    EnterCriticalSection(&docAccess);
+    // deleting hw waits for in-flight protocol fetches, which call
+    // GetDataForUrl() and take docAccess, so it can't happen under
+    // the lock
     delete hw;
+    EnterCriticalSection(&docAccess);
     DestroyWindow(hwnd);
     delete doc;
     for (auto&& d : data) {
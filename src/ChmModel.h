@@ -86,9 +86,18 @@ struct ChmModel : DocController {
     // is deleted (e.g. for titles and URLs for ChmTocItem and ChmCacheEntry)
     PoolAllocator poolAlloc;
 
+    // loads the topics found while parsing the ToC into urlDataCache
+    // in the background so that navigating to them is instant
+    HANDLE prefetchThread = nullptr;
+    AtomicBool stopPrefetch;
+
     bool Load(const char* fileName);
     bool DisplayPage(const char* pageUrl);
 
+    // internal use: body of the ToC prefetch thread
+    void RunTocPrefetch();
+    void JoinTocPrefetchThread();
+
     ChmCacheEntry* FindDataForUrl(const char* url) const;
 
     void ZoomTo(float zoomLevel) const;
@@ -5,6 +5,7 @@
 #include "utils/WinUtil.h"
 #include "utils/UITask.h"
 #include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
 
 #include "wingui/UIModels.h"
 #include "wingui/Layout.h"
@@ -28,6 +29,7 @@
 #include "ExternalViewers.h"
 #include "Annotation.h"
 #include "FileHistory.h"
+#include "FullTextIndex.h"
 
 #include "utils/Log.h"
 
@@ -87,10 +89,13 @@ static i32 gDocumentNotOpenWhitelist[] = {
     CmdHelpVisitWebsite,
     CmdHelpAbout,
     CmdDebugDownloadSymbols,
+    CmdDebugShowMemoryUsage,
     CmdDebugShowNotif,
     CmdDebugStartStressTest,
     CmdDebugTestApp,
+    CmdDebugTogglePerfTrace,
     CmdDebugTogglePredictiveRender,
+    CmdDebugToggleRenderStats,
     CmdDebugToggleRtl,
     CmdFavoriteToggle,
     CmdToggleFullscreen,
@@ -171,6 +176,7 @@ struct ItemDataCP {
     i32 cmdId = 0;
     WindowTab* tab = nullptr;
     const char* filePath = nullptr;
+    int pageNo = 0; // of a ToC section entry
 };
 
 using StrVecCP = StrVecWithData<ItemDataCP>;
@@ -197,6 +203,22 @@ struct CommandPaletteWnd : Wnd {
     StrVecCP tabs;
     StrVecCP fileHistory;
     StrVecCP commands;
+    StrVecCP sections;
+    // lower-cased copies of the above, built once in CollectStrings(),
+    // so that filtering doesn't need case-insensitive matching
+    StrVec tabsLower;
+    StrVec fileHistoryLower;
+    StrVec commandsLower;
+    StrVec sectionsLower;
+    // the previous query and its matches (as indexes into the source
+    // it selected) so that a query that extends the previous one only
+    // narrows down the previous matches
+    AutoFreeStr prevQuery;
+    StrVecCP* prevSource = nullptr;
+    Vec<int> prevMatches;
+    // owns the paths of the current search-everywhere hits; the model's
+    // items point into it
+    StrVec everywherePaths;
     ListBox* listBox = nullptr;
     Static* staticInfo = nullptr;
 
@@ -390,6 +412,14 @@ static TempStr RemovePrefixFromString(const char* s) {
     return str::ReplaceTemp(s, "&", "");
 }
 
+static void AppendLowered(StrVec& out, const StrVecCP& strs) {
+    int n = strs.Size();
+    for (int i = 0; i < n; i++) {
+        TempStr s = str::DupTemp(strs.At(i));
+        out.Append(str::ToLowerInPlace(s));
+    }
+}
+
 void CommandPaletteWnd::CollectStrings(MainWindow* mainWin) {
     CommandPaletteBuildCtx ctx;
     ctx.isDocLoaded = mainWin->IsDocLoaded();
@@ -480,6 +510,18 @@ void CommandPaletteWnd::CollectStrings(MainWindow* mainWin) {
         fileHistory.Append(s, data);
     }
 
+    // flattened ToC of the current document, pre-built in the background
+    // when the document was loaded (see BuildTocFlatIndexAsync)
+    TocFlatIndex* tocFlat = currTab ? currTab->tocFlatIndex : nullptr;
+    if (tocFlat) {
+        int nSections = tocFlat->labels.Size();
+        for (int i = 0; i < nSections; i++) {
+            ItemDataCP data;
+            data.pageNo = tocFlat->pages.At(i);
+            sections.Append(tocFlat->labels.At(i), data);
+        }
+    }
+
     StrVecCP tempCommands;
     int cmdId = (int)CmdFirst + 1;
     for (SeqStrings name = gCommandDescriptions; name; seqstrings::Next(name, &cmdId)) {
@@ -513,6 +555,11 @@ void CommandPaletteWnd::CollectStrings(MainWindow* mainWin) {
     for (int i = 0; i < n; i++) {
         commands.AppendFrom(&tempCommands, i);
     }
+
+    AppendLowered(tabsLower, tabs);
+    AppendLowered(fileHistoryLower, fileHistory);
+    AppendLowered(commandsLower, commands);
+    AppendLowered(sectionsLower, sections);
 }
 
 static void EditSetTextAndFocus(Edit* e, const char* s) {
@@ -533,6 +580,10 @@ static void SwitchToFileHistory(CommandPaletteWnd* wnd) {
     EditSetTextAndFocus(wnd->editQuery, kPalettePrefixFileHistory);
 }
 
+static void SwitchToSections(CommandPaletteWnd* wnd) {
+    EditSetTextAndFocus(wnd->editQuery, kPalettePrefixSections);
+}
+
 static CommandPaletteWnd* gCommandPaletteWnd = nullptr;
 static HWND gHwndToActivateOnClose = nullptr;
 
@@ -646,15 +697,8 @@ bool CommandPaletteWnd::PreTranslateMessage(MSG& msg) {
     return false;
 }
 
-// filter is one or more words separated by whitespace
-// filter matches if all words match, ignoring the case
-static bool FilterMatches(const char* str, const char* filter) {
-    // empty filter matches all
-    if (str::IsEmptyOrWhiteSpace(filter)) {
-        return true;
-    }
-    StrVec words;
-    char* s = str::DupTemp(filter);
+// splits filter (modified in place) into words separated by whitespace
+static void SplitFilterWords(char* s, StrVec& words) {
     char* wordStart = s;
     bool wasWs = false;
     while (*s) {
@@ -665,34 +709,29 @@ static bool FilterMatches(const char* str, const char* filter) {
                 wasWs = true;
             }
             wordStart = s + 1;
+        } else {
+            wasWs = false;
         }
         s++;
     }
     if (str::Leni(wordStart) > 0) {
         AppendIfNotExists(&words, wordStart);
     }
-    // all words must be present
+}
+
+// str and words must be lower-cased
+// matches if all words are present; no words matches all
+static bool FilterMatches(const char* str, const StrVec& words) {
     int nWords = words.Size();
     for (int i = 0; i < nWords; i++) {
         auto word = words.At(i);
-        if (!str::ContainsI(str, word)) {
+        if (!str::Contains(str, word)) {
             return false;
         }
     }
     return true;
 }
 
-static void FilterStrings(StrVecCP& strs, const char* filter, StrVecCP& matchedOut) {
-    int n = strs.Size();
-    for (int i = 0; i < n; i++) {
-        const char* s = strs.At(i);
-        if (!FilterMatches(s, filter)) {
-            continue;
-        }
-        matchedOut.AppendFrom(&strs, i);
-    }
-}
-
 const char* SkipWS(const char* s) {
     while (str::IsWs(*s)) {
         s++;
@@ -700,23 +739,80 @@ const char* SkipWS(const char* s) {
     return s;
 }
 
-void CommandPaletteWnd::FilterStringsForQuery(const char* filter, StrVecCP& strings) {
-    // for efficiency, reusing existing model
-    strings.Reset();
-    if (str::StartsWith(filter, kPalettePrefixTabs)) {
-        filter++;
-        FilterStrings(tabs, filter, strings);
+void CommandPaletteWnd::FilterStringsForQuery(const char* query, StrVecCP& strings) {
+    if (str::StartsWith(query, kPalettePrefixEverywhere)) {
+        // results come from the on-disk full-text index, not from a
+        // pre-collected list, so the narrowing logic below doesn't apply
+        strings.Reset();
+        everywherePaths.Reset();
+        SearchFullTextIndex(SkipWS(query + 1), everywherePaths, 64);
+        for (char* path : everywherePaths) {
+            ItemDataCP data;
+            data.filePath = path;
+            strings.Append(ConvertPathForDisplayTemp(path), data);
+        }
+        prevQuery.SetCopy(query);
+        prevSource = nullptr;
+        prevMatches.Reset();
         return;
     }
-    if (str::StartsWith(filter, kPalettePrefixFileHistory)) {
+
+    StrVecCP* strs = &commands;
+    StrVec* strsLower = &commandsLower;
+    const char* filter = query;
+    if (str::StartsWith(filter, kPalettePrefixTabs)) {
         filter++;
-        FilterStrings(fileHistory, filter, strings);
-        return;
-    }
-    if (str::StartsWith(filter, kPalettePrefixCommands)) {
+        strs = &tabs;
+        strsLower = &tabsLower;
+    } else if (str::StartsWith(filter, kPalettePrefixFileHistory)) {
+        filter++;
+        strs = &fileHistory;
+        strsLower = &fileHistoryLower;
+    } else if (str::StartsWith(filter, kPalettePrefixSections)) {
+        filter++;
+        strs = &sections;
+        strsLower = &sectionsLower;
+    } else if (str::StartsWith(filter, kPalettePrefixCommands)) {
         filter++;
     }
-    FilterStrings(commands, filter, strings);
+
+    StrVec words;
+    if (!str::IsEmptyOrWhiteSpace(filter)) {
+        TempStr filterLower = str::ToLowerInPlace(str::DupTemp(filter));
+        SplitFilterWords(filterLower, words);
+    }
+
+    // a query that extends the previous one can only match a subset of
+    // the previous matches so we only need to re-check those. This keeps
+    // the cost of a keystroke flat even with a very large file history
+    bool narrow = (strs == prevSource) && prevQuery.Get() && str::StartsWith(query, prevQuery.Get());
+    Vec<int> matches;
+    if (narrow) {
+        int n = prevMatches.Size();
+        for (int i = 0; i < n; i++) {
+            int idx = prevMatches.At(i);
+            if (FilterMatches(strsLower->At(idx), words)) {
+                matches.Append(idx);
+            }
+        }
+    } else {
+        int n = strs->Size();
+        for (int i = 0; i < n; i++) {
+            if (FilterMatches(strsLower->At(i), words)) {
+                matches.Append(i);
+            }
+        }
+    }
+
+    // for efficiency, reusing existing model
+    strings.Reset();
+    int nMatches = matches.Size();
+    for (int i = 0; i < nMatches; i++) {
+        strings.AppendFrom(strs, matches.At(i));
+    }
+    prevQuery.SetCopy(query);
+    prevSource = strs;
+    prevMatches = std::move(matches);
 }
 
 void CommandPaletteWnd::QueryChanged() {
@@ -770,6 +866,12 @@ void CommandPaletteWnd::ExecuteCurrentSelection() {
         return;
     }
 
+    if (data->pageNo > 0 && win->IsDocLoaded()) {
+        win->ctrl->GoToPage(data->pageNo, true);
+        ScheduleDelete();
+        return;
+    }
+
     WindowTab* tab = data->tab;
     if (tab != nullptr) {
         MainWindow* mainWin = tab->win;
@@ -892,6 +994,13 @@ bool CommandPaletteWnd::Create(MainWindow* win, const char* prefix, int smartTab
             auto p = new Padding(c, pad);
             hbox->AddChild(p);
         }
+        if (sections.Size() > 0) {
+            auto c = CreateStatic(hwnd, font, "$ Sections");
+            c->SetColors(colTxt, colBg);
+            c->onClick = MkFunc0(SwitchToSections, this);
+            auto p = new Padding(c, pad);
+            hbox->AddChild(p);
+        }
         vbox->AddChild(hbox);
     }
 
@@ -958,3 +1067,75 @@ void RunCommandPallette(MainWindow* win, const char* prefix, int smartTabAdvance
     gCommandPaletteWnd = wnd;
     gHwndToActivateOnClose = win->hwndFrame;
 }
+
+struct TocFlatBuildData {
+    WindowTab* tab = nullptr;
+    EngineBase* engine = nullptr; // keeps the engine alive for the build
+    TocFlatIndex* idx = nullptr;
+};
+
+static void FlattenTocItems(TocItem* item, const char* parentPath, TocFlatIndex* idx) {
+    for (; item; item = item->next) {
+        const char* title = item->title ? item->title : "";
+        TempStr path;
+        if (parentPath) {
+            path = str::JoinTemp(parentPath, " / ", title);
+        } else {
+            path = str::DupTemp(title);
+        }
+        if (item->pageNo > 0) {
+            idx->labels.Append(path);
+            idx->pages.Append(item->pageNo);
+        }
+        FlattenTocItems(item->child, path, idx);
+    }
+}
+
+static void BuildTocFlatIndexDone(TocFlatBuildData* d) {
+    WindowTab* tab = d->tab;
+    // the tab could have been closed or its document reloaded while the
+    // index was being built
+    bool valid = FindMainWindowByTab(tab) && tab->GetEngine() == d->engine;
+    if (valid) {
+        delete tab->tocFlatIndex;
+        tab->tocFlatIndex = d->idx;
+    } else {
+        delete d->idx;
+    }
+    d->engine->Release();
+    delete d;
+}
+
+static void BuildTocFlatIndexThread(TocFlatBuildData* d) {
+    TocTree* tocTree = d->engine->GetToc();
+    if (tocTree && tocTree->root) {
+        TocFlatIndex* idx = new TocFlatIndex();
+        FlattenTocItems(tocTree->root->child, nullptr, idx);
+        if (idx->labels.Size() > 0) {
+            d->idx = idx;
+        } else {
+            delete idx;
+        }
+    }
+    auto fn = MkFunc0(BuildTocFlatIndexDone, d);
+    uitask::Post(fn, "BuildTocFlatIndexDone");
+}
+
+void BuildTocFlatIndexAsync(WindowTab* tab) {
+    if (!tab) {
+        return;
+    }
+    delete tab->tocFlatIndex;
+    tab->tocFlatIndex = nullptr;
+    DisplayModel* dm = tab->AsFixed();
+    if (!dm) {
+        // the Chm ToC is bound to the UI thread
+        return;
+    }
+    auto d = new TocFlatBuildData();
+    d->tab = tab;
+    d->engine = dm->GetEngine();
+    d->engine->AddRef();
+    auto fn = MkFunc0(BuildTocFlatIndexThread, d);
+    RunAsync(fn, "TocFlatIndexThread", ThreadQoS::Background);
+}
@@ -4,5 +4,8 @@
 constexpr const char* kPalettePrefixCommands = ">";
 constexpr const char* kPalettePrefixFileHistory = "#";
 constexpr const char* kPalettePrefixTabs = "@";
+constexpr const char* kPalettePrefixSections = "$";
+constexpr const char* kPalettePrefixEverywhere = "/";
 
 void RunCommandPallette(MainWindow*, const char* prefix, int smartTabAdvance);
+void BuildTocFlatIndexAsync(WindowTab*);
@@ -32,6 +32,7 @@ Cmd* enum (e.g. CmdOpen) and a human-readable name (not used yet).
     V(CmdRotateLeft, "Rotate Left")                                                \
     V(CmdRotateRight, "Rotate Right")                                              \
     V(CmdToggleBookmarks, "Toggle Bookmarks")                                      \
+    V(CmdToggleThumbnailStrip, "Toggle Page Thumbnails")                           \
     V(CmdToggleTableOfContents, "Toggle Table Of Contents")                        \
     V(CmdToggleFullscreen, "Toggle Fullscreen")                                    \
     V(CmdPresentationWhiteBackground, "Presentation White Background")             \
@@ -41,6 +42,7 @@ Cmd* enum (e.g. CmdOpen) and a human-readable name (not used yet).
     V(CmdToggleScrollbars, "Toggle Scrollbars")                                    \
     V(CmdToggleMenuBar, "Toggle Menu Bar")                                         \
     V(CmdCopySelection, "Copy Selection")                                          \
+    V(CmdSaveSelectionAsImage, "Save Selection As Image")                          \
     V(CmdTranslateSelectionWithGoogle, "Translate Selection with Google")          \
     V(CmdTranslateSelectionWithDeepL, "Translate Selection With DeepL")            \
     V(CmdSearchSelectionWithGoogle, "Search Selection with Google")                \
@@ -75,6 +77,7 @@ Cmd* enum (e.g. CmdOpen) and a human-readable name (not used yet).
     V(CmdFindNextSel, "Find Next Selection")                                       \
     V(CmdFindPrevSel, "Find Previous Selection")                                   \
     V(CmdFindMatch, "Find: Match Case")                                            \
+    V(CmdFindAllTabs, "Find in All Open Documents")                                \
     V(CmdSaveAnnotations, "Save Annotations to existing PDF")                      \
     V(CmdSaveAnnotationsNewFile, "Save Annotations to a new PDF")                  \
     V(CmdEditAnnotations, "Edit Annotations")                                      \
@@ -168,6 +171,7 @@ Cmd* enum (e.g. CmdOpen) and a human-readable name (not used yet).
     V(CmdCommandPalette, "Command Palette")                                        \
     V(CmdShowLog, "Show Logs")                                                     \
     V(CmdClearHistory, "Clear History")                                            \
+    V(CmdCompactHistory, "Compact History")                                        \
     V(CmdReopenLastClosedFile, "Reopen Last Closed")                               \
     V(CmdNextTab, "Next Tab")                                                      \
     V(CmdPrevTab, "Previous Tab")                                                  \
@@ -186,9 +190,12 @@ Cmd* enum (e.g. CmdOpen) and a human-readable name (not used yet).
     V(CmdDebugCrashMe, "Debug: Crash Me")                                          \
     V(CmdDebugDownloadSymbols, "Debug: Download Symbols")                          \
     V(CmdDebugTestApp, "Debug: Test App")                                          \
+    V(CmdDebugShowMemoryUsage, "Debug: Show Memory Usage")                         \
     V(CmdDebugShowNotif, "Debug: Show Notification")                               \
     V(CmdDebugStartStressTest, "Debug: Start Stress Test")                         \
+    V(CmdDebugTogglePerfTrace, "Debug: Toggle Perf Trace")                         \
     V(CmdDebugTogglePredictiveRender, "Debug: Toggle Predictive Rendering")        \
+    V(CmdDebugToggleRenderStats, "Debug: Toggle Render Stats")                     \
     V(CmdDebugToggleRtl, "Debug: Toggle Rtl")                                      \
     V(CmdNone, "Do nothing")
 
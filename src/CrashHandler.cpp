@@ -23,6 +23,7 @@
 #include "GlobalPrefs.h"
 #include "AppTools.h"
 #include "CrashHandler.h"
+#include "StressTesting.h"
 #include "Version.h"
 #include "SumatraConfig.h"
 #include "AppSettings.h"
@@ -369,8 +370,14 @@ void _uploadDebugReport(const char* condStr, bool isCrash, bool captureCallstack
           (int)captureCallstack, gSymbolPath);
 
     if (captureCallstack) {
-        // we proceed even if we fail to download symbols
-        DownloadSymbolsIfNeeded();
+        if (dbghelp::HasSymbolMap()) {
+            // addresses resolve from the build-time symbol map so we
+            // don't need the .pdb; dbghelp is still used for stack walking
+            InitializeDbgHelp(false);
+        } else {
+            // we proceed even if we fail to download symbols
+            DownloadSymbolsIfNeeded();
+        }
     }
 
     auto s = BuildCrashInfoText(condStr, isCrash, captureCallstack);
@@ -395,7 +402,9 @@ static DWORD WINAPI CrashDumpThread(LPVOID) {
     }
 
     log("CrashDumpThread\n");
-    _uploadDebugReport(nullptr, true, true);
+    if (!IsStressWorkerProcess()) {
+        _uploadDebugReport(nullptr, true, true);
+    }
 
     // always write a MiniDump (for the latest crash only)
     // set the SUMATRAPDF_FULLDUMP environment variable for more complete dumps
@@ -434,6 +443,11 @@ static LONG WINAPI CrashDumpVectoredExceptionHandler(EXCEPTION_POINTERS* excepti
     SetEvent(gDumpEvent);
     WaitForSingleObject(gDumpThread, INFINITE);
 
+    if (IsStressWorkerProcess()) {
+        // no interactive crash UI in a stress worker; exit with a code
+        // the supervising process recognizes as a crash
+        TerminateProcess(GetCurrentProcess(), kStressWorkerCrashExitCode);
+    }
     ShowCrashHandlerMessage();
     TerminateProcess(GetCurrentProcess(), 1);
 
@@ -467,6 +481,11 @@ static LONG WINAPI CrashDumpExceptionHandler(EXCEPTION_POINTERS* exceptionInfo)
     SetEvent(gDumpEvent);
     WaitForSingleObject(gDumpThread, INFINITE);
 
+    if (IsStressWorkerProcess()) {
+        // no interactive crash UI in a stress worker; exit with a code
+        // the supervising process recognizes as a crash
+        TerminateProcess(GetCurrentProcess(), kStressWorkerCrashExitCode);
+    }
     ShowCrashHandlerMessage();
     TerminateProcess(GetCurrentProcess(), 1);
 
@@ -606,6 +625,9 @@ static void GetSystemInfo(str::Str& s) {
         if (cpu & kCpuSSE3) {
             s.Append("SSE3 ");
         }
+        if (cpu & kCpuSSSE3) {
+            s.Append("SSSE3 ");
+        }
         if (cpu & kCpuSSE41) {
             s.Append("SSE41 ");
         }
@@ -791,6 +813,12 @@ void InstallCrashHandler(const char* crashDumpPath, const char* crashFilePath, c
     gCrashHandlerAllocator = new HeapAllocator();
     gSymbolsUrl = BuildSymbolsUrl();
 
+    // compact symbol map generated at build time (-gen-symbol-map) and
+    // shipped next to the exe; if present, crash reports symbolize
+    // locally without downloading the .pdb
+    TempStr symMapPath = str::FormatTemp("%s.symmap", GetSelfExePathTemp());
+    dbghelp::LoadSymbolMap(symMapPath);
+
     TempStr path = GetSettingsPathTemp();
     // can be empty on first run but that's fine because then we know it has default values
     ByteSlice prefsData = file::ReadFile(path);
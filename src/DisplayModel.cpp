@@ -57,7 +57,9 @@
 #include "EngineAll.h"
 #include "DisplayModel.h"
 #include "GlobalPrefs.h"
+#include "AppSettings.h"
 #include "SumatraPDF.h"
+#include "Ocr.h"
 #include "PdfSync.h"
 #include "ProgressUpdateUI.h"
 #include "TextSelection.h"
@@ -286,6 +288,7 @@ static int LastPageInARowNo(int pageNo, int columns, bool showCover, int pageCou
 
 // must call SetInitialViewSettings() after creation
 DisplayModel::DisplayModel(EngineBase* engine, DocControllerCallback* cb) : DocController(cb) {
+    InitializeCriticalSection(&pageGeometryAccess);
     this->engine = engine;
     ReportIf(!engine || engine->PageCount() <= 0);
     engineType = engine->kind;
@@ -309,6 +312,13 @@ DisplayModel::DisplayModel(EngineBase* engine, DocControllerCallback* cb) : DocC
     textCache = new DocumentTextCache(engine);
     textSelection = new TextSelection(engine, textCache);
     textSearch = new TextSearch(engine, textCache);
+    // warm up the text cache so that the first search / selection
+    // doesn't have to extract text of all pages on demand. in low-memory
+    // mode text is only extracted for pages actually visited, which caps
+    // the text cache to what the user looked at
+    if (!IsLowMemoryMode()) {
+        textCache->StartBackgroundExtraction();
+    }
 }
 
 DisplayModel::~DisplayModel() {
@@ -320,6 +330,10 @@ DisplayModel::~DisplayModel() {
     delete textSelection;
     delete textCache;
     engine->Release();
+    if (pageGeometry) {
+        pageGeometry->Release();
+    }
+    DeleteCriticalSection(&pageGeometryAccess);
     free(pagesInfo);
 }
 
@@ -331,6 +345,86 @@ PageInfo* DisplayModel::GetPageInfo(int pageNo) const {
     return &(pagesInfo[pageNo - 1]);
 }
 
+PageGeometrySnapshot::~PageGeometrySnapshot() {
+    free(pages);
+}
+
+void PageGeometrySnapshot::AddRef() {
+    refs.Inc();
+}
+
+void PageGeometrySnapshot::Release() {
+    if (0 == refs.Dec()) {
+        delete this;
+    }
+}
+
+bool PageGeometrySnapshot::PageShown(int pageNo) const {
+    if (pageNo < 1 || pageNo > pageCount) {
+        return false;
+    }
+    return pages[pageNo - 1].shown;
+}
+
+bool PageGeometrySnapshot::PageVisible(int pageNo) const {
+    if (pageNo < 1 || pageNo > pageCount) {
+        return false;
+    }
+    return pages[pageNo - 1].visibleRatio > 0.0;
+}
+
+bool PageGeometrySnapshot::PageVisibleNearby(int pageNo) const {
+    int columns = ColumnsFromDisplayMode(displayMode);
+    pageNo = FirstPageInARowNo(pageNo, columns, IsBookView(displayMode));
+    for (int i = pageNo - columns; i < pageNo + 2 * columns; i++) {
+        if (PageVisible(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float PageGeometrySnapshot::GetZoomReal(int pageNo) const {
+    if (pageNo < 1 || pageNo > pageCount) {
+        return kInvalidZoom;
+    }
+    return pages[pageNo - 1].zoomReal;
+}
+
+PageGeometrySnapshot* DisplayModel::AcquirePageGeometry() const {
+    ScopedCritSec scope(&pageGeometryAccess);
+    if (pageGeometry) {
+        pageGeometry->AddRef();
+    }
+    return pageGeometry;
+}
+
+void DisplayModel::PublishPageGeometry() const {
+    int nPages = PageCount();
+    auto snap = new PageGeometrySnapshot();
+    snap->pages = AllocArray<PageGeometrySnapshot::Page>(nPages);
+    snap->pageCount = nPages;
+    snap->rotation = rotation;
+    snap->displayMode = GetDisplayMode();
+    snap->viewPort = viewPort;
+    snap->refs.Set(1);
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        PageGeometrySnapshot::Page& p = snap->pages[pageNo - 1];
+        p.pageOnScreen = pageInfo->pageOnScreen;
+        p.visibleRatio = pageInfo->visibleRatio;
+        p.zoomReal = GetZoomReal(pageNo);
+        p.shown = pageInfo->shown;
+    }
+    EnterCriticalSection(&pageGeometryAccess);
+    PageGeometrySnapshot* old = pageGeometry;
+    pageGeometry = snap;
+    LeaveCriticalSection(&pageGeometryAccess);
+    if (old) {
+        old->Release();
+    }
+}
+
 // Call this before the first Relayout
 void DisplayModel::SetInitialViewSettings(DisplayMode newDisplayMode, int newStartPage, Size viewPort, int screenDPI) {
     totalViewPortSize = viewPort;
@@ -852,6 +946,8 @@ RestartLayout:
     }
 
     canvasSize = Size(std::max(canvasDx, viewPort.dx), std::max(canvasDy, viewPort.dy));
+
+    PublishPageGeometry();
 }
 
 void DisplayModel::ChangeStartPage(int newStartPage) {
@@ -907,6 +1003,8 @@ void DisplayModel::RecalcVisibleParts() const {
         pageInfo->pageOnScreen = pageRect;
         pageInfo->pageOnScreen.Offset(-viewPort.x, -viewPort.y);
     }
+
+    PublishPageGeometry();
 }
 
 int DisplayModel::GetPageNoByPoint(Point pt) const {
@@ -1114,29 +1212,63 @@ void DisplayModel::RenderVisibleParts() {
         return;
     }
 
-    // rendering happens LIFO except if the queue is currently
-    // empty, so request the visible pages first and last to
-    // make sure they're rendered before the predicted pages
+    // the viewport changed: everything queued for the old viewport
+    // (except visible tiles) is now stale and shouldn't be rendered
+    cb->AdvanceRenderGeneration();
+
+    // queue visible pages in ascending order of visible ratio: among
+    // requests of equal priority the render thread picks the most
+    // recently queued one, so the page covering most of the viewport
+    // rasterizes first. In facing and book view the page below the
+    // fold used to be decoded before the one actually on screen
+    Vec<int> visiblePages;
     for (int pageNo = firstVisiblePage; pageNo <= lastVisiblePage; pageNo++) {
-        cb->RequestRendering(pageNo);
+        if (GetPageInfo(pageNo)->visibleRatio > 0.0) {
+            visiblePages.Append(pageNo);
+        }
+    }
+    auto cmpByVisibleRatio = [this](int pageNo1, int pageNo2) {
+        return GetPageInfo(pageNo1)->visibleRatio < GetPageInfo(pageNo2)->visibleRatio;
+    };
+    std::sort(visiblePages.begin(), visiblePages.end(), cmpByVisibleRatio);
+    for (int pageNo : visiblePages) {
+        cb->RequestRendering(pageNo, RenderPriority::Visible);
     }
 
-    if (gPredictiveRender) {
+    // in presentation mode the neighboring slides are always kept
+    // pre-rendered at the current zoom, so that a page turn only blits
+    // an already rasterized bitmap
+    if (inPresentation || (gPredictiveRender && !IsLowMemoryMode())) {
         // prerender two more pages in facing and book view modes
         // if the rendering queue still has place for them
         if (!IsSingle(GetDisplayMode())) {
             if (firstVisiblePage > 2) {
-                cb->RequestRendering(firstVisiblePage - 2);
+                cb->RequestRendering(firstVisiblePage - 2, RenderPriority::Speculative);
             }
             if (lastVisiblePage + 1 < PageCount()) {
-                cb->RequestRendering(lastVisiblePage + 2);
+                cb->RequestRendering(lastVisiblePage + 2, RenderPriority::Speculative);
             }
         }
         if (firstVisiblePage > 1) {
-            cb->RequestRendering(firstVisiblePage - 1);
+            cb->RequestRendering(firstVisiblePage - 1, RenderPriority::Prerender);
         }
         if (lastVisiblePage < PageCount()) {
-            cb->RequestRendering(lastVisiblePage + 1);
+            cb->RequestRendering(lastVisiblePage + 1, RenderPriority::Prerender);
+        }
+
+        // during continuous scrolling schedule more pages in the scroll
+        // direction so that rendering doesn't fall behind the viewport
+        int lookahead = SpeculativeLookaheadPages();
+        if (scrollVelocity > 0) {
+            int last = std::min(lastVisiblePage + lookahead, PageCount());
+            for (int pageNo = lastVisiblePage + 2; pageNo <= last; pageNo++) {
+                cb->RequestRendering(pageNo, RenderPriority::Speculative);
+            }
+        } else if (scrollVelocity < 0) {
+            int first = std::max(firstVisiblePage - lookahead, 1);
+            for (int pageNo = firstVisiblePage - 2; pageNo >= first; pageNo--) {
+                cb->RequestRendering(pageNo, RenderPriority::Speculative);
+            }
         }
     }
 
@@ -1284,6 +1416,12 @@ void DisplayModel::GoToPage(int pageNo, int scrollY, bool addNavPt, int scrollX)
     cb->UpdateScrollbars(canvasSize);
     cb->PageNoChanged(this, pageNo);
     RepaintDisplay();
+
+    if (OcrEnabled()) {
+        // the page being looked at jumps the OCR queue; the worker
+        // skips it if it turns out to have a text layer
+        QueueOcrPage(textCache, pageNo, true);
+    }
 }
 
 void DisplayModel::SetDisplayMode(DisplayMode newDisplayMode, bool keepContinuous) {
@@ -1462,8 +1600,49 @@ void DisplayModel::ScrollXBy(int dx) {
     }
 }
 
+// tracks how fast the user is scrolling so that RenderVisibleParts can
+// size the speculative prerender window. Must be called before viewPort.y
+// is updated to the new offset
+void DisplayModel::UpdateScrollVelocity(int newYOff) {
+    double elapsedMs = TimeSinceInMs(lastScrollTime);
+    int dy = newYOff - lastScrollY;
+    lastScrollY = newYOff;
+    lastScrollTime = TimeGet();
+    if (elapsedMs <= 0 || elapsedMs > 500) {
+        // scrolling just started (or resumed after a pause), no velocity
+        // estimate yet
+        scrollVelocity = 0;
+        return;
+    }
+    // smooth over recent scroll events so that a single jump (e.g. a
+    // scrollbar drag) doesn't look like continuous scrolling
+    double v = (double)dy / elapsedMs;
+    scrollVelocity = 0.7 * scrollVelocity + 0.3 * v;
+}
+
+// how many pages past the visible range are worth prerendering at the
+// current scroll speed: 0 when scrolling slowly or not at all (the
+// regular one page prerender is enough), otherwise between 3 and 8,
+// fewer at high zoom levels where each page occupies several tiles of
+// the bitmap cache
+int DisplayModel::SpeculativeLookaheadPages() const {
+    double pxPerSec = fabs(scrollVelocity) * 1000;
+    if (viewPort.dy <= 0 || pxPerSec < (double)viewPort.dy) {
+        return 0;
+    }
+    // viewport heights per second is roughly pages per second at
+    // fit-width zoom levels
+    double speed = pxPerSec / (double)viewPort.dy;
+    int nPages = limitValue((int)(3 * speed), 3, 8);
+    if (zoomReal > 200.f) {
+        nPages = std::min(nPages, 4);
+    }
+    return nPages;
+}
+
 void DisplayModel::ScrollYTo(int yOff) {
     int currPageNo = CurrentPageNo();
+    UpdateScrollVelocity(yOff);
     viewPort.y = yOff;
     RecalcVisibleParts();
     RenderVisibleParts();
@@ -1522,6 +1701,7 @@ void DisplayModel::ScrollYBy(int dy, bool changePage) {
     }
 
     currPageNo = CurrentPageNo();
+    UpdateScrollVelocity(newYOff);
     viewPort.y = newYOff;
     RecalcVisibleParts();
     RenderVisibleParts();
@@ -50,6 +50,40 @@ struct ScrollState {
     int page = 0;
 };
 
+/* Immutable snapshot of the page geometry that background threads need
+   (render, search, UIA). The UI thread publishes a fresh snapshot after
+   every relayout and scroll (see DisplayModel::PublishPageGeometry), so
+   those threads read consistent geometry without racing against the UI
+   thread mutating pagesInfo and without taking the RenderCache locks. */
+struct PageGeometrySnapshot {
+    struct Page {
+        Rect pageOnScreen;
+        float visibleRatio = 0;
+        float zoomReal = kInvalidZoom;
+        bool shown = false;
+    };
+
+    /* pages[i] describes page i + 1 */
+    Page* pages = nullptr;
+    int pageCount = 0;
+    int rotation = 0;
+    DisplayMode displayMode{DisplayMode::Automatic};
+    Rect viewPort;
+    /* starts at 1 (the DisplayModel's own reference) */
+    AtomicInt refs;
+
+    ~PageGeometrySnapshot();
+
+    bool PageShown(int pageNo) const;
+    bool PageVisible(int pageNo) const;
+    /* same logic as DisplayModel::PageVisibleNearby */
+    bool PageVisibleNearby(int pageNo) const;
+    float GetZoomReal(int pageNo) const;
+
+    void AddRef();
+    void Release();
+};
+
 struct DocumentTextCache;
 struct TextSelection;
 struct TextSearch;
@@ -134,6 +168,12 @@ struct DisplayModel : DocController {
 
     PageInfo* GetPageInfo(int pageNo) const;
 
+    /* takes a reference on the current geometry snapshot (null before
+       the first relayout); the caller must Release() it */
+    PageGeometrySnapshot* AcquirePageGeometry() const;
+    /* builds a new snapshot from pagesInfo and swaps it in */
+    void PublishPageGeometry() const;
+
     /* current rotation selected by user */
     int GetRotation() const;
     float GetZoomReal(int pageNo) const;
@@ -205,6 +245,8 @@ struct DisplayModel : DocController {
     Point GetContentStart(int pageNo) const;
     void RecalcVisibleParts() const;
     void RenderVisibleParts();
+    void UpdateScrollVelocity(int newYOff);
+    int SpeculativeLookaheadPages() const;
     void AddNavPoint();
     RectF GetContentBox(int pageNo) const;
     void CalcZoomReal(float zoomVirtual);
@@ -217,6 +259,12 @@ struct DisplayModel : DocController {
     /* an array of PageInfo, len of array is pageCount */
     PageInfo* pagesInfo = nullptr;
 
+    /* current geometry snapshot for background threads. The critical
+       section only guards the pointer swap resp. the reference bump and
+       is never held while laying out or rendering */
+    mutable PageGeometrySnapshot* pageGeometry = nullptr;
+    mutable CRITICAL_SECTION pageGeometryAccess;
+
     DisplayMode displayMode{DisplayMode::Automatic};
     /* In non-continuous mode is the first page from a file that we're
        displaying.
@@ -232,6 +280,13 @@ struct DisplayModel : DocController {
     /* total size of view port (draw area), including scroll bars */
     Size totalViewPortSize;
 
+    /* estimated vertical scroll speed in pixels per ms (signed, positive
+       when scrolling down). Used to size the speculative prerender
+       window during continuous scrolling */
+    double scrollVelocity = 0;
+    LARGE_INTEGER lastScrollTime{};
+    int lastScrollY = 0;
+
     WindowMargin windowMargin;
     Size pageSpacing;
 
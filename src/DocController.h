@@ -14,6 +14,16 @@ enum class DisplayMode;
 
 using OnBitmapRendered = Func1<RenderedBitmap*>;
 
+// how urgently a requested page render is needed. Visible tiles beat
+// prerendering of adjacent pages which beats speculative prerendering
+// which beats thumbnail-strip rendering
+enum class RenderPriority {
+    Visible = 0,
+    Prerender = 1,
+    Speculative = 2,
+    Thumbnail = 3,
+};
+
 struct ILinkHandler {
     virtual ~ILinkHandler(){};
     virtual DocController* GetDocController() = 0;
@@ -37,7 +47,9 @@ struct DocControllerCallback {
     // DisplayModel //
     virtual void Repaint() = 0;
     virtual void UpdateScrollbars(Size canvas) = 0;
-    virtual void RequestRendering(int pageNo) = 0;
+    virtual void RequestRendering(int pageNo, RenderPriority priority = RenderPriority::Visible) = 0;
+    // a scroll / viewport change makes all queued prerender work stale
+    virtual void AdvanceRenderGeneration() = 0;
     virtual void CleanUp(DisplayModel* dm) = 0;
     virtual void RenderThumbnail(DisplayModel* dm, Size size, const OnBitmapRendered*) = 0;
     // ChmModel //
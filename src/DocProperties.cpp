@@ -59,7 +59,8 @@ char* GetPropValueTemp(const Props& props, const char* name) {
     if (idx < 0) {
         return nullptr;
     }
-    char* v = props.At(idx);
+    // values are stored right after their name
+    char* v = props.At(idx + 1);
     return v;
 }
 
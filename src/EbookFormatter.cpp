@@ -6,6 +6,7 @@
 #include "utils/GdiPlusUtil.h"
 #include "utils/WinUtil.h"
 #include "utils/Archive.h"
+#include "utils/FileUtil.h"
 #include "utils/HtmlParserLookup.h"
 #include "utils/HtmlPullParser.h"
 #include "mui/Mui.h"
@@ -25,7 +26,7 @@
 /* Mobi-specific formatting methods */
 
 MobiFormatter::MobiFormatter(HtmlFormatterArgs* args, MobiDoc* doc) : HtmlFormatter(args), doc(doc) {
-    bool fromBeginning = (0 == args->reparseIdx);
+    bool fromBeginning = (0 == args->reparseIdx) && !args->resumeFrom;
     if (!doc || !fromBeginning) {
         return;
     }
@@ -240,11 +241,25 @@ bool EpubFormatter::IgnoreText() {
     return hiddenDepth > 0 || HtmlFormatter::IgnoreText();
 }
 
+void EpubFormatter::SaveCheckpointState(HtmlFormatterCheckpoint* cp) {
+    cp->pagePath.SetCopy(pagePath);
+    cp->hiddenDepth = hiddenDepth;
+}
+
 /* FictionBook-specific formatting methods */
 
+void Fb2Formatter::SaveCheckpointState(HtmlFormatterCheckpoint* cp) {
+    cp->section = section;
+    cp->titleCount = titleCount;
+}
+
 Fb2Formatter::Fb2Formatter(HtmlFormatterArgs* args, Fb2Doc* doc)
     : HtmlFormatter(args), section(1), fb2Doc(doc), titleCount(0) {
-    if (args->reparseIdx != 0) {
+    if (args->resumeFrom) {
+        section = args->resumeFrom->section;
+        titleCount = args->resumeFrom->titleCount;
+    }
+    if (args->reparseIdx != 0 || args->resumeFrom) {
         return;
     }
     ByteSlice* cover = doc->GetCoverImage();
@@ -30,6 +30,7 @@ class EpubFormatter : public HtmlFormatter {
     bool IgnoreText() override;
 
     void HandleTagSvgImage(HtmlToken* t);
+    void SaveCheckpointState(HtmlFormatterCheckpoint* cp) override;
 
     EpubDoc* epubDoc;
     AutoFreeStr pagePath;
@@ -37,6 +38,10 @@ class EpubFormatter : public HtmlFormatter {
 
   public:
     EpubFormatter(HtmlFormatterArgs* args, EpubDoc* doc) : HtmlFormatter(args), epubDoc(doc), hiddenDepth(0) {
+        if (args->resumeFrom) {
+            pagePath.SetCopy(args->resumeFrom->pagePath);
+            hiddenDepth = args->resumeFrom->hiddenDepth;
+        }
     }
 };
 
@@ -51,6 +56,7 @@ class Fb2Formatter : public HtmlFormatter {
     void HandleTagImg(HtmlToken* t) override;
     void HandleTagAsHtml(HtmlToken* t, const char* name);
     void HandleHtmlTag(HtmlToken* t) override;
+    void SaveCheckpointState(HtmlFormatterCheckpoint* cp) override;
 
     bool IgnoreText() override {
         return false;
@@ -49,6 +49,10 @@ static const char *gSoundIcons = "Speaker\0Mic\0";
 static const char *gStampIcons = "Approved\0AsIs\0Confidential\0Departmental\0Draft\0Experimental\0Expired\0Final\0ForComment\0ForPublicRelease\0NotApproved\0NotForPublicRelease\0Sold\0TopSecret\0";
 static const char *gLineEndingStyles = "None\0Square\0Circle\0Diamond\0OpenArrow\0ClosedArrow\0Butt\0ROpenArrow\0RClosedArrow\0Slash\0";
 static const char* gColors = "Transparent\0Aqua\0Black\0Blue\0Fuchsia\0Gray\0Green\0Lime\0Maroon\0Navy\0Olive\0Orange\0Purple\0Red\0Silver\0Teal\0White\0Yellow\0";
+// the font picker deliberately only offers the standard PDF base fonts
+// every viewer renders without embedding; it never enumerates system
+// fonts, so opening the editor doesn't depend on the size of the
+// machine's font library
 static const char *gFontNames = "Cour\0Helv\0TiRo\0";
 static const char *gFontReadableNames = "Courier\0Helvetica\0TimesRoman\0";
 static const char* gQuaddingNames = "Left\0Center\0Right\0";
@@ -250,6 +254,17 @@ static NO_INLINE EngineMupdf* GetEngineMupdf(EditAnnotationsWindow* ew) {
     return AsEngineMupdf(dm->GetEngine());
 }
 
+// only the page with the edited annotation has to be re-rendered,
+// cached bitmaps of other pages are still valid
+static void RerenderAnnotationPage(EditAnnotationsWindow* ew) {
+    Annotation* annot = ew->tab->selectedAnnotation;
+    if (!annot) {
+        MainWindowRerender(ew->tab->win);
+        return;
+    }
+    MainWindowRerenderPage(ew->tab->win, annot->pageNo);
+}
+
 static void HidePerAnnotControls(EditAnnotationsWindow* ew) {
     ew->staticRect->SetIsVisible(false);
     ew->staticAuthor->SetIsVisible(false);
@@ -560,7 +575,7 @@ static void TextAlignmentSelectionChanged(EditAnnotationsWindow* ew) {
     int newQuadding = idx;
     SetQuadding(ew->tab->selectedAnnotation, newQuadding);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoTextFont(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -584,7 +599,7 @@ static void TextFontSelectionChanged(EditAnnotationsWindow* ew) {
     const char* font = seqstrings::IdxToStr(gFontNames, idx);
     SetDefaultAppearanceTextFont(ew->tab->selectedAnnotation, font);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoTextSize(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -613,7 +628,7 @@ static void TextFontSizeChanging(EditAnnotationsWindow* ew, Trackbar::PositionCh
     TempStr s = str::FormatTemp(_TRA("Text Size: %d"), fontSize);
     ew->staticTextSize->SetText(s);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoTextColor(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -632,7 +647,7 @@ static void TextColorSelectionChanged(EditAnnotationsWindow* ew) {
     auto col = GetDropDownColor(item);
     SetDefaultAppearanceTextColor(ew->tab->selectedAnnotation, col);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoBorder(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -656,7 +671,7 @@ static void BorderWidthChanging(EditAnnotationsWindow* ew, Trackbar::PositionCha
     TempStr s = str::FormatTemp(_TRA("Border: %d"), borderWidth);
     ew->staticBorder->SetText(s);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoLineStartEnd(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -684,7 +699,7 @@ static void LineStartSelectionChanged(EditAnnotationsWindow* ew) {
     int newVal = idx;
     start = newVal;
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void LineEndSelectionChanged(EditAnnotationsWindow* ew) {
@@ -695,7 +710,7 @@ static void LineEndSelectionChanged(EditAnnotationsWindow* ew) {
     int newVal = idx;
     end = newVal;
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoIcon(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -733,7 +748,7 @@ static void IconSelectionChanged(EditAnnotationsWindow* ew) {
     auto item = ew->dropDownIcon->items.At(idx);
     SetIconName(ew->tab->selectedAnnotation, item);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoColor(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -761,7 +776,7 @@ static void ColorSelectionChanged(EditAnnotationsWindow* ew) {
     auto col = GetDropDownColor(item);
     SetColor(ew->tab->selectedAnnotation, col);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoInteriorColor(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -782,7 +797,7 @@ static void InteriorColorSelectionChanged(EditAnnotationsWindow* ew) {
     auto col = GetDropDownColor(item);
     SetInteriorColor(ew->tab->selectedAnnotation, col);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 static void DoOpacity(EditAnnotationsWindow* ew, Annotation* annot) {
@@ -811,7 +826,7 @@ static void OpacityChanging(EditAnnotationsWindow* ew, Trackbar::PositionChangin
     TempStr s = str::FormatTemp(_TRA("Opacity: %d"), opacity);
     ew->staticOpacity->SetText(s);
     EnableSaveIfAnnotationsChanged(ew);
-    MainWindowRerender(ew->tab->win);
+    RerenderAnnotationPage(ew);
 }
 
 // TODO: maybe use ew->tab->selectedAnnotation instead of annot
@@ -960,6 +975,8 @@ void EditAnnotationsWindow::ListBoxSelectionChanged() {
 
 static UINT_PTR gMainWindowRerenderTimer = 0;
 static MainWindow* gMainWindowForRender = nullptr;
+// page to re-render when the timer fires, -1 for all pages
+static int gMainWindowRerenderPageNo = -1;
 
 // TODO: there seems to be a leak
 static void ContentsChanged(EditAnnotationsWindow* ew) {
@@ -978,13 +995,23 @@ static void ContentsChanged(EditAnnotationsWindow* ew) {
         // logf("ContentsChanged: killing existing timer for re-render of MainWindow\n");
         KillTimer(win->hwndCanvas, gMainWindowRerenderTimer);
         gMainWindowRerenderTimer = 0;
+        if (gMainWindowRerenderPageNo != a->pageNo) {
+            // edits to annotations on different pages got coalesced
+            gMainWindowRerenderPageNo = -1;
+        }
+    } else {
+        gMainWindowRerenderPageNo = a->pageNo;
     }
     UINT timeoutInMs = 1000;
     gMainWindowForRender = win;
     gMainWindowRerenderTimer = SetTimer(win->hwndCanvas, 1, timeoutInMs, [](HWND, UINT, UINT_PTR, DWORD) {
         if (IsMainWindowValid(gMainWindowForRender)) {
             // logf("ContentsChanged: re-rendering MainWindow\n");
-            MainWindowRerender(gMainWindowForRender);
+            if (gMainWindowRerenderPageNo > 0) {
+                MainWindowRerenderPage(gMainWindowForRender, gMainWindowRerenderPageNo);
+            } else {
+                MainWindowRerender(gMainWindowForRender);
+            }
         } else {
             // logf("ContentsChanged: NOT re-rendering MainWindow because is not valid anymore\n");
         }
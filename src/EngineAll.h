@@ -26,6 +26,7 @@ EngineBase* CreateEngineHtmlFromFile(const char* fileName);
 EngineBase* CreateEngineTxtFromFile(const char* fileName);
 
 void SetDefaultEbookFont(const char* name, float size);
+void SetEbookPaginationCacheDir(const char* dir);
 void EngineEbookCleanup();
 
 /* EngineImages.cpp */
@@ -49,13 +50,19 @@ bool IsEngineMupdfSupportedFileType(Kind);
 EngineBase* CreateEngineMupdfFromFile(const char* path, Kind kind, int displayDPI, PasswordUI* pwdUI = nullptr);
 EngineBase* CreateEngineMupdfFromStream(IStream* stream, const char* nameHint, PasswordUI* pwdUI = nullptr);
 EngineBase* CreateEngineMupdfFromData(const ByteSlice& data, const char* nameHint, PasswordUI* pwdUI);
+// opens a remote document, reading it on demand with http range requests
+EngineBase* CreateEngineMupdfFromURL(const char* url, PasswordUI* pwdUI = nullptr);
 ByteSlice LoadEmbeddedPDFFile(const char* path);
 const char* ParseEmbeddedStreamNumber(const char* path, int* streamNoOut);
 Annotation* EngineMupdfCreateAnnotation(EngineBase*, int pageNo, PointF pos, AnnotCreateArgs* args);
+bool EnginePageContentUnchanged(EngineBase* oldEngine, EngineBase* newEngine, int pageNo);
+u32 EnginePageContentFingerprint(EngineBase* engine, int pageNo);
+u32 EnginePageContentFingerprintCanFail(EngineBase* engine, int pageNo);
 void EngineMupdfGetAnnotations(EngineBase*, Vec<Annotation*>&);
 bool EngineMupdfHasUnsavedAnnotations(EngineBase*);
 bool EngineMupdfSupportsAnnotations(EngineBase*);
 bool EngineMupdfSaveUpdated(EngineBase* engine, const char* path, const ShowErrorCb& showErrorFunc);
+bool EngineMupdfSaveAsPdf(EngineBase* engine, const char* dstPath);
 Annotation* EngineMupdfGetAnnotationAtPos(EngineBase*, int pageNo, PointF pos, Annotation*);
 ByteSlice EngineMupdfLoadAttachment(EngineBase*, int attachmentNo);
 
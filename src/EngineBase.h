@@ -408,6 +408,15 @@ class EngineBase {
     bool isImageCollection = false;
     bool allowsPrinting = true;
     bool allowsCopyingText = true;
+    // the engine's concurrency contract, so that schedulers don't have
+    // to assume the worst: a "parallel" call is safe without external
+    // locking and makes parallel progress instead of serializing on an
+    // internal lock
+    bool allowsParallelRender = false;
+    bool allowsParallelTextExtraction = false;
+    // Clone() is implemented and normally returns a usable engine
+    // (it can still fail at runtime, e.g. for stream-loaded documents)
+    bool supportsClone = false;
     bool isPasswordProtected = false;
     char* decryptionKey = nullptr;
     bool hasPageLabels = false;
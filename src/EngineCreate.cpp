@@ -3,6 +3,7 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/FileUtil.h"
 #include "utils/WinUtil.h"
 #include "utils/GuessFileType.h"
 #include "utils/Dpi.h"
@@ -142,6 +143,11 @@ static EngineBase* CreateEngineForKind(Kind kind, const char* path, PasswordUI*
 EngineBase* CreateEngineFromFile(const char* path, PasswordUI* pwdUI, bool enableChmEngine) {
     ReportIf(!path);
 
+    if (path::IsHttpUrl(path)) {
+        // remote documents are streamed with http range requests
+        return CreateEngineMupdfFromURL(path, pwdUI);
+    }
+
     // try to open with the engine guess from file name
     // if that fails, try to guess the file type based on content
     Kind kind = GuessFileTypeFromName(path);
@@ -228,11 +228,18 @@ void CleanupEngineDjVu() {
     minilisp_finish();
 }
 
+// number of ddjvu_page_t objects kept alive per engine. A decoded page
+// holds its image layers in memory so don't keep too many around
+#define MAX_DJVU_PAGE_CACHE 4
+
 struct DjVuPageInfo {
     RectF mediabox;
     Vec<IPageElement*> allElements;
     miniexp_t annos{miniexp_dummy};
     bool gotAllElements = false;
+    // non-null if this page's decode job was started; owned by the
+    // cache in EngineDjVu (guarded by gDjVuContext->lock)
+    ddjvu_page_t* ddPage = nullptr;
 };
 
 class EngineDjVu : public EngineBase {
@@ -283,6 +290,11 @@ class EngineDjVu : public EngineBase {
 
     Vec<ddjvu_fileinfo_t> fileInfos;
 
+    // pageNos with a live DjVuPageInfo::ddPage, most recently used
+    // first; guarded by gDjVuContext->lock
+    Vec<int> ddPageLru;
+
+    ddjvu_page_t* GetDjVuPage(int pageNo);
     RenderedBitmap* CreateRenderedBitmap(const char* bmpData, Size size, bool grayscale) const;
     bool ExtractPageText(miniexp_t item, str::WStr& extracted, Vec<Rect>& coords);
     TempStr ResolveNamedDestTemp(const char* name);
@@ -298,6 +310,8 @@ EngineDjVu::EngineDjVu() {
     str::ReplaceWithCopy(&defaultExt, ".djvu");
     // DPI isn't constant for all pages and thus premultiplied
     fileDPI = 300.0f;
+    // all calls serialize on the shared DjVuContext
+    supportsClone = true;
     GetDjVuContext();
 }
 
@@ -311,6 +325,10 @@ EngineDjVu::~EngineDjVu() {
             ddjvu_miniexp_release(doc, pi->annos);
             pi->annos = nullptr;
         }
+        if (pi->ddPage) {
+            ddjvu_page_release(pi->ddPage);
+            pi->ddPage = nullptr;
+        }
     }
     DeleteVecMembers(pages);
 
@@ -559,6 +577,32 @@ RenderedBitmap* EngineDjVu::CreateRenderedBitmap(const char* bmpData, Size size,
     return new RenderedBitmap(hbmp, size, hMap);
 }
 
+// returns the (possibly still decoding) page, starting its decode job
+// if needed. libdjvu decodes in its own worker thread, so a job started
+// here makes progress while the caller does other work.
+// caller must hold gDjVuContext->lock
+ddjvu_page_t* EngineDjVu::GetDjVuPage(int pageNo) {
+    DjVuPageInfo* pi = pages[pageNo - 1];
+    if (pi->ddPage) {
+        ddPageLru.Remove(pageNo);
+        ddPageLru.InsertAt(0, pageNo);
+        return pi->ddPage;
+    }
+    pi->ddPage = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    if (!pi->ddPage) {
+        return nullptr;
+    }
+    ddPageLru.InsertAt(0, pageNo);
+    while (ddPageLru.Size() > MAX_DJVU_PAGE_CACHE) {
+        int evicted = ddPageLru.Pop();
+        DjVuPageInfo* piEvicted = pages[evicted - 1];
+        // releasing cancels the decode job if it's still running
+        ddjvu_page_release(piEvicted->ddPage);
+        piEvicted->ddPage = nullptr;
+    }
+    return pi->ddPage;
+}
+
 RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
     ScopedCritSec scope(&gDjVuContext->lock);
     auto pageRect = args.pageRect;
@@ -570,10 +614,16 @@ RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
     Rect full = Transform(PageMediabox(pageNo), pageNo, zoom, rotation).Round();
     screen = full.Intersect(screen);
 
-    ddjvu_page_t* page = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    ddjvu_page_t* page = GetDjVuPage(pageNo);
     if (!page) {
         return nullptr;
     }
+    // start decoding the next page while we wait for and render this
+    // one; in facing-pages mode the other half of the spread is
+    // requested right after this page and is then mostly done
+    if (pageNo < pageCount) {
+        GetDjVuPage(pageNo + 1);
+    }
     while (!ddjvu_page_decoding_done(page)) {
         gDjVuContext->SpinMessageLoop();
     }
@@ -607,9 +657,9 @@ RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
     ddjvu_format_style_t style = isBitonal ? DDJVU_FORMAT_GREY8 : DDJVU_FORMAT_BGR24;
     ddjvu_format_t* fmt = ddjvu_format_create(style, 0, nullptr);
 
+    // page stays alive in the ddPage cache
     defer {
         ddjvu_format_release(fmt);
-        ddjvu_page_release(page);
     };
 
     int topToBottom = TRUE;
@@ -644,7 +694,7 @@ RectF EngineDjVu::PageContentBox(int pageNo, RenderTarget) {
     ScopedCritSec scope(&gDjVuContext->lock);
 
     RectF pageRc = PageMediabox(pageNo);
-    ddjvu_page_t* page = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    ddjvu_page_t* page = GetDjVuPage(pageNo);
     if (!page) {
         return pageRc;
     }
@@ -662,7 +712,6 @@ RectF EngineDjVu::PageContentBox(int pageNo, RenderTarget) {
 
     defer {
         ddjvu_format_release(fmt);
-        ddjvu_page_release(page);
     };
 
     ddjvu_format_set_row_order(fmt, /* top_to_bottom */ TRUE);
@@ -1162,6 +1211,11 @@ TocTree* EngineDjVu::GetToc() {
         return tocTree;
     }
     ScopedCritSec scope(&gDjVuContext->lock);
+    // re-check under the lock: the command palette may ask for the ToC
+    // from a background thread while the sidebar loads it on the UI one
+    if (tocTree) {
+        return tocTree;
+    }
     int idCounter = 0;
     TocItem* root = BuildTocTree(nullptr, outline, idCounter);
     if (!root) {
@@ -3,8 +3,11 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
-#include "utils/CmdLineArgsIter.h"
+#include "utils/DirIter.h"
 #include "utils/FileUtil.h"
+#include "utils/GuessFileType.h"
+#include "utils/ThreadUtil.h"
+#include "utils/Timer.h"
 #include "utils/GdiPlusUtil.h"
 #include "mui/Mui.h"
 #include "utils/TgaReader.h"
@@ -499,104 +502,313 @@ bool RenderDocument(EngineBase* engine, const char* renderPath, float zoom = 1.f
     return success;
 }
 
-class PasswordHolder : public PasswordUI {
-    const char* password;
+// collects the documents listed in a plain text file, one path per line
+static void CollectFilesFromListFile(const char* listPath, StrVec& files) {
+    ByteSlice d = file::ReadFile(listPath);
+    if (d.empty()) {
+        ErrOut("Error: Couldn't read file list '%s'!", listPath);
+        return;
+    }
+    char* str = (char*)d.data();
+    str::TransCharsInPlace(str, "\r", "\n");
+    Split(&files, str, "\n", true);
+    d.Free();
+}
 
-  public:
-    explicit PasswordHolder(const char* password) : password(password) {
+static void CollectFilesFromDir(const char* dir, StrVec& files) {
+    DirIter di{dir};
+    di.recurse = true;
+    for (DirIterEntry* de : di) {
+        Kind kind = GuessFileType(de->filePath, true);
+        if (IsSupportedFileType(kind, true)) {
+            files.Append(de->filePath);
+        }
     }
-    char* GetPassword(const char*, u8*, __unused u8 decryptionKeyOut[32], bool*) override {
-        return str::Dup(password);
+}
+
+// resolves the <filename> | <dir> | @<file list> arguments shared by
+// the batch modes into a flat list of documents
+static void CollectFilesFromFlags(const Flags& flags, StrVec& files) {
+    for (int i = 0; i < flags.fileNames.Size(); i++) {
+        char* path = flags.fileNames.At(i);
+        if (*path == '@') {
+            // @<path>: a text file listing one document per line
+            CollectFilesFromListFile(path + 1, files);
+        } else if (dir::Exists(path)) {
+            CollectFilesFromDir(path, files);
+        } else {
+            files.Append(path);
+        }
     }
+}
+
+struct EngineDumpBatch {
+    StrVec* files = nullptr;
+    AtomicInt nextFile;
+    AtomicInt nFailed;
+    AtomicInt nPages;
+    // serializes the per-document result lines
+    CRITICAL_SECTION outAccess;
 };
 
-void EngineDump(const Flags& flags) {
-#if 0
-    setlocale(LC_ALL, "C");
-    DisableDataExecution();
-
-    CmdLineArgsIter argList(GetCommandLine());
-    int nArgs = argList.nArgs;
-
-    if (nArgs < 2) {
-    Usage:
-        ErrOut("%s [-pwd <password>][-quick][-render <path-%%d.tga>] <filename>",
-               path::GetBaseNameTemp(argList.args[0]));
-        return 2;
-    }
-
-    char* filePath = nullptr;
-    char* password = nullptr;
-    bool fullDump = true;
-    char* renderPath = nullptr;
-    float renderZoom = 1.f;
-    bool loadOnly = false, silent = false;
-
-    for (int i = 1; i < nArgs; i++) {
-        if (str::Eq(argList.at(i), "-pwd") && i + 1 < nArgs && !password) {
-            password = argList.at(++i);
-        } else if (str::Eq(argList.at(i), "-quick")) {
-            fullDump = false;
-        } else if (str::Eq(argList.at(i), "-render") && i + 1 < nArgs && !renderPath) {
-            // optional zoom argument (e.g. -render 50% file.pdf)
-            float zoom;
-            if (i + 2 < nArgs && str::Parse(argList.at(i + 1), "%f%%%$", &zoom) && zoom > 0.f) {
-                renderZoom = zoom / 100.f;
-                i++;
+// extracts the text of every page of path into out, preceded by a
+// grep-able ">>> file:" header line. out is reused across documents
+// and the utf8 conversion goes through the thread's pool allocator,
+// so steady-state extraction does no per-page allocations on our side
+static bool DumpFullTextOfDocument(const char* path, str::Str& out, EngineDumpBatch* batch) {
+    out.AppendFmt(">>> file: %s\n", path);
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+    if (!engine) {
+        out.Append(">>> error: couldn't create an engine\n");
+        return false;
+    }
+    int nPages = engine->PageCount();
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        ScopedTempAllocMark mark;
+        PageText pt = engine->ExtractPageText(pageNo);
+        if (pt.len > 0) {
+            char* s = ToUtf8Temp(pt.text, (size_t)pt.len);
+            out.Append(s);
+            if (out.Last() != '\n') {
+                out.AppendChar('\n');
             }
-            renderPath = argList.at(++i);
-        } else if (str::Eq(argList.at(i), "-loadonly")) {
-            // -loadonly and -silent are only meant for profiling
-            loadOnly = true;
-        } else if (str::Eq(argList.at(i), "-silent")) {
-            silent = true;
-        } else if (str::Eq(argList.at(i), "-full")) {
-            // -full is for backward compatibility
-            fullDump = true;
-        } else if (!filePath) {
-            filePath = argList.at(i);
-        } else {
-            goto Usage;
         }
+        FreePageText(&pt);
     }
-    if (!filePath) {
-        goto Usage;
+    batch->nPages.Add(nPages);
+    engine->Release();
+    return true;
+}
+
+static void FulltextBatchThread(EngineDumpBatch* batch) {
+    int nFiles = batch->files->Size();
+    str::Str out;
+    for (;;) {
+        int i = batch->nextFile.Inc() - 1;
+        if (i >= nFiles) {
+            return;
+        }
+        char* path = batch->files->At(i);
+        // Clear() keeps the buffer so out stops growing once it has
+        // seen the largest document
+        out.Clear();
+        bool ok = DumpFullTextOfDocument(path, out, batch);
+        if (!ok) {
+            batch->nFailed.Inc();
+        }
+        ScopedCritSec scope(&batch->outAccess);
+        fwrite(out.Get(), 1, out.size(), stdout);
     }
-#endif
+}
+
+// validates a document by loading it and every one of its pages. batch
+// mode emits one result line per document instead of the XML dump as
+// the output of concurrently processed documents would interleave
+static bool ValidateDocument(const char* path, str::Str& out) {
+    auto t = TimeGet();
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+    if (!engine) {
+        out.AppendFmt("error\t%s\tcouldn't create an engine\n", path);
+        return false;
+    }
+    int nPages = engine->PageCount();
+    int nFailedPages = 0;
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        if (!engine->BenchLoadPage(pageNo)) {
+            nFailedPages++;
+        }
+    }
+    engine->Release();
+    if (nFailedPages > 0) {
+        out.AppendFmt("error\t%s\tfailed to load %d of %d pages\n", path, nFailedPages, nPages);
+        return false;
+    }
+    out.AppendFmt("ok\t%s\tpages=%d\ttimeMs=%.2f\n", path, nPages, TimeSinceInMs(t));
+    return true;
+}
+
+static void EngineDumpBatchThread(EngineDumpBatch* batch) {
+    int nFiles = batch->files->Size();
+    for (;;) {
+        int i = batch->nextFile.Inc() - 1;
+        if (i >= nFiles) {
+            return;
+        }
+        char* path = batch->files->At(i);
+        str::Str out;
+        // a document that fails to load or dies in the engine only
+        // takes its own result down, the other workers keep going
+        bool ok = ValidateDocument(path, out);
+        if (!ok) {
+            batch->nFailed.Inc();
+        }
+        ScopedCritSec scope(&batch->outAccess);
+        printf("%s", out.Get());
+    }
+}
+
+void EngineDump(const Flags& flags) {
     if (flags.silent) {
         FILE* nul;
         freopen_s(&nul, "NUL", "w", stdout);
         freopen_s(&nul, "NUL", "w", stderr);
     }
 
-#if 0
     ScopedGdiPlus gdiPlus;
     ScopedMui miniMui;
 
-    WIN32_FIND_DATA fdata;
-    WCHAR* pathW = ToWStrTemp(filePath);
-    HANDLE hfind = FindFirstFileW(pathW, &fdata);
-    // embedded documents are referred to by an invalid path
-    // containing more information after a colon (e.g. "C:\file.pdf:3:0")
-    if (INVALID_HANDLE_VALUE != hfind) {
-        char* dir = path::GetDirTemp(filePath);
-        char* name = ToUtf8Temp(fdata.cFileName);
-        filePath = path::JoinTemp(dir, name);
-        FindClose(hfind);
+    StrVec files;
+    CollectFilesFromFlags(flags, files);
+    if (files.Size() == 0) {
+        ErrOut1("Usage: -engine-dump <filename> | <dir> | @<file list> [-fulltext-fast] [-n <thread count>]");
+        return;
     }
 
-    PasswordHolder pwdUI(password);
-    EngineBase* engine = CreateEngineFromFile(filePath, &pwdUI, false);
-    if (!engine) {
-        ErrOut("Error: Couldn't create an engine for %s!", path::GetBaseNameTemp(filePath));
-        return 1;
+    if (flags.fulltextFast) {
+        // -fulltext-fast: stream the text of all pages of all documents
+        // to stdout on a worker pool (-n sets the pool size); a large
+        // stdout buffer so the text goes out in few big writes
+        setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+        auto t = TimeGet();
+        EngineDumpBatch batch;
+        batch.files = &files;
+        InitializeCriticalSection(&batch.outAccess);
+        int nThreads = limitValue(flags.stressParallelCount, 1, 64);
+        nThreads = std::min(nThreads, files.Size());
+        auto fn = MkFunc0(FulltextBatchThread, &batch);
+        Vec<HANDLE> threads;
+        for (int i = 0; i < nThreads; i++) {
+            HANDLE h = StartThread(fn, "FulltextBatchThread");
+            if (h) {
+                threads.Append(h);
+            }
+        }
+        for (HANDLE h : threads) {
+            WaitForSingleObject(h, INFINITE);
+            CloseHandle(h);
+        }
+        fflush(stdout);
+        DeleteCriticalSection(&batch.outAccess);
+        double ms = TimeSinceInMs(t);
+        int nPages = batch.nPages.Get();
+        ErrOut("Extracted %d pages from %d files on %d threads in %.2f ms, %.0f pages/s, %d failed", nPages,
+               files.Size(), nThreads, ms, (double)nPages * 1000.0 / ms, batch.nFailed.Get());
+        return;
     }
-    if (!loadOnly) {
-        DumpData(engine, fullDump);
+
+    if (files.Size() == 1) {
+        const char* path = files.At(0);
+        EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+        if (!engine) {
+            ErrOut("Error: Couldn't create an engine for %s!", path::GetBaseNameTemp(path));
+            return;
+        }
+        DumpData(engine, true);
+        engine->Release();
+        return;
     }
-    if (renderPath) {
-        RenderDocument(engine, renderPath, renderZoom, flags.silent);
+
+    // batch mode: validate the documents on a bounded pool of worker
+    // threads; -n sets the pool size
+    auto t = TimeGet();
+    EngineDumpBatch batch;
+    batch.files = &files;
+    InitializeCriticalSection(&batch.outAccess);
+    int nThreads = limitValue(flags.stressParallelCount, 1, 64);
+    nThreads = std::min(nThreads, files.Size());
+    auto fn = MkFunc0(EngineDumpBatchThread, &batch);
+    Vec<HANDLE> threads;
+    for (int i = 0; i < nThreads; i++) {
+        HANDLE h = StartThread(fn, "EngineDumpBatchThread");
+        if (h) {
+            threads.Append(h);
+        }
+    }
+    for (HANDLE h : threads) {
+        WaitForSingleObject(h, INFINITE);
+        CloseHandle(h);
+    }
+    DeleteCriticalSection(&batch.outAccess);
+    ErrOut("Processed %d files on %d threads in %.2f ms, %d failed", files.Size(), nThreads, TimeSinceInMs(t),
+           batch.nFailed.Get());
+}
+
+// converts path to a PDF file named <path>.pdf next to the original
+static bool ConvertDocumentToPdf(const char* path, str::Str& out) {
+    auto t = TimeGet();
+    Kind kind = GuessFileType(path, true);
+    if (kind == kindFilePDF) {
+        out.AppendFmt("skip\t%s\talready a pdf\n", path);
+        return true;
+    }
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+    if (!engine) {
+        out.AppendFmt("error\t%s\tcouldn't create an engine\n", path);
+        return false;
     }
+    TempStr dstPath = str::JoinTemp(path, ".pdf");
+    bool ok = EngineMupdfSaveAsPdf(engine, dstPath);
     engine->Release();
-#endif
+    if (!ok) {
+        out.AppendFmt("error\t%s\tconversion not supported for this format\n", path);
+        return false;
+    }
+    out.AppendFmt("ok\t%s\t%s\ttimeMs=%.2f\n", path, dstPath, TimeSinceInMs(t));
+    return true;
+}
+
+static void ConvertBatchThread(EngineDumpBatch* batch) {
+    int nFiles = batch->files->Size();
+    for (;;) {
+        int i = batch->nextFile.Inc() - 1;
+        if (i >= nFiles) {
+            return;
+        }
+        char* path = batch->files->At(i);
+        str::Str out;
+        bool ok = ConvertDocumentToPdf(path, out);
+        if (!ok) {
+            batch->nFailed.Inc();
+        }
+        ScopedCritSec scope(&batch->outAccess);
+        printf("%s", out.Get());
+    }
+}
+
+// -convert-to-pdf: converts the given documents to PDF on a bounded
+// pool of worker threads (-n sets the pool size), each worker owning
+// its engine instance. One process pays mupdf/gdi+/font startup once
+// for the whole batch instead of once per document
+void BatchConvertToPdf(const Flags& flags) {
+    ScopedGdiPlus gdiPlus;
+    ScopedMui miniMui;
+
+    StrVec files;
+    CollectFilesFromFlags(flags, files);
+    if (files.Size() == 0) {
+        ErrOut1("Usage: -convert-to-pdf <filename> | <dir> | @<file list> [-n <thread count>]");
+        return;
+    }
+
+    auto t = TimeGet();
+    EngineDumpBatch batch;
+    batch.files = &files;
+    InitializeCriticalSection(&batch.outAccess);
+    int nThreads = limitValue(flags.stressParallelCount, 1, 64);
+    nThreads = std::min(nThreads, files.Size());
+    auto fn = MkFunc0(ConvertBatchThread, &batch);
+    Vec<HANDLE> threads;
+    for (int i = 0; i < nThreads; i++) {
+        HANDLE h = StartThread(fn, "ConvertBatchThread");
+        if (h) {
+            threads.Append(h);
+        }
+    }
+    for (HANDLE h : threads) {
+        WaitForSingleObject(h, INFINITE);
+        CloseHandle(h);
+    }
+    DeleteCriticalSection(&batch.outAccess);
+    ErrOut("Converted %d files on %d threads in %.2f ms, %d failed", files.Size(), nThreads, TimeSinceInMs(t),
+           batch.nFailed.Get());
 }
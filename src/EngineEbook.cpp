@@ -7,12 +7,14 @@
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/Archive.h"
+#include "utils/CryptoUtil.h"
 #include "utils/Dpi.h"
 #include "utils/FileUtil.h"
 #include "utils/GdiPlusUtil.h"
 #include "utils/HtmlParserLookup.h"
 #include "utils/HtmlPullParser.h"
 #include "mui/Mui.h"
+#include "utils/ThreadUtil.h"
 #include "utils/TrivialHtmlParser.h"
 #include "utils/WinUtil.h"
 #include "utils/ZipUtil.h"
@@ -30,6 +32,8 @@
 #include "HtmlFormatter.h"
 #include "EbookFormatter.h"
 
+#include "utils/Log.h"
+
 Kind kindEngineEpub = "engineEpub";
 Kind kindEngineFb2 = "engineFb2";
 Kind kindEngineMobi = "engineMobi";
@@ -71,6 +75,138 @@ void SetDefaultEbookFont(const char* name, float size) {
     gDefaultFontSize = size * 0.8f;
 }
 
+/* pagination cache: a per-document list of page reparse offsets saved to
+disk, so that reopening a document doesn't have to block on laying out the
+entire book before showing page 1: the page count and page positions are
+known immediately and the draw instructions are re-created by a background
+formatting thread (see EngineEbook::FinishFormatting). The cache is keyed
+on the file's size and modification time plus the layout size and font,
+since any of those changing invalidates the pagination */
+
+static AutoFreeStr gPaginationCacheDir;
+
+// directory where the per-document pagination caches are stored;
+// pagination is not cached as long as this isn't set
+void SetEbookPaginationCacheDir(const char* dir) {
+    gPaginationCacheDir.SetCopy(dir);
+}
+
+constexpr u32 kPaginationCacheMagic = 0x45625067; // 'EbPg'
+constexpr u32 kPaginationCacheVersion = 1;
+
+struct PaginationCacheHeader {
+    u32 magic = kPaginationCacheMagic;
+    u32 version = kPaginationCacheVersion;
+    i64 fileSize = 0;
+    FILETIME fileTime{};
+    float pageDx = 0;
+    float pageDy = 0;
+    float fontSize = 0;
+    u32 fontNameLen = 0; // utf-8 font name follows the header
+    u32 nPages = 0;      // i32 reparse offsets follow the font name
+};
+
+static TempStr PaginationCachePathTemp(const char* filePath) {
+    if (!gPaginationCacheDir.Get() || !filePath) {
+        return nullptr;
+    }
+    // same path fingerprint as GetThumbnailPathTemp() in FileThumbnails.cpp
+    u8 digest[16]{};
+    TempStr path = str::DupTemp(filePath);
+    if (path::HasVariableDriveLetter(path)) {
+        // ignore the drive letter, if it might change
+        path[0] = '?';
+    }
+    CalcMD5Digest((u8*)path, str::Leni(path), digest);
+    AutoFreeStr fingerPrint = str::MemToHex(digest, dimof(digest));
+    return path::JoinTemp(gPaginationCacheDir, str::JoinTemp(fingerPrint, ".pages"));
+}
+
+static void SavePaginationCache(const char* filePath, HtmlFormatterArgs* args, Vec<HtmlPage*>* pages) {
+    TempStr cachePath = PaginationCachePathTemp(filePath);
+    if (!cachePath) {
+        return;
+    }
+    PaginationCacheHeader hdr;
+    hdr.fileSize = file::GetSize(filePath);
+    hdr.fileTime = file::GetModificationTime(filePath);
+    hdr.pageDx = args->pageDx;
+    hdr.pageDy = args->pageDy;
+    hdr.fontSize = args->fontSize;
+    TempStr fontName = ToUtf8Temp(args->GetFontName());
+    hdr.fontNameLen = (u32)str::Len(fontName);
+    hdr.nPages = (u32)pages->size();
+
+    str::Str d;
+    d.Append((const char*)&hdr, sizeof(hdr));
+    d.Append(fontName, hdr.fontNameLen);
+    for (HtmlPage* page : *pages) {
+        i32 reparseIdx = (i32)page->reparseIdx;
+        d.Append((const char*)&reparseIdx, sizeof(reparseIdx));
+    }
+    dir::CreateAll(gPaginationCacheDir);
+    file::WriteFile(cachePath, d.AsByteSlice());
+}
+
+// fills pageBreaks with the cached reparse offset of each page and returns
+// true if a cache exists for the file and still matches it and the layout
+static bool LoadPaginationCache(const char* filePath, HtmlFormatterArgs* args, Vec<int>* pageBreaks) {
+    TempStr cachePath = PaginationCachePathTemp(filePath);
+    if (!cachePath) {
+        return false;
+    }
+    ByteSlice d = file::ReadFile(cachePath);
+    if (d.size() < sizeof(PaginationCacheHeader)) {
+        d.Free();
+        return false;
+    }
+    defer {
+        d.Free();
+    };
+
+    PaginationCacheHeader hdr;
+    memcpy(&hdr, d.data(), sizeof(hdr));
+    if (kPaginationCacheMagic != hdr.magic || kPaginationCacheVersion != hdr.version) {
+        return false;
+    }
+    if (hdr.fileSize != file::GetSize(filePath)) {
+        return false;
+    }
+    FILETIME fileTime = file::GetModificationTime(filePath);
+    if (0 != FileTimeDiffInSecs(fileTime, hdr.fileTime)) {
+        return false;
+    }
+    if (hdr.pageDx != args->pageDx || hdr.pageDy != args->pageDy || hdr.fontSize != args->fontSize) {
+        return false;
+    }
+    TempStr fontName = ToUtf8Temp(args->GetFontName());
+    if (hdr.fontNameLen != (u32)str::Len(fontName)) {
+        return false;
+    }
+    if (0 == hdr.nPages || hdr.nPages > (u32)INT_MAX / sizeof(i32)) {
+        return false;
+    }
+    size_t expectedSize = sizeof(hdr) + hdr.fontNameLen + hdr.nPages * sizeof(i32);
+    if (d.size() != expectedSize) {
+        return false;
+    }
+    const char* data = (const char*)d.data();
+    if (!str::EqN(data + sizeof(hdr), fontName, hdr.fontNameLen)) {
+        return false;
+    }
+
+    const i32* breaks = (const i32*)(data + sizeof(hdr) + hdr.fontNameLen);
+    int htmlLen = (int)args->htmlStr.size();
+    for (u32 i = 0; i < hdr.nPages; i++) {
+        if (breaks[i] < 0 || breaks[i] > htmlLen) {
+            pageBreaks->Reset();
+            return false;
+        }
+        pageBreaks->Append((int)breaks[i]);
+    }
+    return true;
+}
+
 /* common classes for EPUB, FictionBook2, Mobi, PalmDOC, CHM, HTML and TXT engines */
 
 struct PageAnchor {
@@ -129,6 +265,9 @@ class EngineEbook : public EngineBase {
 
     bool BenchLoadPage(int pageNo) override;
 
+    // internal use: body of the background formatting thread
+    void RunFormattingThread();
+
   protected:
     Vec<HtmlPage*>* pages = nullptr;
     Vec<PageAnchor> anchors;
@@ -143,10 +282,32 @@ class EngineEbook : public EngineBase {
     RectF pageRect;
     float pageBorder;
 
+    // background formatting; only used when the pagination came from
+    // the cache (see FinishFormatting)
+    HtmlFormatterArgs* formatterArgs = nullptr;
+    bool formatSkipEmptyPages = false;
+    HANDLE formatThread = nullptr;
+    HANDLE pageFormattedEvent = nullptr;
+    AtomicBool stopFormatting;
+    // both guarded by pagesAccess
+    int nPagesFormatted = 0;
+    bool formattingDone = false;
+
     void GetTransform(Matrix& m, float zoom, int rotation);
     bool ExtractPageAnchors();
     TempStr ExtractFontListTemp();
 
+    // creates the formatter FinishFormatting() lays the document out
+    // with; must be overridden by subclasses that call FinishFormatting()
+    virtual HtmlFormatter* CreateFormatter(HtmlFormatterArgs*) {
+        return nullptr;
+    }
+    bool FinishFormatting(HtmlFormatterArgs* args, bool skipEmptyPages);
+    void WaitForPageFormatted(int pageNo);
+    void WaitForAllFormatted();
+    // must be called before the document data the formatter reads from is freed
+    void JoinFormattingThread();
+
     virtual IPageElement* CreatePageLink(DrawInstr* link, Rect rect, int pageNo);
 
     Vec<DrawInstr>* GetHtmlPage(int pageNo);
@@ -199,10 +360,17 @@ EngineEbook::EngineEbook() {
     pageRect = RectF(0, 0, 5.12f * GetFileDPI(), 7.8f * GetFileDPI());
     pageBorder = 0.4f * GetFileDPI();
     preferredLayout = preferredLayout = PageLayout(PageLayout::Type::Single);
+    // all access serializes on pagesAccess
     InitializeCriticalSection(&pagesAccess);
+    supportsClone = true;
 }
 
 EngineEbook::~EngineEbook() {
+    // subclass destructors join the thread before freeing the document
+    // data it reads from; this is just in case
+    JoinFormattingThread();
+    delete formatterArgs;
+
     EnterCriticalSection(&pagesAccess);
 
     if (pages) {
@@ -300,6 +468,145 @@ bool EngineEbook::ExtractPageAnchors() {
     return true;
 }
 
+void EngineEbook::RunFormattingThread() {
+    HtmlFormatter* formatter = CreateFormatter(formatterArgs);
+    int nProduced = 0;
+    HtmlPage* pd;
+    while ((pd = formatter->Next(formatSkipEmptyPages)) != nullptr) {
+        if (stopFormatting.Get()) {
+            delete pd;
+            break;
+        }
+        {
+            ScopedCritSec scope(&pagesAccess);
+            if (nProduced < pageCount) {
+                // fill in the stub created from the cached pagination; the
+                // HtmlPage pointer must stay stable as clients may hold it
+                HtmlPage* page = pages->at(nProduced);
+                page->instructions = pd->instructions;
+                page->reparseIdx = pd->reparseIdx;
+                nPagesFormatted = nProduced + 1;
+            }
+            nProduced++;
+        }
+        delete pd;
+        SetEvent(pageFormattedEvent);
+    }
+    delete formatter;
+
+    if (!stopFormatting.Get()) {
+        if (nProduced != pageCount) {
+            // the cached pagination doesn't match what the formatter
+            // produced (e.g. the file changed without its size or
+            // modification time changing) - drop the cache so that the
+            // next load formats from scratch again
+            logf("EngineEbook::RunFormattingThread: %d cached pages but %d formatted, deleting stale cache\n",
+                 pageCount, nProduced);
+            file::Delete(PaginationCachePathTemp(FilePath()));
+        }
+        ExtractPageAnchors();
+    }
+
+    ScopedCritSec scope(&pagesAccess);
+    nPagesFormatted = pageCount;
+    formattingDone = true;
+    SetEvent(pageFormattedEvent);
+}
+
+static void BackgroundFormattingThread(EngineEbook* engine) {
+    engine->RunFormattingThread();
+}
+
+// shared tail of the subclasses' FinishLoading(): lays the document out into
+// pages. If a pagination cache from a previous run still matches the file,
+// the layout size and the font, only page stubs with the cached reparse
+// offsets are created here and the draw instructions are filled in by a
+// background formatting thread; otherwise the layout runs synchronously and
+// the resulting pagination is saved for the next time the file is opened.
+// Takes ownership of args (the formatting thread keeps using it)
+bool EngineEbook::FinishFormatting(HtmlFormatterArgs* args, bool skipEmptyPages) {
+    formatterArgs = args;
+    formatSkipEmptyPages = skipEmptyPages;
+
+    const char* path = FilePath();
+    Vec<int> pageBreaks;
+    if (LoadPaginationCache(path, args, &pageBreaks)) {
+        pages = new Vec<HtmlPage*>();
+        for (int reparseIdx : pageBreaks) {
+            pages->Append(new HtmlPage(reparseIdx));
+        }
+        pageCount = (int)pages->size();
+        pageFormattedEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        auto fn = MkFunc0(BackgroundFormattingThread, this);
+        formatThread = StartThread(fn, "EbookFormattingThread");
+        // ExtractPageAnchors runs on the formatting thread once all
+        // pages have been formatted
+        return true;
+    }
+
+    HtmlFormatter* formatter = CreateFormatter(args);
+    ReportIf(!formatter);
+    if (!formatter) {
+        return false;
+    }
+    pages = formatter->FormatAllPages(skipEmptyPages);
+    delete formatter;
+    // must set pageCount before ExtractPageAnchors
+    pageCount = (int)pages->size();
+    if (!ExtractPageAnchors()) {
+        return false;
+    }
+    if (path && pageCount > 0) {
+        SavePaginationCache(path, args, pages);
+    }
+    return pageCount > 0;
+}
+
+// blocks until the background formatting thread (if any) has re-created
+// the draw instructions of pages 1..pageNo
+void EngineEbook::WaitForPageFormatted(int pageNo) {
+    if (!formatThread) {
+        return;
+    }
+    for (;;) {
+        {
+            ScopedCritSec scope(&pagesAccess);
+            if (formattingDone || nPagesFormatted >= pageNo) {
+                return;
+            }
+        }
+        WaitForSingleObject(pageFormattedEvent, 50);
+    }
+}
+
+// blocks until all pages are formatted and the anchors are extracted
+void EngineEbook::WaitForAllFormatted() {
+    if (!formatThread) {
+        return;
+    }
+    for (;;) {
+        {
+            ScopedCritSec scope(&pagesAccess);
+            if (formattingDone) {
+                return;
+            }
+        }
+        WaitForSingleObject(pageFormattedEvent, 50);
+    }
+}
+
+void EngineEbook::JoinFormattingThread() {
+    if (!formatThread) {
+        return;
+    }
+    stopFormatting.Set(true);
+    WaitForSingleObject(formatThread, INFINITE);
+    CloseHandle(formatThread);
+    formatThread = nullptr;
+    CloseHandle(pageFormattedEvent);
+    pageFormattedEvent = nullptr;
+}
+
 RectF EngineEbook::Transform(const RectF& rect, int, float zoom, int rotation, bool inverse) {
     RectF rcF = rect; // TODO: un-needed conversion
     auto p1 = Gdiplus::PointF(rcF.x, rcF.y);
@@ -349,6 +656,7 @@ RenderedBitmap* EngineEbook::RenderPage(RenderPageArgs& args) {
         *args.cookie_out = cookie;
     }
 
+    WaitForPageFormatted(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     mui::ITextRender* textDraw = mui::TextRenderGdiplus::Create(&g);
@@ -374,6 +682,7 @@ static Rect GetInstrBbox(DrawInstr& instr, float pageBorder) {
 
 PageText EngineEbook::ExtractPageText(int pageNo) {
     const WCHAR* lineSep = L"\n";
+    WaitForPageFormatted(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     InterlockedIncrement(&gAllowAllocFailure);
@@ -457,6 +766,8 @@ PageText EngineEbook::ExtractPageText(int pageNo) {
 }
 
 IPageElement* EngineEbook::CreatePageLink(DrawInstr* link, Rect rect, int pageNo) {
+    // resolving the link needs the anchors of all pages
+    WaitForAllFormatted();
     char* url = strconv::FromHtmlUtf8Temp(link->str.s, link->str.len);
     if (url::IsAbsolute(url)) {
         return NewEbookLink(link, rect, nullptr, pageNo);
@@ -478,6 +789,7 @@ IPageElement* EngineEbook::CreatePageLink(DrawInstr* link, Rect rect, int pageNo
 }
 
 Vec<IPageElement*> EngineEbook::GetElements(int pageNo) {
+    WaitForPageFormatted(pageNo);
     HtmlPage* pi = GetHtmlPage2(pageNo);
     if (pi->gotElements) {
         return pi->elements;
@@ -521,6 +833,7 @@ RenderedBitmap* EngineEbook::GetImageForPageElement(IPageElement* iel) {
     PageElementImage* el = (PageElementImage*)iel;
     int pageNo = el->pageNo;
     int idx = el->imageID;
+    WaitForPageFormatted(pageNo);
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     auto&& i = pageInstrs->at(idx);
     ReportIf(i.type != DrawInstrType::Image);
@@ -540,6 +853,7 @@ IPageElement* EngineEbook::GetElementAtPos(int pageNo, PointF pt) {
 }
 
 IPageDestination* EngineEbook::GetNamedDest(const char* name) {
+    WaitForAllFormatted();
     const char* id = name;
     if (str::FindChar(id, '#')) {
         id = str::FindChar(id, '#') + 1;
@@ -591,6 +905,7 @@ IPageDestination* EngineEbook::GetNamedDest(const char* name) {
 }
 
 TempStr EngineEbook::ExtractFontListTemp() {
+    WaitForAllFormatted();
     ScopedCritSec scope(&pagesAccess);
 
     Vec<mui::CachedFont*> seenFonts;
@@ -733,6 +1048,10 @@ class EngineEpub : public EngineEbook {
     bool Load(const char* fileName);
     bool Load(IStream* stream);
     bool FinishLoading();
+
+    HtmlFormatter* CreateFormatter(HtmlFormatterArgs* args) override {
+        return new EpubFormatter(args, doc);
+    }
 };
 
 EngineEpub::EngineEpub() : EngineEbook() {
@@ -741,6 +1060,8 @@ EngineEpub::EngineEpub() : EngineEbook() {
 }
 
 EngineEpub::~EngineEpub() {
+    // the formatting thread reads from doc
+    JoinFormattingThread();
     delete doc;
     delete tocTree;
     if (stream) {
@@ -785,20 +1106,16 @@ bool EngineEpub::FinishLoading() {
         return false;
     }
 
-    HtmlFormatterArgs args{};
-    args.htmlStr = doc->GetHtmlData();
-    args.pageDx = (float)pageRect.dx - 2 * pageBorder;
-    args.pageDy = (float)pageRect.dy - 2 * pageBorder;
-    args.SetFontName(GetDefaultFontName());
-    args.fontSize = GetDefaultFontSize();
-    args.textAllocator = &allocator;
-    args.textRenderMethod = mui::TextRenderMethod::GdiplusQuick;
-
-    pages = EpubFormatter(&args, doc).FormatAllPages(false);
+    auto args = new HtmlFormatterArgs();
+    args->htmlStr = doc->GetHtmlData();
+    args->pageDx = (float)pageRect.dx - 2 * pageBorder;
+    args->pageDy = (float)pageRect.dy - 2 * pageBorder;
+    args->SetFontName(GetDefaultFontName());
+    args->fontSize = GetDefaultFontSize();
+    args->textAllocator = &allocator;
+    args->textRenderMethod = mui::TextRenderMethod::GdiplusQuick;
 
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!FinishFormatting(args, false)) {
         return false;
     }
 
@@ -807,7 +1124,7 @@ bool EngineEpub::FinishLoading() {
         preferredLayout.r2l = true;
     }
 
-    return pageCount > 0;
+    return true;
 }
 
 ByteSlice EngineEpub::GetFileData() {
@@ -1005,6 +1322,8 @@ class EngineMobi : public EngineEbook {
         str::ReplaceWithCopy(&defaultExt, ".mobi");
     }
     ~EngineMobi() override {
+        // the formatting thread reads from doc
+        JoinFormattingThread();
         delete tocTree;
         delete doc;
     }
@@ -1036,6 +1355,10 @@ class EngineMobi : public EngineEbook {
     bool Load(const char* fileName);
     bool Load(IStream* stream);
     bool FinishLoading();
+
+    HtmlFormatter* CreateFormatter(HtmlFormatterArgs* args) override {
+        return new MobiFormatter(args, doc);
+    }
 };
 
 bool EngineMobi::Load(const char* fileName) {
@@ -1054,22 +1377,16 @@ bool EngineMobi::FinishLoading() {
         return false;
     }
 
-    HtmlFormatterArgs args;
-    args.htmlStr = doc->GetHtmlData();
-    args.pageDx = (float)pageRect.dx - 2 * pageBorder;
-    args.pageDy = (float)pageRect.dy - 2 * pageBorder;
-    args.SetFontName(GetDefaultFontName());
-    args.fontSize = GetDefaultFontSize();
-    args.textAllocator = &allocator;
-    args.textRenderMethod = mui::TextRenderMethod::GdiplusQuick;
+    auto args = new HtmlFormatterArgs();
+    args->htmlStr = doc->GetHtmlData();
+    args->pageDx = (float)pageRect.dx - 2 * pageBorder;
+    args->pageDy = (float)pageRect.dy - 2 * pageBorder;
+    args->SetFontName(GetDefaultFontName());
+    args->fontSize = GetDefaultFontSize();
+    args->textAllocator = &allocator;
+    args->textRenderMethod = mui::TextRenderMethod::GdiplusQuick;
 
-    pages = MobiFormatter(&args, doc).FormatAllPages();
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
-        return false;
-    }
-    return pageCount > 0;
+    return FinishFormatting(args, true);
 }
 
 IPageDestination* EngineMobi::GetNamedDest(const char* name) {
@@ -1092,6 +1409,7 @@ IPageDestination* EngineMobi::GetNamedDest(const char* name) {
         return nullptr;
     }
 
+    WaitForPageFormatted(pageNo);
     ScopedCritSec scope(&pagesAccess);
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     // link to the bottom of the page, if filePos points
@@ -1838,4 +2156,5 @@ EngineBase* CreateEngineTxtFromFile(const char* fileName) {
 
 void EngineEbookCleanup() {
     gDefaultFontName.Reset();
+    gPaginationCacheDir.Reset();
 }
@@ -12,6 +12,7 @@
 #include "utils/JsonParser.h"
 #include "utils/WinUtil.h"
 #include "utils/Timer.h"
+#include "utils/ThreadUtil.h"
 #include "utils/DirIter.h"
 
 #include "wingui/UIModels.h"
@@ -52,6 +53,11 @@ Kind kindEngineComicBooks = "engineComicBooks";
 // number of decoded bitmaps to cache for quicker rendering
 #define MAX_IMAGE_PAGE_CACHE 10
 
+// how many upcoming pages the decode threads pre-decode into the page
+// cache after a page was rendered, so that page turns are instant
+#define MAX_IMAGE_PREFETCH_PAGES 3
+#define MAX_IMAGE_DECODE_THREADS 2
+
 ///// EngineImages methods apply to all types of engines handling full-page images /////
 
 struct ImagePage {
@@ -111,6 +117,20 @@ class EngineImages : public EngineBase {
     CRITICAL_SECTION cacheAccess;
     Vec<ImagePage*> pageCache;
     Vec<ImagePageInfo*> pages;
+    // pages currently decoded outside of cacheAccess (by GetPage or a
+    // decode thread); guarded by cacheAccess
+    Vec<int> pagesBeingLoaded;
+    HANDLE pageLoadedEvent = nullptr;
+
+    // prefetch decoding of upcoming pages on background threads
+    CRITICAL_SECTION prefetchAccess;
+    Vec<int> prefetchQueue;
+    HANDLE prefetchSem = nullptr;
+    Vec<HANDLE> decodeThreads;
+    AtomicBool stopDecodeThreads;
+
+    void PrefetchPages(int pageNo);
+    void StopDecodeThreads();
 
     void GetTransform(Matrix& m, int pageNo, float zoom, int rotation);
 
@@ -129,11 +149,89 @@ EngineImages::EngineImages() {
     preferredLayout = PageLayout();
     preferredLayout.nonContinuous = true;
     isImageCollection = true;
+    // decoded pages are handed out under cacheAccess
+    supportsClone = true;
 
     InitializeCriticalSection(&cacheAccess);
+    InitializeCriticalSection(&prefetchAccess);
+    pageLoadedEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+}
+
+static void ImageDecodeThread(EngineImages* e) {
+    for (;;) {
+        WaitForSingleObject(e->prefetchSem, INFINITE);
+        if (e->stopDecodeThreads.Get()) {
+            return;
+        }
+        int pageNo = 0;
+        EnterCriticalSection(&e->prefetchAccess);
+        if (e->prefetchQueue.Size() > 0) {
+            pageNo = e->prefetchQueue.at(0);
+            e->prefetchQueue.RemoveAt(0);
+        }
+        LeaveCriticalSection(&e->prefetchAccess);
+        if (!pageNo) {
+            continue;
+        }
+        // warms pageCache; a no-op if the page is already cached
+        ImagePage* page = e->GetPage(pageNo);
+        if (page) {
+            e->DropPage(page, false);
+        }
+    }
+}
+
+// schedule decoding of the pages following pageNo so that they're
+// already in pageCache when the user turns the page
+void EngineImages::PrefetchPages(int pageNo) {
+    int n = 0;
+    EnterCriticalSection(&prefetchAccess);
+    if (!prefetchSem) {
+        prefetchSem = CreateSemaphoreW(nullptr, 0, 1 << 20, nullptr);
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, MAX_IMAGE_DECODE_THREADS);
+        for (int i = 0; i < nThreads; i++) {
+            auto fn = MkFunc0(ImageDecodeThread, this);
+            HANDLE hThread = StartThread(fn, "ImageDecodeThread");
+            if (hThread) {
+                SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);
+                decodeThreads.Append(hThread);
+            }
+        }
+    }
+    prefetchQueue.Reset();
+    for (int i = 1; i <= MAX_IMAGE_PREFETCH_PAGES; i++) {
+        if (pageNo + i > pageCount) {
+            break;
+        }
+        prefetchQueue.Append(pageNo + i);
+        n++;
+    }
+    LeaveCriticalSection(&prefetchAccess);
+    if (n > 0 && decodeThreads.Size() > 0) {
+        ReleaseSemaphore(prefetchSem, n, nullptr);
+    }
+}
+
+void EngineImages::StopDecodeThreads() {
+    if (decodeThreads.Size() > 0) {
+        stopDecodeThreads.Set(true);
+        ReleaseSemaphore(prefetchSem, decodeThreads.Size(), nullptr);
+        for (HANDLE hThread : decodeThreads) {
+            WaitForSingleObject(hThread, INFINITE);
+            CloseHandle(hThread);
+        }
+        decodeThreads.Reset();
+    }
+    if (prefetchSem) {
+        CloseHandle(prefetchSem);
+        prefetchSem = nullptr;
+    }
 }
 
 EngineImages::~EngineImages() {
+    StopDecodeThreads();
     EnterCriticalSection(&cacheAccess);
     while (pageCache.size() > 0) {
         ImagePage* lastPage = pageCache.Last();
@@ -143,6 +241,8 @@ EngineImages::~EngineImages() {
     DeleteVecMembers(pages);
     LeaveCriticalSection(&cacheAccess);
     DeleteCriticalSection(&cacheAccess);
+    DeleteCriticalSection(&prefetchAccess);
+    CloseHandle(pageLoadedEvent);
 }
 
 RectF EngineImages::PageMediabox(int pageNo) {
@@ -167,6 +267,13 @@ RenderedBitmap* EngineImages::RenderPage(RenderPageArgs& args) {
     if (!page) {
         return nullptr;
     }
+    // decode the next few pages in the background while this one is
+    // being drawn. Not for single-file engines: extracting frames of
+    // multi-page TIFFs touches the shared Gdiplus::Bitmap, which isn't
+    // thread-safe
+    if (pageCount > 1 && kind != kindEngineImage) {
+        PrefetchPages(pageNo);
+    }
 
     auto timeStart = TimeGet();
     defer {
@@ -322,43 +429,62 @@ bool EngineImages::SaveFileAs(const char* dstPath) {
 }
 
 ImagePage* EngineImages::GetPage(int pageNo, bool tryOnly) {
-    ScopedCritSec scope(&cacheAccess);
+    EnterCriticalSection(&cacheAccess);
 
     ImagePage* result = nullptr;
 
-    for (size_t i = 0; i < pageCache.size(); i++) {
-        if (pageCache.at(i)->pageNo == pageNo) {
-            result = pageCache.at(i);
+    for (;;) {
+        for (size_t i = 0; i < pageCache.size(); i++) {
+            if (pageCache.at(i)->pageNo == pageNo) {
+                result = pageCache.at(i);
+                break;
+            }
+        }
+        if (result || tryOnly) {
             break;
         }
+        if (!pagesBeingLoaded.Contains(pageNo)) {
+            break;
+        }
+        // another thread is already decoding this page; wait for it
+        LeaveCriticalSection(&cacheAccess);
+        WaitForSingleObject(pageLoadedEvent, 50);
+        EnterCriticalSection(&cacheAccess);
     }
     if (!result && tryOnly) {
+        LeaveCriticalSection(&cacheAccess);
         return nullptr;
     }
 
     if (!result) {
+        // decode outside of cacheAccess so that other threads can get
+        // cached pages (or decode other pages) in the meantime
+        pagesBeingLoaded.Append(pageNo);
+        LeaveCriticalSection(&cacheAccess);
+        bool ownBmp = true;
+        Bitmap* bmp = LoadBitmapForPage(pageNo, ownBmp);
+        EnterCriticalSection(&cacheAccess);
+        pagesBeingLoaded.Remove(pageNo);
         // TODO: drop most memory intensive pages first
-        if (pageCache.size() >= MAX_IMAGE_PAGE_CACHE) {
-            ReportIf(pageCache.size() != MAX_IMAGE_PAGE_CACHE);
+        while (pageCache.size() >= MAX_IMAGE_PAGE_CACHE) {
             DropPage(pageCache.Last(), true);
         }
-        result = new ImagePage(pageNo, nullptr);
-        result->bmp = LoadBitmapForPage(pageNo, result->ownBmp);
+        result = new ImagePage(pageNo, bmp);
+        result->ownBmp = ownBmp;
         pageCache.InsertAt(0, result);
+        SetEvent(pageLoadedEvent);
     } else if (result != pageCache.at(0)) {
         // keep the list Most Recently Used first
         pageCache.Remove(result);
         pageCache.InsertAt(0, result);
     }
     // return nullptr if a page failed to load
-    if (result && !result->bmp) {
-        return nullptr;
+    if (!result->bmp) {
+        result = nullptr;
+    } else {
+        result->refs++;
     }
-    if (!result) {
-        return nullptr;
-    }
-
-    result->refs++;
+    LeaveCriticalSection(&cacheAccess);
     return result;
 }
 
@@ -519,6 +645,9 @@ EngineImage::EngineImage() {
 }
 
 EngineImage::~EngineImage() {
+    // decode threads use LoadBitmapForPage which reads members of
+    // this class, so they must be gone before we start freeing them
+    StopDecodeThreads();
     delete image;
 }
 
@@ -806,6 +935,8 @@ class EngineImageDir : public EngineImages {
     }
 
     ~EngineImageDir() override {
+        // decode threads use LoadBitmapForPage (reads pageFileNames)
+        StopDecodeThreads();
         delete tocTree;
     }
 
@@ -1120,7 +1251,10 @@ class EngineCbx : public EngineImages {
 
     ByteSlice GetImageData(int pageNo);
 
-    // access to cbxFile must be protected after initialization (with cacheAccess)
+    // access to cbxFile must be protected after initialization (with
+    // archiveAccess: extraction seeks inside the shared archive stream
+    // and pages are decoded on multiple threads)
+    CRITICAL_SECTION archiveAccess;
     MultiFormatArchive* cbxFile = nullptr;
     Vec<MultiFormatArchive::FileInfo*> files;
     TocTree* tocTree = nullptr;
@@ -1131,12 +1265,20 @@ class EngineCbx : public EngineImages {
 // TODO: refactor so that doesn't have to keep <arch>
 EngineCbx::EngineCbx(MultiFormatArchive* arch) {
     cbxFile = arch;
+    // pages are read mostly in order so let the archive uncompress
+    // the next entry while we decode the current one
+    cbxFile->prefetchNextEntry = true;
     kind = kindEngineComicBooks;
+    InitializeCriticalSection(&archiveAccess);
 }
 
 EngineCbx::~EngineCbx() {
+    // decode threads use LoadBitmapForPage which reads from cbxFile,
+    // so they must be gone before it's deleted
+    StopDecodeThreads();
     delete tocTree;
     delete cbxFile;
+    DeleteCriticalSection(&archiveAccess);
 }
 
 EngineBase* EngineCbx::Clone() {
@@ -1295,6 +1437,9 @@ TocTree* EngineCbx::GetToc() {
 ByteSlice EngineCbx::GetImageData(int pageNo) {
     ReportIf((pageNo < 1) || (pageNo > PageCount()));
     size_t fileId = files[pageNo - 1]->fileId;
+    // serialize extraction; the actual image decode happens outside of
+    // this lock and does run in parallel
+    ScopedCritSec scope(&archiveAccess);
     ByteSlice d = cbxFile->GetFileDataById(fileId);
     return d;
 }
@@ -10,16 +10,20 @@ extern "C" {
 
 #include "utils/BaseUtil.h"
 #include "utils/Archive.h"
+#include "utils/Dict.h"
 #include "utils/ScopedWin.h"
 #include "utils/FileUtil.h"
 #include "utils/GdiPlusUtil.h"
 #include "utils/GuessFileType.h"
 #include "utils/HtmlParserLookup.h"
 #include "utils/HtmlPullParser.h"
+#include "utils/HttpUtil.h"
+#include "utils/ThreadUtil.h"
 #include "utils/TrivialHtmlParser.h"
 #include "utils/WinUtil.h"
 #include "utils/ZipUtil.h"
 #include "utils/Timer.h"
+#include "utils/PerfTrace.h"
 
 #include "wingui/UIModels.h"
 
@@ -401,6 +405,123 @@ static fz_stream* FzOpenIStream(fz_context* ctx, IStream* stream) {
     return stm;
 }
 
+// remote documents are read with http range requests in fixed-size
+// chunks so that the first page shows after transferring only a small
+// part of the file; fetched chunks are kept for the stream's lifetime
+constexpr i64 kHttpChunkSize = 64 * 1024;
+// on sequential reads fetch several chunks with one request to
+// amortize the per-request overhead
+constexpr int kHttpMaxReadAheadChunks = 4;
+
+struct http_stream_filter {
+    HttpRangeReader* reader;
+    i64 size;
+    u8** chunks; // chunk i covers bytes [i * kHttpChunkSize, ...), fetched lazily
+    int nChunks;
+    i64 lastReadEnd; // to detect sequential reads
+    u8 empty[1];
+};
+
+static bool HttpStreamFetchChunks(http_stream_filter* state, int chunkNo, int nFetch) {
+    i64 off = (i64)chunkNo * kHttpChunkSize;
+    i64 count = std::min((i64)nFetch * kHttpChunkSize, state->size - off);
+    u8* buf = AllocArray<u8>((size_t)count);
+    if (!buf) {
+        return false;
+    }
+    int nRead = state->reader->Read(off, buf, (int)count);
+    if ((i64)nRead != count) {
+        free(buf);
+        return false;
+    }
+    for (int i = 0; i < nFetch; i++) {
+        i64 chunkOff = (i64)i * kHttpChunkSize;
+        if (chunkOff >= count) {
+            break;
+        }
+        size_t chunkSize = (size_t)std::min(kHttpChunkSize, count - chunkOff);
+        u8* chunk = (u8*)memdup(buf + chunkOff, chunkSize);
+        if (!chunk) {
+            free(buf);
+            return false;
+        }
+        state->chunks[chunkNo + i] = chunk;
+    }
+    free(buf);
+    return true;
+}
+
+extern "C" int next_http_stream(fz_context* ctx, fz_stream* stm, size_t) {
+    http_stream_filter* state = (http_stream_filter*)stm->state;
+    i64 pos = stm->pos;
+    if (pos >= state->size) {
+        return EOF;
+    }
+    int chunkNo = (int)(pos / kHttpChunkSize);
+    if (!state->chunks[chunkNo]) {
+        int nFetch = 1;
+        if (pos == state->lastReadEnd) {
+            // sequential access: read ahead
+            while (nFetch < kHttpMaxReadAheadChunks && chunkNo + nFetch < state->nChunks &&
+                   !state->chunks[chunkNo + nFetch]) {
+                nFetch++;
+            }
+        }
+        if (!HttpStreamFetchChunks(state, chunkNo, nFetch)) {
+            fz_throw(ctx, FZ_ERROR_GENERIC, "http read error at offset %d", (int)pos);
+        }
+    }
+    i64 chunkStart = (i64)chunkNo * kHttpChunkSize;
+    i64 chunkEnd = std::min(chunkStart + kHttpChunkSize, state->size);
+    u8* chunk = state->chunks[chunkNo];
+    stm->rp = chunk + (pos - chunkStart);
+    stm->wp = chunk + (chunkEnd - chunkStart);
+    stm->pos = chunkEnd;
+    state->lastReadEnd = chunkEnd;
+    return *stm->rp++;
+}
+
+extern "C" void seek_http_stream(fz_context* ctx, fz_stream* stm, i64 offset, int whence) {
+    http_stream_filter* state = (http_stream_filter*)stm->state;
+    i64 pos = offset;
+    if (whence == SEEK_END) {
+        pos = state->size + offset;
+    }
+    if (pos < 0 || pos > state->size) {
+        fz_throw(ctx, FZ_ERROR_GENERIC, "http stream seek out of range");
+    }
+    stm->pos = pos;
+    stm->rp = stm->wp = state->empty;
+}
+
+extern "C" void drop_http_stream(fz_context* ctx, void* state_) {
+    http_stream_filter* state = (http_stream_filter*)state_;
+    for (int i = 0; i < state->nChunks; i++) {
+        free(state->chunks[i]);
+    }
+    free(state->chunks);
+    delete state->reader;
+    fz_free(ctx, state);
+}
+
+// takes ownership of reader on success
+static fz_stream* FzOpenHttpStream(fz_context* ctx, HttpRangeReader* reader) {
+    if (reader->fileSize > INT_MAX) {
+        // same limit as seek_istream above
+        fz_throw(ctx, FZ_ERROR_GENERIC, "documents beyond 2GB aren't supported");
+    }
+    http_stream_filter* state = fz_malloc_struct(ctx, http_stream_filter);
+    state->reader = reader;
+    state->size = reader->fileSize;
+    state->nChunks = (int)((state->size + kHttpChunkSize - 1) / kHttpChunkSize);
+    state->chunks = AllocArray<u8*>(state->nChunks);
+    state->lastReadEnd = 0;
+
+    fz_stream* stm = fz_new_stream(ctx, state, next_http_stream, drop_http_stream);
+    stm->seek = seek_http_stream;
+    return stm;
+}
+
 static void* FzMemdup(fz_context* ctx, void* p, size_t size) {
     void* res = fz_malloc_no_throw(ctx, size);
     if (!res) {
@@ -410,7 +531,7 @@ static void* FzMemdup(fz_context* ctx, void* p, size_t size) {
     return res;
 }
 
-static fz_stream* FzOpenFile2(fz_context* ctx, const char* path) {
+static fz_stream* FzOpenFile2(fz_context* ctx, const char* path, file::FileMap* fileMap, fz_buffer** bufOut) {
     fz_stream* stm = nullptr;
     i64 fileSize = file::GetSize(path);
     // load small files entirely into memory so that they can be
@@ -446,9 +567,34 @@ static fz_stream* FzOpenFile2(fz_context* ctx, const char* path) {
             stm = nullptr;
             fz_report_error(ctx);
         }
+        if (stm && bufOut) {
+            // the stream still holds a reference, so buf is alive; the
+            // caller keeps its own so that clones can re-parse the same
+            // bytes without re-reading the file (see LoadFromSharedData)
+            *bufOut = fz_keep_buffer(ctx, buf);
+        }
         return stm;
     }
 
+    // map large files instead of going through buffered file reads:
+    // the frequent seeks of xref parsing become page faults served from
+    // the OS file cache and a 1 GB scan isn't read up front or copied.
+    // The mapping is kept in the engine and outlives all mupdf objects
+    // that may read from it (see ~EngineMupdf)
+    if (fileMap && file::MapFile(path, fileMap)) {
+        fz_try(ctx) {
+            stm = fz_open_memory(ctx, fileMap->data, (size_t)fileMap->size);
+        }
+        fz_catch(ctx) {
+            stm = nullptr;
+            fz_report_error(ctx);
+        }
+        if (stm) {
+            return stm;
+        }
+        file::UnmapFile(fileMap);
+    }
+
     WCHAR* pathW = ToWStrTemp(path);
     fz_try(ctx) {
         stm = fz_open_file_w(ctx, pathW);
@@ -1494,13 +1640,13 @@ struct PageTreeStackItem {
 };
 
 static void fz_lock_context_cs(void* user, int lock) {
-    EngineMupdf* e = (EngineMupdf*)user;
-    EnterCriticalSection(&e->mutexes[lock]);
+    CRITICAL_SECTION* mutexes = (CRITICAL_SECTION*)user;
+    EnterCriticalSection(&mutexes[lock]);
 }
 
 static void fz_unlock_context_cs(void* user, int lock) {
-    EngineMupdf* e = (EngineMupdf*)user;
-    LeaveCriticalSection(&e->mutexes[lock]);
+    CRITICAL_SECTION* mutexes = (CRITICAL_SECTION*)user;
+    LeaveCriticalSection(&mutexes[lock]);
 }
 
 static void fz_print_cb(void* user, const char* msg) {
@@ -1524,10 +1670,51 @@ struct ContextThreadID {
 static Vec<ContextThreadID>* gPerThreadContexts;
 static CRITICAL_SECTION gPerThreadContextsCs;
 
-void InitializeEngineMupdf() {
-    ReportIf(gPerThreadContexts);
+// the root context every engine clones from. Clones share the store
+// and the font / colorspace / glyph caches (see fz_clone_context), so
+// 20 tabs of documents embedding the same fonts keep a single parsed
+// copy instead of 20 and FZ_STORE_DEFAULT caps total, not per-tab,
+// cache memory
+static fz_context* gRootCtx = nullptr;
+static CRITICAL_SECTION gRootCtxMutexes[FZ_LOCK_MAX];
+static fz_locks_context gRootCtxLocks;
+// 0: not initialized, 1: initialization in progress, 2: done
+static LONG gRootCtxState = 0;
+
+// engines get created from many threads (including in the previewer
+// and ifilter dlls) so the one-time init must be race-free
+static fz_context* GetMupdfRootContext() {
+    for (;;) {
+        LONG state = InterlockedCompareExchange(&gRootCtxState, 1, 0);
+        if (state == 0) {
+            break; // we won the race and do the initialization
+        }
+        if (state == 2) {
+            return gRootCtx;
+        }
+        Sleep(0); // another thread is initializing
+    }
+    for (size_t i = 0; i < dimof(gRootCtxMutexes); i++) {
+        InitializeCriticalSection(&gRootCtxMutexes[i]);
+    }
+    gRootCtxLocks.user = gRootCtxMutexes;
+    gRootCtxLocks.lock = fz_lock_context_cs;
+    gRootCtxLocks.unlock = fz_unlock_context_cs;
+    extern fz_alloc_context fz_alloc_ctx_counting; // in FzImgReader.cpp
+    gRootCtx = fz_new_context(&fz_alloc_ctx_counting, &gRootCtxLocks, FZ_STORE_DEFAULT);
+    InstallFitzErrorCallbacks(gRootCtx);
+    install_load_windows_font_funcs(gRootCtx);
+    fz_register_document_handlers(gRootCtx);
+
     InitializeCriticalSection(&gPerThreadContextsCs);
     gPerThreadContexts = new Vec<ContextThreadID>();
+
+    InterlockedExchange(&gRootCtxState, 2);
+    return gRootCtx;
+}
+
+void InitializeEngineMupdf() {
+    GetMupdfRootContext();
 }
 
 fz_context* GetOrClonePerThreadContext(EngineMupdf* engine, fz_context* ctx) {
@@ -1559,32 +1746,60 @@ void ReleasePerThreadContext(EngineMupdf* engine) {
     }
 }
 
+// drops the cloned contexts of all threads; only call when no other
+// thread can be using the engine anymore (i.e. from the destructor)
+static void DropPerThreadContexts(EngineMupdf* engine) {
+    ScopedCritSec cs(&gPerThreadContextsCs);
+    auto n = gPerThreadContexts->Size();
+    for (int i = n - 1; i >= 0; i--) {
+        auto& el = gPerThreadContexts->at(i);
+        if (el.engine == engine) {
+            fz_drop_context(el.ctx);
+            gPerThreadContexts->RemoveAtFast(i);
+        }
+    }
+}
+
 EngineMupdf::EngineMupdf() {
     kind = kindEngineMupdf;
     defaultExt = str::Dup(".pdf");
     fileDPI = 72.0f;
-
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        InitializeCriticalSection(&mutexes[i]);
-    }
+    // pages are rasterized from display lists on per-thread contexts,
+    // so concurrent RenderPage() calls genuinely run in parallel; text
+    // extraction still serializes on ctxAccess
+    allowsParallelRender = true;
+    supportsClone = true;
+    creationThreadId = GetCurrentThreadId();
+
+    InitializeCriticalSection(&docAccess);
     InitializeCriticalSection(&pagesAccess);
-    ctxAccess = &mutexes[FZ_LOCK_ALLOC];
+    ctxAccess = &docAccess;
 
-    fz_locks_ctx.user = this;
-    fz_locks_ctx.lock = fz_lock_context_cs;
-    fz_locks_ctx.unlock = fz_unlock_context_cs;
-    _ctx = fz_new_context(nullptr, &fz_locks_ctx, FZ_STORE_DEFAULT);
+    // fz allocation locks are process-wide (they protect the shared
+    // store), so document access gets its own, per-engine lock
+    _ctx = fz_clone_context(GetMupdfRootContext());
+    // error callbacks are per-clone (fz_clone_context resets them)
     InstallFitzErrorCallbacks(_ctx);
-
-    install_load_windows_font_funcs(_ctx);
-    fz_register_document_handlers(_ctx);
 }
 
 fz_context* EngineMupdf::Ctx() const {
     return _ctx;
 }
 
+// a clone of _ctx private to the calling thread. Clones share the store
+// and glyph caches of _ctx (protected by the process-wide fz locks) but
+// have their own exception stack, so multiple threads can e.g.
+// rasterize display lists concurrently without holding ctxAccess
+fz_context* EngineMupdf::CtxForThread() {
+    if (GetCurrentThreadId() == creationThreadId) {
+        return _ctx;
+    }
+    return GetOrClonePerThreadContext(this, _ctx);
+}
+
 EngineMupdf::~EngineMupdf() {
+    StopPageInfoPreload();
+    StopMediaboxResolve();
     EnterCriticalSection(&pagesAccess);
 
     auto ctx = Ctx();
@@ -1596,6 +1811,9 @@ EngineMupdf::~EngineMupdf() {
         if (pi->retainedLinks) {
             fz_drop_link(ctx, pi->retainedLinks);
         }
+        if (pi->displayList) {
+            fz_drop_display_list(ctx, pi->displayList);
+        }
         if (pi->page) {
             fz_drop_page(ctx, pi->page);
         }
@@ -1613,17 +1831,25 @@ EngineMupdf::~EngineMupdf() {
     }
 
     fz_drop_document(ctx, _doc);
+    fz_drop_buffer(ctx, docBuf);
+    DropPerThreadContexts(this);
     fz_drop_context(ctx);
 
+    // now that no mupdf object can read from it anymore; the mapping
+    // is shared with clones, the last engine using it unmaps it
+    if (docMap && docMap->refs.Dec()) {
+        file::UnmapFile(&docMap->map);
+        delete docMap;
+    }
+
     delete pageLabels;
+    delete pageLabelIndex;
     delete tocTree;
     DeleteVecMembers(pages);
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        DeleteCriticalSection(&mutexes[i]);
-    }
     LeaveCriticalSection(&pagesAccess);
     DeleteCriticalSection(&pagesAccess);
+    DeleteCriticalSection(&docAccess);
 }
 
 class PasswordCloner : public PasswordUI {
@@ -1657,7 +1883,17 @@ EngineBase* EngineMupdf::Clone() {
     }
 
     EngineMupdf* clone = new EngineMupdf();
-    bool ok = clone->Load(FilePath(), pwdUI);
+    bool ok;
+    if (path::IsHttpUrl(FilePath())) {
+        ok = clone->LoadFromURL(FilePath(), pwdUI);
+        if (ok) {
+            clone->SetFilePath(FilePath());
+        }
+    } else if (docMap || docBuf) {
+        ok = clone->LoadFromSharedData(this, pwdUI);
+    } else {
+        ok = clone->Load(FilePath(), pwdUI);
+    }
     if (!ok) {
         delete clone;
         delete pwdUI;
@@ -1851,13 +2087,20 @@ bool EngineMupdf::Load(const char* path, PasswordUI* pwdUI) {
     fz_stream* file = nullptr;
 
     fz_var(file);
+    docMap = new SharedFileMap();
     fz_try(ctx) {
-        file = FzOpenFile2(ctx, fnCopy);
+        file = FzOpenFile2(ctx, fnCopy, &docMap->map, &docBuf);
     }
     fz_catch(ctx) {
         fz_report_error(ctx);
         file = nullptr;
     }
+    docLoadedToMemory = docBuf != nullptr;
+    if (!docMap->map.data) {
+        // small file, read to memory instead of mapped
+        delete docMap;
+        docMap = nullptr;
+    }
 
     if (!LoadFromStream(file, FilePath(), pwdUI)) {
         return false;
@@ -1867,6 +2110,15 @@ bool EngineMupdf::Load(const char* path, PasswordUI* pwdUI) {
         return FinishLoading();
     }
 
+    return LoadEmbeddedStream(streamNo, pwdUI);
+}
+
+// replaces the just loaded document with the embedded PDF document
+// in stream number streamNo (see ParseEmbeddedStreamNumber)
+bool EngineMupdf::LoadEmbeddedStream(int streamNo, PasswordUI* pwdUI) {
+    auto ctx = Ctx();
+    fz_stream* file = nullptr;
+
     pdfdoc = pdf_specifics(ctx, _doc);
     if (pdfdoc) {
         if (!pdf_obj_num_is_stream(ctx, pdfdoc, streamNo)) {
@@ -1875,6 +2127,7 @@ bool EngineMupdf::Load(const char* path, PasswordUI* pwdUI) {
 
         fz_buffer* buffer = nullptr;
         fz_var(buffer);
+        fz_var(file);
         fz_try(ctx) {
             buffer = pdf_load_stream_number(ctx, pdfdoc, streamNo);
             file = fz_open_buffer(ctx, buffer);
@@ -1898,6 +2151,58 @@ bool EngineMupdf::Load(const char* path, PasswordUI* pwdUI) {
     return FinishLoading();
 }
 
+// used by Clone(): parses a new document from the source engine's
+// in-memory file data (its shared mapping or its read-to-memory
+// buffer) instead of re-reading the file from disk
+bool EngineMupdf::LoadFromSharedData(EngineMupdf* src, PasswordUI* pwdUI) {
+    auto ctx = Ctx();
+    ReportIf(FilePath() || _doc || !ctx);
+    const char* path = src->FilePath();
+    SetFilePath(path);
+
+    auto ext = path::GetExtTemp(path);
+    str::ReplaceWithCopy(&defaultExt, ext);
+
+    int streamNo = -1;
+    AutoFreeStr fnCopy = ParseEmbeddedStreamNumber(path, &streamNo);
+
+    fz_stream* file = nullptr;
+    fz_var(file);
+    if (src->docMap) {
+        src->docMap->refs.Add();
+        docMap = src->docMap;
+        fz_try(ctx) {
+            file = fz_open_memory(ctx, docMap->map.data, (size_t)docMap->map.size);
+        }
+        fz_catch(ctx) {
+            fz_report_error(ctx);
+            file = nullptr;
+        }
+    } else if (src->docBuf) {
+        // the bytes are immutable and all engine contexts are cloned
+        // from the same root, so sharing the buffer is safe
+        docBuf = fz_keep_buffer(ctx, src->docBuf);
+        docLoadedToMemory = true;
+        fz_try(ctx) {
+            file = fz_open_buffer(ctx, docBuf);
+        }
+        fz_catch(ctx) {
+            fz_report_error(ctx);
+            file = nullptr;
+        }
+    }
+
+    if (!LoadFromStream(file, FilePath(), pwdUI)) {
+        return false;
+    }
+
+    if (streamNo < 0) {
+        return FinishLoading();
+    }
+
+    return LoadEmbeddedStream(streamNo, pwdUI);
+}
+
 #if 0
 const char* custom_css = R"(
 * {
@@ -1947,6 +2252,39 @@ bool EngineMupdf::Load(IStream* stream, const char* nameHint, PasswordUI* pwdUI)
     return FinishLoading();
 }
 
+// opens a remote document without downloading all of it: the stream
+// fetches byte ranges on demand as the progressive loader asks for them
+bool EngineMupdf::LoadFromURL(const char* url, PasswordUI* pwdUI) {
+    auto ctx = Ctx();
+    ReportIf(FilePath() || _doc || !ctx);
+    if (!ctx) {
+        return false;
+    }
+
+    HttpRangeReader* reader = CreateHttpRangeReader(url);
+    if (!reader) {
+        return false;
+    }
+
+    fz_stream* stm = nullptr;
+    fz_var(stm);
+    fz_try(ctx) {
+        stm = FzOpenHttpStream(ctx, reader);
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+        stm = nullptr;
+    }
+    if (!stm) {
+        delete reader;
+        return false;
+    }
+    if (!LoadFromStream(stm, url, pwdUI)) {
+        return false;
+    }
+    return FinishLoading();
+}
+
 bool EngineMupdf::LoadFromStream(fz_stream* stm, const char* nameHint, PasswordUI* pwdUI) {
     if (!stm) {
         return false;
@@ -2179,6 +2517,244 @@ static void FinishNonPDFLoading(EngineMupdf* e) {
     }
 }
 
+// documents with more pages than this get their mediaboxes resolved
+// lazily so that the first page paints without walking the whole xref
+constexpr int kEagerMediaboxPages = 256;
+
+// resolve the exact mediabox of a page whose size was only assumed at
+// load time. Cheaper than loading the page as it only touches the page
+// tree. Safe to call for already resolved pages (does nothing)
+void EngineMupdf::ResolvePageMediabox(int pageNo) {
+    FzPageInfo* pageInfo = pages[pageNo - 1];
+    if (pageInfo->mediaboxResolved) {
+        return;
+    }
+    auto ctx = Ctx();
+    ScopedCritSec scope(ctxAccess);
+    if (pageInfo->mediaboxResolved) {
+        // raced with the background thread
+        return;
+    }
+    fz_rect mbox{};
+    fz_matrix page_ctm{};
+    fz_var(mbox);
+    fz_try(ctx) {
+        // note: don't pdf_drop_obj() this
+        pdf_obj* pageref = pdf_lookup_page_obj(ctx, pdfdoc, pageNo - 1);
+        pdf_page_obj_transform(ctx, pageref, &mbox, &page_ctm);
+        mbox = fz_transform_rect(mbox, page_ctm);
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+        mbox = {};
+    }
+    if (!fz_is_empty_rect(mbox)) {
+        pageInfo->mediabox = ToRectF(mbox);
+    }
+    pageInfo->mediaboxResolved = true;
+}
+
+static void MediaboxResolveThread(EngineMupdf* e) {
+    for (int pageNo = 1; pageNo <= e->pageCount; pageNo++) {
+        if (e->stopMediaboxResolve.Get()) {
+            return;
+        }
+        e->ResolvePageMediabox(pageNo);
+    }
+}
+
+void EngineMupdf::StopMediaboxResolve() {
+    if (!mediaboxResolveThread) {
+        return;
+    }
+    stopMediaboxResolve.Set(true);
+    WaitForSingleObject(mediaboxResolveThread, INFINITE);
+    CloseHandle(mediaboxResolveThread);
+    mediaboxResolveThread = nullptr;
+}
+
+// fully loading every page up front would pin too many fz_page objects
+// for very long documents, so above this cap only the first pages are
+// pre-loaded; the rest keep loading on first access as before
+constexpr int kMaxPageInfoPreloadPages = 1024;
+
+static void PrefetchPageResources(EngineMupdf* e, FzPageInfo* pageInfo);
+static void PredecodeSlowImages(EngineMupdf* e, FzPageInfo* pageInfo);
+
+// fully loads pages (links, annotations, linkified text) after open so
+// that hover hit-testing and tooltips in the UI never have to parse
+// page content. Work is serialized against the UI via pagesAccess /
+// ctxAccess with per-page granularity
+static void PageInfoPreloadThread(EngineMupdf* e) {
+    // zip-container formats pull page resources out of the archive on
+    // first use; pre-interpreting the pages here inflates shared fonts
+    // and images once, up front, instead of during the first render
+    const char* ext = e->defaultExt;
+    bool isContainerDoc = str::EqI(ext, ".xps") || str::EqI(ext, ".oxps") || str::EqI(ext, ".epub");
+
+    int nPages = std::min(e->pageCount, kMaxPageInfoPreloadPages);
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        if (e->stopPageInfoPreload.Get()) {
+            return;
+        }
+        FzPageInfo* pageInfo = e->GetFzPageInfo(pageNo, false);
+        if (isContainerDoc) {
+            PrefetchPageResources(e, pageInfo);
+        }
+        PredecodeSlowImages(e, pageInfo);
+    }
+}
+
+void EngineMupdf::StartPageInfoPreload() {
+    auto fn = MkFunc0(PageInfoPreloadThread, this);
+    pageInfoPreloadThread = StartThread(fn, "PageInfoPreloadThread");
+    if (pageInfoPreloadThread) {
+        SetThreadPriority(pageInfoPreloadThread, THREAD_PRIORITY_LOWEST);
+    }
+}
+
+void EngineMupdf::StopPageInfoPreload() {
+    if (!pageInfoPreloadThread) {
+        return;
+    }
+    stopPageInfoPreload.Set(true);
+    WaitForSingleObject(pageInfoPreloadThread, INFINITE);
+    CloseHandle(pageInfoPreloadThread);
+    pageInfoPreloadThread = nullptr;
+}
+
+static void FingerprintHashAdd(u32& h, u32 v) {
+    u32 data[2] = {h, v};
+    h = MurmurHash2(&data[0], sizeof(data));
+}
+
+// note: only call when holding ctxAccess, can throw
+static void FingerprintPdfObj(fz_context* ctx, pdf_obj* obj, u32& h) {
+    if (!obj) {
+        FingerprintHashAdd(h, 0);
+        return;
+    }
+    char buf[1024];
+    size_t len = 0;
+    char* s = pdf_sprint_obj(ctx, buf, sizeof(buf), &len, obj, 1 /* tight */, 0 /* ascii */);
+    FingerprintHashAdd(h, MurmurHash2(s, len));
+    if (s != buf) {
+        fz_free(ctx, s);
+    }
+}
+
+// note: only call when holding ctxAccess, can throw
+static void FingerprintPdfStream(fz_context* ctx, pdf_obj* ref, u32& h) {
+    fz_buffer* buf = pdf_load_raw_stream(ctx, ref);
+    u8* data = nullptr;
+    size_t size = fz_buffer_storage(ctx, buf, &data);
+    FingerprintHashAdd(h, MurmurHash2(data, size));
+    fz_drop_buffer(ctx, buf);
+}
+
+// a hash of what determines the rendered content of a page: the
+// serialized page dict (covers /MediaBox, /Rotate and the object
+// numbers of /Contents, /Resources and /Annots), the raw bytes of the
+// content stream(s) and of XObjects directly referenced by the page.
+// Object renumbering can yield a false "changed" (which only costs a
+// re-render), a false "unchanged" would need a writer that reuses an
+// object number for different bytes within the referenced objects
+u32 EngineMupdf::GetPageContentFingerprint(int pageNo) {
+    if (!pdfdoc || !docLoadedToMemory) {
+        // when reads go to the file as needed, the bytes on disk might
+        // already differ from what was rendered, so a fingerprint
+        // computed now wouldn't describe the cached bitmaps
+        return 0;
+    }
+    auto ctx = Ctx();
+    ScopedCritSec scope(ctxAccess);
+    if (pageFingerprints.Size() != pageCount) {
+        pageFingerprints.SetSize(pageCount); // zero-filled
+    }
+    u32 memo = pageFingerprints.at(pageNo - 1);
+    if (memo != 0) {
+        return memo;
+    }
+    u32 h = (u32)pageNo;
+    fz_var(h);
+    fz_try(ctx) {
+        // note: don't pdf_drop_obj() the objects below
+        pdf_obj* pageref = pdf_lookup_page_obj(ctx, pdfdoc, pageNo - 1);
+        FingerprintPdfObj(ctx, pageref, h);
+        pdf_obj* contents = pdf_dict_get(ctx, pageref, PDF_NAME(Contents));
+        if (pdf_is_array(ctx, contents)) {
+            int n = pdf_array_len(ctx, contents);
+            for (int i = 0; i < n; i++) {
+                pdf_obj* stream = pdf_array_get(ctx, contents, i);
+                if (pdf_is_stream(ctx, stream)) {
+                    FingerprintPdfStream(ctx, stream, h);
+                }
+            }
+        } else if (pdf_is_stream(ctx, contents)) {
+            FingerprintPdfStream(ctx, contents, h);
+        }
+        pdf_obj* resources = pdf_dict_get_inheritable(ctx, pageref, PDF_NAME(Resources));
+        pdf_obj* xobjs = pdf_dict_get(ctx, resources, PDF_NAME(XObject));
+        int n = pdf_dict_len(ctx, xobjs);
+        for (int i = 0; i < n; i++) {
+            pdf_obj* xobj = pdf_dict_get_val(ctx, xobjs, i);
+            if (pdf_is_stream(ctx, xobj)) {
+                FingerprintPdfStream(ctx, xobj, h);
+            }
+        }
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+        h = 0;
+    }
+    pageFingerprints[pageNo - 1] = h;
+    return h;
+}
+
+// content fingerprint of a page for cross-engine comparisons; 0 when
+// one can't be computed
+u32 EnginePageContentFingerprint(EngineBase* engine, int pageNo) {
+    EngineMupdf* e = AsEngineMupdf(engine);
+    if (!e || pageNo < 1 || pageNo > e->pageCount) {
+        return 0;
+    }
+    return e->GetPageContentFingerprint(pageNo);
+}
+
+// like EnginePageContentFingerprint() but returns 0 instead of blocking
+// when another thread holds the engine lock (e.g. a render in progress)
+u32 EnginePageContentFingerprintCanFail(EngineBase* engine, int pageNo) {
+    EngineMupdf* e = AsEngineMupdf(engine);
+    if (!e || pageNo < 1 || pageNo > e->pageCount) {
+        return 0;
+    }
+    if (!TryEnterCriticalSection(e->ctxAccess)) {
+        return 0;
+    }
+    // CRITICAL_SECTION locking is recursive
+    u32 res = e->GetPageContentFingerprint(pageNo);
+    LeaveCriticalSection(e->ctxAccess);
+    return res;
+}
+
+// true if pageNo exists in both engines with an identical content
+// fingerprint; returns false whenever that can't be established
+bool EnginePageContentUnchanged(EngineBase* oldEngine, EngineBase* newEngine, int pageNo) {
+    EngineMupdf* eOld = AsEngineMupdf(oldEngine);
+    EngineMupdf* eNew = AsEngineMupdf(newEngine);
+    if (!eOld || !eNew || eOld == eNew) {
+        return false;
+    }
+    if (pageNo < 1 || pageNo > eOld->pageCount || pageNo > eNew->pageCount) {
+        return false;
+    }
+    u32 fpOld = eOld->GetPageContentFingerprint(pageNo);
+    if (0 == fpOld) {
+        return false;
+    }
+    return fpOld == eNew->GetPageContentFingerprint(pageNo);
+}
+
 bool EngineMupdf::FinishLoading() {
     auto ctx = Ctx();
     pdfdoc = pdf_specifics(ctx, _doc);
@@ -2208,12 +2784,22 @@ bool EngineMupdf::FinishLoading() {
     }
     if (!pdfdoc) {
         FinishNonPDFLoading(this);
+        StartPageInfoPreload();
         return true;
     }
 
     ScopedCritSec scope(ctxAccess);
 
-    for (int pageNo = 0; pageNo < pageCount; pageNo++) {
+    // resolving the mediabox of every page walks a large part of the
+    // xref, which for big documents delays the first paint by seconds.
+    // Above the threshold only page 1 is resolved here; the other pages
+    // assume its size (almost always exact) until a low-priority
+    // background thread has resolved them for real. Pages are also
+    // resolved exactly when first loaded (see GetFzPageInfo)
+    bool lazyMediaboxes = pageCount > kEagerMediaboxPages;
+    int nEager = lazyMediaboxes ? 1 : pageCount;
+
+    for (int pageNo = 0; pageNo < nEager; pageNo++) {
         pdf_obj* pageref = nullptr;
         fz_rect mbox{};
         fz_matrix page_ctm{};
@@ -2238,9 +2824,24 @@ bool EngineMupdf::FinishLoading() {
         }
         FzPageInfo* pageInfo = pages[pageNo];
         pageInfo->mediabox = ToRectF(mbox);
+        pageInfo->mediaboxResolved = true;
         pageInfo->pageNo = pageNo + 1;
     }
 
+    if (lazyMediaboxes) {
+        RectF guess = pages[0]->mediabox;
+        for (int pageNo = 1; pageNo < pageCount; pageNo++) {
+            FzPageInfo* pageInfo = pages[pageNo];
+            pageInfo->mediabox = guess;
+            pageInfo->pageNo = pageNo + 1;
+        }
+        auto fn = MkFunc0(MediaboxResolveThread, this);
+        mediaboxResolveThread = StartThread(fn, "MediaboxResolveThread");
+        if (mediaboxResolveThread) {
+            SetThreadPriority(mediaboxResolveThread, THREAD_PRIORITY_LOWEST);
+        }
+    }
+
     fz_try(ctx) {
         outline = fz_load_outline(ctx, _doc);
     }
@@ -2320,11 +2921,19 @@ bool EngineMupdf::FinishLoading() {
     }
     if (pageLabels) {
         hasPageLabels = true;
+        // duplicate labels resolve to the first page carrying them,
+        // same as the StrVec::Find() scan this replaces
+        pageLabelIndex = new dict::MapStrToInt((size_t)PageCount());
+        int nLabels = pageLabels->Size();
+        for (int i = 0; i < nLabels; i++) {
+            pageLabelIndex->Insert(pageLabels->At(i), i + 1);
+        }
     }
 
     // TODO: support javascript
     ReportIf(pdf_js_supported(ctx, pdfdoc));
 
+    StartPageInfoPreload();
     return true;
 }
 
@@ -2415,6 +3024,12 @@ TocTree* EngineMupdf::GetToc() {
     int idCounter = 0;
 
     ScopedCritSec cs(ctxAccess);
+    // the command palette builds its ToC index on a background thread;
+    // re-check under the lock so that a racing caller doesn't build
+    // (and leak) a second tree
+    if (tocTree) {
+        return tocTree;
+    }
 
     TocItem* root = nullptr;
     TocItem* att = nullptr;
@@ -2715,6 +3330,17 @@ FzPageInfo* EngineMupdf::GetFzPageInfo(int pageNo, bool loadQuick, fz_cookie* co
         return nullptr;
     }
 
+    if (!pageInfo->mediaboxResolved) {
+        // lazily loaded page: replace the assumed size with the real one
+        fz_try(ctx) {
+            pageInfo->mediabox = ToRectF(fz_bound_page(ctx, page));
+        }
+        fz_catch(ctx) {
+            fz_report_error(ctx);
+        }
+        pageInfo->mediaboxResolved = true;
+    }
+
     // build annotations info on first access
     if (pdfdoc && pageInfo->annotations.Size() == 0) {
         fz_try(ctx) {
@@ -2854,7 +3480,246 @@ RectF EngineMupdf::Transform(const RectF& rect, int pageNo, float zoom, int rota
     return ToRectF(rect2);
 }
 
+// zoom and rotation are baked into the raster transform, not into the
+// recorded list, so one cached list serves every zoom level. CAD-style
+// pages with millions of paths are exactly the ones where interpreting
+// the content stream dominates rendering
+constexpr size_t kDisplayListCacheMaxBytes = 64 * 1024 * 1024;
+
+// all must be called while holding ctxAccess
+
+static void DropCachedDisplayList(EngineMupdf* e, FzPageInfo* pi) {
+    if (!pi->displayList) {
+        return;
+    }
+    e->displayListsTotalSize -= pi->displayListSize;
+    fz_drop_display_list(e->Ctx(), pi->displayList);
+    pi->displayList = nullptr;
+    pi->displayListSize = 0;
+    pi->displayListUsage = nullptr;
+}
+
+static void CacheDisplayList(EngineMupdf* e, FzPageInfo* pi, fz_display_list* list, const char* usage) {
+    auto ctx = e->Ctx();
+    DropCachedDisplayList(e, pi);
+    // display list nodes are 32-bit words (fz_display_node); this
+    // undercounts paths and images referenced out of band but tracks
+    // page complexity well enough for a budget
+    size_t size = list->max * 4;
+    pi->displayList = fz_keep_display_list(ctx, list);
+    pi->displayListSize = size;
+    pi->displayListUsage = usage;
+    pi->displayListGen = ++e->displayListUseGen;
+    e->displayListsTotalSize += size;
+    // evict least recently replayed lists once over budget, but never
+    // the one just added. pages itself is stable after loading so
+    // iterating it here doesn't need pagesAccess (which must not be
+    // taken under ctxAccess anyway)
+    while (e->displayListsTotalSize > kDisplayListCacheMaxBytes) {
+        FzPageInfo* lru = nullptr;
+        for (FzPageInfo* p : e->pages) {
+            if (!p->displayList || p == pi) {
+                continue;
+            }
+            if (!lru || p->displayListGen < lru->displayListGen) {
+                lru = p;
+            }
+        }
+        if (!lru) {
+            break;
+        }
+        DropCachedDisplayList(e, lru);
+    }
+}
+
+// records the display list of a page that hasn't been rendered yet (see
+// PageInfoPreloadThread). For zip-container documents interpreting the
+// content inflates the fonts and image parts the page references from
+// the archive; the recording is kept via CacheDisplayList for the
+// actual render and fonts stay cached by the document even if the list
+// is evicted later
+static void PrefetchPageResources(EngineMupdf* e, FzPageInfo* pageInfo) {
+    if (!pageInfo || !pageInfo->page) {
+        return;
+    }
+    auto ctx = e->Ctx();
+    ScopedCritSec cs(e->ctxAccess);
+    if (pageInfo->displayList) {
+        return;
+    }
+    fz_display_list* list = nullptr;
+    fz_device* listDev = nullptr;
+    fz_var(list);
+    fz_var(listDev);
+    fz_try(ctx) {
+        list = fz_new_display_list(ctx, fz_bound_page(ctx, pageInfo->page));
+        listDev = fz_new_list_device(ctx, list);
+        fz_run_page_contents(ctx, pageInfo->page, listDev, fz_identity, nullptr);
+        fz_close_device(ctx, listDev);
+        listDev = nullptr;
+        CacheDisplayList(e, pageInfo, list, "View");
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, listDev);
+        if (list) {
+            fz_drop_display_list(ctx, list);
+        }
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+    }
+}
+
+// JBIG2 and JPX decode much slower than the other codecs (scanned
+// archival PDFs can spend most of each render inside the codec) and
+// Windows ships no WIC codec for either format we could offload to.
+// What we can do is decode ahead of time: fz_get_pixmap_from_image
+// caches the decoded pixmap in the shared fz store keyed by the image
+// object, so decoding here on the preload thread means the first
+// render finds the result already decoded
+static void PredecodeSlowImages(EngineMupdf* e, FzPageInfo* pageInfo) {
+    if (!pageInfo || !pageInfo->page) {
+        return;
+    }
+    auto ctx = e->Ctx();
+    ScopedCritSec cs(e->ctxAccess);
+    fz_stext_options opts{};
+    opts.flags = FZ_STEXT_PRESERVE_IMAGES;
+    fz_stext_page* stext = nullptr;
+    fz_var(stext);
+    fz_try(ctx) {
+        stext = fz_new_stext_page_from_page(ctx, pageInfo->page, &opts);
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+    }
+    if (!stext) {
+        return;
+    }
+    int nDecoded = 0;
+    for (fz_stext_block* block = stext->first_block; block; block = block->next) {
+        if (block->type != FZ_STEXT_BLOCK_IMAGE) {
+            continue;
+        }
+        if (e->stopPageInfoPreload.Get()) {
+            break;
+        }
+        fz_image* image = block->u.i.image;
+        fz_compressed_buffer* buf = fz_compressed_image_buffer(ctx, image);
+        if (!buf) {
+            continue;
+        }
+        int type = buf->params.type;
+        if (type != FZ_IMAGE_JBIG2 && type != FZ_IMAGE_JPX) {
+            continue;
+        }
+        fz_pixmap* pixmap = nullptr;
+        fz_var(pixmap);
+        fz_try(ctx) {
+            pixmap = fz_get_pixmap_from_image(ctx, image, nullptr, nullptr, nullptr, nullptr);
+            nDecoded++;
+        }
+        fz_always(ctx) {
+            fz_drop_pixmap(ctx, pixmap);
+        }
+        fz_catch(ctx) {
+            fz_report_error(ctx);
+        }
+    }
+    fz_drop_stext_page(ctx, stext);
+    if (nDecoded > 0) {
+        logf("PredecodeSlowImages: pre-decoded %d jbig2/jpx images on page %d\n", nDecoded, pageInfo->pageNo);
+    }
+}
+
+// targets above this render in bands (print DPI on A0-sized drawings
+// easily hits hundreds of MB per copy; the one-shot path below briefly
+// holds three full-size copies: pixmap, BGRA conversion and DIB)
+constexpr size_t kBandedRenderThreshold = 64 * 1024 * 1024;
+constexpr size_t kRenderBandBytes = 16 * 1024 * 1024;
+
+// replays list into a full-size DIB in horizontal bands, so fz-side
+// memory stays bounded by the band size no matter how big the target.
+// Renders straight into BGRA bands, skipping the separate conversion
+// pass of NewRenderedFzPixmap
+static RenderedBitmap* RenderPageBanded(fz_context* ctx, fz_display_list* list, fz_matrix ctm, fz_irect ibounds,
+                                        fz_cookie* fzcookie) {
+    int w = ibounds.x1 - ibounds.x0;
+    int h = ibounds.y1 - ibounds.y0;
+    size_t dstStride = (size_t)w * 4;
+    size_t imgSize = dstStride * (size_t)h;
+
+    ScopedMem<BITMAPINFO> bmi((BITMAPINFO*)calloc(1, sizeof(BITMAPINFO) + 255 * sizeof(RGBQUAD)));
+    BITMAPINFOHEADER* bmih = &bmi.Get()->bmiHeader;
+    bmih->biSize = sizeof(*bmih);
+    bmih->biWidth = w;
+    bmih->biHeight = -h;
+    bmih->biPlanes = 1;
+    bmih->biCompression = BI_RGB;
+    bmih->biBitCount = 32;
+    bmih->biSizeImage = (DWORD)imgSize;
+
+    u8* data = nullptr;
+    HANDLE hMap = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(imgSize >> 32),
+                                     (DWORD)imgSize, nullptr);
+    HBITMAP hbmp = CreateDIBSection(nullptr, bmi, DIB_RGB_COLORS, (void**)&data, hMap, 0);
+    if (!hbmp || !data) {
+        if (hbmp) {
+            DeleteObject(hbmp);
+        }
+        SafeCloseHandle(&hMap);
+        // like NewRenderedFzPixmap: an invalid bitmap (as opposed to
+        // nullptr) tells callers to retry at a smaller size
+        return new RenderedBitmap(nullptr, Size(w, h));
+    }
+
+    int bandDy = (int)(kRenderBandBytes / dstStride);
+    bandDy = std::max(bandDy, 16);
+    fz_matrix inv = fz_invert_matrix(ctm);
+
+    bool failed = false;
+    for (int y = ibounds.y0; y < ibounds.y1 && !failed; y += bandDy) {
+        if (fzcookie && fzcookie->abort) {
+            break;
+        }
+        fz_irect band = ibounds;
+        band.y0 = y;
+        band.y1 = std::min(y + bandDy, ibounds.y1);
+
+        fz_pixmap* pix = nullptr;
+        fz_device* dev = nullptr;
+        fz_var(pix);
+        fz_var(dev);
+        fz_try(ctx) {
+            pix = fz_new_pixmap_with_bbox(ctx, fz_device_bgr(ctx), band, nullptr, 1);
+            fz_clear_pixmap_with_value(ctx, pix, 0xff);
+            dev = fz_new_draw_device(ctx, ctm, pix);
+            // cull list nodes against the band, in page space
+            fz_rect scissor = fz_transform_rect(fz_rect_from_irect(band), inv);
+            fz_run_display_list(ctx, list, dev, fz_identity, scissor, fzcookie);
+            fz_close_device(ctx, dev);
+            u8* dst = data + dstStride * (size_t)(band.y0 - ibounds.y0);
+            memcpy(dst, pix->samples, (size_t)pix->stride * (band.y1 - band.y0));
+        }
+        fz_always(ctx) {
+            fz_drop_device(ctx, dev);
+            fz_drop_pixmap(ctx, pix);
+        }
+        fz_catch(ctx) {
+            fz_report_error(ctx);
+            failed = true;
+        }
+    }
+    if (failed) {
+        DeleteObject(hbmp);
+        SafeCloseHandle(&hMap);
+        return nullptr;
+    }
+    return new RenderedBitmap(hbmp, Size(w, h), hMap);
+}
+
 RenderedBitmap* EngineMupdf::RenderPage(RenderPageArgs& args) {
+    PerfTraceScope trace("EngineMupdf::RenderPage");
     auto ctx = Ctx();
     auto pageNo = args.pageNo;
 
@@ -2872,31 +3737,9 @@ RenderedBitmap* EngineMupdf::RenderPage(RenderPageArgs& args) {
     }
     fz_page* page = pageInfo->page;
 
-    ScopedCritSec cs(ctxAccess);
-
     auto pageRect = args.pageRect;
     auto zoom = args.zoom;
     auto rotation = args.rotation;
-    fz_rect pRect;
-    if (pageRect) {
-        pRect = ToFzRect(*pageRect);
-    } else {
-        // TODO(port): use pageInfo->mediabox?
-        pRect = fz_bound_page(ctx, page);
-    }
-    fz_matrix ctm = viewctm(page, zoom, rotation);
-    fz_irect bbox = fz_round_rect(fz_transform_rect(pRect, ctm));
-
-    fz_colorspace* csRgb = fz_device_rgb(ctx);
-    fz_irect ibounds = bbox;
-
-    fz_pixmap* pix = nullptr;
-    fz_device* dev = nullptr;
-    RenderedBitmap* bitmap = nullptr;
-
-    fz_var(dev);
-    fz_var(pix);
-    fz_var(bitmap);
 
     const char* usage = "View";
     switch (args.target) {
@@ -2905,54 +3748,101 @@ RenderedBitmap* EngineMupdf::RenderPage(RenderPageArgs& args) {
             break;
     }
 
-    pdf_page* pdfpage = nullptr;
-    fz_var(pdfpage);
-    if (pdfdoc) {
+    // record the page into a display list while holding the document
+    // lock; the (slow) rasterization below then runs on this thread's
+    // cloned context so that other page operations (text extraction,
+    // link loading, rendering of other pages) don't serialize on it
+    fz_rect pRect;
+    fz_matrix ctm;
+    fz_display_list* list = nullptr;
+    {
+        ScopedCritSec cs(ctxAccess);
+
+        fz_device* listDev = nullptr;
+        fz_var(list);
+        fz_var(listDev);
         fz_try(ctx) {
-            pdfpage = pdf_page_from_fz_page(ctx, page);
-            pix = fz_new_pixmap_with_bbox(ctx, csRgb, ibounds, nullptr, 1);
-            fz_clear_pixmap_with_value(ctx, pix, 0xff);
-            // TODO: in printing different style. old code use pdf_run_page_with_usage(), with usage ="View"
-            // or "Print". "Export" is not used
-            dev = fz_new_draw_device(ctx, ctm, pix);
-            pdf_run_page_with_usage(ctx, pdfpage, dev, fz_identity, usage, fzcookie);
-            bitmap = NewRenderedFzPixmap(ctx, pix);
-            fz_close_device(ctx, dev);
-        }
-        fz_always(ctx) {
-            if (dev) {
-                fz_drop_device(ctx, dev);
+            if (pageRect) {
+                pRect = ToFzRect(*pageRect);
+            } else {
+                // TODO(port): use pageInfo->mediabox?
+                pRect = fz_bound_page(ctx, page);
+            }
+            ctm = viewctm(page, zoom, rotation);
+            if (pageInfo->displayList && str::Eq(pageInfo->displayListUsage, usage)) {
+                // replay the cached recording instead of re-interpreting
+                // the content stream
+                list = fz_keep_display_list(ctx, pageInfo->displayList);
+                pageInfo->displayListGen = ++displayListUseGen;
+            } else {
+                list = fz_new_display_list(ctx, fz_bound_page(ctx, page));
+                listDev = fz_new_list_device(ctx, list);
+                if (pdfdoc) {
+                    pdf_page* pdfpage = pdf_page_from_fz_page(ctx, page);
+                    pdf_run_page_with_usage(ctx, pdfpage, listDev, fz_identity, usage, fzcookie);
+                } else {
+                    fz_run_page_contents(ctx, page, listDev, fz_identity, fzcookie);
+                }
+                fz_close_device(ctx, listDev);
+                listDev = nullptr;
+                CacheDisplayList(this, pageInfo, list, usage);
             }
-            fz_drop_pixmap(ctx, pix);
-        }
-        fz_catch(ctx) {
-            fz_report_error(ctx);
-            delete bitmap;
-            return nullptr;
-        }
-    } else {
-        fz_try(ctx) {
-            pix = fz_new_pixmap_with_bbox(ctx, csRgb, ibounds, nullptr, 1);
-            // TODO: to have uniform background needs to set custom css
-            // background-color and clear pixmap with the same color
-            fz_clear_pixmap_with_value(ctx, pix, 0xff);
-            // fz_clear_pixmap(ctx, pix);
-            // fz_fill_pixmap_with_color(ctx, pix, )
-            dev = fz_new_draw_device(ctx, ctm, pix);
-            fz_run_page_contents(ctx, page, dev, fz_identity, NULL);
-            fz_close_device(ctx, dev);
-            fz_drop_device(ctx, dev);
-            bitmap = NewRenderedFzPixmap(ctx, pix);
         }
         fz_always(ctx) {
-            fz_drop_pixmap(ctx, pix);
+            fz_drop_device(ctx, listDev);
         }
         fz_catch(ctx) {
             fz_report_error(ctx);
-            delete bitmap;
-            return nullptr;
+            if (list) {
+                fz_drop_display_list(ctx, list);
+                list = nullptr;
+            }
         }
     }
+    if (!list) {
+        return nullptr;
+    }
+
+    fz_context* rctx = CtxForThread();
+    fz_irect ibounds = fz_round_rect(fz_transform_rect(pRect, ctm));
+
+    size_t cbTarget = (size_t)(ibounds.x1 - ibounds.x0) * 4 * (size_t)(ibounds.y1 - ibounds.y0);
+    if (cbTarget > kBandedRenderThreshold) {
+        RenderedBitmap* res = RenderPageBanded(rctx, list, ctm, ibounds, fzcookie);
+        fz_drop_display_list(rctx, list);
+        return res;
+    }
+
+    fz_colorspace* csRgb = fz_device_rgb(rctx);
+
+    fz_pixmap* pix = nullptr;
+    fz_device* dev = nullptr;
+    RenderedBitmap* bitmap = nullptr;
+
+    fz_var(dev);
+    fz_var(pix);
+    fz_var(bitmap);
+
+    fz_try(rctx) {
+        pix = fz_new_pixmap_with_bbox(rctx, csRgb, ibounds, nullptr, 1);
+        // TODO: to have uniform background needs to set custom css
+        // background-color and clear pixmap with the same color
+        fz_clear_pixmap_with_value(rctx, pix, 0xff);
+        dev = fz_new_draw_device(rctx, ctm, pix);
+        fz_run_display_list(rctx, list, dev, fz_identity, pRect, fzcookie);
+        fz_close_device(rctx, dev);
+        bitmap = NewRenderedFzPixmap(rctx, pix);
+    }
+    fz_always(rctx) {
+        fz_drop_device(rctx, dev);
+        fz_drop_pixmap(rctx, pix);
+        fz_drop_display_list(rctx, list);
+    }
+    fz_catch(rctx) {
+        fz_report_error(rctx);
+        delete bitmap;
+        bitmap = nullptr;
+    }
 
     return bitmap;
 }
@@ -3118,6 +4008,7 @@ RenderedBitmap* EngineMupdf::GetPageImage(int pageNo, RectF rect, int imageIdx)
 }
 
 PageText EngineMupdf::ExtractPageText(int pageNo) {
+    PerfTraceScope trace("EngineMupdf::ExtractPageText");
     auto ctx = Ctx();
 
     FzPageInfo* pageInfo = GetFzPageInfo(pageNo, true);
@@ -3485,7 +4376,11 @@ const pdf_write_options pdf_default_write_options2 = {
 // this is used after the PDF was modified by the user (e.g. by adding / changing
 // annotations).
 // if filePath is not given, we save under the same name
-// TODO: if the file is locked, this might fail.
+// when possible this is an incremental save: only the changed objects and a new
+// xref section are appended, which for large files is much faster than a full
+// re-write. file::MapFile() shares write access so that appending to a file
+// we have mapped works
+// TODO: if the file is locked by another program, this might fail.
 bool EngineMupdfSaveUpdated(EngineBase* engine, const char* path, const ShowErrorCb& showErrorFunc) {
     ReportIf(!engine);
     if (!engine) {
@@ -3579,8 +4474,8 @@ int EngineMupdf::GetPageByLabel(const char* label) const {
         return EngineBase::GetPageByLabel(label);
     }
     int pageNo = 0;
-    if (pageLabels) {
-        pageNo = pageLabels->Find(label) + 1;
+    if (pageLabelIndex && !pageLabelIndex->Get(label, &pageNo)) {
+        pageNo = 0;
     }
 
     if (!pageNo) {
@@ -3590,6 +4485,57 @@ int EngineMupdf::GetPageByLabel(const char* label) const {
     return pageNo;
 }
 
+// converts the loaded document to a PDF file at dstPath by replaying
+// every page into mupdf's pdf writer. Works for any mupdf-backed
+// document (epub, fb2, xps, images, ...); returns false for other
+// engines
+bool EngineMupdfSaveAsPdf(EngineBase* engine, const char* dstPath) {
+    EngineMupdf* e = AsEngineMupdf(engine);
+    if (!e) {
+        return false;
+    }
+    int nPages = e->PageCount();
+    // load the pages up front: GetFzPageInfo() takes pagesAccess,
+    // which must not be asked for under ctxAccess
+    Vec<fz_page*> pages;
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        FzPageInfo* pi = e->GetFzPageInfo(pageNo, true);
+        if (!pi || !pi->page) {
+            return false;
+        }
+        pages.Append(pi->page);
+    }
+
+    ScopedCritSec scope(e->ctxAccess);
+    fz_context* ctx = e->Ctx();
+    fz_document_writer* wri = nullptr;
+    bool ok = true;
+    fz_var(wri);
+    fz_var(ok);
+    fz_try(ctx) {
+        wri = fz_new_document_writer(ctx, dstPath, "pdf", nullptr);
+        for (fz_page* page : pages) {
+            fz_rect mediabox = fz_bound_page(ctx, page);
+            fz_device* dev = fz_begin_page(ctx, wri, mediabox);
+            fz_run_page(ctx, page, dev, fz_identity, nullptr);
+            fz_end_page(ctx, wri);
+        }
+        fz_close_document_writer(ctx, wri);
+    }
+    fz_always(ctx) {
+        fz_drop_document_writer(ctx, wri);
+    }
+    fz_catch(ctx) {
+        fz_report_error(ctx);
+        ok = false;
+    }
+    if (!ok) {
+        // don't leave a partially written document behind
+        file::Delete(dstPath);
+    }
+    return ok;
+}
+
 bool IsEngineMupdfSupportedFileType(Kind kind) {
     if (kind == kindFilePDF) {
         return true;
@@ -3677,6 +4623,19 @@ EngineBase* CreateEngineMupdfFromStream(IStream* stream, const char* nameHint, P
     return engine;
 }
 
+EngineBase* CreateEngineMupdfFromURL(const char* url, PasswordUI* pwdUI) {
+    if (str::IsEmpty(url)) {
+        return nullptr;
+    }
+    EngineMupdf* engine = new EngineMupdf();
+    if (!engine->LoadFromURL(url, pwdUI)) {
+        engine->Release();
+        return nullptr;
+    }
+    engine->SetFilePath(url);
+    return engine;
+}
+
 EngineBase* CreateEngineMupdfFromData(const ByteSlice& data, const char* nameHint, PasswordUI* pwdUI) {
     EngineMupdf* engine = new EngineMupdf();
     IStream* stream = CreateStreamFromData(data);
@@ -3830,6 +4789,16 @@ NO_INLINE void MarkNotificationAsModified(EngineMupdf* e, Annotation* annot, Ann
     ReportIf(pageNo < 1 || pageNo > e->pageCount);
     int pageIdx = pageNo - 1;
 
+    {
+        // the cached recording and fingerprint no longer match the page
+        // content
+        ScopedCritSec scope(e->ctxAccess);
+        DropCachedDisplayList(e, e->pages[pageIdx]);
+        if (e->pageFingerprints.Size() > pageIdx) {
+            e->pageFingerprints[pageIdx] = 0;
+        }
+    }
+
     // EngineMupdf is the ultimate source of truth for Annotation* list
     // all other places only get references to Annotation* created
     // inside EngineMupdf.
@@ -3,6 +3,10 @@
 
 struct Annotation;
 
+namespace dict {
+class MapStrToInt;
+}
+
 struct FitzPageImageInfo {
     fz_rect rect = fz_unit_rect;
     fz_matrix transform;
@@ -31,11 +35,31 @@ struct FzPageInfo {
     bool elementsNeedRebuilding = true;
 
     RectF mediabox{};
+    // for large documents mediabox starts out as the size of page 1 and
+    // is only resolved exactly on first use (see FinishLoading)
+    bool mediaboxResolved = false;
     Vec<FitzPageImageInfo*> images;
 
     // if false, only loaded page (fast)
     // if true, loaded expensive info (extracted text etc.)
     bool fullyLoaded = false;
+
+    // recorded page content, so that re-rendering at a new zoom replays
+    // it instead of re-interpreting the content stream. All guarded by
+    // ctxAccess; dropped on annotation changes and by budget eviction
+    fz_display_list* displayList = nullptr;
+    size_t displayListSize = 0;
+    const char* displayListUsage = nullptr;
+    u32 displayListGen = 0; // for least-recently-replayed eviction
+};
+
+// a read-only mapping of the document file, refcounted so that an
+// engine and its clones share one mapping instead of each re-reading
+// the file from disk. The bytes are immutable, every engine parses
+// its own document from them
+struct SharedFileMap {
+    file::FileMap map;
+    AtomicRefCount refs;
 };
 
 class EngineMupdf : public EngineBase {
@@ -73,25 +97,65 @@ class EngineMupdf : public EngineBase {
     int GetPageByLabel(const char* label) const override;
 
     fz_context* Ctx() const;
+    // a per-thread clone of Ctx() for operations that don't touch the
+    // document, like rasterizing display lists
+    fz_context* CtxForThread();
+
+    // resolve the exact mediabox of a lazily loaded page
+    void ResolvePageMediabox(int pageNo);
+    void StopMediaboxResolve();
+
+    void StartPageInfoPreload();
+    void StopPageInfoPreload();
+
+    // hash of the PDF objects that determine the rendered content of a
+    // page; used to detect pages that didn't change across a reload and
+    // to share rendered bitmaps between tabs showing the same document.
+    // Returns 0 when a fingerprint can't be computed
+    u32 GetPageContentFingerprint(int pageNo);
 
     // make sure to never ask for pagesAccess in an ctxAccess
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION* ctxAccess;
     CRITICAL_SECTION pagesAccess;
 
-    CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
+    // what ctxAccess points to; fz allocation locks are process-wide
+    // (all engines clone one root context and share its store)
+    CRITICAL_SECTION docAccess;
 
     fz_context* _ctx = nullptr;
-    fz_locks_context fz_locks_ctx;
+    DWORD creationThreadId = 0;
     int displayDPI{96};
     fz_document* _doc = nullptr;
     pdf_document* pdfdoc = nullptr;
     fz_stream* docStream = nullptr;
+    // backs docStream for large files; pages of the file are faulted in
+    // on demand instead of being read up front. Unmapped by the last
+    // engine (original or clone) using it
+    SharedFileMap* docMap = nullptr;
+    // the file bytes when small files are read to memory in full;
+    // also shared with clones (buffers are refcounted)
+    fz_buffer* docBuf = nullptr;
+    // true if the document was read into memory in its entirety i.e.
+    // reads can't observe later changes to the file on disk
+    bool docLoadedToMemory = false;
     Vec<FzPageInfo*> pages;
+    // memoized GetPageContentFingerprint() results, guarded by
+    // ctxAccess; reset per page when annotations change
+    Vec<u32> pageFingerprints;
     fz_outline* outline = nullptr;
     fz_outline* attachments = nullptr;
+    // fills in exact mediaboxes of lazily loaded pages
+    HANDLE mediaboxResolveThread = nullptr;
+    AtomicBool stopMediaboxResolve;
+    // fully loads page links and annotations in the background
+    HANDLE pageInfoPreloadThread = nullptr;
+    AtomicBool stopPageInfoPreload;
     pdf_obj* pdfInfo = nullptr;
     StrVec* pageLabels = nullptr;
+    // label => first page with that label, so that the toolbar page
+    // box resolves a typed label without scanning all labels
+    dict::MapStrToInt* pageLabelIndex = nullptr;
 
     TocTree* tocTree = nullptr;
 
@@ -99,11 +163,19 @@ class EngineMupdf : public EngineBase {
     // the same annotation, we should be back to 0
     bool modifiedAnnotations = false;
 
+    // combined approximate size of cached per-page display lists and
+    // the use counter backing their LRU eviction; guarded by ctxAccess
+    size_t displayListsTotalSize = 0;
+    u32 displayListUseGen = 0;
+
     bool Load(const char* filePath, PasswordUI* pwdUI = nullptr);
     bool Load(IStream* stream, const char* nameHint, PasswordUI* pwdUI = nullptr);
+    bool LoadFromURL(const char* url, PasswordUI* pwdUI = nullptr);
     // TODO(port): fz_stream can no-longer be re-opened (fz_clone_stream)
     // bool Load(fz_stream* stm, PasswordUI* pwdUI = nullptr);
     bool LoadFromStream(fz_stream* stm, const char* nameHing, PasswordUI* pwdUI = nullptr);
+    bool LoadFromSharedData(EngineMupdf* src, PasswordUI* pwdUI);
+    bool LoadEmbeddedStream(int streamNo, PasswordUI* pwdUI);
     bool FinishLoading();
     RenderedBitmap* GetPageImage(int pageNo, RectF rect, int imageIdx);
 
@@ -4,6 +4,7 @@
 #include "utils/BaseUtil.h"
 #include <zlib.h>
 #include "utils/ByteReader.h"
+#include "utils/CryptoUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/FileUtil.h"
 #include "utils/GuessFileType.h"
@@ -15,6 +16,7 @@
 #include "DocController.h"
 #include "EngineBase.h"
 #include "EngineAll.h"
+#include "FileThumbnails.h"
 
 #include "utils/Log.h"
 
@@ -143,7 +145,69 @@ static Rect ExtractDSCPageSize(const WCHAR* path) {
 }
 #endif
 
-static EngineBase* ps2pdf(const char* path) {
+// where the result of converting srcPath is cached on disk: one file
+// per source path (same fingerprinting scheme as GetThumbnailPathTemp),
+// overwritten when the source changes
+static TempStr GetPsConversionCachePathTemp(const char* srcPath) {
+    if (!srcPath) {
+        return nullptr;
+    }
+    u8 digest[16]{};
+    TempStr path = str::DupTemp(srcPath);
+    if (path::HasVariableDriveLetter(path)) {
+        path[0] = '?';
+    }
+    CalcMD5Digest((u8*)path, str::Leni(path), digest);
+    AutoFreeStr fingerPrint = str::MemToHex(digest, dimof(digest));
+    TempStr cacheDir = GetThumbnailCacheDirTemp();
+    if (!cacheDir) {
+        return nullptr;
+    }
+    return path::JoinTemp(cacheDir, str::JoinTemp(fingerPrint, ".psconv"));
+}
+
+static EngineBase* CreateEngineFromPdfFileData(const char* path) {
+    ByteSlice pdfData = file::ReadFile(path);
+    if (pdfData.empty()) {
+        return nullptr;
+    }
+    IStream* strm = CreateStreamFromData(pdfData);
+    pdfData.Free();
+    ScopedComPtr<IStream> stream(strm);
+    if (!stream) {
+        return nullptr;
+    }
+    return CreateEngineMupdfFromStream(stream, path);
+}
+
+// a cached conversion is valid if it was written no earlier than the
+// source was last modified
+static EngineBase* LoadCachedPsConversion(const char* cachePath, const char* srcPath) {
+    if (!cachePath || !file::Exists(cachePath)) {
+        return nullptr;
+    }
+    FILETIME cacheTime = file::GetModificationTime(cachePath);
+    FILETIME srcTime = file::GetModificationTime(srcPath);
+    if (FileTimeDiffInSecs(cacheTime, srcTime) < 0) {
+        return nullptr;
+    }
+    EngineBase* engine = CreateEngineFromPdfFileData(cachePath);
+    if (engine) {
+        logf("LoadCachedPsConversion: using cached conversion '%s' of '%s'\n", cachePath, srcPath);
+    }
+    return engine;
+}
+
+// path is the file fed to Ghostscript, srcPath the document the user
+// opened (they differ for .ps.gz, where path is the decompressed copy);
+// the conversion cache is keyed by srcPath
+static EngineBase* ps2pdf(const char* path, const char* srcPath) {
+    TempStr cachePath = GetPsConversionCachePathTemp(srcPath);
+    EngineBase* cached = LoadCachedPsConversion(cachePath, srcPath);
+    if (cached) {
+        return cached;
+    }
+
     // TODO: read from gswin32c's stdout instead of using a TEMP file
     TempStr shortPath = path::ShortPathTemp(path);
     TempStr tmpFile = GetTempFilePathTemp("PsE");
@@ -173,20 +237,35 @@ static EngineBase* ps2pdf(const char* path) {
         logf("- %s:%d: using '%s' for creating '%%TEMP%%\\%s'\n", fileName, __LINE__, gswin32c, tmpFileName);
     }
 
-    // TODO: the PS-to-PDF conversion can hang the UI for several seconds
     HANDLE process = LaunchProcessInDir(cmdLine, nullptr, CREATE_NO_WINDOW);
     if (!process) {
         return nullptr;
     }
 
-    // TODO: should show a message box and do it in a background thread
     DWORD timeoutInMs = 40000;
     // allow to disable the timeout
     if (GetEnvironmentVariable(L"SUMATRAPDF_NO_GHOSTSCRIPT_TIMEOUT", nullptr, 0)) {
         timeoutInMs = INFINITE;
     }
+    // wait in slices and log progress (the output file grows as pages
+    // are emitted); with lazy loading the conversion runs on the
+    // document loading thread, so this doesn't hang the UI
     DWORD exitCode = EXIT_FAILURE;
-    WaitForSingleObject(process, timeoutInMs);
+    DWORD waited = 0;
+    for (;;) {
+        DWORD res = WaitForSingleObject(process, 500);
+        if (res != WAIT_TIMEOUT) {
+            break;
+        }
+        waited += 500;
+        if (timeoutInMs != INFINITE && waited >= timeoutInMs) {
+            break;
+        }
+        if ((waited % 5000) == 0) {
+            logf("ps2pdf: still converting '%s' after %d ms, output is %d bytes\n", srcPath, (int)waited,
+                 (int)file::GetSize(tmpFile));
+        }
+    }
     GetExitCodeProcess(process, &exitCode);
     TerminateProcess(process, 1);
     CloseHandle(process);
@@ -194,19 +273,12 @@ static EngineBase* ps2pdf(const char* path) {
         return nullptr;
     }
 
-    ByteSlice pdfData = file::ReadFile(tmpFile);
-    if (pdfData.empty()) {
-        return nullptr;
-    }
-
-    IStream* strm = CreateStreamFromData(pdfData);
-    pdfData.Free();
-    ScopedComPtr<IStream> stream(strm);
-    if (!stream) {
-        return nullptr;
+    // remember the conversion so that reopening the file skips it
+    if (cachePath) {
+        file::Copy(cachePath, tmpFile, false);
     }
 
-    return CreateEngineMupdfFromStream(stream, tmpFile);
+    return CreateEngineFromPdfFileData(tmpFile);
 }
 
 static EngineBase* psgz2pdf(const char* fileName) {
@@ -240,7 +312,7 @@ static EngineBase* psgz2pdf(const char* fileName) {
     fclose(outFile);
     gzclose(inFile);
 
-    return ps2pdf(tmpFile);
+    return ps2pdf(tmpFile, fileName);
 }
 
 // EnginePs is mostly a proxy for a PdfEngine that's fed whatever
@@ -363,7 +435,7 @@ class EnginePs : public EngineBase {
         if (file::StartsWith(fileName, "\x1F\x8B")) {
             pdfEngine = psgz2pdf(fileName);
         } else {
-            pdfEngine = ps2pdf(fileName);
+            pdfEngine = ps2pdf(fileName, fileName);
         }
 
         if (str::EndsWithI(FilePath(), ".eps")) {
@@ -378,6 +450,9 @@ class EnginePs : public EngineBase {
         fileDPI = pdfEngine->GetFileDPI();
         allowsPrinting = pdfEngine->AllowsPrinting();
         allowsCopyingText = pdfEngine->AllowsCopyingText();
+        allowsParallelRender = pdfEngine->allowsParallelRender;
+        allowsParallelTextExtraction = pdfEngine->allowsParallelTextExtraction;
+        supportsClone = pdfEngine->supportsClone;
         decryptionKey = pdfEngine->decryptionKey;
         pageCount = pdfEngine->PageCount();
 
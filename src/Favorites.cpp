@@ -127,24 +127,46 @@ HTREEITEM FavTreeModel::GetHandle(TreeItem ti) {
     return treeItem->hItem;
 }
 
+// files that have favorites, sorted by base file name. The favorites
+// menu and tree used to re-scan and re-sort the whole file history on
+// every menu open and on every favorite change, which with thousands
+// of favorites took a noticeable amount of time
+static Vec<FileState*> gFavFilesSorted;
+static bool gFavIndexValid = false;
+static int gFavIndexHistoryGeneration = 0;
+
+// favorites shown in the currently built favorites menu, indexed by
+// menuId - CmdFavoriteFirst (filled in AppendFavMenuItems)
+struct FavMenuEntry {
+    Favorite* fav = nullptr;
+    FileState* fs = nullptr;
+};
+static Vec<FavMenuEntry> gFavMenuEntries;
+
+// must be called whenever favorites are added or removed (changes of
+// the file history itself are caught via gFileHistoryGeneration)
+static void InvalidateFavIndex() {
+    gFavIndexValid = false;
+}
+
+static void EnsureFavIndex();
+
 static Favorite* GetFavByMenuId(int menuId, FileState** dsOut) {
-    FileState* ds;
-    for (size_t i = 0; (ds = gFileHistory.Get(i)) != nullptr; i++) {
-        for (size_t j = 0; j < ds->favorites->size(); j++) {
-            if (menuId == ds->favorites->at(j)->menuId) {
-                if (dsOut) {
-                    *dsOut = ds;
-                }
-                return ds->favorites->at(j);
-            }
-        }
+    int idx = menuId - CmdFavoriteFirst;
+    if (idx < 0 || idx >= gFavMenuEntries.Size()) {
+        return nullptr;
     }
-    return nullptr;
+    FavMenuEntry e = gFavMenuEntries.At(idx);
+    ReportIf(e.fav->menuId != menuId);
+    if (dsOut) {
+        *dsOut = e.fs;
+    }
+    return e.fav;
 }
 
 static FileState* GetByFavorite(Favorite* fn) {
-    FileState* ds;
-    for (size_t i = 0; (ds = gFileHistory.Get(i)) != nullptr; i++) {
+    EnsureFavIndex();
+    for (FileState* ds : gFavFilesSorted) {
         if (ds->favorites->Contains(fn)) {
             return ds;
         }
@@ -238,6 +260,7 @@ static void AddOrReplaceFav(const char* filePath, int pageNo, const char* name,
         fn = NewFavorite(pageNo, name, pageLabel);
         fav->favorites->Append(fn);
         fav->favorites->Sort(SortByPageNo);
+        InvalidateFavIndex();
     }
 }
 
@@ -253,6 +276,7 @@ static void RemoveFav(const char* filePath, int pageNo) {
 
     fav->favorites->Remove(fn);
     DeleteFavorite(fn);
+    InvalidateFavIndex();
 
     if (!gGlobalPrefs->rememberOpenedFiles && 0 == fav->favorites->size()) {
         gFileHistory.Remove(fav);
@@ -270,6 +294,7 @@ static void RemoveAllFavForFile(const char* filePath) {
         DeleteFavorite(fav->favorites->at(i));
     }
     fav->favorites->Reset();
+    InvalidateFavIndex();
 
     if (!gGlobalPrefs->rememberOpenedFiles) {
         gFileHistory.Remove(fav);
@@ -282,13 +307,8 @@ static void RemoveAllFavForFile(const char* filePath) {
 #define MAX_FAV_MENUS 10
 
 bool HasFavorites() {
-    FileState* ds;
-    for (size_t i = 0; (ds = gFileHistory.Get(i)) != nullptr; i++) {
-        if (ds->favorites->size() > 0) {
-            return true;
-        }
-    }
-    return false;
+    EnsureFavIndex();
+    return gFavFilesSorted.Size() > 0;
 }
 
 // caller has to free() the result
@@ -328,6 +348,8 @@ static void AppendFavMenuItems(HMENU m, FileState* f, int& idx, bool combined, b
         }
         Favorite* fn = f->favorites->at(i);
         fn->menuId = idx++;
+        FavMenuEntry e{fn, f};
+        gFavMenuEntries.Append(e);
         TempStr s;
         if (combined) {
             s = FavCompactReadableNameTemp(f, fn, isCurrent);
@@ -356,14 +378,32 @@ static bool SortByBaseFileName(const char* s1, const char* s2) {
     return n < 0;
 }
 
-static void GetSortedFilePaths(StrVec& filePathsSortedOut, FileState* toIgnore = nullptr) {
+// (re-)builds the sorted list of files with favorites when favorites
+// or the file history changed since the last build
+static void EnsureFavIndex() {
+    if (gFavIndexValid && gFavIndexHistoryGeneration == gFileHistoryGeneration) {
+        return;
+    }
+    gFavFilesSorted.Reset();
     FileState* fs;
     for (size_t i = 0; (fs = gFileHistory.Get(i)) != nullptr; i++) {
-        if (fs->favorites->size() > 0 && fs != toIgnore) {
+        if (fs->favorites->size() > 0) {
+            gFavFilesSorted.Append(fs);
+        }
+    }
+    std::sort(gFavFilesSorted.begin(), gFavFilesSorted.end(),
+              [](FileState* f1, FileState* f2) { return SortByBaseFileName(f1->filePath, f2->filePath); });
+    gFavIndexValid = true;
+    gFavIndexHistoryGeneration = gFileHistoryGeneration;
+}
+
+static void GetSortedFilePaths(StrVec& filePathsSortedOut, FileState* toIgnore = nullptr) {
+    EnsureFavIndex();
+    for (FileState* fs : gFavFilesSorted) {
+        if (fs != toIgnore) {
             filePathsSortedOut.Append(fs->filePath);
         }
     }
-    Sort(&filePathsSortedOut, SortByBaseFileName);
 }
 
 // For easy access, we try to show favorites in the menu, similar to a list of
@@ -402,6 +442,7 @@ static void AppendFavMenus(HMENU m, const char* currFilePath) {
     AppendMenuW(m, MF_SEPARATOR, 0, nullptr);
 
     ResetFavMenuIds();
+    gFavMenuEntries.Reset();
     int menuId = CmdFavoriteFirst;
 
     int menusCount = filePathsSorted.Size();
@@ -638,14 +679,16 @@ void PopulateFavTreeIfNeeded(MainWindow* win) {
         return;
     }
     TreeModel* tm = BuildFavTreeModel(win);
-    treeView->SetTreeModel(tm);
+    // collapsed branches materialize on first expansion, so showing
+    // the tree stays fast no matter how many favorites there are
+    treeView->SetTreeModel(tm, true);
 }
 
 void UpdateFavoritesTree(MainWindow* win) {
     TreeView* treeView = win->favTreeView;
     auto* prevModel = treeView->treeModel;
     TreeModel* newModel = BuildFavTreeModel(win);
-    treeView->SetTreeModel(newModel);
+    treeView->SetTreeModel(newModel, true);
     delete prevModel;
 
     // hide the favorites tree if we've removed the last favorite
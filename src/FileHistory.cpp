@@ -2,6 +2,7 @@
 License: GPLv3 */
 
 #include "utils/BaseUtil.h"
+#include "utils/Dict.h"
 #include "utils/DirIter.h"
 #include "utils/FileUtil.h"
 #include "utils/ThreadUtil.h"
@@ -10,6 +11,7 @@ License: GPLv3 */
 
 #include "Settings.h"
 #include "GlobalPrefs.h"
+#include "AppSettings.h"
 #include "FileThumbnails.h"
 #include "FileHistory.h"
 
@@ -37,11 +39,8 @@ We deserialize this info at startup and serialize when the application
 quits.
 */
 
-// maximum number of files to remember in total
-// (to keep the settings file within reasonable bounds)
-constexpr size_t kFileHistoryMaxFiles = 1000;
-
 FileHistory gFileHistory;
+int gFileHistoryGeneration = 0;
 
 // sorts the most often used files first
 static int cmpOpenCount(const void* a, const void* b) {
@@ -63,17 +62,63 @@ static int cmpOpenCount(const void* a, const void* b) {
     return dsA->index < dsB->index ? -1 : 1;
 }
 
+FileHistory::~FileHistory() {
+    delete pathIdx;
+}
+
+// lookups are case-insensitive (history code used str::EqI before the
+// index existed) so the index keys are lower-cased paths
+static TempStr PathIdxKeyTemp(const char* filePath) {
+    TempStr key = str::DupTemp(filePath);
+    str::ToLowerInPlace(key);
+    return key;
+}
+
+void FileHistory::PathIdxInsert(FileState* fs) const {
+    if (!pathIdx || !fs->filePath) {
+        return;
+    }
+    pathIdx->Insert(PathIdxKeyTemp(fs->filePath), fs);
+}
+
+void FileHistory::PathIdxRemove(FileState* fs) const {
+    if (!pathIdx || !fs->filePath) {
+        return;
+    }
+    TempStr key = PathIdxKeyTemp(fs->filePath);
+    // duplicate paths map to a single entry, only remove if it's ours
+    void* mapped = nullptr;
+    if (pathIdx->Get(key, &mapped) && mapped == fs) {
+        pathIdx->Remove(key);
+    }
+}
+
 void FileHistory::Append(FileState* fs) const {
     ReportIf(!fs->filePath);
     states->Append(fs);
+    PathIdxInsert(fs);
+    gFileHistoryGeneration++;
 }
 
 void FileHistory::Remove(FileState* fs) const {
+    PathIdxRemove(fs);
     states->Remove(fs);
+    gFileHistoryGeneration++;
 }
 
 void FileHistory::UpdateStatesSource(Vec<FileState*>* states) {
     this->states = states;
+    if (!pathIdx) {
+        pathIdx = new dict::MapStrToPtr();
+    } else {
+        pathIdx->Reset();
+    }
+    if (states) {
+        for (FileState* fs : *states) {
+            PathIdxInsert(fs);
+        }
+    }
+    gFileHistoryGeneration++;
 }
 
 void FileHistory::Clear(bool keepFavorites) const {
@@ -90,6 +135,13 @@ void FileHistory::Clear(bool keepFavorites) const {
         }
     }
     *states = keep;
+    if (pathIdx) {
+        pathIdx->Reset();
+        for (FileState* fs : keep) {
+            PathIdxInsert(fs);
+        }
+    }
+    gFileHistoryGeneration++;
 }
 
 FileState* FileHistory::Get(size_t index) const {
@@ -100,18 +152,12 @@ FileState* FileHistory::Get(size_t index) const {
 }
 
 FileState* FileHistory::FindByPath(const char* filePath) const {
-    int idxExact = -1;
-    int n = states->Size();
-    for (int i = 0; i < n; i++) {
-        FileState* fs = states->at(i);
-        if (str::EqI(fs->filePath, filePath)) {
-            idxExact = i;
-        }
-    }
-    if (idxExact == -1) {
+    if (!pathIdx) {
         return nullptr;
     }
-    return states->at(idxExact);
+    void* v = nullptr;
+    pathIdx->Get(PathIdxKeyTemp(filePath), &v);
+    return (FileState*)v;
 }
 
 // returns an exact match by path or match by just file name
@@ -151,12 +197,14 @@ FileState* FileHistory::MarkFileLoaded(const char* filePath) const {
     if (!fs) {
         fs = NewDisplayState(filePath);
         fs->useDefaultState = true;
+        PathIdxInsert(fs);
     } else {
         states->Remove(fs);
         fs->isMissing = false;
     }
     states->InsertAt(0, fs);
     fs->openCount++;
+    fs->lastOpened = GetWeekCount();
     return fs;
 }
 
@@ -206,6 +254,39 @@ void FileHistory::GetFrequencyOrder(Vec<FileState*>& list) const {
     list.Sort(cmpOpenCount);
 }
 
+// documents we must never forget: pinned ones, ones we remember a
+// password for and ones with favorites
+static bool CanPruneHistoryEntry(FileState* state) {
+    return !state->isPinned && state->decryptionKey == nullptr && state->favorites->size() == 0;
+}
+
+// returns true if the retention policy (FileHistoryMaxEntries /
+// FileHistoryRetentionDays) says the entry at 1-based position pos in
+// most-recently-used order should be pruned
+static bool ShouldPruneHistoryEntry(FileState* state, size_t pos, int currWeek) {
+    if (!CanPruneHistoryEntry(state)) {
+        return false;
+    }
+    if (pos <= kFileHistoryMaxRecent) {
+        // never prune the entries shown in the File menu
+        return false;
+    }
+    int maxEntries = gGlobalPrefs->fileHistoryMaxEntries;
+    if (maxEntries > 0 && pos > (size_t)maxEntries) {
+        return true;
+    }
+    int retentionDays = gGlobalPrefs->fileHistoryRetentionDays;
+    if (retentionDays > 0 && state->lastOpened > 0) {
+        // lastOpened has week granularity, which is plenty for
+        // retention periods measured in months
+        int ageDays = (currWeek - state->lastOpened) * 7;
+        if (ageDays > retentionDays) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // removes file history entries which shouldn't be saved anymore
 // (see the loop below for the details)
 void FileHistory::Purge(bool alwaysUseDefaultState) const {
@@ -222,18 +303,17 @@ void FileHistory::Purge(bool alwaysUseDefaultState) const {
         }
     }
 
+    int currWeek = GetWeekCount();
     for (size_t j = states->size(); j > 0; j--) {
         FileState* state = states->at(j - 1);
-        // never forget pinned documents, documents we've remembered a password for and
-        // documents for which there are favorites
-        if (state->isPinned || state->decryptionKey != nullptr || state->favorites->size() > 0) {
+        if (!CanPruneHistoryEntry(state)) {
             continue;
         }
         if (state->isMissing && (alwaysUseDefaultState || state->useDefaultState)) {
             // forget about missing documents without valuable state
             states->RemoveAt(j - 1);
-        } else if (j > kFileHistoryMaxFiles) {
-            // forget about files last opened longer ago than the last FILE_HISTORY_MAX_FILES ones
+        } else if (ShouldPruneHistoryEntry(state, j, currWeek)) {
+            // forget about entries beyond the count resp. age limit
             states->RemoveAt(j - 1);
         } else if (alwaysUseDefaultState && state->openCount < minOpenCount && j > kFileHistoryMaxRecent) {
             // forget about files that were hardly used (and without valuable state)
@@ -241,10 +321,101 @@ void FileHistory::Purge(bool alwaysUseDefaultState) const {
         } else {
             continue;
         }
+        PathIdxRemove(state);
         DeleteDisplayState(state);
+        gFileHistoryGeneration++;
     }
 }
 
+extern void MaybeRedrawHomePage();
+
+// prunes the entry at 1-based position pos
+static void PruneHistoryEntryAt(size_t pos) {
+    Vec<FileState*>* states = gFileHistory.states;
+    FileState* state = states->at(pos - 1);
+    states->RemoveAt(pos - 1);
+    gFileHistory.PathIdxRemove(state);
+    DeleteDisplayState(state);
+    gFileHistoryGeneration++;
+}
+
+int CompactFileHistory() {
+    Vec<FileState*>* states = gFileHistory.states;
+    if (!states) {
+        return 0;
+    }
+    int currWeek = GetWeekCount();
+    int nPruned = 0;
+    for (size_t j = states->size(); j > 0; j--) {
+        if (ShouldPruneHistoryEntry(states->at(j - 1), j, currWeek)) {
+            PruneHistoryEntryAt(j);
+            nPruned++;
+        }
+    }
+    logf("CompactFileHistory: pruned %d entries, %d left\n", nPruned, states->Size());
+    return nPruned;
+}
+
+/* Background vacuum.
+
+The history is owned by the UI thread, so instead of a worker thread the
+vacuum runs as a chain of small UI tasks, each scanning a bounded slice
+of the list from its tail; other messages (and document loads) interleave
+freely between the chunks. New files opened while the vacuum runs shift
+positions by at most the number of files opened, which is noise compared
+to the retention limits. */
+
+struct HistoryVacuumState {
+    // position to continue scanning from (downwards)
+    size_t cursor = 0;
+    int currWeek = 0;
+    int nPruned = 0;
+};
+
+constexpr size_t kHistoryVacuumChunkSize = 256;
+
+static void HistoryVacuumChunk(HistoryVacuumState* vs) {
+    Vec<FileState*>* states = gFileHistory.states;
+    size_t j = states ? states->size() : 0;
+    if (vs->cursor < j) {
+        j = vs->cursor;
+    }
+    size_t stop = j > kHistoryVacuumChunkSize ? j - kHistoryVacuumChunkSize : 0;
+    for (; j > stop; j--) {
+        if (ShouldPruneHistoryEntry(states->at(j - 1), j, vs->currWeek)) {
+            PruneHistoryEntryAt(j);
+            vs->nPruned++;
+        }
+    }
+    if (j > 0) {
+        vs->cursor = j;
+        auto fn = MkFunc0<HistoryVacuumState>(HistoryVacuumChunk, vs);
+        uitask::Post(fn, "TaskHistoryVacuum");
+        return;
+    }
+    if (vs->nPruned > 0) {
+        logf("HistoryVacuumChunk: pruned %d entries, %d left\n", vs->nPruned, states->Size());
+        SaveSettings();
+        MaybeRedrawHomePage();
+    }
+    delete vs;
+}
+
+void VacuumFileHistoryAsync() {
+    Vec<FileState*>* states = gFileHistory.states;
+    if (!states || states->size() == 0) {
+        return;
+    }
+    if (gGlobalPrefs->fileHistoryMaxEntries <= 0 && gGlobalPrefs->fileHistoryRetentionDays <= 0) {
+        return;
+    }
+    auto vs = new HistoryVacuumState;
+    vs->cursor = states->size();
+    vs->currWeek = GetWeekCount();
+    auto fn = MkFunc0<HistoryVacuumState>(HistoryVacuumChunk, vs);
+    uitask::Post(fn, "TaskHistoryVacuum");
+}
+
 // list of recently closed documents, most recent at the end
 StrVec gClosedDocuments;
 
@@ -332,11 +503,14 @@ struct FileExistenceData {
     StrVec missing;
 };
 
-extern void MaybeRedrawHomePage();
-
 // document path is either a file or a directory
 // (when browsing images inside directory).
 bool DocumentPathExists(const char* path) {
+    if (path::IsHttpUrl(path)) {
+        // remote documents; whether the server still has the file is
+        // only known when opening it
+        return true;
+    }
     if (file::Exists(path) || dir::Exists(path)) {
         return true;
     }
@@ -413,5 +587,5 @@ void RemoveNonExistentFilesAsync() {
     }
     logf("RemoveNonExistentFilesAsync: starting FileExistenceCheckerThread to check %d files\n", d->toCheck.Size());
     Func0 fn = MkFunc0<FileExistenceData>(FileExistenceCheckerAsync, d);
-    RunAsync(fn, "FileExistenceThread");
+    RunAsync(fn, "FileExistenceThread", ThreadQoS::Background);
 }
@@ -10,13 +10,22 @@
 // Frequent Read list (space permitting)
 #define kFileHistoryMaxFrequent 30
 
+namespace dict {
+class MapStrToPtr;
+}
+
 struct FileHistory {
     // owned by gGlobalPrefs->fileStates
     Vec<FileState*>* states = nullptr;
+    // maps lower-cased filePath => FileState* in states so that
+    // FindByPath() / MarkFileLoaded() don't scan the whole history
+    dict::MapStrToPtr* pathIdx = nullptr;
 
     FileHistory() = default;
-    ~FileHistory() = default;
+    ~FileHistory();
 
+    void PathIdxInsert(FileState* state) const;
+    void PathIdxRemove(FileState* state) const;
     void Clear(bool keepFavorites) const;
     void Append(FileState* state) const;
     void Remove(FileState* state) const;
@@ -31,6 +40,19 @@ struct FileHistory {
 };
 
 extern FileHistory gFileHistory;
+// bumped whenever entries are added to or removed from the history, so
+// that caches built on top of it (e.g. the favorites index) know when
+// to rebuild
+extern int gFileHistoryGeneration;
+
+// applies the history retention policy (FileHistoryMaxEntries /
+// FileHistoryRetentionDays) in small chunks posted to the UI thread, so
+// that multi-year histories shrink without stalling startup; saves the
+// settings when anything was pruned
+void VacuumFileHistoryAsync();
+// applies the full retention policy at once; returns the number of
+// entries pruned
+int CompactFileHistory();
 
 int RecentlyCloseDocumentsCount();
 void RememberRecentlyClosedDocument(const char* path);
@@ -6,12 +6,17 @@
 #include "utils/FileUtil.h"
 #include "utils/DirIter.h"
 #include "utils/GdiPlusUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/UITask.h"
 #include "utils/WinUtil.h"
 
 #include "Settings.h"
 #include "DocController.h"
+#include "EngineBase.h"
+#include "EngineAll.h"
 #include "FzImgReader.h"
 #include "FileHistory.h"
+#include "SumatraPDF.h"
 
 #include "AppTools.h"
 #include "FileThumbnails.h"
@@ -147,3 +152,298 @@ void RemoveThumbnail(FileState* fs) {
     delete fs->thumbnail;
     fs->thumbnail = nullptr;
 }
+
+/* --- background loading and rendering of thumbnails
+
+The Frequently Read page never touches the disk while painting: it only
+draws thumbnails already in memory. LoadMissingThumbnailsAsync() reads
+the cached .png files on a worker thread and patches FileState on the
+UI thread, repainting the page as results arrive, so a cold or slow
+drive can't hang the first paint.
+
+Files without a usable cached thumbnail (fresh install, cleared cache)
+are rendered on low-priority worker threads by opening the engine
+directly; each finished thumbnail is saved to the regular cache and
+also repaints the home page.
+
+The cache directory is shared by all instances of the same user. A named
+mutex per cache entry elects a single writer, so instances running on
+different virtual desktops don't all render a thumbnail for the same
+file: the losers wait for the winner and pick its .png up from the
+shared cache instead. */
+
+#define MAX_THUMB_RENDER_THREADS 4
+
+static Mutex gThumbRenderMux; // guards the queue and the thread count
+static StrVec* gThumbRenderQueue = nullptr;
+static int gThumbRenderThreads = 0;
+// paths we already tried this session, so that files that fail to
+// render (broken, password protected) are not retried on every paint
+static StrVec* gThumbRenderAttempted = nullptr;
+// paths whose cached .png we already tried to read this session
+static StrVec* gThumbLoadAttempted = nullptr;
+
+// SumatraPDF.cpp
+extern void MaybeRedrawHomePage();
+
+struct ThumbRenderResult {
+    char* filePath = nullptr;
+    RenderedBitmap* bmp = nullptr;
+
+    ~ThumbRenderResult() {
+        str::Free(filePath);
+    }
+};
+
+static void ThumbRenderFinish(ThumbRenderResult* d) {
+    FileState* fs = gFileHistory.FindByPath(d->filePath);
+    if (fs && d->bmp) {
+        // takes ownership of the bitmap and writes the .png
+        SetThumbnail(fs, d->bmp);
+        MaybeRedrawHomePage();
+    } else {
+        delete d->bmp;
+    }
+    delete d;
+}
+
+// elects a single writer per cache entry across instances: returns a
+// held named mutex, waiting for another instance that is already
+// rendering the same thumbnail (rendering page 1 rarely takes longer
+// than a second or two). returns nullptr on timeout or failure, in
+// which case the caller renders on its own as before
+static HANDLE AcquireThumbnailWriteLock(const char* thumbPath) {
+    // the fingerprint file name identifies the entry across instances
+    TempStr name = str::FormatTemp("sumatra-thumb-%s", path::GetBaseNameTemp(thumbPath));
+    HANDLE h = CreateMutexW(nullptr, FALSE, ToWStrTemp(name));
+    if (!h) {
+        return nullptr;
+    }
+    DWORD res = WaitForSingleObject(h, 10 * 1000);
+    if (res == WAIT_OBJECT_0 || res == WAIT_ABANDONED) {
+        return h;
+    }
+    CloseHandle(h);
+    return nullptr;
+}
+
+static RenderedBitmap* RenderThumbnailForFile(const char* path) {
+    // no PasswordUI: documents we can't open without asking are skipped
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+    if (!engine) {
+        return nullptr;
+    }
+    RenderedBitmap* bmp = nullptr;
+    RectF pageRect = engine->PageMediabox(1);
+    if (!pageRect.IsEmpty()) {
+        // same cropping as ControllerCallbackHandler::RenderThumbnail
+        pageRect = engine->Transform(pageRect, 1, 1.0f, 0);
+        float zoom = (float)kThumbnailDx / (float)pageRect.dx;
+        if (pageRect.dy > (float)kThumbnailDy / zoom) {
+            pageRect.dy = (float)kThumbnailDy / zoom;
+        }
+        pageRect = engine->Transform(pageRect, 1, 1.0f, 0, true);
+        RenderPageArgs args(1, zoom, 0, &pageRect);
+        bmp = engine->RenderPage(args);
+    }
+    engine->Release();
+    if (bmp && bmp->GetSize().IsEmpty()) {
+        delete bmp;
+        bmp = nullptr;
+    }
+    return bmp;
+}
+
+static void ThumbRenderThread() {
+    // don't compete with rendering of the foreground document
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    for (;;) {
+        gThumbRenderMux.Lock();
+        int n = gThumbRenderQueue->Size();
+        if (0 == n) {
+            gThumbRenderThreads--;
+            gThumbRenderMux.Unlock();
+            return;
+        }
+        char* path = str::Dup(gThumbRenderQueue->RemoveAt(n - 1));
+        gThumbRenderMux.Unlock();
+
+        RenderedBitmap* bmp = nullptr;
+        {
+            ScopedTempAllocMark tempMark;
+            TempStr thumbPath = GetThumbnailPathTemp(path);
+            HANDLE lock = thumbPath ? AcquireThumbnailWriteLock(thumbPath) : nullptr;
+            if (lock) {
+                // another instance might have rendered this thumbnail
+                // while we waited for the lock: use its result
+                bmp = LoadRenderedBitmap(thumbPath);
+                if (bmp && bmp->GetSize().IsEmpty()) {
+                    delete bmp;
+                    bmp = nullptr;
+                }
+            }
+            if (!bmp) {
+                bmp = RenderThumbnailForFile(path);
+            }
+            if (lock) {
+                // the .png write that follows in ThumbRenderFinish is
+                // idempotent (every instance renders the same image), so
+                // it doesn't need to stay under the lock
+                ReleaseMutex(lock);
+                CloseHandle(lock);
+            }
+        }
+        auto d = new ThumbRenderResult{path, bmp};
+        auto fn = MkFunc0<ThumbRenderResult>(ThumbRenderFinish, d);
+        uitask::Post(fn, "TaskThumbRenderFinish");
+    }
+}
+
+// queue files for background rendering and make sure enough worker
+// threads are running to drain the queue
+static void QueueThumbnailRender(const StrVec& paths) {
+    gThumbRenderMux.Lock();
+    if (!gThumbRenderQueue) {
+        gThumbRenderQueue = new StrVec();
+        gThumbRenderAttempted = new StrVec();
+    }
+    for (const char* path : paths) {
+        if (gThumbRenderAttempted->Contains(path)) {
+            continue;
+        }
+        gThumbRenderAttempted->Append(path);
+        gThumbRenderQueue->Append(path);
+    }
+    int nToStart = 0;
+    int nQueued = gThumbRenderQueue->Size();
+    if (nQueued > 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        int maxThreads = limitValue<int>((int)si.dwNumberOfProcessors / 2, 1, MAX_THUMB_RENDER_THREADS);
+        nToStart = std::min(nQueued, maxThreads) - gThumbRenderThreads;
+        if (nToStart < 0) {
+            nToStart = 0;
+        }
+        gThumbRenderThreads += nToStart;
+    }
+    gThumbRenderMux.Unlock();
+
+    auto fn = MkFunc0Void(ThumbRenderThread);
+    for (int i = 0; i < nToStart; i++) {
+        HANDLE hThread = StartThread(fn, "ThumbRenderThread");
+        if (!hThread) {
+            gThumbRenderMux.Lock();
+            gThumbRenderThreads--;
+            gThumbRenderMux.Unlock();
+            break;
+        }
+        // fire and forget: workers exit when the queue runs empty
+        CloseHandle(hThread);
+    }
+}
+
+struct ThumbLoadData {
+    StrVec paths;
+    // filled on the worker thread, parallel to paths; nullptr for
+    // files without a usable cached thumbnail
+    Vec<RenderedBitmap*> loaded;
+};
+
+static void ThumbLoadFinish(ThumbLoadData* d) {
+    StrVec toRender;
+    bool patched = false;
+    int n = d->paths.Size();
+    for (int i = 0; i < n; i++) {
+        const char* path = d->paths[i];
+        RenderedBitmap* bmp = d->loaded[i];
+        FileState* fs = gFileHistory.FindByPath(path);
+        if (!fs) {
+            delete bmp;
+            continue;
+        }
+        if (bmp) {
+            if (fs->thumbnail) {
+                // the file was opened (and its thumbnail re-created)
+                // while we were reading from disk
+                delete bmp;
+            } else {
+                fs->thumbnail = bmp;
+                patched = true;
+            }
+        } else if (!fs->isMissing) {
+            toRender.Append(path);
+        }
+    }
+    if (patched) {
+        MaybeRedrawHomePage();
+    }
+    if (toRender.Size() > 0) {
+        QueueThumbnailRender(toRender);
+    }
+    delete d;
+}
+
+static void ThumbLoadThread(ThumbLoadData* d) {
+    int n = d->paths.Size();
+    for (int i = 0; i < n; i++) {
+        ScopedTempAllocMark tempMark;
+        const char* path = d->paths[i];
+        TempStr bmpPath = GetThumbnailPathTemp(path);
+        RenderedBitmap* bmp = bmpPath ? LoadRenderedBitmap(bmpPath) : nullptr;
+        if (bmp && bmp->GetSize().IsEmpty()) {
+            delete bmp;
+            bmp = nullptr;
+        }
+        if (bmp) {
+            // discard the thumbnail if the file is newer than it
+            FILETIME bmpTime = file::GetModificationTime(bmpPath);
+            FILETIME fileTime = file::GetModificationTime(path);
+            if (FileTimeDiffInSecs(fileTime, bmpTime) > 0) {
+                delete bmp;
+                bmp = nullptr;
+                file::Delete(bmpPath);
+            }
+        }
+        d->loaded.Append(bmp);
+    }
+    auto fn = MkFunc0<ThumbLoadData>(ThumbLoadFinish, d);
+    uitask::Post(fn, "TaskThumbLoadFinish");
+}
+
+// called from the home page (on the UI thread) when it encounters
+// FileState entries without an in-memory thumbnail. All disk access
+// (reading cached .png files, checking their freshness, rendering
+// replacements) happens on worker threads so that painting the start
+// page never blocks on a slow drive
+void LoadMissingThumbnailsAsync() {
+    // same rule as ShouldSaveThumbnail(): without saved preferences
+    // neither the Frequently Read page nor the cache are used
+    if (!HasPermission(Perm::SavePreferences)) {
+        return;
+    }
+    Vec<FileState*> list;
+    gFileHistory.GetFrequencyOrder(list);
+    int iMax = std::min<int>(list.Size(), kFileHistoryMaxFrequent);
+
+    if (!gThumbLoadAttempted) {
+        gThumbLoadAttempted = new StrVec();
+    }
+    auto d = new ThumbLoadData();
+    for (int i = 0; i < iMax; i++) {
+        FileState* fs = list.at(i);
+        if (fs->thumbnail || fs->isMissing) {
+            continue;
+        }
+        if (gThumbLoadAttempted->Contains(fs->filePath)) {
+            continue;
+        }
+        gThumbLoadAttempted->Append(fs->filePath);
+        d->paths.Append(fs->filePath);
+    }
+    if (d->paths.Size() == 0) {
+        delete d;
+        return;
+    }
+    auto fn = MkFunc0<ThumbLoadData>(ThumbLoadThread, d);
+    RunAsync(fn, "ThumbLoadThread", ThreadQoS::Utility);
+}
@@ -6,6 +6,7 @@ constexpr int kThumbnailDx = 212;
 constexpr int kThumbnailDy = 150;
 
 RenderedBitmap* LoadThumbnail(FileState* fs);
+void LoadMissingThumbnailsAsync();
 bool HasThumbnail(FileState* fs);
 void SetThumbnail(FileState* fs, RenderedBitmap* bmp);
 void SaveThumbnail(FileState* fs);
@@ -45,6 +45,7 @@
     V(NewWindow, "new-window")                   \
     V(Log, "log")                                \
     V(CrashOnOpen, "crash-on-open")              \
+    V(Preload, "preload")                        \
     V(ReuseInstance, "reuse-instance")           \
     V(EscToExit, "esc-to-exit")                  \
     V(ArgEnumPrinters, "enum-printers")          \
@@ -63,11 +64,21 @@
     V(AppData, "appdata")                        \
     V(Plugin, "plugin")                          \
     V(StressTest, "stress-test")                 \
+    V(StressIsolated, "stress-isolated")         \
     V(N, "n")                                    \
     V(Max, "max")                                \
     V(Render, "render")                          \
     V(ExtractText, "extract-text")               \
     V(Bench, "bench")                            \
+    V(BenchSuite, "bench-suite")                 \
+    V(GenSymbolMap, "gen-symbol-map")            \
+    V(BenchIter, "bench-iter")                   \
+    V(BenchWarmup, "bench-warmup")               \
+    V(BenchOut, "bench-out")                     \
+    V(StartupBench, "startup-bench")             \
+    V(RenderGolden, "render-golden")             \
+    V(GoldenDir, "golden-dir")                   \
+    V(GoldenUpdate, "golden-update")             \
     V(Dir, "d")                                  \
     V(InstallDir, "install-dir")                 \
     V(Lang, "lang")                              \
@@ -87,6 +98,10 @@
     V(Adobe, "a")                                \
     V(DDE, "dde")                                \
     V(EngineDump, "engine-dump")                 \
+    V(FulltextFast, "fulltext-fast")             \
+    V(ConvertToPdf, "convert-to-pdf")            \
+    V(RecordInput, "record-input")               \
+    V(ReplayInput, "replay-input")               \
     V(SetColorRange, "set-color-range")
 
 #define MAKE_ARG(__arg, __name) __arg,
@@ -462,10 +477,26 @@ void ParseFlags(const WCHAR* cmdLine, Flags& i) {
             i.stressRandomizeFiles = true;
             continue;
         }
+        if (arg == Arg::StressIsolated) {
+            i.stressIsolated = true;
+            continue;
+        }
         if (arg == Arg::Regress) {
             i.regress = true;
             continue;
         }
+        if (arg == Arg::EngineDump) {
+            i.engineDump = true;
+            continue;
+        }
+        if (arg == Arg::FulltextFast) {
+            i.fulltextFast = true;
+            continue;
+        }
+        if (arg == Arg::ConvertToPdf) {
+            i.convertToPdf = true;
+            continue;
+        }
         if (arg == Arg::Extract) {
             i.justExtractFiles = true;
             continue;
@@ -482,6 +513,10 @@ void ParseFlags(const WCHAR* cmdLine, Flags& i) {
             i.inNewWindow = true;
             continue;
         }
+        if (arg == Arg::Preload) {
+            i.preload = true;
+            continue;
+        }
         if (arg == Arg::Log) {
             i.log = true;
             continue;
@@ -500,6 +535,10 @@ void ParseFlags(const WCHAR* cmdLine, Flags& i) {
             i.crashOnOpen = true;
             continue;
         }
+        if (arg == Arg::GoldenUpdate) {
+            i.goldenUpdate = true;
+            continue;
+        }
         if (arg == Arg::ReuseInstance) {
             // for backwards compatibility, -reuse-instance reuses whatever
             // instance has registered as DDE server
@@ -653,6 +692,48 @@ void ParseFlags(const WCHAR* cmdLine, Flags& i) {
             i.exitImmediately = true;
             continue;
         }
+        if (arg == Arg::BenchSuite) {
+            i.benchSuitePath = str::Dup(param);
+            i.exitImmediately = true;
+            continue;
+        }
+        if (arg == Arg::GenSymbolMap) {
+            i.genSymbolMapPath = str::Dup(param);
+            continue;
+        }
+        if (arg == Arg::BenchIter) {
+            i.benchSuiteIters = paramInt;
+            continue;
+        }
+        if (arg == Arg::BenchWarmup) {
+            i.benchSuiteWarmup = paramInt;
+            continue;
+        }
+        if (arg == Arg::BenchOut) {
+            i.benchSuiteOut = str::Dup(param);
+            continue;
+        }
+        if (arg == Arg::StartupBench) {
+            i.startupBenchOut = str::Dup(param);
+            continue;
+        }
+        if (arg == Arg::RecordInput) {
+            i.recordInputPath = str::Dup(param);
+            continue;
+        }
+        if (arg == Arg::ReplayInput) {
+            i.replayInputPath = str::Dup(param);
+            continue;
+        }
+        if (arg == Arg::RenderGolden) {
+            i.goldenPath = str::Dup(param);
+            i.exitImmediately = true;
+            continue;
+        }
+        if (arg == Arg::GoldenDir) {
+            i.goldenDir = str::Dup(param);
+            continue;
+        }
         if (arg == Arg::Dir || arg == Arg::InstallDir) {
             i.installDir = str::Dup(param);
             continue;
@@ -733,6 +814,14 @@ Flags::~Flags() {
     str::Free(appdataDir);
     str::Free(inverseSearchCmdLine);
     str::Free(stressTestPath);
+    str::Free(benchSuitePath);
+    str::Free(benchSuiteOut);
+    str::Free(startupBenchOut);
+    str::Free(recordInputPath);
+    str::Free(replayInputPath);
+    str::Free(goldenPath);
+    str::Free(goldenDir);
+    str::Free(genSymbolMapPath);
     str::Free(stressTestFilter);
     str::Free(stressTestRanges);
     str::Free(lang);
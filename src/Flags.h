@@ -37,6 +37,36 @@ struct Flags {
     //   to benchmark. It can also be a string "loadonly" which means we'll
     //   only benchmark loading of the catalog
     StrVec pathsToBenchmark;
+    // -bench-suite <file or dir>: run the repeatable benchmark suite
+    // and write machine-readable results to benchSuiteOut
+    char* benchSuitePath = nullptr;
+    // -bench-iter: number of measured iterations per file
+    int benchSuiteIters = 3;
+    // -bench-warmup: number of unmeasured warmup passes per file
+    int benchSuiteWarmup = 1;
+    // -gen-symbol-map <path>: write a compact address-to-symbol map of
+    // this exe (requires the .pdb; run on the build machine)
+    char* genSymbolMapPath = nullptr;
+    // -bench-out: where to write the JSON results
+    char* benchSuiteOut = nullptr;
+    // -startup-bench <file>: write the process-creation-to-first-paint
+    // time in ms to <file> once document content reaches the screen,
+    // then exit (driven by `doit.bat -bench-startup`, see do/bench_startup.go)
+    char* startupBenchOut = nullptr;
+    // -record-input <file>: capture timestamped canvas input for later
+    // -replay-input (see src/InputReplay.cpp)
+    char* recordInputPath = nullptr;
+    // -replay-input <file>: replay a recorded input capture with the
+    // original pacing and the frame-timing HUD forced on
+    char* replayInputPath = nullptr;
+    // -render-golden <file or dir>: render the corpus in parallel and
+    // compare per-page pixel hashes against stored goldens (see
+    // RunGoldenRenderTest); missing goldens are created
+    char* goldenPath = nullptr;
+    // -golden-dir: where the golden files are kept (default: "goldens")
+    char* goldenDir = nullptr;
+    // -golden-update: overwrite existing goldens with the current output
+    bool goldenUpdate = false;
     bool exitWhenDone = false;
     bool printDialog = false;
     char* printerName = nullptr;
@@ -44,6 +74,10 @@ struct Flags {
     char* forwardSearchOrigin = nullptr;
     int forwardSearchLine = 0;
     bool reuseDdeInstance = false;
+    // -preload: start a hidden, fully initialized instance that waits
+    // for documents. Explorer opens are handed off to it via the
+    // reuse-instance DDE machinery and skip the cold start entirely
+    bool preload = false;
     char* destName = nullptr;
     int pageNumber = -1;
     bool restrictedUse = false;
@@ -78,6 +112,9 @@ struct Flags {
     int stressTestCycles = 1;
     int stressParallelCount = 1;
     bool stressRandomizeFiles = false;
+    // render every file in a worker process of its own (see
+    // RunIsolatedStressTest)
+    bool stressIsolated = false;
     int stressTestMax = 0;
 
     // related to testing
@@ -87,6 +124,11 @@ struct Flags {
     bool testApp = false;
     char* dde = nullptr;
     bool engineDump = false; // -engine-dump
+    // -fulltext-fast: with -engine-dump, stream the text of all pages
+    // of all documents to stdout instead of the XML dump
+    bool fulltextFast = false;
+    // -convert-to-pdf : batch-convert the given documents to PDF
+    bool convertToPdf = false;
 
     bool crashOnOpen = false;
 
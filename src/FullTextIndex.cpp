@@ -0,0 +1,268 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+/* An opt-in local full-text index over the folders listed in the
+   FullTextIndexFolders setting, feeding the command palette's
+   search-everywhere ('/') mode.
+
+   Indexing crawls the configured folders on a background thread,
+   extracts document text through the regular engines on a few
+   background-QoS workers and stores the lower-cased text per document
+   in a shared memory-mapped cache-file store, keyed by a hash of the
+   document's path. A document whose size and modification time match
+   its stored entry is skipped, so re-runs only pay for new and changed
+   files; entries for deleted documents age out through the store's
+   generation GC. Everything is local - no Windows Search, no service.
+
+   Searching scans the mapped entries directly and is safe to run on
+   the UI thread while indexing is still going. */
+
+#include "utils/BaseUtil.h"
+#include "utils/CacheFile.h"
+#include "utils/CryptoUtil.h"
+#include "utils/DirIter.h"
+#include "utils/FileUtil.h"
+#include "utils/GuessFileType.h"
+#include "utils/ThreadUtil.h"
+#include "utils/Timer.h"
+#include "utils/WinUtil.h"
+
+#include "Settings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "EngineAll.h"
+#include "GlobalPrefs.h"
+#include "FileThumbnails.h"
+#include "FullTextIndex.h"
+
+#include "utils/Log.h"
+
+constexpr u32 kFullTextCacheSlots = 4 * 1024;
+constexpr u32 kFullTextCacheDataSize = 64 * 1024 * 1024;
+// per-document cap; enough for very long books while keeping one
+// pathological document from crowding out the rest of the corpus
+constexpr size_t kFullTextMaxDocBytes = 1024 * 1024;
+constexpr int kMaxFullTextIndexThreads = 4;
+
+// on-disk layout of an index entry: this header followed by the
+// document's path and its lower-cased extracted text, both
+// null-terminated utf-8
+struct FullTextEntry {
+    FILETIME modTime{};
+    i64 fileSize = 0;
+    u32 pathLen = 0; // without terminator
+    u32 textLen = 0; // without terminator
+};
+
+struct FullTextIndexData {
+    StrVec files;
+    AtomicInt fileIdx;
+};
+
+static CacheFile* gFullTextCache = nullptr;
+static HANDLE gFullTextIndexThread = nullptr;
+static LONG gStopFullTextIndexing = 0;
+
+bool IsFullTextIndexEnabled() {
+    Vec<char*>* folders = gGlobalPrefs->fullTextIndexFolders;
+    return folders && folders->Size() > 0;
+}
+
+// same path fingerprinting as the tile stash: portable installations
+// keep working when the drive letter changes
+static void FullTextIndexKey(const char* filePath, u8 key[16]) {
+    TempStr path = str::DupTemp(filePath);
+    if (path::HasVariableDriveLetter(path)) {
+        path[0] = '?';
+    }
+    CalcMD5Digest((u8*)path, str::Leni(path), key);
+}
+
+static void IndexOneFile(const char* path) {
+    u8 key[16];
+    FullTextIndexKey(path, key);
+    FILETIME modTime = file::GetModificationTime(path);
+    i64 fileSize = file::GetSize(path);
+    if (fileSize <= 0) {
+        return;
+    }
+    ByteSlice prev = gFullTextCache->Get(key);
+    if (prev.size() >= sizeof(FullTextEntry)) {
+        FullTextEntry* e = (FullTextEntry*)prev.data();
+        if (e->fileSize == fileSize && FileTimeEq(e->modTime, modTime)) {
+            // up to date
+            return;
+        }
+    }
+
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+    if (!engine) {
+        return;
+    }
+    str::Str text;
+    int nPages = engine->PageCount();
+    for (int pageNo = 1; pageNo <= nPages && !gStopFullTextIndexing; pageNo++) {
+        ScopedTempAllocMark tempMark;
+        PageText pt = engine->ExtractPageText(pageNo);
+        if (pt.text) {
+            TempStr s = ToUtf8Temp(pt.text, pt.len);
+            // stored lower-cased so that searching is a plain substring scan
+            str::ToLowerInPlace(s);
+            text.Append(s);
+            text.AppendChar('\n');
+        }
+        FreePageText(&pt);
+        if (text.size() > kFullTextMaxDocBytes) {
+            break;
+        }
+    }
+    engine->Release();
+    if (gStopFullTextIndexing) {
+        // don't store a partial extraction
+        return;
+    }
+
+    FullTextEntry e;
+    e.modTime = modTime;
+    e.fileSize = fileSize;
+    e.pathLen = (u32)str::Len(path);
+    e.textLen = (u32)text.size();
+    str::Str v;
+    v.Append((const char*)&e, sizeof(e));
+    v.Append(path, e.pathLen + 1);
+    v.Append(text.Get(), e.textLen + 1);
+    bool ok = gFullTextCache->Put(key, v.AsByteSlice());
+    if (!ok) {
+        logf("IndexOneFile: index store full, couldn't add '%s'\n", path);
+    }
+}
+
+static void FullTextIndexWorkerThread(FullTextIndexData* d) {
+    SetCurrentThreadQoS(ThreadQoS::Background);
+    int nFiles = d->files.Size();
+    for (;;) {
+        if (gStopFullTextIndexing) {
+            return;
+        }
+        int i = d->fileIdx.Inc() - 1;
+        if (i >= nFiles) {
+            return;
+        }
+        IndexOneFile(d->files.At(i));
+    }
+}
+
+static void CollectFilesToIndex(const char* dir, StrVec& files) {
+    DirIter di{dir};
+    di.recurse = true;
+    for (DirIterEntry* de : di) {
+        if (gStopFullTextIndexing) {
+            return;
+        }
+        auto path = de->filePath;
+        Kind kind = GuessFileTypeFromName(path);
+        if (IsSupportedFileType(kind, true)) {
+            files.Append(path);
+        }
+    }
+}
+
+static void FullTextIndexThread(FullTextIndexData* d) {
+    SetCurrentThreadQoS(ThreadQoS::Background);
+    auto t = TimeGet();
+    Vec<char*>* folders = gGlobalPrefs->fullTextIndexFolders;
+    for (char* folder : *folders) {
+        CollectFilesToIndex(folder, d->files);
+    }
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, kMaxFullTextIndexThreads);
+    if (nThreads > d->files.Size()) {
+        nThreads = d->files.Size();
+    }
+    HANDLE threads[kMaxFullTextIndexThreads];
+    for (int i = 0; i < nThreads; i++) {
+        auto fn = MkFunc0(FullTextIndexWorkerThread, d);
+        threads[i] = StartThread(fn, "FullTextIndexWorker");
+    }
+    if (nThreads > 0) {
+        WaitForMultipleObjects((DWORD)nThreads, threads, TRUE, INFINITE);
+        for (int i = 0; i < nThreads; i++) {
+            CloseHandle(threads[i]);
+        }
+    }
+    logf("FullTextIndexThread: indexed %d files in %.2f ms\n", d->files.Size(), TimeSinceInMs(t));
+    delete d;
+}
+
+void StartFullTextIndexing() {
+    if (!IsFullTextIndexEnabled() || gFullTextIndexThread) {
+        return;
+    }
+    TempStr dir = GetThumbnailCacheDirTemp();
+    if (!dir::Create(dir)) {
+        return;
+    }
+    TempStr path = path::JoinTemp(dir, "fulltext.cache");
+    gFullTextCache = OpenCacheFile(path, kFullTextCacheSlots, kFullTextCacheDataSize);
+    if (!gFullTextCache) {
+        // a second instance owns the store; it'll do the indexing
+        return;
+    }
+    auto d = new FullTextIndexData();
+    auto fn = MkFunc0(FullTextIndexThread, d);
+    gFullTextIndexThread = StartThread(fn, "FullTextIndex");
+}
+
+void StopFullTextIndexing() {
+    InterlockedExchange(&gStopFullTextIndexing, 1);
+    if (gFullTextIndexThread) {
+        WaitForSingleObject(gFullTextIndexThread, INFINITE);
+        CloseHandle(gFullTextIndexThread);
+        gFullTextIndexThread = nullptr;
+    }
+    CloseCacheFile(gFullTextCache);
+    gFullTextCache = nullptr;
+}
+
+// appends the paths of up to maxHits indexed documents whose text
+// contains every whitespace-separated word of query. Hit paths are
+// only valid while the index store stays open so callers should copy
+// them. Safe to call while indexing is running: the store's reads are
+// lock-free
+void SearchFullTextIndex(const char* query, StrVec& hits, int maxHits) {
+    if (!gFullTextCache || str::IsEmptyOrWhiteSpace(query)) {
+        return;
+    }
+    TempStr q = str::ToLowerInPlace(str::DupTemp(query));
+    StrVec words;
+    Split(&words, q, " ", true);
+    if (words.Size() == 0) {
+        return;
+    }
+    u32 nSlots = gFullTextCache->NumSlots();
+    for (u32 i = 0; i < nSlots && hits.Size() < maxHits; i++) {
+        ByteSlice d = gFullTextCache->GetAt(i);
+        size_t minSize = sizeof(FullTextEntry);
+        if (d.size() < minSize) {
+            continue;
+        }
+        FullTextEntry* e = (FullTextEntry*)d.data();
+        if (d.size() < minSize + e->pathLen + 1 + e->textLen + 1) {
+            continue;
+        }
+        const char* path = (const char*)d.data() + sizeof(FullTextEntry);
+        const char* text = path + e->pathLen + 1;
+        bool matches = true;
+        for (char* word : words) {
+            if (!str::Contains(text, word)) {
+                matches = false;
+                break;
+            }
+        }
+        if (matches) {
+            hits.Append(path);
+        }
+    }
+}
@@ -0,0 +1,7 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+bool IsFullTextIndexEnabled();
+void StartFullTextIndexing();
+void StopFullTextIndexing();
+void SearchFullTextIndex(const char* query, StrVec& hits, int maxHits);
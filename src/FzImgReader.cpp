@@ -14,6 +14,7 @@ extern "C" {
 #include "utils/WinUtil.h"
 #include "utils/GdiPlusUtil.h"
 #include "utils/FileUtil.h"
+#include "utils/PixelConvert.h"
 
 #include "FzImgReader.h"
 
@@ -33,6 +34,59 @@ static void fz_unlock_context_cs(void* user, int lock) {
     LeaveCriticalSection(&ctx->mutexes[lock]);
 }
 
+/* Counting allocator shared by all mupdf contexts created in this process
+   so that we can answer how much memory mupdf is holding (fz stores,
+   loaded fonts, display lists, ...). We need the size at free time, so we
+   stash it in a small header in front of the returned block (16 bytes to
+   preserve malloc's 16-byte alignment). */
+constexpr size_t kCountingAllocHdrSize = 16;
+
+static volatile LONGLONG gFzAllocatedBytes = 0;
+
+static void* fz_malloc_counting(void*, size_t size) {
+    u8* p = (u8*)malloc(size + kCountingAllocHdrSize);
+    if (!p) {
+        return nullptr;
+    }
+    *(size_t*)p = size;
+    InterlockedAdd64(&gFzAllocatedBytes, (LONGLONG)size);
+    return p + kCountingAllocHdrSize;
+}
+
+static void fz_free_counting(void*, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    u8* p = (u8*)ptr - kCountingAllocHdrSize;
+    InterlockedAdd64(&gFzAllocatedBytes, -(LONGLONG)*(size_t*)p);
+    free(p);
+}
+
+static void* fz_realloc_counting(void* user, void* ptr, size_t size) {
+    if (!ptr) {
+        return fz_malloc_counting(user, size);
+    }
+    if (0 == size) {
+        fz_free_counting(user, ptr);
+        return nullptr;
+    }
+    u8* p = (u8*)ptr - kCountingAllocHdrSize;
+    LONGLONG oldSize = (LONGLONG)*(size_t*)p;
+    p = (u8*)realloc(p, size + kCountingAllocHdrSize);
+    if (!p) {
+        return nullptr;
+    }
+    *(size_t*)p = size;
+    InterlockedAdd64(&gFzAllocatedBytes, (LONGLONG)size - oldSize);
+    return p + kCountingAllocHdrSize;
+}
+
+fz_alloc_context fz_alloc_ctx_counting = {nullptr, fz_malloc_counting, fz_realloc_counting, fz_free_counting};
+
+i64 fz_allocated_bytes() {
+    return (i64)gFzAllocatedBytes;
+}
+
 fz_context* fz_new_context_windows(size_t maxStore) {
     auto c = new MupdfContext();
     for (int i = 0; i < FZ_LOCK_MAX; i++) {
@@ -41,7 +95,7 @@ fz_context* fz_new_context_windows(size_t maxStore) {
     c->fz_locks_ctx.user = c;
     c->fz_locks_ctx.lock = fz_lock_context_cs;
     c->fz_locks_ctx.unlock = fz_unlock_context_cs;
-    c->ctx = fz_new_context(nullptr, &c->fz_locks_ctx, maxStore);
+    c->ctx = fz_new_context(&fz_alloc_ctx_counting, &c->fz_locks_ctx, maxStore);
     return c->ctx;
 }
 
@@ -101,26 +155,40 @@ static Gdiplus::Bitmap* ImageFromJpegData(fz_context* ctx, const u8* data, int l
     fz_var(bmp);
     fz_var(bmpRect);
 
+    // reading whole rows and converting them in bulk is much faster
+    // than going through fz_read() for every pixel
+    u8* grayRow = nullptr;
+    if (1 == cs->n) {
+        grayRow = AllocArrayTemp<u8>(w);
+        if (!grayRow) {
+            bmp.UnlockBits(&bmpData);
+            fz_drop_stream(ctx, stm);
+            fz_drop_colorspace(ctx, cs);
+            return nullptr;
+        }
+    }
+
     fz_try(ctx) {
         for (int y = 0; y < h; y++) {
             u8* line = (u8*)bmpData.Scan0 + y * bmpData.Stride;
-            for (int x = 0; x < w; x++) {
-                int read = (int)fz_read(ctx, stm, line, cs->n);
-                if (read != cs->n) {
+            if (3 == cs->n) { // RGB -> BGR
+                int read = (int)fz_read(ctx, stm, line, w * 3);
+                if (read != w * 3) {
                     fz_throw(ctx, FZ_ERROR_GENERIC, "insufficient data for image");
                 }
-                if (3 == cs->n) { // RGB -> BGR
-                    std::swap(line[0], line[2]);
-                    line += 3;
-                } else if (1 == cs->n) { // gray -> BGR
-                    line[1] = line[2] = line[0];
-                    line += 3;
-                } else if (4 == cs->n) { // CMYK color inversion
-                    for (int k = 0; k < 4; k++) {
-                        line[k] = 255 - line[k];
-                    }
-                    line += 4;
+                RowSwapRB24(line, w);
+            } else if (1 == cs->n) { // gray -> BGR
+                int read = (int)fz_read(ctx, stm, grayRow, w);
+                if (read != w) {
+                    fz_throw(ctx, FZ_ERROR_GENERIC, "insufficient data for image");
+                }
+                RowGrayToBgr24(line, grayRow, w);
+            } else if (4 == cs->n) { // CMYK color inversion
+                int read = (int)fz_read(ctx, stm, line, w * 4);
+                if (read != w * 4) {
+                    fz_throw(ctx, FZ_ERROR_GENERIC, "insufficient data for image");
                 }
+                RowInvertBytes(line, w * 4);
             }
         }
     }
@@ -7,6 +7,8 @@ constexpr size_t kFzStoreDefault = 256 << 20;
 struct fz_context;
 fz_context* fz_new_context_windows(size_t maxStore = kFzStoreUnlimited);
 void fz_drop_context_windows(fz_context* ctx);
+// live bytes currently allocated through mupdf contexts
+i64 fz_allocated_bytes();
 
 Gdiplus::Bitmap* FzImageFromData(const ByteSlice&);
 
@@ -27,6 +27,16 @@ void DeleteDisplayState(FileState* fs) {
     FreeStruct(&gFileStateInfo, fs);
 }
 
+// serializes a single FileState for the settings change journal,
+// see SaveSettings() in AppSettings.cpp. caller has to free()
+ByteSlice SerializeFileState(FileState* fs) {
+    return SerializeStruct(&gFileStateInfo, fs);
+}
+
+FileState* NewFileStateFromData(const char* data) {
+    return (FileState*)DeserializeStruct(&gFileStateInfo, data);
+}
+
 Favorite* NewFavorite(int pageNo, const char* name, const char* pageLabel) {
     Favorite* fav = (Favorite*)DeserializeStruct(&gFavoriteInfo, nullptr);
     fav->pageNo = pageNo;
@@ -71,6 +81,22 @@ ByteSlice SerializeGlobalPrefs(GlobalPrefs* prefs, const char* prevData) {
     return serialized;
 }
 
+// binary snapshot of the settings for fast loading, see
+// LoadSettings() / SaveSettings() in AppSettings.cpp
+ByteSlice SerializeGlobalPrefsToBin(GlobalPrefs* prefs) {
+    return SerializeStructBin(&gGlobalPrefsInfo, prefs);
+}
+
+// returns nullptr if data doesn't decode cleanly; caller has to verify
+// the fingerprint via GetGlobalPrefsFingerprint() before calling
+GlobalPrefs* NewGlobalPrefsFromBin(const ByteSlice& data) {
+    return (GlobalPrefs*)DeserializeStructBin(&gGlobalPrefsInfo, data);
+}
+
+u32 GetGlobalPrefsFingerprint() {
+    return GetStructInfoFingerprint(&gGlobalPrefsInfo);
+}
+
 void DeleteGlobalPrefs(GlobalPrefs* gp) {
     if (!gp) {
         return;
@@ -99,6 +125,19 @@ TabState* NewTabState(FileState* fs) {
     return state;
 }
 
+TabState* CloneTabState(TabState* ts) {
+    TabState* state = (TabState*)DeserializeStruct(&gTabStateInfo, nullptr);
+    str::ReplaceWithCopy(&state->filePath, ts->filePath);
+    str::ReplaceWithCopy(&state->displayMode, ts->displayMode);
+    state->pageNo = ts->pageNo;
+    str::ReplaceWithCopy(&state->zoom, ts->zoom);
+    state->rotation = ts->rotation;
+    state->scrollPos = ts->scrollPos;
+    state->showToc = ts->showToc;
+    *state->tocState = *ts->tocState;
+    return state;
+}
+
 void ResetSessionState(Vec<SessionData*>* sessionData) {
     ReportIf(!sessionData);
     if (!sessionData) {
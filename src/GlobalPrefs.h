@@ -5,16 +5,22 @@ extern GlobalPrefs* gGlobalPrefs;
 
 FileState* NewDisplayState(const char* filePath);
 void DeleteDisplayState(FileState* fs);
+ByteSlice SerializeFileState(FileState* fs);
+FileState* NewFileStateFromData(const char* data);
 
 Favorite* NewFavorite(int pageNo, const char* name, const char* pageLabel);
 void DeleteFavorite(Favorite* fav);
 
 GlobalPrefs* NewGlobalPrefs(const char* data);
 ByteSlice SerializeGlobalPrefs(GlobalPrefs* prefs, const char* prevData);
+ByteSlice SerializeGlobalPrefsToBin(GlobalPrefs* prefs);
+GlobalPrefs* NewGlobalPrefsFromBin(const ByteSlice& data);
+u32 GetGlobalPrefsFingerprint();
 void DeleteGlobalPrefs(GlobalPrefs* gp);
 
 SessionData* NewSessionData();
 TabState* NewTabState(FileState* fs);
+TabState* CloneTabState(TabState* ts);
 void ResetSessionState(Vec<SessionData*>* sessionData);
 ParsedColor* GetParsedColor(const char* s, ParsedColor& parsed);
 COLORREF GetParsedCOLORREF(const char* s, ParsedColor& parsed, COLORREF def);
@@ -762,6 +762,7 @@ void LayoutHomePage(HomePageLayout& l) {
     freqRead->SetBounds(rcHdr);
 
     int nFiles = fileStates.Size();
+    bool missingThumbs = false;
     for (int row = 0; row < thumbsRows; row++) {
         for (int col = 0; col < thumbsCols; col++) {
             if (row * thumbsCols + col >= nFiles) {
@@ -779,7 +780,10 @@ void LayoutHomePage(HomePageLayout& l) {
             if (isRtl) {
                 rcPage.x = rc.dx - rcPage.x - rcPage.dx;
             }
-            RenderedBitmap* thumbImg = LoadThumbnail(fs);
+            // only uses thumbnails already in memory: disk access
+            // happens on background threads so that a cold or slow
+            // drive can't hang the first paint
+            RenderedBitmap* thumbImg = fs->thumbnail;
             if (thumbImg) {
                 Size szThumb = thumbImg->GetSize();
                 if (szThumb.dx != kThumbnailDx || szThumb.dy != kThumbnailDy) {
@@ -787,6 +791,8 @@ void LayoutHomePage(HomePageLayout& l) {
                     rcPage.y += kThumbnailDy - rcPage.dy;
                 }
                 thumb.szThumb = szThumb;
+            } else {
+                missingThumbs = true;
             }
             thumb.rcPage = rcPage;
             int iconSpace = DpiScale(hdc, 20);
@@ -800,6 +806,11 @@ void LayoutHomePage(HomePageLayout& l) {
             win->staticLinks.Append(thumb.sl);
         }
     }
+    if (missingThumbs) {
+        // load (or render) them in the background; each finished
+        // thumbnail triggers a repaint of this page
+        LoadMissingThumbnailsAsync();
+    }
     /* bottom links */
     rc.y +=
         kThumbsMarginTop + thumbsRows * kThumbnailDy + (thumbsRows - 1) * kThumbsSpaceBetweenY + kThumbsMarginBottom;
@@ -886,7 +897,7 @@ static void DrawHomePageLayout(const HomePageLayout& l) {
         FileState* fs = thumb.fs;
         const Rect& page = thumb.rcPage;
 
-        RenderedBitmap* thumbImg = LoadThumbnail(fs);
+        RenderedBitmap* thumbImg = fs->thumbnail;
         if (thumbImg) {
             HRGN clip = CreateRoundRectRgn(page.x, page.y, page.x + page.dx, page.y + page.dy, 10, 10);
             SelectClipRgn(hdc, clip);
@@ -8,6 +8,7 @@
 #include "utils/HtmlPullParser.h"
 #include "mui/Mui.h"
 #include "utils/Timer.h"
+#include "utils/PerfTrace.h"
 
 #include "EbookBase.h"
 #include "FzImgReader.h"
@@ -177,6 +178,26 @@ HtmlFormatter::HtmlFormatter(HtmlFormatterArgs* args)
     styleStack.Append(style);
     nextPageStyle = styleStack.Last();
 
+    if (args->resumeFrom) {
+        // restore the state captured by SaveCheckpoint() so that
+        // styling matches a full format from the beginning
+        HtmlFormatterCheckpoint* cp = args->resumeFrom;
+        currReparseIdx = cp->reparseIdx;
+        htmlParser->SetCurrPosOff(currReparseIdx);
+        ReportIf(!ValidReparseIdx(currReparseIdx, htmlParser));
+        styleStack = cp->styleStack;
+        nextPageStyle = cp->nextPageStyle;
+        tagNesting = cp->tagNesting;
+        styleRules = cp->styleRules;
+        listDepth = cp->listDepth;
+        preFormatted = cp->preFormatted;
+        dirRtl = cp->dirRtl;
+    }
+    if (args->checkpointEveryNPages > 0) {
+        checkpoints = args->checkpoints;
+        checkpointEveryNPages = args->checkpointEveryNPages;
+    }
+
     textMeasure->SetFont(CurrFont());
 
     lineSpacing = textMeasure->GetCurrFontLineSpacing();
@@ -717,6 +738,15 @@ void HtmlFormatter::EmitTextRun(const char* s, const char* end) {
             currReparseIdx = s - htmlParser->Start();
         }
 
+        // fast path: the width of a word we've measured before (with the
+        // same font) is just a table lookup away
+        RectF bbox;
+        if (wordWidths.Get(CurrFont(), s, end - s, bbox) && bbox.dx <= pageDx - currX) {
+            AppendInstr(DrawInstr::Str(s, end - s, bbox, dirRtl));
+            currX += bbox.dx;
+            break;
+        }
+
         WCHAR* buf = ToWStrTemp(s, end - s);
         size_t strLen = str::Len(buf);
         // soft hyphens should not be displayed
@@ -725,7 +755,8 @@ void HtmlFormatter::EmitTextRun(const char* s, const char* end) {
             break;
         }
         textMeasure->SetFont(CurrFont());
-        RectF bbox = textMeasure->Measure(buf, strLen);
+        bbox = textMeasure->Measure(buf, strLen);
+        wordWidths.Remember(CurrFont(), s, end - s, bbox);
         if (bbox.dx <= pageDx - currX) {
             AppendInstr(DrawInstr::Str(s, end - s, bbox, dirRtl));
             currX += bbox.dx;
@@ -980,6 +1011,23 @@ StyleRule* HtmlFormatter::FindStyleRule(HtmlTag tag, const char* clazz, size_t c
     return nullptr;
 }
 
+// books repeat a handful of style strings across thousands of elements,
+// so parsing a style="..." attribute once and reusing the rule for every
+// repetition saves re-tokenizing the same string over and over
+StyleRule HtmlFormatter::ParseInlineStyleCached(const char* s, size_t len) {
+    u32 hash = MurmurHash2(s, len);
+    for (size_t i = 0; i < inlineStyleCache.size(); i++) {
+        StyleRule& rule = inlineStyleCache.at(i);
+        if (hash == rule.classHash) {
+            return rule;
+        }
+    }
+    StyleRule rule = StyleRule::Parse(s, len);
+    rule.classHash = hash;
+    inlineStyleCache.Append(rule);
+    return rule;
+}
+
 StyleRule HtmlFormatter::ComputeStyleRule(HtmlToken* t) {
     StyleRule rule;
     // get style rules ordered by specificity
@@ -1009,7 +1057,7 @@ StyleRule HtmlFormatter::ComputeStyleRule(HtmlToken* t) {
     }
     attr = t->GetAttrByName("style");
     if (attr) {
-        StyleRule newRule = StyleRule::Parse(attr->val, attr->valLen);
+        StyleRule newRule = ParseInlineStyleCached(attr->val, attr->valLen);
         rule.Merge(newRule);
     }
     return rule;
@@ -1331,6 +1379,7 @@ static bool IsEmptyPage(HtmlPage* p) {
 // or more pages, which we remeber and send to the caller
 // if we detect accumulated pages.
 HtmlPage* HtmlFormatter::Next(bool skipEmptyPages) {
+    PerfTraceScope trace("HtmlFormatter::Next");
     InterlockedIncrement(&gAllowAllocFailure);
     defer {
         InterlockedDecrement(&gAllowAllocFailure);
@@ -1353,6 +1402,14 @@ HtmlPage* HtmlFormatter::Next(bool skipEmptyPages) {
         if (finishedParsing) {
             return nullptr;
         }
+        // remember the formatter state between tokens so that a
+        // re-format (e.g. after a layout change) can restart from here
+        // instead of from the beginning of the document. Only at a
+        // clean boundary: no partial line and not inside a link
+        if (checkpoints && pageCount >= lastCheckpointPageCount + checkpointEveryNPages &&
+            0 == currLineInstr.size() && 0 == currLinkIdx) {
+            SaveCheckpoint();
+        }
         HtmlToken* t = htmlParser->Next();
         if (!t || t->IsError()) {
             break;
@@ -1378,6 +1435,38 @@ HtmlPage* HtmlFormatter::Next(bool skipEmptyPages) {
     return Next();
 }
 
+void HtmlFormatter::SaveCheckpoint() {
+    ptrdiff_t off = htmlParser->CurrPosOff();
+    ReportIf(off > INT_MAX);
+    auto cp = new HtmlFormatterCheckpoint();
+    cp->reparseIdx = (int)off;
+    cp->styleStack = styleStack;
+    cp->nextPageStyle = nextPageStyle;
+    cp->tagNesting = tagNesting;
+    cp->styleRules = styleRules;
+    cp->listDepth = listDepth;
+    cp->preFormatted = preFormatted;
+    cp->dirRtl = dirRtl;
+    SaveCheckpointState(cp);
+    checkpoints->Append(cp);
+    lastCheckpointPageCount = pageCount;
+}
+
+// checkpoints are recorded in document order, so take the last one
+// that doesn't start past reparseIdx
+HtmlFormatterCheckpoint* FindCheckpointBefore(Vec<HtmlFormatterCheckpoint*>* checkpoints, int reparseIdx) {
+    if (!checkpoints) {
+        return nullptr;
+    }
+    for (size_t i = checkpoints->size(); i > 0; i--) {
+        HtmlFormatterCheckpoint* cp = checkpoints->at(i - 1);
+        if (cp->reparseIdx <= reparseIdx) {
+            return cp;
+        }
+    }
+    return nullptr;
+}
+
 // convenience method to format the whole html
 Vec<HtmlPage*>* HtmlFormatter::FormatAllPages(bool skipEmptyPages) {
     Vec<HtmlPage*>* pages = new Vec<HtmlPage*>();
@@ -122,6 +122,35 @@ struct HtmlPage {
     bool gotElements = false;
 };
 
+// snapshot of HtmlFormatter's parsing state taken between tokens.
+// Allows re-formatting to restart from the nearest checkpoint before a
+// given position instead of from the beginning of the document, with
+// the same styling as a full format (cf. the TODO at HtmlPage).
+// Holds pointers into the global font cache, so don't reuse after the
+// font name or size changed
+struct HtmlFormatterCheckpoint {
+    // offset within html data where parsing resumes
+    int reparseIdx = 0;
+
+    Vec<DrawStyle> styleStack;
+    DrawStyle nextPageStyle;
+    Vec<HtmlTag> tagNesting;
+    Vec<StyleRule> styleRules;
+    int listDepth = 0;
+    bool preFormatted = false;
+    bool dirRtl = false;
+
+    // extra state of the EbookFormatter subclasses
+    // (saved via HtmlFormatter::SaveCheckpointState)
+    AutoFreeStr pagePath;   // EpubFormatter
+    size_t hiddenDepth = 0; // EpubFormatter
+    int section = 1;        // Fb2Formatter
+    int titleCount = 0;     // Fb2Formatter
+};
+
+// returns the latest checkpoint at or before reparseIdx, nullptr if none
+HtmlFormatterCheckpoint* FindCheckpointBefore(Vec<HtmlFormatterCheckpoint*>* checkpoints, int reparseIdx);
+
 // just to pack args to HtmlFormatter
 struct HtmlFormatterArgs {
     HtmlFormatterArgs() = default;
@@ -152,6 +181,15 @@ struct HtmlFormatterArgs {
     // we start parsing from htmlStr + reparseIdx
     int reparseIdx = 0;
 
+    // if set, parsing starts from this checkpoint's reparseIdx with
+    // the formatter state restored (takes precedence over reparseIdx)
+    HtmlFormatterCheckpoint* resumeFrom = nullptr;
+
+    // if set, a checkpoint is appended here (caller owns them) every
+    // checkpointEveryNPages pages
+    Vec<HtmlFormatterCheckpoint*>* checkpoints = nullptr;
+    int checkpointEveryNPages = 16;
+
     AutoFreeWStr fontName;
 };
 
@@ -185,6 +223,11 @@ class HtmlFormatter {
     }
     virtual void HandleTagLink(HtmlToken*) {
     }
+    // for subclasses to add their own state to a checkpoint; restoring
+    // it is up to the subclass' constructor (the base constructor runs
+    // before the subclass' members exist)
+    virtual void SaveCheckpointState(HtmlFormatterCheckpoint*) {
+    }
 
     float CurrLineDx();
     float CurrLineDy();
@@ -220,6 +263,7 @@ class HtmlFormatter {
     void ParseStyleSheet(const char* data, size_t len);
     StyleRule* FindStyleRule(HtmlTag tag, const char* clazz, size_t clazzLen);
     StyleRule ComputeStyleRule(HtmlToken* t);
+    StyleRule ParseInlineStyleCached(const char* s, size_t len);
 
     void AppendInstr(const DrawInstr& di);
     bool IsCurrLineEmpty();
@@ -237,6 +281,10 @@ class HtmlFormatter {
     float defaultFontSize = 0;
     Allocator* textAllocator = nullptr;
     mui::ITextRender* textMeasure = nullptr;
+    // widths of recently measured words keyed by the raw utf8 run, so
+    // that repeated words skip both the utf16 conversion and the
+    // measuring call (books reuse a small vocabulary)
+    mui::MeasuredTextCache wordWidths;
 
     // style stack of the current line
     Vec<DrawStyle> styleStack;
@@ -259,6 +307,9 @@ class HtmlFormatter {
     bool keepTagNesting = false;
     // set from CSS and to be checked by the individual tag handlers
     Vec<StyleRule> styleRules;
+    // parsed style="..." attributes, keyed via classHash by the hash of
+    // the raw attribute string
+    Vec<StyleRule> inlineStyleCache;
 
     // isntructions for the current line
     Vec<DrawInstr> currLineInstr;
@@ -282,6 +333,13 @@ class HtmlFormatter {
     // for detection of cover image duplicates in mobi formatting
     int pageCount = 0;
 
+    // where to record checkpoints (owned by the caller), if requested
+    Vec<HtmlFormatterCheckpoint*>* checkpoints = nullptr;
+    int checkpointEveryNPages = 0;
+    int lastCheckpointPageCount = 0;
+
+    void SaveCheckpoint();
+
   public:
     explicit HtmlFormatter(HtmlFormatterArgs* args);
     HtmlFormatter(HtmlFormatter const&) = delete;
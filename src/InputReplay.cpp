@@ -0,0 +1,252 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+/* A record / replay harness for input-driven performance bugs, most
+   notably scroll jank that only reproduces with a particular input
+   cadence.
+
+   -record-input <file> captures the input messages reaching the main
+   window's canvas and frame (mouse moves, buttons, wheel, keys) with
+   millisecond timestamps into a plain-text file, one event per line.
+   -replay-input <file> plays such a capture back with the original
+   pacing by posting the messages from a background thread, and forces
+   the frame-timing HUD on so that paint times and render latencies can
+   be compared across builds. Together they make scrolling-latency
+   regressions mechanically bisectable: record a janky session once,
+   replay it against each candidate build.
+
+   Mouse coordinates (including the wheel's, which Windows delivers in
+   screen space) are stored relative to the target window, so a capture
+   replays correctly regardless of window placement; the window size
+   and the opened document should match the recording session, though.
+   Limitations: modifier key state isn't synthesized (a replayed
+   Ctrl+wheel won't zoom) and input to the toolbar, sidebar and dialogs
+   isn't captured. */
+
+#include "utils/BaseUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/Timer.h"
+#include "utils/WinUtil.h"
+
+#include "wingui/UIModels.h"
+
+#include "Settings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "SumatraPDF.h"
+#include "MainWindow.h"
+#include "InputReplay.h"
+
+#include "utils/Log.h"
+
+struct InputReplayEvent {
+    DWORD dt = 0;      // ms since the first recorded event
+    char target = 'c'; // 'c' = the canvas, 'f' = the frame
+    UINT msg = 0;
+    WPARAM wp = 0;
+    LPARAM lp = 0;
+};
+
+struct InputReplayData {
+    Vec<InputReplayEvent> events;
+    HWND hwndFrame = nullptr;
+    HWND hwndCanvas = nullptr;
+};
+
+static bool gIsRecording = false;
+static AutoFreeStr gRecordPath;
+static DWORD gRecordStartTime = 0;
+static int gRecordedCount = 0;
+static str::Str gRecorded;
+
+static HANDLE gReplayThread = nullptr;
+static LONG gStopInputReplay = 0;
+
+static bool IsRecordableMessage(UINT msg) {
+    switch (msg) {
+        case WM_MOUSEMOVE:
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        case WM_LBUTTONDBLCLK:
+        case WM_MBUTTONDOWN:
+        case WM_MBUTTONUP:
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+        case WM_RBUTTONDBLCLK:
+        case WM_MOUSEWHEEL:
+        case WM_MOUSEHWHEEL:
+        case WM_KEYDOWN:
+        case WM_KEYUP:
+        case WM_SYSKEYDOWN:
+        case WM_SYSKEYUP:
+            // WM_CHAR is deliberately absent: TranslateMessage()
+            // regenerates it from the replayed key events
+            return true;
+    }
+    return false;
+}
+
+bool IsRecordingInput() {
+    return gIsRecording;
+}
+
+void StartInputRecording(const char* path) {
+    gRecordPath.SetCopy(path);
+    gRecorded.Reset();
+    gRecordedCount = 0;
+    gRecordStartTime = 0;
+    gIsRecording = true;
+    logf("StartInputRecording: recording input to '%s'\n", path);
+}
+
+// called by the message loop for every retrieved message, before
+// translation and dispatch
+void RecordInputMessage(const MSG& msg) {
+    if (!gIsRecording || !IsRecordableMessage(msg.message)) {
+        return;
+    }
+    MainWindow* win = FindMainWindowByHwnd(msg.hwnd);
+    if (!win) {
+        return;
+    }
+    char target;
+    if (msg.hwnd == win->hwndCanvas) {
+        target = 'c';
+    } else if (msg.hwnd == win->hwndFrame) {
+        target = 'f';
+    } else {
+        return;
+    }
+    if (0 == gRecordStartTime) {
+        // time stamps are relative to the first event so that replay
+        // doesn't sit through the idle time before the user started
+        // scrolling
+        gRecordStartTime = msg.time;
+    }
+    LPARAM lp = msg.lParam;
+    if (WM_MOUSEWHEEL == msg.message || WM_MOUSEHWHEEL == msg.message) {
+        POINT pt = {GET_X_LPARAM(lp), GET_Y_LPARAM(lp)};
+        ScreenToClient(msg.hwnd, &pt);
+        lp = MAKELPARAM(pt.x, pt.y);
+    }
+    DWORD dt = msg.time - gRecordStartTime;
+    gRecorded.AppendFmt("%u %c %u 0x%x 0x%x\n", (uint)dt, target, (uint)msg.message, (uint)msg.wParam, (uint)(DWORD)lp);
+    gRecordedCount++;
+}
+
+void StopInputRecording() {
+    if (!gIsRecording) {
+        return;
+    }
+    gIsRecording = false;
+    bool ok = file::WriteFile(gRecordPath, gRecorded.AsByteSlice());
+    if (ok) {
+        logf("StopInputRecording: wrote %d events to '%s'\n", gRecordedCount, gRecordPath.Get());
+    } else {
+        logf("StopInputRecording: failed to write '%s'\n", gRecordPath.Get());
+    }
+    gRecorded.Reset();
+}
+
+static bool ParseReplayLine(const char* line, InputReplayEvent& ev) {
+    char* s = (char*)line;
+    ev.dt = strtoul(s, &s, 10);
+    while (*s == ' ') {
+        s++;
+    }
+    if (*s != 'c' && *s != 'f') {
+        return false;
+    }
+    ev.target = *s++;
+    ev.msg = strtoul(s, &s, 10);
+    if (!IsRecordableMessage(ev.msg)) {
+        return false;
+    }
+    ev.wp = (WPARAM)strtoul(s, &s, 16);
+    // sign-extend so that packed negative coordinates survive
+    ev.lp = (LPARAM)(LONG)strtoul(s, &s, 16);
+    return true;
+}
+
+static void InputReplayThread(InputReplayData* d) {
+    auto t = TimeGet();
+    DWORD start = GetTickCount();
+    int nPosted = 0;
+    int nEvents = d->events.Size();
+    for (int i = 0; i < nEvents && !gStopInputReplay; i++) {
+        InputReplayEvent& ev = d->events.At(i);
+        // sleep up to the event's timestamp in small slices so that
+        // shutdown doesn't have to wait out a long gap in the capture
+        for (;;) {
+            DWORD elapsed = GetTickCount() - start;
+            if (elapsed >= ev.dt || gStopInputReplay) {
+                break;
+            }
+            Sleep(std::min(ev.dt - elapsed, (DWORD)50));
+        }
+        if (gStopInputReplay) {
+            break;
+        }
+        HWND hwnd = ('f' == ev.target) ? d->hwndFrame : d->hwndCanvas;
+        LPARAM lp = ev.lp;
+        if (WM_MOUSEWHEEL == ev.msg || WM_MOUSEHWHEEL == ev.msg) {
+            POINT pt = {GET_X_LPARAM(lp), GET_Y_LPARAM(lp)};
+            ClientToScreen(hwnd, &pt);
+            lp = MAKELPARAM(pt.x, pt.y);
+        }
+        PostMessageW(hwnd, ev.msg, ev.wp, lp);
+        nPosted++;
+    }
+    logf("InputReplayThread: posted %d of %d events in %.2f ms\n", nPosted, nEvents, TimeSinceInMs(t));
+    delete d;
+}
+
+bool IsReplayingInput() {
+    return gReplayThread != nullptr;
+}
+
+void StartInputReplay(const char* path, HWND hwndFrame, HWND hwndCanvas) {
+    if (gReplayThread) {
+        return;
+    }
+    ByteSlice data = file::ReadFile(path);
+    if (!data.data()) {
+        logf("StartInputReplay: couldn't read '%s'\n", path);
+        return;
+    }
+    auto d = new InputReplayData();
+    d->hwndFrame = hwndFrame;
+    d->hwndCanvas = hwndCanvas;
+    StrVec lines;
+    Split(&lines, (char*)data.data(), "\n", true);
+    data.Free();
+    for (char* line : lines) {
+        InputReplayEvent ev;
+        if (ParseReplayLine(line, ev)) {
+            d->events.Append(ev);
+        }
+    }
+    int nEvents = d->events.Size();
+    if (0 == nEvents) {
+        logf("StartInputReplay: no events in '%s'\n", path);
+        delete d;
+        return;
+    }
+    // the point of replaying is comparing frame times across builds, so
+    // make sure the HUD is up
+    gShowRenderStats = true;
+    logf("StartInputReplay: replaying %d events from '%s'\n", nEvents, path);
+    auto fn = MkFunc0(InputReplayThread, d);
+    gReplayThread = StartThread(fn, "InputReplay");
+}
+
+void StopInputReplay() {
+    if (!gReplayThread) {
+        return;
+    }
+    InterlockedExchange(&gStopInputReplay, 1);
+    WaitForSingleObject(gReplayThread, INFINITE);
+    CloseHandle(gReplayThread);
+    gReplayThread = nullptr;
+}
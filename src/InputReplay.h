@@ -0,0 +1,11 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+bool IsRecordingInput();
+void StartInputRecording(const char* path);
+void StopInputRecording();
+void RecordInputMessage(const MSG& msg);
+
+bool IsReplayingInput();
+void StartInputReplay(const char* path, HWND hwndFrame, HWND hwndCanvas);
+void StopInputReplay();
@@ -107,37 +107,101 @@ char* GetInstallerLogPath() {
     return path::Join(dir, kLogFileName);
 }
 
-static bool ExtractInstallerFiles(lzma::SimpleArchive* archive, const char* destDir) {
-    logf("ExtractFiles(): dir '%s'\n", destDir);
-    lzma::FileInfo* fi;
-    u8* uncompressed;
+constexpr int kMaxExtractThreads = 8;
+
+struct ExtractBatch {
+    lzma::SimpleArchive* archive = nullptr;
+    const char* destDir = nullptr;
+    AtomicInt nextFileNo;
+    AtomicInt nDone;
+    AtomicInt nCorrupted;
+    Mutex mu;
+    // first file that couldn't be written, for the error message
+    char* failedWritePath = nullptr;
+};
 
+static void ExtractBatchThread(ExtractBatch* batch) {
+    lzma::SimpleArchive* archive = batch->archive;
     int nFiles = archive->filesCount;
-
-    for (int i = 0; i < nFiles; i++) {
-        fi = &archive->files[i];
-        uncompressed = lzma::GetFileDataByIdx(archive, i, nullptr);
-
+    for (;;) {
+        int i = batch->nextFileNo.Inc() - 1;
+        if (i >= nFiles) {
+            return;
+        }
+        lzma::FileInfo* fi = &archive->files[i];
+        u8* uncompressed = lzma::GetFileDataByIdx(archive, i, nullptr);
         if (!uncompressed) {
-            NotifyFailed(
-                _TRA("The installer has been corrupted. Please download it again.\nSorry for the inconvenience!"));
-            return false;
+            batch->nCorrupted.Inc();
+            batch->nDone.Inc();
+            continue;
         }
-        TempStr filePath = path::JoinTemp(destDir, fi->name);
-
+        TempStr filePath = path::JoinTemp(batch->destDir, fi->name);
         ByteSlice d = {uncompressed, fi->uncompressedSize};
         bool ok = file::WriteFile(filePath, d);
         free(uncompressed);
+        if (ok) {
+            logf("  extracted '%s'\n", filePath);
+        } else {
+            batch->mu.Lock();
+            if (!batch->failedWritePath) {
+                batch->failedWritePath = str::Dup(filePath);
+            }
+            batch->mu.Unlock();
+        }
+        batch->nDone.Inc();
+    }
+}
 
-        if (!ok) {
-            TempStr msg = str::FormatTemp(_TRA("Couldn't write %s to disk"), filePath);
-            NotifyFailed(msg);
-            return false;
+// decompresses and writes the files on a pool of worker threads
+// (decompression is CPU-bound so this speeds up installs noticeably).
+// the progress bar is still advanced from this thread, as before
+static bool ExtractInstallerFiles(lzma::SimpleArchive* archive, const char* destDir) {
+    logf("ExtractFiles(): dir '%s'\n", destDir);
+    int nFiles = archive->filesCount;
+    if (nFiles <= 0) {
+        return true;
+    }
+
+    ExtractBatch batch;
+    batch.archive = archive;
+    batch.destDir = destDir;
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue<int>((int)si.dwNumberOfProcessors, 1, kMaxExtractThreads);
+    nThreads = std::min(nThreads, nFiles);
+    HANDLE threads[kMaxExtractThreads]{};
+    auto fn = MkFunc0<ExtractBatch>(ExtractBatchThread, &batch);
+    for (int i = 0; i < nThreads; i++) {
+        threads[i] = StartThread(fn, "ExtractBatchThread");
+    }
+    int nReported = 0;
+    for (;;) {
+        DWORD res = WaitForMultipleObjects((DWORD)nThreads, threads, TRUE, 50);
+        int nDone = batch.nDone.Get();
+        while (nReported < nDone) {
+            ProgressStep();
+            nReported++;
+        }
+        if (res != WAIT_TIMEOUT) {
+            break;
         }
-        logf("  extracted '%s'\n", filePath);
-        ProgressStep();
+    }
+    for (int i = 0; i < nThreads; i++) {
+        CloseHandle(threads[i]);
     }
 
+    if (batch.nCorrupted.Get() > 0) {
+        NotifyFailed(
+            _TRA("The installer has been corrupted. Please download it again.\nSorry for the inconvenience!"));
+        return false;
+    }
+    if (batch.failedWritePath) {
+        TempStr msg = str::FormatTemp(_TRA("Couldn't write %s to disk"), batch.failedWritePath);
+        NotifyFailed(msg);
+        str::Free(batch.failedWritePath);
+        return false;
+    }
     return true;
 }
 
@@ -235,22 +299,10 @@ void RemoveAppShortcuts() {
     }
 }
 
-static void InstallerThread(Flags* cli) {
-    bool ok;
-
-    gInstallFailed = true;
-
-    TempStr installedExePath = path::JoinTemp(cli->installDir, kExeName);
-    auto allUsers = cli->allUsers;
-    logf("InstallerThread: cli->allUsers: %d, cli->withFilter: %d, cli->withPreview: %d, installerExePath: '%s'\n",
-         (int)cli->allUsers, (int)cli->withFilter, (int)cli->withPreview, installedExePath);
-    HKEY key = cli->allUsers ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER;
-
-    if (!ExtractInstallerFiles(cli->installDir)) {
-        log("ExtractInstallerFiles() failed\n");
-        goto Exit;
-    }
-
+// cleanup of a previous installation: registry entries, shortcuts and
+// the settings-file migration. None of it depends on the extracted
+// payload, so InstallerThread runs it concurrently with extraction
+static void PreviousInstallCleanupThread() {
     // for cleaner upgrades, remove registry entries and shortcuts from previous installations
     // doing it unconditionally, because deleting non-existing things doesn't hurt
     UninstallBrowserPlugin();
@@ -265,6 +317,33 @@ static void InstallerThread(Flags* cli) {
     RemoveAppShortcuts();
 
     CopySettingsFile();
+}
+
+static void InstallerThread(Flags* cli) {
+    bool ok;
+    bool extractedOk;
+    HANDLE cleanupThread;
+
+    gInstallFailed = true;
+
+    TempStr installedExePath = path::JoinTemp(cli->installDir, kExeName);
+    auto allUsers = cli->allUsers;
+    logf("InstallerThread: cli->allUsers: %d, cli->withFilter: %d, cli->withPreview: %d, installerExePath: '%s'\n",
+         (int)cli->allUsers, (int)cli->withFilter, (int)cli->withPreview, installedExePath);
+    HKEY key = cli->allUsers ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER;
+
+    // overlap extraction with the cleanup of the previous installation;
+    // registration below needs the extracted files, so it stays after both
+    cleanupThread = StartThread(MkFunc0Void(PreviousInstallCleanupThread), "PreviousInstallCleanup");
+    extractedOk = ExtractInstallerFiles(cli->installDir);
+    if (cleanupThread) {
+        WaitForSingleObject(cleanupThread, INFINITE);
+        CloseHandle(cleanupThread);
+    }
+    if (!extractedOk) {
+        log("ExtractInstallerFiles() failed\n");
+        goto Exit;
+    }
 
     // mark them as uninstalled
     gPrevInstall.searchFilterInstalled = false;
@@ -36,7 +36,9 @@
 #include "resource.h"
 #include "Commands.h"
 #include "Caption.h"
+#include "ThumbnailStrip.h"
 #include "Selection.h"
+#include "SearchAndDDE.h"
 #include "Flags.h"
 #include "StressTesting.h"
 #include "Translations.h"
@@ -127,6 +129,7 @@ MainWindow::~MainWindow() {
     DeleteObject(brMovePattern);
     DeleteObject(bmpMovePattern);
     DeleteObject(brControlBgColor);
+    DeleteObject(presFadeBitmap);
 
     // release our copy of UIA provider
     // the UI automation still might have a copy somewhere
@@ -138,6 +141,7 @@ MainWindow::~MainWindow() {
     }
 
     delete linkHandler;
+    delete searchHits;
     delete buffer;
     delete tabSelectionHistory;
     DeleteCaption(caption);
@@ -159,6 +163,7 @@ MainWindow::~MainWindow() {
 
     delete sidebarSplitter;
     delete favSplitter;
+    DeleteThumbnailStrip(this);
     delete tocLabelWithClose;
     delete favLabelWithClose;
 }
@@ -11,6 +11,7 @@ struct Splitter;
 struct Tooltip;
 struct TreeView;
 struct CaptionInfo;
+struct ThumbnailStripInfo;
 struct TabsCtrl;
 
 struct IPageElement;
@@ -24,6 +25,7 @@ struct WindowTab;
 
 struct Annotation;
 struct ILinkHandler;
+struct DocumentSearchHits;
 
 // Current action being performed with a mouse
 // clang-format off
@@ -51,6 +53,12 @@ struct TouchState {
     POINTS panPos{};
     int panScrollOrigX = 0;
     float zoomIntermediate = 0;
+    // pinch zoom in progress: paints scale the last composed frame by
+    // zoomGestureFactor around zoomCenter, the exact zoom is only
+    // committed (and re-rendered) when the gesture ends
+    bool zoomGestureActive = false;
+    float zoomGestureFactor = 1.0f;
+    Point zoomCenter{};
 };
 
 /* Describes position, the target (URL or file path) and infotip of a "hyperlink" */
@@ -134,6 +142,9 @@ struct MainWindow {
     // horizontal splitter for resizing favorites and bookmars parts
     Splitter* favSplitter = nullptr;
 
+    // virtualized page-thumbnail strip at the left edge of the frame
+    ThumbnailStripInfo* thumbnailStrip = nullptr;
+
     TabsCtrl* tabsCtrl = nullptr;
     bool tabsVisible = false;
     bool tabsInTitlebar = false;
@@ -203,6 +214,9 @@ struct MainWindow {
 
     HANDLE findThread = nullptr;
     bool findCancelled = false;
+    // hits of the last completed whole-document search; owned, built on
+    // the find thread and swapped in on the UI thread (see SearchAndDDE.cpp)
+    DocumentSearchHits* searchHits = nullptr;
 
     ILinkHandler* linkHandler = nullptr;
     IPageElement* linkOnLastButtonDown = nullptr;
@@ -215,6 +229,25 @@ struct MainWindow {
     // The target y offset for smooth scrolling.
     // We use a timer to gradually scroll there.
     int scrollTargetY = 0;
+    // state of the smooth scroll animation: sub-pixel position and
+    // velocity of a critically damped spring towards scrollTargetY
+    bool smoothScrollActive = false;
+    double smoothScrollY = 0;
+    double smoothScrollVelocity = 0;
+    LARGE_INTEGER smoothScrollLastStep{};
+
+    // crossfade between slides in presentation mode: a snapshot of the
+    // previous slide's frame, blended over the new one with decreasing
+    // opacity (see DrawPresentationCrossfade in Canvas.cpp)
+    HBITMAP presFadeBitmap = nullptr;
+    LARGE_INTEGER presFadeStart{};
+    // the slide last painted in presentation mode, to detect page turns
+    int presFadeLastPageNo = 0;
+
+    // bumped on every StartLoadDocument() for this window; an async load
+    // whose token no longer matches was superseded and its result is
+    // thrown away instead of replacing the newer document
+    int lastLoadToken = 0;
 
     /* when doing a forward search, the result location is highlighted with
      * rectangular marks in the document. These variables indicate the position of the markers
@@ -39,6 +39,7 @@
 #include "Selection.h"
 #include "HomePage.h"
 #include "Translations.h"
+#include "ThumbnailStrip.h"
 #include "Toolbar.h"
 #include "EditAnnotations.h"
 #include "Accelerators.h"
@@ -275,6 +276,10 @@ static MenuDef menuDefView[] = {
         _TRN("Show Book&marks"),
         CmdToggleBookmarks,
     },
+    {
+        _TRN("Show Page Thumb&nails"),
+        CmdToggleThumbnailStrip,
+    },
     {
         _TRN("Show &Toolbar"),
         CmdToggleToolbar,
@@ -569,6 +574,18 @@ static MenuDef menuDefDebug[] = {
         "Show notification",
         CmdDebugShowNotif,
     },
+    {
+        "Show memory usage",
+        CmdDebugShowMemoryUsage,
+    },
+    {
+        "Toggle perf trace",
+        CmdDebugTogglePerfTrace,
+    },
+    {
+        "Toggle render stats",
+        CmdDebugToggleRenderStats,
+    },
     {
         nullptr,
         0,
@@ -763,6 +780,10 @@ static MenuDef menuDefContext[] = {
         _TRN("&Copy Selection"),
         CmdCopySelection,
     },
+    {
+        _TRN("Save Selection As &Image..."),
+        CmdSaveSelectionAsImage,
+    },
     {
         _TRN("Create Annotation From Selection"),
         (UINT_PTR)menuDefCreateAnnotFromSelection,
@@ -916,6 +937,7 @@ static UINT_PTR disableIfDirectoryOrBrokenPDF[] = {
 
 UINT_PTR disableIfNoSelection[] = {
     CmdCopySelection,
+    CmdSaveSelectionAsImage,
     CmdTranslateSelectionWithDeepL,
     CmdTranslateSelectionWithGoogle,
     CmdSearchSelectionWithWikipedia,
@@ -1697,6 +1719,10 @@ static void MenuUpdateStateForWindow(MainWindow* win) {
     bool checked = documentSpecific ? win->tocVisible : gGlobalPrefs->showToc;
     MenuSetChecked(win->menu, CmdToggleBookmarks, checked);
 
+    MenuSetEnabled(win->menu, CmdToggleThumbnailStrip, win->AsFixed() != nullptr);
+    bool thumbsVisible = win->thumbnailStrip && win->thumbnailStrip->visible;
+    MenuSetChecked(win->menu, CmdToggleThumbnailStrip, thumbsVisible);
+
     MenuSetChecked(win->menu, CmdFavoriteToggle, gGlobalPrefs->showFavorites);
     MenuSetChecked(win->menu, CmdToggleToolbar, gGlobalPrefs->showToolbar);
     MenuSetChecked(win->menu, CmdToggleScrollbars, !gGlobalPrefs->fixedPageUI.hideScrollbars);
@@ -1914,6 +1940,7 @@ void OnWindowContextMenu(MainWindow* win, int x, int y) {
     Annotation* annot = nullptr;
     switch (cmdId) {
         case CmdCopySelection:
+        case CmdSaveSelectionAsImage:
         case CmdTranslateSelectionWithGoogle:
         case CmdTranslateSelectionWithDeepL:
         case CmdSearchSelectionWithGoogle:
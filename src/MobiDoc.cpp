@@ -10,6 +10,7 @@
 #include "utils/GdiPlusUtil.h"
 #include "utils/HtmlParserLookup.h"
 #include "utils/HtmlPullParser.h"
+#include "utils/ThreadUtil.h"
 #include "utils/TrivialHtmlParser.h"
 
 #include "wingui/UIModels.h"
@@ -203,7 +204,11 @@ class HuffDicDecompressor {
 
     u32 codeLength = 0;
 
-    Vec<u32> recursionGuard;
+    // the recursion guard is per call rather than a member so that
+    // multiple threads can Decompress() at the same time (the tables
+    // and dictionaries are read-only after setup)
+    bool Decompress(u8* src, size_t srcSize, str::Str& dst, Vec<u32>& recursionGuard);
+    bool DecodeOne(u32 code, str::Str& dst, Vec<u32>& recursionGuard);
 
   public:
     HuffDicDecompressor();
@@ -211,13 +216,12 @@ class HuffDicDecompressor {
     bool SetHuffData(u8* huffData, size_t huffDataLen);
     bool AddCdicData(u8* cdicData, u32 cdicDataLen);
     bool Decompress(u8* src, size_t srcSize, str::Str& dst);
-    bool DecodeOne(u32 code, str::Str& dst);
 };
 
 HuffDicDecompressor::HuffDicDecompressor() {
 }
 
-bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
+bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst, Vec<u32>& recursionGuard) {
     u16 dict = (u16)(code >> codeLength);
     if (dict >= dictsCount) {
         logf("invalid dict value\n");
@@ -243,7 +247,7 @@ bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
             return false;
         }
         recursionGuard.Append(code);
-        if (!Decompress(p, symLen, dst)) {
+        if (!Decompress(p, symLen, dst, recursionGuard)) {
             return false;
         }
         recursionGuard.Pop();
@@ -259,6 +263,11 @@ bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
 }
 
 bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst) {
+    Vec<u32> recursionGuard;
+    return Decompress(src, srcSize, dst, recursionGuard);
+}
+
+bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst, Vec<u32>& recursionGuard) {
     u32 bitsConsumed = 0;
     u32 bits = 0;
 
@@ -304,7 +313,7 @@ bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst) {
             code = baseTable[codeLen * 2 - 1] - (bits >> (32 - codeLen));
         }
 
-        if (!DecodeOne(code, dst)) {
+        if (!DecodeOne(code, dst, recursionGuard)) {
             return false;
         }
         bitsConsumed = codeLen;
@@ -856,6 +865,27 @@ bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut) {
     return false;
 }
 
+#define MAX_DECOMPRESS_THREADS 8
+// below this the thread overhead costs more than the decompression
+// (doc records are typically 4 KB)
+#define MIN_RECS_FOR_PARALLEL_DECOMPRESS 64
+
+struct DecompressThreadData {
+    MobiDoc* mobiDoc = nullptr;
+    size_t firstRec = 0;
+    size_t lastRec = 0; // inclusive
+    str::Str out;
+    size_t nFailed = 0;
+};
+
+static void DecompressRecsThread(DecompressThreadData* td) {
+    for (size_t recNo = td->firstRec; recNo <= td->lastRec; recNo++) {
+        if (!td->mobiDoc->LoadDocRecordIntoBuffer(recNo, td->out)) {
+            td->nFailed++;
+        }
+    }
+}
+
 bool MobiDoc::LoadForPdbReader(PdbReader* pdbReader) {
     this->pdbReader = pdbReader;
     if (!ParseHeader()) {
@@ -865,9 +895,51 @@ bool MobiDoc::LoadForPdbReader(PdbReader* pdbReader) {
     ReportIf(doc != nullptr);
     doc = new str::Str(docUncompressedSize);
     size_t nFailed = 0;
-    for (size_t i = 1; i <= docRecCount; i++) {
-        if (!LoadDocRecordIntoBuffer(i, *doc)) {
-            nFailed++;
+
+    // decompressing the doc records is cpu-bound and the records are
+    // independent of each other, so fan large documents out across cores:
+    // each thread decompresses a contiguous range of records into its own
+    // buffer and the buffers are stitched together in record order below
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t nThreads = limitValue<size_t>(si.dwNumberOfProcessors, 1, MAX_DECOMPRESS_THREADS);
+    if (docRecCount < MIN_RECS_FOR_PARALLEL_DECOMPRESS) {
+        nThreads = 1;
+    }
+    if (nThreads > 1) {
+        size_t recsPerThread = (docRecCount + nThreads - 1) / nThreads;
+        DecompressThreadData td[MAX_DECOMPRESS_THREADS];
+        HANDLE threads[MAX_DECOMPRESS_THREADS];
+        size_t nStarted = 0;
+        for (size_t i = 0; i < nThreads; i++) {
+            size_t firstRec = 1 + i * recsPerThread;
+            if (firstRec > docRecCount) {
+                break;
+            }
+            td[nStarted].mobiDoc = this;
+            td[nStarted].firstRec = firstRec;
+            td[nStarted].lastRec = std::min(firstRec + recsPerThread - 1, docRecCount);
+            auto fn = MkFunc0(DecompressRecsThread, &td[nStarted]);
+            threads[nStarted] = StartThread(fn, "MobiDecompressThread");
+            if (!threads[nStarted]) {
+                // couldn't create the thread: do its share of the work here
+                DecompressRecsThread(&td[nStarted]);
+            }
+            nStarted++;
+        }
+        for (size_t i = 0; i < nStarted; i++) {
+            if (threads[i]) {
+                WaitForSingleObject(threads[i], INFINITE);
+                CloseHandle(threads[i]);
+            }
+            doc->Append(td[i].out.Get(), td[i].out.size());
+            nFailed += td[i].nFailed;
+        }
+    } else {
+        for (size_t i = 1; i <= docRecCount; i++) {
+            if (!LoadDocRecordIntoBuffer(i, *doc)) {
+                nFailed++;
+            }
         }
     }
 
@@ -0,0 +1,346 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
+#include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/WinUtil.h"
+
+#include "wingui/UIModels.h"
+
+#include "Settings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "GlobalPrefs.h"
+#include "TextSelection.h"
+#include "Ocr.h"
+
+#include "utils/Log.h"
+
+/*
+Scanned documents have no text layer, so search and selection are dead
+in them. When the OcrCmdLine advanced setting is set, pages without
+extractable text are rendered to a bitmap and run through that command
+on a background worker thread; the recognized text is installed into
+the document's DocumentTextCache, which makes the page searchable (and
+persists across sessions via the cache's on-disk copy).
+
+The command is the pluggable part: any OCR tool that reads an image and
+writes plain text works. %i is replaced with the path of the rendered
+page image (a .bmp), %o with the path the tool must write the text to,
+e.g. for tesseract:
+
+  tesseract.exe %i %o txt (tesseract appends .txt itself, so use
+  OcrCmdLine = "tesseract.exe %i %o" and point %o at the base name)
+
+OCR output has no glyph geometry, so coordinates are synthesized by
+spreading each recognized line evenly over a horizontal strip of the
+page: search hit highlights on OCRed pages are approximate, but
+navigation and copying work.
+*/
+
+struct OcrPageTask {
+    DocumentTextCache* cache = nullptr;
+    int pageNo = 0;
+};
+
+static CRITICAL_SECTION gOcrCs;
+static HANDLE gOcrWakeEvent = nullptr;
+static HANDLE gOcrThread = nullptr;
+static AtomicBool gStopOcr;
+// pages waiting for the worker and pages it already attempted (so a
+// page that OCR can't improve isn't re-queued on every visit)
+static Vec<OcrPageTask> gOcrQueue;
+static Vec<OcrPageTask> gOcrDone;
+// the task the worker is processing right now (guarded by gOcrCs)
+static OcrPageTask gOcrCurrent;
+// 0: not initialized, 1: initialization in progress, 2: done
+static LONG gOcrInitState = 0;
+
+bool OcrEnabled() {
+    return gGlobalPrefs && !str::IsEmpty(gGlobalPrefs->ocrCmdLine);
+}
+
+static bool SameTask(const OcrPageTask& t, DocumentTextCache* cache, int pageNo) {
+    return t.cache == cache && t.pageNo == pageNo;
+}
+
+static int CountNonWhitespace(const WCHAR* s, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        WCHAR c = s[i];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            n++;
+        }
+    }
+    return n;
+}
+
+// a page with fewer visible characters than this is treated as having
+// no usable text layer (scans often carry a stray glyph or two)
+constexpr int kMinCharsForTextLayer = 4;
+constexpr DWORD kOcrProcessTimeoutInMs = 2 * 60 * 1000;
+
+// builds per-glyph rects for OCR text that has none: each line gets a
+// horizontal strip of the page, each glyph an even slice of its line.
+// Line-break characters get zero rects, same as engine-extracted text
+static Rect* SynthesizeCoords(const WCHAR* text, int len, RectF mediabox) {
+    Rect* coords = AllocArray<Rect>(len);
+    if (!coords) {
+        return nullptr;
+    }
+    int nLines = 1;
+    for (int i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            nLines++;
+        }
+    }
+    double lineDy = mediabox.dy / (double)nLines;
+    int lineNo = 0;
+    int i = 0;
+    while (i < len) {
+        if (text[i] == '\n') {
+            // zero rect marks a line break for FillResultRects() et al.
+            lineNo++;
+            i++;
+            continue;
+        }
+        int lineStart = i;
+        while (i < len && text[i] != '\n') {
+            i++;
+        }
+        int nGlyphs = i - lineStart;
+        double glyphDx = mediabox.dx / (double)nGlyphs;
+        double y = mediabox.y + (double)lineNo * lineDy;
+        for (int j = 0; j < nGlyphs; j++) {
+            double x = mediabox.x + (double)j * glyphDx;
+            coords[lineStart + j] = Rect((int)x, (int)y, (int)glyphDx + 1, (int)lineDy + 1);
+        }
+    }
+    return coords;
+}
+
+// renders pageNo, runs the configured OCR command over the bitmap and
+// installs the recognized text into cache. Runs on the worker thread
+static void OcrPage(DocumentTextCache* cache, int pageNo) {
+    int len = 0;
+    const WCHAR* text = cache->GetTextForPage(pageNo, &len);
+    if (text && CountNonWhitespace(text, len) >= kMinCharsForTextLayer) {
+        // the engine extracted a text layer after all
+        return;
+    }
+
+    EngineBase* engine = cache->engine;
+    // page units are points (1/72 inch); OCR engines want ~300 dpi
+    float zoom = 300.f / 72.f;
+    RenderPageArgs args(pageNo, zoom, 0);
+    RenderedBitmap* bmp = engine->RenderPage(args);
+    if (!bmp) {
+        logf("OcrPage: failed to render page %d\n", pageNo);
+        return;
+    }
+    ByteSlice bmpData = SerializeBitmap(bmp->GetBitmap());
+    delete bmp;
+    if (bmpData.empty()) {
+        return;
+    }
+
+    TempStr basePath = GetTempFilePathTemp("ocr");
+    if (!basePath) {
+        bmpData.Free();
+        return;
+    }
+    TempStr imgPath = str::JoinTemp(basePath, ".bmp");
+    TempStr outPath = str::JoinTemp(basePath, ".txt");
+    bool ok = file::WriteFile(imgPath, bmpData);
+    bmpData.Free();
+    if (!ok) {
+        return;
+    }
+
+    TempStr cmd = str::ReplaceTemp(gGlobalPrefs->ocrCmdLine, "%i", imgPath);
+    cmd = str::ReplaceTemp(cmd, "%o", outPath);
+    AutoCloseHandle process = LaunchProcessInDir(cmd, nullptr, CREATE_NO_WINDOW);
+    if (!process.IsValid()) {
+        logf("OcrPage: failed to launch '%s'\n", cmd);
+        file::Delete(imgPath);
+        return;
+    }
+    DWORD waited = 0;
+    for (;;) {
+        DWORD res = WaitForSingleObject(process, 500);
+        if (res == WAIT_OBJECT_0) {
+            break;
+        }
+        waited += 500;
+        if (gStopOcr.Get() || waited >= kOcrProcessTimeoutInMs) {
+            TerminateProcess(process, 1);
+            file::Delete(imgPath);
+            file::Delete(outPath);
+            return;
+        }
+    }
+
+    ByteSlice d = file::ReadFile(outPath);
+    file::Delete(imgPath);
+    file::Delete(outPath);
+    if (d.empty()) {
+        logf("OcrPage: no output for page %d from '%s'\n", pageNo, cmd);
+        return;
+    }
+    char* s = (char*)d.data();
+    str::NormalizeNewlinesInPlace(s);
+    WCHAR* ocrText = ToWStr(s);
+    d.Free();
+    if (!ocrText) {
+        return;
+    }
+    int ocrLen = str::Leni(ocrText);
+    if (CountNonWhitespace(ocrText, ocrLen) == 0) {
+        free(ocrText);
+        return;
+    }
+    Rect* coords = SynthesizeCoords(ocrText, ocrLen, engine->PageMediabox(pageNo));
+    if (!coords) {
+        free(ocrText);
+        return;
+    }
+    if (cache->SetOcrTextForPage(pageNo, ocrText, coords, ocrLen)) {
+        // refresh the persisted copy so the next session doesn't re-OCR
+        cache->SaveToDisk();
+        logf("OcrPage: recognized %d chars on page %d\n", ocrLen, pageNo);
+    }
+}
+
+static void OcrThread() {
+    for (;;) {
+        WaitForSingleObject(gOcrWakeEvent, INFINITE);
+        if (gStopOcr.Get()) {
+            return;
+        }
+        for (;;) {
+            OcrPageTask task;
+            {
+                ScopedCritSec cs(&gOcrCs);
+                if (gOcrQueue.Size() == 0) {
+                    break;
+                }
+                task = gOcrQueue.PopAt(0);
+                gOcrCurrent = task;
+                gOcrDone.Append(task);
+            }
+            OcrPage(task.cache, task.pageNo);
+            {
+                ScopedCritSec cs(&gOcrCs);
+                gOcrCurrent = {};
+            }
+            if (gStopOcr.Get()) {
+                return;
+            }
+        }
+    }
+}
+
+// pages get queued from the UI thread and the text extraction thread,
+// so the one-time init must be race-free
+static void EnsureOcrThread() {
+    for (;;) {
+        LONG state = InterlockedCompareExchange(&gOcrInitState, 1, 0);
+        if (state == 0) {
+            break; // we won the race and do the initialization
+        }
+        if (state == 2) {
+            return;
+        }
+        Sleep(0); // another thread is initializing
+    }
+    InitializeCriticalSection(&gOcrCs);
+    gOcrWakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    auto fn = MkFunc0Void(OcrThread);
+    gOcrThread = StartThread(fn, "OcrThread");
+    if (gOcrThread) {
+        SetThreadPriority(gOcrThread, THREAD_PRIORITY_LOWEST);
+    }
+    InterlockedExchange(&gOcrInitState, 2);
+}
+
+void QueueOcrPage(DocumentTextCache* cache, int pageNo, bool priority) {
+    if (!OcrEnabled()) {
+        return;
+    }
+    EnsureOcrThread();
+    if (!gOcrThread) {
+        return;
+    }
+    ScopedCritSec cs(&gOcrCs);
+    for (OcrPageTask& t : gOcrDone) {
+        if (SameTask(t, cache, pageNo)) {
+            return;
+        }
+    }
+    if (SameTask(gOcrCurrent, cache, pageNo)) {
+        return;
+    }
+    int queuedAt = -1;
+    for (int i = 0; i < gOcrQueue.Size(); i++) {
+        if (SameTask(gOcrQueue.At(i), cache, pageNo)) {
+            queuedAt = i;
+            break;
+        }
+    }
+    OcrPageTask task{cache, pageNo};
+    if (priority) {
+        // the visible page goes to the front of the queue
+        if (queuedAt > 0) {
+            gOcrQueue.RemoveAt(queuedAt);
+            queuedAt = -1;
+        }
+        if (queuedAt < 0) {
+            gOcrQueue.InsertAt(0, task);
+        }
+    } else if (queuedAt < 0) {
+        gOcrQueue.Append(task);
+    }
+    SetEvent(gOcrWakeEvent);
+}
+
+void CancelOcr(DocumentTextCache* cache) {
+    if (gOcrInitState != 2) {
+        return;
+    }
+    EnterCriticalSection(&gOcrCs);
+    for (int i = gOcrQueue.Size() - 1; i >= 0; i--) {
+        if (gOcrQueue.At(i).cache == cache) {
+            gOcrQueue.RemoveAt(i);
+        }
+    }
+    for (int i = gOcrDone.Size() - 1; i >= 0; i--) {
+        if (gOcrDone.At(i).cache == cache) {
+            gOcrDone.RemoveAt(i);
+        }
+    }
+    bool inFlight = gOcrCurrent.cache == cache;
+    LeaveCriticalSection(&gOcrCs);
+    // the worker holds raw pointers into cache; wait until it's done
+    // with the in-flight page before the cache is destroyed
+    while (inFlight) {
+        Sleep(10);
+        ScopedCritSec cs(&gOcrCs);
+        inFlight = gOcrCurrent.cache == cache;
+    }
+}
+
+void ShutdownOcr() {
+    if (gOcrInitState != 2 || !gOcrThread) {
+        return;
+    }
+    gStopOcr.Set(true);
+    SetEvent(gOcrWakeEvent);
+    // bounded wait: a stuck OCR process is terminated by the worker's
+    // own timeout handling, but don't hold up exit for it
+    WaitForSingleObject(gOcrThread, 1000);
+    CloseHandle(gOcrThread);
+    CloseHandle(gOcrWakeEvent);
+    gOcrThread = nullptr;
+}
@@ -0,0 +1,13 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+struct DocumentTextCache;
+
+bool OcrEnabled();
+// schedules OCR of a page that has no text layer on the background
+// worker; priority (the visible page) jumps the queue
+void QueueOcrPage(DocumentTextCache* cache, int pageNo, bool priority);
+// removes all queued pages of cache and waits out an in-flight one;
+// must be called before cache is destroyed
+void CancelOcr(DocumentTextCache* cache);
+void ShutdownOcr();
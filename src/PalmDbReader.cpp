@@ -22,7 +22,11 @@ bool PdbReader::Parse(const ByteSlice& d) {
 }
 
 PdbReader::~PdbReader() {
-    str::Free(data);
+    if (mapping.data) {
+        file::UnmapFile(&mapping);
+    } else {
+        str::Free(data);
+    }
 }
 
 static bool DecodePdbHeader(ByteOrderDecoder& dec, PdbHeader* hdr) {
@@ -132,6 +136,22 @@ PdbReader* PdbReader::CreateFromData(const ByteSlice& d) {
 }
 
 PdbReader* PdbReader::CreateFromFile(const char* path) {
+    // map the file instead of reading it up front: most of a large mobi
+    // file is image records and GetRecord() returns slices into the
+    // mapping, so only the records that are actually accessed (and the
+    // pages of the document text as it's decompressed) get paged in
+    PdbReader* reader = new PdbReader();
+    if (file::MapFile(path, &reader->mapping)) {
+        reader->data = reader->mapping.data;
+        reader->dataSize = (size_t)reader->mapping.size;
+        if (!reader->ParseHeader()) {
+            delete reader;
+            return nullptr;
+        }
+        return reader;
+    }
+    delete reader;
+
     ByteSlice d = file::ReadFile(path);
     return CreateFromData(d);
 }
@@ -28,10 +28,14 @@ struct PdbRecordHeader {
 };
 
 class PdbReader {
-    // content of pdb file
+    // content of pdb file; either a heap copy (data ownership was
+    // passed to Parse) or a view into mapping
     const u8* data = nullptr;
     size_t dataSize = 0;
 
+    // set if the file was memory-mapped by CreateFromFile
+    file::FileMap mapping;
+
     // offset of each pdb record within the file + a sentinel
     // value equal to file size to simplify use
     Vec<PdbRecordHeader> recInfos;
@@ -8,6 +8,7 @@ extern "C" {
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/FileUtil.h"
 #include "utils/GdiPlusUtil.h"
 #include "utils/WinUtil.h"
 
@@ -3,8 +3,10 @@
 
 #include "utils/BaseUtil.h"
 #include <synctex_parser.h>
+#include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
 #include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
 #include "utils/ZipUtil.h"
 
 #include "wingui/UIModels.h"
@@ -47,11 +49,15 @@ class Pdfsync : public Synchronizer {
         ReportIf(!str::EndsWithI(syncfilename, ".pdfsync"));
     }
 
+    ~Pdfsync() override {
+        JoinRebuildIndexThread();
+    }
+
     int DocToSource(int pageNo, Point pt, AutoFreeStr& filename, int* line, int* col) override;
     int SourceToDoc(const char* srcfilename, int line, int col, int* page, Vec<Rect>& rects) override;
+    int RebuildIndexIfNeeded() override;
 
   private:
-    int RebuildIndexIfNeeded();
     UINT SourceToRecord(const char* srcfilename, int line, int col, Vec<size_t>& records);
 
     EngineBase* engine;              // needed for converting between coordinate systems
@@ -72,25 +78,57 @@ class SyncTex : public Synchronizer {
     }
 
     ~SyncTex() override {
+        JoinRebuildIndexThread();
         synctex_scanner_free(scanner);
     }
 
     int DocToSource(int pageNo, Point pt, AutoFreeStr& filename, int* line, int* col) override;
     int SourceToDoc(const char* srcfilename, int line, int col, int* page, Vec<Rect>& rects) override;
+    int RebuildIndexIfNeeded() override;
 
   private:
-    int RebuildIndexIfNeeded();
-
     EngineBase* engine; // needed for converting between coordinate systems
     synctex_scanner_p scanner;
 };
 
 Synchronizer::Synchronizer(const char* syncFilePathIn) {
+    InitializeCriticalSection(&indexAccess);
     syncFilePath = str::Dup(syncFilePathIn);
     WCHAR* path = ToWStrTemp(syncFilePathIn);
     _wstat(path, &syncfileTimestamp);
 }
 
+Synchronizer::~Synchronizer() {
+    JoinRebuildIndexThread();
+    DeleteCriticalSection(&indexAccess);
+}
+
+// must be called first thing in subclass destructors so that a
+// background index rebuild doesn't use members being destroyed
+void Synchronizer::JoinRebuildIndexThread() {
+    if (!rebuildIndexThread) {
+        return;
+    }
+    WaitForSingleObject(rebuildIndexThread, INFINITE);
+    CloseHandle(rebuildIndexThread);
+    rebuildIndexThread = nullptr;
+}
+
+static void RebuildIndexThread(Synchronizer* sync) {
+    // don't compete with rendering the freshly loaded document
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    ScopedTempAllocMark tempMark;
+    sync->RebuildIndexIfNeeded();
+}
+
+void Synchronizer::RebuildIndexAsync() {
+    if (rebuildIndexThread) {
+        return;
+    }
+    auto fn = MkFunc0(RebuildIndexThread, this);
+    rebuildIndexThread = StartThread(fn, "SyncIndexThread");
+}
+
 bool Synchronizer::NeedsToRebuildIndex() const {
     // was the index manually discarded?
     if (needsToRebuildIndex) {
@@ -170,6 +208,7 @@ static char* Advance0Line(char* line, char* end) {
 
 // see http://itexmac.sourceforge.net/pdfsync.html for the specification
 int Pdfsync::RebuildIndexIfNeeded() {
+    ScopedCritSec scope(&indexAccess);
     if (!NeedsToRebuildIndex()) {
         return PDFSYNCERR_SUCCESS;
     }
@@ -519,6 +558,7 @@ TempStr ungzipToFile(char* path) {
 // SYNCTEX synchronizer
 
 int SyncTex::RebuildIndexIfNeeded() {
+    ScopedCritSec scope(&indexAccess);
     if (!NeedsToRebuildIndex()) {
         logfa("SyncTex::RebuildIndexIfNeeded: no need to rebuild\n");
         return PDFSYNCERR_SUCCESS;
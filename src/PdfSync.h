@@ -23,7 +23,7 @@ class EngineBase;
 class Synchronizer {
   public:
     explicit Synchronizer(const char* syncfilepath);
-    virtual ~Synchronizer() = default;
+    virtual ~Synchronizer();
 
     // Inverse-search:
     //  - pageNo: page number in the PDF (starting from 1)
@@ -38,19 +38,33 @@ class Synchronizer {
     // The result is returned in page and rects (list of rectangles to highlight).
     virtual int SourceToDoc(const char* srcfilename, int line, int col, int* page, Vec<Rect>& rects) = 0;
 
+    // (re)parses the sync file if it changed since the last parse.
+    // Called lazily by DocToSource / SourceToDoc
+    virtual int RebuildIndexIfNeeded() = 0;
+
+    // parses the sync file on a background thread right after document
+    // load so that the first forward/inverse search doesn't stall a DDE
+    // round trip on parsing a large index
+    void RebuildIndexAsync();
+
   private:
     // true if the index needs to be recomputed (needs to be set to true when a change to the
     // pdfsync file is detected)
     bool needsToRebuildIndex = true;
     // time stamp of sync file when index was last built
     struct _stat syncfileTimestamp;
+    HANDLE rebuildIndexThread = nullptr;
 
   protected:
     bool NeedsToRebuildIndex() const;
     int MarkIndexWasRebuilt();
     char* PrependDir(const char* filename) const;
+    void JoinRebuildIndexThread();
 
     AutoFreeStr syncFilePath; // path to the synchronization file
+    // implementations of RebuildIndexIfNeeded() must hold this while
+    // rebuilding as it can also run on the RebuildIndexAsync() thread
+    CRITICAL_SECTION indexAccess;
 
   public:
     static int Create(const char* pdffilename, EngineBase* engine, Synchronizer** sync);
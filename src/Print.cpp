@@ -272,6 +272,392 @@ static RectF BoundSelectionOnPage(const Vec<SelectionOnPage>& sel, int pageNo) {
     return bounds;
 }
 
+// zoom, rotation and placement of one page on the physical paper
+struct PrintPageParams {
+    int pageNo = 0;
+    float zoom = 0;
+    int rotation = 0;
+    Point offset;
+};
+
+// compute how a page maps onto the physical paper; pulled out of
+// PrintToDevice so that the spooler and the render threads agree on
+// the exact parameters
+static PrintPageParams ComputePrintPageParams(const PrintData& pd, EngineBase& engine, int pageNo, Size paperSize,
+                                              Rect printable, float dpiFactor, bool bPrintPortrait) {
+    PrintPageParams p;
+    p.pageNo = pageNo;
+
+    SizeF pSize = engine.PageMediabox(pageNo).Size();
+    int rotation = 0;
+    // Turn the document by 90 deg if it isn't in portrait mode & if autoRotation is not disabled
+    if (pd.advData.autoRotate && pSize.dx > pSize.dy) {
+        rotation += 90;
+        std::swap(pSize.dx, pSize.dy);
+    }
+    // make sure not to print upside-down
+    rotation = (rotation % 180) == 0 ? 0 : 270;
+    // finally turn the page by (another) 90 deg in landscape mode
+    if (!bPrintPortrait) {
+        rotation = (rotation + 90) % 360;
+        std::swap(pSize.dx, pSize.dy);
+    }
+    p.rotation = rotation;
+
+    // dpiFactor means no physical zoom
+    float zoom = dpiFactor;
+    // offset of the top-left corner of the page from the printable area
+    // (negative values move the page into the left/top margins, etc.);
+    // offset adjustments are needed because the GDI coordinate system
+    // starts at the corner of the printable area and we rather want to
+    // center the page on the physical paper (except for PrintScaleNone
+    // where the page starts at the very top left of the physical paper so
+    // that printing forms/labels of varying size remains reliably possible)
+    Point offset(-printable.x, -printable.y);
+
+    if (pd.advData.scale != PrintScaleAdv::None) {
+        // make sure to fit all content into the printable area when scaling
+        // and the whole document page on the physical paper
+        RectF rect = engine.PageContentBox(pageNo, RenderTarget::Print);
+        RectF cbox = engine.Transform(rect, pageNo, 1.0, rotation);
+        zoom = std::min((float)printable.dx / cbox.dx,
+                        std::min((float)printable.dy / cbox.dy,
+                                 std::min((float)paperSize.dx / pSize.dx, (float)paperSize.dy / pSize.dy)));
+        // use the correct zoom values, if the page fits otherwise
+        // and the user didn't ask for anything else (default setting)
+        if (PrintScaleAdv::Shrink == pd.advData.scale && dpiFactor < zoom) {
+            zoom = dpiFactor;
+        }
+        // center the page on the physical paper
+        offset.x += (int)(paperSize.dx - pSize.dx * zoom) / 2;
+        offset.y += (int)(paperSize.dy - pSize.dy * zoom) / 2;
+        // make sure that no content lies in the non-printable paper margins
+        RectF onPaper(printable.x + offset.x + cbox.x * zoom, printable.y + offset.y + cbox.y * zoom, cbox.dx * zoom,
+                      cbox.dy * zoom);
+        if (onPaper.x < printable.x) {
+            offset.x += (int)(printable.x - onPaper.x);
+        } else if (onPaper.BR().x > printable.BR().x) {
+            offset.x -= (int)(onPaper.BR().x - printable.BR().x);
+        }
+        if (onPaper.y < printable.y) {
+            offset.y += (int)(printable.y - onPaper.y);
+        } else if (onPaper.BR().y > printable.BR().y) {
+            offset.y -= (int)(onPaper.BR().y - printable.BR().y);
+        }
+    }
+    p.zoom = zoom;
+    p.offset = offset;
+    return p;
+}
+
+// render threads stay at most this many bytes of finished bitmaps ahead
+// of the spooler (approximate: pages being rendered don't count)
+constexpr size_t kPrintQueueBudgetBytes = 256 * 1024 * 1024;
+constexpr int kMaxPrintRenderThreads = 4;
+
+// rasterizer workers alive across all render queues; batch printing
+// keeps two jobs' queues alive at once (see PrintFiles) and their
+// combined worker count must stay within kMaxPrintRenderThreads
+static AtomicInt gPrintRenderThreadCount;
+
+struct PrintPageTask {
+    PrintPageParams params;
+    RenderedBitmap* bmp = nullptr;
+    bool done = false;
+};
+
+// producer/consumer pipeline for the page-range print path: worker
+// threads rasterize pages ahead via the engine while PrintToDevice
+// consumes them in order
+struct PrintRenderQueue {
+    EngineBase* engine = nullptr;
+    Vec<PrintPageTask*> tasks;
+    CRITICAL_SECTION access;
+    HANDLE renderedEvent = nullptr; // a worker finished a page
+    HANDLE spooledEvent = nullptr;  // the spooler consumed a page
+    Vec<HANDLE> threads;
+    int nextToRender = 0;
+    size_t bytesQueued = 0;
+    AtomicBool stop;
+};
+
+static size_t PrintBitmapBytes(RenderedBitmap* bmp) {
+    Size s = bmp->GetSize();
+    return (size_t)s.dx * 4 * (size_t)s.dy;
+}
+
+static void PrintRenderThread(PrintRenderQueue* q) {
+    defer {
+        gPrintRenderThreadCount.Dec();
+    };
+    for (;;) {
+        if (q->stop.Get()) {
+            return;
+        }
+        int idx = -1;
+        bool allTaken;
+        EnterCriticalSection(&q->access);
+        allTaken = q->nextToRender >= q->tasks.Size();
+        if (!allTaken && q->bytesQueued < kPrintQueueBudgetBytes) {
+            idx = q->nextToRender++;
+        }
+        LeaveCriticalSection(&q->access);
+        if (idx < 0) {
+            if (allTaken) {
+                return;
+            }
+            // over budget: wait for the spooler to drain a page
+            WaitForSingleObject(q->spooledEvent, 100);
+            continue;
+        }
+        PrintPageTask* task = q->tasks.at(idx);
+        PrintPageParams& p = task->params;
+        // note: no abort cookie; cancellation is only checked between
+        // pages, which is good enough for print-sized renders
+        RenderPageArgs args(p.pageNo, p.zoom, p.rotation, nullptr, RenderTarget::Print);
+        RenderedBitmap* bmp = q->engine->RenderPage(args);
+        EnterCriticalSection(&q->access);
+        task->bmp = bmp;
+        task->done = true;
+        if (bmp) {
+            q->bytesQueued += PrintBitmapBytes(bmp);
+        }
+        LeaveCriticalSection(&q->access);
+        SetEvent(q->renderedEvent);
+    }
+}
+
+static void StartPrintRenderQueue(PrintRenderQueue* q, EngineBase* engine) {
+    q->engine = engine;
+    InitializeCriticalSection(&q->access);
+    q->renderedEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    q->spooledEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, kMaxPrintRenderThreads);
+    // leave room for the workers of other queues alive right now, but
+    // always start at least one so that this queue makes progress
+    nThreads -= gPrintRenderThreadCount.Get();
+    if (nThreads < 1) {
+        nThreads = 1;
+    }
+    if (nThreads > q->tasks.Size()) {
+        nThreads = q->tasks.Size();
+    }
+    for (int i = 0; i < nThreads; i++) {
+        gPrintRenderThreadCount.Inc();
+        auto fn = MkFunc0(PrintRenderThread, q);
+        HANDLE hThread = StartThread(fn, "PrintRenderThread");
+        if (hThread) {
+            q->threads.Append(hThread);
+        } else {
+            gPrintRenderThreadCount.Dec();
+        }
+    }
+}
+
+static void StopPrintRenderQueue(PrintRenderQueue* q) {
+    if (q->engine) {
+        q->stop.Set(true);
+        SetEvent(q->spooledEvent);
+        for (HANDLE hThread : q->threads) {
+            WaitForSingleObject(hThread, INFINITE);
+            CloseHandle(hThread);
+            // wake up the next waiting worker
+            SetEvent(q->spooledEvent);
+        }
+        q->threads.Reset();
+        CloseHandle(q->renderedEvent);
+        CloseHandle(q->spooledEvent);
+        DeleteCriticalSection(&q->access);
+        q->engine = nullptr;
+    }
+    for (PrintPageTask* task : q->tasks) {
+        delete task->bmp;
+        delete task;
+    }
+    q->tasks.Reset();
+}
+
+// returns the pre-rendered bitmap for tasks[idx] (can be null if
+// rendering failed), blocking until a worker has produced it
+static RenderedBitmap* WaitForPrintPageRender(PrintRenderQueue* q, int idx) {
+    for (;;) {
+        EnterCriticalSection(&q->access);
+        PrintPageTask* task = q->tasks.at(idx);
+        if (task->done) {
+            RenderedBitmap* bmp = task->bmp;
+            task->bmp = nullptr;
+            if (bmp) {
+                q->bytesQueued -= PrintBitmapBytes(bmp);
+            }
+            LeaveCriticalSection(&q->access);
+            SetEvent(q->spooledEvent);
+            return bmp;
+        }
+        LeaveCriticalSection(&q->access);
+        WaitForSingleObject(q->renderedEvent, 100);
+    }
+}
+
+// validate printer settings as per
+// https://docs.microsoft.com/en-us/windows/win32/printdocs/documentproperties
+// TODO: maybe do this in NewPrinter?
+static void ValidatePrinterSettings(Printer* printer) {
+    WCHAR* printerName = ToWStrTemp(printer->name);
+    DWORD mode = DM_IN_BUFFER | DM_OUT_BUFFER;
+    HANDLE hPrinter = nullptr;
+    BOOL ok = OpenPrinterW(printerName, &hPrinter, nullptr);
+    if (ok && hPrinter) {
+        DocumentPropertiesW(nullptr, hPrinter, printerName, printer->devMode, printer->devMode, mode);
+    }
+    ClosePrinter(hPrinter);
+}
+
+// physical paper metrics of a printer DC plus the derived zoom and
+// orientation defaults, computed once per job so that task building
+// and spooling agree
+struct PrintDeviceMetrics {
+    Size paperSize;
+    Rect printable;
+    float dpiFactor = 1.0f;
+    bool printPortrait = true;
+};
+
+static PrintDeviceMetrics GetPrintDeviceMetrics(const PrintData& pd, HDC hdc) {
+    PrintDeviceMetrics m;
+    m.paperSize = Size(GetDeviceCaps(hdc, PHYSICALWIDTH), GetDeviceCaps(hdc, PHYSICALHEIGHT));
+    m.printable = Rect(GetDeviceCaps(hdc, PHYSICALOFFSETX), GetDeviceCaps(hdc, PHYSICALOFFSETY),
+                       GetDeviceCaps(hdc, HORZRES), GetDeviceCaps(hdc, VERTRES));
+    float fileDPI = pd.engine->GetFileDPI();
+    float px = (float)GetDeviceCaps(hdc, LOGPIXELSX);
+    float py = (float)GetDeviceCaps(hdc, LOGPIXELSY);
+    m.dpiFactor = std::min(px / fileDPI, py / fileDPI);
+    m.printPortrait = m.paperSize.dx < m.paperSize.dy;
+    auto devMode = pd.printer->devMode;
+    if (devMode && (devMode->dmFields & DM_ORIENTATION)) {
+        m.printPortrait = DMORIENT_PORTRAIT == devMode->dmOrientation;
+    }
+    if (pd.advData.rotation == PrintRotationAdv::Portrait) {
+        m.printPortrait = true;
+    } else if (pd.advData.rotation == PrintRotationAdv::Landscape) {
+        m.printPortrait = false;
+    }
+    return m;
+}
+
+// fills queue->tasks with the per-page render parameters for pd's page
+// ranges (the selection path doesn't use the queue)
+static void BuildPrintPageTasks(const PrintData& pd, const PrintDeviceMetrics& m, PrintRenderQueue* queue) {
+    for (size_t i = 0; i < pd.ranges.size(); i++) {
+        int dir = pd.ranges.at(i).nFromPage > pd.ranges.at(i).nToPage ? -1 : 1;
+        for (DWORD pageNo = pd.ranges.at(i).nFromPage; pageNo != pd.ranges.at(i).nToPage + dir; pageNo += dir) {
+            if ((PrintRangeAdv::Even == pd.advData.range && pageNo % 2 != 0) ||
+                (PrintRangeAdv::Odd == pd.advData.range && pageNo % 2 == 0)) {
+                continue;
+            }
+            auto task = new PrintPageTask;
+            task->params = ComputePrintPageParams(pd, *pd.engine, (int)pageNo, m.paperSize, m.printable, m.dpiFactor,
+                                                  m.printPortrait);
+            queue->tasks.Append(task);
+        }
+    }
+}
+
+// spools one job's pre-computed page tasks, consuming pre-rendered
+// bitmaps from queue when useQueue is set; shared between PrintToDevice
+// and batch printing (see SpoolBatchPrintJob)
+static bool SpoolPrintTasks(const PrintData& pd, HDC hdc, DOCINFOW* di, PrintRenderQueue& queue, bool useQueue,
+                            int total) {
+    EngineBase& engine = *pd.engine;
+    auto progressCb = pd.progressCb;
+    auto abortCookie = pd.abortCookie;
+    int current = 1;
+
+    // for PDF Printer, this shows a file dialog to pick file name for destination PDF
+    int res = StartDoc(hdc, di);
+    if (res <= 0) {
+        logf("SpoolPrintTasks: StartDoc() failed with %d\n", res);
+        return false;
+    }
+
+    // MM_TEXT: Each logical unit is mapped to one device pixel.
+    // Positive x is to the right; positive y is down.
+    SetMapMode(hdc, MM_TEXT);
+
+    for (int idx = 0; idx < queue.tasks.Size(); idx++) {
+        const PrintPageParams& params = queue.tasks.at(idx)->params;
+        UpdateProgress(progressCb, current, total);
+
+        RenderedBitmap* bmp = nullptr;
+        if (useQueue) {
+            bmp = WaitForPrintPageRender(&queue, idx);
+        }
+        if (WasCanceled(progressCb)) {
+            logf("SpoolPrintTasks: canceled\n");
+            delete bmp;
+            AbortDoc(hdc);
+            return false;
+        }
+
+        res = StartPage(hdc);
+        if (res <= 0) {
+            logf("SpoolPrintTasks: StartPage() failed with %d\n", res);
+            delete bmp;
+            continue;
+        }
+
+        bool ok = false;
+        short shrink = 1;
+        if (bmp) {
+            if (bmp->IsValid()) {
+                auto size = bmp->GetSize();
+                Rect rc(params.offset.x, params.offset.y, size.dx, size.dy);
+                ok = bmp->Blit(hdc, rc);
+            }
+            delete bmp;
+            shrink = 2;
+        }
+        // render (again) on the spooler thread if there was no pre-rendered
+        // bitmap or blitting it failed (e.g. the bitmap was too large for
+        // the printer driver; retry at reduced resolutions)
+        while (!ok && shrink < 32 && !WasCanceled(progressCb)) {
+            RenderPageArgs args(params.pageNo, params.zoom / shrink, params.rotation, nullptr, RenderTarget::Print);
+            if (abortCookie) {
+                args.cookie_out = &abortCookie->cookie;
+            }
+            bmp = engine.RenderPage(args);
+            if (abortCookie) {
+                abortCookie->Clear();
+            }
+            if (bmp && bmp->IsValid()) {
+                auto size = bmp->GetSize();
+                Rect rc(params.offset.x, params.offset.y, size.dx * shrink, size.dy * shrink);
+                ok = bmp->Blit(hdc, rc);
+            }
+            delete bmp;
+            shrink *= 2;
+        }
+        // TODO: abort if !ok?
+
+        res = EndPage(hdc);
+        bool wasCanceled = WasCanceled(progressCb);
+        if (res <= 0 || wasCanceled) {
+            logf("SpoolPrintTasks: EndPage() failed with %d or wasCanceled: %d\n", res, (int)wasCanceled);
+            AbortDoc(hdc);
+            return false;
+        }
+        current++;
+    }
+
+    res = EndDoc(hdc);
+    if (res <= 0) {
+        logf("SpoolPrintTasks: EndDoc() failed with %d\n", res);
+        return false;
+    }
+    return true;
+}
+
 static bool PrintToDevice(const PrintData& pd) {
     ReportIf(!pd.engine);
     if (!pd.engine) {
@@ -336,58 +722,31 @@ static bool PrintToDevice(const PrintData& pd) {
 
     UpdateProgress(progressCb, current, total);
 
-    auto devMode = pd.printer->devMode;
+    ValidatePrinterSettings(pd.printer);
+
     // http://blogs.msdn.com/b/oldnewthing/archive/2012/11/09/10367057.aspx
     WCHAR* printerName = ToWStrTemp(pd.printer->name);
 
-    {
-        // validate printer settings as per
-        // https://docs.microsoft.com/en-us/windows/win32/printdocs/documentproperties
-        // TODO: maybe do this in NewPrinter?
-        DWORD mode = DM_IN_BUFFER | DM_OUT_BUFFER;
-        HANDLE hPrinter = nullptr;
-        BOOL ok = OpenPrinterW(printerName, &hPrinter, nullptr);
-        if (ok && hPrinter) {
-            DocumentPropertiesW(nullptr, hPrinter, printerName, devMode, devMode, mode);
-        }
-        ClosePrinter(hPrinter);
-    }
-
-    AutoDeleteDC hdc{CreateDCW(nullptr, printerName, nullptr, devMode)};
+    AutoDeleteDC hdc{CreateDCW(nullptr, printerName, nullptr, pd.printer->devMode)};
     if (!hdc) {
         logf("PrintToDevice: CreateDCW('%s') failed\n", pd.printer->name);
         return false;
     }
 
-    // for PDF Printer, this shows a file dialog to pick file name for destination PDF
-    res = StartDoc(hdc, &di);
-    if (res <= 0) {
-        logf("PrintToDevice: StartDoc() failed with %d\n", res);
-        return false;
-    }
+    PrintDeviceMetrics m = GetPrintDeviceMetrics(pd, hdc);
 
-    // MM_TEXT: Each logical unit is mapped to one device pixel.
-    // Positive x is to the right; positive y is down.
-    SetMapMode(hdc, MM_TEXT);
+    if (pd.sel.size() > 0) {
+        // for PDF Printer, this shows a file dialog to pick file name for destination PDF
+        res = StartDoc(hdc, &di);
+        if (res <= 0) {
+            logf("PrintToDevice: StartDoc() failed with %d\n", res);
+            return false;
+        }
 
-    const Size paperSize(GetDeviceCaps(hdc, PHYSICALWIDTH), GetDeviceCaps(hdc, PHYSICALHEIGHT));
-    const Rect printable(GetDeviceCaps(hdc, PHYSICALOFFSETX), GetDeviceCaps(hdc, PHYSICALOFFSETY),
-                         GetDeviceCaps(hdc, HORZRES), GetDeviceCaps(hdc, VERTRES));
-    float fileDPI = engine.GetFileDPI();
-    float px = (float)GetDeviceCaps(hdc, LOGPIXELSX);
-    float py = (float)GetDeviceCaps(hdc, LOGPIXELSY);
-    float dpiFactor = std::min(px / fileDPI, py / fileDPI);
-    bool bPrintPortrait = paperSize.dx < paperSize.dy;
-    if (devMode && (devMode->dmFields & DM_ORIENTATION)) {
-        bPrintPortrait = DMORIENT_PORTRAIT == devMode->dmOrientation;
-    }
-    if (pd.advData.rotation == PrintRotationAdv::Portrait) {
-        bPrintPortrait = true;
-    } else if (pd.advData.rotation == PrintRotationAdv::Landscape) {
-        bPrintPortrait = false;
-    }
+        // MM_TEXT: Each logical unit is mapped to one device pixel.
+        // Positive x is to the right; positive y is down.
+        SetMapMode(hdc, MM_TEXT);
 
-    if (pd.sel.size() > 0) {
         for (int pageNo = 1; pageNo <= engine.PageCount(); pageNo++) {
             RectF bounds = BoundSelectionOnPage(pd.sel, pageNo);
             if (bounds.IsEmpty()) {
@@ -399,13 +758,13 @@ static bool PrintToDevice(const PrintData& pd) {
             StartPage(hdc);
 
             SizeF bSize = bounds.Size();
-            float zoom = std::min((float)printable.dx / bSize.dx, (float)printable.dy / bSize.dy);
+            float zoom = std::min((float)m.printable.dx / bSize.dx, (float)m.printable.dy / bSize.dy);
             // use the correct zoom values, if the page fits otherwise
             // and the user didn't ask for anything else (default setting)
             if (PrintScaleAdv::Shrink == pd.advData.scale) {
-                zoom = std::min(dpiFactor, zoom);
+                zoom = std::min(m.dpiFactor, zoom);
             } else if (PrintScaleAdv::None == pd.advData.scale) {
-                zoom = dpiFactor;
+                zoom = m.dpiFactor;
             }
 
             for (size_t i = 0; i < pd.sel.size(); i++) {
@@ -417,8 +776,8 @@ static bool PrintToDevice(const PrintData& pd) {
                 Point offset((int)((clipRegion->x - bounds.x) * zoom), (int)((clipRegion->y - bounds.y) * zoom));
                 if (pd.advData.scale != PrintScaleAdv::None) {
                     // center the selection on the physical paper
-                    offset.x += (int)(printable.dx - bSize.dx * zoom) / 2;
-                    offset.y += (int)(printable.dy - bSize.dy * zoom) / 2;
+                    offset.x += (int)(m.printable.dx - bSize.dx * zoom) / 2;
+                    offset.y += (int)(m.printable.dy - bSize.dy * zoom) / 2;
                 }
 
                 bool ok = false;
@@ -463,117 +822,22 @@ static bool PrintToDevice(const PrintData& pd) {
     }
 
     // print all the pages the user requested
-    for (size_t i = 0; i < pd.ranges.size(); i++) {
-        int dir = pd.ranges.at(i).nFromPage > pd.ranges.at(i).nToPage ? -1 : 1;
-        for (DWORD pageNo = pd.ranges.at(i).nFromPage; pageNo != pd.ranges.at(i).nToPage + dir; pageNo += dir) {
-            if ((PrintRangeAdv::Even == pd.advData.range && pageNo % 2 != 0) ||
-                (PrintRangeAdv::Odd == pd.advData.range && pageNo % 2 == 0)) {
-                continue;
-            }
-            UpdateProgress(progressCb, current, total);
-
-            res = StartPage(hdc);
-            if (res <= 0) {
-                logf("PrintToDevice: StartPage() failed with %d\n", res);
-                continue;
-            }
-
-            SizeF pSize = engine.PageMediabox(pageNo).Size();
-            int rotation = 0;
-            // Turn the document by 90 deg if it isn't in portrait mode & if autoRotation is not disabled
-            if (pd.advData.autoRotate && pSize.dx > pSize.dy) {
-                rotation += 90;
-                std::swap(pSize.dx, pSize.dy);
-            }
-            // make sure not to print upside-down
-            rotation = (rotation % 180) == 0 ? 0 : 270;
-            // finally turn the page by (another) 90 deg in landscape mode
-            if (!bPrintPortrait) {
-                rotation = (rotation + 90) % 360;
-                std::swap(pSize.dx, pSize.dy);
-            }
-
-            // dpiFactor means no physical zoom
-            float zoom = dpiFactor;
-            // offset of the top-left corner of the page from the printable area
-            // (negative values move the page into the left/top margins, etc.);
-            // offset adjustments are needed because the GDI coordinate system
-            // starts at the corner of the printable area and we rather want to
-            // center the page on the physical paper (except for PrintScaleNone
-            // where the page starts at the very top left of the physical paper so
-            // that printing forms/labels of varying size remains reliably possible)
-            Point offset(-printable.x, -printable.y);
-
-            if (pd.advData.scale != PrintScaleAdv::None) {
-                // make sure to fit all content into the printable area when scaling
-                // and the whole document page on the physical paper
-                RectF rect = engine.PageContentBox(pageNo, RenderTarget::Print);
-                RectF cbox = engine.Transform(rect, pageNo, 1.0, rotation);
-                zoom = std::min((float)printable.dx / cbox.dx,
-                                std::min((float)printable.dy / cbox.dy,
-                                         std::min((float)paperSize.dx / pSize.dx, (float)paperSize.dy / pSize.dy)));
-                // use the correct zoom values, if the page fits otherwise
-                // and the user didn't ask for anything else (default setting)
-                if (PrintScaleAdv::Shrink == pd.advData.scale && dpiFactor < zoom) {
-                    zoom = dpiFactor;
-                }
-                // center the page on the physical paper
-                offset.x += (int)(paperSize.dx - pSize.dx * zoom) / 2;
-                offset.y += (int)(paperSize.dy - pSize.dy * zoom) / 2;
-                // make sure that no content lies in the non-printable paper margins
-                RectF onPaper(printable.x + offset.x + cbox.x * zoom, printable.y + offset.y + cbox.y * zoom,
-                              cbox.dx * zoom, cbox.dy * zoom);
-                if (onPaper.x < printable.x) {
-                    offset.x += (int)(printable.x - onPaper.x);
-                } else if (onPaper.BR().x > printable.BR().x) {
-                    offset.x -= (int)(onPaper.BR().x - printable.BR().x);
-                }
-                if (onPaper.y < printable.y) {
-                    offset.y += (int)(printable.y - onPaper.y);
-                } else if (onPaper.BR().y > printable.BR().y) {
-                    offset.y -= (int)(onPaper.BR().y - printable.BR().y);
-                }
-            }
-
-            bool ok = false;
-            short shrink = 1;
-            do {
-                RenderPageArgs args(pageNo, zoom / shrink, rotation, nullptr, RenderTarget::Print);
-                if (abortCookie) {
-                    args.cookie_out = &abortCookie->cookie;
-                }
-                RenderedBitmap* bmp = engine.RenderPage(args);
-                if (abortCookie) {
-                    abortCookie->Clear();
-                }
-                if (bmp && bmp->IsValid()) {
-                    auto size = bmp->GetSize();
-                    Rect rc(offset.x, offset.y, size.dx * shrink, size.dy * shrink);
-                    ok = bmp->Blit(hdc, rc);
-                }
-                delete bmp;
-                shrink *= 2;
-            } while (!ok && shrink < 32 && !WasCanceled(progressCb));
-            // TODO: abort if !ok?
-
-            res = EndPage(hdc);
-            bool wasCanceled = WasCanceled(progressCb);
-            if (res <= 0 || wasCanceled) {
-                logf("PrintToDevice: EndPage() failed with %d or wasCanceled: %d\n", res, (int)wasCanceled);
-                AbortDoc(hdc);
-                return false;
-            }
-            current++;
-        }
+    PrintRenderQueue queue;
+    BuildPrintPageTasks(pd, m, &queue);
+    // with a single page there's nothing to overlap with spooling
+    bool useQueue = queue.tasks.Size() > 1;
+    if (useQueue) {
+        StartPrintRenderQueue(&queue, pd.engine);
     }
+    defer {
+        StopPrintRenderQueue(&queue);
+    };
 
-    res = EndDoc(hdc);
-    if (res <= 0) {
-        logf("PrintToDevice: EndDoc() failed with %d\n", res);
-        return false;
+    bool ok = SpoolPrintTasks(pd, hdc, &di, queue, useQueue, total);
+    if (ok) {
+        logf("PrintToDevice: finished ok\n");
     }
-    logf("PrintToDevice: finished ok\n");
-    return true;
+    return ok;
 }
 
 struct UpdatePrintProgressData {
@@ -1235,10 +1499,46 @@ static void SetPrinterCustomPaperSizeForEngine(EngineBase* engine, Printer* prin
     SetCustomPaperSize(printer, size);
 }
 
-bool PrintFile2(EngineBase* engine, char* printerName, bool displayErrors, const char* settings) {
-    bool ok = false;
+// creates a Printer for printerName (the default printer when null) set
+// up for printing engine; fills ranges and advanced from -print-settings
+static Printer* CreatePrinterForEngine(EngineBase* engine, char* printerName, bool displayErrors,
+                                       const char* settings, Vec<PRINTPAGERANGE>& ranges,
+                                       Print_Advanced_Data& advanced) {
     Printer* printer = nullptr;
+    if (printerName) {
+        printer = NewPrinter(printerName);
+    } else {
+        char* defName = GetDefaultPrinterNameTemp();
+        if (!defName) {
+            logf("CreatePrinterForEngine: GetDefaultPrinterName() failed\n");
+            return nullptr;
+        }
+        printer = NewPrinter(defName);
+    }
+
+    if (!printer) {
+        MessageBoxWarningCond(displayErrors, _TRA("Printer with given name doesn't exist"), _TRA("Printing problem."));
+        return nullptr;
+    }
 
+    // set paper size to match the size of the document's first page
+    // (will be overridden by any paper= value in -print-settings)
+    auto devMode = printer->devMode;
+    devMode->dmPaperSize = GetPaperSize(engine);
+
+    ApplyPrintSettings(printer, settings, engine->PageCount(), ranges, advanced);
+
+    if (advanced.rotation == PrintRotationAdv::Auto && devMode->dmPaperSize == 0) {
+        if (devMode->dmPaperSize = DetectPrinterPaperSize(engine, printer)) {
+            devMode->dmFields |= DM_PAPERSIZE;
+        } else {
+            SetPrinterCustomPaperSizeForEngine(engine, printer);
+        }
+    }
+    return printer;
+}
+
+bool PrintFile2(EngineBase* engine, char* printerName, bool displayErrors, const char* settings) {
     if (!HasPermission(Perm::PrinterAccess)) {
         return false;
     }
@@ -1257,47 +1557,19 @@ bool PrintFile2(EngineBase* engine, char* printerName, bool displayErrors, const
 
     logf("PrintFile2: file: '%s', printer: '%s'\n", engine->FilePath(), printerName);
 
-    if (printerName) {
-        printer = NewPrinter(printerName);
-    } else {
-        char* defName = GetDefaultPrinterNameTemp();
-        if (!defName) {
-            logf("PrintFile: GetDefaultPrinterName() failed\n");
-            return false;
-        }
-        printer = NewPrinter(defName);
-    }
-
+    Vec<PRINTPAGERANGE> ranges;
+    Print_Advanced_Data advanced;
+    Printer* printer = CreatePrinterForEngine(engine, printerName, displayErrors, settings, ranges, advanced);
     if (!printer) {
-        MessageBoxWarningCond(displayErrors, _TRA("Printer with given name doesn't exist"), _TRA("Printing problem."));
         return false;
     }
 
-    // set paper size to match the size of the document's first page
-    // (will be overridden by any paper= value in -print-settings)
-    auto devMode = printer->devMode;
-    devMode->dmPaperSize = GetPaperSize(engine);
-    {
-        Print_Advanced_Data advanced;
-        Vec<PRINTPAGERANGE> ranges;
-
-        ApplyPrintSettings(printer, settings, engine->PageCount(), ranges, advanced);
-
-        if (advanced.rotation == PrintRotationAdv::Auto && devMode->dmPaperSize == 0) {
-            if (devMode->dmPaperSize = DetectPrinterPaperSize(engine, printer)) {
-                devMode->dmFields |= DM_PAPERSIZE;
-            } else {
-                SetPrinterCustomPaperSizeForEngine(engine, printer);
-            }
-        }
-
-        // takes ownership of printer
-        PrintData pd(engine, printer, ranges, advanced);
-        ok = PrintToDevice(pd);
-        if (!ok) {
-            logfa("PrintToDevice: failed\n");
-            MessageBoxWarningCond(displayErrors, _TRA("Couldn't initialize printer"), _TRA("Printing problem."));
-        }
+    // takes ownership of printer
+    PrintData pd(engine, printer, ranges, advanced);
+    bool ok = PrintToDevice(pd);
+    if (!ok) {
+        logfa("PrintToDevice: failed\n");
+        MessageBoxWarningCond(displayErrors, _TRA("Couldn't initialize printer"), _TRA("Printing problem."));
     }
     logf("PrintFile2: finished ok\n");
     return ok;
@@ -1317,3 +1589,160 @@ bool PrintFile(const char* fileName, char* printerName, bool displayErrors, cons
     logfa("PrintFile: finished ok\n");
     return ok;
 }
+
+/* Batch printing (-print-to with several files).
+
+One process already prints all the files sequentially, but each job used
+to run end to end before the next one started: load the document, set up
+the printer, rasterize, spool. PrintFiles() instead prepares the next
+job on a background thread -- engine load, printer setup, printer DC
+creation and the start of rasterization -- while the current job spools,
+so the spooler doesn't go idle between documents. The combined
+rasterizer worker count of the two live jobs stays capped (see
+StartPrintRenderQueue). */
+
+struct BatchPrintJob {
+    PrintData* pd = nullptr;
+    HDC hdc = nullptr;
+    PrintRenderQueue queue;
+    bool useQueue = false;
+
+    ~BatchPrintJob() {
+        StopPrintRenderQueue(&queue);
+        if (hdc) {
+            DeleteDC(hdc);
+        }
+        delete pd;
+    }
+};
+
+static BatchPrintJob* PrepareBatchPrintJob(const char* path, char* printerName, bool displayErrors,
+                                           const char* settings) {
+    if (!HasPermission(Perm::PrinterAccess)) {
+        return nullptr;
+    }
+
+    TempStr fileName = path::NormalizeTemp(path);
+    EngineBase* engine = CreateEngineFromFile(fileName, nullptr, true);
+#ifndef DISABLE_DOCUMENT_RESTRICTIONS
+    if (engine && !engine->AllowsPrinting()) {
+        engine->Release();
+        engine = nullptr;
+    }
+#endif
+    if (!engine) {
+        TempStr msg = str::FormatTemp("Couldn't open file '%s' for printing", fileName);
+        MessageBoxWarningCond(displayErrors, msg, "Error");
+        return nullptr;
+    }
+
+    Vec<PRINTPAGERANGE> ranges;
+    Print_Advanced_Data advanced;
+    Printer* printer = CreatePrinterForEngine(engine, printerName, displayErrors, settings, ranges, advanced);
+    if (!printer) {
+        engine->Release();
+        return nullptr;
+    }
+    ValidatePrinterSettings(printer);
+
+    auto job = new BatchPrintJob;
+    // takes ownership of printer
+    job->pd = new PrintData(engine, printer, ranges, advanced);
+    engine->Release();
+
+    WCHAR* printerNameW = ToWStrTemp(printer->name);
+    job->hdc = CreateDCW(nullptr, printerNameW, nullptr, printer->devMode);
+    if (!job->hdc) {
+        logf("PrepareBatchPrintJob: CreateDCW('%s') failed\n", printer->name);
+        delete job;
+        return nullptr;
+    }
+
+    PrintDeviceMetrics m = GetPrintDeviceMetrics(*job->pd, job->hdc);
+    BuildPrintPageTasks(*job->pd, m, &job->queue);
+    if (job->queue.tasks.Size() == 0) {
+        logf("PrepareBatchPrintJob: no pages to print in '%s'\n", fileName);
+        delete job;
+        return nullptr;
+    }
+    // rendering only needs the DC metrics, not StartDoc(), so it can
+    // run ahead while an earlier job is still spooling
+    job->useQueue = job->queue.tasks.Size() > 1;
+    if (job->useQueue) {
+        StartPrintRenderQueue(&job->queue, job->pd->engine);
+    }
+    return job;
+}
+
+static bool SpoolBatchPrintJob(BatchPrintJob* job) {
+    PrintData* pd = job->pd;
+    logf("SpoolBatchPrintJob: printer: '%s', file: '%s'\n", pd->printer->name, pd->engine->FilePath());
+
+    DOCINFOW di{};
+    di.cbSize = sizeof(DOCINFO);
+    di.lpszDocName = ToWStrTemp(pd->engine->FilePath());
+    if (pd->printer->output) {
+        di.lpszOutput = ToWStrTemp(pd->printer->output);
+    }
+    int total = job->queue.tasks.Size();
+    return SpoolPrintTasks(*pd, job->hdc, &di, job->queue, job->useQueue, total);
+}
+
+struct PrepareBatchPrintData {
+    const char* path = nullptr;
+    char* printerName = nullptr;
+    const char* settings = nullptr;
+    bool displayErrors = false;
+    BatchPrintJob* job = nullptr;
+};
+
+static void PrepareBatchPrintThread(PrepareBatchPrintData* d) {
+    d->job = PrepareBatchPrintJob(d->path, d->printerName, d->displayErrors, d->settings);
+}
+
+int PrintFiles(const StrVec& files, char* printerName, bool displayErrors, const char* settings) {
+    int nFiles = files.Size();
+    int nFailed = 0;
+
+    BatchPrintJob* job = nullptr;
+    if (nFiles > 0) {
+        job = PrepareBatchPrintJob(files.At(0), printerName, displayErrors, settings);
+    }
+    for (int i = 0; i < nFiles; i++) {
+        // prepare the next document in parallel with spooling this one
+        PrepareBatchPrintData prep;
+        HANDLE hPrepareThread = nullptr;
+        if (i + 1 < nFiles) {
+            prep.path = files.At(i + 1);
+            prep.printerName = printerName;
+            prep.settings = settings;
+            prep.displayErrors = displayErrors;
+            auto fn = MkFunc0(PrepareBatchPrintThread, &prep);
+            hPrepareThread = StartThread(fn, "PrintPrepareThread");
+        }
+
+        if (!job) {
+            nFailed++;
+        } else {
+            bool ok = SpoolBatchPrintJob(job);
+            if (!ok) {
+                logfa("PrintFiles: printing '%s' failed\n", files.At(i));
+                MessageBoxWarningCond(displayErrors, _TRA("Couldn't initialize printer"), _TRA("Printing problem."));
+                nFailed++;
+            }
+            delete job;
+            job = nullptr;
+        }
+
+        if (hPrepareThread) {
+            WaitForSingleObject(hPrepareThread, INFINITE);
+            CloseHandle(hPrepareThread);
+            job = prep.job;
+        } else if (i + 1 < nFiles) {
+            // couldn't start the prepare thread; prepare synchronously
+            job = PrepareBatchPrintJob(files.At(i + 1), printerName, displayErrors, settings);
+        }
+    }
+    logf("PrintFiles: finished, %d of %d failed\n", nFailed, nFiles);
+    return nFailed;
+}
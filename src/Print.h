@@ -38,5 +38,9 @@ bool PrintFile(const char* fileName, char* printerName = nullptr, bool displayEr
                const char* settings = nullptr);
 bool PrintFile2(EngineBase* engine, char* printerName = nullptr, bool displayErrors = true,
                 const char* settings = nullptr);
+// batch version of PrintFile for several files; returns the number of
+// files that failed to print
+int PrintFiles(const StrVec& files, char* printerName = nullptr, bool displayErrors = true,
+               const char* settings = nullptr);
 void PrintCurrentFile(MainWindow* win, bool waitForCompletion = false);
 void AbortPrinting(MainWindow* win);
@@ -2,9 +2,17 @@
    License: GPLv3 */
 
 #include "utils/BaseUtil.h"
+#include <zlib.h>
 #include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
+#include "utils/ThreadUtil.h"
 #include "utils/Timer.h"
+#include "utils/CacheFile.h"
+#include "utils/CryptoUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/GdiPlusUtil.h"
+#include "utils/HttpUtil.h"
+#include "utils/PerfTrace.h"
 
 #include "wingui/UIModels.h"
 
@@ -14,8 +22,10 @@
 #include "EngineAll.h"
 #include "DisplayModel.h"
 #include "GlobalPrefs.h"
+#include "AppSettings.h"
 #include "RenderCache.h"
 #include "TextSelection.h"
+#include "FileThumbnails.h"
 
 #define NO_LOG
 #include "utils/Log.h"
@@ -30,6 +40,27 @@
 
 bool gShowTileLayout = false;
 
+/* optional display color management for print-proofing workflows: each
+rendered bitmap is converted from sRGB to the monitor's ICC profile once,
+right after rendering, so painting stays a plain blit with no per-frame
+conversion. off by default: the transform costs some milliseconds per
+rendered tile and without a calibrated profile it's a no-op anyway */
+bool gColorManagedRendering = false;
+
+struct RenderThreadData {
+    RenderCache* cache = nullptr;
+    int threadNo = 0;
+};
+
+// keep one core free for the UI thread so that painting the finished
+// bitmaps doesn't compete with rasterization
+static int GetRenderThreadCount() {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int n = (int)si.dwNumberOfProcessors - 1;
+    return limitValue(n, 1, MAX_RENDER_THREADS);
+}
+
 RenderCache::RenderCache() : maxTileSize({GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN)}) {
     // enable when debugging RenderCache logic
     // gEnableDbgLog = true;
@@ -41,20 +72,47 @@ RenderCache::RenderCache() : maxTileSize({GetSystemMetrics(SM_CXSCREEN), GetSyst
     InitializeCriticalSection(&cacheAccess);
     InitializeCriticalSection(&requestAccess);
 
-    startRendering = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    renderThread = CreateThread(nullptr, 0, RenderCacheThread, this, 0, nullptr);
-    ReportIf(nullptr == renderThread);
+    lowMemoryNotification = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+
+    // manual-reset: a single request must be able to wake every idle worker
+    // as work for other workers can become eligible once it's picked up
+    startRendering = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    renderThreadCount = GetRenderThreadCount();
+    for (int i = 0; i < renderThreadCount; i++) {
+        auto td = new RenderThreadData{this, i};
+        renderThreads[i] = CreateThread(nullptr, 0, RenderCacheThread, td, 0, nullptr);
+        ReportIf(nullptr == renderThreads[i]);
+    }
 }
 
+static CacheFile* gWorkingSetCache = nullptr;
+
 RenderCache::~RenderCache() {
+    CloseCacheFile(gWorkingSetCache);
+    gWorkingSetCache = nullptr;
     EnterCriticalSection(&requestAccess);
     EnterCriticalSection(&cacheAccess);
 
-    CloseHandle(renderThread);
+    bool hasCurReq = false;
+    for (int i = 0; i < renderThreadCount; i++) {
+        CloseHandle(renderThreads[i]);
+        if (curReqs[i]) {
+            hasCurReq = true;
+        }
+    }
     CloseHandle(startRendering);
-    if (curReq || 0 != requestCount || cacheCount != 0) {
-        logf("RenderCache::~RenderCache: curReq: 0x%p, requestCount: %d, cacheCount: %d\n", curReq, requestCount,
-             cacheCount);
+    if (lowMemoryNotification) {
+        CloseHandle(lowMemoryNotification);
+    }
+    DeleteVecMembers(previews);
+    for (int i = 0; i < compressedCount; i++) {
+        delete compressed[i];
+    }
+    compressedCount = 0;
+    compressedBytes = 0;
+    if (hasCurReq || 0 != requestCount || cacheCount != 0) {
+        logf("RenderCache::~RenderCache: hasCurReq: %d, requestCount: %d, cacheCount: %d\n", (int)hasCurReq,
+             requestCount, cacheCount);
         ReportIf(true);
     }
 
@@ -75,10 +133,38 @@ BitmapCacheEntry* RenderCache::Find(DisplayModel* dm, int pageNo, int rotation,
         if ((dm == e->dm) && (pageNo == e->pageNo) && (rotation == e->rotation) &&
             (kInvalidZoom == zoom || zoom == e->zoom) && (!tile || e->tile == *tile)) {
             e->refs++;
+            e->lastUse = GetTickCount();
             ReportIf(i != e->cacheIdx);
             return e;
         }
     }
+    if (kInvalidZoom != zoom && tile) {
+        // another tab showing the same document content at the same
+        // zoom can paint from that tab's bitmap instead of rendering
+        // its own copy (frequent when comparing a file side-by-side)
+        u32 fp = 0;
+        bool fpComputed = false;
+        for (int i = 0; i < cacheCount; i++) {
+            BitmapCacheEntry* e = cache[i];
+            if ((dm == e->dm) || (pageNo != e->pageNo) || (rotation != e->rotation) || (zoom != e->zoom) ||
+                !(e->tile == *tile) || e->outOfDate || (0 == e->contentFingerprint)) {
+                continue;
+            }
+            if (!fpComputed) {
+                // can-fail so that painting never blocks on a render
+                // in progress; we just miss the share this time
+                fp = EnginePageContentFingerprintCanFail(dm->GetEngine(), pageNo);
+                fpComputed = true;
+            }
+            if (fp != e->contentFingerprint) {
+                continue;
+            }
+            e->refs++;
+            e->lastUse = GetTickCount();
+            return e;
+        }
+        return PromoteCompressed(dm, pageNo, rotation, zoom, *tile);
+    }
     return nullptr;
 }
 
@@ -112,6 +198,8 @@ bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
     logf("RenderCache::DropCacheEntry: pageNo: %d, rotation: %d, zoom: %.2f\n", entry->pageNo, entry->rotation,
          entry->zoom);
 
+    ReportIf(entry->byteSize > cacheBytes);
+    cacheBytes -= entry->byteSize;
     delete entry;
 
     // fast removal by replacing freed item with the item at the end
@@ -127,43 +215,298 @@ bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
     return true;
 }
 
-static bool FreeIfFull(RenderCache* rc, const PageRenderRequest& req) {
-    int n = rc->cacheCount;
-    if (n < MAX_BITMAPS_CACHED) {
-        return true;
+CompressedCacheEntry::~CompressedCacheEntry() {
+    free(data);
+}
+
+static BITMAPINFO MakeBitmapInfo(Size size) {
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = size.dx;
+    bmi.bmiHeader.biHeight = -size.dy;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biSizeImage = size.dx * 4 * size.dy;
+    return bmi;
+}
+
+// compress a bitmap about to be evicted so that coming back to its page
+// is a decompression instead of a full re-render. Returns nullptr if the
+// pixels can't be read or don't compress to less than the original size
+void RenderCache::StashCompressed(BitmapCacheEntry* entry) {
+    if (!entry->bitmap || entry->outOfDate || entry->zoom == kInvalidZoom) {
+        return;
+    }
+    HBITMAP hbmp = entry->bitmap->GetBitmap();
+    if (!hbmp) {
+        return;
+    }
+    Size size = entry->bitmap->GetSize();
+    BITMAPINFO bmi = MakeBitmapInfo(size);
+    uLong nBytes = (uLong)bmi.bmiHeader.biSizeImage;
+    u8* pixels = (u8*)malloc(nBytes);
+    if (!pixels) {
+        return;
+    }
+    HDC hdc = GetDC(nullptr);
+    int nLines = GetDIBits(hdc, hbmp, 0, size.dy, pixels, &bmi, DIB_RGB_COLORS);
+    ReleaseDC(nullptr, hdc);
+    if (nLines != size.dy) {
+        free(pixels);
+        return;
+    }
+    uLongf compressedSize = compressBound(nBytes);
+    u8* data = (u8*)malloc(compressedSize);
+    if (!data || Z_OK != compress2(data, &compressedSize, pixels, nBytes, Z_BEST_SPEED)) {
+        free(data);
+        free(pixels);
+        return;
+    }
+    free(pixels);
+    if (compressedSize >= nBytes) {
+        // pathological content (e.g. photos), not worth keeping
+        free(data);
+        return;
     }
 
-    DisplayModel* dm = req.dm;
-    // free an invisible page of the same DisplayModel ...
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm && !dm->PageVisibleNearby(entry->pageNo)) {
-            bool didDrop = rc->DropCacheEntry(entry);
-            if (didDrop) {
-                return true;
-            }
-        }
+    ScopedCritSec scope(&cacheAccess);
+    if (compressedCount == MAX_BITMAPS_COMPRESSED) {
+        ReportIf(compressed[0]->dataSize > compressedBytes);
+        compressedBytes -= compressed[0]->dataSize;
+        delete compressed[0];
+        memmove(&compressed[0], &compressed[1], sizeof(compressed[0]) * (MAX_BITMAPS_COMPRESSED - 1));
+        compressedCount--;
     }
+    auto e = new CompressedCacheEntry();
+    e->dm = entry->dm;
+    e->pageNo = entry->pageNo;
+    e->rotation = entry->rotation;
+    e->zoom = entry->zoom;
+    e->tile = entry->tile;
+    e->size = size;
+    e->textColor = entry->textColor;
+    e->bgColor = entry->bgColor;
+    e->keepsOriginalColors = entry->keepsOriginalColors;
+    e->data = data;
+    e->dataSize = (size_t)compressedSize;
+    e->uncompressedSize = (size_t)nBytes;
+    compressed[compressedCount++] = e;
+    compressedBytes += e->dataSize;
+    logf("RenderCache::StashCompressed: pageNo: %d, %d => %d bytes\n", e->pageNo, (int)nBytes, (int)compressedSize);
+}
 
-    // ... or just the oldest cached page
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm) {
-            // don't free pages from the document we're currently displaying
-            // as it leads to flicker
-            // TODO: it can still flicker if the dm is from a visible tab
-            // in a different window, but it's harder to detect
+void RenderCache::FreeCompressed(DisplayModel* dm, int pageNo) {
+    ScopedCritSec scope(&cacheAccess);
+    for (int i = compressedCount - 1; i >= 0; i--) {
+        CompressedCacheEntry* e = compressed[i];
+        if (e->dm != dm || (pageNo != kInvalidPageNo && e->pageNo != pageNo)) {
             continue;
         }
-        bool didDrop = rc->DropCacheEntry(entry);
-        if (didDrop) {
+        ReportIf(e->dataSize > compressedBytes);
+        compressedBytes -= e->dataSize;
+        delete e;
+        memmove(&compressed[i], &compressed[i + 1], sizeof(compressed[0]) * (compressedCount - i - 1));
+        compressedCount--;
+    }
+}
+
+void RenderCache::AddPreview(DisplayModel* dm, int pageNo, int rotation, RenderedBitmap* bmp) {
+    ReportIf(!bmp);
+    if (!bmp) {
+        return;
+    }
+    ScopedCritSec scope(&cacheAccess);
+    for (PagePreviewEntry* e : previews) {
+        if (e->dm == dm && e->pageNo == pageNo) {
+            // e.g. re-rendered after a rotation change
+            delete e->bitmap;
+            e->bitmap = bmp;
+            e->rotation = rotation;
+            e->lastUse = GetTickCount();
+            return;
+        }
+    }
+    if (previews.Size() >= MAX_PAGE_PREVIEWS) {
+        // evict the least recently painted preview
+        int oldest = 0;
+        for (int i = 1; i < previews.Size(); i++) {
+            if (previews.at(i)->lastUse < previews.at(oldest)->lastUse) {
+                oldest = i;
+            }
+        }
+        delete previews.PopAt(oldest);
+    }
+    auto e = new PagePreviewEntry;
+    e->dm = dm;
+    e->pageNo = pageNo;
+    e->rotation = rotation;
+    e->bitmap = bmp;
+    e->lastUse = GetTickCount();
+    previews.Append(e);
+}
+
+bool RenderCache::HasPreview(DisplayModel* dm, int pageNo, int rotation) {
+    ScopedCritSec scope(&cacheAccess);
+    for (PagePreviewEntry* e : previews) {
+        if (e->dm == dm && e->pageNo == pageNo && e->rotation == rotation) {
             return true;
         }
     }
     return false;
 }
 
-void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp) {
+bool RenderCache::PaintPreview(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, Rect pageOnScreen) {
+    if (pageOnScreen.IsEmpty()) {
+        return false;
+    }
+    ScopedCritSec scope(&cacheAccess);
+    PagePreviewEntry* entry = nullptr;
+    for (PagePreviewEntry* e : previews) {
+        if (e->dm == dm && e->pageNo == pageNo && e->rotation == dm->GetRotation()) {
+            entry = e;
+            break;
+        }
+    }
+    HBITMAP hbmp = entry && entry->bitmap ? entry->bitmap->GetBitmap() : nullptr;
+    if (!hbmp) {
+        return false;
+    }
+    HDC bmpDC = CreateCompatibleDC(hdc);
+    if (!bmpDC) {
+        return false;
+    }
+    entry->lastUse = GetTickCount();
+    Size bmpSize = entry->bitmap->GetSize();
+    int xSrc = (bounds.x - pageOnScreen.x) * bmpSize.dx / pageOnScreen.dx;
+    int ySrc = (bounds.y - pageOnScreen.y) * bmpSize.dy / pageOnScreen.dy;
+    int dxSrc = bounds.dx * bmpSize.dx / pageOnScreen.dx;
+    int dySrc = bounds.dy * bmpSize.dy / pageOnScreen.dy;
+    HGDIOBJ prevBmp = SelectObject(bmpDC, hbmp);
+    // the preview is upscaled heavily, HALFTONE keeps it legible
+    int prevMode = SetStretchBltMode(hdc, HALFTONE);
+    StretchBlt(hdc, bounds.x, bounds.y, bounds.dx, bounds.dy, bmpDC, xSrc, ySrc, dxSrc, dySrc, SRCCOPY);
+    SetStretchBltMode(hdc, prevMode);
+    SelectObject(bmpDC, prevBmp);
+    DeleteDC(bmpDC);
+    return true;
+}
+
+void RenderCache::FreePreviews(DisplayModel* dm) {
+    ScopedCritSec scope(&cacheAccess);
+    for (int i = previews.Size() - 1; i >= 0; i--) {
+        if (previews.at(i)->dm == dm) {
+            delete previews.PopAt(i);
+        }
+    }
+}
+
+// under memory pressure the compressed tier is dropped entirely: it only
+// exists to make revisiting pages cheaper and can always be rebuilt
+void RenderCache::FreeAllCompressed() {
+    ScopedCritSec scope(&cacheAccess);
+    for (int i = 0; i < compressedCount; i++) {
+        delete compressed[i];
+    }
+    compressedCount = 0;
+    compressedBytes = 0;
+}
+
+size_t RenderCache::CacheBudgetBytes() {
+    constexpr size_t oneMB = 1024 * 1024;
+    size_t budget;
+    int prefMB = gGlobalPrefs ? gGlobalPrefs->renderCacheSizeInMB : 0;
+    if (prefMB > 0) {
+        budget = (size_t)prefMB * oneMB;
+    } else {
+        // an eighth of installed RAM so that a kiosk machine with many
+        // tabs open doesn't get paged out just for cached renderings
+        MEMORYSTATUSEX ms{};
+        ms.dwLength = sizeof(ms);
+        GlobalMemoryStatusEx(&ms);
+        budget = (size_t)(ms.ullTotalPhys / 8);
+        budget = limitValue<size_t>(budget, 64 * oneMB, 1024 * oneMB);
+        if (IsLowMemoryMode()) {
+            // keep a much smaller footprint; the compressed tier (counted
+            // against the same budget) still makes revisits cheap
+            budget = (size_t)(ms.ullTotalPhys / 32);
+            budget = limitValue<size_t>(budget, 32 * oneMB, 128 * oneMB);
+        }
+    }
+    BOOL lowMemory = FALSE;
+    if (lowMemoryNotification && QueryMemoryResourceNotification(lowMemoryNotification, &lowMemory) && lowMemory) {
+        budget /= 4;
+    }
+    return budget;
+}
+
+// picks the least valuable evictable entry: the cost of a bitmap in
+// bytes, weighted by how long ago it was last painted, so that one
+// stale 4K page goes before a dozen recently used thumbnails. Entries
+// still referenced elsewhere are never eligible; pages visible (or
+// nearby) in their DisplayModel only as a last resort (allowVisible)
+// and then never from the requesting document, as that leads to flicker
+// TODO: it can still flicker if the dm is from a visible tab
+// in a different window, but it's harder to detect
+static BitmapCacheEntry* NextEvictionCandidate(RenderCache* rc, DisplayModel* reqDm, bool allowVisible) {
+    DWORD now = GetTickCount();
+    BitmapCacheEntry* best = nullptr;
+    u64 bestScore = 0;
+    for (int i = 0; i < rc->cacheCount; i++) {
+        BitmapCacheEntry* entry = rc->cache[i];
+        if (entry->refs != 1) {
+            continue;
+        }
+        if (entry->dm->PageVisibleNearby(entry->pageNo)) {
+            if (!allowVisible || entry->dm == reqDm) {
+                continue;
+            }
+        }
+        u64 age = (u64)(now - entry->lastUse) + 1;
+        u64 score = age * (u64)(entry->byteSize + 1);
+        if (score > bestScore) {
+            best = entry;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+// make room for one more bitmap: the cache is bounded both by entry
+// count (GDI objects) and by the byte budget
+static bool FreeIfFull(RenderCache* rc, const PageRenderRequest& req) {
+    size_t budget = rc->CacheBudgetBytes();
+    bool overBudget = rc->cacheBytes + rc->compressedBytes > budget;
+    if (overBudget) {
+        rc->FreeAllCompressed();
+    }
+
+    while (rc->cacheCount >= MAX_BITMAPS_CACHED || rc->cacheBytes > budget) {
+        BitmapCacheEntry* entry = NextEvictionCandidate(rc, req.dm, false);
+        if (!entry) {
+            entry = NextEvictionCandidate(rc, req.dm, true);
+        }
+        if (!entry) {
+            // everything left is referenced or would flicker
+            return rc->cacheCount < MAX_BITMAPS_CACHED;
+        }
+        if (!overBudget) {
+            // compressing costs memory, don't when we're trying to shed it
+            rc->StashCompressed(entry);
+        }
+        rc->DropCacheEntry(entry);
+    }
+    return true;
+}
+
+void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp, COLORREF textColor, COLORREF bgColor,
+                      bool keepsOriginalColors) {
+    // computed before taking cacheAccess so that the cache lock is
+    // never held while waiting for the engine lock
+    u32 contentFingerprint = 0;
+    if (req.dm && bmp) {
+        contentFingerprint = EnginePageContentFingerprint(req.dm->GetEngine(), req.pageNo);
+    }
     ScopedCritSec scope(&cacheAccess);
     ReportIf(!req.dm);
 
@@ -179,9 +522,109 @@ void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp) {
 
     // Copy the PageRenderRequest as it will be reused
     auto entry = new BitmapCacheEntry(req.dm, req.pageNo, req.rotation, req.zoom, req.tile, bmp);
+    entry->contentFingerprint = contentFingerprint;
+    entry->textColor = textColor;
+    entry->bgColor = bgColor;
+    entry->keepsOriginalColors = keepsOriginalColors;
+    if (bmp) {
+        Size size = bmp->GetSize();
+        entry->byteSize = (size_t)size.dx * 4 * size.dy;
+    }
+    entry->lastUse = GetTickCount();
+    entry->cacheIdx = cacheCount;
+    cache[cacheCount] = entry;
+    cacheCount++;
+    cacheBytes += entry->byteSize;
+
+    if (req.timestamp != 0) {
+        lastRenderLatencyMs = (int)(GetTickCount() - req.timestamp);
+        renderLatencyTotalMs += lastRenderLatencyMs;
+        renderedCount++;
+    }
+}
+
+void RenderCache::ResetStats() {
+    ScopedCritSec scope(&cacheAccess);
+    paintHits = 0;
+    paintMisses = 0;
+    lastRenderLatencyMs = 0;
+    renderLatencyTotalMs = 0;
+    renderedCount = 0;
+}
+
+// if a matching bitmap sits in the compressed tier, decompress it back
+// into the cache. Returns the entry with an extra reference, like Find()
+BitmapCacheEntry* RenderCache::PromoteCompressed(DisplayModel* dm, int pageNo, int rotation, float zoom,
+                                                 TilePosition tile) {
+    ScopedCritSec scope(&cacheAccess);
+    int found = -1;
+    for (int i = 0; i < compressedCount; i++) {
+        CompressedCacheEntry* e = compressed[i];
+        if (e->dm == dm && e->pageNo == pageNo && e->rotation == rotation && e->zoom == zoom && e->tile == tile) {
+            found = i;
+            break;
+        }
+    }
+    if (found < 0) {
+        return nullptr;
+    }
+    CompressedCacheEntry* e = compressed[found];
+    COLORREF eText = e->textColor;
+    COLORREF eBg = e->bgColor;
+    bool keepsOriginalColors = e->keepsOriginalColors;
+    // promoting consumes the compressed copy either way
+    ReportIf(e->dataSize > compressedBytes);
+    compressedBytes -= e->dataSize;
+    memmove(&compressed[found], &compressed[found + 1], sizeof(compressed[0]) * (compressedCount - found - 1));
+    compressedCount--;
+
+    HBITMAP hbmp = CreateMemoryBitmap(e->size, nullptr);
+    u8* pixels = (u8*)malloc(e->uncompressedSize);
+    uLongf pixelsLen = (uLongf)e->uncompressedSize;
+    bool ok = hbmp && pixels && Z_OK == uncompress(pixels, &pixelsLen, e->data, (uLong)e->dataSize);
+    if (ok) {
+        BITMAPINFO bmi = MakeBitmapInfo(e->size);
+        SetDIBits(nullptr, hbmp, 0, e->size.dy, pixels, &bmi, DIB_RGB_COLORS);
+    }
+    free(pixels);
+    Size size = e->size;
+    delete e;
+    if (!ok) {
+        DeleteObject(hbmp);
+        return nullptr;
+    }
+
+    // the document colors may have changed while the tile sat in the
+    // compressed tier
+    if (!keepsOriginalColors && (eText != textColor || eBg != backgroundColor)) {
+        if (gColorManagedRendering || !RemapBitmapColors(hbmp, eText, eBg, textColor, backgroundColor)) {
+            DeleteObject(hbmp);
+            return nullptr;
+        }
+        eText = textColor;
+        eBg = backgroundColor;
+    }
+
+    PageRenderRequest tmp;
+    tmp.dm = dm;
+    if (!FreeIfFull(this, tmp)) {
+        DeleteObject(hbmp);
+        return nullptr;
+    }
+    auto bmp = new RenderedBitmap(hbmp, size);
+    auto entry = new BitmapCacheEntry(dm, pageNo, rotation, zoom, tile, bmp);
+    entry->textColor = eText;
+    entry->bgColor = eBg;
+    entry->keepsOriginalColors = keepsOriginalColors;
+    entry->byteSize = (size_t)size.dx * 4 * size.dy;
+    entry->lastUse = GetTickCount();
     entry->cacheIdx = cacheCount;
     cache[cacheCount] = entry;
     cacheCount++;
+    cacheBytes += entry->byteSize;
+    entry->refs++; // for the caller
+    logf("RenderCache::PromoteCompressed: pageNo: %d\n", pageNo);
+    return entry;
 }
 
 static RectF GetTileRect(RectF pagerect, TilePosition tile) {
@@ -268,6 +711,9 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
             if (!shouldFree && entry->tile.res > 1) {
                 shouldFree = !IsTileVisible(entry->dm, entry->pageNo, entry->tile, 2.0);
             }
+            if (shouldFree && entry->refs == 1) {
+                StashCompressed(entry);
+            }
         }
         if (shouldFree) {
             DropCacheEntry(entry);
@@ -275,8 +721,221 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
     }
 }
 
+/* Per-document working set persistence: when a document is closed, the
+compressed tiles covering its last viewport are written to a small file
+in the thumbnail cache directory. Reopening the document loads them
+straight back into the compressed tier, so the first Paint() promotes
+yesterday's pixels with a quick decompression instead of waiting for
+the engine to rasterize the page - perceived instant resume. The stash
+is invalidated by the document's size/modification time. */
+
+constexpr u32 kWorkingSetMagic = 0x31575354; // "TSW1"
+constexpr u32 kMaxPersistedTiles = 4;
+
+#pragma pack(push, 1)
+struct PersistedTilesHeader {
+    u32 magic = 0;
+    u32 nTiles = 0;
+    i64 fileSize = 0;
+    FILETIME modTime{};
+};
+struct PersistedTile {
+    int pageNo = 0;
+    int rotation = 0;
+    float zoom = 0.f;
+    u32 tileRes = 0;
+    u32 tileRow = 0;
+    u32 tileCol = 0;
+    int dx = 0;
+    int dy = 0;
+    u32 textColor = 0;
+    u32 bgColor = 0;
+    u32 keepsOriginalColors = 0;
+    u32 dataSize = 0;
+    u32 uncompressedSize = 0;
+};
+#pragma pack(pop)
+
+// all documents share one memory-mapped store (utils/CacheFile.h) in
+// the thumbnail cache directory; unused stashes age out of it on their
+// own via the store's generation GC
+static CacheFile* GetWorkingSetCache() {
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        TempStr dir = GetThumbnailCacheDirTemp();
+        if (dir) {
+            dir::Create(dir);
+            TempStr path = path::JoinTemp(dir, "tiles.cache");
+            gWorkingSetCache = OpenCacheFile(path, 128, 32 * 1024 * 1024);
+        }
+    }
+    return gWorkingSetCache;
+}
+
+// key is the MD5 of the (normalized) document path, same scheme as
+// GetThumbnailPathTemp()
+static bool WorkingSetKey(const char* filePath, u8 key[16]) {
+    if (!filePath) {
+        return false;
+    }
+    TempStr path = str::DupTemp(filePath);
+    if (path::HasVariableDriveLetter(path)) {
+        path[0] = '?';
+    }
+    CalcMD5Digest((u8*)path, str::Leni(path), key);
+    return true;
+}
+
+void RenderCache::PersistWorkingSet(DisplayModel* dm) {
+    if (!dm) {
+        return;
+    }
+    EngineBase* engine = dm->GetEngine();
+    const char* filePath = engine ? engine->FilePath() : nullptr;
+    u8 key[16];
+    if (!WorkingSetKey(filePath, key)) {
+        return;
+    }
+    ScopedCritSec scope(&cacheAccess);
+    // move the visible tiles into the compressed tier first so that
+    // there's a single source of serialized pixels
+    for (int i = 0; i < cacheCount; i++) {
+        BitmapCacheEntry* e = cache[i];
+        if (e->dm != dm || e->outOfDate || !dm->PageVisible(e->pageNo)) {
+            continue;
+        }
+        StashCompressed(e);
+    }
+    str::Str buf;
+    PersistedTilesHeader hdr;
+    hdr.magic = kWorkingSetMagic;
+    hdr.fileSize = file::GetSize(filePath);
+    hdr.modTime = file::GetModificationTime(filePath);
+    buf.Append((const char*)&hdr, sizeof(hdr));
+    u32 nTiles = 0;
+    // newest entries first, they were stashed for the current viewport
+    for (int i = compressedCount - 1; i >= 0 && nTiles < kMaxPersistedTiles; i--) {
+        CompressedCacheEntry* e = compressed[i];
+        if (e->dm != dm || !dm->PageVisible(e->pageNo)) {
+            continue;
+        }
+        PersistedTile t;
+        t.pageNo = e->pageNo;
+        t.rotation = e->rotation;
+        t.zoom = e->zoom;
+        t.tileRes = e->tile.res;
+        t.tileRow = e->tile.row;
+        t.tileCol = e->tile.col;
+        t.dx = e->size.dx;
+        t.dy = e->size.dy;
+        t.textColor = (u32)e->textColor;
+        t.bgColor = (u32)e->bgColor;
+        t.keepsOriginalColors = e->keepsOriginalColors ? 1 : 0;
+        t.dataSize = (u32)e->dataSize;
+        t.uncompressedSize = (u32)e->uncompressedSize;
+        buf.Append((const char*)&t, sizeof(t));
+        buf.Append((const char*)e->data, e->dataSize);
+        nTiles++;
+    }
+    if (0 == nTiles) {
+        // nothing worth resuming to; a previous stash ages out of the
+        // store on its own
+        return;
+    }
+    ((PersistedTilesHeader*)buf.Get())->nTiles = nTiles;
+    CacheFile* cf = GetWorkingSetCache();
+    if (!cf || !cf->Put(key, buf.AsByteSlice())) {
+        return;
+    }
+    logf("RenderCache::PersistWorkingSet: %d tiles, %d bytes for '%s'\n", (int)nTiles, (int)buf.size(), filePath);
+}
+
+void RenderCache::RestoreWorkingSet(DisplayModel* dm) {
+    if (!dm) {
+        return;
+    }
+    EngineBase* engine = dm->GetEngine();
+    const char* filePath = engine ? engine->FilePath() : nullptr;
+    u8 key[16];
+    if (!WorkingSetKey(filePath, key)) {
+        return;
+    }
+    CacheFile* cf = GetWorkingSetCache();
+    if (!cf) {
+        return;
+    }
+    // points into the store's mapping, don't free
+    ByteSlice d = cf->Get(key);
+    if (d.size() < sizeof(PersistedTilesHeader)) {
+        return;
+    }
+    PersistedTilesHeader hdr = *(PersistedTilesHeader*)d.data();
+    FILETIME modTime = file::GetModificationTime(filePath);
+    bool valid = hdr.magic == kWorkingSetMagic && hdr.fileSize == file::GetSize(filePath) &&
+                 FileTimeEq(hdr.modTime, modTime);
+    if (!valid) {
+        // the document has changed since the stash was written; the
+        // stale entry ages out of the store on its own
+        return;
+    }
+    const u8* p = d.data() + sizeof(hdr);
+    size_t left = d.size() - sizeof(hdr);
+    int nRestored = 0;
+    ScopedCritSec scope(&cacheAccess);
+    for (u32 i = 0; i < hdr.nTiles; i++) {
+        if (left < sizeof(PersistedTile)) {
+            break;
+        }
+        PersistedTile t = *(PersistedTile*)p;
+        p += sizeof(t);
+        left -= sizeof(t);
+        if (t.dataSize > left) {
+            break;
+        }
+        // cheap sanity checks against a corrupted stash
+        bool tileOk = t.pageNo >= 1 && t.pageNo <= dm->PageCount() && t.dx > 0 && t.dy > 0 &&
+                      t.uncompressedSize == (u32)t.dx * 4 * (u32)t.dy;
+        if (tileOk) {
+            if (compressedCount == MAX_BITMAPS_COMPRESSED) {
+                compressedBytes -= compressed[0]->dataSize;
+                delete compressed[0];
+                memmove(&compressed[0], &compressed[1], sizeof(compressed[0]) * (MAX_BITMAPS_COMPRESSED - 1));
+                compressedCount--;
+            }
+            auto e = new CompressedCacheEntry();
+            e->dm = dm;
+            e->pageNo = t.pageNo;
+            e->rotation = t.rotation;
+            e->zoom = t.zoom;
+            e->tile = TilePosition((USHORT)t.tileRes, (USHORT)t.tileRow, (USHORT)t.tileCol);
+            e->size = Size(t.dx, t.dy);
+            e->textColor = (COLORREF)t.textColor;
+            e->bgColor = (COLORREF)t.bgColor;
+            e->keepsOriginalColors = t.keepsOriginalColors != 0;
+            e->data = (u8*)memdup((void*)p, t.dataSize);
+            e->dataSize = t.dataSize;
+            e->uncompressedSize = t.uncompressedSize;
+            compressed[compressedCount++] = e;
+            compressedBytes += e->dataSize;
+            nRestored++;
+        }
+        p += t.dataSize;
+        left -= t.dataSize;
+    }
+    logf("RenderCache::RestoreWorkingSet: %d tiles for '%s'\n", nRestored, filePath);
+}
+
 void RenderCache::FreeForDisplayModel(DisplayModel* dm) {
     FreePage(dm);
+    FreeCompressed(dm);
+    FreePreviews(dm);
+    ScopedCritSec scope(&cacheAccess);
+    for (int i = pageCosts.Size() - 1; i >= 0; i--) {
+        if (pageCosts.at(i).dm == dm) {
+            pageCosts.RemoveAt(i);
+        }
+    }
 }
 
 void RenderCache::FreeNotVisible() {
@@ -285,13 +944,46 @@ void RenderCache::FreeNotVisible() {
 
 // keep the cached bitmaps for visible pages to avoid flickering during a reload.
 // mark invisible pages as out-of-date to prevent inconsistencies
+// when reloading into a different model, pages whose PDF content is
+// byte-identical keep their bitmaps as fully valid, so that e.g. a
+// LaTeX rebuild that touched one chapter doesn't re-render the rest of
+// the document. MainWindowRerender() passes oldDm == newDm because it
+// wants everything re-rendered (e.g. after a theme change)
 void RenderCache::KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm) {
     ScopedCritSec scope(&cacheAccess);
+    // compressed copies would outlive oldDm and have gone stale anyway
+    FreeCompressed(oldDm);
+    if (oldDm != newDm) {
+        // same for the scrubbing previews; the idle pass refills them
+        FreePreviews(oldDm);
+    }
+    EngineBase* oldEngine = oldDm->GetEngine();
+    EngineBase* newEngine = newDm->GetEngine();
+    bool checkUnchanged = oldDm != newDm && oldEngine && newEngine && oldEngine != newEngine;
+    // memoized per page since tiles of a page share one fingerprint
+    Vec<int> pagesChecked;
+    Vec<int> pagesUnchanged;
     for (int i = 0; i < cacheCount; i++) {
         BitmapCacheEntry* entry = cache[i];
         if (entry->dm != oldDm) {
             continue;
         }
+        if (checkUnchanged) {
+            int pageNo = entry->pageNo;
+            bool unchanged;
+            int idx = pagesChecked.Find(pageNo);
+            if (idx >= 0) {
+                unchanged = pagesUnchanged.at(idx) != 0;
+            } else {
+                unchanged = EnginePageContentUnchanged(oldEngine, newEngine, pageNo);
+                pagesChecked.Append(pageNo);
+                pagesUnchanged.Append(unchanged ? 1 : 0);
+            }
+            if (unchanged) {
+                entry->dm = newDm;
+                continue;
+            }
+        }
         if (oldDm->PageVisible(entry->pageNo)) {
             entry->dm = newDm;
         }
@@ -306,9 +998,7 @@ void RenderCache::Invalidate(DisplayModel* dm, int pageNo, RectF rect) {
     ScopedCritSec scopeReq(&requestAccess);
 
     ClearQueueForDisplayModel(dm, pageNo);
-    if (curReq && curReq->dm == dm && curReq->pageNo == pageNo) {
-        AbortCurrentRequest();
-    }
+    AbortCurrentRequests(dm, pageNo);
 
     ScopedCritSec scopeCache(&cacheAccess);
 
@@ -320,10 +1010,60 @@ void RenderCache::Invalidate(DisplayModel* dm, int pageNo, RectF rect) {
             e->outOfDate = true;
         }
     }
+    FreeCompressed(dm, pageNo);
+}
+
+// per-tile render time the adaptive tiling aims for: tiles much slower
+// than this are split further, much faster ones merged
+constexpr float kTargetTileRenderMs = 250.f;
+
+// the page cost table stays small; old documents' entries get evicted
+constexpr int kMaxPageCostEntries = 256;
+
+void RenderCache::RecordRenderTime(const PageRenderRequest& req, double durMs) {
+    if (req.tile.res > 10) {
+        return;
+    }
+    // a tile at res r covers 1/4^r of the page, scale its time up to a
+    // full-page render so that measurements at different res compare
+    float fullPageMs = (float)durMs * (float)(1 << (2 * req.tile.res));
+    ScopedCritSec scope(&cacheAccess);
+    for (PageRenderCost& c : pageCosts) {
+        if (c.dm == req.dm && c.pageNo == req.pageNo) {
+            // weigh the latest measurement heavily so that the tiling
+            // converges within a few renders
+            c.fullPageMs = 0.5f * c.fullPageMs + 0.5f * fullPageMs;
+            return;
+        }
+    }
+    if (pageCosts.Size() >= kMaxPageCostEntries) {
+        pageCosts.RemoveAt(0);
+    }
+    PageRenderCost c{req.dm, req.pageNo, fullPageMs};
+    pageCosts.Append(c);
+}
+
+float RenderCache::GetFullPageCostMs(DisplayModel* dm, int pageNo) {
+    ScopedCritSec scope(&cacheAccess);
+    float sum = 0;
+    int n = 0;
+    for (PageRenderCost& c : pageCosts) {
+        if (c.dm != dm) {
+            continue;
+        }
+        if (c.pageNo == pageNo) {
+            return c.fullPageMs;
+        }
+        sum += c.fullPageMs;
+        n++;
+    }
+    // a page never rendered before gets the document-wide average, so
+    // its neighbors' measurements apply when scrolling into it
+    return n > 0 ? sum / (float)n : 0;
 }
 
 // determine the count of tiles required for a page at a given zoom level
-USHORT RenderCache::GetTileRes(DisplayModel* dm, int pageNo) const {
+USHORT RenderCache::GetTileRes(DisplayModel* dm, int pageNo) {
     auto engine = dm->GetEngine();
     RectF mediabox = engine->PageMediabox(pageNo);
     float zoom = dm->GetZoomReal(pageNo);
@@ -352,7 +1092,25 @@ USHORT RenderCache::GetTileRes(DisplayModel* dm, int pageNo) const {
         res = (USHORT)ceilf(log(factorAvg) / log(2.0f));
     }
     // limit res to 30, so that (1 << res) doesn't overflow for 32-bit signed int
-    return std::min(res, (USHORT)30);
+    res = std::min(res, (USHORT)30);
+
+    // adapt the geometric choice with the measured render cost of this
+    // page (or its document's average)
+    float fullPageMs = GetFullPageCostMs(dm, pageNo);
+    if (fullPageMs > 0 && res < 15) {
+        float tileMs = fullPageMs / (float)(1 << (2 * res));
+        if (tileMs > 2 * kTargetTileRenderMs) {
+            // complex page: split finer for earlier first pixels and
+            // cheaper cancellation
+            res++;
+        } else if (res > 0 && tileMs < kTargetTileRenderMs / 4) {
+            // simple page: a merged tile still renders quickly and has
+            // less per-tile overhead. The asymmetric thresholds keep
+            // the choice from oscillating between two levels
+            res--;
+        }
+    }
+    return res;
 }
 
 // get the maximum resolution available for the given page
@@ -391,12 +1149,12 @@ bool RenderCache::ReduceTileSize() {
     while (requestCount > 0) {
         ClearQueueForDisplayModel(requests[0].dm);
     }
-    AbortCurrentRequest();
+    AbortCurrentRequests();
 
     return true;
 }
 
-void RenderCache::RequestRendering(DisplayModel* dm, int pageNo) {
+void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, RenderPriority priority) {
     TilePosition tile(GetTileRes(dm, pageNo), 0, 0);
     // only honor the request if there's a good chance that the
     // rendered tile will actually be used
@@ -404,17 +1162,45 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo) {
         return;
     }
 
-    RequestRendering(dm, pageNo, tile);
+    RequestRendering(dm, pageNo, tile, priority);
     // render both tiles of the first row when splitting a page in four
     // (which always happens on larger displays for Fit Width)
     if (tile.res == 1 && !IsRenderQueueFull()) {
         tile.col = 1;
-        RequestRendering(dm, pageNo, tile, false);
+        RequestRendering(dm, pageNo, tile, priority, false);
+    }
+}
+
+// invalidate queued prerendering work after a viewport change. Visible-priority
+// requests are kept: the worker thread re-checks their visibility anyway
+void RenderCache::BumpRenderGeneration() {
+    ScopedCritSec scope(&requestAccess);
+    renderGeneration++;
+    int curPos = 0;
+    int reqCount = requestCount;
+    for (int i = 0; i < reqCount; i++) {
+        PageRenderRequest* req = &(requests[i]);
+        // thumbnail-strip requests aren't tied to the viewport, they
+        // only go away when the queue overflows or the document closes
+        bool keep = req->priority == RenderPriority::Visible || req->priority == RenderPriority::Thumbnail;
+        bool isStale = req->generation != renderGeneration && !keep;
+        if (i != curPos) {
+            requests[curPos] = requests[i];
+        }
+        if (isStale) {
+            if (req->renderCb) {
+                req->renderCb->Call(nullptr);
+            }
+            requestCount--;
+        } else {
+            curPos++;
+        }
     }
 }
 
 /* Render a bitmap for page <pageNo> in <dm>. */
-void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage) {
+void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, RenderPriority priority,
+                                   bool clearQueueForPage) {
     logf("RenderCache::RequestRendering(): pageNo %d\n", pageNo);
     ScopedCritSec scope(&requestAccess);
     ReportIf(!dm);
@@ -425,14 +1211,20 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
     int rotation = NormalizeRotation(dm->GetRotation());
     float zoom = dm->GetZoomReal(pageNo);
 
-    if (curReq && (curReq->pageNo == pageNo) && (curReq->dm == dm) && (curReq->tile == tile)) {
-        if ((curReq->zoom == zoom) && (curReq->rotation == rotation)) {
-            /* we're already rendering exactly the same page */
-            return;
+    for (int i = 0; i < renderThreadCount; i++) {
+        PageRenderRequest* curReq = curReqs[i];
+        if (curReq && (curReq->pageNo == pageNo) && (curReq->dm == dm) && (curReq->tile == tile)) {
+            if ((curReq->zoom == zoom) && (curReq->rotation == rotation)) {
+                /* we're already rendering exactly the same page */
+                return;
+            }
+            /* Currently rendered page is for the same page but with different zoom
+            or rotation, so abort it */
+            if (curReq->abortCookie) {
+                curReq->abortCookie->Abort();
+            }
+            curReq->abort = true;
         }
-        /* Currently rendered page is for the same page but with different zoom
-        or rotation, so abort it */
-        AbortCurrentRequest();
     }
 
     // clear requests for tiles of different resolution and invisible tiles
@@ -451,12 +1243,18 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
                 tmp = requests[requestCount - 1];
                 requests[requestCount - 1] = *req;
                 *req = tmp;
+                req = &(requests[requestCount - 1]);
             } else {
                 /* There was a request queued for the same page but with different
                    zoom or rotation, so only replace this request */
                 req->zoom = zoom;
                 req->rotation = rotation;
             }
+            /* re-requesting un-stales the request and can only raise its urgency */
+            req->generation = renderGeneration;
+            if (priority < req->priority) {
+                req->priority = priority;
+            }
             return;
         }
     }
@@ -467,7 +1265,7 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
         return;
     }
 
-    Render(dm, pageNo, rotation, zoom, &tile);
+    Render(dm, pageNo, rotation, zoom, &tile, nullptr, nullptr, priority);
 }
 
 void RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom, RectF pageRect,
@@ -479,7 +1277,7 @@ void RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
 }
 
 bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile, RectF* pageRect,
-                         const OnBitmapRendered* renderCb) {
+                         const OnBitmapRendered* renderCb, RenderPriority priority) {
     logf("RenderCache::Render(): pageNo %d\n", pageNo);
     ReportIf(!dm);
     if (!dm || dm->dontRenderFlag) {
@@ -522,6 +1320,8 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
     } else {
         CrashMe();
     }
+    newRequest->priority = priority;
+    newRequest->generation = renderGeneration;
     newRequest->abort = false;
     newRequest->abortCookie = nullptr;
     newRequest->timestamp = GetTickCount();
@@ -535,8 +1335,11 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
 int RenderCache::GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile) {
     ScopedCritSec scope(&requestAccess);
 
-    if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
-        return GetTickCount() - curReq->timestamp;
+    for (int i = 0; i < renderThreadCount; i++) {
+        PageRenderRequest* curReq = curReqs[i];
+        if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
+            return GetTickCount() - curReq->timestamp;
+        }
     }
 
     for (int i = 0; i < requestCount; i++) {
@@ -548,33 +1351,67 @@ int RenderCache::GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile)
     return RENDER_DELAY_UNDEFINED;
 }
 
-bool RenderCache::GetNextRequest(PageRenderRequest* req) {
+// returns the most urgent request whose engine isn't already busy on
+// another worker: visible tiles beat adjacent prerendering beats
+// speculative prerendering, most recently queued first within a class.
+// Engines that declare allowsParallelRender may be picked up by
+// several workers at once; the others serialize access internally, so
+// letting two workers render pages of the same document would just
+// make them contend on the engine's lock instead of rendering other
+// documents.
+bool RenderCache::GetNextRequest(int threadNo, PageRenderRequest* req) {
     ScopedCritSec scope(&requestAccess);
 
-    if (requestCount == 0) {
-        return false;
-    }
-
     ReportIf(requestCount < 0);
     ReportIf(requestCount > MAX_PAGE_REQUESTS);
-    requestCount--;
-    *req = requests[requestCount];
-    curReq = req;
-    ReportIf(requestCount < 0);
-    ReportIf(req->abort);
-
-    return true;
+    int best = -1;
+    for (int i = requestCount - 1; i >= 0; i--) {
+        DisplayModel* dm = requests[i].dm;
+        bool engineBusy = false;
+        if (!dm->GetEngine()->allowsParallelRender) {
+            for (int j = 0; j < renderThreadCount; j++) {
+                if (j != threadNo && curReqs[j] && curReqs[j]->dm == dm) {
+                    engineBusy = true;
+                    break;
+                }
+            }
+        }
+        if (engineBusy) {
+            continue;
+        }
+        if (best < 0 || requests[i].priority < requests[best].priority) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        *req = requests[best];
+        for (int j = best; j < requestCount - 1; j++) {
+            requests[j] = requests[j + 1];
+        }
+        requestCount--;
+        curReqs[threadNo] = req;
+        ReportIf(req->abort);
+        return true;
+    }
+    // nothing this worker can pick up right now: either the queue is
+    // empty or all queued requests are for engines busy on other workers
+    ResetEvent(startRendering);
+    return false;
 }
 
-bool RenderCache::ClearCurrentRequest() {
+void RenderCache::ClearCurrentRequest(int threadNo) {
     ScopedCritSec scope(&requestAccess);
+    PageRenderRequest* curReq = curReqs[threadNo];
     if (curReq) {
         delete curReq->abortCookie;
     }
-    curReq = nullptr;
+    curReqs[threadNo] = nullptr;
 
-    bool isQueueEmpty = requestCount == 0;
-    return isQueueEmpty;
+    if (curReq && requestCount > 0) {
+        // this worker's engine became free, queued requests for it
+        // might now be eligible on other workers
+        SetEvent(startRendering);
+    }
 }
 
 /* Wait until rendering of a page beloging to <dm> has finished. */
@@ -585,14 +1422,13 @@ void RenderCache::CancelRendering(DisplayModel* dm) {
 
     for (;;) {
         EnterCriticalSection(&requestAccess);
-        if (!curReq || (curReq->dm != dm)) {
+        bool isRendering = AbortCurrentRequests(dm);
+        if (!isRendering) {
             // to be on the safe side
             ClearQueueForDisplayModel(dm);
             LeaveCriticalSection(&requestAccess);
             return;
         }
-
-        AbortCurrentRequest();
         LeaveCriticalSection(&requestAccess);
 
         /* TODO: busy loop is not good, but I don't have a better idea */
@@ -622,37 +1458,394 @@ void RenderCache::ClearQueueForDisplayModel(DisplayModel* dm, int pageNo, TilePo
     }
 }
 
-void RenderCache::AbortCurrentRequest() {
+bool RenderCache::AbortCurrentRequests(DisplayModel* dm, int pageNo) {
     ScopedCritSec scope(&requestAccess);
-    if (!curReq) {
+    bool didAbort = false;
+    for (int i = 0; i < renderThreadCount; i++) {
+        PageRenderRequest* curReq = curReqs[i];
+        if (!curReq) {
+            continue;
+        }
+        if (dm && curReq->dm != dm) {
+            continue;
+        }
+        if (pageNo != kInvalidPageNo && curReq->pageNo != pageNo) {
+            continue;
+        }
+        if (curReq->abortCookie) {
+            curReq->abortCookie->Abort();
+        }
+        curReq->abort = true;
+        didAbort = true;
+    }
+    return didAbort;
+}
+
+#include <icm.h>
+#pragma comment(lib, "mscms.lib")
+
+// lazily built sRGB -> monitor profile transform, shared by the render
+// threads. the profiles stay open for the lifetime of the transform
+static HTRANSFORM CreateMonitorColorTransform() {
+    // profile of the primary monitor; proofing setups calibrate it
+    WCHAR monitorProfilePath[MAX_PATH]{};
+    DWORD cch = dimof(monitorProfilePath);
+    HDC hdc = GetDC(nullptr);
+    BOOL ok = GetICMProfileW(hdc, &cch, monitorProfilePath);
+    ReleaseDC(nullptr, hdc);
+    if (!ok) {
+        return nullptr;
+    }
+    // engines render in (effectively) sRGB
+    WCHAR srgbProfilePath[MAX_PATH]{};
+    DWORD cb = sizeof(srgbProfilePath);
+    ok = GetStandardColorSpaceProfileW(nullptr, LCS_sRGB, srgbProfilePath, &cb);
+    if (!ok) {
+        return nullptr;
+    }
+    if (str::EqI(monitorProfilePath, srgbProfilePath)) {
+        // the monitor is assumed to be sRGB, converting would be a no-op
+        return nullptr;
+    }
+    PROFILE spec{};
+    spec.dwType = PROFILE_FILENAME;
+    spec.pProfileData = srgbProfilePath;
+    spec.cbDataSize = (str::Len(srgbProfilePath) + 1) * sizeof(WCHAR);
+    HPROFILE profiles[2];
+    profiles[0] = OpenColorProfileW(&spec, PROFILE_READ, FILE_SHARE_READ, OPEN_EXISTING);
+    spec.pProfileData = monitorProfilePath;
+    spec.cbDataSize = (str::Len(monitorProfilePath) + 1) * sizeof(WCHAR);
+    profiles[1] = OpenColorProfileW(&spec, PROFILE_READ, FILE_SHARE_READ, OPEN_EXISTING);
+    if (!profiles[0] || !profiles[1]) {
+        if (profiles[0]) {
+            CloseColorProfile(profiles[0]);
+        }
+        if (profiles[1]) {
+            CloseColorProfile(profiles[1]);
+        }
+        return nullptr;
+    }
+    DWORD intents[1] = {INTENT_PERCEPTUAL};
+    return CreateMultiProfileTransform(profiles, 2, intents, 1, BEST_MODE, INDEX_DONT_CARE);
+}
+
+// converts a rendered bitmap to the monitor's color profile, in place.
+// engines render into 32bpp dib sections (CreateMemoryBitmap); anything
+// else is left alone
+static void TransformBitmapToMonitorColors(HBITMAP hbmp) {
+    if (!gColorManagedRendering) {
+        return;
+    }
+    static HTRANSFORM transform = CreateMonitorColorTransform();
+    if (!transform || !hbmp) {
+        return;
+    }
+    DIBSECTION ds{};
+    if (GetObject(hbmp, sizeof(ds), &ds) != sizeof(ds) || !ds.dsBm.bmBits) {
+        return;
+    }
+    if (ds.dsBm.bmBitsPixel != 32) {
         return;
     }
-    if (curReq->abortCookie) {
-        curReq->abortCookie->Abort();
+    DWORD dy = (DWORD)std::abs(ds.dsBm.bmHeight);
+    TranslateBitmapBits(transform, ds.dsBm.bmBits, BM_xRGBQUADS, (DWORD)ds.dsBm.bmWidth, dy,
+                        (DWORD)ds.dsBm.bmWidthBytes, ds.dsBm.bmBits, BM_xRGBQUADS, (DWORD)ds.dsBm.bmWidthBytes,
+                        nullptr, 0);
+}
+
+// remaps all cached bitmaps to the new document colors in place, so
+// that toggling between light and dark document colors only repaints
+// instead of re-rendering every page. returns false if some bitmap
+// couldn't be remapped; the caller falls back to re-rendering
+bool RenderCache::RemapCachedColors(COLORREF text, COLORREF bg) {
+    if (gColorManagedRendering) {
+        // the pixels were additionally pushed through the monitor
+        // profile, the color mapping alone can't be inverted anymore
+        return false;
+    }
+    ScopedCritSec scope(&cacheAccess);
+    bool allOk = true;
+    for (int i = 0; i < cacheCount; i++) {
+        BitmapCacheEntry* e = cache[i];
+        if (e->keepsOriginalColors || (e->textColor == text && e->bgColor == bg)) {
+            continue;
+        }
+        HBITMAP hbmp = e->bitmap ? e->bitmap->GetBitmap() : nullptr;
+        if (!hbmp || !RemapBitmapColors(hbmp, e->textColor, e->bgColor, text, bg)) {
+            allOk = false;
+            continue;
+        }
+        e->textColor = text;
+        e->bgColor = bg;
     }
-    curReq->abort = true;
+    return allOk;
+}
+
+// renders the part of <rect> (in page coordinates) covered by the
+// entry's tile and blits the pixels over the cached bitmap
+static bool PatchCacheEntryRect(BitmapCacheEntry* e, EngineBase* engine, RectF rect) {
+    HBITMAP hbmpTile = e->bitmap ? e->bitmap->GetBitmap() : nullptr;
+    if (!hbmpTile) {
+        return false;
+    }
+
+    Rect tileDevice = GetTileRectDevice(engine, e->pageNo, e->rotation, e->zoom, e->tile);
+    Rect clipDevice = engine->Transform(rect, e->pageNo, e->zoom, e->rotation).Round();
+    // a couple of extra pixels for anti-aliasing bleed at the edges
+    clipDevice.Inflate(2, 2);
+    clipDevice = clipDevice.Intersect(tileDevice);
+    if (clipDevice.IsEmpty()) {
+        // the tile isn't affected after all
+        return true;
+    }
+
+    // render exactly the patch's pixels (same rounding as GetTileRectUser)
+    RectF clipUser = engine->Transform(ToRectF(clipDevice), e->pageNo, e->zoom, e->rotation, true);
+    RenderPageArgs args(e->pageNo, e->zoom, e->rotation, &clipUser);
+    RenderedBitmap* bmp = engine->RenderPage(args);
+    if (!bmp || !bmp->IsValid()) {
+        delete bmp;
+        return false;
+    }
+    // match the color mapping the cached pixels went through
+    if (!e->keepsOriginalColors) {
+        UpdateBitmapColors(bmp->GetBitmap(), e->textColor, e->bgColor);
+    }
+    TransformBitmapToMonitorColors(bmp->GetBitmap());
+
+    Size patchSize = bmp->GetSize();
+    int x = clipDevice.x - tileDevice.x;
+    int y = clipDevice.y - tileDevice.y;
+    HDC hdcSrc = CreateCompatibleDC(nullptr);
+    HDC hdcDst = CreateCompatibleDC(nullptr);
+    bool ok = hdcSrc && hdcDst;
+    if (ok) {
+        HGDIOBJ prevSrc = SelectObject(hdcSrc, bmp->GetBitmap());
+        HGDIOBJ prevDst = SelectObject(hdcDst, hbmpTile);
+        ok = BitBlt(hdcDst, x, y, patchSize.dx, patchSize.dy, hdcSrc, 0, 0, SRCCOPY);
+        SelectObject(hdcSrc, prevSrc);
+        SelectObject(hdcDst, prevDst);
+    }
+    if (hdcSrc) {
+        DeleteDC(hdcSrc);
+    }
+    if (hdcDst) {
+        DeleteDC(hdcDst);
+    }
+    delete bmp;
+    if (ok) {
+        // the pixels no longer match the page-content hash that bitmap
+        // sharing between tabs is keyed by
+        e->contentFingerprint = 0;
+    }
+    return ok;
+}
+
+bool RenderCache::RerenderRect(DisplayModel* dm, int pageNo, RectF rect) {
+    EngineBase* engine = dm->GetEngine();
+    RectF mediabox = engine->PageMediabox(pageNo);
+    rect = rect.Intersect(mediabox);
+    if (rect.IsEmpty()) {
+        return true;
+    }
+    // a change covering most of the page re-renders faster as a whole
+    if (rect.dx * rect.dy > 0.5 * mediabox.dx * mediabox.dy) {
+        return false;
+    }
+
+    {
+        // in-flight renders of the page would Add() bitmaps with pixels
+        // from before the change, same as in Invalidate()
+        ScopedCritSec scopeReq(&requestAccess);
+        ClearQueueForDisplayModel(dm, pageNo);
+        AbortCurrentRequests(dm, pageNo);
+    }
+
+    // collect the affected entries under the lock, render outside of it
+    // so that the cache stays usable while the engine works
+    Vec<BitmapCacheEntry*> affected;
+    {
+        ScopedCritSec scope(&cacheAccess);
+        for (int i = 0; i < cacheCount; i++) {
+            BitmapCacheEntry* e = cache[i];
+            if (e->dm != dm || e->pageNo != pageNo || e->outOfDate || e->zoom <= 0) {
+                continue;
+            }
+            if (GetTileRect(mediabox, e->tile).Intersect(rect).IsEmpty()) {
+                // the tile doesn't cover the changed rect, stays valid
+                continue;
+            }
+            e->refs++;
+            affected.Append(e);
+        }
+    }
+    // the compressed tier can't be patched in place
+    FreeCompressed(dm, pageNo);
+
+    auto timeStart = TimeGet();
+    bool allOk = true;
+    for (BitmapCacheEntry* e : affected) {
+        if (!PatchCacheEntryRect(e, engine, rect)) {
+            allOk = false;
+        }
+        DropCacheEntry(e);
+    }
+    logf("RenderCache::RerenderRect: pageNo %d, %d tiles in %.2f ms\n", pageNo, affected.Size(),
+         (float)TimeSinceInMs(timeStart));
+    return allOk;
+}
+
+/* Shared tile cache for kiosk/signage deployments: thin clients showing
+the same documents can fetch rendered tiles from a LAN cache server
+(gGlobalPrefs->tileCacheServerURL) before rasterizing locally and upload
+the tiles they had to render themselves, so that across the deployment
+each tile is rasterized only once. Tiles are keyed by the page's content
+fingerprint (stable across machines, unlike file paths), zoom, rotation
+and tile position and transferred as .bmp files in their original
+document colors (theme colors are applied locally, after the fetch).
+After a few failed requests the server is considered down and skipped
+for the rest of the session. */
+
+#define MAX_TILE_SERVER_ERRORS 5
+static AtomicInt gTileServerErrors;
+
+static bool TileCacheServerUsable() {
+    return !str::IsEmpty(gGlobalPrefs->tileCacheServerURL) && gTileServerErrors.Get() < MAX_TILE_SERVER_ERRORS;
+}
+
+// the tile's path on the server; nullptr when the page has no stable
+// content fingerprint (then the tile can't be shared across machines)
+static TempStr TileCachePathTemp(PageRenderRequest& req) {
+    u32 fp = EnginePageContentFingerprint(req.dm->GetEngine(), req.pageNo);
+    if (0 == fp) {
+        return nullptr;
+    }
+    // zoom is transferred with 0.01% granularity to avoid float
+    // formatting differences between clients
+    int zoom = (int)(req.zoom * 10000.f);
+    return str::FormatTemp("/tile/%08x/%d/%d/%u-%u-%u", fp, zoom, req.rotation, (uint)req.tile.res, (uint)req.tile.row,
+                           (uint)req.tile.col);
+}
+
+static RenderedBitmap* FetchTileFromCacheServer(PageRenderRequest& req) {
+    if (!TileCacheServerUsable()) {
+        return nullptr;
+    }
+    TempStr path = TileCachePathTemp(req);
+    if (!path) {
+        return nullptr;
+    }
+    TempStr url = str::JoinTemp(gGlobalPrefs->tileCacheServerURL, path);
+    HttpRsp rsp;
+    if (!HttpGet(url, &rsp)) {
+        gTileServerErrors.Inc();
+        return nullptr;
+    }
+    if (rsp.httpStatusCode != 200 || rsp.data.size() == 0) {
+        // a miss on the server, not an error
+        return nullptr;
+    }
+    gTileServerErrors.Set(0);
+    ByteSlice bmpData{(u8*)rsp.data.Get(), rsp.data.size()};
+    Gdiplus::Bitmap* gbmp = BitmapFromDataWin(bmpData);
+    if (!gbmp) {
+        return nullptr;
+    }
+    RenderedBitmap* res = nullptr;
+    HBITMAP hbmp;
+    if (gbmp->GetHBITMAP((Gdiplus::ARGB)Gdiplus::Color::White, &hbmp) == Gdiplus::Ok) {
+        res = new RenderedBitmap(hbmp, Size(gbmp->GetWidth(), gbmp->GetHeight()));
+    }
+    delete gbmp;
+    return res;
+}
+
+// splits http://host[:port][/...] into host and port for HttpPost()
+static bool ParseTileCacheServerURL(const char* url, TempStr* hostOut, int* portOut) {
+    const char* s = url;
+    if (str::StartsWithI(s, "http://")) {
+        s += 7;
+    }
+    const char* slash = str::FindChar(s, '/');
+    TempStr host = slash ? str::DupTemp(s, slash - s) : str::DupTemp(s);
+    int port = 80;
+    char* colon = str::FindChar(host, ':');
+    if (colon) {
+        *colon = 0;
+        port = atoi(colon + 1);
+    }
+    if (str::IsEmpty(host) || port <= 0) {
+        return false;
+    }
+    *hostOut = host;
+    *portOut = port;
+    return true;
+}
+
+// frees bmpData
+static void UploadTileToCacheServer(PageRenderRequest& req, ByteSlice bmpData) {
+    TempStr host = nullptr;
+    int port = 0;
+    if (TileCacheServerUsable() && ParseTileCacheServerURL(gGlobalPrefs->tileCacheServerURL, &host, &port)) {
+        // the fingerprint was computed (and cached) by the failed fetch,
+        // so building the path again is cheap
+        TempStr path = TileCachePathTemp(req);
+        if (path) {
+            str::Str body;
+            body.Append((const char*)bmpData.data(), bmpData.size());
+            if (!HttpPost(host, port, path, nullptr, &body)) {
+                gTileServerErrors.Inc();
+            }
+        }
+    }
+    bmpData.Free();
 }
 
 DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
-    RenderCache* cache = (RenderCache*)data;
+    RenderThreadData* td = (RenderThreadData*)data;
+    RenderCache* cache = td->cache;
+    int threadNo = td->threadNo;
+    delete td;
     PageRenderRequest req;
     RenderedBitmap* bmp;
+    ThreadQoS currQoS = ThreadQoS::Default;
 
     for (;;) {
-        if (cache->ClearCurrentRequest()) {
-            DWORD waitResult = WaitForSingleObject(cache->startRendering, INFINITE);
-            // Is it not a page render request?
-            if (WAIT_OBJECT_0 != waitResult) {
-                continue;
-            }
+        cache->ClearCurrentRequest(threadNo);
+        if (!cache->GetNextRequest(threadNo, &req)) {
+            WaitForSingleObject(cache->startRendering, INFINITE);
+            continue;
         }
 
-        if (!cache->GetNextRequest(&req)) {
-            continue;
+        // prerendering must not compete with the visible page's render
+        // or the UI thread for CPU, I/O or memory
+        ThreadQoS qos = ThreadQoS::Default;
+        if (req.priority == RenderPriority::Prerender) {
+            qos = ThreadQoS::Utility;
+        } else if (req.priority == RenderPriority::Speculative || req.priority == RenderPriority::Thumbnail) {
+            qos = ThreadQoS::Background;
+        }
+        if (qos != currQoS) {
+            SetCurrentThreadQoS(qos);
+            currQoS = qos;
         }
 
-        if (!req.dm->PageVisibleNearby(req.pageNo) && !req.renderCb) {
-            continue;
+        // speculative requests for likely navigation targets (queued by
+        // OnMessageLoopIdle) point far away from the viewport on purpose;
+        // BumpRenderGeneration() already dropped the ones made stale by
+        // scrolling
+        bool farFromViewPortOk = req.priority == RenderPriority::Speculative;
+        if (!req.renderCb && !farFromViewPortOk) {
+            // read visibility off the published geometry snapshot
+            // instead of pagesInfo, which the UI thread mutates freely
+            PageGeometrySnapshot* geom = req.dm->AcquirePageGeometry();
+            bool visibleNearby = geom ? geom->PageVisibleNearby(req.pageNo) : req.dm->PageVisibleNearby(req.pageNo);
+            if (geom) {
+                geom->Release();
+            }
+            if (!visibleNearby) {
+                continue;
+            }
         }
 
         if (req.dm->dontRenderFlag) {
@@ -671,9 +1864,17 @@ DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
 
         ReportIf(req.abortCookie != nullptr);
         EngineBase* engine = req.dm->GetEngine();
-        RenderPageArgs args(req.pageNo, req.zoom, req.rotation, &req.pageRect, RenderTarget::View, &req.abortCookie);
         auto timeStart = TimeGet();
-        bmp = engine->RenderPage(args);
+        bool fromCacheServer = false;
+        if (!req.renderCb) {
+            bmp = FetchTileFromCacheServer(req);
+            fromCacheServer = bmp != nullptr;
+        }
+        if (!bmp) {
+            RenderPageArgs args(req.pageNo, req.zoom, req.rotation, &req.pageRect, RenderTarget::View, &req.abortCookie);
+            bmp = engine->RenderPage(args);
+        }
+        PerfTraceRecordEvent("RenderCache::Render", timeStart);
         if (req.abort) {
             delete bmp;
             if (req.renderCb) {
@@ -682,10 +1883,21 @@ DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
             continue;
         }
         auto durMs = TimeSinceInMs(timeStart);
-        if (durMs > 100) {
+        if (durMs > 100 && !fromCacheServer) {
             auto path = engine->FilePath();
             logfa("Slow rendering: %.2f ms, page: %d in '%s'\n", (float)durMs, req.pageNo, path);
         }
+        if (bmp && !req.renderCb && !fromCacheServer) {
+            // callback renders (thumbnails etc.) use arbitrary page
+            // rects, only successful tile renders are meaningful feedback
+            cache->RecordRenderTime(req, durMs);
+        }
+        ByteSlice tileUpload;
+        if (bmp && !req.renderCb && !fromCacheServer && TileCacheServerUsable()) {
+            // serialize before theme colors are applied below, other
+            // clients need the original document colors
+            tileUpload = SerializeBitmap(bmp->GetBitmap());
+        }
 
         if (req.renderCb) {
             // the callback must free the RenderedBitmap
@@ -693,12 +1905,24 @@ DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
             // req.renderCb = (RenderingCallback*)1; // will crash if accessed again, which should not happen
         } else {
             // don't replace colors for individual images
-            if (bmp && !engine->IsImageCollection()) {
-                UpdateBitmapColors(bmp->GetBitmap(), cache->textColor, cache->backgroundColor);
+            bool keepsOriginalColors = !bmp || engine->IsImageCollection();
+            COLORREF textCol = cache->textColor;
+            COLORREF bgCol = cache->backgroundColor;
+            if (!keepsOriginalColors) {
+                UpdateBitmapColors(bmp->GetBitmap(), textCol, bgCol);
             }
-            cache->Add(req, bmp);
+            if (bmp) {
+                // no-op unless gColorManagedRendering is set
+                TransformBitmapToMonitorColors(bmp->GetBitmap());
+            }
+            cache->Add(req, bmp, textCol, bgCol, keepsOriginalColors);
             req.dm->RepaintDisplay();
         }
+        if (tileUpload.data()) {
+            // only after Add(), so painting the tile isn't delayed by
+            // the upload
+            UploadTileToCacheServer(req, tileUpload);
+        }
         ResetTempAllocator();
     }
     DestroyTempAllocator();
@@ -712,6 +1936,12 @@ int RenderCache::PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, T
     BitmapCacheEntry* entry = Find(dm, pageNo, dm->GetRotation(), zoom, &tile);
     int renderDelay = 0;
 
+    if (entry) {
+        paintHits++;
+    } else {
+        paintMisses++;
+    }
+
     if (!entry) {
         if (!isRemoteSession) {
             if (renderedReplacement) {
@@ -724,6 +1954,76 @@ int RenderCache::PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, T
             RequestRendering(dm, pageNo, tile);
         }
     }
+    if (!entry && tile.res > 0 && !isRemoteSession) {
+        /* Treat cached tiles as a mip pyramid: while the exact tile is
+           rendering, sample the nearest cached lower-resolution level
+           (whole page at res 0, quadrants at res 1, ...) and stretch the
+           part covering this tile. Gets progressively replaced by the
+           real tile on subsequent paints, so zooming into a page never
+           flashes blank as long as any coarser level is cached. */
+        TilePosition ancestor = tile;
+        while (ancestor.res > 0 && !entry) {
+            ancestor.res--;
+            ancestor.row /= 2;
+            ancestor.col /= 2;
+            entry = Find(dm, pageNo, dm->GetRotation(), kInvalidZoom, &ancestor);
+        }
+        HBITMAP ancestorBmp = entry && entry->bitmap ? entry->bitmap->GetBitmap() : nullptr;
+        PageInfo* pageInfo = dm->GetPageInfo(pageNo);
+        if (ancestorBmp && pageInfo) {
+            Rect ancestorOnScreen =
+                GetTileOnScreen(dm->GetEngine(), pageNo, dm->GetRotation(), zoom, ancestor, pageInfo->pageOnScreen);
+            HDC bmpDC = nullptr;
+            if (!ancestorOnScreen.IsEmpty()) {
+                bmpDC = CreateCompatibleDC(hdc);
+            }
+            if (bmpDC) {
+                Size bmpSize = entry->bitmap->GetSize();
+                int xSrc = (bounds.x - ancestorOnScreen.x) * bmpSize.dx / ancestorOnScreen.dx;
+                int ySrc = (bounds.y - ancestorOnScreen.y) * bmpSize.dy / ancestorOnScreen.dy;
+                int dxSrc = bounds.dx * bmpSize.dx / ancestorOnScreen.dx;
+                int dySrc = bounds.dy * bmpSize.dy / ancestorOnScreen.dy;
+                HGDIOBJ prevBmp = SelectObject(bmpDC, ancestorBmp);
+                StretchBlt(hdc, bounds.x, bounds.y, bounds.dx, bounds.dy, bmpDC, xSrc, ySrc, dxSrc, dySrc, SRCCOPY);
+                SelectObject(bmpDC, prevBmp);
+                DeleteDC(bmpDC);
+
+                if (renderedReplacement) {
+                    *renderedReplacement = true;
+                }
+                if (entry->outOfDate && renderOutOfDateCue) {
+                    *renderOutOfDateCue = true;
+                }
+                DropCacheEntry(entry);
+                // the exact tile was requested above; report it as still pending
+                if (0 == renderDelay) {
+                    renderDelay = 1;
+                }
+                return renderDelay;
+            }
+        }
+        if (entry) {
+            DropCacheEntry(entry);
+            entry = nullptr;
+        }
+    }
+    if (!entry && !isRemoteSession) {
+        /* Below any cached resolution sits the tiny preview tier:
+           stretch the scrubbing preview over the tile so that pages the
+           user never visited show their layout instead of blank while
+           the real render is pending. */
+        PageInfo* pageInfo = dm->GetPageInfo(pageNo);
+        if (pageInfo && PaintPreview(hdc, bounds, dm, pageNo, pageInfo->pageOnScreen)) {
+            if (renderedReplacement) {
+                *renderedReplacement = true;
+            }
+            if (0 == renderDelay) {
+                renderDelay = 1;
+            }
+            return renderDelay;
+        }
+    }
+
     RenderedBitmap* renderedBmp = entry ? entry->bitmap : nullptr;
     HBITMAP hbmp = renderedBmp ? renderedBmp->GetBitmap() : nullptr;
 
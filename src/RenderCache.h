@@ -9,12 +9,23 @@ constexpr int RENDER_DELAY_FAILED = std::numeric_limits<int>::max() - 2;
 #define INVALID_TILE_RES ((USHORT)-1)
 
 #define MAX_PAGE_REQUESTS 8
-// keep this value reasonably low, else we'll run out of
-// GDI resources/memory when caching many larger bitmaps
-// TODO: this should be based on amount of memory taken by rendered pages
-// i.e. one big page can use as much memory as lots of small pages
+// upper bound for render worker threads; the actual count is based
+// on the number of cores (minus one, to keep the UI thread responsive)
+#define MAX_RENDER_THREADS 8
+// hard upper bound on the number of cached bitmaps so that we can't run
+// out of GDI resources; the primary limit is the byte budget enforced
+// by CacheBudgetBytes()
 #define MAX_BITMAPS_CACHED 64
 
+// number of evicted bitmaps kept around in losslessly compressed form
+#define MAX_BITMAPS_COMPRESSED 32
+
+// number of tiny full-page previews kept for scrollbar scrubbing
+#define MAX_PAGE_PREVIEWS 256
+// max dimension in px of a scrubbing preview; a few dozen KB of pixels
+// per page, enough to make out the page layout while dragging
+constexpr int kPreviewMaxDim = 64;
+
 struct PageInfo;
 
 /* A page is split into tiles of at most TILE_MAX_W x TILE_MAX_H pixels.
@@ -48,8 +59,21 @@ struct BitmapCacheEntry {
 
     // owned by the BitmapCacheEntry
     RenderedBitmap* bitmap = nullptr;
+    // content hash of the rendered page so that tabs showing the same
+    // document can share the bitmap; 0 if unknown (then never shared)
+    u32 contentFingerprint = 0;
     bool outOfDate = false;
+    // document colors the bitmap's pixels were mapped to, so that a
+    // theme toggle can remap them in place instead of re-rendering
+    COLORREF textColor = 0;
+    COLORREF bgColor = 0;
+    // individual images keep their original colors (see RenderCacheThread)
+    bool keepsOriginalColors = false;
     int refs = 1;
+    // memory used by the bitmap's pixels, counted against the byte budget
+    size_t byteSize = 0;
+    // GetTickCount() of the most recent Find() hit, for LRU eviction
+    DWORD lastUse = 0;
 
     BitmapCacheEntry(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition tile,
                      RenderedBitmap* bitmap) {
@@ -65,6 +89,50 @@ struct BitmapCacheEntry {
     }
 };
 
+/* Second-tier cache entry: a bitmap evicted from the cache, kept as
+   zlib-compressed 32-bit pixels. Rendered text and line art compress
+   very well and decompressing is much faster than re-rendering the
+   page through the engine when the user comes back to it. */
+struct CompressedCacheEntry {
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    int rotation = 0;
+    float zoom = 0.f;
+    TilePosition tile;
+
+    Size size;
+    // see the BitmapCacheEntry fields of the same name
+    COLORREF textColor = 0;
+    COLORREF bgColor = 0;
+    bool keepsOriginalColors = false;
+    // owned by the CompressedCacheEntry
+    u8* data = nullptr;
+    size_t dataSize = 0;
+    size_t uncompressedSize = 0;
+
+    ~CompressedCacheEntry();
+};
+
+/* Third-tier entry: a heavily downsampled full-page preview (at most
+   kPreviewMaxDim px in its larger dimension). Painted stretched over
+   the page area while no rendered tile is available yet, most visibly
+   when scrubbing the scrollbar through unvisited parts of a large
+   document. Filled during the idle pass (see QueueIdlePreviewRender)
+   and evicted independently of the bitmap byte budget. */
+struct PagePreviewEntry {
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    int rotation = 0;
+    // owned by the PagePreviewEntry
+    RenderedBitmap* bitmap = nullptr;
+    // GetTickCount() of the most recent paint, for LRU eviction
+    DWORD lastUse = 0;
+
+    ~PagePreviewEntry() {
+        delete bitmap;
+    }
+};
+
 /* Even though this looks a lot like a BitmapCacheEntry, we keep it
    separate for clarity in the code (PageRenderRequests are reused,
    while BitmapCacheEntries are ref-counted) */
@@ -76,6 +144,10 @@ struct PageRenderRequest {
     TilePosition tile;
 
     RectF pageRect; // calculated from TilePosition
+    RenderPriority priority = RenderPriority::Visible;
+    // requests from older generations than RenderCache.renderGeneration
+    // were queued for a viewport the user has scrolled away from
+    int generation = 0;
     bool abort = false;
     AbortCookie* abortCookie = nullptr;
     DWORD timestamp = 0;
@@ -84,22 +156,59 @@ struct PageRenderRequest {
     const OnBitmapRendered* renderCb = nullptr;
 };
 
+// measured render cost of a page, fed back into GetTileRes() so that
+// slow pages get smaller tiles (earlier first pixels, cheaper
+// cancellation) and fast pages larger ones (less per-tile overhead)
+struct PageRenderCost {
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    // EWMA of the measured render time scaled to a full page at the
+    // current zoom, in ms
+    float fullPageMs = 0;
+};
+
 struct RenderCache {
     BitmapCacheEntry* cache[MAX_BITMAPS_CACHED]{};
     int cacheCount = 0;
+    // bytes used by the bitmaps in cache, protected by cacheAccess
+    size_t cacheBytes = 0;
+    // second tier, also protected by cacheAccess
+    CompressedCacheEntry* compressed[MAX_BITMAPS_COMPRESSED]{};
+    int compressedCount = 0;
+    size_t compressedBytes = 0;
+    // third tier: tiny scrubbing previews, also protected by cacheAccess
+    Vec<PagePreviewEntry*> previews;
+    // per-page render times observed by the worker threads, protected
+    // by cacheAccess (bounded, oldest entries evicted first)
+    Vec<PageRenderCost> pageCosts;
+    // signals that the OS is low on physical memory
+    HANDLE lowMemoryNotification = nullptr;
     // make sure to never ask for requestAccess in a cacheAccess
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION cacheAccess;
 
     PageRenderRequest requests[MAX_PAGE_REQUESTS]{};
     int requestCount = 0;
-    PageRenderRequest* curReq = nullptr;
+    // requests currently being rendered, one slot per worker thread
+    PageRenderRequest* curReqs[MAX_RENDER_THREADS]{};
+    // bumped on viewport changes, protected by requestAccess
+    int renderGeneration = 0;
     CRITICAL_SECTION requestAccess;
-    HANDLE renderThread = nullptr;
+    HANDLE renderThreads[MAX_RENDER_THREADS]{};
+    int renderThreadCount = 0;
 
     Size maxTileSize{};
     bool isRemoteSession = false;
 
+    // counters for the render-stats HUD (CmdDebugToggleRenderStats).
+    // paintHits/paintMisses are only touched on the UI thread, the
+    // latency fields are protected by cacheAccess
+    int paintHits = 0;   // PaintTile found the exact tile in the cache
+    int paintMisses = 0; // PaintTile had to settle for a substitute (or nothing)
+    int lastRenderLatencyMs = 0; // request-to-bitmap time of the last completed request
+    i64 renderLatencyTotalMs = 0;
+    int renderedCount = 0;
+
     COLORREF textColor = 0;
     COLORREF backgroundColor = 0;
 
@@ -111,42 +220,82 @@ struct RenderCache {
     RenderCache& operator=(RenderCache const&) = delete;
     ~RenderCache();
 
-    void RequestRendering(DisplayModel* dm, int pageNo);
+    void RequestRendering(DisplayModel* dm, int pageNo, RenderPriority priority = RenderPriority::Visible);
     void Render(DisplayModel* dm, int pageNo, int rotation, float zoom, RectF pageRect,
                 const OnBitmapRendered& callback);
+    // invalidates all queued prerender/speculative requests
+    void BumpRenderGeneration();
     void CancelRendering(DisplayModel* dm);
     bool Exists(DisplayModel* dm, int pageNo, int rotation, float zoom = kInvalidZoom, TilePosition* tile = nullptr);
     void FreeForDisplayModel(DisplayModel* dm);
     void KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm);
+    // persist / restore the compressed tiles covering the last viewport
+    // across sessions, for near-instant resume of yesterday's document
+    void PersistWorkingSet(DisplayModel* dm);
+    void RestoreWorkingSet(DisplayModel* dm);
     void Invalidate(DisplayModel* dm, int pageNo, RectF rect);
+    // re-renders only <rect> (in page coordinates, e.g. an edited
+    // annotation's bounding box) of the page's cached bitmaps in place
+    // instead of invalidating them; returns false if some bitmap
+    // couldn't be patched and the caller must Invalidate() instead
+    bool RerenderRect(DisplayModel* dm, int pageNo, RectF rect);
     // returns how much time in ms has past since the most recent rendering
     // request for the visible part of the page if nothing at all could be
     // painted, 0 if something has been painted and RENDER_DELAY_FAILED on failure
     int Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageInfo* pageInfo, bool* renderOutOfDateCue);
 
-    bool ClearCurrentRequest();
-    bool GetNextRequest(PageRenderRequest* req);
-    void Add(PageRenderRequest& req, RenderedBitmap* bmp);
+    void ResetStats();
+
+    void ClearCurrentRequest(int threadNo);
+    bool GetNextRequest(int threadNo, PageRenderRequest* req);
+    void Add(PageRenderRequest& req, RenderedBitmap* bmp, COLORREF textColor, COLORREF bgColor,
+             bool keepsOriginalColors);
+    // remaps all cached bitmaps to new document colors in place; returns
+    // false if some bitmap couldn't be remapped and a re-render is needed
+    bool RemapCachedColors(COLORREF text, COLORREF bg);
 
-    USHORT GetTileRes(DisplayModel* dm, int pageNo) const;
+    USHORT GetTileRes(DisplayModel* dm, int pageNo);
     USHORT GetMaxTileRes(DisplayModel* dm, int pageNo, int rotation);
+    void RecordRenderTime(const PageRenderRequest& req, double durMs);
+    float GetFullPageCostMs(DisplayModel* dm, int pageNo);
     bool ReduceTileSize();
 
     bool IsRenderQueueFull() const {
         return requestCount == MAX_PAGE_REQUESTS;
     }
     int GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile);
-    void RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage = true);
+    void RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, RenderPriority priority,
+                          bool clearQueueForPage = true);
     bool Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile = nullptr,
-                RectF* pageRect = nullptr, const OnBitmapRendered* renderCb = nullptr);
+                RectF* pageRect = nullptr, const OnBitmapRendered* renderCb = nullptr,
+                RenderPriority priority = RenderPriority::Visible);
     void ClearQueueForDisplayModel(DisplayModel* dm, int pageNo = kInvalidPageNo, TilePosition* tile = nullptr);
-    void AbortCurrentRequest();
+    // abort in-flight requests for the given page (or all pages of dm,
+    // or all requests if dm is nullptr); returns true if any was aborted
+    bool AbortCurrentRequests(DisplayModel* dm = nullptr, int pageNo = kInvalidPageNo);
 
     static DWORD WINAPI RenderCacheThread(LPVOID data);
 
     BitmapCacheEntry* Find(DisplayModel* dm, int pageNo, int rotation, float zoom = kInvalidZoom,
                            TilePosition* tile = nullptr);
     bool DropCacheEntry(BitmapCacheEntry* entry);
+    // move a bitmap about to be evicted into the compressed tier
+    void StashCompressed(BitmapCacheEntry* entry);
+    // decompress a matching second-tier entry back into the cache
+    BitmapCacheEntry* PromoteCompressed(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition tile);
+    void FreeCompressed(DisplayModel* dm, int pageNo = kInvalidPageNo);
+    void FreeAllCompressed();
+    // tiny full-page previews for scrollbar scrubbing (third tier);
+    // AddPreview takes ownership of bmp
+    void AddPreview(DisplayModel* dm, int pageNo, int rotation, RenderedBitmap* bmp);
+    bool HasPreview(DisplayModel* dm, int pageNo, int rotation);
+    // paints the part of the page's preview covering bounds, stretched
+    // to the page's on-screen size; false if no preview is cached
+    bool PaintPreview(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, Rect pageOnScreen);
+    void FreePreviews(DisplayModel* dm);
+    // how many bytes cached bitmaps (including the compressed tier) may
+    // use right now; shrinks under OS memory pressure
+    size_t CacheBudgetBytes();
     void FreePage(DisplayModel* dm = nullptr, int pageNo = -1, TilePosition* tile = nullptr);
     void FreeNotVisible();
 
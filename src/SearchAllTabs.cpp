@@ -0,0 +1,433 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/WinUtil.h"
+#include "utils/UITask.h"
+#include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+
+#include "wingui/UIModels.h"
+#include "wingui/Layout.h"
+#include "wingui/WinGui.h"
+
+#include "Settings.h"
+#include "AppSettings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "GlobalPrefs.h"
+#include "DisplayModel.h"
+#include "MainWindow.h"
+#include "Theme.h"
+#include "WindowTab.h"
+#include "ProgressUpdateUI.h"
+#include "TextSelection.h"
+#include "TextSearch.h"
+#include "SumatraPDF.h"
+#include "SearchAllTabs.h"
+
+#include "utils/Log.h"
+
+constexpr const char* kInfoSearchAllTabs = "Enter to search / go to hit      Esc to close";
+
+// don't list more hits per document; a term this common is better
+// narrowed down than scrolled through
+#define MAX_HITS_PER_TAB 512
+
+// a hit in the results list: the tab it came from and the page the
+// match starts on
+struct TabSearchHit {
+    WindowTab* tab = nullptr;
+    int pageNo = 0;
+};
+
+using StrVecST = StrVecWithData<TabSearchHit>;
+
+struct ListBoxModelST : ListBoxModel {
+    StrVecST strings;
+
+    ListBoxModelST() = default;
+    ~ListBoxModelST() override = default;
+    int ItemsCount() override {
+        return strings.Size();
+    }
+    const char* Item(int i) override {
+        return strings.At(i);
+    }
+};
+
+// bumped whenever a search is started or the panel closes; worker
+// threads carrying an older generation stop and their results are
+// dropped on arrival
+static AtomicInt gTabSearchGen;
+
+struct SearchAllTabsWnd : Wnd {
+    ~SearchAllTabsWnd() override = default;
+    HFONT font = nullptr;
+    MainWindow* win = nullptr;
+
+    Edit* editQuery = nullptr;
+    ListBox* listBox = nullptr;
+    Static* staticInfo = nullptr;
+
+    // all hits received so far, in tab order; rebuilt into the list box
+    // model whenever another tab completes
+    StrVecST results;
+    int tabsPending = 0;
+    int tabsSearched = 0;
+
+    bool PreTranslateMessage(MSG&) override;
+    LRESULT WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) override;
+
+    void StartSearch();
+    void ExecuteCurrentSelection();
+    void UpdateList();
+    void UpdateInfo();
+};
+
+static SearchAllTabsWnd* gSearchAllTabsWnd = nullptr;
+static HWND gHwndToActivateOnClose = nullptr;
+
+static void SafeDeleteSearchAllTabsWnd() {
+    if (!gSearchAllTabsWnd) {
+        return;
+    }
+    gTabSearchGen.Inc();
+    auto tmp = gSearchAllTabsWnd;
+    gSearchAllTabsWnd = nullptr;
+    delete tmp;
+    if (gHwndToActivateOnClose) {
+        SetActiveWindow(gHwndToActivateOnClose);
+        gHwndToActivateOnClose = nullptr;
+    }
+}
+
+static void ScheduleDelete() {
+    if (!gSearchAllTabsWnd) {
+        return;
+    }
+    auto fn = MkFunc0Void(SafeDeleteSearchAllTabsWnd);
+    uitask::Post(fn, "SafeDeleteSearchAllTabsWnd");
+}
+
+// work order and results for searching one tab; created on the UI
+// thread, filled on a worker, consumed back on the UI thread
+struct TabSearchData {
+    int gen = 0;
+    WindowTab* tab = nullptr;
+    // keeps the document alive while the worker runs
+    EngineBase* engine = nullptr;
+    DocumentTextCache* textCache = nullptr;
+    AutoFreeWStr term;
+    bool caseSensitive = false;
+    Vec<int> pages; // start page of each hit, capped at MAX_HITS_PER_TAB
+};
+
+static void TabSearchDone(TabSearchData* d) {
+    d->engine->Release();
+    AutoDelete delData(d);
+
+    SearchAllTabsWnd* wnd = gSearchAllTabsWnd;
+    if (!wnd || d->gen != gTabSearchGen.Get()) {
+        return;
+    }
+    wnd->tabsPending--;
+    wnd->tabsSearched++;
+    // the tab could have been closed while the search was running
+    WindowTab* tab = d->tab;
+    if (wnd->win->Tabs().Contains(tab)) {
+        const char* name = path::GetBaseNameTemp(tab->filePath);
+        for (int pageNo : d->pages) {
+            TempStr label = tab->ctrl ? tab->ctrl->GetPageLabeTemp(pageNo) : str::FormatTemp("%d", pageNo);
+            TempStr s = str::FormatTemp("%s \xE2\x80\x94 page %s", name, label);
+            TabSearchHit hit;
+            hit.tab = tab;
+            hit.pageNo = pageNo;
+            wnd->results.Append(s, hit);
+        }
+    }
+    wnd->UpdateList();
+    wnd->UpdateInfo();
+}
+
+static void TabSearchThread(TabSearchData* d) {
+    TextSearch ts(d->engine, d->textCache);
+    ts.SetSensitive(d->caseSensitive);
+    TextSel* sel = ts.FindFirst(1, d->term);
+    while (sel && d->gen == gTabSearchGen.Get()) {
+        d->pages.Append(ts.searchHitStartAt);
+        if (d->pages.Size() >= MAX_HITS_PER_TAB) {
+            break;
+        }
+        sel = ts.FindNext();
+    }
+    auto fn = MkFunc0(TabSearchDone, d);
+    uitask::Post(fn, "TabSearchDone");
+}
+
+void SearchAllTabsWnd::UpdateList() {
+    auto m = new ListBoxModelST();
+    int n = results.Size();
+    for (int i = 0; i < n; i++) {
+        m->strings.AppendFrom(&results, i);
+    }
+    int currSel = listBox->GetCurrentSelection();
+    listBox->SetModel(m);
+    if (m->ItemsCount() > 0) {
+        listBox->SetCurrentSelection(currSel >= 0 ? currSel : 0);
+    }
+}
+
+void SearchAllTabsWnd::UpdateInfo() {
+    if (tabsPending > 0) {
+        TempStr s = str::FormatTemp("Searching %d of %d...", tabsSearched + 1, tabsSearched + tabsPending);
+        staticInfo->SetText(s);
+        return;
+    }
+    if (tabsSearched == 0) {
+        staticInfo->SetText(kInfoSearchAllTabs);
+        return;
+    }
+    TempStr s = str::FormatTemp("%d hits in %d documents", results.Size(), tabsSearched);
+    staticInfo->SetText(s);
+}
+
+// fans the query out: one worker per open document, each with its own
+// TextSearch over that tab's DocumentTextCache. The per-tab extraction
+// pipelines (background text extraction, anchor prefiltering) all do
+// their work in parallel, so the whole sweep takes roughly as long as
+// the slowest single document
+void SearchAllTabsWnd::StartSearch() {
+    char* term = HwndGetTextTemp(editQuery->hwnd);
+    if (str::IsEmpty(term)) {
+        return;
+    }
+    int gen = gTabSearchGen.Inc();
+    results.Reset();
+    tabsPending = 0;
+    tabsSearched = 0;
+    UpdateList();
+
+    // all tabs use the match-case setting of the current document
+    bool caseSensitive = false;
+    DisplayModel* dm = win->AsFixed();
+    if (dm) {
+        caseSensitive = dm->textSearch->caseSensitive;
+    }
+
+    for (WindowTab* tab : win->Tabs()) {
+        DisplayModel* tabDm = tab->AsFixed();
+        if (!tabDm) {
+            // only fixed-page documents have a text cache; lazily
+            // loaded tabs haven't been opened yet
+            continue;
+        }
+        auto d = new TabSearchData();
+        d->gen = gen;
+        d->tab = tab;
+        d->engine = tabDm->GetEngine();
+        d->engine->AddRef();
+        d->textCache = tabDm->textCache;
+        d->term.Set(ToWStr(term));
+        d->caseSensitive = caseSensitive;
+        tabsPending++;
+        auto fn = MkFunc0(TabSearchThread, d);
+        RunAsync(fn, "TabSearchThread", ThreadQoS::Utility);
+    }
+    UpdateInfo();
+}
+
+void SearchAllTabsWnd::ExecuteCurrentSelection() {
+    int idx = listBox->GetCurrentSelection();
+    if (idx < 0) {
+        return;
+    }
+    auto m = (ListBoxModelST*)listBox->model;
+    TabSearchHit* hit = m->strings.AtData(idx);
+    WindowTab* tab = hit->tab;
+    if (!win->Tabs().Contains(tab)) {
+        return;
+    }
+    if (win->CurrentTab() != tab) {
+        SelectTabInWindow(tab);
+    }
+    if (tab->ctrl) {
+        tab->ctrl->GoToPage(hit->pageNo, true);
+    }
+    gHwndToActivateOnClose = win->hwndFrame;
+    ScheduleDelete();
+}
+
+LRESULT SearchAllTabsWnd::WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_ACTIVATE:
+            if (wparam == WA_INACTIVE) {
+                ScheduleDelete();
+                return 0;
+            }
+            break;
+    }
+
+    return WndProcDefault(hwnd, msg, wparam, lparam);
+}
+
+bool SearchAllTabsWnd::PreTranslateMessage(MSG& msg) {
+    if (msg.message != WM_KEYDOWN) {
+        return false;
+    }
+    if (msg.wParam == VK_ESCAPE) {
+        ScheduleDelete();
+        return true;
+    }
+    if (msg.wParam == VK_RETURN) {
+        if (GetFocus() == editQuery->hwnd) {
+            StartSearch();
+        } else {
+            ExecuteCurrentSelection();
+        }
+        return true;
+    }
+    int dir = 0;
+    if (msg.wParam == VK_UP) {
+        dir = -1;
+    } else if (msg.wParam == VK_DOWN) {
+        dir = 1;
+    }
+    if (dir == 0) {
+        return false;
+    }
+    int n = listBox->GetCount();
+    if (n == 0) {
+        return false;
+    }
+    int sel = listBox->GetCurrentSelection() + dir;
+    if (sel < 0) {
+        sel = n - 1;
+    }
+    if (sel >= n) {
+        sel = 0;
+    }
+    listBox->SetCurrentSelection(sel);
+    return true;
+}
+
+static void ListDoubleClick(SearchAllTabsWnd* w) {
+    w->ExecuteCurrentSelection();
+}
+
+static void OnDestroy(Wnd::DestroyEvent*) {
+    ScheduleDelete();
+}
+
+// almost like HwndPositionInCenterOf but y is near top of hwndRelative
+static void PositionSearchAllTabs(HWND hwnd, HWND hwndRelative) {
+    Rect rRelative = WindowRect(hwndRelative);
+    Rect r = WindowRect(hwnd);
+    int x = rRelative.x + (rRelative.dx / 2) - (r.dx / 2);
+    int y = rRelative.y + (rRelative.dy / 2) - (r.dy / 2);
+    r = {x, y, r.dx, r.dy};
+    Rect r2 = ShiftRectToWorkArea(r, hwndRelative, true);
+    r2.y = rRelative.y + 42;
+    SetWindowPos(hwnd, nullptr, r2.x, r2.y, 0, 0, SWP_NOZORDER | SWP_NOSIZE);
+}
+
+static bool CreateSearchAllTabsWnd(SearchAllTabsWnd* wnd, MainWindow* win, const char* term) {
+    {
+        CreateCustomArgs args;
+        args.visible = false;
+        args.style = WS_POPUPWINDOW;
+        args.font = wnd->font;
+        wnd->CreateCustom(args);
+    }
+    if (!wnd->hwnd) {
+        return false;
+    }
+
+    auto colBg = ThemeWindowControlBackgroundColor();
+    auto colTxt = ThemeWindowTextColor();
+    wnd->SetColors(colTxt, colBg);
+
+    auto vbox = new VBox();
+    vbox->alignMain = MainAxisAlign::MainStart;
+    vbox->alignCross = CrossAxisAlign::Stretch;
+
+    {
+        Edit::CreateArgs args;
+        args.parent = wnd->hwnd;
+        args.isMultiLine = false;
+        args.withBorder = false;
+        args.cueText = "search all open documents";
+        args.text = term;
+        args.font = wnd->font;
+        auto c = new Edit();
+        c->SetColors(colTxt, colBg);
+        c->maxDx = 150;
+        HWND ok = c->Create(args);
+        ReportIf(!ok);
+        wnd->editQuery = c;
+        vbox->AddChild(c);
+    }
+
+    {
+        ListBox::CreateArgs args;
+        args.parent = wnd->hwnd;
+        args.font = wnd->font;
+        auto c = new ListBox();
+        c->onDoubleClick = MkFunc0(ListDoubleClick, wnd);
+        c->idealSizeLines = 32;
+        c->SetInsetsPt(4, 0);
+        c->Create(args);
+        c->SetColors(colTxt, colBg);
+        c->SetModel(new ListBoxModelST());
+        wnd->listBox = c;
+        vbox->AddChild(c, 1);
+    }
+
+    {
+        Static::CreateArgs args;
+        args.parent = wnd->hwnd;
+        args.font = wnd->font;
+        args.text = kInfoSearchAllTabs;
+        auto c = new Static();
+        HWND ok = c->Create(args);
+        ReportIf(!ok);
+        c->SetColors(colTxt, colBg);
+        wnd->staticInfo = c;
+        vbox->AddChild(c);
+    }
+
+    auto padding = new Padding(vbox, DpiScaledInsets(wnd->hwnd, 4, 8));
+    wnd->layout = padding;
+
+    auto rc = ClientRect(win->hwndFrame);
+    int dy = rc.dy - 72;
+    if (dy < 480) {
+        dy = 480;
+    }
+    int dx = rc.dx - 256;
+    dx = limitValue(dx, 640, 1024);
+    LayoutAndSizeToContent(wnd->layout, dx, dy, wnd->hwnd);
+    PositionSearchAllTabs(wnd->hwnd, win->hwndFrame);
+
+    wnd->editQuery->SetCursorPositionAtEnd();
+    wnd->SetIsVisible(true);
+    HwndSetFocus(wnd->editQuery->hwnd);
+    return true;
+}
+
+void RunSearchAllTabs(MainWindow* win) {
+    if (gSearchAllTabsWnd) {
+        return;
+    }
+    auto wnd = new SearchAllTabsWnd();
+    auto fn = MkFunc1Void<Wnd::DestroyEvent*>(OnDestroy);
+    wnd->onDestroy = fn;
+    wnd->font = GetAppBiggerFont();
+    wnd->win = win;
+    // start out with the term from the find toolbar, if any
+    char* term = HwndGetTextTemp(win->hwndFindEdit);
+    bool ok = CreateSearchAllTabsWnd(wnd, win, term);
+    ReportIf(!ok);
+    gSearchAllTabsWnd = wnd;
+    gHwndToActivateOnClose = win->hwndFrame;
+}
@@ -0,0 +1,6 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// "find this in any open document": fans a search term across all open
+// tabs in parallel and shows the grouped hits in a pick-list panel
+void RunSearchAllTabs(MainWindow* win);
@@ -16,6 +16,7 @@
 #include "EngineBase.h"
 #include "EngineAll.h"
 #include "GlobalPrefs.h"
+#include "Flags.h"
 #include "ChmModel.h"
 #include "DisplayModel.h"
 #include "PdfSync.h"
@@ -193,6 +194,83 @@ void ClearSearchResult(MainWindow* win) {
     ScheduleRepaint(win, 0);
 }
 
+void ClearDocumentSearchHits(MainWindow* win) {
+    if (!win->searchHits) {
+        return;
+    }
+    delete win->searchHits;
+    win->searchHits = nullptr;
+    RedrawWindow(win->hwndCanvas, nullptr, nullptr, RDW_FRAME | RDW_INVALIDATE);
+}
+
+// draws a mark per search hit onto the vertical scrollbar so the
+// distribution of hits across the document is visible at a glance.
+// Called over the freshly painted non-client area (see WM_NCPAINT in
+// Canvas.cpp) and after client paints, which restore the marks the
+// moving scroll thumb painted over
+void PaintSearchHitMarks(MainWindow* win) {
+    DocumentSearchHits* hits = win->searchHits;
+    DisplayModel* dm = win->AsFixed();
+    if (!hits || !dm || hits->pages.Size() == 0) {
+        return;
+    }
+    // the scrollbar only maps to the whole document in continuous layouts
+    if (!IsContinuous(dm->GetDisplayMode())) {
+        return;
+    }
+    if (gGlobalPrefs->fixedPageUI.hideScrollbars) {
+        return;
+    }
+    HWND hwnd = win->hwndCanvas;
+    DWORD style = GetWindowLong(hwnd, GWL_STYLE);
+    if (!(style & WS_VSCROLL)) {
+        return;
+    }
+    int canvasDy = dm->GetCanvasSize().dy;
+    if (canvasDy <= 0) {
+        return;
+    }
+    Rect cr = ClientRect(hwnd);
+    int cyArrow = GetSystemMetrics(SM_CYVSCROLL);
+    int trackDy = cr.dy - 2 * cyArrow;
+    if (trackDy <= 0) {
+        return;
+    }
+    HDC hdc = GetWindowDC(hwnd);
+    if (!hdc) {
+        return;
+    }
+    // window DC coordinates are relative to the window's top-left corner
+    Rect wr = WindowRect(hwnd);
+    POINT origin{0, 0};
+    ClientToScreen(hwnd, &origin);
+    int offX = origin.x - wr.x;
+    int offY = origin.y - wr.y;
+    int markX = offX + cr.dx + 2;
+    int markDx = GetSystemMetrics(SM_CXVSCROLL) - 4;
+
+    COLORREF col = GetPrefsColor(gGlobalPrefs->fixedPageUI.selectionColor)->col;
+    AutoDeleteBrush brush = CreateSolidBrush(col);
+    int n = hits->pages.Size();
+    for (int i = 0; i < n; i++) {
+        int pageNo = hits->pages.at(i);
+        PageInfo* pageInfo = dm->GetPageInfo(pageNo);
+        if (!pageInfo || pageInfo->pos.IsEmpty()) {
+            continue;
+        }
+        // canvas position of the hit; the in-page offset ignores rotation,
+        // which is plenty accurate for a scrollbar mark
+        float yCanvas = (float)pageInfo->pos.y;
+        if (pageInfo->page.dy > 0) {
+            yCanvas += (float)hits->rects.at(i).y / (float)pageInfo->page.dy * (float)pageInfo->pos.dy;
+        }
+        int y = offY + cyArrow + (int)(yCanvas * (float)trackDy / (float)canvasDy);
+        RECT r{markX, y, markX + markDx, y + 2};
+        FillRect(hdc, &r, brush);
+    }
+    ReleaseDC(hwnd, hdc);
+}
+
 struct UpdateFindStatusData {
     MainWindow* win;
     int current;
@@ -309,12 +387,17 @@ struct FindEndTaskData {
     MainWindow* win = nullptr;
     FindThreadData* ftd = nullptr;
     TextSel* textSel = nullptr;
+    // freshly collected whole-document hit list (or nullptr when the
+    // cached one was still valid); ownership passes to win->searchHits
+    DocumentSearchHits* hits = nullptr;
     bool wasModifiedCanceled = false;
     bool loopedAround = false;
     FindEndTaskData() = default;
     ~FindEndTaskData() {
         delete ftd;
         ftd = nullptr;
+        delete hits;
+        hits = nullptr;
     }
 };
 
@@ -335,6 +418,13 @@ static void FindEndTask(FindEndTaskData* d) {
         // before this FindEndTask could be executed
         return;
     }
+    if (d->hits && win->IsDocLoaded()) {
+        delete win->searchHits;
+        win->searchHits = d->hits;
+        d->hits = nullptr;
+        // repaint the hit marks on the scrollbar
+        RedrawWindow(win->hwndCanvas, nullptr, nullptr, RDW_FRAME | RDW_INVALIDATE);
+    }
     if (!win->IsDocLoaded()) {
         // the UI has already been disabled and hidden
     } else if (textSel) {
@@ -357,6 +447,111 @@ static void UpdateSearchProgress(FindThreadData* ftd, ProgressUpdateData* data)
     ftd->UpdateProgress(data->current, data->total);
 }
 
+// don't collect more hits than can be told apart on a scrollbar; past
+// this the list is dropped and F3 falls back to incremental search
+#define MAX_SEARCH_HIT_MARKS (8 * 1024)
+
+static void SearchHitsProgress(FindThreadData* ftd, ProgressUpdateData* data) {
+    // only answer cancellation queries; the primary search has already
+    // shown the progress UI for this term
+    if (data->wasCancelled) {
+        *data->wasCancelled = ftd->WasCanceled();
+    }
+}
+
+// sweeps the whole document once and records the start position and
+// first rectangle of every hit. Runs on the find thread with its own
+// TextSearch so the position of the primary search isn't disturbed
+static void CollectDocumentSearchHits(FindThreadData* ftd, DisplayModel* dm, DocumentSearchHits* hits) {
+    TextSearch* textSearch = dm->textSearch;
+    // start position of the hit the primary search ended on, so that
+    // F3 navigation continues from it
+    int curPage = textSearch->GetSearchHitStartPageNo();
+    int curGlyph = textSearch->startGlyph;
+
+    TextSearch ts(dm->GetEngine(), dm->textCache);
+    ts.progressCb = MkFunc1<FindThreadData, ProgressUpdateData*>(SearchHitsProgress, ftd);
+    ts.SetSensitive(textSearch->caseSensitive);
+
+    TextSel* sel = ts.FindFirst(1, ftd->text);
+    while (sel && !ftd->WasCanceled()) {
+        if (hits->pages.Size() >= MAX_SEARCH_HIT_MARKS) {
+            // too many to be useful; forget them rather than keeping an
+            // arbitrary subset
+            hits->pages.Reset();
+            hits->glyphs.Reset();
+            hits->rects.Reset();
+            return;
+        }
+        if (ts.searchHitStartAt == curPage && ts.startGlyph == curGlyph) {
+            hits->current = hits->pages.Size();
+        }
+        hits->pages.Append(ts.searchHitStartAt);
+        hits->glyphs.Append(ts.startGlyph);
+        hits->rects.Append(sel->rects[0]);
+        sel = ts.FindNext();
+    }
+}
+
+// runs on the find thread: reads page visibility off the immutable
+// geometry snapshot instead of pagesInfo, which the UI thread mutates
+static bool PageVisibleForSearch(DisplayModel* dm, int pageNo) {
+    PageGeometrySnapshot* geom = dm->AcquirePageGeometry();
+    if (!geom) {
+        return dm->PageVisible(pageNo);
+    }
+    bool visible = geom->PageVisible(pageNo);
+    geom->Release();
+    return visible;
+}
+
+// jumps to the neighboring hit in the cached whole-document hit list
+// instead of re-searching from the current position
+static TextSel* FindCachedHit(MainWindow* win, TextSearch::Direction direction, DocumentSearchHits* hits,
+                              bool* loopedAround) {
+    DisplayModel* dm = win->AsFixed();
+    TextSearch* textSearch = dm->textSearch;
+    bool fwd = TextSearch::Direction::Forward == direction;
+    int n = hits->pages.Size();
+    int idx;
+
+    int curPage = textSearch->GetCurrentPageNo();
+    if (!win->ctrl->ValidPageNo(curPage) || !PageVisibleForSearch(dm, curPage)) {
+        // the user scrolled away from the last hit: continue from the
+        // first hit at or after (resp. before) the current page
+        int pageNo = win->ctrl->CurrentPageNo();
+        idx = fwd ? n : -1;
+        for (int i = 0; i < n; i++) {
+            if (fwd && hits->pages.at(i) >= pageNo) {
+                idx = i;
+                break;
+            }
+            if (!fwd && hits->pages.at(i) <= pageNo) {
+                idx = i;
+            }
+        }
+        if (idx == n || idx == -1) {
+            idx = fwd ? 0 : n - 1;
+            *loopedAround = true;
+        }
+    } else {
+        idx = hits->current + (fwd ? 1 : -1);
+        if (idx >= n) {
+            idx = 0;
+            *loopedAround = true;
+        } else if (idx < 0) {
+            idx = n - 1;
+            *loopedAround = true;
+        }
+    }
+
+    TextSel* sel = textSearch->FindHitAt(hits->pages.at(idx), hits->glyphs.at(idx));
+    if (sel) {
+        hits->current = idx;
+    }
+    return sel;
+}
+
 static void FindThread(FindThreadData* ftd) {
     ReportIf(!(ftd && ftd->win && ftd->win->ctrl && ftd->win->ctrl->AsFixed()));
 
@@ -374,15 +569,24 @@ static void FindThread(FindThreadData* ftd) {
     TextSel* rect;
     textSearch->progressCb = MkFunc1<FindThreadData, ProgressUpdateData*>(UpdateSearchProgress, ftd);
     textSearch->SetDirection(ftd->direction);
-    if (ftd->wasModified || !ctrl->ValidPageNo(textSearch->GetCurrentPageNo()) ||
-        !dm->GetPageInfo(textSearch->GetCurrentPageNo())->visibleRatio) {
+
+    bool loopedAround = false;
+    // the cached hit list is only valid for the term it was built for;
+    // it's only replaced on the UI thread and never while a find thread
+    // is running, so reading it here is safe
+    DocumentSearchHits* hits = win->searchHits;
+    bool haveHits = !ftd->wasModified && hits && hits->pages.Size() > 0 && str::Eq(hits->term, ftd->text) &&
+                    hits->caseSensitive == textSearch->caseSensitive;
+    if (haveHits) {
+        rect = FindCachedHit(win, ftd->direction, hits, &loopedAround);
+    } else if (ftd->wasModified || !ctrl->ValidPageNo(textSearch->GetCurrentPageNo()) ||
+               !PageVisibleForSearch(dm, textSearch->GetCurrentPageNo())) {
         rect = textSearch->FindFirst(ctrl->CurrentPageNo(), ftd->text);
     } else {
         rect = textSearch->FindNext();
     }
 
-    bool loopedAround = false;
-    if (!win->findCancelled && !rect) {
+    if (!win->findCancelled && !rect && !haveHits) {
         // With no further findings, start over (unless this was a new search from the beginning)
         int startPage = (TextSearch::Direction::Forward == ftd->direction) ? 1 : ctrl->PageCount();
         if (!ftd->wasModified || ctrl->CurrentPageNo() != startPage) {
@@ -391,6 +595,22 @@ static void FindThread(FindThreadData* ftd) {
         }
     }
 
+    // collect all hits of a new term in one pass; F3 then jumps through
+    // the cached list and the scrollbar shows one mark per hit
+    DocumentSearchHits* newHits = nullptr;
+    if (!haveHits && !win->findCancelled) {
+        newHits = new DocumentSearchHits();
+        newHits->term.SetCopy(ftd->text);
+        newHits->caseSensitive = textSearch->caseSensitive;
+        if (rect) {
+            CollectDocumentSearchHits(ftd, dm, newHits);
+        }
+        if (win->findCancelled) {
+            delete newHits;
+            newHits = nullptr;
+        }
+    }
+
     // wait for FindTextOnThread to return so that
     // FindEndTask closes the correct handle to
     // the current find thread
@@ -402,6 +622,7 @@ static void FindThread(FindThreadData* ftd) {
     data->win = win;
     data->ftd = ftd;
     data->textSel = nullptr;
+    data->hits = newHits;
     data->loopedAround = false;
 
     if (!win->findCancelled && rect) {
@@ -906,6 +1127,11 @@ static const char* HandleOpenCmd(const char* cmd, bool* ack) {
     // rest via DDE.
     // ReportIf(win && win->IsAboutWindow());
     if (win) {
+        // a pre-warmed instance (-preload) waits hidden until it gets
+        // its first document
+        if (gCli->preload && !IsWindowVisible(win->hwndFrame)) {
+            ShowWindow(win->hwndFrame, SW_SHOW);
+        }
         if (forceRefresh) {
             logf("HandleOpenCmd: forceRefresh != 0 so calling ReloadDocument()\n");
             ReloadDocument(win, true);
@@ -1249,13 +1475,71 @@ LRESULT OnDDERequest(HWND hwnd, WPARAM wp, LPARAM lp) {
     return 0;
 }
 
+// editors send us bursts of DDE commands (e.g. one forward-search per
+// file during a batch build) and each one used to execute synchronously
+// inside WM_DDE_EXECUTE, blocking the sender for a full round trip per
+// command. Commands are queued instead, acknowledged right away and
+// executed from a single task on the message loop, where a burst of
+// forward-search commands coalesces to the last one
+struct DdeCmd {
+    HWND hwnd = nullptr;
+    char* cmd = nullptr;
+};
+static Vec<DdeCmd> gDdeCmdQueue;
+static bool gDdeCmdTaskPending = false;
+
+static bool IsForwardSearchCmd(const char* cmd) {
+    return str::StartsWith(cmd, "[ForwardSearch");
+}
+
+static void ProcessDdeCmdQueue() {
+    gDdeCmdTaskPending = false;
+    // executing a command can pump messages and queue more commands;
+    // those get their own task, so take the current batch out first
+    Vec<DdeCmd> cmds = gDdeCmdQueue;
+    gDdeCmdQueue.Reset();
+    int n = cmds.Size();
+    for (int i = 0; i < n; i++) {
+        DdeCmd& c = cmds.At(i);
+        bool superseded = false;
+        if (IsForwardSearchCmd(c.cmd)) {
+            // each forward search just moves the view, so only the
+            // final position of a burst matters
+            for (int j = i + 1; !superseded && j < n; j++) {
+                superseded = IsForwardSearchCmd(cmds.At(j).cmd);
+            }
+        }
+        if (!superseded) {
+            HandleExecuteCmds(c.hwnd, c.cmd);
+        }
+        str::Free(c.cmd);
+    }
+}
+
+static void QueueDdeCmd(HWND hwnd, const char* cmd) {
+    DdeCmd c;
+    c.hwnd = hwnd;
+    c.cmd = str::Dup(cmd);
+    gDdeCmdQueue.Append(c);
+    if (!gDdeCmdTaskPending) {
+        gDdeCmdTaskPending = true;
+        auto fn = MkFunc0Void(ProcessDdeCmdQueue);
+        uitask::Post(fn, "ProcessDdeCmdQueue");
+    }
+}
+
 LRESULT OnDDExecute(HWND hwnd, WPARAM wp, LPARAM lp) {
     HWND hwndClient = (HWND)wp;
     HGLOBAL hCommand = (HGLOBAL)lp;
     bool isUnicode = IsWindowUnicode(hwndClient);
 
     TempStr cmd = HGLOBALToStrTemp((HGLOBAL)hCommand, isUnicode);
-    bool didHandle = HandleExecuteCmds(hwnd, cmd);
+    bool didHandle = !str::IsEmpty(cmd);
+    if (didHandle) {
+        QueueDdeCmd(hwnd, cmd);
+    }
+    // the ack confirms that the command was received, not that it was
+    // understood; execution happens after the sender is unblocked
     DDEACK ack{};
     ack.fAck = didHandle ? 1 : 0;
     LPARAM lpres = PackDDElParam(WM_DDE_ACK, *(WORD*)&ack, (UINT_PTR)hCommand);
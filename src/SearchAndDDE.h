@@ -21,6 +21,20 @@ bool OnInverseSearch(MainWindow* win, int x, int y);
 void ShowForwardSearchResult(MainWindow* win, const char* fileName, int line, int col, int ret, int page,
                              Vec<Rect>& rects);
 void PaintForwardSearchMark(MainWindow* win, HDC hdc);
+
+// every hit of a whole-document search, collected in one pass on the
+// find thread. Drives the hit marks on the canvas scrollbar and lets
+// F3 jump to the neighboring hit without searching again.
+struct DocumentSearchHits {
+    AutoFreeWStr term;
+    bool caseSensitive = false;
+    int current = 0; // index of the hit the view was last moved to
+    Vec<int> pages;  // start page of each hit
+    Vec<int> glyphs; // start glyph within the start page's text
+    Vec<Rect> rects; // first rectangle of each hit in page coordinates
+};
+void PaintSearchHitMarks(MainWindow* win);
+void ClearDocumentSearchHits(MainWindow* win);
 void FindPrev(MainWindow* win);
 void FindNext(MainWindow* win);
 void FindFirst(MainWindow* win);
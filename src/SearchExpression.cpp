@@ -0,0 +1,682 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
+#include "utils/WinUtil.h"
+#include "utils/ThreadUtil.h"
+
+#include "wingui/UIModels.h"
+
+#include "Settings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "ProgressUpdateUI.h"
+#include "TextSelection.h"
+#include "SearchExpression.h"
+
+// parallel page fan-out, mirroring TextSearch::PrefilterPages()
+#define MIN_PAGES_FOR_PARALLEL_EXPR_SEARCH 16
+#define MAX_EXPR_SEARCH_THREADS 8
+
+static WCHAR ToLowerW(WCHAR c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c + 32;
+    }
+    if (c < 128) {
+        return c;
+    }
+    WCHAR buf[1] = {c};
+    CharLowerBuffW(buf, 1);
+    return buf[0];
+}
+
+/* ---------- linear-time regex matching ---------- */
+
+// values above any UTF-16 code unit mark non-character states
+constexpr int kNfaSplit = 0x10000;   // epsilon fork into out and out1
+constexpr int kNfaAnyChar = 0x10001; // '.'
+constexpr int kNfaClass = 0x10002;   // '[...]', consults NfaProg::ranges
+constexpr int kNfaMatch = 0x10003;   // accepting state
+
+struct NfaState {
+    int c = 0; // code unit to match or one of the kNfa* markers
+    int out = -1;
+    int out1 = -1;
+    int firstRange = 0; // into NfaProg::ranges for kNfaClass states
+    int nRanges = 0;
+    bool negate = false;
+};
+
+struct NfaProg {
+    Vec<NfaState> states;
+    // inclusive (lo, hi) code unit pairs of all character classes
+    Vec<WCHAR> ranges;
+    int start = -1;
+
+    bool Matches(const WCHAR* text, bool caseSensitive) const;
+};
+
+static bool NfaClassMatches(const NfaProg* prog, const NfaState& st, WCHAR c) {
+    bool in = false;
+    for (int i = 0; i < st.nRanges; i++) {
+        WCHAR lo = prog->ranges.at(st.firstRange + 2 * i);
+        WCHAR hi = prog->ranges.at(st.firstRange + 2 * i + 1);
+        if (c >= lo && c <= hi) {
+            in = true;
+            break;
+        }
+    }
+    return st.negate ? !in : in;
+}
+
+// adds a state to the active list, following epsilon forks; seen
+// de-duplicates per step so a list never exceeds the number of states
+static void NfaAddState(const NfaProg* prog, int stateIdx, Vec<int>& list, Vec<int>& seen, int stamp) {
+    Vec<int> todo;
+    todo.Append(stateIdx);
+    while (todo.Size() > 0) {
+        int idx = todo.Pop();
+        if (idx < 0 || seen.at(idx) == stamp) {
+            continue;
+        }
+        seen[idx] = stamp;
+        const NfaState& st = prog->states.at(idx);
+        if (st.c == kNfaSplit) {
+            todo.Append(st.out);
+            todo.Append(st.out1);
+            continue;
+        }
+        list.Append(idx);
+    }
+}
+
+// unanchored search: all active states advance in lock-step and the
+// start state is re-seeded at every position, so the text is scanned
+// exactly once no matter how ambiguous the pattern is
+bool NfaProg::Matches(const WCHAR* text, bool caseSensitive) const {
+    int n = states.Size();
+    if (start < 0 || n == 0 || !text) {
+        return false;
+    }
+    Vec<int> l1, l2;
+    Vec<int>* clist = &l1;
+    Vec<int>* nlist = &l2;
+    Vec<int> seen;
+    seen.SetSize(n);
+    int stamp = 1;
+
+    NfaAddState(this, start, *clist, seen, stamp);
+    for (const WCHAR* s = text;; s++) {
+        for (int idx : *clist) {
+            if (states.at(idx).c == kNfaMatch) {
+                return true;
+            }
+        }
+        WCHAR c = *s;
+        if (!c) {
+            return false;
+        }
+        if (!caseSensitive) {
+            c = ToLowerW(c);
+        }
+        stamp++;
+        nlist->Reset();
+        for (int idx : *clist) {
+            const NfaState& st = states.at(idx);
+            bool matches = st.c == (int)c || st.c == kNfaAnyChar || (st.c == kNfaClass && NfaClassMatches(this, st, c));
+            if (matches) {
+                NfaAddState(this, st.out, *nlist, seen, stamp);
+            }
+        }
+        // a match can also start at the next character
+        NfaAddState(this, start, *nlist, seen, stamp);
+        std::swap(clist, nlist);
+    }
+}
+
+// a partially built NFA: entry state plus the dangling out-edges that
+// the next piece of the pattern has to be patched into
+struct NfaFrag {
+    int start = -1;
+    // state index * 2, +1 when the edge is the state's out1
+    Vec<int> outs;
+};
+
+struct RegexParser {
+    NfaProg* prog = nullptr;
+    const WCHAR* s = nullptr;
+    bool caseSensitive = false;
+
+    int AddState(int c);
+    void Patch(const Vec<int>& outs, int to);
+    void AddClassRange(WCHAR lo, WCHAR hi);
+    bool ParseAtom(NfaFrag* frag);
+    bool ParseRepeat(NfaFrag* frag);
+    bool ParseConcat(NfaFrag* frag);
+    bool ParseAlt(NfaFrag* frag);
+};
+
+int RegexParser::AddState(int c) {
+    NfaState st;
+    st.c = c;
+    prog->states.Append(st);
+    return prog->states.Size() - 1;
+}
+
+void RegexParser::Patch(const Vec<int>& outs, int to) {
+    for (int o : outs) {
+        NfaState& st = prog->states[o / 2];
+        if (o & 1) {
+            st.out1 = to;
+        } else {
+            st.out = to;
+        }
+    }
+}
+
+void RegexParser::AddClassRange(WCHAR lo, WCHAR hi) {
+    prog->ranges.Append(lo);
+    prog->ranges.Append(hi);
+    if (caseSensitive) {
+        return;
+    }
+    // input characters are folded to lower case before class checks, so
+    // mirror the upper-case part of the range into lower case
+    WCHAR foldLo = std::max(lo, (WCHAR)'A');
+    WCHAR foldHi = std::min(hi, (WCHAR)'Z');
+    if (foldLo <= foldHi) {
+        prog->ranges.Append((WCHAR)(foldLo + 32));
+        prog->ranges.Append((WCHAR)(foldHi + 32));
+    }
+}
+
+static bool IsRegexMetaChar(WCHAR c) {
+    return c == '(' || c == ')' || c == '[' || c == ']' || c == '|' || c == '*' || c == '+' || c == '?' || c == '.' ||
+           c == '\\';
+}
+
+bool RegexParser::ParseAtom(NfaFrag* frag) {
+    WCHAR c = *s;
+    if (c == '(') {
+        s++;
+        if (!ParseAlt(frag)) {
+            return false;
+        }
+        if (*s != ')') {
+            return false;
+        }
+        s++;
+        return true;
+    }
+    if (c == '[') {
+        s++;
+        int idx = AddState(kNfaClass);
+        NfaState& st = prog->states[idx];
+        st.firstRange = prog->ranges.Size();
+        if (*s == '^') {
+            st.negate = true;
+            s++;
+        }
+        while (*s && *s != ']') {
+            WCHAR lo = *s++;
+            if (lo == '\\' && *s) {
+                lo = *s++;
+            }
+            WCHAR hi = lo;
+            if (*s == '-' && s[1] && s[1] != ']') {
+                s++;
+                hi = *s++;
+                if (hi == '\\' && *s) {
+                    hi = *s++;
+                }
+            }
+            if (hi < lo) {
+                return false;
+            }
+            AddClassRange(lo, hi);
+        }
+        if (*s != ']') {
+            return false;
+        }
+        s++;
+        st.nRanges = (prog->ranges.Size() - st.firstRange) / 2;
+        frag->start = idx;
+        frag->outs.Reset();
+        frag->outs.Append(idx * 2);
+        return true;
+    }
+    if (c == '.') {
+        s++;
+        int idx = AddState(kNfaAnyChar);
+        frag->start = idx;
+        frag->outs.Reset();
+        frag->outs.Append(idx * 2);
+        return true;
+    }
+    if (c == '\\') {
+        s++;
+        c = *s;
+        if (!c) {
+            return false;
+        }
+    } else if (!c || IsRegexMetaChar(c)) {
+        return false;
+    }
+    s++;
+    if (!caseSensitive) {
+        c = ToLowerW(c);
+    }
+    int idx = AddState(c);
+    frag->start = idx;
+    frag->outs.Reset();
+    frag->outs.Append(idx * 2);
+    return true;
+}
+
+bool RegexParser::ParseRepeat(NfaFrag* frag) {
+    if (!ParseAtom(frag)) {
+        return false;
+    }
+    WCHAR c = *s;
+    if (c != '*' && c != '+' && c != '?') {
+        return true;
+    }
+    s++;
+    int split = AddState(kNfaSplit);
+    prog->states[split].out = frag->start;
+    if (c == '*') {
+        Patch(frag->outs, split);
+        frag->start = split;
+        frag->outs.Reset();
+        frag->outs.Append(split * 2 + 1);
+    } else if (c == '+') {
+        Patch(frag->outs, split);
+        frag->outs.Reset();
+        frag->outs.Append(split * 2 + 1);
+    } else { // '?'
+        frag->start = split;
+        frag->outs.Append(split * 2 + 1);
+    }
+    return true;
+}
+
+bool RegexParser::ParseConcat(NfaFrag* frag) {
+    if (!ParseRepeat(frag)) {
+        return false;
+    }
+    while (*s && *s != '|' && *s != ')') {
+        NfaFrag next;
+        if (!ParseRepeat(&next)) {
+            return false;
+        }
+        Patch(frag->outs, next.start);
+        frag->outs = next.outs;
+    }
+    return true;
+}
+
+bool RegexParser::ParseAlt(NfaFrag* frag) {
+    if (!ParseConcat(frag)) {
+        return false;
+    }
+    while (*s == '|') {
+        s++;
+        NfaFrag other;
+        if (!ParseConcat(&other)) {
+            return false;
+        }
+        int split = AddState(kNfaSplit);
+        prog->states[split].out = frag->start;
+        prog->states[split].out1 = other.start;
+        frag->start = split;
+        for (int o : other.outs) {
+            frag->outs.Append(o);
+        }
+    }
+    return true;
+}
+
+static NfaProg* CompileRegex(const WCHAR* pattern, bool caseSensitive) {
+    NfaProg* prog = new NfaProg();
+    RegexParser p;
+    p.prog = prog;
+    p.s = pattern;
+    p.caseSensitive = caseSensitive;
+    NfaFrag frag;
+    if (!p.ParseAlt(&frag) || *p.s) {
+        delete prog;
+        return nullptr;
+    }
+    int match = p.AddState(kNfaMatch);
+    p.Patch(frag.outs, match);
+    prog->start = frag.start;
+    return prog;
+}
+
+/* ---------- boolean expression over terms ---------- */
+
+enum class SearchExprOp { Term, And, Or };
+
+struct SearchExprNode {
+    SearchExprOp op = SearchExprOp::Term;
+    // a Term is either a literal (phrase) or a compiled regex
+    WCHAR* literal = nullptr;
+    NfaProg* regex = nullptr;
+    Vec<SearchExprNode*> children;
+
+    ~SearchExprNode() {
+        str::Free(literal);
+        delete regex;
+        DeleteVecMembers(children);
+    }
+};
+
+static bool EvalNode(const SearchExprNode* node, const WCHAR* text, bool caseSensitive) {
+    switch (node->op) {
+        case SearchExprOp::Term:
+            if (node->regex) {
+                return node->regex->Matches(text, caseSensitive);
+            }
+            if (caseSensitive) {
+                return StrStr(text, node->literal) != nullptr;
+            }
+            return StrStrI(text, node->literal) != nullptr;
+        case SearchExprOp::And:
+            for (SearchExprNode* child : node->children) {
+                if (!EvalNode(child, text, caseSensitive)) {
+                    return false;
+                }
+            }
+            return true;
+        case SearchExprOp::Or:
+            for (SearchExprNode* child : node->children) {
+                if (EvalNode(child, text, caseSensitive)) {
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+struct ExprParser {
+    const WCHAR* s = nullptr;
+    bool caseSensitive = false;
+
+    void SkipWs();
+    bool EatKeyword(const WCHAR* kw);
+    SearchExprNode* ParseTerm();
+    SearchExprNode* ParseUnary();
+    SearchExprNode* ParseAnd();
+    SearchExprNode* ParseOr();
+};
+
+void ExprParser::SkipWs() {
+    while (str::IsWs(*s)) {
+        s++;
+    }
+}
+
+// consumes kw if it appears as a stand-alone word at the current position
+bool ExprParser::EatKeyword(const WCHAR* kw) {
+    size_t n = str::Len(kw);
+    if (!str::StartsWith(s, kw)) {
+        return false;
+    }
+    WCHAR after = s[n];
+    if (after && !str::IsWs(after) && after != '(') {
+        return false;
+    }
+    s += n;
+    return true;
+}
+
+SearchExprNode* ExprParser::ParseTerm() {
+    WCHAR c = *s;
+    const WCHAR* start;
+    if (c == '"') {
+        s++;
+        start = s;
+        while (*s && *s != '"') {
+            s++;
+        }
+        if (*s != '"' || s == start) {
+            return nullptr;
+        }
+        auto node = new SearchExprNode();
+        node->literal = str::Dup(start, s - start);
+        s++;
+        return node;
+    }
+    if (c == '/') {
+        s++;
+        start = s;
+        while (*s && *s != '/') {
+            if (*s == '\\' && s[1]) {
+                s++;
+            }
+            s++;
+        }
+        if (*s != '/' || s == start) {
+            return nullptr;
+        }
+        AutoFreeWStr pattern = str::Dup(start, s - start);
+        s++;
+        NfaProg* regex = CompileRegex(pattern, caseSensitive);
+        if (!regex) {
+            return nullptr;
+        }
+        auto node = new SearchExprNode();
+        node->regex = regex;
+        return node;
+    }
+    start = s;
+    while (*s && !str::IsWs(*s) && *s != '(' && *s != ')') {
+        s++;
+    }
+    if (s == start) {
+        return nullptr;
+    }
+    auto node = new SearchExprNode();
+    node->literal = str::Dup(start, s - start);
+    return node;
+}
+
+SearchExprNode* ExprParser::ParseUnary() {
+    SkipWs();
+    if (*s == '(') {
+        s++;
+        SearchExprNode* node = ParseOr();
+        if (!node) {
+            return nullptr;
+        }
+        SkipWs();
+        if (*s != ')') {
+            delete node;
+            return nullptr;
+        }
+        s++;
+        return node;
+    }
+    return ParseTerm();
+}
+
+static SearchExprNode* CombineNodes(SearchExprNode* left, SearchExprNode* right, SearchExprOp op) {
+    if (left->op == op) {
+        left->children.Append(right);
+        return left;
+    }
+    auto node = new SearchExprNode();
+    node->op = op;
+    node->children.Append(left);
+    node->children.Append(right);
+    return node;
+}
+
+SearchExprNode* ExprParser::ParseAnd() {
+    SearchExprNode* node = ParseUnary();
+    if (!node) {
+        return nullptr;
+    }
+    for (;;) {
+        SkipWs();
+        if (!*s || *s == ')') {
+            return node;
+        }
+        const WCHAR* save = s;
+        if (EatKeyword(L"OR")) {
+            s = save;
+            return node;
+        }
+        // an explicit AND is optional: adjacent terms conjoin
+        EatKeyword(L"AND");
+        SearchExprNode* right = ParseUnary();
+        if (!right) {
+            delete node;
+            return nullptr;
+        }
+        node = CombineNodes(node, right, SearchExprOp::And);
+    }
+}
+
+SearchExprNode* ExprParser::ParseOr() {
+    SearchExprNode* node = ParseAnd();
+    if (!node) {
+        return nullptr;
+    }
+    for (;;) {
+        SkipWs();
+        if (!EatKeyword(L"OR")) {
+            return node;
+        }
+        SearchExprNode* right = ParseAnd();
+        if (!right) {
+            delete node;
+            return nullptr;
+        }
+        node = CombineNodes(node, right, SearchExprOp::Or);
+    }
+}
+
+/* ---------- SearchExpression ---------- */
+
+SearchExpression::~SearchExpression() {
+    delete root;
+}
+
+bool SearchExpression::MatchesPage(const WCHAR* text) const {
+    if (!root || !text) {
+        return false;
+    }
+    return EvalNode(root, text, caseSensitive);
+}
+
+SearchExpression* SearchExpression::Compile(const WCHAR* expr, bool caseSensitive) {
+    if (str::IsEmpty(expr)) {
+        return nullptr;
+    }
+    ExprParser p;
+    p.s = expr;
+    p.caseSensitive = caseSensitive;
+    SearchExprNode* root = p.ParseOr();
+    if (root) {
+        p.SkipWs();
+        if (*p.s) {
+            delete root;
+            root = nullptr;
+        }
+    }
+    if (!root) {
+        return nullptr;
+    }
+    auto res = new SearchExpression();
+    res->root = root;
+    res->caseSensitive = caseSensitive;
+    return res;
+}
+
+struct ExprSearchThreadData {
+    const SearchExpression* expr = nullptr;
+    DocumentTextCache* textCache = nullptr;
+    int firstPage = 0;
+    int lastPage = 0; // inclusive
+    Vec<bool>* matches = nullptr;
+    ProgressUpdateCb progressCb;
+};
+
+static void ExprSearchThread(ExprSearchThreadData* d) {
+    for (int pageNo = d->firstPage; pageNo <= d->lastPage; pageNo++) {
+        if (WasCanceled(d->progressCb)) {
+            return;
+        }
+        const WCHAR* text = d->textCache->GetTextForPage(pageNo);
+        if (text && d->expr->MatchesPage(text)) {
+            (*d->matches)[pageNo - 1] = true;
+        }
+    }
+}
+
+// evaluating pages is independent work, so spread it over multiple
+// threads the same way TextSearch::PrefilterPages() does; each thread
+// writes to its own range of matches and text extraction is serialized
+// by DocumentTextCache (usually already done by its background pass)
+void SearchExpression::FindMatchingPages(DocumentTextCache* textCache, Vec<int>& pagesOut,
+                                         const ProgressUpdateCb& progressCb) const {
+    int nPages = textCache->nPages;
+    if (nPages <= 0 || !root) {
+        return;
+    }
+    Vec<bool> matches;
+    matches.SetSize(nPages);
+
+    if (nPages < MIN_PAGES_FOR_PARALLEL_EXPR_SEARCH) {
+        ExprSearchThreadData td;
+        td.expr = this;
+        td.textCache = textCache;
+        td.firstPage = 1;
+        td.lastPage = nPages;
+        td.matches = &matches;
+        td.progressCb = progressCb;
+        ExprSearchThread(&td);
+    } else {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        int nThreads = limitValue((int)si.dwNumberOfProcessors, 1, MAX_EXPR_SEARCH_THREADS);
+        int pagesPerThread = (nPages + nThreads - 1) / nThreads;
+
+        ExprSearchThreadData td[MAX_EXPR_SEARCH_THREADS];
+        HANDLE threads[MAX_EXPR_SEARCH_THREADS];
+        int nStarted = 0;
+        for (int i = 0; i < nThreads; i++) {
+            int firstPage = 1 + i * pagesPerThread;
+            if (firstPage > nPages) {
+                break;
+            }
+            td[i].expr = this;
+            td[i].textCache = textCache;
+            td[i].firstPage = firstPage;
+            td[i].lastPage = std::min(firstPage + pagesPerThread - 1, nPages);
+            td[i].matches = &matches;
+            td[i].progressCb = progressCb;
+            auto fn = MkFunc0(ExprSearchThread, &td[i]);
+            threads[nStarted] = StartThread(fn, "ExprSearchThread");
+            if (threads[nStarted]) {
+                nStarted++;
+            }
+        }
+        WaitForMultipleObjects(nStarted, threads, TRUE, INFINITE);
+        for (int i = 0; i < nStarted; i++) {
+            CloseHandle(threads[i]);
+        }
+    }
+
+    if (WasCanceled(progressCb)) {
+        return;
+    }
+    for (int i = 0; i < nPages; i++) {
+        if (matches.at(i)) {
+            pagesOut.Append(i + 1);
+        }
+    }
+}
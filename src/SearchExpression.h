@@ -0,0 +1,37 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// compiled boolean / regex search expression, evaluated over the cached
+// per-page text (DocumentTextCache). Expression syntax:
+//   term1 term2        both terms must appear on a page (implicit AND)
+//   term1 AND term2    same, explicit
+//   term1 OR term2     either term; AND binds stronger than OR
+//   "exact phrase"     literal phrase, may contain spaces
+//   /colou?r/          regular expression
+//   ( ... )            grouping
+// the regex subset: literal characters, '.', '[...]' classes with
+// ranges and '^' negation, '|', '(...)', postfix '*', '+' and '?', and
+// '\' to escape metacharacters. Patterns compile to an NFA that is
+// simulated in lock-step (all active states advanced per character), so
+// matching stays linear in the page size for arbitrarily nested patterns
+
+struct SearchExprNode;
+
+struct SearchExpression {
+    SearchExpression() = default;
+    ~SearchExpression();
+
+    // does the boolean combination of terms hold for this page's text?
+    bool MatchesPage(const WCHAR* text) const;
+
+    // evaluates every page of textCache on multiple threads and appends
+    // the numbers of matching pages to pagesOut, in page order.
+    // progressCb is only used for cancellation and may be empty
+    void FindMatchingPages(DocumentTextCache* textCache, Vec<int>& pagesOut, const ProgressUpdateCb& progressCb) const;
+
+    // returns nullptr if expr can't be parsed
+    static SearchExpression* Compile(const WCHAR* expr, bool caseSensitive);
+
+    SearchExprNode* root = nullptr;
+    bool caseSensitive = false;
+};
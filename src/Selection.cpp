@@ -6,6 +6,10 @@
 #include <UIAutomationCoreApi.h>
 #include "utils/ScopedWin.h"
 #include "utils/Dpi.h"
+#include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/UITask.h"
+#include "utils/AsyncTask.h"
 #include "utils/WinUtil.h"
 
 #include "utils/Log.h"
@@ -171,8 +175,14 @@ void PaintSelection(MainWindow* win, HDC hdc) {
             return;
         }
 
+        // a document-wide select-all has rects on every page; only the
+        // ones on visible pages can paint
+        DisplayModel* dm = win->AsFixed();
         for (SelectionOnPage& sel : *win->CurrentTab()->selectionOnPage) {
-            rects.Append(sel.GetRect(win->AsFixed()));
+            if (!dm->PageVisible(sel.pageNo)) {
+                continue;
+            }
+            rects.Append(sel.GetRect(dm));
         }
     }
 
@@ -180,6 +190,57 @@ void PaintSelection(MainWindow* win, HDC hdc) {
     PaintTransparentRectangles(hdc, win->canvasRc, rects, parsedCol->col);
 }
 
+// the screen area the current selection paints to, including the
+// outline drawn by PaintTransparentRectangles(); empty if nothing is
+// painted
+Rect SelectionScreenArea(MainWindow* win) {
+    DisplayModel* dm = win->AsFixed();
+    if (!dm) {
+        return Rect();
+    }
+    Rect res;
+    if (win->mouseAction == MouseAction::Selecting) {
+        Rect selRect = win->selectionRect;
+        if (selRect.dx < 0) {
+            selRect.x += selRect.dx;
+            selRect.dx *= -1;
+        }
+        if (selRect.dy < 0) {
+            selRect.y += selRect.dy;
+            selRect.dy *= -1;
+        }
+        res = selRect;
+    } else {
+        WindowTab* tab = win->CurrentTab();
+        if (!tab || !tab->selectionOnPage) {
+            return Rect();
+        }
+        for (SelectionOnPage& sel : *tab->selectionOnPage) {
+            if (!dm->PageVisible(sel.pageNo)) {
+                continue;
+            }
+            res = res.Union(sel.GetRect(dm));
+        }
+    }
+    if (res.IsEmpty()) {
+        return res;
+    }
+    // cover the outline and the anti-aliasing around it
+    res.Inflate(2, 2);
+    return res.Intersect(win->canvasRc);
+}
+
+// invalidates only the part of the canvas a selection change affects;
+// oldArea is SelectionScreenArea() from before the change
+void InvalidateSelectionChange(MainWindow* win, Rect oldArea) {
+    Rect r = oldArea.Union(SelectionScreenArea(win));
+    if (r.IsEmpty()) {
+        return;
+    }
+    RECT rc = ToRECT(r);
+    InvalidateRect(win->hwndCanvas, &rc, FALSE);
+}
+
 void UpdateTextSelection(MainWindow* win, bool select) {
     if (!win->AsFixed()) {
         return;
@@ -246,11 +307,250 @@ TempStr GetSelectedTextTemp(WindowTab* tab, const char* lineSep, bool& isTextOnl
     return s;
 }
 
+/* Delayed clipboard rendering for large text selections.
+
+Copying a selection spanning hundreds of pages used to extract all of
+its text synchronously before SetClipboardData. Instead only the glyph
+range of the selection is remembered and an empty CF_UNICODETEXT entry
+is put on the clipboard; Windows asks for the actual text via
+WM_RENDERFORMAT only when (and if) something pastes it. */
+
+// smaller selections are extracted immediately: that's cheap and the
+// data survives closing the document without any bookkeeping
+constexpr int kMinPagesForDelayedClipboard = 10;
+
+struct DelayedClipboardText {
+    // tab the selected document is in; nullptr when nothing is pending
+    WindowTab* tab = nullptr;
+    int fromPage = 0;
+    int fromGlyph = 0;
+    int toPage = 0;
+    int toGlyph = 0;
+};
+
+static DelayedClipboardText gDelayedClipboardText;
+
+static HGLOBAL BuildDelayedClipboardText() {
+    WindowTab* tab = gDelayedClipboardText.tab;
+    DisplayModel* dm = tab ? tab->AsFixed() : nullptr;
+    if (!dm) {
+        return nullptr;
+    }
+    DocumentTextCache* textCache = dm->textSelection->textCache;
+    int fromPage = gDelayedClipboardText.fromPage;
+    int toPage = gDelayedClipboardText.toPage;
+    str::WStr text;
+    for (int page = fromPage; page <= toPage; page++) {
+        int textLen;
+        const WCHAR* s = textCache->GetTextForPage(page, &textLen);
+        if (!s) {
+            continue;
+        }
+        int end = page == toPage ? gDelayedClipboardText.toGlyph : textLen;
+        end = limitValue(end, 0, textLen);
+        int glyph = page == fromPage ? gDelayedClipboardText.fromGlyph : 0;
+        glyph = limitValue(glyph, 0, end);
+        for (int i = glyph; i < end; i++) {
+            if (s[i] == '\n') {
+                text.Append(L"\r\n");
+            } else {
+                text.AppendChar(s[i]);
+            }
+        }
+        if (page < toPage) {
+            text.Append(L"\r\n");
+        }
+    }
+    size_t cch = text.size() + 1;
+    HGLOBAL handle = GlobalAlloc(GMEM_MOVEABLE, cch * sizeof(WCHAR));
+    if (!handle) {
+        return nullptr;
+    }
+    WCHAR* dst = (WCHAR*)GlobalLock(handle);
+    if (dst) {
+        memcpy(dst, text.Get(), (cch - 1) * sizeof(WCHAR));
+        dst[cch - 1] = 0;
+    }
+    GlobalUnlock(handle);
+    return handle;
+}
+
+// WM_RENDERFORMAT: the clipboard is already open, just provide the data
+void RenderDelayedClipboardFormat(UINT fmt) {
+    if (fmt != CF_UNICODETEXT) {
+        return;
+    }
+    HGLOBAL h = BuildDelayedClipboardText();
+    if (h) {
+        SetClipboardData(CF_UNICODETEXT, h);
+    }
+    // the clipboard holds concrete data from now on
+    gDelayedClipboardText.tab = nullptr;
+}
+
+// WM_RENDERALLFORMATS: the owner window is going away, materialize the
+// pending text so the clipboard survives it
+void RenderAllDelayedClipboardFormats(HWND hwnd) {
+    if (!gDelayedClipboardText.tab) {
+        return;
+    }
+    if (!OpenClipboard(hwnd)) {
+        return;
+    }
+    if (GetClipboardOwner() == hwnd) {
+        RenderDelayedClipboardFormat(CF_UNICODETEXT);
+    }
+    CloseClipboard();
+}
+
+// WM_DESTROYCLIPBOARD: another copy replaced ours
+void DropDelayedClipboardData() {
+    gDelayedClipboardText.tab = nullptr;
+}
+
+// called before tab's document (and with it the text cache) is
+// deleted; materializes the pending clipboard text while we still can
+void FlushDelayedClipboard(WindowTab* tab) {
+    if (!tab || gDelayedClipboardText.tab != tab) {
+        return;
+    }
+    HWND hwnd = tab->win ? tab->win->hwndFrame : nullptr;
+    if (hwnd && OpenClipboard(hwnd)) {
+        if (GetClipboardOwner() == hwnd) {
+            HGLOBAL h = BuildDelayedClipboardText();
+            if (h) {
+                SetClipboardData(CF_UNICODETEXT, h);
+            }
+        }
+        CloseClipboard();
+    }
+    gDelayedClipboardText.tab = nullptr;
+}
+
+// the zoom level a graphical selection is rendered at for the
+// clipboard or a file: the user-chosen export DPI, falling back to the
+// current on-screen zoom (engine zoom 1.0 renders at 96 DPI)
+static float GetSelectionExportZoom(DisplayModel* dm, int pageNo) {
+    int dpi = gGlobalPrefs->imageExportDpi;
+    if (dpi <= 0) {
+        return dm->GetZoomReal(pageNo);
+    }
+    dpi = limitValue(dpi, 48, 1200);
+    return (float)dpi / 96.f;
+}
+
+/* async export of a graphical selection to a .bmp file. Rendering a
+poster-size region at export DPI can take seconds, so everything but
+the file dialog runs off the UI thread and reports through a progress
+notification. One coroutine, hopping between the pool and the UI
+thread (see utils/AsyncTask.h). */
+
+struct SaveSelectionData {
+    // keeps the engine alive while the render runs
+    EngineBase* engine = nullptr;
+    int pageNo = 0;
+    RectF rect;
+    float zoom = 0.f;
+    int rotation = 0;
+    char* path = nullptr;
+    NotificationWnd* wnd = nullptr;
+
+    ~SaveSelectionData() {
+        str::Free(path);
+    }
+};
+
+static AsyncTask SaveSelectionTask(SaveSelectionData* d) {
+    co_await ResumeBackground{};
+    RenderPageArgs args(d->pageNo, d->zoom, d->rotation, &d->rect, RenderTarget::Export);
+    RenderedBitmap* bmp = d->engine->RenderPage(args);
+
+    co_await ResumeUiThread{};
+    if (IsNotificationValid(d->wnd)) {
+        UpdateNotificationProgress(d->wnd, _TRA("Saving image..."), 70);
+    }
+
+    co_await ResumeBackground{};
+    bool ok = false;
+    if (bmp && bmp->IsValid()) {
+        ByteSlice bmpData = SerializeBitmap(bmp->GetBitmap());
+        if (bmpData.data()) {
+            ok = file::WriteFile(d->path, bmpData);
+            bmpData.Free();
+        }
+    }
+    delete bmp;
+
+    co_await ResumeUiThread{};
+    d->engine->Release();
+    if (IsNotificationValid(d->wnd)) {
+        if (ok) {
+            UpdateNotificationProgress(d->wnd, _TRA("Saving image..."), 100);
+            NotificationUpdateMessage(d->wnd, _TRA("Image saved"), kNotifDefaultTimeOut);
+        } else {
+            NotificationUpdateMessage(d->wnd, _TRA("Saving image failed"), kNotif5SecsTimeOut, true);
+        }
+    }
+    delete d;
+}
+
+void SaveSelectionToImageFile(MainWindow* win) {
+    if (!HasPermission(Perm::DiskAccess) || !HasPermission(Perm::CopySelection)) {
+        return;
+    }
+    WindowTab* tab = win->CurrentTab();
+    DisplayModel* dm = win->AsFixed();
+    if (!dm || !tab || !tab->selectionOnPage || tab->selectionOnPage->size() == 0) {
+        return;
+    }
+    SelectionOnPage* selOnPage = &tab->selectionOnPage->at(0);
+
+    WCHAR dstFileName[MAX_PATH + 1]{};
+    OPENFILENAME ofn{};
+    str::Str fileFilter(256);
+    fileFilter.Append(_TRA("Bitmap files"));
+    fileFilter.Append("\1*.bmp\1");
+    fileFilter.Append("\1*.*\1");
+    str::TransCharsInPlace(fileFilter.CStr(), "\1", "\0");
+    TempWStr fileFilterW = ToWStrTemp(fileFilter);
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = win->hwndFrame;
+    ofn.lpstrFile = dstFileName;
+    ofn.nMaxFile = dimof(dstFileName);
+    ofn.lpstrFilter = fileFilterW;
+    ofn.nFilterIndex = 1;
+    ofn.lpstrDefExt = L".bmp";
+    ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_HIDEREADONLY;
+    if (!GetSaveFileNameW(&ofn)) {
+        return;
+    }
+
+    auto d = new SaveSelectionData();
+    d->engine = dm->GetEngine();
+    d->engine->AddRef();
+    d->pageNo = selOnPage->pageNo;
+    d->rect = selOnPage->rect;
+    d->zoom = GetSelectionExportZoom(dm, selOnPage->pageNo);
+    d->rotation = dm->GetRotation();
+    d->path = str::Dup(ToUtf8Temp(dstFileName));
+
+    NotificationCreateArgs nargs;
+    nargs.hwndParent = win->hwndCanvas;
+    nargs.msg = _TRA("Saving image...");
+    d->wnd = ShowNotification(nargs);
+    UpdateNotificationProgress(d->wnd, _TRA("Saving image..."), 5);
+
+    SaveSelectionTask(d);
+}
+
 void CopySelectionToClipboard(MainWindow* win) {
     WindowTab* tab = win->CurrentTab();
     ReportIf(tab->selectionOnPage->size() == 0 && win->mouseAction != MouseAction::SelectingText);
 
-    if (!OpenClipboard(nullptr)) {
+    // open with the frame as owner so that we receive WM_RENDERFORMAT
+    // for delayed-rendered entries
+    if (!OpenClipboard(win->hwndFrame)) {
         return;
     }
     EmptyClipboard();
@@ -267,6 +567,20 @@ void CopySelectionToClipboard(MainWindow* win) {
         args.msg = _TRA("Copying text was denied (copying as image only)");
         ShowNotification(args);
     } else {
+        if (dm && dm->textSelection->result.len > 0) {
+            int fromPage, fromGlyph, toPage, toGlyph;
+            dm->textSelection->GetGlyphRange(&fromPage, &fromGlyph, &toPage, &toGlyph);
+            if (toPage - fromPage + 1 >= kMinPagesForDelayedClipboard) {
+                SetClipboardData(CF_UNICODETEXT, nullptr);
+                gDelayedClipboardText.tab = tab;
+                gDelayedClipboardText.fromPage = fromPage;
+                gDelayedClipboardText.fromGlyph = fromGlyph;
+                gDelayedClipboardText.toPage = toPage;
+                gDelayedClipboardText.toGlyph = toGlyph;
+                // a text selection is never also copied as an image
+                return;
+            }
+        }
         selText = GetSelectedTextTemp(tab, "\r\n", isTextOnlySelectionOut);
     }
 
@@ -284,7 +598,7 @@ void CopySelectionToClipboard(MainWindow* win) {
     }
     /* also copy a screenshot of the current selection to the clipboard */
     SelectionOnPage* selOnPage = &tab->selectionOnPage->at(0);
-    float zoom = dm->GetZoomReal(selOnPage->pageNo);
+    float zoom = GetSelectionExportZoom(dm, selOnPage->pageNo);
     int rotation = dm->GetRotation();
     RenderPageArgs args(selOnPage->pageNo, zoom, rotation, &selOnPage->rect, RenderTarget::Export);
     RenderedBitmap* bmp = dm->GetEngine()->RenderPage(args);
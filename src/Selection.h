@@ -26,8 +26,18 @@ void DeleteOldSelectionInfo(MainWindow* win, bool alsoTextSel = false);
 void PaintTransparentRectangles(HDC hdc, Rect screenRc, Vec<Rect>& rects, COLORREF selectionColor, u8 alpha = 0x5f,
                                 int margin = 1);
 void PaintSelection(MainWindow* win, HDC hdc);
+Rect SelectionScreenArea(MainWindow* win);
+void InvalidateSelectionChange(MainWindow* win, Rect oldArea);
 void UpdateTextSelection(MainWindow* win, bool select = true);
 void CopySelectionToClipboard(MainWindow* win);
+// renders the selected region at the export DPI on a background thread
+// and writes it to a user-chosen .bmp file
+void SaveSelectionToImageFile(MainWindow* win);
+// delayed clipboard rendering of large text selections (see Selection.cpp)
+void RenderDelayedClipboardFormat(UINT fmt);
+void RenderAllDelayedClipboardFormats(HWND hwnd);
+void DropDelayedClipboardData();
+void FlushDelayedClipboard(WindowTab* tab);
 void OnSelectAll(MainWindow* win, bool textOnly = false);
 bool NeedsSelectionEdgeAutoscroll(MainWindow* win, int x, int y);
 void OnSelectionEdgeAutoscroll(MainWindow* win, int x, int y);
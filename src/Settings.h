@@ -245,6 +245,10 @@ struct FileState {
     // that the Frequently Read list hopefully better reflects the
     // currently relevant documents
     int openCount;
+    // week (in the same unit as OpenCountWeek) when this file was last
+    // opened; used for age-based history pruning (see
+    // FileHistoryRetentionDays)
+    int lastOpened;
     // Hex encoded MD5 fingerprint of file content (32 chars) followed by
     // crypt key (64 chars) - only applies for PDF documents
     char* decryptionKey;
@@ -340,6 +344,10 @@ struct GlobalPrefs {
     // actual resolution of the main screen in DPI (if this value isn't
     // positive, the system's UI setting is used)
     int customScreenDPI;
+    // DPI at which a graphical selection is rendered when copied to the
+    // clipboard or saved to a file (0 means the current on-screen zoom
+    // level; values are clamped to the 48-1200 range)
+    int imageExportDpi;
     // how pages should be laid out by default, needs to be synchronized
     // with DefaultDisplayMode after deserialization and before
     // serialization
@@ -352,18 +360,39 @@ struct GlobalPrefs {
     bool enableTeXEnhancements;
     // if true, Esc key closes SumatraPDF
     bool escToExit;
+    // maximum number of entries kept in the file history; entries beyond
+    // this count are pruned, oldest first (0 means no limit; pinned
+    // documents and documents with favorites are always kept)
+    int fileHistoryMaxEntries;
+    // number of days after which a file that hasn't been opened is
+    // pruned from the file history (0 disables age-based pruning; pinned
+    // documents and documents with favorites are always kept)
+    int fileHistoryRetentionDays;
     // if true, we show the full path to a file in the title bar
     bool fullPathInTitle;
+    // folders whose documents are indexed for the command palette's
+    // search-everywhere ('/') mode; an empty list disables the indexer
+    Vec<char*>* fullTextIndexFolders;
     // pattern used to launch the LaTeX editor when doing inverse search
     char* inverseSearchCmdLine;
     // when restoring session, delay loading of documents until their tab
     // is selected
     bool lazyLoading;
+    // low-memory profile: disables speculative prerendering, shrinks the
+    // render cache budget and tile size and skips whole-document text
+    // pre-extraction. one of: auto (on for machines with little physical
+    // RAM), on, off
+    char* lowMemoryMode;
     // background color of the non-document windows, traditionally yellow
     char* mainWindowBackground;
     ParsedColor mainWindowBackgroundParsed;
     // if true, doesn't open Home tab
     bool noHomeTab;
+    // command line used to OCR pages that have no text layer. %i is
+    // replaced with the path of the rendered page image (a .bmp), %o
+    // with the path the command must write the recognized text to.
+    // empty (the default) disables OCR
+    char* ocrCmdLine;
     // if true, a document will be reloaded automatically whenever it's
     // changed (currently doesn't work for documents shown in the ebook UI)
     bool reloadModifiedDocuments;
@@ -373,6 +402,9 @@ struct GlobalPrefs {
     // if true, we store display settings for each document separately
     // (i.e. everything after UseDefaultState in FileStates)
     bool rememberStatePerDocument;
+    // maximum amount of memory (in MB) used for caching rendered pages. 0
+    // means automatic, scaled to the amount of installed RAM
+    int renderCacheSizeInMB;
     // if true and SessionData isn't empty, that session will be restored
     // at startup
     bool restoreSession;
@@ -398,10 +430,19 @@ struct GlobalPrefs {
     int sidebarDx;
     // if true, implements smooth scrolling
     bool smoothScroll;
+    // if > 0, a document in a tab that wasn't looked at for that many
+    // minutes is unloaded to reclaim memory and reloaded when the tab is
+    // selected again. 0 disables this
+    int tabHibernationTimeoutInMin;
     // maximum width of a single tab
     int tabWidth;
     // the name of the theme to use
     char* theme;
+    // URL of a LAN cache server that rendered tiles are fetched from
+    // (and uploaded to) before rasterizing locally; meant for kiosk
+    // deployments where many clients show the same documents. Empty
+    // (the default) disables it
+    char* tileCacheServerURL;
     // if both favorites and bookmarks parts of sidebar are visible, this
     // is the height of bookmarks (table of contents) part
     int tocDy;
@@ -651,6 +692,7 @@ static const FieldInfo gFileStateFields[] = {
     {offsetof(FileState, isPinned), SettingType::Bool, false},
     {offsetof(FileState, isMissing), SettingType::Bool, false},
     {offsetof(FileState, openCount), SettingType::Int, 0},
+    {offsetof(FileState, lastOpened), SettingType::Int, 0},
     {offsetof(FileState, decryptionKey), SettingType::String, 0},
     {offsetof(FileState, useDefaultState), SettingType::Bool, false},
     {offsetof(FileState, displayMode), SettingType::String, (intptr_t) "automatic"},
@@ -667,9 +709,9 @@ static const FieldInfo gFileStateFields[] = {
     {offsetof(FileState, tocState), SettingType::IntArray, 0},
 };
 static StructInfo gFileStateInfo = {
-    sizeof(FileState), 19, gFileStateFields,
-    "FilePath\0Favorites\0IsPinned\0IsMissing\0OpenCount\0DecryptionKey\0UseDefaultState\0DisplayMode\0ScrollPos\0PageN"
-    "o\0Zoom\0Rotation\0WindowState\0WindowPos\0ShowToc\0SidebarDx\0DisplayR2L\0ReparseIdx\0TocState"};
+    sizeof(FileState), 20, gFileStateFields,
+    "FilePath\0Favorites\0IsPinned\0IsMissing\0OpenCount\0LastOpened\0DecryptionKey\0UseDefaultState\0DisplayMode\0Scro"
+    "llPos\0PageNo\0Zoom\0Rotation\0WindowState\0WindowPos\0ShowToc\0SidebarDx\0DisplayR2L\0ReparseIdx\0TocState"};
 
 static const FieldInfo gPointF_1_Fields[] = {
     {offsetof(PointF, x), SettingType::Float, (intptr_t) "0"},
@@ -724,14 +766,21 @@ static const FieldInfo gGlobalPrefsFields[] = {
     {offsetof(GlobalPrefs, defaultZoom), SettingType::String, (intptr_t) "fit page"},
     {offsetof(GlobalPrefs, enableTeXEnhancements), SettingType::Bool, false},
     {offsetof(GlobalPrefs, escToExit), SettingType::Bool, false},
+    {offsetof(GlobalPrefs, fileHistoryMaxEntries), SettingType::Int, 1000},
+    {offsetof(GlobalPrefs, fileHistoryRetentionDays), SettingType::Int, 0},
     {offsetof(GlobalPrefs, fullPathInTitle), SettingType::Bool, false},
+    {offsetof(GlobalPrefs, fullTextIndexFolders), SettingType::StringArray, 0},
+    {offsetof(GlobalPrefs, imageExportDpi), SettingType::Int, 0},
     {offsetof(GlobalPrefs, inverseSearchCmdLine), SettingType::String, 0},
     {offsetof(GlobalPrefs, lazyLoading), SettingType::Bool, true},
+    {offsetof(GlobalPrefs, lowMemoryMode), SettingType::String, (intptr_t) "auto"},
     {offsetof(GlobalPrefs, mainWindowBackground), SettingType::Color, (intptr_t) "#80fff200"},
     {offsetof(GlobalPrefs, noHomeTab), SettingType::Bool, false},
+    {offsetof(GlobalPrefs, ocrCmdLine), SettingType::String, 0},
     {offsetof(GlobalPrefs, reloadModifiedDocuments), SettingType::Bool, true},
     {offsetof(GlobalPrefs, rememberOpenedFiles), SettingType::Bool, true},
     {offsetof(GlobalPrefs, rememberStatePerDocument), SettingType::Bool, true},
+    {offsetof(GlobalPrefs, renderCacheSizeInMB), SettingType::Int, 0},
     {offsetof(GlobalPrefs, restoreSession), SettingType::Bool, true},
     {offsetof(GlobalPrefs, reuseInstance), SettingType::Bool, true},
     {offsetof(GlobalPrefs, showMenubar), SettingType::Bool, true},
@@ -742,8 +791,10 @@ static const FieldInfo gGlobalPrefsFields[] = {
     {offsetof(GlobalPrefs, showStartPage), SettingType::Bool, true},
     {offsetof(GlobalPrefs, sidebarDx), SettingType::Int, 0},
     {offsetof(GlobalPrefs, smoothScroll), SettingType::Bool, false},
+    {offsetof(GlobalPrefs, tabHibernationTimeoutInMin), SettingType::Int, 0},
     {offsetof(GlobalPrefs, tabWidth), SettingType::Int, 300},
     {offsetof(GlobalPrefs, theme), SettingType::String, (intptr_t) ""},
+    {offsetof(GlobalPrefs, tileCacheServerURL), SettingType::String, (intptr_t) ""},
     {offsetof(GlobalPrefs, tocDy), SettingType::Int, 0},
     {offsetof(GlobalPrefs, toolbarSize), SettingType::Int, 18},
     {offsetof(GlobalPrefs, treeFontName), SettingType::String, (intptr_t) "automatic"},
@@ -789,12 +840,14 @@ static const FieldInfo gGlobalPrefsFields[] = {
     {(size_t)-1, SettingType::Comment, (intptr_t) "Settings below are not recognized by the current version"},
 };
 static const StructInfo gGlobalPrefsInfo = {
-    sizeof(GlobalPrefs), 71, gGlobalPrefsFields,
-    "\0\0CheckForUpdates\0CustomScreenDPI\0DefaultDisplayMode\0DefaultZoom\0EnableTeXEnhancements\0EscToExit\0FullPathI"
-    "nTitle\0InverseSearchCmdLine\0LazyLoading\0MainWindowBackground\0NoHomeTab\0ReloadModifiedDocuments\0RememberOpene"
-    "dFiles\0RememberStatePerDocument\0RestoreSession\0ReuseInstance\0ShowMenubar\0ShowToolbar\0ShowFavorites\0ShowToc"
-    "\0ShowLinks\0ShowStartPage\0SidebarDx\0SmoothScroll\0TabWidth\0Theme\0TocDy\0ToolbarSize\0TreeFontName\0TreeFontSi"
-    "ze\0UIFontSize\0UseSysColors\0UseTabs\0ZoomLevels\0ZoomIncrement\0\0FixedPageUI\0\0ComicBookUI\0\0ChmUI\0\0Annotat"
+    sizeof(GlobalPrefs), 80, gGlobalPrefsFields,
+    "\0\0CheckForUpdates\0CustomScreenDPI\0DefaultDisplayMode\0DefaultZoom\0EnableTeXEnhancements\0EscToExit\0FileHisto"
+    "ryMaxEntries\0FileHistoryRetentionDays\0FullPathI"
+    "nTitle\0FullTextIndexFolders\0ImageExportDpi\0InverseSearchCmdLine\0LazyLoading\0LowMemoryMode\0MainWindowBackground\0NoHomeTab\0OcrCmdLine\0ReloadModifiedDocuments\0RememberOpene"
+    "dFiles\0RememberStatePerDocument\0RenderCacheSizeInMB\0RestoreSession\0ReuseInstance\0ShowMenubar\0ShowToolbar\0Sh"
+    "owFavorites\0ShowToc"
+    "\0ShowLinks\0ShowStartPage\0SidebarDx\0SmoothScroll\0TabHibernationTimeoutInMin\0TabWidth\0Theme\0TileCacheServerURL\0TocDy\0ToolbarSi"
+    "ze\0TreeFontName\0TreeFontSize\0UIFontSize\0UseSysColors\0UseTabs\0ZoomLevels\0ZoomIncrement\0\0FixedPageUI\0\0ComicBookUI\0\0ChmUI\0\0Annotat"
     "ions\0\0ExternalViewers\0\0ForwardSearch\0\0PrinterDefaults\0\0SelectionHandlers\0\0Shortcuts\0\0Themes\0\0\0Defau"
     "ltPasswords\0UiLanguage\0VersionToSkip\0WindowState\0WindowPos\0FileStates\0SessionData\0ReopenOnce\0TimeOfLastUpd"
     "ateCheck\0OpenCountWeek\0\0"};
@@ -2,12 +2,15 @@
    License: GPLv3 */
 
 #include "utils/BaseUtil.h"
+#include "utils/CryptoUtil.h"
 #include "utils/DirIter.h"
 #include "utils/FileUtil.h"
 #include "utils/GuessFileType.h"
 #include "utils/HtmlParserLookup.h"
+#include "utils/ThreadUtil.h"
 #include "utils/Timer.h"
 #include "utils/WinUtil.h"
+#include "utils/MpScQueue.h"
 #include "utils/StrQueue.h"
 
 #include "wingui/UIModels.h"
@@ -31,6 +34,7 @@
 #include "Flags.h"
 #include "SearchAndDDE.h"
 #include "StressTesting.h"
+#include "AppTools.h"
 
 #include "utils/Log.h"
 
@@ -207,6 +211,456 @@ void BenchFileOrDir(StrVec& pathsToBench) {
     }
 }
 
+// timings of one measured pass over a document
+struct BenchSuiteTimings {
+    int pages = 0;
+    double loadMs = 0;
+    // first page rendered at 100%, a proxy for time to first paint
+    double firstRenderMs = 0;
+    // all pages rendered at 100%
+    double renderMs = 0;
+    // text extraction of all pages
+    double extractMs = 0;
+    // searching a common word through all pages
+    double searchMs = 0;
+};
+
+static bool BenchSuiteFile(const char* path, BenchSuiteTimings& res) {
+    auto t = TimeGet();
+    EngineBase* engine = CreateEngineFromFile(path, nullptr, true);
+    if (!engine) {
+        logf("BenchSuiteFile: failed to load '%s'\n", path);
+        return false;
+    }
+    res.loadMs = TimeSinceInMs(t);
+    res.pages = engine->PageCount();
+
+    t = TimeGet();
+    for (int pageNo = 1; pageNo <= res.pages; pageNo++) {
+        RenderPageArgs args(pageNo, 1.0, 0);
+        RenderedBitmap* bmp = engine->RenderPage(args);
+        if (pageNo == 1) {
+            res.firstRenderMs = TimeSinceInMs(t);
+        }
+        delete bmp;
+    }
+    res.renderMs = TimeSinceInMs(t);
+
+    DocumentTextCache textCache(engine);
+    t = TimeGet();
+    for (int pageNo = 1; pageNo <= res.pages; pageNo++) {
+        textCache.GetTextForPage(pageNo);
+    }
+    res.extractMs = TimeSinceInMs(t);
+
+    if (res.pages > 0) {
+        t = TimeGet();
+        TextSearch search(engine, &textCache);
+        // a word common enough that the search has matches to locate
+        TextSel* sel = search.FindFirst(1, L"the");
+        while (sel) {
+            sel = search.FindNext();
+        }
+        res.searchMs = TimeSinceInMs(t);
+    }
+
+    engine->Release();
+    return true;
+}
+
+static void AppendJsonString(str::Str& out, const char* s) {
+    out.AppendChar('"');
+    for (; *s; s++) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            out.AppendChar('\\');
+            out.AppendChar(c);
+        } else if (c == '\n') {
+            out.Append("\\n");
+        } else {
+            out.AppendChar(c);
+        }
+    }
+    out.AppendChar('"');
+}
+
+static void AppendJsonTimings(str::Str& out, const char* name, const Vec<double>& vals) {
+    out.AppendFmt("      \"%s\": [", name);
+    for (int i = 0; i < vals.Size(); i++) {
+        out.AppendFmt(i > 0 ? ", %.2f" : "%.2f", vals.at(i));
+    }
+    out.Append("]");
+}
+
+// runs the benchmark suite on a file or recursively on a directory: for
+// every file does unmeasured warmup passes followed by measured
+// iterations of load, render, text extraction and search and writes the
+// per-iteration timings as JSON so that regressions can be tracked
+// across releases on a fixed corpus
+void RunBenchSuite(Flags* flags) {
+    char* path = flags->benchSuitePath;
+    StrVec files;
+    if (file::Exists(path)) {
+        files.Append(path);
+    } else if (dir::Exists(path)) {
+        CollectFilesToBench(path, files);
+    } else {
+        logf("RunBenchSuite: file or dir '%s' doesn't exist\n", path);
+        return;
+    }
+    int nIters = limitValue(flags->benchSuiteIters, 1, 100);
+    int nWarmup = limitValue(flags->benchSuiteWarmup, 0, 100);
+
+    str::Str out;
+    out.Append("{\n");
+    out.AppendFmt("  \"warmup\": %d,\n  \"iterations\": %d,\n", nWarmup, nIters);
+    out.Append("  \"files\": [\n");
+    bool isFirstFile = true;
+    for (int i = 0; i < files.Size(); i++) {
+        char* file = files.At(i);
+        logf("RunBenchSuite: %s\n", file);
+        bool ok = true;
+        for (int j = 0; ok && j < nWarmup; j++) {
+            BenchSuiteTimings ignored;
+            ok = BenchSuiteFile(file, ignored);
+        }
+        Vec<double> loadMs, firstRenderMs, renderMs, extractMs, searchMs;
+        int pages = 0;
+        for (int j = 0; ok && j < nIters; j++) {
+            BenchSuiteTimings run;
+            ok = BenchSuiteFile(file, run);
+            if (!ok) {
+                break;
+            }
+            pages = run.pages;
+            loadMs.Append(run.loadMs);
+            firstRenderMs.Append(run.firstRenderMs);
+            renderMs.Append(run.renderMs);
+            extractMs.Append(run.extractMs);
+            searchMs.Append(run.searchMs);
+        }
+        if (!ok) {
+            continue;
+        }
+        if (!isFirstFile) {
+            out.Append(",\n");
+        }
+        isFirstFile = false;
+        out.Append("    {\n      \"file\": ");
+        AppendJsonString(out, file);
+        out.AppendFmt(",\n      \"pages\": %d,\n", pages);
+        AppendJsonTimings(out, "loadMs", loadMs);
+        out.Append(",\n");
+        AppendJsonTimings(out, "firstRenderMs", firstRenderMs);
+        out.Append(",\n");
+        AppendJsonTimings(out, "renderMs", renderMs);
+        out.Append(",\n");
+        AppendJsonTimings(out, "extractMs", extractMs);
+        out.Append(",\n");
+        AppendJsonTimings(out, "searchMs", searchMs);
+        out.Append("\n    }");
+    }
+    out.Append("\n  ]\n}\n");
+
+    const char* outPath = flags->benchSuiteOut ? flags->benchSuiteOut : "bench-results.json";
+    bool wrote = file::WriteFile(outPath, {(u8*)out.Get(), out.size()});
+    logf("RunBenchSuite: %s results for %d file(s) to '%s'\n", wrote ? "wrote" : "failed to write", files.Size(),
+         outPath);
+}
+
+/* Render determinism harness: renders a corpus to per-page pixel hashes
+plus a small perceptual signature and diffs them against stored goldens,
+so that an engine or rasterizer upgrade can be checked for rendering
+changes (and per-page render time regressions) in one parallel batch run
+instead of eyeballing documents. */
+
+// per-pixel average tolerance on the 8x8 luma downsample; differences
+// below this (e.g. anti-aliasing changes) are perceptually equivalent
+#define GOLDEN_PERCEPTUAL_TOLERANCE 3.0
+// only report render time deltas beyond this factor
+#define GOLDEN_TIMING_SLACK 1.25
+
+struct GoldenPage {
+    char* md5 = nullptr; // hex of the raw page pixels
+    u8 thumb[64]{};      // 8x8 luma downsample of the page
+    double renderMs = 0;
+};
+
+// filled in by one worker, logged and aggregated after all workers join
+struct GoldenFileOutcome {
+    str::Str log;
+    int nPages = 0;
+    int nPixelDiffs = 0;   // hash differs, perceptual diff above tolerance
+    int nPerceptualOk = 0; // hash differs but within tolerance
+    int nTimingDeltas = 0;
+    bool created = false; // no golden existed, wrote one
+    bool failed = false;
+};
+
+struct GoldenTestData {
+    StrVec* files = nullptr;
+    const char* goldenDir = nullptr;
+    bool update = false;
+    GoldenFileOutcome* outcomes = nullptr;
+    AtomicInt fileIdx;
+};
+
+static void FreeGoldenPages(Vec<GoldenPage>& pages) {
+    for (int i = 0; i < pages.Size(); i++) {
+        str::Free(pages.at(i).md5);
+    }
+    pages.Reset();
+}
+
+static void GoldenThumb(BitmapPixels* px, u8 thumb[64]) {
+    int dx = px->size.dx;
+    int dy = px->size.dy;
+    for (int ty = 0; ty < 8; ty++) {
+        for (int tx = 0; tx < 8; tx++) {
+            int x1 = (tx + 1) * dx / 8;
+            int y1 = (ty + 1) * dy / 8;
+            i64 sum = 0;
+            int n = 0;
+            for (int y = ty * dy / 8; y < y1; y++) {
+                for (int x = tx * dx / 8; x < x1; x++) {
+                    COLORREF c = GetPixel(px, x, y);
+                    sum += (GetRed(c) * 77 + GetGreen(c) * 151 + GetBlue(c) * 28) >> 8;
+                    n++;
+                }
+            }
+            thumb[ty * 8 + tx] = n > 0 ? (u8)(sum / n) : 0;
+        }
+    }
+}
+
+static bool GoldenRenderPage(EngineBase* engine, int pageNo, GoldenPage& res) {
+    auto t = TimeGet();
+    RenderPageArgs args(pageNo, 1.0, 0);
+    RenderedBitmap* bmp = engine->RenderPage(args);
+    res.renderMs = TimeSinceInMs(t);
+    if (!bmp || !bmp->IsValid()) {
+        delete bmp;
+        return false;
+    }
+    BitmapPixels* px = GetBitmapPixels(bmp->GetBitmap());
+    if (!px) {
+        delete bmp;
+        return false;
+    }
+    u8 digest[16];
+    CalcMD5Digest(px->pixels, px->nBytesPerRow * px->size.dy, digest);
+    res.md5 = str::MemToHex(digest, 16);
+    GoldenThumb(px, res.thumb);
+    FinalizeBitmapPixels(px);
+    delete bmp;
+    return true;
+}
+
+// goldens are keyed by the hash of the document's path (the same scheme
+// as thumbnails) so that corpus files can live anywhere
+static TempStr GoldenFilePathTemp(const char* goldenDir, const char* docPath) {
+    u8 digest[16];
+    CalcMD5Digest((u8*)docPath, str::Leni(docPath), digest);
+    AutoFreeStr hex = _MemToHex(&digest);
+    return path::JoinTemp(goldenDir, str::FormatTemp("%s.txt", hex.Get()));
+}
+
+static void WriteGoldenFile(const char* path, const char* docPath, Vec<GoldenPage>& pages) {
+    str::Str out;
+    out.AppendFmt("file: %s\n", docPath);
+    out.AppendFmt("pages: %d\n", pages.Size());
+    for (int i = 0; i < pages.Size(); i++) {
+        GoldenPage& p = pages.at(i);
+        AutoFreeStr thumbHex = str::MemToHex(p.thumb, 64);
+        out.AppendFmt("%d %s %s %.2f\n", i + 1, p.md5, thumbHex.Get(), p.renderMs);
+    }
+    file::WriteFile(path, {(u8*)out.Get(), out.size()});
+}
+
+static bool ParseGoldenFile(const char* path, Vec<GoldenPage>& pages) {
+    ByteSlice d = file::ReadFile(path);
+    if (!d.data()) {
+        return false;
+    }
+    defer {
+        d.Free();
+    };
+    StrVec lines;
+    Split(&lines, (char*)d.data(), "\n", true);
+    for (int i = 0; i < lines.Size(); i++) {
+        char* line = lines.At(i);
+        if (str::StartsWith(line, "file:") || str::StartsWith(line, "pages:")) {
+            continue;
+        }
+        // <pageNo> <pixel md5> <thumb hex> <renderMs>
+        StrVec parts;
+        Split(&parts, line, " ", true);
+        if (parts.Size() != 4 || atoi(parts.At(0)) != pages.Size() + 1) {
+            FreeGoldenPages(pages);
+            return false;
+        }
+        GoldenPage p;
+        if (!str::HexToMem(parts.At(2), p.thumb, 64)) {
+            FreeGoldenPages(pages);
+            return false;
+        }
+        p.md5 = str::Dup(parts.At(1));
+        p.renderMs = atof(parts.At(3));
+        pages.Append(p);
+    }
+    return pages.Size() > 0;
+}
+
+static void GoldenTestFile(const char* docPath, GoldenTestData* td, GoldenFileOutcome* res) {
+    EngineBase* engine = CreateEngineFromFile(docPath, nullptr, true);
+    if (!engine) {
+        res->failed = true;
+        res->log.AppendFmt("golden: failed to load '%s'\n", docPath);
+        return;
+    }
+    int nPages = engine->PageCount();
+    Vec<GoldenPage> rendered;
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        GoldenPage p;
+        if (!GoldenRenderPage(engine, pageNo, p)) {
+            res->failed = true;
+            res->log.AppendFmt("golden: '%s' page %d: render failed\n", docPath, pageNo);
+            break;
+        }
+        rendered.Append(p);
+    }
+    engine->Release();
+    if (res->failed) {
+        FreeGoldenPages(rendered);
+        return;
+    }
+    res->nPages = nPages;
+
+    TempStr goldenPath = GoldenFilePathTemp(td->goldenDir, docPath);
+    Vec<GoldenPage> golden;
+    bool haveGolden = !td->update && ParseGoldenFile(goldenPath, golden);
+    if (!haveGolden) {
+        WriteGoldenFile(goldenPath, docPath, rendered);
+        res->created = true;
+        FreeGoldenPages(rendered);
+        return;
+    }
+    if (golden.Size() != rendered.Size()) {
+        res->failed = true;
+        res->log.AppendFmt("golden: '%s': page count changed %d => %d (-golden-update to accept)\n", docPath,
+                           golden.Size(), rendered.Size());
+        FreeGoldenPages(golden);
+        FreeGoldenPages(rendered);
+        return;
+    }
+    for (int i = 0; i < golden.Size(); i++) {
+        GoldenPage& was = golden.at(i);
+        GoldenPage& now = rendered.at(i);
+        if (!str::Eq(was.md5, now.md5)) {
+            double diff = 0;
+            for (int k = 0; k < 64; k++) {
+                diff += std::abs((int)was.thumb[k] - (int)now.thumb[k]);
+            }
+            diff /= 64;
+            if (diff > GOLDEN_PERCEPTUAL_TOLERANCE) {
+                res->nPixelDiffs++;
+                res->log.AppendFmt("golden: '%s' page %d: pixels differ (perceptual diff %.1f)\n", docPath, i + 1,
+                                   diff);
+            } else {
+                res->nPerceptualOk++;
+            }
+        }
+        // renders below a millisecond are all noise
+        if (was.renderMs > 1 &&
+            (now.renderMs > was.renderMs * GOLDEN_TIMING_SLACK || now.renderMs * GOLDEN_TIMING_SLACK < was.renderMs)) {
+            res->nTimingDeltas++;
+            res->log.AppendFmt("golden: '%s' page %d: render time %.1f ms => %.1f ms\n", docPath, i + 1, was.renderMs,
+                               now.renderMs);
+        }
+    }
+    FreeGoldenPages(golden);
+    FreeGoldenPages(rendered);
+}
+
+static void GoldenTestThread(GoldenTestData* td) {
+    for (;;) {
+        int i = td->fileIdx.Inc() - 1;
+        if (i >= td->files->Size()) {
+            return;
+        }
+        GoldenTestFile(td->files->At(i), td, &td->outcomes[i]);
+    }
+}
+
+// runs the golden render test on a file or recursively on a directory.
+// Each document is rendered by one worker; documents don't share state
+// so this parallelizes cleanly at file granularity
+void RunGoldenRenderTest(Flags* flags) {
+    char* path = flags->goldenPath;
+    StrVec files;
+    if (file::Exists(path)) {
+        files.Append(path);
+    } else if (dir::Exists(path)) {
+        CollectFilesToBench(path, files);
+    } else {
+        logf("RunGoldenRenderTest: file or dir '%s' doesn't exist\n", path);
+        return;
+    }
+    int nFiles = files.Size();
+    if (nFiles == 0) {
+        logf("RunGoldenRenderTest: no supported files in '%s'\n", path);
+        return;
+    }
+    const char* goldenDir = flags->goldenDir ? flags->goldenDir : "goldens";
+    if (!dir::CreateAll(goldenDir)) {
+        logf("RunGoldenRenderTest: failed to create '%s'\n", goldenDir);
+        return;
+    }
+
+    GoldenTestData td;
+    td.files = &files;
+    td.goldenDir = goldenDir;
+    td.update = flags->goldenUpdate;
+    td.outcomes = new GoldenFileOutcome[nFiles];
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, MAX_RENDER_THREADS);
+    nThreads = limitValue(nThreads, 1, nFiles);
+    auto t = TimeGet();
+    if (nThreads < 2) {
+        GoldenTestThread(&td);
+    } else {
+        HANDLE threads[MAX_RENDER_THREADS];
+        for (int i = 0; i < nThreads; i++) {
+            threads[i] = StartThread(MkFunc0(GoldenTestThread, &td), "GoldenTestThread");
+        }
+        WaitForMultipleObjects((DWORD)nThreads, threads, TRUE, INFINITE);
+        for (int i = 0; i < nThreads; i++) {
+            CloseHandle(threads[i]);
+        }
+    }
+    double durMs = TimeSinceInMs(t);
+
+    int nPages = 0, nPixelDiffs = 0, nPerceptualOk = 0, nTimingDeltas = 0, nCreated = 0, nFailed = 0;
+    for (int i = 0; i < nFiles; i++) {
+        GoldenFileOutcome& res = td.outcomes[i];
+        if (res.log.size() > 0) {
+            logf("%s", res.log.Get());
+        }
+        nPages += res.nPages;
+        nPixelDiffs += res.nPixelDiffs;
+        nPerceptualOk += res.nPerceptualOk;
+        nTimingDeltas += res.nTimingDeltas;
+        nCreated += res.created ? 1 : 0;
+        nFailed += res.failed ? 1 : 0;
+    }
+    logf("RunGoldenRenderTest: %d file(s), %d page(s) in %.2f ms on %d thread(s): %d pixel diff(s), %d within "
+         "tolerance, %d timing delta(s), %d golden(s) created, %d failed\n",
+         nFiles, nPages, durMs, nThreads, nPixelDiffs, nPerceptualOk, nTimingDeltas, nCreated, nFailed);
+    delete[] td.outcomes;
+}
+
 static bool IsStressTestSupportedFile(const char* filePath, const char* filter) {
     if (filter && !path::Match(path::GetBaseNameTemp(filePath), filter)) {
         return false;
@@ -859,6 +1313,181 @@ void GetStressTestInfo(str::Str* s) {
     }
 }
 
+// ----- isolated multi-process stress testing -----
+//
+// with -stress-isolated every file is rendered by a worker process of
+// its own, up to -n of them at a time, so a crashing or hanging file
+// kills only its worker and the run continues. Files whose worker
+// crashed or hung are appended to a persistent blacklist which later
+// runs skip
+
+// set (via inherited environment) for the processes RunIsolatedStressTest
+// launches; a crashing worker must exit silently with a recognizable
+// code instead of showing crash UI, see CrashHandler.cpp
+constexpr const char* kStressWorkerEnvVar = "SUMATRAPDF_STRESS_WORKER";
+
+bool IsStressWorkerProcess() {
+    return GetEnvironmentVariableA(kStressWorkerEnvVar, nullptr, 0) != 0;
+}
+
+constexpr DWORD kStressWorkerTimeoutInMs = 2 * 60 * 1000;
+
+static TempStr GetStressBlacklistPathTemp() {
+    return GetPathInAppDataDirTemp("stress-blacklist.txt");
+}
+
+static void AppendToStressBlacklist(const char* filePath) {
+    TempStr path = GetStressBlacklistPathTemp();
+    str::Str s;
+    ByteSlice prev = file::ReadFile(path);
+    if (!prev.empty()) {
+        s.Append((const char*)prev.data(), (int)prev.size());
+    }
+    prev.Free();
+    s.Append(filePath);
+    s.Append("\r\n");
+    file::WriteFile(path, {(u8*)s.Get(), s.size()});
+}
+
+struct StressWorkerSlot {
+    HANDLE process = nullptr;
+    // owned by the file list in RunIsolatedStressTest
+    const char* filePath = nullptr;
+    LARGE_INTEGER started{};
+};
+
+static HANDLE StartStressWorkerProcess(Flags* flags, const char* filePath) {
+    TempStr exePath = GetSelfExePathTemp();
+    TempStr cmd = str::FormatTemp("\"%s\" -stress-test \"%s\" %dx -exit-when-done", exePath, filePath,
+                                  flags->stressTestCycles);
+    return LaunchProcessInDir(cmd, nullptr, 0);
+}
+
+int RunIsolatedStressTest(Flags* flags) {
+    const char* path = flags->stressTestPath;
+    StrVec files;
+    if (path::IsDirectory(path)) {
+        printf("Scanning for files in directory %s\n", path);
+        fflush(stdout);
+        auto di = DirIter{path};
+        di.recurse = true;
+        for (DirIterEntry* de : di) {
+            if (IsStressTestSupportedFile(de->filePath, flags->stressTestFilter)) {
+                files.Append(de->filePath);
+            }
+            if (flags->stressTestMax > 0 && files.Size() >= flags->stressTestMax) {
+                break;
+            }
+        }
+    } else if (file::Exists(path)) {
+        files.Append(path);
+    }
+
+    StrVec blacklist;
+    {
+        ByteSlice d = file::ReadFile(GetStressBlacklistPathTemp());
+        if (!d.empty()) {
+            Split(&blacklist, (const char*)d.data(), "\r\n", true);
+        }
+        d.Free();
+    }
+
+    StrVec todo;
+    int nSkipped = 0;
+    for (char* f : files) {
+        if (blacklist.Contains(f)) {
+            nSkipped++;
+        } else {
+            todo.Append(f);
+        }
+    }
+
+    int nWorkers = limitValue(flags->stressParallelCount, 1, 64);
+    logf("RunIsolatedStressTest: %d files (%d blacklisted), %d worker processes\n", todo.Size(), nSkipped, nWorkers);
+
+    // workers inherit this and suppress crash UI / report upload
+    SetEnvironmentVariableA(kStressWorkerEnvVar, "1");
+
+    StressWorkerSlot* slots = AllocArray<StressWorkerSlot>(nWorkers);
+    int nextFile = 0;
+    int nOk = 0, nFailed = 0, nCrashed = 0, nHung = 0;
+    auto timeStart = TimeGet();
+    for (;;) {
+        // fill free slots
+        for (int i = 0; i < nWorkers; i++) {
+            if (slots[i].process || nextFile >= todo.Size()) {
+                continue;
+            }
+            const char* f = todo.At(nextFile++);
+            HANDLE h = StartStressWorkerProcess(flags, f);
+            if (!h) {
+                logf("RunIsolatedStressTest: failed to launch worker for '%s'\n", f);
+                nFailed++;
+                i--; // try the next file in this slot
+                continue;
+            }
+            slots[i].process = h;
+            slots[i].filePath = f;
+            slots[i].started = TimeGet();
+        }
+
+        HANDLE active[64];
+        int nActive = 0;
+        for (int i = 0; i < nWorkers; i++) {
+            if (slots[i].process) {
+                active[nActive++] = slots[i].process;
+            }
+        }
+        if (nActive == 0) {
+            break;
+        }
+        WaitForMultipleObjects(nActive, active, FALSE, 1000);
+
+        for (int i = 0; i < nWorkers; i++) {
+            StressWorkerSlot* slot = &slots[i];
+            if (!slot->process) {
+                continue;
+            }
+            if (WaitForSingleObject(slot->process, 0) == WAIT_OBJECT_0) {
+                DWORD code = 1;
+                GetExitCodeProcess(slot->process, &code);
+                if (code == 0) {
+                    nOk++;
+                } else if (code == kStressWorkerCrashExitCode || code >= 0xC0000000) {
+                    logf("RunIsolatedStressTest: '%s' crashed (0x%x), blacklisting\n", slot->filePath, (uint)code);
+                    AppendToStressBlacklist(slot->filePath);
+                    nCrashed++;
+                } else {
+                    nFailed++;
+                }
+            } else if (TimeSinceInMs(slot->started) > (double)kStressWorkerTimeoutInMs) {
+                logf("RunIsolatedStressTest: '%s' hung, killing worker and blacklisting\n", slot->filePath);
+                TerminateProcess(slot->process, 1);
+                WaitForSingleObject(slot->process, 10 * 1000);
+                AppendToStressBlacklist(slot->filePath);
+                nHung++;
+            } else {
+                continue;
+            }
+            CloseHandle(slot->process);
+            slot->process = nullptr;
+            slot->filePath = nullptr;
+        }
+    }
+    free(slots);
+
+    double secs = TimeSinceInMs(timeStart) / 1000.;
+    int nDone = nOk + nFailed + nCrashed + nHung;
+    double perSec = secs > 0 ? (double)nDone / secs : 0;
+    printf("Stress tested %d files in %.0f secs (%.2f files/sec): %d ok, %d failed, %d crashed, %d hung, %d "
+           "blacklisted earlier\n",
+           nDone, secs, perSec, nOk, nFailed, nCrashed, nHung, nSkipped);
+    fflush(stdout);
+    logf("RunIsolatedStressTest: %d files in %.0f secs (%.2f files/sec): %d ok, %d failed, %d crashed, %d hung\n",
+         nDone, secs, perSec, nOk, nFailed, nCrashed, nHung);
+    return (nFailed + nCrashed + nHung) > 0 ? 1 : 0;
+}
+
 void StartStressTest(Flags* i, MainWindow* win) {
     gIsStressTesting = true;
     // TODO: for now stress testing only supports the non-ebook ui
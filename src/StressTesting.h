@@ -5,7 +5,13 @@ struct Flags;
 struct MainWindow;
 
 void BenchFileOrDir(StrVec& pathsToBench);
+void RunBenchSuite(Flags* flags);
+void RunGoldenRenderTest(Flags* flags);
 bool IsStressTesting();
+// exit code of a stress worker process that crashed (see CrashHandler.cpp)
+constexpr DWORD kStressWorkerCrashExitCode = 0xDEAD;
+bool IsStressWorkerProcess();
+int RunIsolatedStressTest(Flags* flags);
 void StartStressTest(Flags* i, MainWindow* win);
 void OnStressTestTimer(MainWindow* win, int timerId);
 void FinishStressTest(MainWindow* win);
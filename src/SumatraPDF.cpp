@@ -20,8 +20,13 @@
 #include "utils/GdiPlusUtil.h"
 #include "utils/Archive.h"
 #include "utils/Timer.h"
+#include "utils/PerfTrace.h"
 #include "utils/LzmaSimpleArchive.h"
 
+// for GetProcessMemoryInfo() without linking against psapi.lib
+#define PSAPI_VERSION 2
+#include <psapi.h>
+
 #include "wingui/UIModels.h"
 #include "wingui/Layout.h"
 #include "wingui/WinGui.h"
@@ -48,6 +53,7 @@
 #include "MobiDoc.h"
 #include "DisplayModel.h"
 #include "FileHistory.h"
+#include "FzImgReader.h"
 #include "PdfSync.h"
 #include "RenderCache.h"
 #include "ProgressUpdateUI.h"
@@ -73,6 +79,7 @@
 #include "Menu.h"
 #include "Print.h"
 #include "SearchAndDDE.h"
+#include "SearchAllTabs.h"
 #include "Selection.h"
 #include "StressTesting.h"
 #include "HomePage.h"
@@ -80,6 +87,7 @@
 #include "SumatraProperties.h"
 #include "TableOfContents.h"
 #include "Tabs.h"
+#include "ThumbnailStrip.h"
 #include "Toolbar.h"
 #include "Translations.h"
 #include "uia/Provider.h"
@@ -100,6 +108,7 @@ constexpr const WCHAR* kSumatraWindowTitleW = L"SumatraPDF";
 // used to show it in debug, but is not very useful,
 // so always disable
 bool gShowFrameRate = false;
+bool gShowRenderStats = false;
 
 // in plugin mode, the window's frame isn't drawn and closing and
 // fullscreen are disabled, so that SumatraPDF can be displayed
@@ -165,6 +174,7 @@ void LoadArgs::SetFilePath(const char* path) {
 LoadArgs* LoadArgs::Clone() {
     LoadArgs* res = new LoadArgs(fileName, win);
     res->tabState = this->tabState;
+    res->loadedCb = this->loadedCb;
     return res;
 }
 
@@ -683,7 +693,8 @@ struct ControllerCallbackHandler : DocControllerCallback {
     void PageNoChanged(DocController* ctrl, int pageNo) override;
     void ZoomChanged(DocController* ctrl, float zoomVirtual) override;
     void UpdateScrollbars(Size canvas) override;
-    void RequestRendering(int pageNo) override;
+    void RequestRendering(int pageNo, RenderPriority priority) override;
+    void AdvanceRenderGeneration() override;
     void CleanUp(DisplayModel* dm) override;
     void RenderThumbnail(DisplayModel* dm, Size size, const OnBitmapRendered*) override;
     void GotoLink(IPageDestination* dest) override {
@@ -770,7 +781,7 @@ static void CreateThumbnailForFile(MainWindow* win, FileState* ds) {
 }
 
 /* Send the request to render a given page to a rendering thread */
-void ControllerCallbackHandler::RequestRendering(int pageNo) {
+void ControllerCallbackHandler::RequestRendering(int pageNo, RenderPriority priority) {
     ReportIf(!win->AsFixed());
     if (!win->AsFixed()) {
         return;
@@ -781,12 +792,19 @@ void ControllerCallbackHandler::RequestRendering(int pageNo) {
     // they'll be rendered directly in DrawDocument during
     // WM_PAINT on the UI thread
     if (dm->ShouldCacheRendering(pageNo)) {
-        gRenderCache->RequestRendering(dm, pageNo);
+        gRenderCache->RequestRendering(dm, pageNo, priority);
     }
 }
 
+void ControllerCallbackHandler::AdvanceRenderGeneration() {
+    gRenderCache->BumpRenderGeneration();
+}
+
 void ControllerCallbackHandler::CleanUp(DisplayModel* dm) {
     gRenderCache->CancelRendering(dm);
+    if (HasPermission(Perm::DiskAccess) && gGlobalPrefs->rememberOpenedFiles) {
+        gRenderCache->PersistWorkingSet(dm);
+    }
     gRenderCache->FreeForDisplayModel(dm);
 }
 
@@ -927,6 +945,7 @@ void ControllerCallbackHandler::PageNoChanged(DocController* ctrl, int pageNo) {
 
     UpdateTocSelection(win, pageNo);
     win->currPageNo = pageNo;
+    ThumbnailStripPageChanged(win, pageNo);
 
     NotificationWnd* wnd = GetNotificationForGroup(win->hwndCanvas, kNotifPageInfo);
     if (!wnd) {
@@ -1080,6 +1099,7 @@ static void UpdateUiForCurrentTab(MainWindow* win) {
 
     FindToggleMatchCase(win);
     UpdateFindbox(win);
+    UpdateThumbnailStrip(win);
 
     HwndSetText(win->hwndFrame, win->CurrentTab()->frameTitle);
 
@@ -1163,6 +1183,7 @@ static void ReplaceDocumentInCurrentTab(LoadArgs* args, DocController* ctrl, Fil
     }
 
     AbortFinding(args->win, true);
+    ClearDocumentSearchHits(args->win);
 
     DocController* prevCtrl = win->ctrl;
     tab->ctrl = ctrl;
@@ -1253,6 +1274,9 @@ static void ReplaceDocumentInCurrentTab(LoadArgs* args, DocController* ctrl, Fil
         // expose SyncTeX in the UI
         if (PDFSYNCERR_SUCCESS == res) {
             gGlobalPrefs->enableTeXEnhancements = true;
+            // parse the sync file now so that the first forward search
+            // DDE from an editor doesn't have to
+            win->AsFixed()->pdfSync->RebuildIndexAsync();
         }
     }
 
@@ -1294,6 +1318,10 @@ static void ReplaceDocumentInCurrentTab(LoadArgs* args, DocController* ctrl, Fil
         return;
     }
 
+    // flatten the ToC for the command palette now so that the first
+    // section search doesn't have to walk the tree
+    BuildTocFlatIndexAsync(win->CurrentTab());
+
     TempStr unsupported = win->ctrl->GetPropertyTemp(kPropUnsupportedFeatures);
     if (unsupported) {
         const char* s = _TRA("This document uses unsupported features (%s) and might not render properly");
@@ -1344,6 +1372,11 @@ void ReloadDocument(MainWindow* win, bool autoRefresh) {
             args.forceReuse = true;
             args.noSavePrefs = true;
             args.tabState = tab->tabState;
+            if (tab->preloadedEngine) {
+                // engine was built in the background during session restore
+                args.engine = tab->preloadedEngine;
+                tab->preloadedEngine = nullptr;
+            }
             LoadDocument(&args);
         }
         return;
@@ -1352,7 +1385,10 @@ void ReloadDocument(MainWindow* win, bool autoRefresh) {
     HwndPasswordUI pwdUI(win->hwndFrame);
     const char* path = tab->filePath;
     logfa("ReloadDocument: %s, auto refresh: %d\n", path, (int)autoRefresh);
-    DocController* ctrl = CreateControllerForEngineOrFile(nullptr, path, &pwdUI, win);
+    // engine built in the background by ReloadDocumentAsync (if any)
+    EngineBase* engine = tab->preloadedEngine;
+    tab->preloadedEngine = nullptr;
+    DocController* ctrl = CreateControllerForEngineOrFile(engine, path, &pwdUI, win);
     // We don't allow PDF-repair if it is an autorefresh because
     // a refresh event can occur before the file is finished being written,
     // in which case the repair could fail. Instead, if the file is broken,
@@ -1417,6 +1453,82 @@ void ReloadDocument(MainWindow* win, bool autoRefresh) {
     DeleteDisplayState(fs);
 }
 
+struct ReloadDocumentAsyncData {
+    char* path = nullptr;
+    MainWindow* win = nullptr;
+    bool autoRefresh = false;
+    EngineBase* engine = nullptr;
+    ~ReloadDocumentAsyncData() {
+        str::Free(path);
+    }
+};
+
+// runs on the UI thread: hand the engine built in the background to
+// ReloadDocument(), unless the tab went away while we were loading
+static void ReloadDocumentAsyncFinish(ReloadDocumentAsyncData* d) {
+    AutoDelete delData(d);
+    if (!IsMainWindowValid(d->win)) {
+        if (d->engine) {
+            d->engine->Release();
+        }
+        return;
+    }
+    WindowTab* tab = nullptr;
+    for (WindowTab* t : d->win->Tabs()) {
+        if (str::Eq(t->filePath, d->path)) {
+            tab = t;
+            break;
+        }
+    }
+    if (!tab) {
+        if (d->engine) {
+            d->engine->Release();
+        }
+        return;
+    }
+    if (d->engine) {
+        if (tab->preloadedEngine) {
+            tab->preloadedEngine->Release();
+        }
+        tab->preloadedEngine = d->engine;
+        d->engine = nullptr;
+    }
+    if (tab != d->win->CurrentTab()) {
+        // reload (with the engine we just built) when the user comes back
+        tab->reloadOnFocus = true;
+        return;
+    }
+    ReloadDocument(d->win, d->autoRefresh);
+}
+
+static void ReloadDocumentAsyncThread(ReloadDocumentAsyncData* d) {
+    // no PasswordUI: for password-protected documents engine creation
+    // fails here and ReloadDocument() puts up the password prompt
+    d->engine = CreateEngineFromFile(d->path, nullptr, gGlobalPrefs->chmUI.useFixedPageUI);
+    auto fn = MkFunc0(ReloadDocumentAsyncFinish, d);
+    uitask::Post(fn, "TaskReloadDocumentAsyncFinish");
+}
+
+// reloads the current tab's document without blocking the UI: the new
+// engine (for ebooks a full re-layout, e.g. after a font change) is
+// built on a background thread while the old pages stay on screen and
+// the swap happens on the UI thread once the engine is ready
+void ReloadDocumentAsync(MainWindow* win, bool autoRefresh) {
+    WindowTab* tab = win->CurrentTab();
+    if (!tab || tab->IsAboutTab() || !tab->IsDocLoaded() || tab->editAnnotsWindow) {
+        // the cases ReloadDocument() handles specially (lazy loading,
+        // annotation windows) stay on the synchronous path
+        ReloadDocument(win, autoRefresh);
+        return;
+    }
+    auto d = new ReloadDocumentAsyncData;
+    d->path = str::Dup(tab->filePath);
+    d->win = win;
+    d->autoRefresh = autoRefresh;
+    auto fn = MkFunc0(ReloadDocumentAsyncThread, d);
+    RunAsync(fn, "ReloadDocumentThread");
+}
+
 static void CreateSidebar(MainWindow* win) {
     {
         Splitter::CreateArgs args;
@@ -1527,6 +1639,7 @@ static MainWindow* CreateMainWindow() {
     CreateTabbar(win);
     CreateToolbar(win);
     CreateSidebar(win);
+    CreateThumbnailStrip(win);
     UpdateFindbox(win);
     if (CanAccessDisk() && !gPluginMode) {
         DragAcceptFiles(win->hwndCanvas, TRUE);
@@ -1546,6 +1659,9 @@ static MainWindow* CreateMainWindow() {
     // TODO: this is hackish. in general we should divorce
     // layout re-calculations from MainWindow and creation of windows
     win->UpdateCanvasSize();
+
+    // cheap no-op unless TabHibernationTimeoutInMin is set
+    SetTimer(win->hwndFrame, TAB_HIBERNATE_TIMER_ID, TAB_HIBERNATE_CHECK_DELAY_IN_MS, nullptr);
     return win;
 }
 
@@ -1565,17 +1681,22 @@ MainWindow* CreateAndShowMainWindow(SessionData* data) {
         // TODO: also restore data->sidebarDx
     }
 
-    if (WIN_STATE_FULLSCREEN == windowState || WIN_STATE_MAXIMIZED == windowState) {
-        ShowWindow(win->hwndFrame, SW_MAXIMIZE);
-    } else {
-        ShowWindow(win->hwndFrame, SW_SHOW);
+    // a pre-warmed instance (-preload) stays hidden until a document
+    // open is handed to it via DDE (see HandleOpenCmd)
+    bool showWin = !(gCli->preload && !data);
+    if (showWin) {
+        if (WIN_STATE_FULLSCREEN == windowState || WIN_STATE_MAXIMIZED == windowState) {
+            ShowWindow(win->hwndFrame, SW_MAXIMIZE);
+        } else {
+            ShowWindow(win->hwndFrame, SW_SHOW);
+        }
+        UpdateWindow(win->hwndFrame);
     }
-    UpdateWindow(win->hwndFrame);
 
     SetSidebarVisibility(win, false, gGlobalPrefs->showFavorites);
     ToolbarUpdateStateForWindow(win, true);
 
-    if (WIN_STATE_FULLSCREEN == windowState) {
+    if (showWin && WIN_STATE_FULLSCREEN == windowState) {
         EnterFullScreen(win);
     }
     return win;
@@ -1646,7 +1767,9 @@ static void RenameFileInHistory(const char* oldPath, const char* newPath) {
     }
     fs = gFileHistory.FindByName(oldPath, nullptr);
     if (fs) {
+        gFileHistory.PathIdxRemove(fs);
         SetFileStatePath(fs, newPath);
+        gFileHistory.PathIdxInsert(fs);
         // merge Frequently Read data, so that a file
         // doesn't accidentally vanish from there
         fs->isPinned = fs->isPinned || oldIsPinned;
@@ -1819,6 +1942,16 @@ MainWindow* LoadDocumentFinish(LoadArgs* args) {
         currTab->watcher = FileWatcherSubscribe(path, fn);
     }
 
+    // gather metadata in the background so that the Properties dialog
+    // opens instantly even for huge or damaged files
+    PrefetchDocProperties(currTab->AsFixed());
+
+    if (HasPermission(Perm::DiskAccess) && gGlobalPrefs->rememberOpenedFiles) {
+        // paint the previous session's viewport content while the
+        // first render is still in flight
+        gRenderCache->RestoreWorkingSet(currTab->AsFixed());
+    }
+
     if (gGlobalPrefs->rememberOpenedFiles) {
         ReportIf(!str::Eq(fullPath, path));
         FileState* ds = gFileHistory.MarkFileLoaded(fullPath);
@@ -1838,6 +1971,9 @@ MainWindow* LoadDocumentFinish(LoadArgs* args) {
         AddPathToRecentDocs(fullPath);
     }
 
+    if (args->loadedCb.IsValid()) {
+        args->loadedCb.Call();
+    }
     return win;
 }
 
@@ -1885,6 +2021,8 @@ static MainWindow* MaybeCreateWindowForFileLoad(LoadArgs* args) {
 struct LoadDocumentAsyncData {
     NotificationWnd* wndNotif = nullptr;
     LoadArgs* args = nullptr;
+    // matched against MainWindow::lastLoadToken when the load finishes
+    int loadToken = 0;
     LoadDocumentAsyncData() = default;
     ~LoadDocumentAsyncData() {
         delete args;
@@ -1895,11 +2033,30 @@ static void LoadDocumentAsyncFinish(LoadDocumentAsyncData* d) {
     AutoDelete delData(d);
 
     auto args = d->args;
-    RemoveNotification(d->wndNotif);
     MainWindow* win = args->win;
+    if (!IsMainWindowValid(win)) {
+        // the window was closed while we were loading
+        delete args->ctrl;
+        args->ctrl = nullptr;
+        return;
+    }
+    RemoveNotification(d->wndNotif);
+    if (d->loadToken && win->lastLoadToken != d->loadToken) {
+        // the user started replacing the current tab again before this
+        // load finished; drop the stale result
+        delete args->ctrl;
+        args->ctrl = nullptr;
+        if (args->loadedCb.IsValid()) {
+            args->loadedCb.Call();
+        }
+        return;
+    }
     const char* path = args->FilePath();
     if (!args->ctrl) {
         ShowErrorLoadingNotification(win, path, args->noSavePrefs);
+        if (args->loadedCb.IsValid()) {
+            args->loadedCb.Call();
+        }
         return;
     }
     args->activateExisting = false;
@@ -1924,7 +2081,7 @@ static void LoadDocumentAsync(LoadDocumentAsyncData* d) {
     gDangerousThreadCount.Dec();
 }
 
-void StartLoadDocument(LoadArgs* argsIn) {
+MainWindow* StartLoadDocument(LoadArgs* argsIn) {
     if (gCrashOnOpen) {
         log("LoadDocumentAsync: about to call CrashMe()\n");
         CrashMe();
@@ -1935,20 +2092,20 @@ void StartLoadDocument(LoadArgs* argsIn) {
     const char* path = argsIn->FilePath();
     if (failEarly) {
         ShowFileNotFound(win, path, argsIn->noSavePrefs);
-        return;
+        return nullptr;
     }
 
     if (argsIn->activateExisting) {
         MainWindow* existing = FindMainWindowByFile(path, true);
         if (existing) {
             existing->Focus();
-            return;
+            return existing;
         }
     }
 
     win = MaybeCreateWindowForFileLoad(argsIn);
     if (!win) {
-        return;
+        return nullptr;
     }
 
     auto wndNotif = ShowLoadingNotif(win, path);
@@ -1971,20 +2128,26 @@ void StartLoadDocument(LoadArgs* argsIn) {
             if (!args->ctrl) {
                 ShowErrorLoadingNotification(win, path, args->noSavePrefs);
                 delete args;
-                return;
+                return win;
             }
             args->activateExisting = false;
             LoadDocumentFinish(args);
             delete args;
-            return;
+            return win;
         }
     }
 
     auto data = new LoadDocumentAsyncData;
     data->wndNotif = wndNotif;
     data->args = args;
+    if (args->forceReuse) {
+        // loads into new tabs can complete in any order, but loads that
+        // replace the current tab supersede each other
+        data->loadToken = ++win->lastLoadToken;
+    }
     auto fn = MkFunc0<LoadDocumentAsyncData>(LoadDocumentAsync, data);
     RunAsync(fn, "LoadDocumentThread");
+    return win;
 }
 
 // remember which files failed to open so that a failure to
@@ -2020,6 +2183,11 @@ MainWindow* LoadDocument(LoadArgs* args) {
     if (!win) {
         return nullptr;
     }
+    if (args->forceReuse) {
+        // a synchronous load supersedes any in-flight async load into
+        // the same tab
+        win->lastLoadToken++;
+    }
 
     auto timeStart = TimeGet();
     HwndPasswordUI pwdUI(win->hwndFrame);
@@ -2052,8 +2220,10 @@ void LoadModelIntoTab(WindowTab* tab) {
         return;
     }
 
+    tab->lastActiveTime = GetTickCount();
     MainWindow* win = tab->win;
-    if (gGlobalPrefs->lazyLoading && win->ctrl && !tab->ctrl && !tab->IsAboutTab()) {
+    bool loadOnSelect = gGlobalPrefs->lazyLoading || tab->tabState;
+    if (loadOnSelect && win->ctrl && !tab->ctrl && !tab->IsAboutTab()) {
         NotificationCreateArgs args;
         args.hwndParent = win->hwndCanvas;
         args.msg = str::FormatTemp(_TRA("Please wait - loading..."));
@@ -2107,7 +2277,7 @@ void LoadModelIntoTab(WindowTab* tab) {
 
     HwndSetFocus(win->hwndFrame);
     if (!tab->IsAboutTab()) {
-        if (gGlobalPrefs->lazyLoading && !tab->ctrl) {
+        if (loadOnSelect && !tab->ctrl) {
             ReloadDocument(win, false);
         } else {
             if (tab->reloadOnFocus) {
@@ -2119,6 +2289,71 @@ void LoadModelIntoTab(WindowTab* tab) {
     win->RedrawAll(true);
 }
 
+// free the engine, render cache entries and text cache of a long-idle
+// background tab. Scroll / zoom / toc state is snapshotted into
+// tab->tabState so that selecting the tab again restores it
+// transparently via ReloadDocument() (same as lazy loading)
+static void HibernateTab(WindowTab* tab) {
+    MainWindow* win = tab->win;
+    ReportIf(tab == win->CurrentTab());
+    ReportIf(tab->tabState);
+    logf("HibernateTab: '%s'\n", tab->filePath);
+
+    FileState* fs = NewDisplayState(tab->filePath);
+    tab->ctrl->GetDisplayState(fs);
+    fs->showToc = tab->showToc;
+    *fs->tocState = tab->tocState;
+    tab->tabState = NewTabState(fs);
+    DeleteDisplayState(fs);
+
+    FileWatcherUnsubscribe(tab->watcher);
+    tab->watcher = nullptr;
+    if (gMostRecentlyOpenedDoc == tab->ctrl) {
+        gMostRecentlyOpenedDoc = nullptr;
+    }
+    tab->selectedAnnotation = nullptr;
+    tab->currToc = nullptr;
+    delete tab->selectionOnPage;
+    tab->selectionOnPage = nullptr;
+    FlushDelayedClipboard(tab);
+    // DisplayModel destructor drops RenderCache entries (CleanUp) and
+    // deletes the text cache, then releases the engine
+    delete tab->ctrl;
+    tab->ctrl = nullptr;
+}
+
+static void HibernateIdleTabs(MainWindow* win) {
+    int timeoutInMin = gGlobalPrefs->tabHibernationTimeoutInMin;
+    if (timeoutInMin <= 0 || gPluginMode) {
+        return;
+    }
+    DWORD now = GetTickCount();
+    DWORD timeoutInMs = (DWORD)timeoutInMin * 60 * 1000;
+    for (WindowTab* tab : win->Tabs()) {
+        if (tab == win->CurrentTab()) {
+            tab->lastActiveTime = now;
+            continue;
+        }
+        if (!tab->lastActiveTime) {
+            // tab pre-dates hibernation being enabled; start counting now
+            tab->lastActiveTime = now;
+            continue;
+        }
+        if (now - tab->lastActiveTime < timeoutInMs) {
+            continue;
+        }
+        // only fixed-page documents; chm keeps hwnd state we'd lose
+        if (!tab->ctrl || !tab->AsFixed() || tab->editAnnotsWindow) {
+            continue;
+        }
+        // don't throw away unsaved annotations
+        if (EngineHasUnsavedAnnotations(tab->GetEngine())) {
+            continue;
+        }
+        HibernateTab(tab);
+    }
+}
+
 enum class MeasurementUnit { pt, mm, in };
 
 static TempStr FormatCursorPositionTemp(EngineBase* engine, PointF pt, MeasurementUnit unit) {
@@ -2196,6 +2431,32 @@ void MainWindowRerender(MainWindow* win, bool includeNonClientArea) {
     }
 }
 
+// re-render a single page of the document currently displayed in this
+// window, keeping cached bitmaps of all the other pages. used after
+// editing an annotation so that e.g. dragging a highlight doesn't
+// queue a re-render of every cached page
+void MainWindowRerenderPage(MainWindow* win, int pageNo, const RectF* changedRect) {
+    DisplayModel* dm = win->AsFixed();
+    if (!dm) {
+        return;
+    }
+    if (!dm->ValidPageNo(pageNo)) {
+        MainWindowRerender(win);
+        return;
+    }
+    if (changedRect && gRenderCache->RerenderRect(dm, pageNo, *changedRect)) {
+        // the cached bitmaps were patched in place
+        win->RedrawAll(true);
+        return;
+    }
+    // invalidate all tiles of the page: an annotation edit can change
+    // pixels outside the annotation's current rect (e.g. its old
+    // position after a move)
+    RectF mediabox = dm->GetEngine()->PageMediabox(pageNo);
+    gRenderCache->Invalidate(dm, pageNo, mediabox);
+    win->RedrawAll(true);
+}
+
 static void RerenderEverything() {
     for (auto* win : gWindows) {
         MainWindowRerender(win);
@@ -2221,6 +2482,14 @@ void UpdateDocumentColors() {
 
     gRenderCache->textColor = text;
     gRenderCache->backgroundColor = bg;
+    // remap the cached bitmaps in place: toggling between light and dark
+    // document colors then only repaints instead of re-rendering
+    if (gRenderCache->RemapCachedColors(text, bg)) {
+        for (auto* win : gWindows) {
+            win->RedrawAll(true);
+        }
+        return;
+    }
     RerenderEverything();
 }
 
@@ -2245,6 +2514,10 @@ void UpdateFixedPageScrollbarsVisibility() {
     RerenderFixedPage();
 }
 
+// set while OnMenuExit() closes the windows: a -preload instance hides
+// on its last window instead of quitting, but an explicit Exit quits
+static bool gExplicitQuit = false;
+
 static void OnMenuExit() {
     if (gPluginMode) {
         return;
@@ -2255,6 +2528,7 @@ static void OnMenuExit() {
             return;
         }
     }
+    gExplicitQuit = true;
 
     // we want to preserve the session state of all windows,
     // so we save it now
@@ -2288,6 +2562,7 @@ static void CloseDocumentInCurrentTab(MainWindow* win, bool keepUIEnabled, bool
     win->annotationUnderCursor = nullptr;
 
     win->fwdSearchMark.show = false;
+    ClearDocumentSearchHits(win);
     if (win->uiaProvider) {
         win->uiaProvider->OnDocumentUnload();
     }
@@ -2298,6 +2573,7 @@ static void CloseDocumentInCurrentTab(MainWindow* win, bool keepUIEnabled, bool
     }
     if (deleteModel) {
         if (currentTab) {
+            FlushDelayedClipboard(currentTab);
             delete currentTab->ctrl;
             currentTab->ctrl = nullptr;
             FileWatcherUnsubscribe(currentTab->watcher);
@@ -2748,10 +3024,16 @@ void CloseWindow(MainWindow* win, bool quitIfLast, bool forceClose) {
     }
 
     bool lastWindow = (1 == gWindows.size());
+    // a pre-warmed instance (-preload) goes back to waiting hidden when
+    // its last window closes, so the next Explorer open is warm too
+    bool hideInsteadOfQuit = lastWindow && quitIfLast && !forceClose && gCli->preload && !gExplicitQuit;
+    if (hideInsteadOfQuit) {
+        quitIfLast = false;
+    }
     // RememberDefaultWindowPosition becomes a no-op once the window is hidden
     RememberDefaultWindowPosition(win);
     // hide the window before saving prefs (closing seems slightly faster that way)
-    if (!lastWindow || quitIfLast) {
+    if (!lastWindow || quitIfLast || hideInsteadOfQuit) {
         ShowWindow(win->hwndFrame, SW_HIDE);
     }
     SaveSettings();
@@ -2825,6 +3107,120 @@ static bool AppendFileFilterForDoc(DocController* ctrl, str::Str& fileFilter) {
     return true;
 }
 
+// above this size Save As copies the file on a background thread so
+// that the UI doesn't freeze for the duration of the copy
+constexpr i64 kSaveAsAsyncCopyThreshold = 8 * 1024 * 1024;
+
+struct SaveAsCopyData {
+    MainWindow* win = nullptr;
+    NotificationWnd* wnd = nullptr;
+    AutoFreeStr srcPath;
+    AutoFreeStr dstPath;
+    bool setZoneIdentifier = false;
+    // set from the UI thread when the notification is closed, checked
+    // by CopyFileExW after every copied block
+    BOOL cancel = FALSE;
+    int lastPerc = -1; // only accessed on the copy thread
+    bool ok = false;
+    DWORD lastError = 0;
+};
+
+struct SaveAsProgressData {
+    SaveAsCopyData* d = nullptr;
+    int perc = 0;
+};
+
+static void UpdateSaveAsProgress(SaveAsProgressData* u) {
+    SaveAsCopyData* d = u->d;
+    if (d->wnd) {
+        TempStr msg = str::FormatTemp(_TRA("Saving '%s'..."), path::GetBaseNameTemp(d->dstPath));
+        UpdateNotificationProgress(d->wnd, msg, u->perc);
+    }
+    delete u;
+}
+
+static void SaveAsNotifRemoved(SaveAsCopyData* d, NotificationWnd*) {
+    d->wnd = nullptr;
+    d->cancel = TRUE;
+}
+
+static DWORD CALLBACK SaveAsCopyProgressCb(LARGE_INTEGER totalFileSize, LARGE_INTEGER totalBytesTransferred,
+                                           LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID param) {
+    SaveAsCopyData* d = (SaveAsCopyData*)param;
+    int perc = CalcPerc((int)(totalBytesTransferred.QuadPart >> 10), (int)(totalFileSize.QuadPart >> 10));
+    if (perc == d->lastPerc) {
+        return PROGRESS_CONTINUE;
+    }
+    d->lastPerc = perc;
+    auto u = new SaveAsProgressData;
+    u->d = d;
+    u->perc = perc;
+    auto fn = MkFunc0<SaveAsProgressData>(UpdateSaveAsProgress, u);
+    uitask::Post(fn, "TaskSaveAsUpdateProgress");
+    return PROGRESS_CONTINUE;
+}
+
+static void SaveAsCopyDone(SaveAsCopyData* d) {
+    if (d->wnd) {
+        RemoveNotification(d->wnd); // also sets d->cancel via SaveAsNotifRemoved, harmless now
+    }
+    if (d->ok) {
+        // Make sure that the copy isn't write-locked or hidden
+        const DWORD attributesToDrop = FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM;
+        DWORD attributes = file::GetAttributes(d->dstPath);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & attributesToDrop)) {
+            file::SetAttributes(d->dstPath, attributes & ~attributesToDrop);
+        }
+        if (d->setZoneIdentifier) {
+            file::SetZoneIdentifier(d->dstPath);
+        }
+    } else if (d->lastError != ERROR_REQUEST_ABORTED) {
+        TempStr msg = (TempStr)_TRA("Failed to save a file");
+        TempStr errStr = GetLastErrorStrTemp(d->lastError);
+        if (str::Leni(errStr) > 0) {
+            msg = str::FormatTemp("%s\n\n%s", msg, errStr);
+        }
+        logf("SaveAsCopyDone() failed with '%s'\n", msg);
+        HWND hwndParent = IsMainWindowValid(d->win) ? d->win->hwndFrame : nullptr;
+        MessageBoxWarning(hwndParent, msg);
+    }
+    delete d;
+}
+
+static void SaveAsCopyThread(SaveAsCopyData* d) {
+    WCHAR* src = ToWStrTemp(d->srcPath);
+    WCHAR* dst = ToWStrTemp(d->dstPath);
+    BOOL res = CopyFileExW(src, dst, SaveAsCopyProgressCb, d, &d->cancel, 0);
+    d->ok = res != 0;
+    if (!res) {
+        d->lastError = GetLastError();
+        // remove a partial copy (CopyFileExW doesn't always do it itself)
+        file::Delete(d->dstPath);
+    }
+    auto fn = MkFunc0(SaveAsCopyDone, d);
+    uitask::Post(fn, "TaskSaveAsCopyDone");
+}
+
+static void StartSaveAsCopyThread(MainWindow* win, const char* srcPath, const char* dstPath, bool setZoneIdentifier) {
+    auto d = new SaveAsCopyData;
+    d->win = win;
+    d->srcPath.SetCopy(srcPath);
+    d->dstPath.SetCopy(dstPath);
+    d->setZoneIdentifier = setZoneIdentifier;
+
+    NotificationCreateArgs args;
+    args.hwndParent = win->hwndCanvas;
+    args.timeoutMs = 0;
+    args.msg = str::FormatTemp(_TRA("Saving '%s'..."), path::GetBaseNameTemp(dstPath));
+    args.onRemoved = MkFunc1(SaveAsNotifRemoved, d);
+    // no groupId so that saving doesn't replace other notifications
+    args.groupId = nullptr;
+    d->wnd = ShowNotification(args);
+
+    auto fn = MkFunc0(SaveAsCopyThread, d);
+    RunAsync(fn, "SaveAsCopyThread");
+}
+
 static void SaveCurrentFileAs(MainWindow* win) {
     if (!CanAccessDisk()) {
         return;
@@ -2930,6 +3326,13 @@ static void SaveCurrentFileAs(MainWindow* win) {
         logf("calling engine->SaveFileAs(%s)\n", realDstFileName);
         ok = engine->SaveFileAs(realDstFileName);
     } else if (!path::IsSame(srcFileName, realDstFileName)) {
+        if (file::GetSize(srcFileName) >= kSaveAsAsyncCopyThreshold) {
+            // the copy of a large file runs in the background with a
+            // progress notification; errors are reported from there
+            bool setZone = IsUntrustedFile(ctrl->GetFilePath(), gPluginURL);
+            StartSaveAsCopyThread(win, srcFileName, realDstFileName, setZone);
+            return;
+        }
         ok = file::Copy(realDstFileName, srcFileName, false);
         if (ok) {
             // Make sure that the copy isn't write-locked or hidden
@@ -3330,7 +3733,7 @@ static void OpenFile(MainWindow* win) {
     GetFilesFromGetOpenFileName(&ofn, files);
     for (char* path : files) {
         LoadArgs args(path, win);
-        LoadDocument(&args);
+        StartLoadDocument(&args);
     }
 }
 
@@ -3543,6 +3946,15 @@ static void RelayoutFrame(MainWindow* win, bool updateToolbars = true, int sideb
         rc.dx -= toc.dx + kSplitterDx;
     }
 
+    // thumbnail strip between the sidebar and the canvas
+    int thumbsDx = GetThumbnailStripDx(win);
+    if (thumbsDx > 0) {
+        Rect rThumbs(rc.x, rc.y, thumbsDx, rc.dy);
+        dh.MoveWindow(win->thumbnailStrip->hwnd, rThumbs);
+        rc.x += thumbsDx;
+        rc.dx -= thumbsDx;
+    }
+
     dh.MoveWindow(win->hwndCanvas, rc);
 
     dh.End();
@@ -4374,7 +4786,14 @@ Annotation* MakeAnnotationsFromSelection(WindowTab* tab, AnnotCreateArgs* args)
         CopySelectionToClipboard(win);
     }
     DeleteOldSelectionInfo(win, true);
-    MainWindowRerender(win);
+    if (annot && pageNos.Size() == 1) {
+        // a freshly created annotation only changes pixels inside its bounds
+        MainWindowRerenderPage(win, pageNos.at(0), &annot->bounds);
+    } else {
+        for (auto pageNo : pageNos) {
+            MainWindowRerenderPage(win, pageNo);
+        }
+    }
     ToolbarUpdateStateForWindow(win, true);
     return annot;
 }
@@ -4808,7 +5227,7 @@ void ReopenLastClosedFile(MainWindow* win) {
         return;
     }
     LoadArgs args(path, win);
-    LoadDocument(&args);
+    StartLoadDocument(&args);
 }
 
 void CopyFilePath(WindowTab* tab) {
@@ -4888,7 +5307,20 @@ void ClearHistory(MainWindow* win) {
     data->win = win;
     data->nFiles = nFiles;
     auto fn = MkFunc0<ClearHistoryData>(ClearHistoryAsync, data);
-    RunAsync(fn, "ClearHistoryAsync");
+    RunAsync(fn, "ClearHistoryAsync", ThreadQoS::Background);
+}
+
+static void CompactHistory(MainWindow* win) {
+    if (!win) {
+        return;
+    }
+    int nPruned = CompactFileHistory();
+    if (nPruned > 0) {
+        SaveSettings();
+        CleanUpThumbnailCache();
+    }
+    TempStr msg = str::FormatTemp(_TRA("Removed %d files from history."), nPruned);
+    ShowTemporaryNotification(win->hwndCanvas, msg, kNotif5SecsTimeOut);
 }
 
 static void TogglePredictiveRender(MainWindow* win) {
@@ -4900,6 +5332,68 @@ static void TogglePredictiveRender(MainWindow* win) {
     ShowNotification(args);
 }
 
+static void TogglePerfTrace(MainWindow* win) {
+    NotificationCreateArgs args;
+    args.hwndParent = win->hwndCanvas;
+    args.timeoutMs = 3000;
+    if (!gPerfTraceEnabled) {
+        PerfTraceStart();
+        args.msg = "Started perf trace";
+        ShowNotification(args);
+        return;
+    }
+    PerfTraceStop();
+    TempStr path = path::JoinTemp(GetTempDirTemp(), "sumatra-perf-trace.json");
+    bool ok = PerfTraceSaveToFile(path);
+    if (ok) {
+        args.msg = str::FormatTemp("Saved perf trace to '%s'\nOpen it in chrome://tracing", path);
+    } else {
+        args.msg = str::FormatTemp("Failed to save perf trace to '%s'", path);
+        args.warning = true;
+    }
+    args.timeoutMs = kNotif5SecsTimeOut;
+    ShowNotification(args);
+}
+
+// answers "why is SumatraPDF using this much memory": live byte counts
+// of the major subsystems, shown in a notification and logged so that
+// it also shows up with -console and in Show Logs
+static void ShowMemoryUsage(MainWindow* win) {
+    str::Str s;
+    PROCESS_MEMORY_COUNTERS pmc{};
+    pmc.cb = sizeof(pmc);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        s.AppendFmt("working set: %s\n", str::FormatFileSizeTemp((i64)pmc.WorkingSetSize));
+    }
+    s.AppendFmt("mupdf: %s\n", str::FormatFileSizeTemp(fz_allocated_bytes()));
+    s.AppendFmt("bitmap cache: %s in %d bitmaps\n", str::FormatFileSizeTemp((i64)gRenderCache->cacheBytes),
+                gRenderCache->cacheCount);
+    s.AppendFmt("compressed bitmaps: %s in %d entries\n", str::FormatFileSizeTemp((i64)gRenderCache->compressedBytes),
+                gRenderCache->compressedCount);
+    i64 textCacheBytes = 0;
+    int nDocs = 0;
+    for (MainWindow* w : gWindows) {
+        for (WindowTab* tab : w->Tabs()) {
+            DisplayModel* dm = tab->AsFixed();
+            if (dm && dm->textCache) {
+                textCacheBytes += (i64)dm->textCache->debugSize;
+            }
+            if (tab->ctrl) {
+                nDocs++;
+            }
+        }
+    }
+    s.AppendFmt("text cache: %s in %d documents\n", str::FormatFileSizeTemp(textCacheBytes), nDocs);
+    s.AppendFmt("file history: %d entries", gFileHistory.states->Size());
+    logf("Memory usage:\n%s\n", s.Get());
+
+    NotificationCreateArgs args;
+    args.hwndParent = win->hwndCanvas;
+    args.msg = s.Get();
+    args.timeoutMs = kNotif5SecsTimeOut;
+    ShowNotification(args);
+}
+
 static void DownloadDebugSymbols() {
     TempStr msg = (TempStr) "Symbols were already downloaded";
 
@@ -5107,7 +5601,7 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             FileState* state = gFileHistory.Get(idx);
             if (state) {
                 LoadArgs args(state->filePath, win);
-                LoadDocument(&args);
+                StartLoadDocument(&args);
             }
             return 0;
         }
@@ -5261,6 +5755,10 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             ClearHistory(win);
             break;
 
+        case CmdCompactHistory:
+            CompactHistory(win);
+            break;
+
         case CmdReopenLastClosedFile:
             ReopenLastClosedFile(win);
             break;
@@ -5317,7 +5815,7 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             break;
 
         case CmdReloadDocument:
-            ReloadDocument(win, false);
+            ReloadDocumentAsync(win, false);
             break;
 
         case CmdCreateShortcutToFile:
@@ -5437,6 +5935,10 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             ToggleTocBox(win);
             break;
 
+        case CmdToggleThumbnailStrip:
+            ToggleThumbnailStrip(win);
+            break;
+
         case CmdScrollUpHalfPage: {
             if (!win->IsDocLoaded()) {
                 return 0;
@@ -5612,6 +6114,10 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             FindToggleMatchCase(win);
             break;
 
+        case CmdFindAllTabs:
+            RunSearchAllTabs(win);
+            break;
+
         case CmdFindNextSel:
             FindSelection(win, TextSearch::Direction::Forward);
             break;
@@ -5704,6 +6210,10 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             CopySelectionInTabToClipboard(tab);
             break;
 
+        case CmdSaveSelectionAsImage:
+            SaveSelectionToImageFile(win);
+            break;
+
         case CmdSelectAll:
             OnSelectAll(win);
             break;
@@ -5718,10 +6228,26 @@ static LRESULT FrameOnCommand(MainWindow* win, HWND hwnd, UINT msg, WPARAM wp, L
             DownloadDebugSymbols();
             break;
 
+        case CmdDebugShowMemoryUsage:
+            ShowMemoryUsage(win);
+            break;
+
+        case CmdDebugTogglePerfTrace:
+            TogglePerfTrace(win);
+            break;
+
         case CmdDebugTogglePredictiveRender:
             TogglePredictiveRender(win);
             break;
 
+        case CmdDebugToggleRenderStats:
+            gShowRenderStats = !gShowRenderStats;
+            if (gShowRenderStats) {
+                gRenderCache->ResetStats();
+            }
+            ScheduleRepaint(win, 0);
+            break;
+
         case CmdToggleLinks:
             gGlobalPrefs->showLinks = !gGlobalPrefs->showLinks;
             for (auto& w : gWindows) {
@@ -6204,7 +6730,7 @@ LRESULT CALLBACK WndProcSumatraFrame(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
 
         case WM_ENDSESSION:
             // TODO: check for unfinished print jobs in WM_QUERYENDSESSION?
-            SaveSettings();
+            FlushSettings();
             gDontSaveSettings = true;
             if (wp == TRUE) {
                 // we must quit so that we restore opened files on start.
@@ -6225,8 +6751,25 @@ LRESULT CALLBACK WndProcSumatraFrame(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
         case WM_COPYDATA:
             return OnCopyData(hwnd, wp, lp);
 
+        // large text selections are copied with delayed rendering and
+        // only extracted when pasted (see Selection.cpp)
+        case WM_RENDERFORMAT:
+            RenderDelayedClipboardFormat((UINT)wp);
+            return 0;
+        case WM_RENDERALLFORMATS:
+            RenderAllDelayedClipboardFormats(hwnd);
+            return 0;
+        case WM_DESTROYCLIPBOARD:
+            DropDelayedClipboardData();
+            return 0;
+
         case WM_TIMER:
-            if (win && win->stressTest) {
+            if (win && wp == TAB_HIBERNATE_TIMER_ID) {
+                HibernateIdleTabs(win);
+            } else if (win && wp == UPDATE_CHECK_TIMER_ID) {
+                KillTimer(hwnd, UPDATE_CHECK_TIMER_ID);
+                StartAsyncUpdateCheck(win, UpdateCheck::Automatic);
+            } else if (win && win->stressTest) {
                 OnStressTestTimer(win, (int)wp);
             }
             break;
@@ -6298,6 +6841,217 @@ void GetProgramInfo(str::Str& s) {
     }
 }
 
+// don't start speculative work until the user has been inactive this long
+constexpr DWORD kIdlePrerenderDelayInMs = 500;
+// cap per position so that a link-heavy page doesn't flood the render queue
+constexpr int kMaxIdlePrerenderPages = 4;
+
+static bool IsUserIdle() {
+    LASTINPUTINFO lii{};
+    lii.cbSize = sizeof(lii);
+    if (!GetLastInputInfo(&lii)) {
+        return false;
+    }
+    return GetTickCount() - lii.dwTime >= kIdlePrerenderDelayInMs;
+}
+
+static void AppendPrerenderTarget(Vec<int>& targets, DisplayModel* dm, int pageNo) {
+    if (pageNo <= 0 || pageNo > dm->PageCount()) {
+        return;
+    }
+    // pages near the viewport are already covered by predictive rendering
+    if (dm->PageVisibleNearby(pageNo)) {
+        return;
+    }
+    if (targets.Contains(pageNo)) {
+        return;
+    }
+    targets.Append(pageNo);
+}
+
+// one unit of idle work: queue speculative renders for one window's
+// current position, at most once per position. The likely jump targets
+// are the destinations of links on the visible pages and the beginning
+// of the next ToC section
+static bool QueueIdlePrerender(MainWindow* win) {
+    DisplayModel* dm = win->AsFixed();
+    WindowTab* tab = win->CurrentTab();
+    if (!dm || !tab || dm->dontRenderFlag) {
+        return false;
+    }
+    int currPageNo = dm->CurrentPageNo();
+    if (tab->idlePrerenderPageNo == currPageNo) {
+        return false;
+    }
+    tab->idlePrerenderPageNo = currPageNo;
+
+    // collect all link destinations on the visible pages and count how
+    // many links point at each: in cross-reference heavy documents the
+    // same target (a definitions or references section) is linked over
+    // and over, so the count is a good predictor of where the next jump
+    // goes and decides which targets get the few prerender slots
+    Vec<int> linkPages;
+    Vec<int> linkCounts;
+    EngineBase* engine = dm->GetEngine();
+    int nPages = dm->PageCount();
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        if (!dm->PageVisible(pageNo)) {
+            continue;
+        }
+        Vec<IPageElement*> els = engine->GetElements(pageNo);
+        for (IPageElement* el : els) {
+            if (!el->Is(kindPageElementDest)) {
+                continue;
+            }
+            int destPageNo = PageDestGetPageNo(el->AsLink());
+            if (destPageNo <= 0 || destPageNo > nPages) {
+                continue;
+            }
+            // pages near the viewport are already covered by predictive rendering
+            if (dm->PageVisibleNearby(destPageNo)) {
+                continue;
+            }
+            int idx = linkPages.Find(destPageNo);
+            if (idx < 0) {
+                linkPages.Append(destPageNo);
+                linkCounts.Append(1);
+            } else {
+                linkCounts.At(idx)++;
+            }
+        }
+    }
+
+    Vec<int> targets;
+    while (targets.Size() < kMaxIdlePrerenderPages && linkPages.Size() > 0) {
+        int best = 0;
+        for (int i = 1; i < linkPages.Size(); i++) {
+            if (linkCounts.At(i) > linkCounts.At(best)) {
+                best = i;
+            }
+        }
+        targets.Append(linkPages.At(best));
+        linkPages.RemoveAt(best);
+        linkCounts.RemoveAt(best);
+    }
+    TocFlatIndex* idx = tab->tocFlatIndex;
+    if (idx) {
+        int n = idx->pages.Size();
+        for (int i = 0; i < n; i++) {
+            if (idx->pages.At(i) > currPageNo) {
+                AppendPrerenderTarget(targets, dm, idx->pages.At(i));
+                break;
+            }
+        }
+    }
+    for (int pageNo : targets) {
+        dm->cb->RequestRendering(pageNo, RenderPriority::Speculative);
+    }
+    return targets.Size() > 0;
+}
+
+// upper bound of preview renders queued per idle unit; tiny bitmaps,
+// but they go through the same render queue as real pages
+constexpr int kMaxIdlePreviewPages = 2;
+
+// data for one idle preview render, see QueueIdlePreviewRender
+struct PreviewRenderData {
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    int rotation = 0;
+    const OnBitmapRendered* self = nullptr;
+};
+
+// called on a render thread; bmp is nullptr if rendering failed or
+// was aborted
+static void PreviewRenderedOnThread(PreviewRenderData* d, RenderedBitmap* bmp) {
+    if (bmp) {
+        gRenderCache->AddPreview(d->dm, d->pageNo, d->rotation, bmp);
+    }
+    delete d->self;
+    delete d;
+}
+
+// one unit of idle work: queue renders for the next few missing
+// scrollbar-scrubbing previews (see RenderCache::PaintPreview), from
+// the front of the document towards the back
+static bool QueueIdlePreviewRender(MainWindow* win) {
+    DisplayModel* dm = win->AsFixed();
+    WindowTab* tab = win->CurrentTab();
+    if (!dm || !tab || dm->dontRenderFlag) {
+        return false;
+    }
+    EngineBase* engine = dm->GetEngine();
+    int rotation = dm->GetRotation();
+    if (tab->idlePreviewRotation != rotation) {
+        // previews are per rotation; start over after a rotation change
+        tab->idlePreviewRotation = rotation;
+        tab->idlePreviewPageNo = 0;
+    }
+    int nPages = dm->PageCount();
+    int nQueued = 0;
+    for (int pageNo = tab->idlePreviewPageNo + 1; pageNo <= nPages; pageNo++) {
+        if (nQueued >= kMaxIdlePreviewPages || gRenderCache->IsRenderQueueFull()) {
+            break;
+        }
+        tab->idlePreviewPageNo = pageNo;
+        if (gRenderCache->HasPreview(dm, pageNo, rotation)) {
+            continue;
+        }
+        RectF pageRect = engine->PageMediabox(pageNo);
+        if (pageRect.IsEmpty()) {
+            continue;
+        }
+        SizeF size = engine->Transform(pageRect, pageNo, 1.0f, rotation).Size();
+        float zoom = (float)kPreviewMaxDim / std::max(size.dx, size.dy);
+        auto d = new PreviewRenderData;
+        d->dm = dm;
+        d->pageNo = pageNo;
+        d->rotation = rotation;
+        d->self = NewFunc1(PreviewRenderedOnThread, d);
+        bool ok = gRenderCache->Render(dm, pageNo, rotation, zoom, nullptr, &pageRect, d->self,
+                                       RenderPriority::Thumbnail);
+        if (!ok) {
+            delete d->self;
+            delete d;
+            break;
+        }
+        nQueued++;
+    }
+    return nQueued > 0;
+}
+
+// the message loop calls this when the message queue is empty. The render
+// threads drop to background priority for speculative requests and the
+// bitmaps only occupy spare cache capacity, so a hit makes the jump
+// instant and a miss costs nothing the user can notice. Returns true if
+// some work was done (i.e. call again while still idle), false if the
+// loop should block waiting for the next message
+bool OnMessageLoopIdle() {
+    // never compete with user interaction
+    if (!IsUserIdle()) {
+        return false;
+    }
+    // speculative rendering is the first thing to go on machines that
+    // are tight on memory
+    if (IsLowMemoryMode()) {
+        return false;
+    }
+    for (MainWindow* win : gWindows) {
+        if (!win->IsDocLoaded()) {
+            continue;
+        }
+        if (QueueIdlePrerender(win)) {
+            // one small unit per call so that a message arriving mid-work
+            // is delayed by at most a single window's pass
+            return true;
+        }
+        if (QueueIdlePreviewRender(win)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool CrashHandlerCanUseNet() {
     return HasPermission(Perm::InternetAccess);
 }
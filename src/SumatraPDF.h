@@ -27,6 +27,15 @@ constexpr int kHideCursorDelayInMs = 3000;
 #define AUTO_RELOAD_TIMER_ID 5
 #define AUTO_RELOAD_DELAY_IN_MS 100
 
+// set on hwndFrame; checks for long-idle tabs to hibernate
+#define TAB_HIBERNATE_TIMER_ID 7
+#define TAB_HIBERNATE_CHECK_DELAY_IN_MS (60 * 1000)
+
+// set on hwndFrame; delays the automatic update check so that it never
+// competes with startup and first interaction for network and CPU
+#define UPDATE_CHECK_TIMER_ID 8
+#define UPDATE_CHECK_DELAY_IN_MS (10 * 1000)
+
 // permissions that can be revoked through sumatrapdfrestrict.ini or the -restrict command line flag
 enum class Perm : uint {
     // enables Update checks, crash report submitting and hyperlinks
@@ -84,6 +93,7 @@ struct Flags;
 // all defined in SumatraPDF.cpp
 extern Flags* gCli;
 extern bool gShowFrameRate;
+extern bool gShowRenderStats;
 
 extern const char* gPluginURL;
 extern Favorites gFavorites;
@@ -122,6 +132,7 @@ void UpdateDocumentColors();
 void UpdateFixedPageScrollbarsVisibility();
 void UpdateTabFileDisplayStateForTab(WindowTab* tab);
 void ReloadDocument(MainWindow* win, bool autoRefresh);
+void ReloadDocumentAsync(MainWindow* win, bool autoRefresh);
 void ToggleFullScreen(MainWindow* win, bool presentation = false);
 void RelayoutWindow(MainWindow* win);
 void DuplicateTabInNewWindow(WindowTab* tab);
@@ -173,6 +184,10 @@ struct LoadArgs {
 
     TabState* tabState = nullptr;
 
+    // called on the UI thread once the load attempt completed, even if
+    // it failed; not called if the window goes away first
+    Func0 loadedCb;
+
   private:
     AutoFreeStr fileName;
 };
@@ -181,7 +196,7 @@ struct PasswordUI;
 
 MainWindow* LoadDocument(LoadArgs* args);
 MainWindow* LoadDocumentFinish(LoadArgs* args);
-void StartLoadDocument(LoadArgs* args);
+MainWindow* StartLoadDocument(LoadArgs* args);
 MainWindow* CreateAndShowMainWindow(SessionData* data = nullptr);
 DocController* CreateControllerForEngineOrFile(EngineBase* engine, const char* path, PasswordUI* pwdUI,
                                                MainWindow* win);
@@ -196,7 +211,12 @@ void RebuildMenuBarForWindow(MainWindow* win);
 void DeleteMainWindow(MainWindow* win);
 void SwitchToDisplayMode(MainWindow* win, DisplayMode displayMode, bool keepContinuous = false);
 void MainWindowRerender(MainWindow* win, bool includeNonClientArea = false);
+// changedRect (in page coordinates) enables patching just that part of
+// the page's cached bitmaps instead of fully re-rendering them
+void MainWindowRerenderPage(MainWindow* win, int pageNo, const RectF* changedRect = nullptr);
+void OnStartupBenchFirstPaint(MainWindow* win);
 LRESULT CALLBACK WndProcSumatraFrame(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp);
+bool OnMessageLoopIdle();
 void ShutdownCleanup();
 bool DocIsSupportedFileType(Kind);
 TempStr GetLogFilePathTemp();
@@ -5,6 +5,9 @@
 #include "utils/StrFormat.h"
 #include "utils/ScopedWin.h"
 #include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/Timer.h"
+#include "utils/UITask.h"
 #include "utils/WinUtil.h"
 
 #include "wingui/UIModels.h"
@@ -30,6 +33,8 @@
 #include "Print.h"
 #include "Theme.h"
 
+#include "utils/Log.h"
+
 void ShowProperties(HWND parent, DocController* ctrl, bool extended);
 
 constexpr const WCHAR* kPropertiesWinClassName = L"SUMATRA_PDF_PROPERTIES";
@@ -480,6 +485,101 @@ static const char* propToName[] = {
 };
 // clang-format on
 
+/* Background prefetch of document properties.
+
+Extracting metadata (and especially the font list) can stall on huge or
+damaged files, so it's done once on a background thread right after a
+document finished loading. The results are kept per file path; the
+Properties dialog and other metadata consumers read them through
+GetCachedDocPropertyTemp() on the UI thread and only fall back to asking
+the engine when no prefetch ran for the document. */
+
+struct DocPropsCacheEntry {
+    // only set while the prefetch thread runs, keeps the engine alive
+    EngineBase* engine = nullptr;
+    char* filePath = nullptr;
+    Props props;
+
+    ~DocPropsCacheEntry() {
+        str::Free(filePath);
+    }
+};
+
+constexpr int kMaxDocPropsCacheEntries = 32;
+
+// most recently prefetched last; only accessed on the UI thread
+static Vec<DocPropsCacheEntry*> gDocPropsCache;
+
+static DocPropsCacheEntry* FindCachedDocProps(const char* path) {
+    for (auto e : gDocPropsCache) {
+        if (str::EqI(e->filePath, path)) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+static void DocPropsPrefetchFinish(DocPropsCacheEntry* e) {
+    e->engine->Release();
+    e->engine = nullptr;
+    // replace a previous entry for this file (e.g. after a reload)
+    DocPropsCacheEntry* prev = FindCachedDocProps(e->filePath);
+    if (prev) {
+        gDocPropsCache.Remove(prev);
+        delete prev;
+    }
+    if (gDocPropsCache.Size() >= kMaxDocPropsCacheEntries) {
+        delete gDocPropsCache.at(0);
+        gDocPropsCache.RemoveAt(0);
+    }
+    gDocPropsCache.Append(e);
+}
+
+static void DocPropsPrefetchThread(DocPropsCacheEntry* e) {
+    auto timeStart = TimeGet();
+    for (const char** name = gAllProps; *name; name++) {
+        TempStr val = e->engine->GetPropertyTemp(*name);
+        if (val) {
+            AddProp(e->props, *name, val);
+        }
+    }
+    logf("DocPropsPrefetchThread: '%s' in %.2f ms\n", e->filePath, (float)TimeSinceInMs(timeStart));
+    auto fn = MkFunc0(DocPropsPrefetchFinish, e);
+    uitask::Post(fn, "TaskDocPropsPrefetch");
+    DestroyTempAllocator();
+}
+
+void PrefetchDocProperties(DisplayModel* dm) {
+    if (!dm) {
+        return;
+    }
+    auto e = new DocPropsCacheEntry;
+    e->engine = dm->GetEngine();
+    e->engine->AddRef();
+    e->filePath = str::Dup(e->engine->FilePath());
+    auto fn = MkFunc0(DocPropsPrefetchThread, e);
+    RunAsync(fn, "DocPropsPrefetchThread", ThreadQoS::Background);
+}
+
+TempStr GetCachedDocPropertyTemp(const char* path, const char* name) {
+    DocPropsCacheEntry* e = path ? FindCachedDocProps(path) : nullptr;
+    if (!e) {
+        return nullptr;
+    }
+    return GetPropValueTemp(e->props, name);
+}
+
+// prefers the prefetched values; they are authoritative once present
+// (a missing prop then means the document doesn't have it), so that the
+// dialog never repeats a slow extraction the prefetch already did
+static TempStr GetPropTemp(DocController* ctrl, const char* name) {
+    DocPropsCacheEntry* e = FindCachedDocProps(ctrl->GetFilePath());
+    if (e) {
+        return GetPropValueTemp(e->props, name);
+    }
+    return ctrl->GetPropertyTemp(name);
+}
+
 static void AddPropTranslated(PropertiesLayout* layoutData, const char* propName, const char* val) {
     const char* s = GetMatchingString(propToName, propName);
     ReportIf(!s);
@@ -488,12 +588,12 @@ static void AddPropTranslated(PropertiesLayout* layoutData, const char* propName
 }
 
 static void AddPropTranslated(DocController* ctrl, PropertiesLayout* layoutData, const char* propName) {
-    TempStr val = ctrl->GetPropertyTemp(propName);
+    TempStr val = GetPropTemp(ctrl, propName);
     AddPropTranslated(layoutData, propName, val);
 }
 
 static void AddPdfFileStructure(DocController* ctrl, PropertiesLayout* layoutData) {
-    TempStr fstruct = ctrl->GetPropertyTemp(kPropPdfFileStructure);
+    TempStr fstruct = GetPropTemp(ctrl, kPropPdfFileStructure);
     if (str::IsEmpty(fstruct)) {
         bool isPDF = str::EndsWithI(ctrl->GetFilePath(), ".pdf");
         if (isPDF) {
@@ -561,7 +661,7 @@ static void GetProps(DocController* ctrl, PropertiesLayout* layoutData, bool ext
     AddPropTranslated(ctrl, layoutData, kPropAuthor);
     AddPropTranslated(ctrl, layoutData, kPropCopyright);
 
-    TempStr val = ctrl->GetPropertyTemp(kPropCreationDate);
+    TempStr val = GetPropTemp(ctrl, kPropCreationDate);
     if (val && dm && kindEngineMupdf == dm->engineType) {
         strTemp = ConvDateToDisplayTemp(val, PdfDateParseA);
     } else {
@@ -569,7 +669,7 @@ static void GetProps(DocController* ctrl, PropertiesLayout* layoutData, bool ext
     }
     layoutData->AddProperty(_TRA("Created:"), strTemp);
 
-    val = ctrl->GetPropertyTemp(kPropModificationDate);
+    val = GetPropTemp(ctrl, kPropModificationDate);
     if (val && dm && kindEngineMupdf == dm->engineType) {
         strTemp = ConvDateToDisplayTemp(val, PdfDateParseA);
     } else {
@@ -600,8 +700,8 @@ static void GetProps(DocController* ctrl, PropertiesLayout* layoutData, bool ext
     layoutData->AddProperty(_TRA("Denied Permissions:"), strTemp);
 
     if (extended) {
-        // Note: FontList extraction can take a while
-        val = ctrl->GetPropertyTemp(kPropFontList);
+        // Note: FontList extraction can take a while when not prefetched
+        val = GetPropTemp(ctrl, kPropFontList);
         if (val) {
             // add a space between basic and extended file properties
             layoutData->AddProperty(" ", " ");
@@ -2,7 +2,15 @@
    License: GPLv3 */
 
 struct PropertiesLayout;
+struct DisplayModel;
 
 void ShowProperties(HWND parent, DocController* ctrl, bool extended);
+// gathers the document's properties on a background thread so that the
+// Properties dialog (and other metadata consumers) don't have to block
+// on the engine; called once the document finished loading
+void PrefetchDocProperties(DisplayModel* dm);
+// a property gathered by PrefetchDocProperties or nullptr if it wasn't
+// (yet); only call on the UI thread
+TempStr GetCachedDocPropertyTemp(const char* path, const char* name);
 void DeletePropertiesWindow(HWND hwndParent);
 PropertiesLayout* FindPropertyWindowByHwnd(HWND hwnd);
@@ -15,6 +15,7 @@
 #include "mui/Mui.h"
 #include "utils/SquareTreeParser.h"
 #include "utils/ThreadUtil.h"
+#include "utils/Timer.h"
 #include "utils/UITask.h"
 #include "utils/WinUtil.h"
 
@@ -22,6 +23,7 @@
 
 #include "wingui/UIModels.h"
 #include "wingui/Layout.h"
+#include "wingui/FrameBudget.h"
 #include "wingui/WinGui.h"
 
 #include "Settings.h"
@@ -33,6 +35,7 @@
 #include "FileHistory.h"
 #include "GlobalPrefs.h"
 #include "Accelerators.h"
+#include "Ocr.h"
 #include "PdfSync.h"
 #include "RenderCache.h"
 #include "ProgressUpdateUI.h"
@@ -52,6 +55,8 @@
 #include "Caption.h"
 #include "CrashHandler.h"
 #include "FileThumbnails.h"
+#include "FullTextIndex.h"
+#include "InputReplay.h"
 #include "Print.h"
 #include "SearchAndDDE.h"
 #include "Selection.h"
@@ -223,24 +228,12 @@ static void MaybeStartSearch(MainWindow* win, const char* searchTerm) {
     FindTextOnThread(win, TextSearch::Direction::Forward, searchTerm, wasModified, showProgress);
 }
 
-static MainWindow* LoadOnStartup(const char* filePath, const Flags& flags, bool isFirstWin) {
-    LoadArgs args(filePath, nullptr);
-    args.showWin = !(flags.printDialog && flags.exitWhenDone) && !gPluginMode;
-    MainWindow* win = LoadDocument(&args);
-    if (!win) {
-        return win;
-    }
-
-    if (isFirstWin) {
-        MaybeGoTo(win, flags.destName, flags.pageNumber);
-    }
-
-    bool ok = MaybeMakePluginWindow(win, flags.hwndPluginParent);
-    if (!ok) {
-        return nullptr;
-    }
-    if (!win->IsDocLoaded() || !isFirstWin) {
-        return win;
+// state from the command line that can only be applied once the
+// document finished loading
+static void ApplyFlagsAfterLoad(MainWindow* win, const Flags& flags) {
+    MaybeGoTo(win, flags.destName, flags.pageNumber);
+    if (!win->IsDocLoaded()) {
+        return;
     }
     FlagsEnterFullscreen(flags, win);
     if (flags.startView != DisplayMode::Automatic) {
@@ -264,6 +257,63 @@ static MainWindow* LoadOnStartup(const char* filePath, const Flags& flags, bool
         ShowForwardSearchResult(win, srcPath, flags.forwardSearchLine, 0, ret, page, rects);
     }
     MaybeStartSearch(win, flags.search);
+}
+
+struct StartupLoadData {
+    MainWindow* win = nullptr;
+    const Flags* flags = nullptr;
+};
+
+static void ApplyFlagsAfterLoadCb(StartupLoadData* d) {
+    AutoDelete delData(d);
+    if (!IsMainWindowValid(d->win)) {
+        return;
+    }
+    ApplyFlagsAfterLoad(d->win, *d->flags);
+}
+
+static MainWindow* LoadOnStartup(const char* filePath, const Flags& flags, bool isFirstWin) {
+    LoadArgs args(filePath, nullptr);
+    args.showWin = !(flags.printDialog && flags.exitWhenDone) && !gPluginMode;
+    // when opening multiple files only the first is fully loaded; the rest
+    // become background tabs that just remember the path and build their
+    // engine when the tab is selected, like session-restored tabs
+    args.lazyLoad = gGlobalPrefs->lazyLoading && gGlobalPrefs->useTabs && !isFirstWin && !flags.printDialog &&
+                    !flags.printerName && !gPluginMode;
+
+    // printing and plugin mode need the loaded document before this
+    // function returns; everything else loads the engine on the loader
+    // thread so that the frame is created, painted and responsive
+    // right away instead of waiting out the document I/O
+    bool mustLoadSync = flags.printDialog || flags.printerName || gPluginMode || args.lazyLoad;
+    if (!mustLoadSync) {
+        if (isFirstWin) {
+            // flags outlives the message loop (it's owned by WinMain)
+            StartupLoadData* d = new StartupLoadData;
+            d->flags = &flags;
+            args.loadedCb = MkFunc0(ApplyFlagsAfterLoadCb, d);
+            MainWindow* win = StartLoadDocument(&args);
+            d->win = win;
+            if (!win) {
+                delete d;
+            }
+            return win;
+        }
+        return StartLoadDocument(&args);
+    }
+
+    MainWindow* win = LoadDocument(&args);
+    if (!win) {
+        return win;
+    }
+
+    bool ok = MaybeMakePluginWindow(win, flags.hwndPluginParent);
+    if (!ok) {
+        return nullptr;
+    }
+    if (isFirstWin) {
+        ApplyFlagsAfterLoad(win, flags);
+    }
     return win;
 }
 
@@ -334,6 +384,87 @@ static void RestoreTabOnStartup(MainWindow* win, TabState* state, bool lazyLoad
     }
 }
 
+struct SessionPreloadData {
+    StrVec paths;
+    AtomicInt nextIdx;
+    AtomicInt activeThreads;
+};
+
+struct SessionPreloadResult {
+    char* path = nullptr;
+    EngineBase* engine = nullptr;
+    ~SessionPreloadResult() {
+        str::Free(path);
+    }
+};
+
+// runs on the UI thread: hand a preloaded engine to its tab, unless the
+// user got there first (or closed the tab) while we were loading
+static void SessionPreloadAttach(SessionPreloadResult* res) {
+    AutoDelete delRes(res);
+    WindowTab* tab = FindTabByFile(res->path);
+    if (!tab || tab->ctrl || tab->preloadedEngine) {
+        res->engine->Release();
+        return;
+    }
+    logf("SessionPreloadAttach: preloaded engine for '%s'\n", res->path);
+    tab->preloadedEngine = res->engine;
+}
+
+static void SessionPreloadThread(SessionPreloadData* d) {
+    for (;;) {
+        int i = d->nextIdx.Inc() - 1;
+        if (i >= d->paths.Size()) {
+            break;
+        }
+        const char* path = d->paths.At(i);
+        // no PasswordUI: password-protected documents are skipped here
+        // and load normally (with the password prompt) when activated
+        EngineBase* engine = CreateEngineFromFile(path, nullptr, false);
+        if (!engine) {
+            continue;
+        }
+        auto res = new SessionPreloadResult;
+        res->path = str::Dup(path);
+        res->engine = engine;
+        auto fn = MkFunc0(SessionPreloadAttach, res);
+        uitask::Post(fn, "TaskSessionPreloadAttach");
+    }
+    if (d->activeThreads.Dec() == 0) {
+        delete d;
+    }
+}
+
+// constructs engines for restored tabs the user hasn't activated yet on
+// a small pool of low-priority threads, so that switching to such a tab
+// doesn't have to parse the document from scratch. The focused tab was
+// already loaded synchronously and rendering still only happens when a
+// tab is activated
+static void StartSessionEnginePreload(StrVec& paths) {
+    if (paths.Size() == 0) {
+        return;
+    }
+    auto d = new SessionPreloadData;
+    d->paths = paths;
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, 4);
+    if (nThreads > paths.Size()) {
+        nThreads = paths.Size();
+    }
+    d->activeThreads.Set(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        auto fn = MkFunc0(SessionPreloadThread, d);
+        HANDLE hThread = StartThread(fn, "SessionPreloadThread");
+        if (hThread) {
+            SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);
+            CloseHandle(hThread);
+        } else if (d->activeThreads.Dec() == 0) {
+            delete d;
+        }
+    }
+}
+
 static bool SetupPluginMode(Flags& i) {
     if (!IsWindow(i.hwndPluginParent) || i.fileNames.Size() == 0) {
         return false;
@@ -501,7 +632,21 @@ static int RunMessageLoop() {
     HWND hwndDialog;
     HWND hwndAccel;
 
-    while (GetMessage(&msg, nullptr, 0, 0)) {
+    for (;;) {
+        while (!PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            // the queue is empty: spend the time on deferred work, one
+            // small unit at a time, and only block waiting for the next
+            // message once there's nothing left to do
+            if (!OnMessageLoopIdle()) {
+                WaitMessage();
+            }
+        }
+        if (WM_QUIT == msg.message) {
+            break;
+        }
+        if (IsRecordingInput()) {
+            RecordInputMessage(msg);
+        }
         if (PreTranslateMessage(msg)) {
             continue;
         }
@@ -525,8 +670,10 @@ static int RunMessageLoop() {
             // DbgLogMsg("dialog: ", msg.hwnd, msg.message, msg.wParam, msg.lParam);
             continue;
         }
+        FrameBudgetMsgBegin(&msg);
         TranslateMessage(&msg);
         DispatchMessage(&msg);
+        FrameBudgetMsgEnd();
         ResetTempAllocator();
     }
 
@@ -877,7 +1024,75 @@ void StartDeleteStaleFiles() {
     TempStr ver = GetVerDirNameTemp("");
     logf("DeleteStaleFiles: dir: '%s', gIsPreRelaseBuild: %d, ver: %s\n", dir, (int)gIsPreReleaseBuild, ver);
     auto fn = MkFunc0Void(DeleteStaleFilesAsync);
-    RunAsync(fn, "DeleteStaleFilesThread");
+    RunAsync(fn, "DeleteStaleFilesThread", ThreadQoS::Background);
+}
+
+// files we'll open shortly, gathered before windows are created so that
+// the prefetch thread can overlap disk latency with the rest of init
+static StrVec gFilesToPrefetch;
+
+// pull the head and the tail of a file into the OS cache. Readers touch
+// both ends first (header and styles vs. the xref / central directory),
+// the rest is demand-paged as pages render
+static void PrefetchFile(const char* path) {
+    constexpr DWORD kPrefetchHead = 256 * 1024;
+    constexpr DWORD kPrefetchTail = 64 * 1024;
+    HANDLE h = file::OpenReadOnly(path);
+    if (h == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    char* buf = AllocArray<char>(kPrefetchHead);
+    DWORD nRead = 0;
+    ReadFile(h, buf, kPrefetchHead, &nRead, nullptr);
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(h, &size) && size.QuadPart > (i64)(kPrefetchHead + kPrefetchTail)) {
+        LARGE_INTEGER pos{};
+        pos.QuadPart = size.QuadPart - (i64)kPrefetchTail;
+        if (SetFilePointerEx(h, pos, nullptr, FILE_BEGIN)) {
+            ReadFile(h, buf, kPrefetchTail, &nRead, nullptr);
+        }
+    }
+    free(buf);
+    CloseHandle(h);
+}
+
+static void PrefetchFilesAsync() {
+    for (char* path : gFilesToPrefetch) {
+        PrefetchFile(path);
+    }
+    gFilesToPrefetch.Reset();
+}
+
+// warm the OS cache for the documents we're about to load: files given
+// on the command line and the previous session's tabs. The reads run on
+// a background thread while we register window classes and create
+// windows, so a cold start doesn't serialize CPU init behind the disk
+static void StartSessionFilePrefetch(Flags& flags) {
+    constexpr int kMaxPrefetchFiles = 16;
+    for (char* path : flags.fileNames) {
+        if (gFilesToPrefetch.Size() >= kMaxPrefetchFiles) {
+            break;
+        }
+        gFilesToPrefetch.Append(path);
+    }
+    bool restoreSession = gGlobalPrefs->restoreSession && gGlobalPrefs->sessionData;
+    if (restoreSession) {
+        for (SessionData* data : *gGlobalPrefs->sessionData) {
+            for (TabState* state : *data->tabStates) {
+                if (gFilesToPrefetch.Size() >= kMaxPrefetchFiles) {
+                    break;
+                }
+                if (!str::IsEmpty(state->filePath) && !gFilesToPrefetch.Contains(state->filePath)) {
+                    gFilesToPrefetch.Append(state->filePath);
+                }
+            }
+        }
+    }
+    if (gFilesToPrefetch.Size() == 0) {
+        return;
+    }
+    auto fn = MkFunc0Void(PrefetchFilesAsync);
+    RunAsync(fn, "FilePrefetchThread", ThreadQoS::Utility);
 }
 
 // non-admin process cannot send DDE messages to admin process
@@ -929,8 +1144,47 @@ static void testLogf() {
 
 // in mupdf_load_system_font.c
 extern "C" void destroy_system_font_list();
+
+// logs how long each startup phase took so that we can see where
+// the time goes when startup gets slower (target: < 300 ms to first paint)
+static LARGE_INTEGER gStartupPhaseStarted;
+static double gStartupTotalMs = 0;
+
+static void LogStartupPhase(const char* name) {
+    double ms = TimeSinceInMs(gStartupPhaseStarted);
+    gStartupTotalMs += ms;
+    logfa("startup: %s: %.2f ms (total: %.2f ms)\n", name, ms, gStartupTotalMs);
+    gStartupPhaseStarted = TimeGet();
+}
 extern void DeleteManualBrowserWindow();
 
+static void StartupBenchDone(MainWindow* win) {
+    CloseWindow(win, true, true);
+}
+
+// -startup-bench handshake: Canvas.cpp calls this whenever a paint put
+// actual document content on screen. On the first such paint we write
+// the process-creation-to-now time to the given file and quit, so that
+// `doit.bat -bench-startup` (do/bench_startup.go) can launch us
+// repeatedly and report percentiles
+void OnStartupBenchFirstPaint(MainWindow* win) {
+    if (!gCli || !gCli->startupBenchOut) {
+        return;
+    }
+    static bool reported = false;
+    if (reported) {
+        return;
+    }
+    reported = true;
+    double ms = GetProcessRunningTime();
+    logfa("startup: first document paint %.2f ms after process creation\n", ms);
+    TempStr s = str::FormatTemp("%.2f\n", ms);
+    file::WriteFile(gCli->startupBenchOut, {(u8*)s, str::Len(s)});
+    // we're in the middle of WM_PAINT; close once the queue is drained
+    auto fn = MkFunc0(StartupBenchDone, win);
+    uitask::Post(fn, "TaskStartupBenchDone");
+}
+
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     int exitCode = 1; // by default it's error
     int nWithDde = 0;
@@ -945,6 +1199,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     Vec<SessionData*>* sessionData = nullptr;
 
     supressThrowFromNew();
+    gStartupPhaseStarted = TimeGet();
 
     InitDynCalls();
     NoDllHijacking();
@@ -964,11 +1219,14 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         SetupCrashHandler();
     }
 
+    LogStartupPhase("crash handler");
+
     ScopedOle ole;
     InitAllCommonControls();
     ScopedGdiPlus gdiPlus(true);
     mui::Initialize();
     uitask::Initialize();
+    LogStartupPhase("libraries");
 
     if (!IsDebuggerPresent()) {
         // VSCode shows both debugger output and console out which doubles the logging
@@ -976,9 +1234,15 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         gLogToConsole = true;
     }
 
+    // opt-in allocation instrumentation, reported at exit
+    if (GetEnvironmentVariableA("SUMATRAPDF_TRACK_ALLOCS", nullptr, 0)) {
+        StartTrackingAllocs();
+    }
+
     Flags flags;
     ParseFlags(GetCommandLineW(), flags);
     gCli = &flags;
+    LogStartupPhase("parse flags");
 
     CheckIsStoreBuild();
 
@@ -1132,6 +1396,12 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         return 0;
     }
 
+    if (flags.convertToPdf) {
+        void BatchConvertToPdf(const Flags& flags);
+        BatchConvertToPdf(flags);
+        return 0;
+    }
+
     if (flags.appdataDir) {
         SetAppDataDir(flags.appdataDir);
     }
@@ -1152,6 +1422,11 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     LoadSettings();
     UpdateGlobalPrefs(flags);
     SetCurrentLang(flags.lang ? flags.lang : gGlobalPrefs->uiLanguage);
+    LogStartupPhase("load settings");
+
+    if (CanAccessDisk() && !gPluginMode) {
+        StartSessionFilePrefetch(flags);
+    }
 
     if (flags.showConsole) {
         RedirectIOToConsole();
@@ -1161,6 +1436,24 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         BenchFileOrDir(flags.pathsToBenchmark);
     }
 
+    if (flags.benchSuitePath) {
+        RunBenchSuite(&flags);
+    }
+
+    if (flags.goldenPath) {
+        RunGoldenRenderTest(&flags);
+    }
+
+    if (flags.stressIsolated && flags.stressTestPath) {
+        exitCode = RunIsolatedStressTest(&flags);
+        goto Exit;
+    }
+
+    if (flags.genSymbolMapPath) {
+        exitCode = dbghelp::GenSymbolMap(flags.genSymbolMapPath) ? 0 : 1;
+        goto Exit;
+    }
+
     if (flags.exitImmediately) {
         goto Exit;
     }
@@ -1168,6 +1461,12 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     gCrashOnOpen = flags.crashOnOpen;
 
     gRenderCache->textColor = ThemeDocumentColors(gRenderCache->backgroundColor);
+    if (IsLowMemoryMode()) {
+        // smaller tiles keep individual bitmaps small so that the
+        // reduced cache budget still fits several of them
+        gRenderCache->maxTileSize.dx /= 2;
+        gRenderCache->maxTileSize.dy /= 2;
+    }
     // logfa("retrieved doc colors in WinMain: 0x%x 0x%x\n", gRenderCache->textColor, gRenderCache->backgroundColor);
 
     gIsStartup = true;
@@ -1178,6 +1477,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     if (!InstanceInit()) {
         goto Exit;
     }
+    LogStartupPhase("register classes");
 
     if (flags.hwndPluginParent) {
         // check early to avoid a crash in MakePluginWindow()
@@ -1204,12 +1504,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     if (flags.printerName) {
         // note: this prints all PDF files. Another option would be to
         // print only the first one
-        for (char* path : flags.fileNames) {
-            bool ok = PrintFile(path, flags.printerName, !flags.silent, flags.printSettings);
-            if (!ok) {
-                exitCode++;
-            }
-        }
+        exitCode += PrintFiles(flags.fileNames, flags.printerName, !flags.silent, flags.printSettings);
         --exitCode; // was 1 if no print failures, turn 1 into 0
         logf("Finished printing, exitCode: %d\n", exitCode);
         goto Exit;
@@ -1218,6 +1513,12 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     // only call FindPrevInstWindow() once
     existingInstanceHwnd = FindPrevInstWindow(&hMutex);
 
+    if (flags.preload && existingInstanceHwnd) {
+        // only one pre-warmed instance is needed and an already running
+        // SumatraPDF answers DDE opens just as fast
+        goto Exit;
+    }
+
     if (flags.printDialog || flags.stressTestPath || gPluginMode) {
         // TODO: pass print request through to previous instance?
     } else if (flags.reuseDdeInstance || flags.dde) {
@@ -1266,7 +1567,7 @@ ContinueOpenWindow:
     sessionData = gGlobalPrefs->sessionData;
     gGlobalPrefs->sessionData = new Vec<SessionData*>();
 
-    restoreSession = gGlobalPrefs->restoreSession && (sessionData->size() > 0) && !gPluginMode;
+    restoreSession = gGlobalPrefs->restoreSession && (sessionData->size() > 0) && !gPluginMode && !flags.preload;
     if (!gGlobalPrefs->useTabs && (existingInstanceHwnd != nullptr)) {
         // do not restore a session if tabs are disabled and SumatraPDF is already running
         // TODO: maybe disable restoring if tabs are disabled?
@@ -1301,6 +1602,19 @@ ContinueOpenWindow:
                 ReloadDocument(win, false);
             }
         }
+        if (gGlobalPrefs->lazyLoading) {
+            // the focused tab of each window loaded synchronously above;
+            // pre-build engines for the remaining tabs in the background
+            StrVec preloadPaths;
+            for (MainWindow* w : gWindows) {
+                for (WindowTab* tab : w->Tabs()) {
+                    if (tab->tabState && !tab->ctrl && !str::IsEmpty(tab->filePath)) {
+                        preloadPaths.Append(tab->filePath);
+                    }
+                }
+            }
+            StartSessionEnginePreload(preloadPaths);
+        }
     }
 
     for (const char* path : flags.fileNames) {
@@ -1348,7 +1662,19 @@ ContinueOpenWindow:
         gDdeOpenOnStartup.Reset();
     }
 
+    if (gGlobalPrefs->lazyLoading) {
+        // opening multiple files leaves the last one's tab selected but
+        // lazy-loaded; load it now so the window doesn't show up blank
+        for (MainWindow* w : gWindows) {
+            WindowTab* tab = w->CurrentTab();
+            if (tab && !tab->IsAboutTab() && !tab->IsDocLoaded()) {
+                ReloadDocument(w, false);
+            }
+        }
+    }
+
     gIsStartup = false;
+    LogStartupPhase("create windows");
 
     if (flags.fileNames.Size() > 0 && !win) {
         // failed to create any window, even though there
@@ -1376,10 +1702,20 @@ ContinueOpenWindow:
         StartStressTest(&flags, win);
     }
 
+    if (flags.recordInputPath) {
+        StartInputRecording(flags.recordInputPath);
+    } else if (flags.replayInputPath) {
+        StartInputReplay(flags.replayInputPath, win->hwndFrame, win->hwndCanvas);
+    }
+
     // only hide newly missing files when showing the start page on startup
     if (showStartPage && gFileHistory.Get(0)) {
         RemoveNonExistentFilesAsync();
     }
+    // apply the history retention policy in the background
+    VacuumFileHistoryAsync();
+    // bring the search-everywhere index up to date in the background
+    StartFullTextIndexing();
     // call this once it's clear whether Perm::SavePreferences has been granted
     RegisterSettingsForFileChanges();
 
@@ -1396,9 +1732,13 @@ ContinueOpenWindow:
     //  \Documents is a good directory to use
     ChangeCurrDirToDocuments();
 
-    StartAsyncUpdateCheck(win, UpdateCheck::Automatic);
+    // auto update check is delayed so that it doesn't slow down startup
+    // and first interaction (matters on slow / VPN-gated networks)
+    SetTimer(win->hwndFrame, UPDATE_CHECK_TIMER_ID, UPDATE_CHECK_DELAY_IN_MS, nullptr);
 
-    BringWindowToTop(win->hwndFrame);
+    if (!flags.preload) {
+        BringWindowToTop(win->hwndFrame);
+    }
 
     StartDeleteStaleFiles();
 
@@ -1408,7 +1748,13 @@ ContinueOpenWindow:
 
 Exit:
     logf("Exiting with exit code: %d\n", exitCode);
+    DumpAllocStats();
+    FrameBudgetLogStats();
+    // write out the last deferred settings save, which might still be
+    // waiting for its coalescing delay
+    FlushSettings();
     UnregisterSettingsForFileChanges();
+    ShutdownOcr();
 
     HandleRedirectedConsoleOnShutdown();
     DeleteManualBrowserWindow();
@@ -1459,6 +1805,9 @@ Exit:
 
     FreeAcceleratorTables();
 
+    StopInputReplay();
+    StopInputRecording();
+    StopFullTextIndexing();
     FileWatcherWaitForShutdown();
     delete gRenderCache;
     SaveCallstackLogs();
@@ -233,11 +233,57 @@ static void GoToTocTreeItem(MainWindow* win, TreeItem ti, bool allowExternal) {
     }
 }
 
+// hashes every item's title, page and tree position; detects on reload
+// whether the bookmarks actually changed (rebuilt LaTeX documents
+// mostly keep them identical)
+static u32 TocTreeFingerprint(TocItem* item, u32 h = 2166136261) {
+    for (; item; item = item->next) {
+        const char* title = item->title ? item->title : "";
+        for (const char* c = title; *c; c++) {
+            h = (h ^ (u8)*c) * 16777619; // FNV-1a
+        }
+        h = (h ^ (u32)item->pageNo) * 16777619;
+        if (item->child) {
+            h = (h ^ 0x9e) * 16777619; // make the tree shape part of the hash
+            h = TocTreeFingerprint(item->child, h);
+        }
+    }
+    return h;
+}
+
+static TocItem* FindTocItemById(TocItem* item, int id) {
+    for (; item; item = item->next) {
+        if (item->id == id) {
+            return item;
+        }
+        TocItem* res = FindTocItemById(item->child, id);
+        if (res) {
+            return res;
+        }
+    }
+    return nullptr;
+}
+
 void ClearTocBox(MainWindow* win) {
     if (!win->tocLoaded) {
         return;
     }
 
+    // remember what the tree looked like so that a reload which doesn't
+    // change the bookmarks can restore the scroll position in addition
+    // to the expansion state (see LoadTocTree)
+    WindowTab* tab = win->CurrentTab();
+    TocTree* tocTree = (TocTree*)win->tocTreeView->treeModel;
+    if (tab && tocTree && tocTree->root) {
+        tab->tocFingerprint = TocTreeFingerprint(tocTree->root);
+        tab->tocFirstVisibleId = 0;
+        HTREEITEM h = TreeView_GetFirstVisible(win->tocTreeView->hwnd);
+        TreeItem ti = h ? win->tocTreeView->GetTreeItemByHandle(h) : 0;
+        if (ti) {
+            tab->tocFirstVisibleId = ((TocItem*)ti)->id;
+        }
+    }
+
     win->tocTreeView->Clear();
 
     win->currPageNo = 0;
@@ -735,7 +781,22 @@ void LoadTocTree(MainWindow* win) {
     SetInitialExpandState(tocTree->root, tab->tocState);
     AutoExpandTopLevelItems(tocTree->root->child);
 
-    treeView->SetTreeModel(tocTree);
+    // populate lazily: a toc with thousands of items would take
+    // noticeable time to insert into the tree view up-front
+    treeView->SetTreeModel(tocTree, true);
+
+    // on a reload that didn't change the bookmarks, also scroll back to
+    // where the tree was; ids are assigned in tree order so they match
+    // between the old and the new tree when the fingerprints do
+    u32 fingerprint = TocTreeFingerprint(tocTree->root);
+    if (fingerprint == tab->tocFingerprint && tab->tocFirstVisibleId != 0) {
+        TocItem* item = FindTocItemById(tocTree->root, tab->tocFirstVisibleId);
+        HTREEITEM h = item ? treeView->GetHandleByTreeItem((TreeItem)item) : nullptr;
+        if (h) {
+            TreeView_SelectSetFirstVisible(treeView->hwnd, h);
+        }
+    }
+    tab->tocFingerprint = fingerprint;
 
     if (ShouldCustomDraw(win)) {
         treeView->onCustomDraw = MkFunc1Void(OnTocCustomDraw);
@@ -4,6 +4,8 @@
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/PerfTrace.h"
 
 #include "wingui/UIModels.h"
 
@@ -14,11 +16,21 @@
 #include "TextSelection.h"
 #include "TextSearch.h"
 
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#include <intrin.h>
+#define USE_SSE2_ANCHOR_SCAN 1
+#endif
+
 #define SkipWhitespace(c) for (; str::IsWs(*(c)); (c)++)
 // ignore spaces between CJK glyphs but not between Latin, Greek, Cyrillic, etc. letters
 // cf. http://code.google.com/p/sumatrapdf/issues/detail?id=959
 #define isnoncjkwordchar(c) (isWordChar(c) && (unsigned short)(c) < 0x2E80)
 
+// don't bother spinning up prefilter threads for short documents
+#define MIN_PAGES_FOR_PARALLEL_SEARCH 16
+#define MAX_SEARCH_THREADS 8
+
 static void markAllPagesNonSkip(Vec<bool>& pagesToSkip) {
     for (size_t i = 0; i < pagesToSkip.size(); i++) {
         pagesToSkip[i] = false;
@@ -101,6 +113,7 @@ void TextSearch::SetText(const WCHAR* text) {
     }
 
     markAllPagesNonSkip(pagesToSkip);
+    pagesPrefiltered = false;
 }
 
 void TextSearch::SetSensitive(bool sensitive) {
@@ -110,6 +123,7 @@ void TextSearch::SetSensitive(bool sensitive) {
     this->caseSensitive = sensitive;
 
     markAllPagesNonSkip(pagesToSkip);
+    pagesPrefiltered = false;
 }
 
 void TextSearch::SetDirection(TextSearch::Direction direction) {
@@ -141,6 +155,108 @@ void TextSearch::SetLastResult(TextSelection* sel) {
     forward = true;
 }
 
+static bool IsAsciiOnly(const WCHAR* s) {
+    for (; *s; s++) {
+        if (*s > 127) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static WCHAR AsciiToLower(WCHAR c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c + 32;
+    }
+    return c;
+}
+
+static bool MatchAnchorAt(const WCHAR* s, const WCHAR* anchor, bool caseSensitive) {
+    for (size_t i = 0; anchor[i]; i++) {
+        WCHAR c = s[i];
+        if (!c) {
+            return false;
+        }
+        WCHAR a = anchor[i];
+        if (!caseSensitive) {
+            c = AsciiToLower(c);
+            a = AsciiToLower(a);
+        }
+        if (c != a) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Finds the first occurrence of anchor in text. This sits in the inner
+   loop of searching: every page is scanned for the anchor, so scan 8
+   characters per step with SSE2 by locating candidates for the anchor's
+   first character (both cases) and only then verifying the full anchor.
+   Requires an ASCII anchor when searching case-insensitively; callers
+   fall back to StrStrI for anchors that need locale-aware folding. */
+static const WCHAR* FindAnchor(const WCHAR* text, const WCHAR* anchor, bool caseSensitive) {
+    WCHAR c0 = anchor[0];
+    WCHAR cLo = c0, cUp = c0;
+    if (!caseSensitive) {
+        cLo = AsciiToLower(c0);
+        cUp = (cLo >= 'a' && cLo <= 'z') ? cLo - 32 : cLo;
+    }
+
+    const WCHAR* s = text;
+#ifdef USE_SSE2_ANCHOR_SCAN
+    // scalar until 16-byte aligned; aligned loads can't cross a page boundary
+    // so reading up to 7 characters past the terminator below is safe
+    for (; ((uintptr_t)s & 15) != 0; s++) {
+        if (!*s) {
+            return nullptr;
+        }
+        if ((*s == cLo || *s == cUp) && MatchAnchorAt(s, anchor, caseSensitive)) {
+            return s;
+        }
+    }
+
+    __m128i vLo = _mm_set1_epi16((short)cLo);
+    __m128i vUp = _mm_set1_epi16((short)cUp);
+    __m128i vZero = _mm_setzero_si128();
+    for (;; s += 8) {
+        __m128i chunk = _mm_load_si128((const __m128i*)s);
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi16(chunk, vLo), _mm_cmpeq_epi16(chunk, vUp));
+        int hitMask = _mm_movemask_epi8(eq);
+        int endMask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, vZero));
+        if (endMask) {
+            // ignore candidates at or past the terminating 0
+            hitMask &= (endMask - 1) & ~endMask;
+        }
+        while (hitMask) {
+            DWORD bit;
+            _BitScanForward(&bit, (DWORD)hitMask);
+            const WCHAR* cand = s + bit / 2;
+            if (MatchAnchorAt(cand, anchor, caseSensitive)) {
+                return cand;
+            }
+            hitMask &= hitMask - 1;
+            hitMask &= hitMask - 1;
+        }
+        if (endMask) {
+            return nullptr;
+        }
+    }
+#else
+    for (; *s; s++) {
+        if ((*s == cLo || *s == cUp) && MatchAnchorAt(s, anchor, caseSensitive)) {
+            return s;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+// returns true if the fast scan can be used for this anchor
+static bool CanUseFastAnchorScan(const WCHAR* anchor, bool caseSensitive) {
+    return anchor && (caseSensitive || IsAsciiOnly(anchor));
+}
+
 static WCHAR CharToLower2(WCHAR c) {
     WCHAR buf[1] = {c};
     CharLowerBuffW(buf, 1);
@@ -254,6 +370,7 @@ static const WCHAR* GetNextIndex(const WCHAR* base, int offset, bool forward) {
 }
 
 bool TextSearch::FindTextInPage(int pageNo, TextSearch::PageAndOffset* finalGlyph) {
+    PerfTraceScope trace("TextSearch::FindTextInPage");
     if (str::IsEmpty(findText)) {
         return false;
     }
@@ -272,8 +389,8 @@ bool TextSearch::FindTextInPage(int pageNo, TextSearch::PageAndOffset* finalGlyp
             found = GetNextIndex(pageText, findIndex, forward);
         } else if (forward) {
             const WCHAR* s = pageText + findIndex;
-            if (caseSensitive) {
-                found = StrStr(s, anchor);
+            if (CanUseFastAnchorScan(anchor, caseSensitive)) {
+                found = FindAnchor(s, anchor, caseSensitive);
             } else {
                 found = StrStrI(s, anchor);
             }
@@ -304,11 +421,92 @@ bool TextSearch::FindTextInPage(int pageNo, TextSearch::PageAndOffset* finalGlyp
     return true;
 }
 
+struct PrefilterThreadData {
+    TextSearch* ts = nullptr;
+    int firstPage = 0;
+    int lastPage = 0; // inclusive
+};
+
+static void PrefilterPagesThread(PrefilterThreadData* d) {
+    TextSearch* ts = d->ts;
+    for (int pageNo = d->firstPage; pageNo <= d->lastPage; pageNo++) {
+        if (WasCanceled(ts->progressCb)) {
+            return;
+        }
+        if (ts->pagesToSkip[pageNo - 1]) {
+            continue;
+        }
+        const WCHAR* text = ts->textCache->GetTextForPage(pageNo);
+        if (!text) {
+            continue;
+        }
+        // the bloom filter shares the fast scan's ASCII-folding gate:
+        // both are wrong for anchors that need locale-aware folding
+        bool canUseFastScan = CanUseFastAnchorScan(ts->anchor, ts->caseSensitive);
+        if (canUseFastScan && !ts->textCache->PageMayContainAnchor(pageNo, ts->anchor)) {
+            ts->pagesToSkip[pageNo - 1] = true;
+            continue;
+        }
+        const WCHAR* found;
+        if (canUseFastScan) {
+            found = FindAnchor(text, ts->anchor, ts->caseSensitive);
+        } else {
+            found = StrStrI(text, ts->anchor);
+        }
+        if (!found) {
+            ts->pagesToSkip[pageNo - 1] = true;
+        }
+    }
+}
+
+// a match must start with the anchor on its starting page, so pages
+// without the anchor can be ruled out up front. Scanning pages is
+// independent work, so spread it over multiple threads; the directional
+// search below then only visits candidate pages. Each thread writes to
+// its own range of pagesToSkip, text extraction is serialized by
+// DocumentTextCache (and usually already done by its background pass)
+void TextSearch::PrefilterPages() {
+    if (pagesPrefiltered) {
+        return;
+    }
+    pagesPrefiltered = true;
+    if (!anchor || nPages < MIN_PAGES_FOR_PARALLEL_SEARCH) {
+        return;
+    }
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors, 1, MAX_SEARCH_THREADS);
+    int pagesPerThread = (nPages + nThreads - 1) / nThreads;
+
+    PrefilterThreadData td[MAX_SEARCH_THREADS];
+    HANDLE threads[MAX_SEARCH_THREADS];
+    int nStarted = 0;
+    for (int i = 0; i < nThreads; i++) {
+        int firstPage = 1 + i * pagesPerThread;
+        if (firstPage > nPages) {
+            break;
+        }
+        td[i] = {this, firstPage, std::min(firstPage + pagesPerThread - 1, nPages)};
+        auto fn = MkFunc0(PrefilterPagesThread, &td[i]);
+        threads[nStarted] = StartThread(fn, "SearchPrefilterThread");
+        if (threads[nStarted]) {
+            nStarted++;
+        }
+    }
+    WaitForMultipleObjects(nStarted, threads, TRUE, INFINITE);
+    for (int i = 0; i < nStarted; i++) {
+        CloseHandle(threads[i]);
+    }
+}
+
 bool TextSearch::FindStartingAtPage(int pageNo) {
     if (str::IsEmpty(findText)) {
         return false;
     }
 
+    PrefilterPages();
+
     int next = forward ? 1 : -1;
     while ((1 <= pageNo) && (pageNo <= nPages) && !WasCanceled(progressCb)) {
         UpdateProgress(progressCb, pageNo, nPages);
@@ -322,6 +520,13 @@ bool TextSearch::FindStartingAtPage(int pageNo) {
 
         pageText = textCache->GetTextForPage(pageNo, &findIndex);
         if (pageText) {
+            // cheap per-page skip for searches the prefilter didn't
+            // cover (short documents, repeated searches in a session)
+            if (CanUseFastAnchorScan(anchor, caseSensitive) && !textCache->PageMayContainAnchor(pageNo, anchor)) {
+                pagesToSkip[pageNo - 1] = true;
+                pageNo += next;
+                continue;
+            }
             if (forward) {
                 findIndex = 0;
             }
@@ -384,3 +589,30 @@ TextSel* TextSearch::FindNext() {
     }
     return nullptr;
 }
+
+// re-create the selection for a hit found by an earlier whole-document
+// sweep without searching for it again: the hit's start position is
+// known, only its extent has to be re-derived
+TextSel* TextSearch::FindHitAt(int pageNo, int glyph) {
+    if (str::IsEmpty(findText)) {
+        return nullptr;
+    }
+    Reset();
+    forward = true;
+    findPage = pageNo;
+    pageText = textCache->GetTextForPage(pageNo);
+    if (!pageText) {
+        return nullptr;
+    }
+    findIndex = glyph;
+    PageAndOffset finalGlyph;
+    if (!FindTextInPage(pageNo, &finalGlyph)) {
+        return nullptr;
+    }
+    if (findPage != finalGlyph.page) {
+        findPage = finalGlyph.page;
+        pageText = textCache->GetTextForPage(findPage);
+    }
+    findIndex = finalGlyph.offset;
+    return &result;
+}
@@ -12,6 +12,9 @@ struct TextSearch : public TextSelection {
     void SetLastResult(TextSelection* sel);
     TextSel* FindFirst(int page, const WCHAR* text);
     TextSel* FindNext();
+    // re-creates the selection for a hit whose start position is already
+    // known (e.g. from a cached whole-document hit list)
+    TextSel* FindHitAt(int pageNo, int glyph);
 
     int GetCurrentPageNo() const;
     int GetSearchHitStartPageNo() const;
@@ -40,6 +43,8 @@ struct TextSearch : public TextSelection {
     bool FindTextInPage(int pageNo, PageAndOffset* finalGlyph);
     bool FindStartingAtPage(int pageNo);
     PageAndOffset MatchEnd(const WCHAR* start) const;
+    // mark pages that can't contain a match on several threads at once
+    void PrefilterPages();
 
     void Clear();
     void Reset();
@@ -50,4 +55,5 @@ struct TextSearch : public TextSelection {
     WCHAR* lastText = nullptr;
     int nPages = 0;
     Vec<bool> pagesToSkip;
+    bool pagesPrefiltered = false;
 };
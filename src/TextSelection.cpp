@@ -4,11 +4,16 @@
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/CryptoUtil.h"
 
 #include "wingui/UIModels.h"
 
 #include "DocController.h"
 #include "EngineBase.h"
+#include "FileThumbnails.h"
+#include "Ocr.h"
 #include "TextSelection.h"
 
 uint distSq(int x, int y) {
@@ -22,25 +27,385 @@ bool isWordChar(WCHAR c) {
 DocumentTextCache::DocumentTextCache(EngineBase* engine) : engine(engine) {
     nPages = engine->PageCount();
     pagesText = AllocArray<PageText>(nPages);
-    debugSize = nPages * (sizeof(Rect*) + sizeof(WCHAR*) + sizeof(int));
+    pagesCoords = AllocArray<PageCoords>(nPages);
+    pagesRows = AllocArray<PageTextRows>(nPages);
+    pagesWords = AllocArray<PageTextWords>(nPages);
+    pagesBloom = AllocArray<PageBloomFilter>(nPages);
+    debugSize = nPages * (sizeof(Rect*) + sizeof(WCHAR*) + sizeof(int) + sizeof(PageBloomFilter));
 
     InitializeCriticalSection(&access);
 }
 
+// on-disk format: header followed by (len, text, coords) per page.
+// bump the magic when changing the format
+constexpr u32 kTextCacheMagic = 0x30585453; // 'STX0'
+
+struct TextCacheHeader {
+    u32 magic;
+    u32 nPages;
+    FILETIME docModTime;
+};
+
+static TempStr GetTextCachePathTemp(const char* filePath) {
+    if (!filePath) {
+        return nullptr;
+    }
+    // same fingerprinting scheme as GetThumbnailPathTemp()
+    u8 digest[16]{};
+    TempStr path = str::DupTemp(filePath);
+    if (path::HasVariableDriveLetter(path)) {
+        path[0] = '?';
+    }
+    CalcMD5Digest((u8*)path, str::Leni(path), digest);
+    AutoFreeStr fingerPrint = str::MemToHex(digest, dimof(digest));
+
+    TempStr cacheDir = GetThumbnailCacheDirTemp();
+    if (!cacheDir) {
+        return nullptr;
+    }
+    return path::JoinTemp(cacheDir, str::JoinTemp(fingerPrint, ".stext"));
+}
+
+// glyph rects of a line share y and dy and advance monotonically in x,
+// so per-field deltas are tiny; zig-zag + varint encoding shrinks a
+// page's coordinates by roughly an order of magnitude
+static void EncodeVarint(str::Str& s, int v) {
+    u32 u = ((u32)v << 1) ^ (u32)(v >> 31);
+    while (u >= 0x80) {
+        s.AppendChar((char)(u | 0x80));
+        u >>= 7;
+    }
+    s.AppendChar((char)u);
+}
+
+static const u8* DecodeVarint(const u8* s, int* vOut) {
+    u32 u = 0;
+    int shift = 0;
+    for (;;) {
+        u8 c = *s++;
+        u |= (u32)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    *vOut = (int)((u >> 1) ^ (0u - (u & 1)));
+    return s;
+}
+
+static u8* CompressCoords(const Rect* coords, int nCoords, int* packedSizeOut) {
+    *packedSizeOut = 0;
+    if (nCoords <= 0 || !coords) {
+        return nullptr;
+    }
+    str::Str s;
+    Rect prev;
+    for (int i = 0; i < nCoords; i++) {
+        Rect r;
+        // coords can point into unaligned file data (see LoadFromDisk)
+        memcpy(&r, &coords[i], sizeof(Rect));
+        EncodeVarint(s, r.x - prev.x);
+        EncodeVarint(s, r.y - prev.y);
+        EncodeVarint(s, r.dx - prev.dx);
+        EncodeVarint(s, r.dy - prev.dy);
+        prev = r;
+    }
+    *packedSizeOut = s.Size();
+    return (u8*)memdup(s.Get(), (size_t)s.Size(), 0);
+}
+
+static Rect* DecompressCoords(const u8* packed, int nCoords) {
+    Rect* coords = AllocArray<Rect>(nCoords);
+    if (!coords) {
+        return nullptr;
+    }
+    const u8* cur = packed;
+    Rect prev;
+    for (int i = 0; i < nCoords; i++) {
+        int d;
+        cur = DecodeVarint(cur, &d);
+        prev.x += d;
+        cur = DecodeVarint(cur, &d);
+        prev.y += d;
+        cur = DecodeVarint(cur, &d);
+        prev.dx += d;
+        cur = DecodeVarint(cur, &d);
+        prev.dy += d;
+        coords[i] = prev;
+    }
+    return coords;
+}
+
+// number of pages whose inflated coordinates are kept around. Callers
+// only use a coords pointer while working on one page, so a budget of
+// a few pages also leaves slack for concurrent users (e.g. the search
+// thread next to the UI thread). Caller must hold access
+constexpr int kMaxInflatedCoordsPages = 8;
+
+static void EvictColdCoords(DocumentTextCache* cache) {
+    int nInflated = 0;
+    for (int i = 0; i < cache->nPages; i++) {
+        if (cache->pagesCoords[i].inflated) {
+            nInflated++;
+        }
+    }
+    while (nInflated > kMaxInflatedCoordsPages) {
+        PageCoords* coldest = nullptr;
+        for (int i = 0; i < cache->nPages; i++) {
+            PageCoords* pc = &cache->pagesCoords[i];
+            if (pc->inflated && (!coldest || pc->lastUsed < coldest->lastUsed)) {
+                coldest = pc;
+            }
+        }
+        free(coldest->inflated);
+        coldest->inflated = nullptr;
+        nInflated--;
+    }
+}
+
+// tries to fill the cache from a previous session's extraction. Returns
+// true if the text of all pages was loaded
+bool DocumentTextCache::LoadFromDisk() {
+    const char* filePath = engine->FilePath();
+    TempStr cachePath = GetTextCachePathTemp(filePath);
+    if (!cachePath) {
+        return false;
+    }
+    ByteSlice d = file::ReadFile(cachePath);
+    if (d.empty()) {
+        return false;
+    }
+
+    bool ok = false;
+    const u8* cur = d.data();
+    const u8* end = cur + d.size();
+    if (d.size() >= sizeof(TextCacheHeader)) {
+        TextCacheHeader hdr;
+        memcpy(&hdr, cur, sizeof(hdr));
+        cur += sizeof(hdr);
+        FILETIME docModTime = file::GetModificationTime(filePath);
+        ok = hdr.magic == kTextCacheMagic && (int)hdr.nPages == nPages &&
+             FileTimeDiffInSecs(docModTime, hdr.docModTime) == 0;
+    }
+
+    ScopedCritSec scope(&access);
+    for (int i = 0; ok && i < nPages; i++) {
+        int len;
+        ok = cur + sizeof(int) <= end;
+        if (!ok) {
+            break;
+        }
+        memcpy(&len, cur, sizeof(int));
+        cur += sizeof(int);
+        size_t textSize = ((size_t)len + 1) * sizeof(WCHAR);
+        size_t coordsSize = (size_t)len * sizeof(Rect);
+        ok = len >= 0 && cur + textSize + coordsSize <= end;
+        if (!ok) {
+            break;
+        }
+        PageText* pageText = &pagesText[i];
+        if (!pageText->text) {
+            pageText->text = (WCHAR*)memdup((void*)cur, textSize, 0);
+            pageText->len = len;
+            PageCoords* pc = &pagesCoords[i];
+            pc->packed = CompressCoords((const Rect*)(cur + textSize), len, &pc->packedSize);
+            debugSize += (len + 1) * (int)sizeof(WCHAR) + pc->packedSize;
+        }
+        cur += textSize + coordsSize;
+    }
+    d.Free();
+    if (ok) {
+        logf("DocumentTextCache::LoadFromDisk: loaded text of %d pages from '%s'\n", nPages, cachePath);
+    }
+    return ok;
+}
+
+// persists the cache once the text of all pages has been extracted
+void DocumentTextCache::SaveToDisk() {
+    const char* filePath = engine->FilePath();
+    TempStr cachePath = GetTextCachePathTemp(filePath);
+    if (!cachePath) {
+        return;
+    }
+
+    ScopedCritSec scope(&access);
+    size_t n = sizeof(TextCacheHeader);
+    for (int i = 0; i < nPages; i++) {
+        PageText* pageText = &pagesText[i];
+        if (!pageText->text) {
+            // only fully extracted documents are worth persisting
+            return;
+        }
+        n += sizeof(int) + ((size_t)pageText->len + 1) * sizeof(WCHAR) + (size_t)pageText->len * sizeof(Rect);
+    }
+
+    u8* data = (u8*)malloc(n);
+    if (!data) {
+        return;
+    }
+    TextCacheHeader hdr{kTextCacheMagic, (u32)nPages, file::GetModificationTime(filePath)};
+    u8* cur = data;
+    memcpy(cur, &hdr, sizeof(hdr));
+    cur += sizeof(hdr);
+    for (int i = 0; i < nPages; i++) {
+        PageText* pageText = &pagesText[i];
+        int len = pageText->len;
+        memcpy(cur, &len, sizeof(int));
+        cur += sizeof(int);
+        size_t textSize = ((size_t)len + 1) * sizeof(WCHAR);
+        memcpy(cur, pageText->text, textSize);
+        cur += textSize;
+        if (len > 0) {
+            PageCoords* pc = &pagesCoords[i];
+            if (pc->inflated) {
+                memcpy(cur, pc->inflated, (size_t)len * sizeof(Rect));
+            } else {
+                Rect* coords = DecompressCoords(pc->packed, len);
+                memcpy(cur, coords, (size_t)len * sizeof(Rect));
+                free(coords);
+            }
+            cur += (size_t)len * sizeof(Rect);
+        }
+    }
+    ReportIf(cur != data + n);
+
+    bool ok = file::WriteFile(cachePath, {data, n});
+    free(data);
+    logf("DocumentTextCache::SaveToDisk: %s '%s'\n", ok ? "wrote" : "failed to write", cachePath);
+}
+
+static void BackgroundTextExtractionThread(DocumentTextCache* cache) {
+    if (!cache->LoadFromDisk()) {
+        for (int pageNo = 1; pageNo <= cache->nPages; pageNo++) {
+            if (cache->stopExtraction.Get()) {
+                return;
+            }
+            if (cache->HasTextForPage(pageNo)) {
+                continue;
+            }
+            cache->GetTextForPage(pageNo);
+        }
+        if (cache->stopExtraction.Get()) {
+            return;
+        }
+        cache->SaveToDisk();
+    }
+    if (!OcrEnabled()) {
+        return;
+    }
+    // pages that came out empty are likely scans without a text layer;
+    // hand them to the OCR worker (see Ocr.cpp)
+    for (int pageNo = 1; pageNo <= cache->nPages; pageNo++) {
+        if (cache->stopExtraction.Get()) {
+            return;
+        }
+        int len = 0;
+        cache->GetTextForPage(pageNo, &len);
+        if (len == 0) {
+            QueueOcrPage(cache, pageNo, false);
+        }
+    }
+}
+
+// extract text of all pages on a low-priority thread. Pages already
+// extracted on demand (e.g. by the render thread) are skipped; on-demand
+// extraction and the background pass serialize on the access lock
+void DocumentTextCache::StartBackgroundExtraction() {
+    ReportIf(extractionThread);
+    if (extractionThread) {
+        return;
+    }
+    stopExtraction.Set(false);
+    auto fn = MkFunc0(BackgroundTextExtractionThread, this);
+    extractionThread = StartThread(fn, "TextExtractionThread");
+    if (extractionThread) {
+        SetThreadPriority(extractionThread, THREAD_PRIORITY_LOWEST);
+    }
+}
+
+void DocumentTextCache::StopBackgroundExtraction() {
+    if (!extractionThread) {
+        return;
+    }
+    stopExtraction.Set(true);
+    WaitForSingleObject(extractionThread, INFINITE);
+    CloseHandle(extractionThread);
+    extractionThread = nullptr;
+}
+
 DocumentTextCache::~DocumentTextCache() {
+    CancelOcr(this);
+    StopBackgroundExtraction();
     EnterCriticalSection(&access);
 
     int n = engine->PageCount();
     for (int i = 0; i < n; i++) {
-        PageText* pageText = &pagesText[i];
-        free(pageText->coords);
-        free(pageText->text);
+        free(pagesText[i].text);
+        free(pagesCoords[i].packed);
+        free(pagesCoords[i].inflated);
+        free(pagesRows[i].rows);
+        free(pagesWords[i].words);
     }
     free(pagesText);
+    free(pagesCoords);
+    free(pagesRows);
+    free(pagesWords);
+    free(pagesBloom);
+    for (void* buf : retiredBuffers) {
+        free(buf);
+    }
     LeaveCriticalSection(&access);
     DeleteCriticalSection(&access);
 }
 
+// bigrams are folded to ASCII lower case so that a case-insensitive
+// query can use the same bits; non-ASCII characters pass through
+// unchanged (locale-aware folding is the caller's problem, cf. the
+// comment on PageMayContainAnchor)
+static inline WCHAR FoldBloomChar(WCHAR c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c + 32;
+    }
+    return c;
+}
+
+// two bit positions per bigram keep the false-positive rate of the
+// 256-bit filter low enough even for dense pages
+static inline void BloomBitsForBigram(WCHAR c1, WCHAR c2, u32* bit1, u32* bit2) {
+    u32 h = ((u32)c1 * 31u + (u32)c2) * 2654435761u;
+    *bit1 = h & 255;
+    *bit2 = (h >> 8) & 255;
+}
+
+static void BuildBloomFilter(const PageText* pageText, PageBloomFilter* bloom) {
+    const WCHAR* s = pageText->text;
+    for (int i = 0; i + 1 < pageText->len; i++) {
+        u32 bit1, bit2;
+        BloomBitsForBigram(FoldBloomChar(s[i]), FoldBloomChar(s[i + 1]), &bit1, &bit2);
+        bloom->bits[bit1 >> 5] |= 1u << (bit1 & 31);
+        bloom->bits[bit2 >> 5] |= 1u << (bit2 & 31);
+    }
+    bloom->built = true;
+}
+
+bool DocumentTextCache::PageMayContainAnchor(int pageNo, const WCHAR* anchor) {
+    ReportIf(pageNo < 1 || pageNo > nPages);
+    ScopedCritSec scope(&access);
+    PageBloomFilter* bloom = &pagesBloom[pageNo - 1];
+    // an anchor needs at least one bigram to rule a page out
+    if (!bloom->built || !anchor || !anchor[0] || !anchor[1]) {
+        return true;
+    }
+    for (int i = 0; anchor[i + 1]; i++) {
+        u32 bit1, bit2;
+        BloomBitsForBigram(FoldBloomChar(anchor[i]), FoldBloomChar(anchor[i + 1]), &bit1, &bit2);
+        if (!(bloom->bits[bit1 >> 5] & (1u << (bit1 & 31))) || !(bloom->bits[bit2 >> 5] & (1u << (bit2 & 31)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool DocumentTextCache::HasTextForPage(int pageNo) const {
     ReportIf(pageNo < 1 || pageNo > nPages);
     PageText* pageText = &pagesText[pageNo - 1];
@@ -52,6 +417,7 @@ const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** c
 
     ScopedCritSec scope(&access);
     PageText* pageText = &pagesText[pageNo - 1];
+    PageCoords* pc = &pagesCoords[pageNo - 1];
 
     if (!pageText->text) {
         *pageText = engine->ExtractPageText(pageNo);
@@ -59,18 +425,170 @@ const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** c
             pageText->text = str::Dup(L"");
             pageText->len = 0;
         }
-        debugSize += (pageText->len + 1) * (int)(sizeof(WCHAR) + sizeof(Rect));
+        // coordinates are only kept compressed; the raw array stays
+        // cached below if this caller asked for it
+        pc->packed = CompressCoords(pageText->coords, pageText->len, &pc->packedSize);
+        if (coordsOut) {
+            pc->inflated = pageText->coords;
+        } else {
+            free(pageText->coords);
+        }
+        pageText->coords = nullptr;
+        debugSize += (pageText->len + 1) * (int)sizeof(WCHAR) + pc->packedSize;
+    }
+    // also covers text that LoadFromDisk() filled in without extraction
+    if (!pagesBloom[pageNo - 1].built) {
+        BuildBloomFilter(pageText, &pagesBloom[pageNo - 1]);
     }
 
     if (lenOut) {
         *lenOut = pageText->len;
     }
     if (coordsOut) {
-        *coordsOut = pageText->coords;
+        if (!pc->inflated && pageText->len > 0) {
+            pc->inflated = DecompressCoords(pc->packed, pageText->len);
+        }
+        pc->lastUsed = ++coordsUseGen;
+        EvictColdCoords(this);
+        *coordsOut = pc->inflated;
     }
     return pageText->text;
 }
 
+// installs text recognized by OCR for a page whose extracted text is
+// empty, replacing the empty buffers. Derived per-page data (rows,
+// words, bloom filter) describes the old text and is retired with it
+bool DocumentTextCache::SetOcrTextForPage(int pageNo, WCHAR* text, Rect* coords, int len) {
+    ReportIf(pageNo < 1 || pageNo > nPages);
+    ScopedCritSec scope(&access);
+
+    PageText* pageText = &pagesText[pageNo - 1];
+    if (pageText->len > 0) {
+        // the engine came up with real text after all
+        free(text);
+        free(coords);
+        return false;
+    }
+    retiredBuffers.Append(pageText->text);
+    pageText->text = text;
+    pageText->len = len;
+
+    PageCoords* pc = &pagesCoords[pageNo - 1];
+    free(pc->packed);
+    pc->packed = CompressCoords(coords, len, &pc->packedSize);
+    if (pc->inflated) {
+        retiredBuffers.Append(pc->inflated);
+    }
+    // keep the raw coords hot: the page is likely being looked at
+    pc->inflated = coords;
+    pc->lastUsed = ++coordsUseGen;
+    debugSize += (len + 1) * (int)sizeof(WCHAR) + pc->packedSize;
+
+    retiredBuffers.Append(pagesRows[pageNo - 1].rows);
+    pagesRows[pageNo - 1] = {};
+    retiredBuffers.Append(pagesWords[pageNo - 1].words);
+    pagesWords[pageNo - 1] = {};
+    pagesBloom[pageNo - 1] = {};
+    BuildBloomFilter(pageText, &pagesBloom[pageNo - 1]);
+    return true;
+}
+
+static bool IsLineBreakGlyph(const Rect& r) {
+    return !r.x && !r.dx;
+}
+
+// groups the glyphs of a page into rows (runs of glyphs between line
+// breaks) with the union of their bounding boxes
+TextRow* DocumentTextCache::GetRowsForPage(int pageNo, int* nRowsOut) {
+    int len;
+    Rect* coords;
+    GetTextForPage(pageNo, &len, &coords);
+
+    ScopedCritSec scope(&access);
+    PageTextRows* pageRows = &pagesRows[pageNo - 1];
+    if (!pageRows->built) {
+        int nRows = 0;
+        for (int i = 0; i < len; i++) {
+            if (!IsLineBreakGlyph(coords[i]) && (i == 0 || IsLineBreakGlyph(coords[i - 1]))) {
+                nRows++;
+            }
+        }
+        TextRow* rows = nRows > 0 ? AllocArray<TextRow>(nRows) : nullptr;
+        int rowIx = -1;
+        for (int i = 0; i < len; i++) {
+            if (IsLineBreakGlyph(coords[i])) {
+                continue;
+            }
+            if (i == 0 || IsLineBreakGlyph(coords[i - 1])) {
+                rowIx++;
+                rows[rowIx].firstGlyph = i;
+                rows[rowIx].bbox = coords[i];
+            } else {
+                rows[rowIx].bbox = rows[rowIx].bbox.Union(coords[i]);
+            }
+            rows[rowIx].lastGlyph = i + 1;
+        }
+        ReportIf(rowIx + 1 != nRows);
+        pageRows->rows = rows;
+        pageRows->nRows = nRows;
+        pageRows->built = true;
+        debugSize += nRows * (int)sizeof(TextRow);
+    }
+    *nRowsOut = pageRows->nRows;
+    return pageRows->rows;
+}
+
+int FindWordAtOrAfter(WordSpan* words, int nWords, int glyphIx) {
+    int lo = 0, hi = nWords;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (words[mid].end < glyphIx) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// precomputes the word spans of a page so that word lookups (double-
+// click selection, UIA word navigation) don't have to walk the raw
+// text buffer
+WordSpan* DocumentTextCache::GetWordsForPage(int pageNo, int* nWordsOut) {
+    int len;
+    const WCHAR* text = GetTextForPage(pageNo, &len);
+
+    ScopedCritSec scope(&access);
+    PageTextWords* pageWords = &pagesWords[pageNo - 1];
+    if (!pageWords->built) {
+        int nWords = 0;
+        for (int i = 0; i < len; i++) {
+            if (isWordChar(text[i]) && (i == 0 || !isWordChar(text[i - 1]))) {
+                nWords++;
+            }
+        }
+        WordSpan* words = nWords > 0 ? AllocArray<WordSpan>(nWords) : nullptr;
+        int wordIx = -1;
+        for (int i = 0; i < len; i++) {
+            if (!isWordChar(text[i])) {
+                continue;
+            }
+            if (i == 0 || !isWordChar(text[i - 1])) {
+                wordIx++;
+                words[wordIx].start = i;
+            }
+            words[wordIx].end = i + 1;
+        }
+        ReportIf(wordIx + 1 != nWords);
+        pageWords->words = words;
+        pageWords->nWords = nWords;
+        pageWords->built = true;
+        debugSize += nWords * (int)sizeof(WordSpan);
+    }
+    *nWordsOut = pageWords->nWords;
+    return pageWords->words;
+}
+
 TextSelection::TextSelection(EngineBase* engine, DocumentTextCache* textCache) : engine(engine), textCache(textCache) {
 }
 
@@ -87,6 +605,24 @@ void TextSelection::Reset() {
     result.rects = nullptr;
 }
 
+// squared distance from a point to the closest point of a rectangle,
+// 0 if the point is inside
+static uint DistSqToRect(int x, int y, const Rect& r) {
+    int dx = 0;
+    if (x < r.x) {
+        dx = r.x - x;
+    } else if (x > r.x + r.dx) {
+        dx = x - (r.x + r.dx);
+    }
+    int dy = 0;
+    if (y < r.y) {
+        dy = r.y - y;
+    } else if (y > r.y + r.dy) {
+        dy = y - (r.y + r.dy);
+    }
+    return distSq(dx, dy);
+}
+
 // returns the index of the glyph closest to the right of the given coordinates
 // (i.e. when over the right half of a glyph, the returned index will be for the
 // glyph following it, which will be the first glyph (not) to be selected)
@@ -94,6 +630,8 @@ static int FindClosestGlyph(TextSelection* ts, int pageNo, double x, double y) {
     int textLen;
     Rect* coords;
     ts->textCache->GetTextForPage(pageNo, &textLen, &coords);
+    int nRows;
+    TextRow* rows = ts->textCache->GetRowsForPage(pageNo, &nRows);
     PointF pt = PointF(x, y);
 
     unsigned int maxDist = UINT_MAX;
@@ -101,25 +639,40 @@ static int FindClosestGlyph(TextSelection* ts, int pageNo, double x, double y) {
     bool overGlyph = false;
     int result = -1;
 
-    for (int i = 0; i < textLen; i++) {
-        Rect& coord = coords[i];
-        if (!coord.x && !coord.dx) {
+    // visiting rows in glyph order and rejecting them by their bounding
+    // box gives the same result as visiting every glyph: glyph centers
+    // lie within the row's bbox, so no glyph of a rejected row can be
+    // strictly closer than the bbox itself
+    for (int rowIx = 0; rowIx < nRows; rowIx++) {
+        TextRow& row = rows[rowIx];
+        bool inRow = row.bbox.Contains(pti);
+        if (overGlyph && !inRow) {
+            // only glyphs the cursor is over can still improve the result
             continue;
         }
-        if (overGlyph && !coord.Contains(pti)) {
+        if (!inRow && DistSqToRect((int)x, (int)y, row.bbox) >= maxDist) {
             continue;
         }
+        for (int i = row.firstGlyph; i < row.lastGlyph; i++) {
+            Rect& coord = coords[i];
+            if (!coord.x && !coord.dx) {
+                continue;
+            }
+            if (overGlyph && !coord.Contains(pti)) {
+                continue;
+            }
 
-        uint dist = distSq((int)x - coord.x - coord.dx / 2, (int)y - coord.y - coord.dy / 2);
-        if (dist < maxDist) {
-            result = i;
-            maxDist = dist;
-        }
-        // prefer glyphs the cursor is actually over
-        if (!overGlyph && coord.Contains(pti)) {
-            overGlyph = true;
-            result = i;
-            maxDist = dist;
+            uint dist = distSq((int)x - coord.x - coord.dx / 2, (int)y - coord.y - coord.dy / 2);
+            if (dist < maxDist) {
+                result = i;
+                maxDist = dist;
+            }
+            // prefer glyphs the cursor is actually over
+            if (!overGlyph && coord.Contains(pti)) {
+                overGlyph = true;
+                result = i;
+                maxDist = dist;
+            }
         }
     }
 
@@ -200,6 +753,37 @@ static void FillResultRects(TextSelection* ts, int pageNo, int glyph, int length
     }
 }
 
+// merges vertically adjacent line rects with (nearly) the same
+// horizontal extent into one block rect, so that select-all on a dense
+// page paints a handful of region fills instead of one rect per line.
+// Runs once per selection change; painting happens on every frame
+static void CoalesceResultRects(TextSel& res) {
+    if (res.len < 2) {
+        return;
+    }
+    // max difference in horizontal extent for two line rects to count
+    // as part of the same text block and max vertical gap (leading
+    // between lines, in page units) to bridge
+    constexpr int kMaxXDiff = 2;
+    constexpr int kMaxYGap = 6;
+    int n = 0; // index of the last merged rect
+    for (int i = 1; i < res.len; i++) {
+        Rect& prev = res.rects[n];
+        Rect r = res.rects[i];
+        bool merge = res.pages[i] == res.pages[n] && std::abs(r.x - prev.x) <= kMaxXDiff &&
+                     std::abs(r.dx - prev.dx) <= kMaxXDiff && r.y >= prev.y &&
+                     r.y - (prev.y + prev.dy) <= kMaxYGap;
+        if (merge) {
+            prev = prev.Union(r);
+            continue;
+        }
+        n++;
+        res.pages[n] = res.pages[i];
+        res.rects[n] = r;
+    }
+    res.len = n + 1;
+}
+
 bool TextSelection::IsOverGlyph(int pageNo, double x, double y) {
     int textLen;
     Rect* coords;
@@ -267,25 +851,22 @@ void TextSelection::SelectUpTo(int pageNo, int glyphIx) {
             FillResultRects(this, page, glyph, length);
         }
     }
+    CoalesceResultRects(result);
 }
 
 void TextSelection::SelectWordAt(int pageNo, double x, double y) {
     int i = FindClosestGlyph(this, pageNo, x, y);
-    int textLen;
-    const WCHAR* text = textCache->GetTextForPage(pageNo, &textLen);
+    int nWords;
+    WordSpan* words = textCache->GetWordsForPage(pageNo, &nWords);
 
-    for (; i > 0; i--) {
-        if (!isWordChar(text[i - 1])) {
-            break;
-        }
+    int wordIx = FindWordAtOrAfter(words, nWords, i);
+    if (wordIx < nWords && words[wordIx].start <= i) {
+        StartAt(pageNo, words[wordIx].start);
+        SelectUpTo(pageNo, words[wordIx].end);
+        return;
     }
+    // not over a word: collapse the selection at the closest glyph
     StartAt(pageNo, i);
-
-    for (; i < textLen; i++) {
-        if (!isWordChar(text[i])) {
-            break;
-        }
-    }
     SelectUpTo(pageNo, i);
 }
 
@@ -1,19 +1,112 @@
 /* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
    License: GPLv3 */
 
+// a run of consecutive glyphs between line breaks and the union of
+// their bounding boxes. FindClosestGlyph() can reject a whole row by
+// its bbox instead of visiting every glyph
+struct TextRow {
+    int firstGlyph = 0;
+    // one past the last glyph of the row
+    int lastGlyph = 0;
+    Rect bbox;
+};
+
+struct PageTextRows {
+    TextRow* rows = nullptr;
+    int nRows = 0;
+    bool built = false;
+};
+
+// a maximal run of word characters (see isWordChar). Word starts and
+// ends are sorted, so the word containing a glyph can be found by
+// binary search (see FindWordAtOrAfter)
+struct WordSpan {
+    int start = 0;
+    // one past the last glyph of the word
+    int end = 0;
+};
+
+struct PageTextWords {
+    WordSpan* words = nullptr;
+    int nWords = 0;
+    bool built = false;
+};
+
+// 256-bit character-bigram bloom filter of a page's text. Search can
+// skip a page when one of the needle's bigrams is provably absent,
+// without re-scanning the page text (see PageMayContainAnchor)
+struct PageBloomFilter {
+    u32 bits[8] = {};
+    bool built = false;
+};
+
+// glyph coordinates of a page. At rest they're only kept delta+varint
+// compressed (a Rect per glyph dwarfs the text itself on large
+// documents); recently used pages also cache the inflated Rect array,
+// evicted in LRU order (see kMaxInflatedCoordsPages)
+struct PageCoords {
+    u8* packed = nullptr;
+    int packedSize = 0;
+    Rect* inflated = nullptr;
+    // value of DocumentTextCache::coordsUseGen at the last access
+    u32 lastUsed = 0;
+};
+
 struct DocumentTextCache {
     EngineBase* engine = nullptr;
     int nPages = 0;
     PageText* pagesText = nullptr;
+    // compressed glyph coordinates, parallel to pagesText
+    PageCoords* pagesCoords = nullptr;
+    u32 coordsUseGen = 0;
+    // lazily built per-page rows for hit-testing, parallel to pagesText
+    PageTextRows* pagesRows = nullptr;
+    // lazily built per-page word spans for word lookups, parallel to
+    // pagesText
+    PageTextWords* pagesWords = nullptr;
+    // per-page bigram filters, built when a page's text first becomes
+    // available; parallel to pagesText
+    PageBloomFilter* pagesBloom = nullptr;
     int debugSize = 0;
+    // buffers replaced by SetOcrTextForPage(). Callers cache pointers
+    // returned by the getters across calls (e.g. TextSearch), so
+    // replaced buffers are only freed with the cache itself
+    Vec<void*> retiredBuffers;
 
     CRITICAL_SECTION access;
 
+    // pre-extracts text of all pages so that the first search /
+    // selection doesn't have to walk the document
+    HANDLE extractionThread = nullptr;
+    AtomicBool stopExtraction;
+
     explicit DocumentTextCache(EngineBase* engine);
     ~DocumentTextCache();
 
     bool HasTextForPage(int pageNo) const;
+    // the returned coords pointer stays valid only until coords of a
+    // handful of other pages are requested (they're re-inflated from
+    // the compressed form and evicted in LRU order); don't hold it
+    // across pages
     const WCHAR* GetTextForPage(int pageNo, int* lenOut = nullptr, Rect** coordsOut = nullptr);
+    // replaces an empty page's text with OCR output (see Ocr.cpp);
+    // takes ownership of text and coords
+    bool SetOcrTextForPage(int pageNo, WCHAR* text, Rect* coords, int len);
+    TextRow* GetRowsForPage(int pageNo, int* nRowsOut);
+    WordSpan* GetWordsForPage(int pageNo, int* nWordsOut);
+    // false only when the page's text provably doesn't contain anchor.
+    // Bigrams are ASCII-case-folded, so the answer is only reliable for
+    // searches that don't need locale-aware folding (ASCII anchors or
+    // case-sensitive ones); callers have to gate on that
+    bool PageMayContainAnchor(int pageNo, const WCHAR* anchor);
+
+    void StartBackgroundExtraction();
+    void StopBackgroundExtraction();
+
+    // persisted copy of the extracted text so that repeat searches in
+    // the same document skip extraction entirely across sessions
+    bool LoadFromDisk();
+    void SaveToDisk();
 };
 
 // TODO: replace with Vec<TextSel>
@@ -53,3 +146,6 @@ struct TextSelection {
 
 uint distSq(int x, int y);
 bool isWordChar(WCHAR c);
+// returns the index of the first word whose end is at or past glyphIx,
+// nWords if there is none
+int FindWordAtOrAfter(WordSpan* words, int nWords, int glyphIx);
@@ -0,0 +1,438 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/Dpi.h"
+#include "utils/UITask.h"
+#include "utils/WinUtil.h"
+
+#include "wingui/UIModels.h"
+#include "wingui/Layout.h"
+#include "wingui/WinGui.h"
+
+#include "Settings.h"
+#include "DocController.h"
+#include "EngineBase.h"
+#include "GlobalPrefs.h"
+#include "SumatraPDF.h"
+#include "MainWindow.h"
+#include "DisplayModel.h"
+#include "RenderCache.h"
+#include "Theme.h"
+#include "ThumbnailStrip.h"
+
+#include "utils/Log.h"
+
+#define THUMBNAIL_STRIP_CLASS_NAME L"SUMATRA_PDF_THUMBNAIL_STRIP"
+
+// unscaled layout metrics
+constexpr int kThumbStripDx = 150;
+constexpr int kThumbStripPadding = 6;
+constexpr int kThumbStripLabelDy = 16;
+
+// upper bound for cached thumbnail bitmaps per window; at ~150x200 px
+// 32-bit each this is about 5 MB, no matter how long the document is
+constexpr int kThumbStripMaxCached = 48;
+
+ThumbnailStripInfo::~ThumbnailStripInfo() {
+    for (StripThumb& st : thumbs) {
+        delete st.bmp;
+    }
+}
+
+static StripThumb* FindStripThumb(ThumbnailStripInfo* t, int pageNo) {
+    int n = t->thumbs.Size();
+    for (int i = 0; i < n; i++) {
+        if (t->thumbs.at(i).pageNo != pageNo) {
+            continue;
+        }
+        // most recently used entries live at the end
+        if (i != n - 1) {
+            StripThumb st = t->thumbs.at(i);
+            t->thumbs.RemoveAt(i);
+            t->thumbs.Append(st);
+        }
+        return &t->thumbs.at(n - 1);
+    }
+    return nullptr;
+}
+
+// takes ownership of bmp
+static void SetStripThumb(ThumbnailStripInfo* t, int pageNo, RenderedBitmap* bmp) {
+    StripThumb* st = FindStripThumb(t, pageNo);
+    if (st) {
+        delete st->bmp;
+        st->bmp = bmp;
+        return;
+    }
+    if (t->thumbs.Size() >= kThumbStripMaxCached) {
+        // recycle the least recently used thumbnail
+        delete t->thumbs.at(0).bmp;
+        t->thumbs.RemoveAt(0);
+    }
+    StripThumb newThumb;
+    newThumb.pageNo = pageNo;
+    newThumb.bmp = bmp;
+    t->thumbs.Append(newThumb);
+}
+
+// the cell (thumbnail plus label) of pageNo in client coordinates
+static Rect StripCellRect(ThumbnailStripInfo* t, int pageNo) {
+    int y = (pageNo - 1) * t->cellDy - t->scrollY;
+    return Rect(0, y, t->stripDx, t->cellDy);
+}
+
+static void UpdateStripScrollbar(ThumbnailStripInfo* t) {
+    Rect rc = ClientRect(t->hwnd);
+    SCROLLINFO si{};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_ALL;
+    si.nMin = 0;
+    si.nMax = t->pageCount * t->cellDy - 1;
+    si.nPage = rc.dy;
+    si.nPos = t->scrollY;
+    SetScrollInfo(t->hwnd, SB_VERT, &si, TRUE);
+}
+
+static void SetStripScrollY(ThumbnailStripInfo* t, int y) {
+    Rect rc = ClientRect(t->hwnd);
+    int maxY = t->pageCount * t->cellDy - rc.dy;
+    y = limitValue(y, 0, std::max(maxY, 0));
+    if (y == t->scrollY) {
+        return;
+    }
+    t->scrollY = y;
+    UpdateStripScrollbar(t);
+    InvalidateRect(t->hwnd, nullptr, FALSE);
+}
+
+/* Rendering.
+
+Thumbnails go through the shared RenderCache queue at the lowest priority
+so that they never delay rendering of the visible page. The callback runs
+on a render thread and bounces the bitmap over to the UI thread, which
+validates that the window and document still exist before touching the
+strip. */
+
+struct ThumbRenderData {
+    MainWindow* win = nullptr;
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    RenderedBitmap* bmp = nullptr;
+    // the callback registered with the RenderCache, freed when it fired
+    const OnBitmapRendered* self = nullptr;
+};
+
+static void ThumbnailRenderedFinish(ThumbRenderData* d) {
+    delete d->self;
+    MainWindow* win = d->win;
+    ThumbnailStripInfo* t = IsMainWindowValid(win) ? win->thumbnailStrip : nullptr;
+    if (!t || t->dm != d->dm) {
+        // the window was closed or the tab switched documents
+        delete d->bmp;
+        delete d;
+        return;
+    }
+    int idx = t->pendingPages.Find(d->pageNo);
+    if (idx >= 0) {
+        t->pendingPages.RemoveAt(idx);
+    }
+    if (d->bmp) {
+        SetStripThumb(t, d->pageNo, d->bmp);
+        Rect rCell = StripCellRect(t, d->pageNo);
+        RECT rc = ToRECT(rCell);
+        InvalidateRect(t->hwnd, &rc, FALSE);
+    }
+    delete d;
+}
+
+// called on a render thread; the bitmap is nullptr if rendering failed
+// or was aborted
+static void ThumbnailRenderedOnThread(ThumbRenderData* d, RenderedBitmap* bmp) {
+    d->bmp = bmp;
+    auto fn = MkFunc0<ThumbRenderData>(ThumbnailRenderedFinish, d);
+    uitask::Post(fn, "TaskThumbnailStripRendered");
+}
+
+static void RequestThumbRendering(ThumbnailStripInfo* t, int pageNo) {
+    if (t->pendingPages.Contains(pageNo)) {
+        return;
+    }
+    DisplayModel* dm = t->dm;
+    EngineBase* engine = dm->GetEngine();
+    RectF pageRect = engine->PageMediabox(pageNo);
+    if (pageRect.IsEmpty()) {
+        return;
+    }
+    pageRect = engine->Transform(pageRect, pageNo, 1.0f, 0);
+    float zoom = (float)t->thumbDx / (float)pageRect.dx;
+    if (pageRect.dy > (float)t->thumbDy / zoom) {
+        pageRect.dy = (float)t->thumbDy / zoom;
+    }
+    pageRect = engine->Transform(pageRect, pageNo, 1.0f, 0, true);
+
+    auto d = new ThumbRenderData;
+    d->win = t->win;
+    d->dm = dm;
+    d->pageNo = pageNo;
+    d->self = NewFunc1(ThumbnailRenderedOnThread, d);
+    t->pendingPages.Append(pageNo);
+    bool ok = gRenderCache->Render(dm, pageNo, 0, zoom, nullptr, &pageRect, d->self, RenderPriority::Thumbnail);
+    if (!ok) {
+        t->pendingPages.RemoveAt(t->pendingPages.Find(pageNo));
+        delete d->self;
+        delete d;
+    }
+}
+
+static void PaintThumbnailStrip(ThumbnailStripInfo* t, HDC hdc, Rect rcPaint) {
+    Rect rc = ClientRect(t->hwnd);
+    HBRUSH brBg = CreateSolidBrush(ThemeControlBackgroundColor());
+    RECT tmpRc = ToRECT(rc);
+    FillRect(hdc, &tmpRc, brBg);
+    DeleteObject(brBg);
+    if (!t->dm || t->pageCount == 0 || t->cellDy == 0) {
+        return;
+    }
+
+    COLORREF txtCol = ThemeWindowTextColor();
+    HBRUSH brFrame = CreateSolidBrush(txtCol);
+    SetTextColor(hdc, txtCol);
+    SetBkMode(hdc, TRANSPARENT);
+    HFONT font = GetDefaultGuiFont();
+
+    int firstPage = t->scrollY / t->cellDy + 1;
+    for (int pageNo = firstPage; pageNo <= t->pageCount; pageNo++) {
+        Rect rCell = StripCellRect(t, pageNo);
+        if (rCell.y >= rc.dy) {
+            break;
+        }
+        if (rCell.y + rCell.dy <= rcPaint.y || rCell.y >= rcPaint.y + rcPaint.dy) {
+            continue;
+        }
+        Rect rThumb(t->padding, rCell.y + t->padding, t->thumbDx, t->thumbDy);
+        StripThumb* st = FindStripThumb(t, pageNo);
+        if (st) {
+            // center the bitmap inside the thumbnail box (pages narrower
+            // or shorter than the box get letterboxed)
+            Size bmpSize = st->bmp->GetSize();
+            int dx = std::min(bmpSize.dx, rThumb.dx);
+            int dy = std::min(bmpSize.dy, rThumb.dy);
+            Rect target(rThumb.x + (rThumb.dx - dx) / 2, rThumb.y + (rThumb.dy - dy) / 2, dx, dy);
+            st->bmp->Blit(hdc, target);
+            target.Inflate(1, 1);
+            tmpRc = ToRECT(target);
+            FrameRect(hdc, &tmpRc, brFrame);
+        } else {
+            tmpRc = ToRECT(rThumb);
+            FrameRect(hdc, &tmpRc, brFrame);
+            RequestThumbRendering(t, pageNo);
+        }
+        if (pageNo == t->win->currPageNo) {
+            // a double border marks the current page
+            Rect rSel = rThumb;
+            rSel.Inflate(2, 2);
+            tmpRc = ToRECT(rSel);
+            FrameRect(hdc, &tmpRc, brFrame);
+            rSel.Inflate(1, 1);
+            tmpRc = ToRECT(rSel);
+            FrameRect(hdc, &tmpRc, brFrame);
+        }
+        TempStr label = t->win->ctrl->GetPageLabeTemp(pageNo);
+        Rect rLabel(0, rCell.y + t->padding + t->thumbDy, t->stripDx, t->labelDy);
+        HdcDrawText(hdc, label, rLabel, DT_CENTER | DT_SINGLELINE | DT_VCENTER | DT_NOPREFIX, font);
+    }
+    DeleteObject(brFrame);
+}
+
+static void OnStripVScroll(ThumbnailStripInfo* t, WPARAM wp) {
+    SCROLLINFO si{};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_ALL | SIF_TRACKPOS;
+    GetScrollInfo(t->hwnd, SB_VERT, &si);
+
+    int y = t->scrollY;
+    switch (LOWORD(wp)) {
+        case SB_TOP:
+            y = 0;
+            break;
+        case SB_BOTTOM:
+            y = si.nMax;
+            break;
+        case SB_LINEUP:
+            y -= t->cellDy;
+            break;
+        case SB_LINEDOWN:
+            y += t->cellDy;
+            break;
+        case SB_PAGEUP:
+            y -= (int)si.nPage;
+            break;
+        case SB_PAGEDOWN:
+            y += (int)si.nPage;
+            break;
+        case SB_THUMBTRACK:
+        case SB_THUMBPOSITION:
+            y = si.nTrackPos;
+            break;
+    }
+    SetStripScrollY(t, y);
+}
+
+static void OnStripLButtonDown(ThumbnailStripInfo* t, int y) {
+    if (!t->dm || t->cellDy == 0) {
+        return;
+    }
+    int pageNo = (t->scrollY + y) / t->cellDy + 1;
+    if (pageNo < 1 || pageNo > t->pageCount) {
+        return;
+    }
+    t->win->ctrl->GoToPage(pageNo, true);
+}
+
+static LRESULT CALLBACK WndProcThumbnailStrip(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
+    MainWindow* win = FindMainWindowByHwnd(hwnd);
+    ThumbnailStripInfo* t = win ? win->thumbnailStrip : nullptr;
+    if (!t) {
+        return DefWindowProc(hwnd, msg, wp, lp);
+    }
+
+    switch (msg) {
+        case WM_ERASEBKGND:
+            // the background is filled in WM_PAINT
+            return TRUE;
+
+        case WM_PAINT: {
+            PAINTSTRUCT ps;
+            HDC hdc = BeginPaint(hwnd, &ps);
+            PaintThumbnailStrip(t, hdc, ToRect(ps.rcPaint));
+            EndPaint(hwnd, &ps);
+            return 0;
+        }
+
+        case WM_SIZE:
+            UpdateStripScrollbar(t);
+            // re-clamp after e.g. a maximize made the strip taller
+            SetStripScrollY(t, t->scrollY);
+            return 0;
+
+        case WM_VSCROLL:
+            OnStripVScroll(t, wp);
+            return 0;
+
+        case WM_MOUSEWHEEL: {
+            int delta = GET_WHEEL_DELTA_WPARAM(wp);
+            SetStripScrollY(t, t->scrollY - delta * t->cellDy / WHEEL_DELTA);
+            return 0;
+        }
+
+        case WM_LBUTTONDOWN:
+            OnStripLButtonDown(t, GET_Y_LPARAM(lp));
+            return 0;
+    }
+    return DefWindowProc(hwnd, msg, wp, lp);
+}
+
+void CreateThumbnailStrip(MainWindow* win) {
+    static ATOM gAtomThumbnailStrip = 0;
+    HMODULE h = GetModuleHandleW(nullptr);
+    if (!gAtomThumbnailStrip) {
+        WNDCLASSEX wcex = {};
+        FillWndClassEx(wcex, THUMBNAIL_STRIP_CLASS_NAME, WndProcThumbnailStrip);
+        gAtomThumbnailStrip = RegisterClassEx(&wcex);
+        ReportIf(!gAtomThumbnailStrip);
+    }
+
+    auto t = new ThumbnailStripInfo;
+    t->win = win;
+    DWORD dwStyle = WS_CHILD | WS_CLIPSIBLINGS | WS_VSCROLL;
+    t->hwnd = CreateWindowExW(0, THUMBNAIL_STRIP_CLASS_NAME, nullptr, dwStyle, 0, 0, 0, 0, win->hwndFrame, nullptr, h,
+                              nullptr);
+    ReportIf(!t->hwnd);
+    win->thumbnailStrip = t;
+}
+
+void DeleteThumbnailStrip(MainWindow* win) {
+    delete win->thumbnailStrip;
+    win->thumbnailStrip = nullptr;
+}
+
+int GetThumbnailStripDx(MainWindow* win) {
+    ThumbnailStripInfo* t = win->thumbnailStrip;
+    if (!t || !t->visible || !win->AsFixed()) {
+        return 0;
+    }
+    return t->stripDx;
+}
+
+void UpdateThumbnailStrip(MainWindow* win) {
+    ThumbnailStripInfo* t = win->thumbnailStrip;
+    if (!t) {
+        return;
+    }
+    DisplayModel* dm = win->AsFixed();
+    if (dm != t->dm) {
+        for (StripThumb& st : t->thumbs) {
+            delete st.bmp;
+        }
+        t->thumbs.Reset();
+        t->pendingPages.Reset();
+        t->scrollY = 0;
+        t->dm = dm;
+        t->pageCount = dm ? dm->PageCount() : 0;
+    }
+
+    if (dm) {
+        HWND hwnd = t->hwnd;
+        t->stripDx = DpiScale(hwnd, kThumbStripDx);
+        t->padding = DpiScale(hwnd, kThumbStripPadding);
+        t->labelDy = DpiScale(hwnd, kThumbStripLabelDy);
+        t->thumbDx = t->stripDx - 2 * t->padding;
+        // all cells share the first page's aspect ratio; unusually tall
+        // or wide pages get letterboxed rather than blowing up the cell
+        RectF pageRect = dm->GetEngine()->Transform(dm->GetEngine()->PageMediabox(1), 1, 1.0f, 0);
+        float aspect = 1.4142f; // ISO 216 fallback for empty first pages
+        if (pageRect.dx > 0 && pageRect.dy > 0) {
+            aspect = limitValue((float)(pageRect.dy / pageRect.dx), 0.5f, 2.0f);
+        }
+        t->thumbDy = (int)((float)t->thumbDx * aspect);
+        t->cellDy = t->padding + t->thumbDy + t->labelDy;
+    }
+
+    bool show = t->visible && dm != nullptr;
+    ShowWindow(t->hwnd, show ? SW_SHOW : SW_HIDE);
+    if (show) {
+        UpdateStripScrollbar(t);
+        ThumbnailStripPageChanged(win, win->currPageNo);
+        InvalidateRect(t->hwnd, nullptr, FALSE);
+    }
+}
+
+void ToggleThumbnailStrip(MainWindow* win) {
+    ThumbnailStripInfo* t = win->thumbnailStrip;
+    if (!t) {
+        return;
+    }
+    t->visible = !t->visible;
+    UpdateThumbnailStrip(win);
+    RelayoutWindow(win);
+}
+
+void ThumbnailStripPageChanged(MainWindow* win, int pageNo) {
+    ThumbnailStripInfo* t = win->thumbnailStrip;
+    if (!t || !t->visible || !t->dm || t->cellDy == 0) {
+        return;
+    }
+    if (pageNo < 1 || pageNo > t->pageCount) {
+        return;
+    }
+    Rect rc = ClientRect(t->hwnd);
+    int yTop = (pageNo - 1) * t->cellDy;
+    if (yTop < t->scrollY) {
+        SetStripScrollY(t, yTop);
+    } else if (yTop + t->cellDy > t->scrollY + rc.dy) {
+        SetStripScrollY(t, yTop + t->cellDy - rc.dy);
+    }
+    // move the current-page highlight
+    InvalidateRect(t->hwnd, nullptr, FALSE);
+}
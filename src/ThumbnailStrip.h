@@ -0,0 +1,57 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+struct MainWindow;
+struct DisplayModel;
+struct RenderedBitmap;
+
+// a page thumbnail kept by the strip; bitmaps are recycled in LRU order
+// so that the cache stays bounded no matter how long the document is
+struct StripThumb {
+    int pageNo = 0;
+    RenderedBitmap* bmp = nullptr;
+};
+
+/* A virtualized strip of page thumbnails at the left edge of the frame,
+   for quick visual navigation in long documents. Only the visible
+   thumbnails are ever rendered (at lowest priority, so that they never
+   compete with the visible page) which bounds the render cost even for
+   documents with thousands of pages. */
+struct ThumbnailStripInfo {
+    MainWindow* win = nullptr;
+    HWND hwnd = nullptr;
+    bool visible = false;
+
+    // the model the cached thumbnails belong to
+    DisplayModel* dm = nullptr;
+    int pageCount = 0;
+
+    // layout, recomputed in UpdateThumbnailStrip
+    int stripDx = 0;
+    int thumbDx = 0;
+    int thumbDy = 0;
+    int labelDy = 0;
+    int padding = 0;
+    int cellDy = 0;
+
+    int scrollY = 0;
+
+    // least recently used first
+    Vec<StripThumb> thumbs;
+    // pages with a render request in flight
+    Vec<int> pendingPages;
+
+    ~ThumbnailStripInfo();
+};
+
+void CreateThumbnailStrip(MainWindow*);
+void DeleteThumbnailStrip(MainWindow*);
+// syncs the strip with the current tab's document (also after tab switches
+// and document reloads); drops all cached thumbnails if the model changed
+void UpdateThumbnailStrip(MainWindow*);
+void ToggleThumbnailStrip(MainWindow*);
+// keeps the current page's thumbnail scrolled into view
+void ThumbnailStripPageChanged(MainWindow*, int pageNo);
+// width the strip takes up in the frame layout (0 when hidden or when
+// the current document doesn't support thumbnails)
+int GetThumbnailStripDx(MainWindow*);
@@ -7,6 +7,7 @@ extern "C" {
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/FileUtil.h"
 #include "utils/WinDynCalls.h"
 #include "utils/Dpi.h"
 #include "utils/WinUtil.h"
@@ -894,8 +895,60 @@ static void BlitPixmap(u8* dstSamples, ptrdiff_t dstStride, fz_pixmap* src, int
     }
 }
 
+// rasterizing all the toolbar SVGs takes long enough to be visible on
+// window creation and theme/dpi change, so finished strips are cached
+// on disk, one file per (size, colors). The hash of the SVG sources in
+// the header invalidates stale strips when icons change between builds
+struct IconsStripHeader {
+    u32 magic = kIconsStripMagic;
+    u32 svgHash = 0;
+    i32 dx = 0;
+    i32 dy = 0;
+    u32 fgCol = 0;
+    u32 bgCol = 0;
+
+    static constexpr u32 kIconsStripMagic = 0x74624931; // 'tbI1'
+};
+
+static u32 SvgIconsHash() {
+    u32 h = 0;
+    int nIcons = (int)TbIcon::kMax;
+    for (int i = 0; i < nIcons; i++) {
+        const char* svg = GetSvgIcon((TbIcon)i);
+        h = h * 31 + MurmurHash2(svg, str::Len(svg));
+    }
+    return h;
+}
+
+static TempStr IconsStripPathTemp(int dx, int dy, COLORREF fgCol, COLORREF bgCol) {
+    TempStr name = str::FormatTemp("toolbarIcons-%dx%d-%06x-%06x.dat", dx, dy, (u32)fgCol, (u32)bgCol);
+    return path::JoinTemp(GetNotImportantDataDirTemp(), name);
+}
+
+static bool LoadIconsStrip(const char* path, const IconsStripHeader& want, u8* pixels, size_t cbPixels) {
+    ByteSlice d = file::ReadFile(path);
+    if (!d.data()) {
+        return false;
+    }
+    bool ok = d.size() == sizeof(IconsStripHeader) + cbPixels;
+    if (ok) {
+        ok = memeq(d.data(), &want, sizeof(want));
+    }
+    if (ok) {
+        memcpy(pixels, d.data() + sizeof(want), cbPixels);
+    }
+    d.Free();
+    return ok;
+}
+
+static void SaveIconsStrip(const char* path, const IconsStripHeader& hdr, const u8* pixels, size_t cbPixels) {
+    str::Str d(sizeof(hdr) + cbPixels);
+    d.Append((const char*)&hdr, sizeof(hdr));
+    d.Append((const char*)pixels, cbPixels);
+    file::WriteFile(path, d.AsByteSlice());
+}
+
 static HBITMAP BuildIconsBitmap(int dx, int dy) {
-    fz_context* ctx = fz_new_context_windows();
     int nIcons = (int)TbIcon::kMax;
     int destDx = dx * nIcons;
     ptrdiff_t dstStride;
@@ -933,6 +986,23 @@ static HBITMAP BuildIconsBitmap(int dx, int dy) {
 
     COLORREF fgCol = ThemeWindowTextColor();
     COLORREF bgCol = ThemeControlBackgroundColor();
+
+    size_t cbPixels = (size_t)dstStride * dy;
+    IconsStripHeader hdr;
+    hdr.svgHash = SvgIconsHash();
+    hdr.dx = dx;
+    hdr.dy = dy;
+    hdr.fgCol = (u32)fgCol;
+    hdr.bgCol = (u32)bgCol;
+    TempStr cachePath = nullptr;
+    if (CanAccessDisk()) {
+        cachePath = IconsStripPathTemp(dx, dy, fgCol, bgCol);
+        if (LoadIconsStrip(cachePath, hdr, hbmpData, cbPixels)) {
+            return hbmp;
+        }
+    }
+
+    fz_context* ctx = fz_new_context_windows();
     for (int i = 0; i < nIcons; i++) {
         const char* svgData = GetSvgIcon((TbIcon)i);
         TempStr strokeCol = SerializeColorTemp(fgCol);
@@ -952,6 +1022,10 @@ static HBITMAP BuildIconsBitmap(int dx, int dy) {
     }
 
     fz_drop_context_windows(ctx);
+
+    if (cachePath) {
+        SaveIconsStrip(cachePath, hdr, hbmpData, cbPixels);
+    }
     return hbmp;
 }
 
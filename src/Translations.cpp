@@ -2,6 +2,7 @@
    License: Simplified BSD (see COPYING.BSD) */
 
 #include "utils/BaseUtil.h"
+#include "utils/Dict.h"
 #include "utils/WinUtil.h"
 
 #include "SumatraConfig.h"
@@ -27,6 +28,30 @@ static const char* gCurrLangCode = nullptr;
 static int gCurrLangIdx = 0;
 // for each translation: english string followed by a translation
 static StrVec* gTranslationCache = nullptr;
+// maps an english string to the index of its entry in gTranslationCache
+static dict::MapStrToInt* gTranslationIdx = nullptr;
+
+// direct-mapped cache from the address of a string literal passed to
+// GetTranslation() to its translation. Call sites pass the same literal
+// every time, so after the first call per site repeated lookups (menu,
+// toolbar and dialog rebuilds) become a pointer compare instead of a
+// string hash. Collisions just evict, which is always correct
+constexpr int kPtrCacheSize = 1024; // power of 2; we have ~700 strings
+struct PtrTransEntry {
+    const char* s;
+    const char* trans;
+};
+static PtrTransEntry gPtrTransCache[kPtrCacheSize];
+
+static PtrTransEntry& PtrTransSlot(const char* s) {
+    // >> 4: low bits of an address carry no entropy
+    u32 h = (u32)(((uintptr_t)s >> 4) * 2654435761u);
+    return gPtrTransCache[h & (kPtrCacheSize - 1)];
+}
+
+static void ClearPtrTransCache() {
+    memset(&gPtrTransCache, 0, sizeof(gPtrTransCache));
+}
 
 static TempStr UnescapeTemp(char* sOrig) {
     char* s = str::DupTemp(sOrig);
@@ -64,8 +89,11 @@ static TempStr UnescapeTemp(char* sOrig) {
 }
 
 static void FreeTranslations() {
+    ClearPtrTransCache();
     delete gTranslationCache;
     gTranslationCache = nullptr;
+    delete gTranslationIdx;
+    gTranslationIdx = nullptr;
 }
 
 static void ParseTranslationsTxt(const StrSpan& d, const char* langCode) {
@@ -83,8 +111,11 @@ static void ParseTranslationsTxt(const StrSpan& d, const char* langCode) {
     int nLines = lines.Size();
     logf("ParseTranslationsTxt: %d lines, nStrings: %d\n", nLines, nStrings);
 
+    ClearPtrTransCache();
     delete gTranslationCache;
     gTranslationCache = new StrVec();
+    delete gTranslationIdx;
+    gTranslationIdx = new dict::MapStrToInt(RoundToPowerOf2(nStrings * 2));
     auto c = gTranslationCache;
     int nUntranslated = 0;
 
@@ -111,6 +142,7 @@ static void ParseTranslationsTxt(const StrSpan& d, const char* langCode) {
             nUntranslated++;
         }
         TempStr unescaped = UnescapeTemp(orig);
+        gTranslationIdx->Insert(unescaped, c->Size());
         c->Append(unescaped);
         if (!trans) {
             c->Append(nullptr);
@@ -126,31 +158,44 @@ static void ParseTranslationsTxt(const StrSpan& d, const char* langCode) {
     }
 }
 
+// loads and parses the translations resource for the current language.
+// Deferred to the first lookup so that startup doesn't pay for it
+static void LoadTranslationsForCurrLang() {
+    StrSpan d = LoadDataResource(2);
+    ParseTranslationsTxt(d, gCurrLangCode);
+    str::Free(d);
+}
+
 // don't free
 const char* GetTranslation(const char* s) {
     if (gCurrLangIdx == 0) {
-        // 0 is english, no translation needed
+        // 0 is english and the source strings are the english strings,
+        // so no table is needed at all
         return s;
     }
-    auto c = gTranslationCache;
-    int n = c->Size();
-    ReportDebugIf(n % 2 != 0);
-    n = n / 2;
-    int sLen = str::Leni(s);
-    for (int i = 0; i < n; i++) {
-        int idx = i * 2;
-        StrSpan s2 = c->AtSpan(idx);
-        if (s2.Len() == sLen && str::Eq(s, s2.CStr())) {
-            auto tr = c->At(idx + 1);
-            if (!tr) {
-                logf("Didn't find translation for '%s'\n", s);
-                return s;
-            }
-            return tr;
-        }
+    PtrTransEntry& e = PtrTransSlot(s);
+    if (e.s == s) {
+        return e.trans;
+    }
+    if (!gTranslationIdx) {
+        // SetCurrentLangByCode() deferred the parsing to us
+        LoadTranslationsForCurrLang();
+    }
+    const char* res = s;
+    int idx;
+    if (!gTranslationIdx || !gTranslationIdx->Get(s, &idx)) {
+        ReportDebugIf(true);
+        return s;
     }
-    ReportDebugIf(true);
-    return s;
+    auto tr = gTranslationCache->At(idx + 1);
+    if (tr) {
+        res = tr;
+    } else {
+        logf("Didn't find translation for '%s'\n", s);
+    }
+    e.s = s;
+    e.trans = res;
+    return res;
 }
 
 int GetLangsCount() {
@@ -175,14 +220,17 @@ void SetCurrentLangByCode(const char* langCode) {
     ReportDebugIf(-1 == idx);
     gCurrLangIdx = idx;
     gCurrLangCode = GetLangCodeByIdx(idx);
-    if (idx == 0 && !gIsDebugBuild) {
-        // perf: in release builds we skip parsing translations for english
-        // in debug we want to execute this code to catch errors
-        return;
+    // drop the previous language's table; the new one is loaded lazily
+    // by the first GetTranslation() call, which keeps the parsing of the
+    // translations resource off the startup path entirely
+    FreeTranslations();
+    if (idx == 0 && gIsDebugBuild) {
+        // in release builds english never needs a table; in debug we
+        // still parse it to catch errors in the translations file
+        StrSpan d = LoadDataResource(2);
+        ParseTranslationsTxt(d, langCode);
+        str::Free(d);
     }
-    StrSpan d = LoadDataResource(2);
-    ParseTranslationsTxt(d, langCode);
-    str::Free(d);
 }
 
 const char* ValidateLangCode(const char* langCode) {
@@ -8,6 +8,7 @@
 #include "utils/HttpUtil.h"
 #include "utils/WinUtil.h"
 #include "utils/FileUtil.h"
+#include "utils/CryptoUtil.h"
 
 #include "wingui/Layout.h"
 #include "wingui/UIModels.h"
@@ -73,6 +74,8 @@ struct UpdateInfo {
     const char* portable32 = nullptr;
 
     const char* dlURL = nullptr;
+    // optional SHA-256 of the file at dlURL (hex), from the update info
+    const char* dlSha256 = nullptr;
     const char* installerPath = nullptr;
 
     UpdateInfo() = default;
@@ -85,6 +88,7 @@ struct UpdateInfo {
         str::Free(portableArm64);
         str::Free(portable32);
         str::Free(dlURL);
+        str::Free(dlSha256);
         str::Free(installerPath);
     }
 };
@@ -100,6 +104,10 @@ PortableExe64: https://www.sumatrapdfreader.org/dl/prerel/14276/SumatraPDF-prere
 PortableExe32: https://www.sumatrapdfreader.org/dl/prerel/14276/SumatraPDF-prerel.exe
 PortableZip64: https://www.sumatrapdfreader.org/dl/prerel/14276/SumatraPDF-prerel-64.zip
 PortableZip32: https://www.sumatrapdfreader.org/dl/prerel/14276/SumatraPDF-prerel.zip
+
+Optionally each of the downloads can have a SHA-256 (hex) under the
+same key with a Sha256 suffix, e.g. Installer64Sha256; when given, the
+downloaded file is verified against it
 */
 static UpdateInfo* ParseUpdateInfo(const char* d) {
     // if a user configures os-wide proxy that is not a regular ie proxy
@@ -137,15 +145,21 @@ static UpdateInfo* ParseUpdateInfo(const char* d) {
 
     // figure out which executable to download
     const char* dlURL = nullptr;
+    const char* shaKey = nullptr;
     bool isDll = IsDllBuild();
     if (IsArmBuild()) {
         dlURL = isDll ? res->installerArm64 : res->portableArm64;
+        shaKey = isDll ? "InstallerArm64Sha256" : "PortableExeArm64Sha256";
     } else if (IsProcess64()) {
         dlURL = isDll ? res->installer64 : res->portable64;
+        shaKey = isDll ? "Installer64Sha256" : "PortableExe64Sha256";
     } else {
         dlURL = isDll ? res->installer32 : res->portable32;
+        shaKey = isDll ? "Installer32Sha256" : "PortableExe32Sha256";
     }
     res->dlURL = str::Dup(dlURL);
+    // optional; when given, the download is verified against it
+    res->dlSha256 = str::Dup(node->GetValue(shaKey));
     return res;
 }
 
@@ -298,6 +312,13 @@ static void NotifyUserOfUpdate(UpdateInfo* updateInfo) {
 struct UpdateProgressData {
     HWND hwndForNotif = nullptr;
     i64 nDownloaded = 0;
+    // hashes the installer chunk by chunk as it's downloaded, so that
+    // the file is verified the moment the last byte arrives instead of
+    // in an extra pass before the update prompt
+    SHA2Incremental* hasher = nullptr;
+    const char* installerPath = nullptr;
+    i64 nHashed = 0;
+    bool hashFailed = false;
 };
 
 struct DownloadUpdateAsyncData {
@@ -332,8 +353,31 @@ static void UpdateDownloadProgressNotif(UpdateProgressData* data) {
     delete data;
 }
 
+// runs on the download thread, once per received chunk
 static void UpdateProgressCb(UpdateProgressData* data, HttpProgress* progress) {
     logf("UpdateProgressCb: n: %d\n", (int)progress->nDownloaded);
+    if (data->hasher && progress->chunk && !data->hashFailed) {
+        i64 chunkStart = progress->nDownloaded - (i64)progress->chunkSize;
+        if (data->nHashed == 0 && chunkStart > 0) {
+            // a resumed download: hash the part already on disk first
+            // (it includes this chunk, which was written before the
+            // callback, hence the cut at chunkStart)
+            ByteSlice d = file::ReadFile(data->installerPath);
+            if (d.size() >= (size_t)chunkStart) {
+                data->hasher->Update(d.data(), (size_t)chunkStart);
+                data->nHashed = chunkStart;
+            } else {
+                data->hashFailed = true;
+            }
+            d.Free();
+        }
+        if (!data->hashFailed && data->nHashed == chunkStart) {
+            data->hasher->Update(progress->chunk, progress->chunkSize);
+            data->nHashed = progress->nDownloaded;
+        } else {
+            data->hashFailed = true;
+        }
+    }
     auto fnData = new UpdateProgressData;
     fnData->hwndForNotif = data->hwndForNotif;
     fnData->nDownloaded = progress->nDownloaded;
@@ -341,24 +385,72 @@ static void UpdateProgressCb(UpdateProgressData* data, HttpProgress* progress) {
     uitask::Post(fn, nullptr);
 }
 
+// validates the downloaded installer: SHA-256 against the digest from
+// the update info (when given) and, for signed builds, the Authenticode
+// signature. Runs on the download thread, right after the last byte;
+// most of the hashing already happened while the download was in flight
+static bool VerifyUpdateDownload(UpdateInfo* updateInfo, const char* installerPath, UpdateProgressData* pd) {
+    if (updateInfo->dlSha256) {
+        u8 digest[32] = {0};
+        bool haveDigest = false;
+        i64 fileSize = file::GetSize(installerPath);
+        if (!pd->hashFailed && pd->nHashed == fileSize && fileSize > 0) {
+            haveDigest = pd->hasher->Finish(digest);
+        }
+        if (!haveDigest) {
+            // streamed hashing didn't cover the whole file (e.g. the
+            // resumed download had nothing left to fetch), redo it
+            // from disk
+            ByteSlice d = file::ReadFile(installerPath);
+            haveDigest = !d.empty();
+            if (haveDigest) {
+                CalcSHA2Digest(d.data(), d.Size(), digest);
+            }
+            d.Free();
+        }
+        AutoFreeStr hex = str::MemToHex(digest, dimof(digest));
+        if (!haveDigest || !str::EqI(hex, updateInfo->dlSha256)) {
+            logf("VerifyUpdateDownload: SHA-256 mismatch: got %s, wanted %s\n", hex.Get(), updateInfo->dlSha256);
+            return false;
+        }
+    }
+    // a signed build only updates to a signed installer
+    if (IsSumatraSigned() && !IsPEFileSigned(installerPath)) {
+        logf("VerifyUpdateDownload: '%s' has no valid signature\n", installerPath);
+        return false;
+    }
+    return true;
+}
+
 static void DownloadUpdateAsync(DownloadUpdateAsyncData* data) {
     auto hwndForNotif = data->hwndForNotif;
     auto updateInfo = data->updateInfo;
 
-    TempStr installerPath = GetTempFilePathTemp("sumatra-installer");
+    // stable, version-specific name so that an interrupted download can
+    // be resumed on the next check instead of starting over.
     // the installer must be named .exe or it won't be able to self-elevate
     // with "runas"
-    installerPath = str::JoinTemp(installerPath, ".exe");
+    TempStr name = str::FormatTemp("SumatraPDF-update-%s.exe", updateInfo->latestVer);
+    TempStr installerPath = path::JoinTemp(GetTempDirTemp(), name);
     UpdateProgressData pd;
     pd.hwndForNotif = hwndForNotif;
+    SHA2Incremental hasher;
+    if (updateInfo->dlSha256) {
+        pd.hasher = &hasher;
+        pd.installerPath = installerPath;
+    }
     auto cb = MkFunc1<UpdateProgressData, HttpProgress*>(UpdateProgressCb, &pd);
-    bool ok = HttpGetToFile(updateInfo->dlURL, installerPath, cb);
+    bool ok = HttpGetToFile(updateInfo->dlURL, installerPath, cb, true);
     logf("ShowAutoUpdateDialog: HttpGetToFile(): ok=%d, downloaded to '%s'\n", (int)ok, installerPath);
+    if (ok && !VerifyUpdateDownload(updateInfo, installerPath, &pd)) {
+        // a corrupt download would never verify, so don't resume it
+        file::Delete(installerPath);
+        ok = false;
+    }
     if (ok) {
         updateInfo->installerPath = str::Dup(installerPath);
-    } else {
-        file::Delete(installerPath);
     }
+    // on failure the partial download is kept for the next attempt to resume
 
     // process the rest on ui thread to avoid threading issues
     auto fn = MkFunc0<DownloadUpdateAsyncData>(DownloadUpdateFinish, data);
@@ -456,7 +548,7 @@ static DWORD MaybeStartUpdateDownload(HWND hwndParent, HttpRsp* rsp, UpdateCheck
     fnData->hwndForNotif = hwndForNotif;
     fnData->updateInfo = updateInfo;
     auto fn = MkFunc0<DownloadUpdateAsyncData>(DownloadUpdateAsync, fnData);
-    RunAsync(fn, "DownloadUpdateAsync");
+    RunAsync(fn, "DownloadUpdateAsync", ThreadQoS::Background);
     return 0;
 }
 
@@ -575,7 +667,7 @@ void StartAsyncUpdateCheck(MainWindow* win, UpdateCheck updateCheckType) {
     data->win = win;
     data->updateCheckType = updateCheckType;
     auto fn = MkFunc0<UpdateCheckAsyncData>(UpdateCheckAsync, data);
-    RunAsync(fn, "UpdateCheckAsync");
+    RunAsync(fn, "UpdateCheckAsync", ThreadQoS::Background);
 }
 
 // the assumption is that this is a portable version downloaded to temp directory
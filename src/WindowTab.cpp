@@ -44,11 +44,16 @@ WindowTab::~WindowTab() {
         AsChm()->RemoveParentHwnd();
     }
     delete selectionOnPage;
+    delete tocFlatIndex;
     // technically we only need to clear ctrl == gMostRecentlyOpenedDoc
     // but gMostRecentlyOpenedDoc is only for dde commands
     // so doesn't need to be kept for long
     gMostRecentlyOpenedDoc = nullptr;
+    FlushDelayedClipboard(this);
     delete ctrl;
+    if (preloadedEngine) {
+        preloadedEngine->Release();
+    }
     str::FreePtr(&filePath);
     str::FreePtr(&frameTitle);
 }
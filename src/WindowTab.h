@@ -6,6 +6,16 @@ struct WatchedFile;
 struct EditAnnotationsWindow;
 struct MainWindow;
 
+// flattened table of contents for the command palette's section search:
+// one entry per ToC item with a "chapter / section" breadcrumb label and
+// its page number already resolved. Built once per document on a
+// background thread (see BuildTocFlatIndexAsync) so that jumping to a
+// section is a palette keystroke with no tree walk at query time
+struct TocFlatIndex {
+    StrVec labels;  // breadcrumb labels, in document order
+    Vec<int> pages; // page each entry points to
+};
+
 /* Data related to a single document loaded into a tab/window */
 /* (none of these depend on MainWindow, so that a WindowTab could
    be moved between windows once this is supported) */
@@ -26,6 +36,11 @@ struct WindowTab {
     bool showTocPresentation = false;
     // an array of ids for ToC items that have been expanded/collapsed by user
     Vec<int> tocState;
+    // fingerprint and topmost visible item of the ToC tree when it was
+    // last cleared; a reload that doesn't change the bookmarks restores
+    // the scroll position from them (see LoadTocTree)
+    u32 tocFingerprint = 0;
+    int tocFirstVisibleId = 0;
     // canvas dimensions when the document was last visible
     Rect canvasRc;
     // whether to auto-reload the document when the tab is selected
@@ -39,6 +54,8 @@ struct WindowTab {
     float prevZoomVirtual{kInvalidZoom};
     DisplayMode prevDisplayMode{DisplayMode::Automatic};
     TocTree* currToc = nullptr; // not owned by us
+    // owned; replaced from a uitask when the background build finishes
+    TocFlatIndex* tocFlatIndex = nullptr;
     EditAnnotationsWindow* editAnnotsWindow = nullptr;
     Rect lastEditAnnotsWindowPos = {};
 
@@ -46,6 +63,19 @@ struct WindowTab {
     bool askedToSaveAnnotations = false;
 
     TabState* tabState = nullptr; // when lazy loading
+    // engine built ahead of time by session restore; consumed by
+    // ReloadDocument() when the tab is first activated
+    EngineBase* preloadedEngine = nullptr;
+    // GetTickCount() of when this tab was last the current tab,
+    // used to hibernate long-idle tabs (TabHibernationTimeoutInMin)
+    DWORD lastActiveTime = 0;
+    // CurrentPageNo() for which idle-time prerendering of likely
+    // navigation targets was last queued (see OnMessageLoopIdle)
+    int idlePrerenderPageNo = 0;
+    // progress of the idle scrubbing-preview pass, see
+    // QueueIdlePreviewRender
+    int idlePreviewPageNo = 0;
+    int idlePreviewRotation = 0;
 
     Annotation* selectedAnnotation = nullptr;
     bool didScrollToSelectedAnnotation = false; // only automatically scroll once
@@ -163,13 +163,14 @@ protected:
 
 public:
     FilterBase(long *plRefCount) : m_lRef(1), m_plModuleRef(plRefCount),
-        m_dwChunkId(0), m_iText(0), m_pStream(nullptr) {
+        m_dwChunkId(0), m_iText(0), m_pStream(nullptr), m_pszFilePath(nullptr) {
         InterlockedIncrement(m_plModuleRef);
     }
 
     virtual ~FilterBase() {
         if (m_pStream)
             m_pStream->Release();
+        free(m_pszFilePath);
         InterlockedDecrement(m_plModuleRef);
     }
 
@@ -272,6 +273,8 @@ public:
 
     // IInitializeWithStream
     IFACEMETHODIMP Initialize(IStream *pStm, __unused DWORD grfMode) {
+        free(m_pszFilePath);
+        m_pszFilePath = nullptr;
         if (m_pStream)
             m_pStream->Release();
         m_pStream = pStm;
@@ -309,6 +312,8 @@ public:
         }
         HRESULT res = Initialize(pStm, 0);
         pStm->Release();
+        if (SUCCEEDED(res))
+            m_pszFilePath = _wcsdup(pszFileName);
         return res;
     }
     IFACEMETHODIMP Save(__unused LPCOLESTR pszFileName, __unused BOOL bRemember) { return E_NOTIMPL; }
@@ -317,6 +322,9 @@ public:
 
 protected:
     IStream*                    m_pStream;
+    // only set when initialized through IPersistFile::Load;
+    // IInitializeWithStream doesn't tell us the file's path
+    PWSTR                       m_pszFilePath;
 
 private:
     long                        m_lRef, * m_plModuleRef;
@@ -2,7 +2,9 @@
    License: GPLv3 */
 
 #include "utils/BaseUtil.h"
+#include "utils/FileUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/ThreadUtil.h"
 #include "utils/WinUtil.h"
 
 #include "wingui/UIModels.h"
@@ -18,8 +20,207 @@
 
 #include "utils/Log.h"
 
+/* The text of all pages, extracted in a single background pass over the
+   document so that GetChunk() only has to hand out finished strings
+   instead of parsing one page per call. Ref-counted because it's shared
+   between the filter, the extraction thread and the engine cache. */
+struct PdfFilterDocText {
+    Mutex mu;
+    // signaled after each extracted page (and once more when finished)
+    HANDLE pageExtracted = nullptr;
+    // per-page text with "\n" already converted to "\r\n";
+    // nullptr for pages without text
+    Vec<WCHAR*> pages;
+    bool finished = false;
+    // set by CleanUp() to stop the extraction thread early
+    bool abort = false;
+    // the extraction thread stopped before reaching the last page
+    bool aborted = false;
+    LONG refs = 1;
+
+    PdfFilterDocText() {
+        pageExtracted = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    }
+    ~PdfFilterDocText() {
+        for (WCHAR* s : pages) {
+            str::Free(s);
+        }
+        CloseHandle(pageExtracted);
+    }
+    void AddRef() {
+        InterlockedIncrement(&refs);
+    }
+    void Release() {
+        if (0 == InterlockedDecrement(&refs)) {
+            delete this;
+        }
+    }
+};
+
+struct ExtractPageTextData {
+    EngineBase* engine = nullptr;        // we hold a reference
+    PdfFilterDocText* docText = nullptr; // we hold a reference
+};
+
+static void ExtractPageTextThread(ExtractPageTextData* d) {
+    EngineBase* engine = d->engine;
+    PdfFilterDocText* docText = d->docText;
+    int nPages = engine->PageCount();
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        docText->mu.Lock();
+        bool abort = docText->abort;
+        docText->mu.Unlock();
+        if (abort) {
+            docText->mu.Lock();
+            docText->aborted = true;
+            docText->mu.Unlock();
+            break;
+        }
+        PageText pageText = engine->ExtractPageText(pageNo);
+        WCHAR* s = nullptr;
+        if (!str::IsEmpty(pageText.text)) {
+            s = str::Replace(pageText.text, L"\n", L"\r\n");
+        }
+        FreePageText(&pageText);
+        docText->mu.Lock();
+        docText->pages.Append(s);
+        docText->mu.Unlock();
+        SetEvent(docText->pageExtracted);
+    }
+    docText->mu.Lock();
+    docText->finished = true;
+    docText->mu.Unlock();
+    SetEvent(docText->pageExtracted);
+    engine->Release();
+    docText->Release();
+    delete d;
+}
+
+/* Windows Search tends to index the same document several times in a row
+   (and ifilttst.exe opens it once per test pass). Keep the most recently
+   parsed documents around, keyed by path, so that re-entrant indexing
+   calls don't have to parse the PDF again. Only engages when the filter
+   was initialized through IPersistFile as IInitializeWithStream doesn't
+   tell us the path. */
+constexpr int kMaxCachedEngines = 4;
+
+struct CachedEngine {
+    WCHAR* filePath = nullptr;
+    FILETIME modTime{};
+    EngineBase* engine = nullptr;        // we hold a reference
+    PdfFilterDocText* docText = nullptr; // we hold a reference
+
+    ~CachedEngine() {
+        str::Free(filePath);
+        if (engine) {
+            engine->Release();
+        }
+        if (docText) {
+            docText->Release();
+        }
+    }
+};
+
+static Mutex gEngineCacheMu;
+// most recently used entries are at the end
+static Vec<CachedEngine*> gEngineCache;
+
+static FILETIME GetFileModTime(const WCHAR* filePath) {
+    FILETIME res{};
+    WIN32_FILE_ATTRIBUTE_DATA fileInfo;
+    if (GetFileAttributesExW(filePath, GetFileExInfoStandard, &fileInfo)) {
+        res = fileInfo.ftLastWriteTime;
+    }
+    return res;
+}
+
+// the caller gets a reference to the engine and, if the text was fully
+// extracted by a previous indexing call, to the extracted text as well
+static EngineBase* FindCachedEngine(const WCHAR* filePath, PdfFilterDocText** docTextOut) {
+    FILETIME modTime = GetFileModTime(filePath);
+    EngineBase* engine = nullptr;
+    gEngineCacheMu.Lock();
+    for (int i = 0; i < gEngineCache.Size(); i++) {
+        CachedEngine* e = gEngineCache.At(i);
+        if (!str::EqI(e->filePath, filePath)) {
+            continue;
+        }
+        if (!FileTimeEq(e->modTime, modTime)) {
+            // the file has changed since we last parsed it
+            gEngineCache.RemoveAt(i);
+            delete e;
+            break;
+        }
+        engine = e->engine;
+        engine->AddRef();
+        e->docText->mu.Lock();
+        bool textUsable = e->docText->finished && !e->docText->aborted;
+        e->docText->mu.Unlock();
+        if (textUsable) {
+            e->docText->AddRef();
+            *docTextOut = e->docText;
+        }
+        // move to the end of the list (most recently used)
+        gEngineCache.RemoveAt(i);
+        gEngineCache.Append(e);
+        break;
+    }
+    gEngineCacheMu.Unlock();
+    return engine;
+}
+
+static void RememberCachedEngine(const WCHAR* filePath, EngineBase* engine, PdfFilterDocText* docText) {
+    gEngineCacheMu.Lock();
+    CachedEngine* e = nullptr;
+    for (CachedEngine* cached : gEngineCache) {
+        if (str::EqI(cached->filePath, filePath)) {
+            e = cached;
+            break;
+        }
+    }
+    if (!e) {
+        e = new CachedEngine();
+        e->filePath = str::Dup(filePath);
+        gEngineCache.Append(e);
+    }
+    e->modTime = GetFileModTime(filePath);
+    if (e->engine != engine) {
+        if (e->engine) {
+            e->engine->Release();
+        }
+        engine->AddRef();
+        e->engine = engine;
+    }
+    if (e->docText != docText) {
+        if (e->docText) {
+            e->docText->Release();
+        }
+        docText->AddRef();
+        e->docText = docText;
+    }
+    while (gEngineCache.Size() > kMaxCachedEngines) {
+        CachedEngine* old = gEngineCache.PopAt(0);
+        delete old;
+    }
+    gEngineCacheMu.Unlock();
+}
+
 VOID PdfFilter::CleanUp() {
     logf("PdfFilter::Cleanup()\n");
+    if (m_docText) {
+        m_docText->mu.Lock();
+        m_docText->abort = true;
+        m_docText->mu.Unlock();
+    }
+    if (m_extractThread) {
+        WaitForSingleObject(m_extractThread, INFINITE);
+        CloseHandle(m_extractThread);
+        m_extractThread = nullptr;
+    }
+    if (m_docText) {
+        m_docText->Release();
+        m_docText = nullptr;
+    }
     if (m_pdfEngine) {
         m_pdfEngine->Release();
         m_pdfEngine = nullptr;
@@ -31,26 +232,51 @@ HRESULT PdfFilter::OnInit() {
     logf("PdfFilter::OnInit()\n");
     CleanUp();
 
-    // TODO: EngineMupdf::CreateFromStream never returns with
-    //       m_pStream instead of a clone - why?
+    // if we were initialized through IPersistFile we know the path and
+    // can reuse an engine opened by a previous indexing call
+    if (m_pszFilePath) {
+        m_pdfEngine = FindCachedEngine(m_pszFilePath, &m_docText);
+    }
+
+    if (!m_pdfEngine) {
+        // TODO: EngineMupdf::CreateFromStream never returns with
+        //       m_pStream instead of a clone - why?
+
+        // load content of PDF document into a seekable stream
+        HRESULT res;
+        ByteSlice data = GetDataFromStream(m_pStream, &res);
+        if (data.empty()) {
+            return res;
+        }
+
+        IStream* strm = CreateStreamFromData(data);
+        data.Free();
+        ScopedComPtr<IStream> stream(strm);
+        if (!stream) {
+            return E_FAIL;
+        }
 
-    // load content of PDF document into a seekable stream
-    HRESULT res;
-    ByteSlice data = GetDataFromStream(m_pStream, &res);
-    if (data.empty()) {
-        return res;
+        m_pdfEngine = CreateEngineMupdfFromStream(stream, "foo.pdf");
+        if (!m_pdfEngine) {
+            return E_FAIL;
+        }
     }
 
-    IStream* strm = CreateStreamFromData(data);
-    data.Free();
-    ScopedComPtr<IStream> stream(strm);
-    if (!stream) {
-        return E_FAIL;
+    // extract the text of all pages in one background pass;
+    // GetNextChunkValue() serves the pages as they become available
+    if (!m_docText) {
+        m_docText = new PdfFilterDocText();
+        auto d = new ExtractPageTextData();
+        m_pdfEngine->AddRef();
+        d->engine = m_pdfEngine;
+        m_docText->AddRef();
+        d->docText = m_docText;
+        auto fn = MkFunc0(ExtractPageTextThread, d);
+        m_extractThread = StartThread(fn, "PdfFilterExtract");
     }
 
-    m_pdfEngine = CreateEngineMupdfFromStream(stream, "foo.pdf");
-    if (!m_pdfEngine) {
-        return E_FAIL;
+    if (m_pszFilePath) {
+        RememberCachedEngine(m_pszFilePath, m_pdfEngine, m_docText);
     }
 
     m_state = PdfFilterState::Start;
@@ -134,18 +360,32 @@ HRESULT PdfFilter::GetNextChunkValue(ChunkValue& chunkValue) {
             [[fallthrough]];
 
         case PdfFilterState::Content:
-            while (++m_iPageNo <= m_pdfEngine->PageCount()) {
-                PageText pageText = m_pdfEngine->ExtractPageText(m_iPageNo);
-                if (str::IsEmpty(pageText.text)) {
-                    FreePageText(&pageText);
-                    continue;
+            for (;;) {
+                bool haveNext = false;
+                bool finished = false;
+                WCHAR* pageText = nullptr;
+                m_docText->mu.Lock();
+                if (m_iPageNo < m_docText->pages.Size()) {
+                    haveNext = true;
+                    pageText = m_docText->pages.At(m_iPageNo++);
+                } else {
+                    finished = m_docText->finished;
                 }
-                ws = pageText.text;
-                WCHAR* str = str::Replace(ws, L"\n", L"\r\n");
-                chunkValue.SetTextValue(PKEY_Search_Contents, str, CHUNK_TEXT);
-                str::FreePtr(&str);
-                FreePageText(&pageText);
-                return S_OK;
+                m_docText->mu.Unlock();
+                if (haveNext) {
+                    if (!pageText) {
+                        // a page without text
+                        continue;
+                    }
+                    // the text stays owned by m_docText
+                    chunkValue.SetTextValue(PKEY_Search_Contents, pageText, CHUNK_TEXT);
+                    return S_OK;
+                }
+                if (finished) {
+                    break;
+                }
+                // the extraction thread hasn't caught up with us yet
+                WaitForSingleObject(m_docText->pageExtracted, 50);
             }
             m_state = PdfFilterState::End;
 
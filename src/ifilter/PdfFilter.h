@@ -5,6 +5,7 @@ constexpr const char* kPdfFilterStateStrs = "start\0author\0title\0data\0content
 enum class PdfFilterState { Start = 0, Author, Title, Date, Content, End };
 
 class EngineBase;
+struct PdfFilterDocText;
 
 class PdfFilter : public FilterBase
 {
@@ -24,6 +25,10 @@ public:
 
 private:
     PdfFilterState m_state{PdfFilterState::End};
+    // index of the next page to serve from m_docText->pages
     int m_iPageNo = -1;
     EngineBase *m_pdfEngine = nullptr;
+    // text of all pages, filled in by a background thread (we hold a reference)
+    PdfFilterDocText *m_docText = nullptr;
+    HANDLE m_extractThread = nullptr;
 };
@@ -157,13 +157,12 @@ void GraphicsCacheEntry::Free() const {
 void Initialize() {
     InitializeCriticalSection(&gMuiCs);
     gGraphicsCache = new Vec<GraphicsCacheEntry>();
-    // allocate the first entry in gGraphicsCache for UI thread, ref count
-    // ensures it stays alive forever
-    AllocGraphicsForMeasureText();
+    // the Graphics used for measuring text is created lazily by
+    // AllocGraphicsForMeasureText() so that startup doesn't pay for
+    // creating GDI+ objects it might not need
 }
 
 void Destroy() {
-    FreeGraphicsForMeasureText(gGraphicsCache->at(0).gfx);
     for (GraphicsCacheEntry& e : *gGraphicsCache) {
         e.Free();
     }
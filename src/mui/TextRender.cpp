@@ -39,6 +39,79 @@ using Gdiplus::StringFormatFlagsDirectionRightToLeft;
 
 namespace mui {
 
+// number of entries in MeasuredTextCache; at ~20 bytes per entry this
+// costs 20KB per text renderer, enough for several ebook pages worth
+// of distinct words
+constexpr u32 kMeasuredTextCacheSize = 1024;
+
+MeasuredTextCache::~MeasuredTextCache() {
+    free(entries);
+}
+
+static u32 MeasuredTextSlot(CachedFont* font, const void* s, size_t nBytes, u32& hashOut) {
+    u32 hash = MurmurHash2(s, nBytes);
+    // fold the font in so that the same word in a different font
+    // doesn't map to the same slot with the same hash
+    hashOut = hash ^ (u32)(uintptr_t)font;
+    return hashOut % kMeasuredTextCacheSize;
+}
+
+bool MeasuredTextCache::Get(CachedFont* font, const WCHAR* s, size_t sLen, RectF& bbOut) {
+    if (!entries) {
+        return false;
+    }
+    u32 hash;
+    u32 slot = MeasuredTextSlot(font, s, sLen * sizeof(WCHAR), hash);
+    Entry& e = entries[slot];
+    if (e.font != font || e.hash != hash || e.len != (u32)sLen) {
+        return false;
+    }
+    bbOut = RectF(0.0f, 0.0f, e.dx, e.dy);
+    return true;
+}
+
+void MeasuredTextCache::Remember(CachedFont* font, const WCHAR* s, size_t sLen, RectF bb) {
+    if (!entries) {
+        entries = AllocArray<Entry>(kMeasuredTextCacheSize);
+    }
+    u32 hash;
+    u32 slot = MeasuredTextSlot(font, s, sLen * sizeof(WCHAR), hash);
+    Entry& e = entries[slot];
+    e.font = font;
+    e.hash = hash;
+    e.len = (u32)sLen;
+    e.dx = bb.dx;
+    e.dy = bb.dy;
+}
+
+bool MeasuredTextCache::Get(CachedFont* font, const char* s, size_t sLen, RectF& bbOut) {
+    if (!entries) {
+        return false;
+    }
+    u32 hash;
+    u32 slot = MeasuredTextSlot(font, s, sLen, hash);
+    Entry& e = entries[slot];
+    if (e.font != font || e.hash != hash || e.len != (u32)sLen) {
+        return false;
+    }
+    bbOut = RectF(0.0f, 0.0f, e.dx, e.dy);
+    return true;
+}
+
+void MeasuredTextCache::Remember(CachedFont* font, const char* s, size_t sLen, RectF bb) {
+    if (!entries) {
+        entries = AllocArray<Entry>(kMeasuredTextCacheSize);
+    }
+    u32 hash;
+    u32 slot = MeasuredTextSlot(font, s, sLen, hash);
+    Entry& e = entries[slot];
+    e.font = font;
+    e.hash = hash;
+    e.len = (u32)sLen;
+    e.dx = bb.dx;
+    e.dy = bb.dy;
+}
+
 TextRenderGdi* TextRenderGdi::Create(Graphics* gfx) {
     TextRenderGdi* res = new TextRenderGdi();
     res->gfx = gfx;
@@ -121,9 +194,14 @@ float TextRenderGdi::GetCurrFontLineSpacing() {
 }
 
 RectF TextRenderGdi::Measure(const WCHAR* s, size_t sLen) {
+    RectF res;
+    if (measureCache.Get(currFont, s, sLen, res)) {
+        return res;
+    }
     SIZE txtSize;
     GetTextExtentPoint32W(hdcForTextMeasure, s, (int)sLen, &txtSize);
-    RectF res(0.0f, 0.0f, (float)txtSize.cx, (float)txtSize.cy);
+    res = RectF(0.0f, 0.0f, (float)txtSize.cx, (float)txtSize.cy);
+    measureCache.Remember(currFont, s, sLen, res);
     return res;
 }
 
@@ -318,14 +396,20 @@ float TextRenderGdiplus::GetCurrFontLineSpacing() {
 
 RectF TextRenderGdiplus::Measure(const WCHAR* s, size_t sLen) {
     ReportIf(!currFont);
-    return MeasureText(gfx, currFont->font, s, sLen, measureAlgo);
+    RectF res;
+    if (measureCache.Get(currFont, s, sLen, res)) {
+        return res;
+    }
+    res = MeasureText(gfx, currFont->font, s, sLen, measureAlgo);
+    measureCache.Remember(currFont, s, sLen, res);
+    return res;
 }
 
 RectF TextRenderGdiplus::Measure(const char* s, size_t sLen) {
     ReportIf(!currFont);
     WCHAR* buf = ToWStrTemp(s, sLen);
     size_t strLen = str::Len(buf);
-    return MeasureText(gfx, currFont->font, buf, strLen, measureAlgo);
+    return Measure(buf, strLen);
 }
 
 TextRenderGdiplus::~TextRenderGdiplus() {
@@ -445,10 +529,15 @@ RectF TextRenderHdc::Measure(const char* s, size_t sLen) {
 }
 
 RectF TextRenderHdc::Measure(const WCHAR* s, size_t sLen) {
-    SIZE txtSize;
     ReportIf(!hdc);
+    RectF res;
+    if (measureCache.Get(currFont, s, sLen, res)) {
+        return res;
+    }
+    SIZE txtSize;
     GetTextExtentPoint32W(hdc, s, (int)sLen, &txtSize);
-    RectF res(0.0f, 0.0f, (float)txtSize.cx, (float)txtSize.cy);
+    res = RectF(0.0f, 0.0f, (float)txtSize.cx, (float)txtSize.cy);
+    measureCache.Remember(currFont, s, sLen, res);
     return res;
 }
 
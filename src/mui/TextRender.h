@@ -10,6 +10,30 @@ enum class TextRenderMethod {
     // TextRenderDirectDraw
 };
 
+/* Remembers the result of measuring a string with a given font. Ebook
+layout measures the same words over and over (each re-layout and each
+StringLenForWidth() bisection), so skipping the GDI/GDI+ round-trip for
+strings we've seen before is a big win. Direct-mapped: a colliding
+entry is simply overwritten. */
+struct MeasuredTextCache {
+    struct Entry {
+        CachedFont* font = nullptr;
+        u32 hash = 0;
+        u32 len = 0;
+        float dx = 0.f;
+        float dy = 0.f;
+    };
+    // allocated on first use (not all ITextRender users measure text)
+    Entry* entries = nullptr;
+
+    ~MeasuredTextCache();
+    bool Get(CachedFont* font, const WCHAR* s, size_t sLen, RectF& bbOut);
+    void Remember(CachedFont* font, const WCHAR* s, size_t sLen, RectF bb);
+    // same, keyed on utf8 bytes (don't mix both keyings in one cache)
+    bool Get(CachedFont* font, const char* s, size_t sLen, RectF& bbOut);
+    void Remember(CachedFont* font, const char* s, size_t sLen, RectF bb);
+};
+
 class ITextRender {
   public:
     virtual void SetFont(CachedFont* font) = 0;
@@ -40,6 +64,9 @@ class ITextRender {
     ;
 
     TextRenderMethod method = TextRenderMethod::Hdc;
+
+  protected:
+    MeasuredTextCache measureCache;
 };
 
 class TextRenderGdi : public ITextRender {
@@ -81,14 +81,24 @@ IFACEMETHODIMP PreviewBase::GetThumbnail(uint cx, HBITMAP* phbmp, WTS_ALPHATYPE*
     return hthumb ? S_OK : E_NOTIMPL;
 }
 
+// number of rendered pages kept around so that flipping back and forth
+// re-paints from cache instead of re-rasterizing
+constexpr int kMaxCachedPreviewPages = 4;
+
+struct CachedPreviewPage {
+    int pageNo = 0;
+    // due to rounding differences, bmp->Size() and size can differ slightly
+    Size size;
+    RenderedBitmap* bmp = nullptr;
+    DWORD lastUse = 0;
+};
+
 class PageRenderer {
     EngineBase* engine = nullptr;
     HWND hwnd = nullptr;
 
-    int currPage = 0;
-    RenderedBitmap* currBmp = nullptr;
-    // due to rounding differences, currBmp->Size() and currSize can differ slightly
-    Size currSize;
+    // most recently rendered pages, protected by currAccess
+    Vec<CachedPreviewPage*> cache;
     int reqPage = 0;
     float reqZoom = 0.f;
     Size reqSize = {};
@@ -115,7 +125,10 @@ class PageRenderer {
         if (thread) {
             WaitForSingleObject(thread, INFINITE);
         }
-        delete currBmp;
+        for (CachedPreviewPage* page : cache) {
+            delete page->bmp;
+            delete page;
+        }
         DeleteCriticalSection(&currAccess);
     }
 
@@ -136,14 +149,29 @@ class PageRenderer {
         log("PageRenderer::Render()\n");
 
         ScopedCritSec scope(&currAccess);
-        if (currBmp && currPage == pageNo && currSize == target.Size()) {
-            currBmp->Blit(hdc, target);
-        } else if (!thread) {
+        CachedPreviewPage* cached = FindCached(pageNo);
+        if (cached) {
+            cached->lastUse = GetTickCount();
+            // Blit() scales, so a bitmap rendered for a slightly different
+            // pane size still paints fine
+            cached->bmp->Blit(hdc, target);
+            if (!NeedsRerender(cached->size, target.Size())) {
+                return;
+            }
+            // the pane was resized past the threshold:
+            // re-rasterize at exactly the new size
+        }
+        if (!thread) {
             reqPage = pageNo;
             reqZoom = zoom;
             reqSize = target.Size();
             reqAbort = false;
             thread = CreateThread(nullptr, 0, RenderThread, this, 0, nullptr);
+            if (thread) {
+                // rendering is only for preview; don't compete with the process
+                // hosting the preview pane
+                SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+            }
         } else if (reqPage != pageNo || reqSize != target.Size()) {
             if (abortCookie) {
                 abortCookie->Abort();
@@ -153,6 +181,57 @@ class PageRenderer {
     }
 
   protected:
+    // caller must hold currAccess; AddToCache() keeps at most one
+    // bitmap per page, so no size disambiguation is needed
+    CachedPreviewPage* FindCached(int pageNo) {
+        for (CachedPreviewPage* page : cache) {
+            if (page->pageNo == pageNo) {
+                return page;
+            }
+        }
+        return nullptr;
+    }
+
+    // Explorer resizes the preview pane in many small steps (and by a few
+    // pixels when toggling details); scaling the cached bitmap covers
+    // those, only a resize of more than 1/8th in either dimension is
+    // worth going back to the engine for
+    static bool NeedsRerender(Size rendered, Size target) {
+        int dx = std::abs(rendered.dx - target.dx);
+        int dy = std::abs(rendered.dy - target.dy);
+        return 8 * dx > target.dx || 8 * dy > target.dy;
+    }
+
+    // caller must hold currAccess; takes ownership of bmp
+    void AddToCache(RenderedBitmap* bmp, int pageNo, Size size) {
+        // a stale bitmap of the same page (e.g. from before a resize)
+        // is replaced rather than kept around
+        for (int i = 0; i < cache.Size(); i++) {
+            if (cache.at(i)->pageNo == pageNo) {
+                delete cache.at(i)->bmp;
+                delete cache.at(i);
+                cache.RemoveAt(i);
+                break;
+            }
+        }
+        while (cache.Size() >= kMaxCachedPreviewPages) {
+            int lru = 0;
+            for (int i = 1; i < cache.Size(); i++) {
+                if (cache.at(i)->lastUse < cache.at(lru)->lastUse) {
+                    lru = i;
+                }
+            }
+            delete cache.at(lru)->bmp;
+            delete cache.at(lru);
+            cache.RemoveAt(lru);
+        }
+        auto page = new CachedPreviewPage;
+        page->pageNo = pageNo;
+        page->size = size;
+        page->bmp = bmp;
+        page->lastUse = GetTickCount();
+        cache.Append(page);
+    }
     static DWORD WINAPI RenderThread(LPVOID data) {
         log("PageRenderer::RenderThread started\n");
         ScopedCom comScope; // because the engine reads data from a COM IStream
@@ -160,17 +239,11 @@ class PageRenderer {
         PageRenderer* pr = (PageRenderer*)data;
         RenderPageArgs args(pr->reqPage, pr->reqZoom, 0, nullptr, RenderTarget::View, &pr->abortCookie);
         RenderedBitmap* bmp = pr->engine->RenderPage(args);
-        if (!bmp) {
-            return 0;
-        }
 
         ScopedCritSec scope(&pr->currAccess);
 
-        if (!pr->reqAbort) {
-            delete pr->currBmp;
-            pr->currBmp = bmp;
-            pr->currPage = pr->reqPage;
-            pr->currSize = pr->reqSize;
+        if (bmp && !pr->reqAbort) {
+            pr->AddToCache(bmp, pr->reqPage, pr->reqSize);
         } else {
             delete bmp;
         }
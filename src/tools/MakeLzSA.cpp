@@ -14,6 +14,7 @@
 #include "utils/CmdLineArgsIter.h"
 #include "utils/FileUtil.h"
 #include "utils/DirIter.h"
+#include "utils/ThreadUtil.h"
 #include "utils/WinUtil.h"
 #include "utils/LzmaSimpleArchive.h"
 
@@ -79,59 +80,104 @@ static bool Compress(const char* uncompressed, size_t uncompressedSize, char* co
     return true;
 }
 
-static bool AppendEntry(str::Str& data, str::Str& content, const char* filePath, const char* inArchiveName,
-                        lzma::FileInfo* fi = nullptr) {
-    size_t nameLen = str::Len(inArchiveName);
-    ReportIf(nameLen > UINT32_MAX - 25);
-    u32 headerSize = 25 + (u32)nameLen;
-    FILETIME ft = file::GetModificationTime(filePath);
+// files are compressed on a pool of worker threads, one task per file
+struct FileCompressTask {
+    // input
+    AutoFreeStr filePath;
+    AutoFreeStr inArchiveName;
+    lzma::FileInfo* fi = nullptr; // matching entry in the previous version of the archive
+
+    // output of CompressOneFile()
+    bool ok = false;
+    FILETIME ftModified{};
+    u32 uncompressedSize = 0;
+    u32 uncompressedCrc32 = 0;
+    AutoFree compressed;
+    u32 compressedSize = 0;
+};
 
-    constexpr size_t kBufSize = 24;
+// reads and compresses a single file, or re-uses the compressed data from
+// the previous version of the archive if the file didn't change.
+// runs on a worker thread so it must only touch its own task
+static void CompressOneFile(FileCompressTask* t) {
+    lzma::FileInfo* fi = t->fi;
+    t->ftModified = file::GetModificationTime(t->filePath);
 
-    if (fi && FileTimeEq(ft, fi->ftModified)) {
+    if (fi && FileTimeEq(t->ftModified, fi->ftModified)) {
     ReusePrevious:
-        ByteWriterLE meta(kBufSize);
-        meta.Write32(headerSize);
-        meta.Write32(fi->compressedSize);
-        meta.Write32(fi->uncompressedSize);
-        meta.Write32(fi->uncompressedCrc32);
-        meta.Write32(ft.dwLowDateTime);
-        meta.Write32(ft.dwHighDateTime);
-        ReportIf(meta.Size() != kBufSize);
-        data.AppendSlice(meta.AsByteSlice());
-        data.Append(inArchiveName, nameLen + 1);
-        return content.Append(fi->compressedData, fi->compressedSize);
+        t->uncompressedSize = fi->uncompressedSize;
+        t->uncompressedCrc32 = fi->uncompressedCrc32;
+        t->compressedSize = fi->compressedSize;
+        t->compressed.Set((char*)memdup((void*)fi->compressedData, fi->compressedSize));
+        t->ok = t->compressed.Get() != nullptr;
+        return;
     }
 
-    ByteSlice fileData = file::ReadFile(filePath);
+    ByteSlice fileData = file::ReadFile(t->filePath);
     if (!fileData.data() || fileData.size() >= UINT32_MAX) {
-        fprintf(stderr, "Failed to read \"%s\" for compression\n", filePath);
-        return false;
+        fprintf(stderr, "Failed to read \"%s\" for compression\n", t->filePath.Get());
+        return;
     }
     u32 fileDataCrc = crc32(0, (const u8*)fileData.data(), (u32)fileData.size());
-    if (fi && fi->uncompressedCrc32 == fileDataCrc && fi->uncompressedSize == fileData.size())
+    if (fi && fi->uncompressedCrc32 == fileDataCrc && fi->uncompressedSize == fileData.size()) {
+        free(fileData.data());
         goto ReusePrevious;
+    }
 
     size_t compressedSize = fileData.size() + 1;
-    AutoFree compressed((char*)malloc(compressedSize));
-    if (!compressed.Get()) {
-        return false;
+    char* compressed = (char*)malloc(compressedSize);
+    if (!compressed) {
+        free(fileData.data());
+        return;
     }
     if (!Compress((const char*)fileData.data(), fileData.size(), compressed, &compressedSize)) {
-        return false;
+        free(fileData.data());
+        free(compressed);
+        return;
+    }
+    t->compressed.Set(compressed);
+    t->compressedSize = (u32)compressedSize;
+    t->uncompressedSize = (u32)fileData.size();
+    t->uncompressedCrc32 = fileDataCrc;
+    t->ok = true;
+    free(fileData.data());
+}
+
+constexpr int kMaxCompressThreads = 16;
+
+struct CompressBatch {
+    Vec<FileCompressTask*>* tasks = nullptr;
+    AtomicInt nextTask;
+};
+
+static void CompressBatchThread(CompressBatch* batch) {
+    for (;;) {
+        int i = batch->nextTask.Inc() - 1;
+        if (i >= batch->tasks->Size()) {
+            return;
+        }
+        CompressOneFile(batch->tasks->At(i));
     }
+}
 
+// appends the metadata and compressed content of a finished task
+static bool AppendEntry(str::Str& data, str::Str& content, FileCompressTask* t) {
+    size_t nameLen = str::Len(t->inArchiveName);
+    ReportIf(nameLen > UINT32_MAX - 25);
+    u32 headerSize = 25 + (u32)nameLen;
+
+    constexpr size_t kBufSize = 24;
     ByteWriterLE meta(kBufSize);
     meta.Write32(headerSize);
-    meta.Write32((u32)compressedSize);
-    meta.Write32((u32)fileData.size());
-    meta.Write32(fileDataCrc);
-    meta.Write32(ft.dwLowDateTime);
-    meta.Write32(ft.dwHighDateTime);
+    meta.Write32(t->compressedSize);
+    meta.Write32(t->uncompressedSize);
+    meta.Write32(t->uncompressedCrc32);
+    meta.Write32(t->ftModified.dwLowDateTime);
+    meta.Write32(t->ftModified.dwHighDateTime);
     ReportIf(meta.Size() != kBufSize);
     data.AppendSlice(meta.AsByteSlice());
-    data.Append(inArchiveName, nameLen + 1);
-    return content.Append(compressed, compressedSize);
+    data.Append(t->inArchiveName, nameLen + 1);
+    return content.Append(t->compressed, t->compressedSize);
 }
 
 // creates an archive from files (starting at index skipFiles);
@@ -146,6 +192,52 @@ bool CreateArchive(const char* archivePath, StrVec& files, size_t skipFiles = 0)
         prevArchive.filesCount = 0;
     }
 
+    Vec<FileCompressTask*> tasks;
+    bool ok = true;
+    for (int i = skipFiles; i < files.Size(); i++) {
+        auto t = new FileCompressTask();
+        tasks.Append(t);
+        t->filePath.SetCopy(files.at(i));
+        char* sep = str::FindCharLast(t->filePath, ':');
+        if (sep) {
+            t->inArchiveName.SetCopy(sep + 1);
+            *sep = '\0';
+        } else {
+            t->inArchiveName.SetCopy(t->filePath);
+        }
+
+        str::TransCharsInPlace(t->inArchiveName, "/", "\\");
+        if ('/' == *t->inArchiveName.Get() || str::Find(t->inArchiveName, "../")) {
+            fprintf(stderr, "In-archive name must not be an absolute path: %s\n", t->inArchiveName.Get());
+            ok = false;
+            break;
+        }
+
+        int idx = GetIdxFromName(&prevArchive, t->inArchiveName);
+        if (idx != -1)
+            t->fi = &prevArchive.files[idx];
+    }
+
+    if (ok && tasks.Size() > 0) {
+        // compress the files in parallel; entries are still written out
+        // strictly in the given order so the archive is deterministic
+        CompressBatch batch;
+        batch.tasks = &tasks;
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        int nThreads = limitValue<int>((int)si.dwNumberOfProcessors, 1, kMaxCompressThreads);
+        nThreads = std::min(nThreads, tasks.Size());
+        HANDLE threads[kMaxCompressThreads]{};
+        auto fn = MkFunc0<CompressBatch>(CompressBatchThread, &batch);
+        for (int i = 0; i < nThreads; i++) {
+            threads[i] = StartThread(fn, "CompressBatchThread");
+        }
+        for (int i = 0; i < nThreads; i++) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+
     str::Str data;
     str::Str content;
 
@@ -156,30 +248,21 @@ bool CreateArchive(const char* archivePath, StrVec& files, size_t skipFiles = 0)
     ReportIf(lzsaHeader.Size() != kBufSize);
     data.AppendSlice(lzsaHeader.AsByteSlice());
 
-    for (int i = skipFiles; i < files.Size(); i++) {
-        AutoFreeStr filePath(str::Dup(files.at(i)));
-        char* sep = str::FindCharLast(filePath, ':');
-        AutoFreeStr utf8Name;
-        if (sep) {
-            utf8Name = str::Dup(sep + 1);
-            *sep = '\0';
-        } else {
-            utf8Name = str::Dup(filePath);
+    for (FileCompressTask* t : tasks) {
+        if (!ok)
+            break;
+        if (!t->ok) {
+            ok = false;
+            break;
         }
-
-        str::TransCharsInPlace(utf8Name, "/", "\\");
-        if ('/' == *utf8Name || str::Find(utf8Name, "../")) {
-            fprintf(stderr, "In-archive name must not be an absolute path: %s\n", utf8Name.Get());
-            return false;
+        if (!AppendEntry(data, content, t)) {
+            ok = false;
+            break;
         }
-
-        int idx = GetIdxFromName(&prevArchive, utf8Name);
-        lzma::FileInfo* fi = nullptr;
-        if (idx != -1)
-            fi = &prevArchive.files[idx];
-        if (!AppendEntry(data, content, filePath, utf8Name, fi))
-            return false;
     }
+    DeleteVecMembers(tasks);
+    if (!ok)
+        return false;
 
     u32 headerCrc32 = crc32(0, (const u8*)data.Get(), (u32)data.size());
     ByteWriterLE buf(4);
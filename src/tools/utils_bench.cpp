@@ -0,0 +1,175 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// micro-benchmarks for the hot operations of the utils containers
+// (Vec, StrVec, dict::MapStrToInt, PoolAllocator). Emits a JSON array
+// of {name, n, ms} records on stdout so that results can be diffed
+// across commits; all inputs are generated deterministically
+
+#include "utils/BaseUtil.h"
+#include "utils/Dict.h"
+#include "utils/Timer.h"
+
+// best-of-n repetitions to filter out scheduling noise
+constexpr int kNRepeats = 5;
+
+static bool gFirstResult = true;
+
+static void ReportResult(const char* name, int n, double ms) {
+    if (!gFirstResult) {
+        printf(",\n");
+    }
+    gFirstResult = false;
+    printf("  {\"name\": \"%s\", \"n\": %d, \"ms\": %.3f}", name, n, ms);
+}
+
+// deterministic xorshift rng so that runs are comparable
+static u32 gRngState = 0x9e3779b9;
+
+static u32 RngNext() {
+    u32 x = gRngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    gRngState = x;
+    return x;
+}
+
+static void RngReset() {
+    gRngState = 0x9e3779b9;
+}
+
+// formats a pseudo-random file-name-like string; mixes digits so that
+// SortNatural() exercises its number-aware comparison
+static void GenKey(char* buf, size_t cchBuf, int i) {
+    u32 r = RngNext();
+    snprintf(buf, cchBuf, "file-%u-page%d.pdf", r % 9973, i % 100);
+}
+
+static void BenchVecAppend() {
+    constexpr int kN = 1000 * 1000;
+    double best = 0;
+    for (int rep = 0; rep < kNRepeats; rep++) {
+        Vec<int> v;
+        auto t = TimeGet();
+        for (int i = 0; i < kN; i++) {
+            v.Append(i);
+        }
+        double ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    ReportResult("vec-append", kN, best);
+}
+
+static void FillStrVec(StrVec* v, int n) {
+    RngReset();
+    char buf[64];
+    for (int i = 0; i < n; i++) {
+        GenKey(buf, dimof(buf), i);
+        v->Append(buf);
+    }
+}
+
+static void BenchStrVecAppend() {
+    constexpr int kN = 100 * 1000;
+    double best = 0;
+    for (int rep = 0; rep < kNRepeats; rep++) {
+        StrVec v;
+        auto t = TimeGet();
+        FillStrVec(&v, kN);
+        double ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    ReportResult("strvec-append", kN, best);
+}
+
+static void BenchStrVecSort(const char* name, void (*sortFn)(StrVec*)) {
+    constexpr int kN = 100 * 1000;
+    double best = 0;
+    for (int rep = 0; rep < kNRepeats; rep++) {
+        StrVec v;
+        FillStrVec(&v, kN);
+        auto t = TimeGet();
+        sortFn(&v);
+        double ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    ReportResult(name, kN, best);
+}
+
+static void SortDefault(StrVec* v) {
+    Sort(v);
+}
+
+static void BenchDict() {
+    constexpr int kN = 100 * 1000;
+    double bestInsert = 0;
+    double bestLookup = 0;
+    char buf[64];
+    for (int rep = 0; rep < kNRepeats; rep++) {
+        dict::MapStrToInt map(kN);
+        RngReset();
+        auto t = TimeGet();
+        for (int i = 0; i < kN; i++) {
+            GenKey(buf, dimof(buf), i);
+            map.Insert(buf, i);
+        }
+        double ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < bestInsert) {
+            bestInsert = ms;
+        }
+
+        RngReset();
+        int val;
+        t = TimeGet();
+        for (int i = 0; i < kN; i++) {
+            GenKey(buf, dimof(buf), i);
+            map.Get(buf, &val);
+        }
+        ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < bestLookup) {
+            bestLookup = ms;
+        }
+    }
+    ReportResult("dict-insert", kN, bestInsert);
+    ReportResult("dict-lookup", kN, bestLookup);
+}
+
+static void BenchPoolAllocator() {
+    constexpr int kN = 1000 * 1000;
+    double best = 0;
+    PoolAllocator pool;
+    for (int rep = 0; rep < kNRepeats; rep++) {
+        auto t = TimeGet();
+        for (int i = 0; i < kN; i++) {
+            // vary the size a bit like real string allocations do
+            pool.Alloc(16 + (i & 31));
+        }
+        pool.Reset();
+        double ms = TimeSinceInMs(t);
+        if (rep == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    ReportResult("pool-alloc-reset", kN, best);
+}
+
+int main(int, char**) {
+    printf("[\n");
+    BenchVecAppend();
+    BenchStrVecAppend();
+    BenchStrVecSort("strvec-sort", SortDefault);
+    BenchStrVecSort("strvec-sort-nocase", SortNoCase);
+    BenchStrVecSort("strvec-sort-natural", SortNatural);
+    BenchDict();
+    BenchPoolAllocator();
+    printf("\n]\n");
+    DestroyTempAllocator();
+    return 0;
+}
@@ -97,6 +97,10 @@ DisplayModel* SumatraUIAutomationDocumentProvider::GetDM() {
     return dm;
 }
 
+HWND SumatraUIAutomationDocumentProvider::GetCanvasHwnd() const {
+    return canvasHwnd;
+}
+
 SumatraUIAutomationPageProvider* SumatraUIAutomationDocumentProvider::GetFirstPage() {
     ReportIf(!IsDocumentLoaded());
     return child_first;
@@ -144,19 +144,25 @@ HRESULT STDMETHODCALLTYPE SumatraUIAutomationPageProvider::get_BoundingRectangle
         return E_FAIL;
     }
 
-    // some engines might not support GetPageInfo
-    const PageInfo* page = dm->GetPageInfo(pageNum);
-    if (!page) {
+    // UIA can call this from an RPC thread; read the geometry off the
+    // immutable snapshot instead of pagesInfo
+    PageGeometrySnapshot* geom = dm->AcquirePageGeometry();
+    if (!geom || pageNum < 1 || pageNum > geom->pageCount) {
+        if (geom) {
+            geom->Release();
+        }
         return E_FAIL;
     }
+    Rect pageOnScreen = geom->pages[pageNum - 1].pageOnScreen;
+    geom->Release();
 
     RECT canvasRect;
     GetWindowRect(canvasHwnd, &canvasRect);
 
-    pRetVal->left = canvasRect.left + page->pageOnScreen.x;
-    pRetVal->top = canvasRect.top + page->pageOnScreen.y;
-    pRetVal->width = page->pageOnScreen.dx;
-    pRetVal->height = page->pageOnScreen.dy;
+    pRetVal->left = canvasRect.left + pageOnScreen.x;
+    pRetVal->top = canvasRect.top + pageOnScreen.y;
+    pRetVal->width = pageOnScreen.dx;
+    pRetVal->height = pageOnScreen.dy;
 
     return S_OK;
 }
@@ -122,23 +122,22 @@ void SumatraUIAutomationTextRange::ValidateEndEndpoint() {
 }
 
 int SumatraUIAutomationTextRange::FindPreviousWordEndpoint(int pageno, int idx, bool dontReturnInitial) {
-    // based on TextSelection::SelectWordAt
-    int textLen;
     auto cache = document->GetDM()->textCache;
-    const WCHAR* pageText = cache->GetTextForPage(pageno, &textLen);
+    int nWords;
+    WordSpan* words = cache->GetWordsForPage(pageno, &nWords);
 
+    int wordIx = FindWordAtOrAfter(words, nWords, idx);
     if (dontReturnInitial) {
-        for (; idx > 0; idx--) {
-            if (isWordChar(pageText[idx - 1])) {
-                break;
-            }
+        // move to the start of the word strictly before idx
+        if (wordIx == nWords || words[wordIx].start >= idx) {
+            wordIx--;
         }
+        return wordIx >= 0 ? words[wordIx].start : 0;
     }
-
-    for (; idx > 0; idx--) {
-        if (!isWordChar(pageText[idx - 1])) {
-            break;
-        }
+    // inside a word (or at its end): its start; otherwise idx already
+    // is an endpoint
+    if (wordIx < nWords && words[wordIx].start < idx) {
+        return words[wordIx].start;
     }
     return idx;
 }
@@ -146,20 +145,21 @@ int SumatraUIAutomationTextRange::FindPreviousWordEndpoint(int pageno, int idx,
 int SumatraUIAutomationTextRange::FindNextWordEndpoint(int pageno, int idx, bool dontReturnInitial) {
     int textLen;
     auto cache = document->GetDM()->textCache;
-    const WCHAR* pageText = cache->GetTextForPage(pageno, &textLen);
+    cache->GetTextForPage(pageno, &textLen);
+    int nWords;
+    WordSpan* words = cache->GetWordsForPage(pageno, &nWords);
 
+    int wordIx = FindWordAtOrAfter(words, nWords, idx);
     if (dontReturnInitial) {
-        for (; idx < textLen; idx++) {
-            if (isWordChar(pageText[idx])) {
-                break;
-            }
+        // move to the end of the word strictly after idx
+        if (wordIx < nWords && words[wordIx].end == idx) {
+            wordIx++;
         }
+        return wordIx < nWords ? words[wordIx].end : textLen;
     }
-
-    for (; idx < textLen; idx++) {
-        if (!isWordChar(pageText[idx])) {
-            break;
-        }
+    // inside a word: its end; otherwise idx already is an endpoint
+    if (wordIx < nWords && words[wordIx].start <= idx && words[wordIx].end > idx) {
+        return words[wordIx].end;
     }
     return idx;
 }
@@ -409,18 +409,59 @@ HRESULT STDMETHODCALLTYPE SumatraUIAutomationTextRange::GetBoundingRectangles(SA
         return E_FAIL;
     }
 
-    if (IsNullRange()) {
-        SAFEARRAY* sarray = SafeArrayCreateVector(VT_R8, 0, 0);
-        if (!sarray) {
-            return E_OUTOFMEMORY;
+    // only the visible part of the range matters for the screen
+    // reader's highlight and restricting to it keeps this O(visible):
+    // pages outside the viewport contribute nothing and their glyph
+    // coordinates are never inflated
+    Vec<Rect> rects;
+    if (!IsNullRange() && !IsEmptyRange()) {
+        DisplayModel* dm = document->GetDM();
+        // UIA can call this from an RPC thread; read the geometry off the
+        // immutable snapshot instead of pagesInfo
+        PageGeometrySnapshot* geom = dm->AcquirePageGeometry();
+        if (geom) {
+            RECT canvasRect;
+            GetWindowRect(document->GetCanvasHwnd(), &canvasRect);
+            EngineBase* engine = dm->GetEngine();
+            int firstPage = std::max(startPage, 1);
+            int lastPage = std::min(endPage, geom->pageCount);
+            for (int page = firstPage; page <= lastPage; page++) {
+                if (!geom->PageVisible(page)) {
+                    continue;
+                }
+                TextSelection selection(engine, dm->textCache);
+                selection.StartAt(page, page == startPage ? startGlyph : 0);
+                // -1 selects up to the last glyph of the page
+                selection.SelectUpTo(page, page == endPage ? endGlyph : -1);
+                Rect pageOnScreen = geom->pages[page - 1].pageOnScreen;
+                float zoom = geom->GetZoomReal(page);
+                for (int i = 0; i < selection.result.len; i++) {
+                    RectF r = ToRectF(selection.result.rects[i]);
+                    r = engine->Transform(r, page, zoom, geom->rotation);
+                    Rect onScreen = r.Round();
+                    onScreen.x += pageOnScreen.x + canvasRect.left;
+                    onScreen.y += pageOnScreen.y + canvasRect.top;
+                    rects.Append(onScreen);
+                }
+            }
+            geom->Release();
         }
-
-        *boundingRects = sarray;
-        return S_OK;
     }
 
-    // TODO: support GetBoundingRectangles
-    return E_NOTIMPL;
+    SAFEARRAY* psa = SafeArrayCreateVector(VT_R8, 0, (ULONG)rects.Size() * 4);
+    if (!psa) {
+        return E_OUTOFMEMORY;
+    }
+    for (int i = 0; i < rects.Size(); i++) {
+        Rect r = rects.At(i);
+        double vals[4] = {(double)r.x, (double)r.y, (double)r.dx, (double)r.dy};
+        for (LONG j = 0; j < 4; j++) {
+            LONG idx = (LONG)i * 4 + j;
+            SafeArrayPutElement(psa, &idx, &vals[j]);
+        }
+    }
+    *boundingRects = psa;
+    return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE
@@ -445,33 +486,52 @@ HRESULT STDMETHODCALLTYPE SumatraUIAutomationTextRange::GetText(int maxLength, B
         return E_FAIL;
     }
 
-    if (IsNullRange() || IsEmptyRange()) {
+    if (IsNullRange() || IsEmptyRange() || maxLength == 0) {
         *text = SysAllocString(L""); // 0-sized not-null string
         return S_OK;
     }
 
-    TextSelection selection(document->GetDM()->GetEngine(), document->GetDM()->textCache);
-    selection.StartAt(startPage, startGlyph);
-    selection.SelectUpTo(endPage, endGlyph);
-
-    AutoFreeWStr selected_text(selection.ExtractText("\r\n"));
-    size_t selected_text_length = str::Len(selected_text);
-
     // -1 and [0, inf) are allowed
-    if (maxLength > -2) {
-        if (maxLength != -1 && selected_text_length > (size_t)maxLength) {
-            selected_text[maxLength] = '\0'; // truncate
-        }
+    if (maxLength < -1) {
+        return E_INVALIDARG;
+    }
 
-        *text = SysAllocString(selected_text);
-        if (*text) {
-            return S_OK;
-        } else {
-            return E_OUTOFMEMORY;
+    DisplayModel* dm = document->GetDM();
+
+    // extract page by page instead of building one document-spanning
+    // selection: a multi-page selection materializes the glyph
+    // coordinate arrays of every page it touches at once, this only
+    // keeps a single page's selection alive at a time. A screen reader
+    // attaching typically asks for the text of the whole document range
+    // with a small maxLength, which additionally stops the walk early
+    // so that it doesn't force text extraction of every page
+    str::WStr res;
+    for (int page = startPage; page <= endPage; page++) {
+        TextSelection selection(dm->GetEngine(), dm->textCache);
+        selection.StartAt(page, page == startPage ? startGlyph : 0);
+        // -1 selects up to the last glyph of the page
+        selection.SelectUpTo(page, page == endPage ? endGlyph : -1);
+        AutoFreeWStr pageFrag(selection.ExtractText("\r\n"));
+        if (str::IsEmpty(pageFrag.Get())) {
+            continue;
         }
-    } else {
-        return E_INVALIDARG;
+        // ExtractText() joins the lines of consecutive pages with the
+        // line separator as well
+        if (res.size() > 0) {
+            res.Append(L"\r\n");
+        }
+        res.Append(pageFrag.Get());
+        if (maxLength != -1 && res.size() >= (size_t)maxLength) {
+            break;
+        }
+    }
+
+    size_t n = res.size();
+    if (maxLength != -1) {
+        n = std::min(n, (size_t)maxLength);
     }
+    *text = SysAllocStringLen(res.Get(), (UINT)n);
+    return *text ? S_OK : E_OUTOFMEMORY;
 }
 
 HRESULT STDMETHODCALLTYPE SumatraUIAutomationTextRange::Move(enum TextUnit unit, int count, int* moved) {
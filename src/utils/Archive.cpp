@@ -6,11 +6,15 @@
 #include "utils/ScopedWin.h"
 #include "utils/WinUtil.h"
 #include "utils/CryptoUtil.h"
+#include "utils/ThreadUtil.h"
 
 #include "utils/Archive.h"
 
 extern "C" {
 #include <unarr.h>
+// from unarr's common/unarr-imp.h, used to warm up the lazily
+// initialized crc32 table before worker threads race to build it
+uint32_t ar_crc32(uint32_t crc32, const unsigned char* data, size_t data_len);
 }
 
 // TODO: set include path to ext/ dir
@@ -21,6 +25,15 @@ extern "C" {
 // 3 is for absolute worst case of WCHAR* where last char was partially written
 #define ZERO_PADDING_COUNT 3
 
+// archives up to this size are loaded whole with a single bulk read and
+// parsed from memory, which is much faster than the many small buffered
+// reads done while walking e.g. a zip central directory with thousands
+// of entries
+constexpr i64 kMaxInMemoryArchiveSize = 128 * 1024 * 1024;
+
+// upper bound for parallel loadOnOpen worker threads
+#define MAX_PARALLEL_LOAD_THREADS 4
+
 FILETIME MultiFormatArchive::FileInfo::GetWinFileTime() const {
     FILETIME ft = {(DWORD)-1, (DWORD)-1};
     LocalFileTimeToFileTime((FILETIME*)&fileTime, &ft);
@@ -53,6 +66,11 @@ bool MultiFormatArchive::Open(ar_stream* data, const char* archivePath) {
         return false;
     }
 
+    // with the file in memory each worker thread can run its own
+    // decoder over the shared buffer, so all entries get uncompressed
+    // (and checksum-verified) in parallel instead of one after another
+    bool parallelLoad = loadOnOpen && inMemoryData_.data() != nullptr;
+
     size_t fileId = 0;
     while (ar_parse_entry(ar_)) {
         const char* name = ar_entry_get_name(ar_);
@@ -69,7 +87,7 @@ bool MultiFormatArchive::Open(ar_stream* data, const char* archivePath) {
         fileInfos_.Append(i);
         // doesn't benchmark faster for .zip files but not much slower either
         // is probably faster for .tar.gz files
-        if (loadOnOpen) {
+        if (loadOnOpen && !parallelLoad) {
             size_t size = i->fileSizeUncompressed;
             i->data = AllocArray<char>(size + ZERO_PADDING_COUNT);
             if (i->data) {
@@ -83,15 +101,108 @@ bool MultiFormatArchive::Open(ar_stream* data, const char* archivePath) {
 
         fileId++;
     }
+    if (parallelLoad) {
+        ParallelLoadOnOpen();
+    }
     return true;
 }
 
+// opens the archive at path, preferring a single bulk read of the whole
+// file into memory over many small reads through a buffered file stream
+bool MultiFormatArchive::OpenPath(const char* path) {
+    ar_stream* stm = nullptr;
+    i64 fileSize = file::GetSize(path);
+    // rar files are usually handled by unrar.dll, which re-opens the
+    // file from disk itself, so bulk-loading them would be wasted work
+    if (format != Format::Rar && fileSize > 0 && fileSize <= kMaxInMemoryArchiveSize) {
+        ByteSlice d = file::ReadFile(path);
+        if (d.data()) {
+            stm = ar_open_memory(d.data(), d.size());
+            if (stm) {
+                inMemoryData_ = d;
+            } else {
+                d.Free();
+            }
+        }
+    }
+    if (!stm) {
+        WCHAR* pathW = ToWStrTemp(path);
+        stm = ar_open_file_w(pathW);
+    }
+    return Open(stm, path);
+}
+
+void MultiFormatArchive::RunParallelLoad() {
+    ar_stream* stm = ar_open_memory(inMemoryData_.data(), inMemoryData_.size());
+    ar_archive* ar = stm ? opener_(stm) : nullptr;
+    int nEntries = fileInfos_.Size();
+    while (ar) {
+        int idx = parallelLoadIdx_.Inc() - 1;
+        if (idx >= nEntries) {
+            break;
+        }
+        FileInfo* fi = fileInfos_.at(idx);
+        size_t size = fi->fileSizeUncompressed;
+        if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
+            continue;
+        }
+        char* data = AllocArray<char>(size + ZERO_PADDING_COUNT);
+        if (!data) {
+            continue;
+        }
+        bool ok = ar_parse_entry_at(ar, fi->filePos) && ar_entry_uncompress(ar, data, size);
+        if (!ok) {
+            // same as a failed uncompress on the serial path: the entry
+            // stays empty and GetFileDataById() retries on demand
+            free(data);
+            continue;
+        }
+        fi->data = data;
+    }
+    ar_close_archive(ar);
+    ar_close(stm);
+}
+
+static void ArchiveParallelLoadThread(MultiFormatArchive* archive) {
+    archive->RunParallelLoad();
+}
+
+// uncompress all entries using multiple worker threads, each with its
+// own decoder over the shared in-memory file. The decoders verify each
+// entry's checksum while uncompressing, so a corrupted entry is caught
+// here instead of when the reader first asks for it
+void MultiFormatArchive::ParallelLoadOnOpen() {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue((int)si.dwNumberOfProcessors / 2, 1, MAX_PARALLEL_LOAD_THREADS);
+    int nEntries = fileInfos_.Size();
+    parallelLoadIdx_.Set(0);
+    if (nEntries < 2 || nThreads < 2) {
+        RunParallelLoad();
+        return;
+    }
+    // unarr builds its crc32 table lazily on first use; do it now from
+    // a single thread
+    ar_crc32(0, nullptr, 0);
+    HANDLE threads[MAX_PARALLEL_LOAD_THREADS];
+    for (int i = 0; i < nThreads; i++) {
+        auto fn = MkFunc0(ArchiveParallelLoadThread, this);
+        threads[i] = StartThread(fn, "ArchiveParallelLoad");
+    }
+    WaitForMultipleObjects((DWORD)nThreads, threads, TRUE, INFINITE);
+    for (int i = 0; i < nThreads; i++) {
+        CloseHandle(threads[i]);
+    }
+}
+
 MultiFormatArchive::~MultiFormatArchive() {
+    JoinPrefetchThread();
     ar_close_archive(ar_);
     ar_close(data_);
     for (auto& fi : fileInfos_) {
         free((void*)fi->data);
     }
+    inMemoryData_.Free();
 }
 
 size_t getFileIdByName(Vec<MultiFormatArchive::FileInfo*>& fileInfos, const char* name) {
@@ -116,6 +227,64 @@ ByteSlice MultiFormatArchive::GetFileDataByName(const char* fileName) {
     return GetFileDataById(fileId);
 }
 
+// assumes exclusive access to ar_ i.e. no prefetch in-flight
+ByteSlice MultiFormatArchive::UncompressEntry(size_t fileId) {
+    auto* fileInfo = fileInfos_[fileId];
+    auto filePos = fileInfo->filePos;
+    if (!ar_parse_entry_at(ar_, filePos)) {
+        return {};
+    }
+    size_t size = fileInfo->fileSizeUncompressed;
+    if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
+        return {};
+    }
+    u8* data = AllocArray<u8>(size + ZERO_PADDING_COUNT);
+    if (!data) {
+        return {};
+    }
+    if (!ar_entry_uncompress(ar_, data, size)) {
+        free(data);
+        return {};
+    }
+
+    return {data, size};
+}
+
+void MultiFormatArchive::RunPrefetch() {
+    auto* fileInfo = fileInfos_[prefetchFileId_];
+    ByteSlice data = UncompressEntry(prefetchFileId_);
+    fileInfo->data = (char*)data.data();
+}
+
+static void ArchivePrefetchThread(MultiFormatArchive* archive) {
+    archive->RunPrefetch();
+}
+
+// uncompress entry fileId on a background thread into FileInfo::data,
+// where the next GetFileDataById() will pick it up. A wrong guess costs
+// one entry's worth of memory (freed in the destructor)
+void MultiFormatArchive::MaybeStartPrefetch(size_t fileId) {
+    ReportIf(prefetchThread_);
+    if (!prefetchNextEntry || !ar_ || LoadedUsingUnrarDll()) {
+        return;
+    }
+    if (fileId >= fileInfos_.size() || fileInfos_[fileId]->data != nullptr) {
+        return;
+    }
+    prefetchFileId_ = fileId;
+    auto fn = MkFunc0(ArchivePrefetchThread, this);
+    prefetchThread_ = StartThread(fn, "ArchivePrefetchThread");
+}
+
+void MultiFormatArchive::JoinPrefetchThread() {
+    if (!prefetchThread_) {
+        return;
+    }
+    WaitForSingleObject(prefetchThread_, INFINITE);
+    CloseHandle(prefetchThread_);
+    prefetchThread_ = nullptr;
+}
+
 // the caller must free()
 ByteSlice MultiFormatArchive::GetFileDataById(size_t fileId) {
     if (fileId == (size_t)-1) {
@@ -123,6 +292,9 @@ ByteSlice MultiFormatArchive::GetFileDataById(size_t fileId) {
     }
     ReportIf(fileId >= fileInfos_.size());
 
+    // a pending prefetch might still be writing FileInfo::data
+    JoinPrefetchThread();
+
     auto* fileInfo = fileInfos_[fileId];
     ReportIf(fileInfo->fileId != fileId);
 
@@ -130,6 +302,7 @@ ByteSlice MultiFormatArchive::GetFileDataById(size_t fileId) {
         // the caller takes ownership
         ByteSlice res{(u8*)fileInfo->data, fileInfo->fileSizeUncompressed};
         fileInfo->data = nullptr;
+        MaybeStartPrefetch(fileId + 1);
         return res;
     }
 
@@ -141,29 +314,16 @@ ByteSlice MultiFormatArchive::GetFileDataById(size_t fileId) {
         return {};
     }
 
-    auto filePos = fileInfo->filePos;
-    if (!ar_parse_entry_at(ar_, filePos)) {
-        return {};
-    }
-    size_t size = fileInfo->fileSizeUncompressed;
-    if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
-        return {};
-    }
-    u8* data = AllocArray<u8>(size + ZERO_PADDING_COUNT);
-    if (!data) {
-        return {};
-    }
-    if (!ar_entry_uncompress(ar_, data, size)) {
-        return {};
-    }
-
-    return {data, size};
+    ByteSlice res = UncompressEntry(fileId);
+    MaybeStartPrefetch(fileId + 1);
+    return res;
 }
 
 const char* MultiFormatArchive::GetComment() {
     if (!ar_) {
         return nullptr;
     }
+    JoinPrefetchThread();
 
     size_t n = ar_get_global_comment(ar_, nullptr, 0);
     if (0 == n || (size_t)-1 == n) {
@@ -190,9 +350,7 @@ static ar_archive* ar_open_zip_archive_deflated(ar_stream* stream) {
 }
 
 static MultiFormatArchive* open(MultiFormatArchive* archive, const char* path) {
-    WCHAR* pathW = ToWStrTemp(path);
-    ar_stream* stm = ar_open_file_w(pathW);
-    bool ok = archive->Open(stm, path);
+    bool ok = archive->OpenPath(path);
     if (!ok) {
         delete archive;
         return nullptr;
@@ -31,6 +31,7 @@ class MultiFormatArchive {
     Format format;
 
     bool Open(ar_stream* data, const char* archivePath);
+    bool OpenPath(const char* path);
 
     Vec<FileInfo*> const& GetFileInfos();
 
@@ -44,6 +45,16 @@ class MultiFormatArchive {
     // if true, will load and uncompress all files on open
     bool loadOnOpen = false;
 
+    // if true, GetFileDataById() schedules uncompressing the next entry
+    // on a background thread so that readers going through the archive
+    // in order don't wait on i/o (matters for files on network shares)
+    bool prefetchNextEntry = false;
+
+    // internal use: body of the prefetch thread
+    void RunPrefetch();
+    // internal use: body of a parallel loadOnOpen worker thread
+    void RunParallelLoad();
+
   protected:
     // used for allocating strings that are referenced by ArchFileInfo::name
     PoolAllocator allocator_;
@@ -56,6 +67,22 @@ class MultiFormatArchive {
     // only set when we loaded file infos using unrar.dll fallback
     const char* rarFilePath_ = nullptr;
 
+    // at most one prefetch is in-flight; must be joined before
+    // touching ar_ or FileInfo::data
+    HANDLE prefetchThread_ = nullptr;
+    size_t prefetchFileId_ = 0;
+
+    // the whole archive file when it was small enough to load with a
+    // single bulk read; parsing and uncompressing then run from memory
+    ByteSlice inMemoryData_;
+    // next fileInfos_ index to be uncompressed by a parallel load worker
+    AtomicInt parallelLoadIdx_;
+
+    ByteSlice UncompressEntry(size_t fileId);
+    void MaybeStartPrefetch(size_t fileId);
+    void ParallelLoadOnOpen();
+    void JoinPrefetchThread();
+
     bool OpenUnrarFallback(const char* rarPathUtf);
     ByteSlice GetFileDataByIdUnarrDll(size_t fileId);
     bool LoadedUsingUnrarDll() const {
@@ -64,6 +91,7 @@ class MultiFormatArchive {
 };
 
 MultiFormatArchive* OpenZipArchive(const char* path, bool deflatedOnly);
+
 MultiFormatArchive* Open7zArchive(const char* path);
 MultiFormatArchive* OpenTarArchive(const char* path);
 MultiFormatArchive* OpenRarArchive(const char* path);
@@ -0,0 +1,19 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/UITask.h"
+#include "utils/AsyncTask.h"
+
+static void ResumeCoro(void* frame) {
+    std::coroutine_handle<>::from_address(frame).resume();
+}
+
+void ResumeBackground::await_suspend(std::coroutine_handle<> h) const {
+    RunAsync(MkFunc0(ResumeCoro, h.address()), "AsyncTask", qos);
+}
+
+void ResumeUiThread::await_suspend(std::coroutine_handle<> h) const {
+    uitask::Post(MkFunc0(ResumeCoro, h.address()), "TaskResumeCoro");
+}
@@ -0,0 +1,71 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+/* Coroutine-based composition for multi-step async flows (render =>
+   report progress => write => update UI) that are otherwise hand-rolled
+   chains of RunAsync() + uitask::Post() closures, each step a separate
+   function sharing state through a heap-allocated struct.
+
+   An AsyncTask coroutine starts synchronously on the caller's thread
+   and hops between the shared thread pool and the UI thread with
+   co_await, keeping locals alive across the hops:
+
+   static AsyncTask LoadAndShow(MainWindow* win, char* path) {
+       co_await ResumeBackground{};  // the rest runs on the pool
+       ByteSlice data = file::ReadFile(path);
+       co_await ResumeUiThread{};    // the rest runs on the UI thread
+       ShowData(win, data);
+       data.Free();
+       str::Free(path);
+   }
+
+   Tasks are fire-and-forget: the coroutine frame frees itself when the
+   body finishes. Anything captured by pointer must outlive the task,
+   same as with the Func0 closures. Each pool segment runs under its own
+   ScopedTempAllocMark, so Temp allocations don't survive a co_await -
+   str::Dup() anything that has to cross a hop. */
+
+#include <coroutine>
+
+struct AsyncTask {
+    struct promise_type {
+        AsyncTask get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        // not suspending at the end auto-frees the coroutine frame
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            // exceptions are disabled in this codebase
+        }
+    };
+};
+
+// co_await ResumeBackground{}: continue on the shared thread pool
+struct ResumeBackground {
+    // for long / low-priority work, same as the RunAsync argument
+    ThreadQoS qos = ThreadQoS::Default;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) const;
+    void await_resume() const noexcept {
+    }
+};
+
+// co_await ResumeUiThread{}: continue on the UI thread (via uitask)
+struct ResumeUiThread {
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) const;
+    void await_resume() const noexcept {
+    }
+};
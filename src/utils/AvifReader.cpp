@@ -2,6 +2,7 @@
    License: Simplified BSD (see COPYING.BSD) */
 
 #include "utils/BaseUtil.h"
+#include "utils/PixelConvert.h"
 #include "utils/AvifReader.h"
 
 #ifndef NO_AVIF
@@ -86,18 +87,9 @@ Gdiplus::Bitmap* AvifImageFromData(const ByteSlice& d) {
         u8* src = (u8*)data;
         u8* dst = (u8*)bmpData.Scan0;
         for (int i = 0; i < dy; i++) {
-            u8* srcTmp = src;
-            u8* dstTmp = dst;
-            // TODO: memcpy?
-            for (int j = 0; j < dx; j++) {
-                *dst++ = src[2];
-                *dst++ = src[1];
-                *dst++ = src[0];
-                dst++;
-                src += 3;
-            }
-            src = srcTmp + srcStride;
-            dst = dstTmp + dstStride;
+            RowRgbToBgrx32(dst, src, dx);
+            src += srcStride;
+            dst += dstStride;
         }
         bmp->UnlockBits(&bmpData);
     }
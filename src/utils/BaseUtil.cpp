@@ -4,6 +4,9 @@
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
 
+// for _ReturnAddress() used by allocation tracking
+#include <intrin.h>
+
 #include "utils/Log.h"
 
 Kind kindNone = "none";
@@ -214,6 +217,45 @@ void PoolAllocator::Reset(bool poisonFreedMemory) {
     currBlock = first;
 }
 
+// remembers the current position so that everything allocated after
+// it can be freed with RewindTo(). The caller must ensure no other
+// thread allocates from this allocator between the two calls
+PoolAllocator::Mark PoolAllocator::GetMark() {
+    ScopedCritSec scs(&cs);
+    Mark m;
+    m.block = currBlock;
+    if (currBlock) {
+        m.freeSpace = currBlock->freeSpace;
+        m.end = currBlock->end;
+        m.blockNAllocs = currBlock->nAllocs;
+    }
+    m.nAllocs = nAllocs;
+    return m;
+}
+
+void PoolAllocator::RewindTo(const Mark& m) {
+    ScopedCritSec scs(&cs);
+    if (!m.block) {
+        // nothing was allocated when the mark was taken; keep the
+        // first block for re-use, same as Reset()
+        Reset(false);
+        return;
+    }
+    // free the blocks allocated after the marked one
+    Block* curr = m.block->next;
+    while (curr) {
+        Block* next = curr->next;
+        free(curr);
+        curr = next;
+    }
+    m.block->next = nullptr;
+    m.block->freeSpace = m.freeSpace;
+    m.block->end = m.end;
+    m.block->nAllocs = m.blockNAllocs;
+    currBlock = m.block;
+    nAllocs = m.nAllocs;
+}
+
 PoolAllocator::~PoolAllocator() {
     FreeAll();
     DeleteCriticalSection(&cs);
@@ -320,11 +362,122 @@ void* PoolAllocator::At(int i) {
     return (void*)d;
 }
 
+// ----- opt-in allocation tracking (see StartTrackingAllocs) -----
+
+// a fixed-size open-addressing hash of allocation call sites, keyed by
+// the caller's return address. Fixed size so that the tracking path
+// never allocates itself
+struct AllocSite {
+    void* addr;
+    i64 nAllocs;
+    i64 nBytes;
+};
+
+// power of 2; overflowing sites are silently dropped
+constexpr int kMaxAllocSites = 4096;
+
+static AllocSite* gAllocSites = nullptr;
+static CRITICAL_SECTION gAllocSitesCs;
+static bool gTrackAllocs = false;
+
+void StartTrackingAllocs() {
+    if (gTrackAllocs) {
+        return;
+    }
+    InitializeCriticalSection(&gAllocSitesCs);
+    gAllocSites = (AllocSite*)calloc(kMaxAllocSites, sizeof(AllocSite));
+    gTrackAllocs = gAllocSites != nullptr;
+}
+
+static void TrackAlloc(void* site, size_t size) {
+    EnterCriticalSection(&gAllocSitesCs);
+    u32 idx = (u32)(((uintptr_t)site >> 4) * 2654435761u) & (kMaxAllocSites - 1);
+    for (int probe = 0; probe < kMaxAllocSites; probe++) {
+        AllocSite* s = &gAllocSites[idx];
+        if (s->addr == site || !s->addr) {
+            s->addr = site;
+            s->nAllocs++;
+            s->nBytes += (i64)size;
+            break;
+        }
+        idx = (idx + 1) & (kMaxAllocSites - 1);
+    }
+    LeaveCriticalSection(&gAllocSitesCs);
+}
+
+// formats site as a module-relative address that can be resolved
+// against a .map file or in a debugger, without requiring dbghelp
+static void AppendAllocSiteAddr(str::Str& s, void* site) {
+    HMODULE mod = nullptr;
+    DWORD flags = GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT;
+    GetModuleHandleExW(flags, (const WCHAR*)site, &mod);
+    if (!mod) {
+        s.AppendFmt("0x%p", site);
+        return;
+    }
+    char path[MAX_PATH]{};
+    GetModuleFileNameA(mod, path, dimof(path) - 1);
+    const char* name = path;
+    for (const char* c = path; *c; c++) {
+        if (*c == '\\' || *c == '/') {
+            name = c + 1;
+        }
+    }
+    s.AppendFmt("%s+0x%llx", name, (u64)((char*)site - (char*)mod));
+}
+
+static void DumpTopAllocSites(AllocSite* sites, int n, int nTop, const char* order) {
+    if (nTop > n) {
+        nTop = n;
+    }
+    logf("DumpAllocStats: top %d of %d sites by %s:\n", nTop, n, order);
+    str::Str s;
+    for (int i = 0; i < nTop; i++) {
+        s.Reset();
+        AppendAllocSiteAddr(s, sites[i].addr);
+        logf("  %s: %d allocs, %d kB\n", s.Get(), (int)sites[i].nAllocs, (int)(sites[i].nBytes / 1024));
+    }
+}
+
+void DumpAllocStats(int nTopSites) {
+    if (!gTrackAllocs) {
+        return;
+    }
+    // snapshot under the lock, report outside of it (logf allocates)
+    AllocSite* sites = (AllocSite*)calloc(kMaxAllocSites, sizeof(AllocSite));
+    if (!sites) {
+        return;
+    }
+    EnterCriticalSection(&gAllocSitesCs);
+    memcpy(sites, gAllocSites, kMaxAllocSites * sizeof(AllocSite));
+    LeaveCriticalSection(&gAllocSitesCs);
+
+    // compact the hash into a dense array for sorting
+    int n = 0;
+    for (int i = 0; i < kMaxAllocSites; i++) {
+        if (sites[i].addr) {
+            sites[n++] = sites[i];
+        }
+    }
+    std::sort(sites, sites + n, [](const AllocSite& a, const AllocSite& b) { return a.nBytes > b.nBytes; });
+    DumpTopAllocSites(sites, n, nTopSites, "bytes");
+    std::sort(sites, sites + n, [](const AllocSite& a, const AllocSite& b) { return a.nAllocs > b.nAllocs; });
+    DumpTopAllocSites(sites, n, nTopSites, "count");
+    free(sites);
+}
+
+static void* AllocZeroAt(void* site, size_t count, size_t size) {
+    if (gTrackAllocs) {
+        TrackAlloc(site, count * size);
+    }
+    return calloc(count, size);
+}
+
 // This exits so that I can add temporary instrumentation
 // to catch allocations of a given size and it won't cause
 // re-compilation of everything caused by changing BaseUtil.h
 void* AllocZero(size_t count, size_t size) {
-    return calloc(count, size);
+    return AllocZeroAt(_ReturnAddress(), count, size);
 }
 
 // extraBytes will be filled with 0. Useful for copying zero-terminated strings
@@ -333,7 +486,8 @@ void* memdup(const void* data, size_t len, size_t extraBytes) {
     if (!data) {
         return nullptr;
     }
-    void* dup = AllocZero(len + extraBytes, 1);
+    // attributed to memdup's caller, not to memdup itself
+    void* dup = AllocZeroAt(_ReturnAddress(), len + extraBytes, 1);
     if (dup) {
         memcpy(dup, data, len);
     }
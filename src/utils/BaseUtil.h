@@ -263,6 +263,14 @@ void BreakIfUnderDebugger();
 
 void* AllocZero(size_t count, size_t size);
 
+// opt-in heap instrumentation: counts allocations made through
+// AllocZero() / memdup() per call site (keyed by the caller's return
+// address) to find transient-allocation storms. Enabled by setting the
+// SUMATRAPDF_TRACK_ALLOCS environment variable (see WinMain) or by
+// calling StartTrackingAllocs() directly
+void StartTrackingAllocs();
+void DumpAllocStats(int nTopSites = 10);
+
 template <typename T>
 FORCEINLINE T* AllocArray(size_t n) {
     return (T*)AllocZero(n, sizeof(T));
@@ -458,6 +466,20 @@ struct PoolAllocator : Allocator {
     void Reset(bool poisonFreedMemory = false);
     void* At(int i);
 
+    // a position in the allocator; all allocations made after taking
+    // a mark can be freed with RewindTo(). Invalidated by Reset() and
+    // FreeAll()
+    struct Mark {
+        Block* block = nullptr;
+        char* freeSpace = nullptr;
+        char* end = nullptr;
+        size_t blockNAllocs = 0;
+        int nAllocs = 0;
+    };
+
+    Mark GetMark();
+    void RewindTo(const Mark&);
+
     // only valid for structs, could alloc objects with
     // placement new()
     template <typename T>
@@ -0,0 +1,250 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/CacheFile.h"
+
+#include "utils/Log.h"
+
+constexpr u32 kCacheFileMagic = 0x31464353; // "SCF1"
+// entries not used for this many consecutive OpenCacheFile() generations
+// are evicted when the data area runs low
+constexpr u32 kCacheFileKeepGenerations = 16;
+// compact at open when the data area is more than 3/4 full
+constexpr u32 kCacheFileCompactNum = 3;
+constexpr u32 kCacheFileCompactDenom = 4;
+
+#pragma pack(push, 1)
+struct CacheFileHeader {
+    u32 magic = 0;
+    u32 nSlots = 0;
+    u32 dataSize = 0; // capacity of the data area
+    u32 dataUsed = 0; // high-water mark, only reset by compaction
+    u32 generation = 0;
+    u32 reserved[3]{};
+};
+
+struct CacheFileSlot {
+    u8 key[16];
+    u32 off = 0; // from the start of the data area, 8-byte aligned
+    u32 size = 0;
+    u32 generation = 0; // of the last Get() / Put()
+    u32 state = 0;
+};
+#pragma pack(pop)
+
+// deleted slots keep linear probing going so that entries inserted
+// past them stay reachable; their data is reclaimed by compaction
+enum { kSlotEmpty = 0, kSlotValid = 1, kSlotDeleted = 2 };
+
+static u32 SlotIndex(const u8 key[16], u32 nSlots) {
+    u32 h;
+    memcpy(&h, key, sizeof(h));
+    return h % nSlots;
+}
+
+static CacheFileSlot* FindSlot(CacheFile* cf, const u8 key[16], bool forInsert) {
+    u32 n = cf->hdr->nSlots;
+    u32 idx = SlotIndex(key, n);
+    CacheFileSlot* insertAt = nullptr;
+    for (u32 i = 0; i < n; i++) {
+        CacheFileSlot* s = cf->slots + (idx + i) % n;
+        if (s->state == kSlotEmpty) {
+            return forInsert ? (insertAt ? insertAt : s) : nullptr;
+        }
+        if (s->state == kSlotDeleted) {
+            // remember the first reusable slot but keep probing: a
+            // match for the key might still follow
+            if (!insertAt) {
+                insertAt = s;
+            }
+            continue;
+        }
+        if (memcmp(s->key, key, dimof(s->key)) == 0) {
+            return s;
+        }
+    }
+    return forInsert ? insertAt : nullptr;
+}
+
+ByteSlice CacheFile::Get(const u8 key[16]) {
+    CacheFileSlot* s = FindSlot(this, key, false);
+    if (!s) {
+        return {};
+    }
+    // remember the use so that compaction keeps this entry around
+    s->generation = hdr->generation;
+    return {data + s->off, s->size};
+}
+
+ByteSlice CacheFile::GetAt(u32 idx) {
+    if (idx >= hdr->nSlots) {
+        return {};
+    }
+    CacheFileSlot* s = slots + idx;
+    if (s->state != kSlotValid) {
+        return {};
+    }
+    return {data + s->off, s->size};
+}
+
+u32 CacheFile::NumSlots() const {
+    return hdr->nSlots;
+}
+
+bool CacheFile::Put(const u8 key[16], const ByteSlice& d) {
+    u32 len = (u32)d.size();
+    if (0 == len || len > hdr->dataSize) {
+        return false;
+    }
+    ScopedCritSec cs(&writeAccess);
+    CacheFileSlot* s = FindSlot(this, key, true);
+    if (!s) {
+        // slot table is full
+        return false;
+    }
+    u32 off = (hdr->dataUsed + 7) & ~7u;
+    if (off + len > hdr->dataSize) {
+        // data area is full; stale entries are evicted and their bytes
+        // reclaimed on the next OpenCacheFile()
+        return false;
+    }
+    memcpy(data + off, d.data(), len);
+    if (s->state == kSlotValid) {
+        // replacing: hide the slot from lock-free readers while its
+        // offset and size change (the old bytes become garbage that
+        // compaction reclaims)
+        s->state = kSlotDeleted;
+    }
+    memcpy(s->key, key, dimof(s->key));
+    s->off = off;
+    s->size = len;
+    s->generation = hdr->generation;
+    MemoryBarrier();
+    s->state = kSlotValid;
+    hdr->dataUsed = off + len;
+    return true;
+}
+
+static int CmpSlotOff(const CacheFileSlot* s1, const CacheFileSlot* s2) {
+    return (int)s1->off - (int)s2->off;
+}
+
+// evicts entries that haven't been used for kCacheFileKeepGenerations
+// opens, moves the survivors' data to the front and rebuilds the slot
+// table. Only called from OpenCacheFile(), before any readers exist
+static void CompactCacheFile(CacheFile* cf) {
+    CacheFileHeader* hdr = cf->hdr;
+    Vec<CacheFileSlot> live;
+    for (u32 i = 0; i < hdr->nSlots; i++) {
+        CacheFileSlot* s = cf->slots + i;
+        if (s->state != kSlotValid) {
+            continue;
+        }
+        if (s->generation + kCacheFileKeepGenerations <= hdr->generation) {
+            continue;
+        }
+        live.Append(*s);
+    }
+    // in offset order so that the memmove below only ever moves data down
+    live.SortTyped(CmpSlotOff);
+    memset(cf->slots, 0, hdr->nSlots * sizeof(CacheFileSlot));
+    u32 used = 0;
+    for (int i = 0; i < live.Size(); i++) {
+        CacheFileSlot s = live.at(i);
+        u32 off = (used + 7) & ~7u;
+        memmove(cf->data + off, cf->data + s.off, s.size);
+        s.off = off;
+        used = off + s.size;
+        CacheFileSlot* dst = FindSlot(cf, s.key, true);
+        *dst = s;
+    }
+    logf("CompactCacheFile: kept %d of %d entries, %u of %u bytes\n", live.Size(), (int)hdr->nSlots, used,
+         hdr->dataUsed);
+    hdr->dataUsed = used;
+}
+
+static bool ValidateCacheFile(CacheFile* cf, u32 nSlots, u32 dataSize) {
+    CacheFileHeader* hdr = cf->hdr;
+    if (hdr->magic != kCacheFileMagic || hdr->nSlots != nSlots || hdr->dataSize != dataSize) {
+        return false;
+    }
+    if (hdr->dataUsed > hdr->dataSize) {
+        return false;
+    }
+    for (u32 i = 0; i < nSlots; i++) {
+        CacheFileSlot* s = cf->slots + i;
+        if (s->state == kSlotEmpty || s->state == kSlotDeleted) {
+            continue;
+        }
+        if (s->state != kSlotValid || s->off + s->size > hdr->dataUsed || s->off + s->size < s->off) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CacheFile* OpenCacheFile(const char* path, u32 nSlots, u32 dataSize) {
+    if (0 == nSlots || 0 == dataSize) {
+        return nullptr;
+    }
+    size_t viewSize = sizeof(CacheFileHeader) + nSlots * (size_t)sizeof(CacheFileSlot) + dataSize;
+    WCHAR* pathW = ToWStrTemp(path);
+    // exclusive write access: a second instance runs without the cache
+    HANDLE hFile =
+        CreateFileW(pathW, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+    if (existed && file::GetSize(path) != (i64)viewSize) {
+        // sizes changed (or the file is truncated): start over
+        existed = false;
+    }
+    HANDLE hMap = CreateFileMappingW(hFile, nullptr, PAGE_READWRITE, (DWORD)((u64)viewSize >> 32),
+                                     (DWORD)(viewSize & 0xffffffff), nullptr);
+    if (!hMap) {
+        CloseHandle(hFile);
+        return nullptr;
+    }
+    u8* view = (u8*)MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, viewSize);
+    if (!view) {
+        CloseHandle(hMap);
+        CloseHandle(hFile);
+        return nullptr;
+    }
+
+    CacheFile* cf = new CacheFile();
+    cf->hFile = hFile;
+    cf->hMap = hMap;
+    cf->view = view;
+    cf->viewSize = viewSize;
+    cf->hdr = (CacheFileHeader*)view;
+    cf->slots = (CacheFileSlot*)(view + sizeof(CacheFileHeader));
+    cf->data = (u8*)(cf->slots + nSlots);
+    InitializeCriticalSection(&cf->writeAccess);
+
+    if (!existed || !ValidateCacheFile(cf, nSlots, dataSize)) {
+        memset(view, 0, sizeof(CacheFileHeader) + nSlots * sizeof(CacheFileSlot));
+        cf->hdr->magic = kCacheFileMagic;
+        cf->hdr->nSlots = nSlots;
+        cf->hdr->dataSize = dataSize;
+    }
+    cf->hdr->generation++;
+    if (cf->hdr->dataUsed * kCacheFileCompactDenom > cf->hdr->dataSize * kCacheFileCompactNum) {
+        CompactCacheFile(cf);
+    }
+    return cf;
+}
+
+void CloseCacheFile(CacheFile* cf) {
+    if (!cf) {
+        return;
+    }
+    UnmapViewOfFile(cf->view);
+    CloseHandle(cf->hMap);
+    CloseHandle(cf->hFile);
+    DeleteCriticalSection(&cf->writeAccess);
+    delete cf;
+}
@@ -0,0 +1,50 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+/* A shared subsystem for on-disk caches (thumbnails, cached tiles,
+   converted documents, ...): one memory-mapped, content-addressed file
+   per cache instead of bespoke file handling in every cache.
+
+   Entries are keyed by a 16-byte content hash. Get() is lock-free and
+   returns a pointer directly into the mapping; entries never move while
+   the file is open, so the slice stays valid until CloseCacheFile().
+   Put() is serialized by a critical section. Every OpenCacheFile()
+   bumps a generation counter and entries remember the generation of
+   their last use; when the data area runs low, entries that haven't
+   been used for many generations are evicted and the file is compacted
+   at open time, before any readers exist.
+
+   The capacity is fixed when the file is created and the file is opened
+   for exclusive writing, so a second instance of the app falls back to
+   running without the cache. */
+
+struct CacheFileHeader;
+struct CacheFileSlot;
+
+struct CacheFile {
+    HANDLE hFile = nullptr;
+    HANDLE hMap = nullptr;
+    u8* view = nullptr;
+    size_t viewSize = 0;
+    // all point into view
+    CacheFileHeader* hdr = nullptr;
+    CacheFileSlot* slots = nullptr;
+    u8* data = nullptr;
+    CRITICAL_SECTION writeAccess;
+
+    // lock-free; returns an empty slice on a miss. A Put() under the
+    // same key invalidates the returned slice
+    ByteSlice Get(const u8 key[16]);
+    // for enumerating entries, idx in [0, NumSlots()); returns an
+    // empty slice for unused slots
+    ByteSlice GetAt(u32 idx);
+    u32 NumSlots() const;
+    // returns false when the cache is full (space is reclaimed on the
+    // next OpenCacheFile) or a second instance owns the file
+    bool Put(const u8 key[16], const ByteSlice& d);
+};
+
+// nSlots and dataSize only matter when the file doesn't exist yet; an
+// existing file with different sizes is discarded and re-created
+CacheFile* OpenCacheFile(const char* path, u32 nSlots, u32 dataSize);
+void CloseCacheFile(CacheFile* cf);
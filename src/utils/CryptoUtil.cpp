@@ -54,6 +54,51 @@ void CalcSHA2Digest(const void* data, int dataSize, u8 digest[32]) {
     CalcDigestWin(data, dataSize, digest, 32, MS_ENH_RSA_AES_PROV, PROV_RSA_AES, CALG_SHA_256);
 }
 
+SHA2Incremental::SHA2Incremental() {
+    BOOL ok = CryptAcquireContextW(&hProv, nullptr, MS_ENH_RSA_AES_PROV, PROV_RSA_AES, CRYPT_VERIFYCONTEXT);
+    if (!ok) {
+        hProv = 0;
+        return;
+    }
+    ok = CryptCreateHash(hProv, CALG_SHA_256, 0, 0, &hHash);
+    if (!ok) {
+        hHash = 0;
+    }
+}
+
+SHA2Incremental::~SHA2Incremental() {
+    if (hHash) {
+        CryptDestroyHash(hHash);
+    }
+    if (hProv) {
+        CryptReleaseContext(hProv, 0);
+    }
+}
+
+void SHA2Incremental::Update(const void* data, size_t size) {
+    if (!hHash) {
+        return;
+    }
+#ifdef _WIN64
+    for (; size > DWORD_MAX; data = (const BYTE*)data + DWORD_MAX, size -= DWORD_MAX) {
+        if (!CryptHashData(hHash, (const BYTE*)data, DWORD_MAX, 0)) {
+            return;
+        }
+    }
+#endif
+    BOOL ok = CryptHashData(hHash, (const BYTE*)data, (DWORD)size, 0);
+    ReportIf(!ok);
+}
+
+bool SHA2Incremental::Finish(u8 digest[32]) {
+    if (!hHash) {
+        return false;
+    }
+    DWORD hashLen = 32;
+    BOOL ok = CryptGetHashParam(hHash, HP_HASHVAL, digest, &hashLen, 0);
+    return ok && hashLen == 32;
+}
+
 static bool ExtractSignature(const char* hexSignature, const void* data, size_t& dataLen, ScopedMem<BYTE>& signature,
                              size_t& signatureLen) {
     // verify hexSignature format - must be either
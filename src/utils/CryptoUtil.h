@@ -5,5 +5,18 @@ void CalcMD5Digest(const void* data, int dataSize, u8 digest[16]);
 void CalcSHA1Digest(const void* data, int dataSize, u8 digest[20]);
 void CalcSHA2Digest(const void* data, int dataSize, u8 digest[32]);
 
+// incremental version of CalcSHA2Digest() for data that arrives in
+// chunks (e.g. while it's still being downloaded)
+struct SHA2Incremental {
+    HCRYPTPROV hProv = 0;
+    HCRYPTHASH hHash = 0;
+
+    SHA2Incremental();
+    ~SHA2Incremental();
+    void Update(const void* data, size_t size);
+    // can only be called once
+    bool Finish(u8 digest[32]);
+};
+
 bool VerifySHA1Signature(const void* data, size_t dataLen, const char* hexSignature, const void* pubkey,
                          size_t pubkeyLen);
@@ -298,6 +298,163 @@ static void AppendAddress(str::Str& s, DWORD64 addr) {
     s.AppendFmt("%p", p);
 }
 
+// ----- compact build-time symbol map -----
+//
+// fallback for machines that can't download .pdb symbols at crash time:
+// a text map of the exe's function RVAs, generated on the build machine
+// (see GenSymbolMap) and shipped next to the binary. Loaded once at
+// startup; lookups don't allocate so they're safe on the crash path
+
+struct SymbolMapEntry {
+    DWORD rva;
+    // points into the loaded map file data
+    const char* name;
+};
+
+static char* gSymbolMapData = nullptr;
+static SymbolMapEntry* gSymbolMap = nullptr;
+static int gSymbolMapCount = 0;
+
+bool HasSymbolMap() {
+    return gSymbolMapCount > 0;
+}
+
+// format: one "<hex rva> <name>" line per function, sorted by rva
+bool LoadSymbolMap(const char* path) {
+    if (gSymbolMap) {
+        return true;
+    }
+    ByteSlice d = file::ReadFile(path);
+    if (d.empty()) {
+        return false;
+    }
+    char* s = (char*)d.data();
+    int nLines = 0;
+    for (char* c = s; *c; c++) {
+        if (*c == '\n') {
+            nLines++;
+        }
+    }
+    SymbolMapEntry* entries = AllocArray<SymbolMapEntry>(nLines + 1);
+    int n = 0;
+    char* c = s;
+    while (*c && n < nLines) {
+        char* line = c;
+        while (*c && *c != '\n') {
+            c++;
+        }
+        char* end = c;
+        if (*c) {
+            c++;
+        }
+        if (end > line && end[-1] == '\r') {
+            end--;
+        }
+        *end = 0;
+        char* sep = line;
+        while (*sep && *sep != ' ') {
+            sep++;
+        }
+        if (!*sep || sep + 1 == end) {
+            continue;
+        }
+        *sep = 0;
+        entries[n].rva = (DWORD)strtoul(line, nullptr, 16);
+        entries[n].name = sep + 1;
+        n++;
+    }
+    gSymbolMapData = s;
+    gSymbolMap = entries;
+    gSymbolMapCount = n;
+    logf("dbghelp::LoadSymbolMap: loaded %d symbols from '%s'\n", n, path);
+    return n > 0;
+}
+
+// returns the name of the mapped function containing addr if addr is
+// inside the main exe module, nullptr otherwise
+static const char* SymbolMapNameFromAddr(DWORD64 addr, DWORD* dispOut) {
+    if (gSymbolMapCount == 0) {
+        return nullptr;
+    }
+    DWORD64 base = (DWORD64)GetModuleHandleW(nullptr);
+    if (addr < base) {
+        return nullptr;
+    }
+    MEMORY_BASIC_INFORMATION mbi{};
+    if (!VirtualQuery((void*)addr, &mbi, sizeof(mbi)) || (DWORD64)mbi.AllocationBase != base) {
+        return nullptr;
+    }
+    DWORD rva = (DWORD)(addr - base);
+    if (rva < gSymbolMap[0].rva) {
+        return nullptr;
+    }
+    // last entry with entry.rva <= rva
+    int lo = 0;
+    int hi = gSymbolMapCount - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (gSymbolMap[mid].rva <= rva) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    *dispOut = rva - gSymbolMap[lo].rva;
+    return gSymbolMap[lo].name;
+}
+
+// enumerates the exe's functions via dbghelp (requires the .pdb, i.e. a
+// build machine) and writes the map that LoadSymbolMap() consumes
+bool GenSymbolMap(const char* path) {
+    if (!DynSymEnumSymbols) {
+        return false;
+    }
+    TempStr exeDir = path::GetDirTemp(GetSelfExePathTemp());
+    WCHAR* dirW = ToWStrTemp(exeDir);
+    if (!Initialize(dirW, false)) {
+        return false;
+    }
+    if (!HasSymbols()) {
+        log("GenSymbolMap: no .pdb symbols for the exe\n");
+        return false;
+    }
+    struct EnumCtx {
+        Vec<SymbolMapEntry>* entries;
+        DWORD64 base;
+    };
+    Vec<SymbolMapEntry> entries;
+    DWORD64 base = (DWORD64)GetModuleHandleW(nullptr);
+    EnumCtx ctx{&entries, base};
+    auto cb = [](PSYMBOL_INFO si, ULONG, PVOID user) -> BOOL {
+        EnumCtx* c = (EnumCtx*)user;
+        if (si->Address < c->base) {
+            return TRUE;
+        }
+        SymbolMapEntry e;
+        e.rva = (DWORD)(si->Address - c->base);
+        e.name = str::Dup(si->Name);
+        c->entries->Append(e);
+        return TRUE;
+    };
+    BOOL ok = DynSymEnumSymbols(GetCurrentProcess(), base, nullptr, cb, &ctx);
+    if (!ok || entries.Size() == 0) {
+        logf("GenSymbolMap: SymEnumSymbols failed or no symbols, ok: %d\n", (int)ok);
+        return false;
+    }
+    SymbolMapEntry* els = entries.LendData();
+    std::sort(els, els + entries.Size(), [](const SymbolMapEntry& a, const SymbolMapEntry& b) { return a.rva < b.rva; });
+    str::Str out;
+    for (SymbolMapEntry& e : entries) {
+        out.AppendFmt("%x %s\r\n", (uint)e.rva, e.name);
+    }
+    ok = file::WriteFile(path, {(u8*)out.Get(), out.size()});
+    for (SymbolMapEntry& e : entries) {
+        str::Free(e.name);
+    }
+    logf("GenSymbolMap: wrote %d symbols to '%s'\n", entries.Size(), path);
+    return ok;
+}
+
 void GetAddressInfo(str::Str& s, DWORD64 addr, bool compact) {
     static const int MAX_SYM_LEN = 512;
 
@@ -331,8 +488,13 @@ void GetAddressInfo(str::Str& s, DWORD64 addr, bool compact) {
             s.AppendFmt(" %s", moduleShort);
         }
 
+        DWORD mapDisp = 0;
+        const char* mapName = symName ? nullptr : SymbolMapNameFromAddr(addr, &mapDisp);
         if (symName) {
             s.AppendFmt("!%s+0x%x", symName, (int)symDisp);
+        } else if (mapName) {
+            // resolved from the compact build-time symbol map
+            s.AppendFmt("!%s+0x%x", mapName, (int)mapDisp);
         } else if (symDisp != 0) {
             s.AppendFmt("+0x%x", (int)symDisp);
         }
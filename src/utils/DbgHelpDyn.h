@@ -5,6 +5,9 @@ namespace dbghelp {
 
 bool Initialize(const WCHAR* symPath, bool force);
 bool HasSymbols();
+bool GenSymbolMap(const char* path);
+bool LoadSymbolMap(const char* path);
+bool HasSymbolMap();
 void GetAddressInfo(str::Str& s, DWORD64 addr, bool compact);
 void WriteMiniDump(const WCHAR* crashDumpFilePath, MINIDUMP_EXCEPTION_INFORMATION* mei, bool fullDump);
 void GetThreadCallstack(str::Str& s, DWORD threadId);
@@ -4,8 +4,6 @@
 /* This is a dictionary with intentionally unorthodox design.
 It's called dictionary, not a hashtable, to emphasize it's
 about the API, not implementation technique.
-Currently it's imlemented on top of a hash table, but it could
-just as well be a tree of some kind.
 
 Usually those things are done as a templated hash table class,
 but I want to avoid code bloat and awful syntax.
@@ -15,16 +13,17 @@ hash table. The actual dict class is a wrapper that provides
 a type-safe API and handles policy decisions like allocations
 (if they are necessary).
 
-Our hash table uses the same parameters as the one in redis
-(but without complexity of incremental hashing):
-- we use chaining on collisions
-- size of the hash table is power of two
+The hash table is open-addressing with linear probing and the
+hash is remembered per slot:
+- lookups walk a flat array instead of chasing per-entry
+  allocations, so misses stay within a cache line or two
+- remembering the hash makes resize a reinsertion by stored
+  hash (no re-hashing of keys) and makes slot comparisons cheap
+- deletion uses backward-shift instead of tombstones so probe
+  chains don't degrade over time
 
 TODO:
 - add iterator for keys/values
-- would hash function be faster if we got bytes one at a time
-  but only with a single pass vs. getting 4 at a time but
-  doing 2 passes (the first to calculate the length)?
 */
 
 #include "utils/BaseUtil.h"
@@ -50,48 +49,43 @@ class StrKeyHasherComparator : public HasherComparator {
     }
 };
 
-class WStrKeyHasherComparator : public HasherComparator {
-    size_t Hash(uintptr_t key) override {
-        size_t cbLen = str::Len((const WCHAR*)key) * sizeof(WCHAR);
-        return MurmurHash2((const void*)key, cbLen);
-    }
-    bool Equal(uintptr_t k1, uintptr_t k2) override {
-        const WCHAR* s1 = (const WCHAR*)k1;
-        const WCHAR* s2 = (const WCHAR*)k2;
-        return str::Eq(s1, s2);
-    }
-};
-
 static StrKeyHasherComparator gStrKeyHasherComparator;
-static WStrKeyHasherComparator gWStrKeyHasherComparator;
 
 struct HashTableEntry {
+    size_t hash; // 0 means an empty slot
     uintptr_t key;
     uintptr_t val;
-    struct HashTableEntry* next;
 };
 
 // not a class so that it can be allocated with an allocator
 struct HashTable {
-    HashTableEntry** entries;
-    HashTableEntry* freeList;
+    HashTableEntry* entries;
 
-    size_t nEntries;
-    size_t nUsed; // total number of inserted entries
+    size_t nEntries; // always a power of two
+    size_t nUsed;    // total number of inserted entries
 
     // for debugging
     size_t nResizes;
     size_t nCollisions;
 };
 
+// 0 is reserved as the empty-slot marker
+static size_t KeyHash(HasherComparator* hc, uintptr_t key) {
+    size_t hash = hc->Hash(key);
+    if (0 == hash) {
+        hash = 1;
+    }
+    return hash;
+}
+
 static HashTable* NewHashTable(size_t size, Allocator* allocator) {
     ReportIf(!allocator); // we'll leak otherwise
     HashTable* h = Allocator::AllocArray<HashTable>(allocator, 1);
     // number of hash table entries should be power of 2
     size = RoundToPowerOf2(size);
     // entries are not allocated with allocator since those are large blocks
-    // and we don't want to waste their memory after
-    h->entries = AllocArray<HashTableEntry*>(size);
+    // and we don't want to waste their memory after resizing
+    h->entries = AllocArray<HashTableEntry>(size);
     h->nEntries = size;
     return h;
 }
@@ -101,111 +95,120 @@ static void DeleteHashTable(HashTable* h) {
     // the rest is freed by allocator
 }
 
-static void HashTableResize(HashTable* h, HasherComparator* hc) {
+// finds the slot key lives in or, if missing, the empty slot
+// where it would be inserted
+static HashTableEntry* FindEntry(HashTable* h, HasherComparator* hc, uintptr_t key, size_t hash) {
+    size_t mask = h->nEntries - 1;
+    size_t pos = hash & mask;
+    for (;;) {
+        HashTableEntry* e = &h->entries[pos];
+        if (0 == e->hash) {
+            return e;
+        }
+        if (e->hash == hash && hc->Equal(key, e->key)) {
+            return e;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+static void HashTableResize(HashTable* h) {
     size_t newSize = RoundToPowerOf2(h->nEntries + 1);
     ReportIf(newSize <= h->nEntries);
-    HashTableEntry** newEntries = AllocArray<HashTableEntry*>(newSize);
-    HashTableEntry *e, *next;
-    size_t hash, pos;
+    HashTableEntry* newEntries = AllocArray<HashTableEntry>(newSize);
+    size_t mask = newSize - 1;
     for (size_t i = 0; i < h->nEntries; i++) {
-        e = h->entries[i];
-        while (e) {
-            next = e->next;
-            hash = hc->Hash(e->key);
-            pos = hash % newSize;
-            e->next = newEntries[pos];
-            newEntries[pos] = e;
-            e = next;
+        HashTableEntry* e = &h->entries[i];
+        if (0 == e->hash) {
+            continue;
         }
+        // the hash is remembered in the slot, so no re-hashing of keys
+        size_t pos = e->hash & mask;
+        while (newEntries[pos].hash != 0) {
+            pos = (pos + 1) & mask;
+        }
+        newEntries[pos] = *e;
     }
     free(h->entries);
     h->entries = newEntries;
     h->nEntries = newSize;
     h->nResizes += 1;
-
-    ReportIf(h->nUsed >= (h->nEntries * 3) / 2);
 }
 
 // micro optimization: this is called often, so we want this check inlined. Resizing logic
 // is called rarely, so doesn't need to be inlined
-static inline void HashTableResizeIfNeeded(HashTable* h, HasherComparator* hc) {
-    // per http://stackoverflow.com/questions/1603712/when-should-i-do-rehashing-of-entire-hash-table/1604428#1604428
-    // when using collision chaining, load factor can be 150%
-    if (h->nUsed < (h->nEntries * 3) / 2) {
+static inline void HashTableResizeIfNeeded(HashTable* h) {
+    // open addressing degrades badly when mostly full; grow at 3/4
+    if ((h->nUsed + 1) * 4 < h->nEntries * 3) {
         return;
     }
-    HashTableResize(h, hc);
+    HashTableResize(h);
 }
 
-// note: allocator must be nullptr for get, non-nullptr for create
-static HashTableEntry* GetOrCreateEntry(HashTable* h, HasherComparator* hc, uintptr_t key, Allocator* allocator,
+// note: shouldCreate must be false for get, true for create
+static HashTableEntry* GetOrCreateEntry(HashTable* h, HasherComparator* hc, uintptr_t key, bool shouldCreate,
                                         bool& newEntry) {
-    bool shouldCreate = (allocator != nullptr);
-    size_t hash = hc->Hash(key);
-    size_t pos = hash % h->nEntries;
-    HashTableEntry* e = h->entries[pos];
+    size_t hash = KeyHash(hc, key);
     newEntry = false;
-    while (e) {
-        if (hc->Equal(key, e->key)) {
-            return e;
-        }
-        e = e->next;
+    if (shouldCreate) {
+        // must resize before probing or the found empty slot could move
+        HashTableResizeIfNeeded(h);
+    }
+    HashTableEntry* e = FindEntry(h, hc, key, hash);
+    if (e->hash != 0) {
+        return e;
     }
     if (!shouldCreate) {
         return nullptr;
     }
 
-    if (h->freeList) {
-        e = h->freeList;
-        h->freeList = h->freeList->next;
-    } else {
-        e = Allocator::AllocArray<HashTableEntry>(allocator, 1);
-    }
-    e->next = h->entries[pos];
-    h->entries[pos] = e;
-    h->nUsed++;
-    if (e->next != nullptr) {
+    size_t pos = e - h->entries;
+    if (pos != (hash & (h->nEntries - 1))) {
         h->nCollisions++;
     }
+    e->hash = hash;
+    h->nUsed++;
     newEntry = true;
     return e;
 }
 
 static bool RemoveEntry(HashTable* h, HasherComparator* hc, uintptr_t key, uintptr_t* removedValOut) {
-    size_t hash = hc->Hash(key);
-    size_t pos = hash % h->nEntries;
-    HashTableEntry* e = h->entries[pos];
-    while (e) {
-        if (hc->Equal(key, e->key)) {
-            break;
-        }
-        e = e->next;
-    }
-    if (!e) {
+    size_t hash = KeyHash(hc, key);
+    HashTableEntry* e = FindEntry(h, hc, key, hash);
+    if (0 == e->hash) {
         return false;
     }
+    *removedValOut = e->val;
 
-    // remove the the entry from the list
-    HashTableEntry* e2 = h->entries[pos];
-    if (e2 == e) {
-        h->entries[pos] = e->next;
-    } else {
-        while (e2->next != e) {
-            e2 = e2->next;
+    // backward-shift deletion: pull later entries of the probe chain
+    // into the hole so lookups never need tombstones
+    size_t mask = h->nEntries - 1;
+    size_t i = e - h->entries;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (0 == h->entries[j].hash) {
+            break;
+        }
+        // the entry at j can fill the hole at i unless its ideal slot
+        // lies cyclically within (i, j], i.e. moving it would break
+        // the probe chain leading to it
+        size_t ideal = h->entries[j].hash & mask;
+        bool inRange = (i <= j) ? (i < ideal && ideal <= j) : (i < ideal || ideal <= j);
+        if (inRange) {
+            continue;
         }
-        e2->next = e->next;
+        h->entries[i] = h->entries[j];
+        i = j;
     }
-    e->next = h->freeList;
-    h->freeList = e;
-    *removedValOut = e->val;
+    h->entries[i].hash = 0;
     ReportIf(0 == h->nUsed);
     h->nUsed -= 1;
     return true;
 }
 
 MapStrToInt::MapStrToInt(size_t initialSize) {
-    // we use PoolAllocator to allocate HashTableEntry entries
-    // and copies of string keys
+    // we use PoolAllocator to intern the string keys
     h = NewHashTable(initialSize, &allocator);
 }
 
@@ -228,7 +231,7 @@ size_t MapStrToInt::Count() const {
 //   * sets existingKeyOut to (interned) key
 bool MapStrToInt::Insert(const char* key, int val, int* existingValOut, const char** existingKeyOut) {
     bool newEntry;
-    HashTableEntry* e = GetOrCreateEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, &allocator, newEntry);
+    HashTableEntry* e = GetOrCreateEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, true, newEntry);
     if (!newEntry) {
         if (existingValOut) {
             *existingValOut = (int)e->val;
@@ -238,13 +241,11 @@ bool MapStrToInt::Insert(const char* key, int val, int* existingValOut, const ch
         }
         return false;
     }
-    e->key = (intptr_t)str::Dup(&allocator, key);
-    e->val = (intptr_t)val;
+    e->key = (uintptr_t)str::Dup(&allocator, key);
+    e->val = (uintptr_t)val;
     if (existingKeyOut) {
         *existingKeyOut = (const char*)e->key;
     }
-
-    HashTableResizeIfNeeded(h, &gStrKeyHasherComparator);
     return true;
 }
 
@@ -258,9 +259,8 @@ bool MapStrToInt::Remove(const char* key, int* removedValOut) const {
 }
 
 bool MapStrToInt::Get(const char* key, int* valOut) const {
-    StrKeyHasherComparator hc;
     bool newEntry;
-    HashTableEntry* e = GetOrCreateEntry(h, &hc, (uintptr_t)key, nullptr, newEntry);
+    HashTableEntry* e = GetOrCreateEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, false, newEntry);
     if (!e) {
         return false;
     }
@@ -268,4 +268,59 @@ bool MapStrToInt::Get(const char* key, int* valOut) const {
     return true;
 }
 
+MapStrToPtr::MapStrToPtr(size_t initialSize) {
+    // we use PoolAllocator to intern the string keys
+    h = NewHashTable(initialSize, &allocator);
+}
+
+MapStrToPtr::~MapStrToPtr() {
+    DeleteHashTable(h);
+}
+
+size_t MapStrToPtr::Count() const {
+    return h->nUsed;
+}
+
+// removes all entries (and their interned keys) but keeps the first
+// allocator block cached for re-filling
+void MapStrToPtr::Reset() {
+    size_t size = h->nEntries;
+    DeleteHashTable(h);
+    allocator.Reset(false);
+    h = NewHashTable(size, &allocator);
+}
+
+// if the key already exists, returns false and leaves the existing
+// value in place. Otherwise inserts a copy of the key allocated with
+// allocator and returns true
+bool MapStrToPtr::Insert(const char* key, void* val) {
+    bool newEntry;
+    HashTableEntry* e = GetOrCreateEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, true, newEntry);
+    if (!newEntry) {
+        return false;
+    }
+    e->key = (uintptr_t)str::Dup(&allocator, key);
+    e->val = (uintptr_t)val;
+    return true;
+}
+
+bool MapStrToPtr::Remove(const char* key, void** removedValOut) const {
+    uintptr_t removedVal;
+    bool removed = RemoveEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, &removedVal);
+    if (removed && removedValOut) {
+        *removedValOut = (void*)removedVal;
+    }
+    return removed;
+}
+
+bool MapStrToPtr::Get(const char* key, void** valOut) const {
+    bool newEntry;
+    HashTableEntry* e = GetOrCreateEntry(h, &gStrKeyHasherComparator, (uintptr_t)key, false, newEntry);
+    if (!e) {
+        return false;
+    }
+    *valOut = (void*)e->val;
+    return true;
+}
+
 } // namespace dict
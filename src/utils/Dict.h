@@ -5,14 +5,12 @@ namespace dict {
 
 struct HashTable;
 
-// we are very generous with default initial size. It's a trade-off
-// between memory used by hash table and how often we need to resize it.
-// We allocate size*sizeof(ptr) which is 64k on 32-bit for 16k entries.
-// 64k is very little on today's machines, especially for short-lived
-// hash tables.
-// Should use smaller values for long-lived hash tables, especially
-// if there are many of them.
-enum { DEFAULT_HASH_TABLE_INITIAL_SIZE = 16 * 1024 };
+// a trade-off between memory used by the hash table and how often we
+// need to resize it. Slots are stored inline (24 bytes each on 64-bit)
+// and resizing doesn't re-hash keys, so erring on the small side is
+// cheap; callers that know they'll store many entries can pass a
+// bigger initial size.
+enum { DEFAULT_HASH_TABLE_INITIAL_SIZE = 1024 };
 
 // a dictionary whose keys are char * strings and the values are integers
 // note: StrToInt would be more natural name but it's re-#define'd in <shlwapi.h>
@@ -32,4 +30,22 @@ class MapStrToInt {
     bool Get(const char* key, int* valOut) const;
 };
 
+// a dictionary whose keys are char * strings and the values are pointers.
+// doesn't own the values
+class MapStrToPtr {
+  public:
+    PoolAllocator allocator;
+    HashTable* h = nullptr;
+
+    explicit MapStrToPtr(size_t initialSize = DEFAULT_HASH_TABLE_INITIAL_SIZE);
+    ~MapStrToPtr();
+
+    size_t Count() const;
+    void Reset();
+
+    bool Insert(const char* key, void* val);
+    bool Remove(const char* key, void** removedValOut = nullptr) const;
+    bool Get(const char* key, void** valOut) const;
+};
+
 } // namespace dict
@@ -5,6 +5,7 @@
 #include "utils/FileUtil.h"
 #include "utils/ThreadUtil.h"
 #include "utils/WinUtil.h"
+#include "utils/MpScQueue.h"
 #include "utils/StrQueue.h"
 #include "utils/DirIter.h"
 
@@ -179,14 +180,122 @@ struct DirTraverseThreadData {
     }
 };
 
+// traversal is i/o bound so a thread per core still helps on fast
+// (NVMe) storage where directory reads can be issued concurrently
+#define MAX_DIR_TRAVERSE_THREADS 16
+
+struct TraverseDirsState {
+    StrQueue* results = nullptr; // we don't own it
+    bool recurse = false;
+    int nThreads = 0;
+
+    CRITICAL_SECTION cs;
+    StrVec dirsToVisit; // guarded by cs
+    int nBusy = 0;      // workers currently enumerating a directory, guarded by cs
+    bool done = false;  // guarded by cs
+    HANDLE hSem = nullptr; // counts directories waiting in dirsToVisit
+};
+
+// enumerate one directory, appending files to results and
+// sub-directories to the shared to-visit list
+static void TraverseOneDir(TraverseDirsState* st, const char* dir) {
+    TempWStr dirW = ToWStrTemp(dir);
+    WCHAR* pattern = path::Join(dirW, L"*");
+    WIN32_FIND_DATAW fd;
+    // FindExInfoBasic skips the short-name lookup we don't need
+    HANDLE h =
+        FindFirstFileExW(pattern, FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    str::Free(pattern);
+    if (!IsValidHandle(h)) {
+        return;
+    }
+    do {
+        bool isFile = IsRegularFile(fd.dwFileAttributes);
+        bool isDir = IsDirectory(fd.dwFileAttributes);
+        char* name = ToUtf8Temp(fd.cFileName);
+        if (isFile) {
+            char* path = path::JoinTemp(dir, name);
+            st->results->Append(path);
+        } else if (isDir && st->recurse && !IsSpecialDir(name)) {
+            char* path = path::JoinTemp(dir, name);
+            EnterCriticalSection(&st->cs);
+            st->dirsToVisit.Append(path);
+            LeaveCriticalSection(&st->cs);
+            ReleaseSemaphore(st->hSem, 1, nullptr);
+        }
+    } while (FindNextFileW(h, &fd));
+    FindClose(h);
+}
+
+static void TraverseDirsWorker(TraverseDirsState* st) {
+    for (;;) {
+        WaitForSingleObject(st->hSem, INFINITE);
+        EnterCriticalSection(&st->cs);
+        if (st->done) {
+            LeaveCriticalSection(&st->cs);
+            return;
+        }
+        int n = st->dirsToVisit.Size();
+        ReportIf(n == 0);
+        char* dir = st->dirsToVisit.RemoveAt(n - 1);
+        st->nBusy++;
+        LeaveCriticalSection(&st->cs);
+
+        {
+            // per-directory temp strings aren't needed once copied
+            // into results / dirsToVisit
+            ScopedTempAllocMark tempMark;
+            TraverseOneDir(st, dir);
+        }
+
+        EnterCriticalSection(&st->cs);
+        st->nBusy--;
+        if (0 == st->nBusy && 0 == st->dirsToVisit.Size()) {
+            // no work left and nobody is producing more: wake
+            // everybody (including ourselves) up to exit
+            st->done = true;
+            ReleaseSemaphore(st->hSem, st->nThreads, nullptr);
+        }
+        LeaveCriticalSection(&st->cs);
+    }
+}
+
 static void DirTraverseThread(DirTraverseThreadData* td) {
-    DirIter di(td->dir);
-    di.includeFiles = true;
-    di.includeDirs = false;
-    di.recurse = td->recurse;
-    for (DirIterEntry* de : di) {
-        td->queue->Append(de->filePath);
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = limitValue<int>((int)si.dwNumberOfProcessors, 1, MAX_DIR_TRAVERSE_THREADS);
+    if (!td->recurse) {
+        // a single directory can't be split between workers
+        nThreads = 1;
     }
+
+    TraverseDirsState st;
+    st.results = td->queue;
+    st.recurse = td->recurse;
+    st.nThreads = nThreads;
+    InitializeCriticalSection(&st.cs);
+    st.hSem = CreateSemaphoreW(nullptr, 0, 0x7fffffff, nullptr);
+    st.dirsToVisit.Append(td->dir);
+    ReleaseSemaphore(st.hSem, 1, nullptr);
+
+    HANDLE threads[MAX_DIR_TRAVERSE_THREADS]{};
+    int nStarted = 0;
+    auto fn = MkFunc0(TraverseDirsWorker, &st);
+    for (int i = 0; i < nThreads - 1; i++) {
+        threads[nStarted] = StartThread(fn, "DirTraverseWorker");
+        if (threads[nStarted]) {
+            nStarted++;
+        }
+    }
+    // this thread is a worker as well; returns when the traversal is done
+    TraverseDirsWorker(&st);
+    for (int i = 0; i < nStarted; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+
+    CloseHandle(st.hSem);
+    DeleteCriticalSection(&st.cs);
     td->queue->MarkFinished();
     delete td;
 }
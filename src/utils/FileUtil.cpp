@@ -120,7 +120,8 @@ char* Join(const char* path, const char* fileName) {
 }
 
 bool IsDirectory(const char* path) {
-    auto pathW = ToWStrTemp(path);
+    WCHAR buf[MAX_PATH];
+    WCHAR* pathW = strconv::Utf8ToWStrBuf(path, (size_t)-1, buf, dimof(buf), GetTempAllocator());
     DWORD attrs = GetFileAttributesW(pathW);
     if (INVALID_FILE_ATTRIBUTES == attrs) {
         return false;
@@ -231,6 +232,10 @@ WCHAR* Join(const WCHAR* path, const WCHAR* fileName, const WCHAR* fileName2) {
 //    "c:\foo\bar.pdf" becomes "c:\foo\Bar.Pdf"
 //    "C:\foo\BAR.PDF" becomes "C:\foo\Bar.Pdf"
 WCHAR* Normalize(const WCHAR* path) {
+    // leave urls of remote documents alone, GetFullPathName would mangle them
+    if (str::StartsWithI(path, L"http://") || str::StartsWithI(path, L"https://")) {
+        return str::Dup(path);
+    }
     // convert to absolute path, change slashes into backslashes
     DWORD cch = GetFullPathNameW(path, 0, nullptr, nullptr);
     if (!cch) {
@@ -466,6 +471,10 @@ bool IsAbsolute(const char* path) {
     TempWStr ws = ToWStrTemp(path);
     return !PathIsRelativeW(ws);
 }
+
+bool IsHttpUrl(const char* path) {
+    return str::StartsWithI(path, "http://") || str::StartsWithI(path, "https://");
+}
 } // namespace path
 
 // returns the path to either the %TEMP% directory or a
@@ -586,16 +595,71 @@ bool WriteFile(const char* path, const ByteSlice& d) {
 }
 
 HANDLE OpenReadOnly(const char* path) {
-    WCHAR* filePath = ToWStrTemp(path);
+    WCHAR buf[MAX_PATH];
+    WCHAR* filePath = strconv::Utf8ToWStrBuf(path, (size_t)-1, buf, dimof(buf), GetTempAllocator());
     return CreateFileW(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 }
 
+// maps a file read-only into the address space so that large files can
+// be accessed on demand via page faults instead of being read up front
+bool MapFile(const char* path, FileMap* fm) {
+    ReportIf(!fm || fm->data);
+    // share write access: the file stays mapped for as long as the document
+    // is open and denying writes would make appending an incremental PDF
+    // save to the file we loaded it from fail with a sharing violation.
+    // Appending doesn't modify the bytes the mapping can see
+    WCHAR* filePath = ToWStrTemp(path);
+    DWORD sharing = FILE_SHARE_READ | FILE_SHARE_WRITE;
+    HANDLE hFile = CreateFileW(filePath, GENERIC_READ, sharing, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == hFile) {
+        return false;
+    }
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart <= 0) {
+        CloseHandle(hFile);
+        return false;
+    }
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hMapping) {
+        CloseHandle(hFile);
+        return false;
+    }
+    void* data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        // e.g. a 1 GB file might not fit the address space of a 32-bit build
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+    fm->data = (u8*)data;
+    fm->size = size.QuadPart;
+    fm->hFile = hFile;
+    fm->hMapping = hMapping;
+    return true;
+}
+
+void UnmapFile(FileMap* fm) {
+    if (!fm || !fm->data) {
+        return;
+    }
+    UnmapViewOfFile(fm->data);
+    CloseHandle(fm->hMapping);
+    CloseHandle(fm->hFile);
+    fm->data = nullptr;
+    fm->size = 0;
+    fm->hMapping = nullptr;
+    fm->hFile = INVALID_HANDLE_VALUE;
+}
+
 bool Exists(const char* path) {
     if (!path) {
         return false;
     }
 
-    WCHAR* pathW = ToWStrTemp(path);
+    // stack buffer: Exists() is called for every file during session
+    // restore and history validation (long paths fall back to alloc)
+    WCHAR buf[MAX_PATH];
+    WCHAR* pathW = strconv::Utf8ToWStrBuf(path, (size_t)-1, buf, dimof(buf), GetTempAllocator());
     WIN32_FILE_ATTRIBUTE_DATA fileInfo;
     BOOL res = GetFileAttributesEx(pathW, GetFileExInfoStandard, &fileInfo);
     if (0 == res) {
@@ -27,6 +27,8 @@ bool IsSame(const char* path1, const char* path2);
 bool HasVariableDriveLetter(const char* path);
 bool IsOnFixedDrive(const char* path);
 bool IsAbsolute(const char* path);
+// http:// or https:// url of a remote document
+bool IsHttpUrl(const char* path);
 
 bool Match(const char* path, const char* filter);
 
@@ -53,6 +55,17 @@ ByteSlice ReadFile(const char* path);
 int ReadN(const char* path, char* buf, size_t toRead);
 bool WriteFile(const char* path, const ByteSlice&);
 
+// a read-only memory mapping of a file. data is valid until UnmapFile()
+struct FileMap {
+    u8* data = nullptr;
+    i64 size = 0;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = nullptr;
+};
+
+bool MapFile(const char* path, FileMap* fm);
+void UnmapFile(FileMap* fm);
+
 i64 GetSize(const char*);
 bool Delete(const char* path);
 bool DeleteFileToTrash(const char* path);
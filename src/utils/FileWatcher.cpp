@@ -37,11 +37,6 @@ periodically wake up thread.
 TODO:
   - should I end the thread when there are no files to watch?
 
-  - a single file copy can generate multiple notifications for the same
-    file. add some delay mechanism so that subsequent change notifications
-    cancel a previous, delayed one ? E.g. a copy f2.pdf f.pdf generates 3
-    notifications if f2.pdf is 2 MB.
-
   - try to handle short file names as well: http://blogs.msdn.com/b/ericgu/archive/2005/10/07/478396.aspx
     but how to test it?
 
@@ -53,6 +48,16 @@ TODO:
 // there's a balance between responsiveness to changes and efficiency
 #define FILEWATCH_DELAY_IN_MS 1000
 
+// a single file write can generate several change notifications and tools
+// like latexmk write the same file multiple times in quick succession, so
+// we wait for this much quiet time before calling back, each new
+// notification re-starting the wait
+#define FILEWATCH_DEBOUNCE_IN_MS 200
+
+// when the writer still has the file open we push the callback back by the
+// debounce delay, but no more than this many times
+#define FILEWATCH_MAX_WRITE_RETRIES 25
+
 // Some people use overlapped.hEvent to store data but I'm playing it safe.
 struct OverlappedEx {
     OVERLAPPED overlapped{};
@@ -86,6 +91,12 @@ struct WatchedFile {
     bool isManualCheck = false;
     FileWatcherState fileState;
 
+    // when non-zero, a change notification is pending and will be fired
+    // at this time (in GetTickCount64() ms), unless a new notification
+    // or a still-busy writer pushes it back
+    i64 notifyDue = 0;
+    int notifyRetries = 0;
+
     bool ignore = false;
 };
 
@@ -149,11 +160,6 @@ static bool FileStateChanged(const char* filePath, FileWatcherState* fs) {
 // TODO: per internet, fileName could be short, 8.3 dos-style name
 // and we don't handle that. On the other hand, I've only seen references
 // to it wrt. to rename/delete operation, which we don't get notified about
-//
-// TODO: to collapse multiple notifications for the same file, could put it on a
-// queue, restart the thread with a timeout, restart the process if we
-// get notified again before timeout expires, call OnFileChanges() when
-// timeout expires
 static void NotifyAboutFile(WatchedDir* d, const char* fileName) {
     int i = 0;
 
@@ -177,7 +183,12 @@ static void NotifyAboutFile(WatchedDir* d, const char* fileName) {
         // because the time granularity is so big that this can cause genuine
         // file notifications to be ignored. (This happens for instance for
         // PDF files produced by pdftex from small.tex document)
-        wf->onFileChangedCb.Call();
+        //
+        // the callback is fired in FireFileChangeNotifications() after
+        // FILEWATCH_DEBOUNCE_IN_MS of quiet, so that the multiple
+        // notifications a single save generates coalesce into one
+        wf->notifyDue = (i64)GetTickCount64() + FILEWATCH_DEBOUNCE_IN_MS;
+        wf->notifyRetries = 0;
     }
 }
 
@@ -290,12 +301,23 @@ static void StartMonitoringDirForChanges(WatchedDir* wd) {
 
 static DWORD GetTimeoutInMs() {
     ScopedCritSec cs(&gFileWatcherMutex);
+    i64 timeout = (i64)INFINITE;
+    i64 now = (i64)GetTickCount64();
     for (WatchedFile* wf = gWatchedFiles; wf; wf = wf->next) {
-        if (wf->isManualCheck) {
-            return FILEWATCH_DELAY_IN_MS;
+        if (wf->notifyDue > 0) {
+            i64 due = wf->notifyDue - now;
+            if (due < 1) {
+                due = 1;
+            }
+            if (due < timeout) {
+                timeout = due;
+            }
+        }
+        if (wf->isManualCheck && FILEWATCH_DELAY_IN_MS < timeout) {
+            timeout = FILEWATCH_DELAY_IN_MS;
         }
     }
-    return INFINITE;
+    return (DWORD)timeout;
 }
 
 static void RunManualChecks() {
@@ -307,11 +329,53 @@ static void RunManualChecks() {
         }
         if (FileStateChanged(wf->filePath, &wf->fileState)) {
             // logf("RunManualCheck() %s changed\n", wf->filePath);
-            wf->onFileChangedCb.Call();
+            wf->notifyDue = (i64)GetTickCount64() + FILEWATCH_DEBOUNCE_IN_MS;
+            wf->notifyRetries = 0;
         }
     }
 }
 
+// if we can't open the file for reading the writer most likely still has
+// it open i.e. the write is not finished yet and a reload would see a
+// partially written document
+static bool IsFileBeingWritten(const char* filePath) {
+    WCHAR* pathW = ToWStrTemp(filePath);
+    HANDLE h = CreateFileW(pathW, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (INVALID_HANDLE_VALUE == h) {
+        return GetLastError() == ERROR_SHARING_VIOLATION;
+    }
+    CloseHandle(h);
+    return false;
+}
+
+// fires the callbacks scheduled in NotifyAboutFile() / RunManualChecks()
+// whose quiet period has passed. If the writer still has the file open
+// the callback is pushed back (with a cap, so a file that's permanently
+// locked for reading doesn't postpone it forever)
+static void FireFileChangeNotifications() {
+    ScopedCritSec cs(&gFileWatcherMutex);
+
+    i64 now = (i64)GetTickCount64();
+    for (WatchedFile* wf = gWatchedFiles; wf; wf = wf->next) {
+        if (wf->notifyDue <= 0 || now < wf->notifyDue) {
+            continue;
+        }
+        if (wf->notifyRetries < FILEWATCH_MAX_WRITE_RETRIES && IsFileBeingWritten(wf->filePath)) {
+            logf("FireFileChangeNotifications: '%s' is still being written to\n", wf->filePath);
+            wf->notifyRetries++;
+            wf->notifyDue = now + FILEWATCH_DEBOUNCE_IN_MS;
+            continue;
+        }
+        wf->notifyDue = 0;
+        wf->notifyRetries = 0;
+        if (wf->ignore) {
+            // could have been set while the notification was pending
+            continue;
+        }
+        wf->onFileChangedCb.Call();
+    }
+}
+
 static void FileWatcherThread() {
     HANDLE handles[1];
     // must be alertable to receive ReadDirectoryChangesW() callbacks and APCs
@@ -324,6 +388,7 @@ static void FileWatcherThread() {
         DWORD obj = WaitForMultipleObjectsEx(1, handles, FALSE, timeout, alertable);
         if (WAIT_TIMEOUT == obj) {
             RunManualChecks();
+            FireFileChangeNotifications();
             continue;
         }
 
@@ -122,27 +122,98 @@ static const char* gFileExts = DEF_EXT_KIND(EXT);
 static Kind gExtsKind[] = {DEF_EXT_KIND(KIND)};
 #undef KIND
 
+// entries in gFileExts that can't be matched by just the part after
+// the last '.'; must be checked before the extension lookup so that
+// e.g. ".fb2.zip" isn't classified as ".zip"
+// clang-format off
+static const char* gMultiPartExts =
+    ".fb2.zip\0"
+    ".ps.gz\0"
+    "file_id.diz\0"
+    "read.me\0";
+static Kind gMultiPartKinds[] = {
+    kindFileFb2z,
+    kindFilePS,
+    kindFileTxt,
+    kindFileTxt
+};
+// clang-format on
+
+// maps a hash of a (lower-cased) file extension to index + 1 in
+// gFileExts, 0 means no match; the seed is picked in BuildExtHashTable
+// so that every extension lands in its own bucket (i.e. the hash is
+// perfect and a lookup is one probe plus one string compare)
+constexpr u32 kExtHashBuckets = 512;
+static u8 gExtHashToIdx[kExtHashBuckets];
+static u32 gExtHashSeed = 0;
+
+static u32 HashFileExt(const char* ext, u32 seed) {
+    u32 h = seed;
+    char c;
+    while ((c = *ext++) != 0) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h = h * 33 + (u8)c;
+    }
+    return h % kExtHashBuckets;
+}
+
+static void BuildExtHashTable() {
+    for (u32 seed = 1;; seed++) {
+        ZeroMemory(gExtHashToIdx, sizeof(gExtHashToIdx));
+        bool collided = false;
+        const char* ext = gFileExts;
+        int idx = 0;
+        while (ext && !collided) {
+            u32 h = HashFileExt(ext, seed);
+            collided = gExtHashToIdx[h] != 0;
+            gExtHashToIdx[h] = (u8)(idx + 1);
+            seqstrings::Next(ext);
+            idx++;
+        }
+        if (!collided) {
+            gExtHashSeed = seed;
+            return;
+        }
+    }
+}
+
 static Kind GetKindByFileExt(const char* path) {
+    int n = (int)dimof(gMultiPartKinds);
+    for (int i = 0; i < n; i++) {
+        const char* ext = seqstrings::IdxToStr(gMultiPartExts, i);
+        if (str::EndsWithI(path, ext)) {
+            return gMultiPartKinds[i];
+        }
+    }
     char* ext = path::GetExtTemp(path);
-    int idx = seqstrings::StrToIdxIS(gFileExts, ext);
-    if (idx < 0) {
+    if (str::IsEmpty(ext)) {
+        return nullptr;
+    }
+    u32 h = HashFileExt(ext, gExtHashSeed);
+    int idx = (int)gExtHashToIdx[h] - 1;
+    if (idx < 0 || idx >= (int)dimof(gExtsKind)) {
         return nullptr;
     }
-    int n = (int)dimof(gExtsKind);
-    if (idx >= n) {
+    // the hash can still map an unknown extension into a used bucket
+    if (!str::EqIS(seqstrings::IdxToStr(gFileExts, idx), ext)) {
         return nullptr;
     }
     return gExtsKind[idx];
 }
 
-// ensure gFileExts and gExtsKind match
+// build the lookup tables and ensure gFileExts and gExtsKind match
 static bool gDidVerifyExtsMatch = false;
 static void VerifyExtsMatch() {
     if (gDidVerifyExtsMatch) {
         return;
     }
+    BuildExtHashTable();
     ReportIf(kindFileEpub != GetKindByFileExt("foo.epub"));
     ReportIf(kindFileJp2 != GetKindByFileExt("foo.JP2"));
+    ReportIf(kindFileFb2z != GetKindByFileExt("foo.fb2.zip"));
+    ReportIf(kindFileTxt != GetKindByFileExt("README.read.me"));
     gDidVerifyExtsMatch = true;
 }
 
@@ -191,6 +262,26 @@ struct FileSig {
 static FileSig gFileSigs[] = {FILE_SIGS(MK_SIG)};
 #undef MK_SIG
 
+// bit b is set if some signature at offset 0 starts with byte b; the
+// common case (the first byte matches no signature) is then decided by
+// a single bit test instead of trying every signature
+static u32 gSigFirstByteMask[8];
+static bool gDidBuildSigMask = false;
+
+static void BuildSigFirstByteMask() {
+    if (gDidBuildSigMask) {
+        return;
+    }
+    for (const FileSig& fs : gFileSigs) {
+        if (fs.offset != 0) {
+            continue;
+        }
+        u8 b = (u8)fs.sig[0];
+        gSigFirstByteMask[b >> 5] |= 1u << (b & 31);
+    }
+    gDidBuildSigMask = true;
+}
+
 // PDF files have %PDF-${ver} somewhere in the beginning of the file
 static bool IsPdfFileContent(const ByteSlice& d) {
     if (d.size() < 8) {
@@ -288,9 +379,16 @@ Kind GuessFileTypeFromContent(const ByteSlice& d) {
     size_t len = d.size();
     int n = (int)dimof(gFileSigs);
 
+    BuildSigFirstByteMask();
+    u8 b0 = len > 0 ? data[0] : 0;
+    bool anySigAt0 = (gSigFirstByteMask[b0 >> 5] >> (b0 & 31)) & 1;
+
     for (int i = 0; i < n; i++) {
-        const char* sig = gFileSigs[i].sig;
         size_t off = gFileSigs[i].offset;
+        if (0 == off && !anySigAt0) {
+            continue;
+        }
+        const char* sig = gFileSigs[i].sig;
         size_t sigLen = gFileSigs[i].sigLen;
         size_t sigMaxLen = off + sigLen;
         u8* dat = data + off;
@@ -5,6 +5,28 @@
 #include "HtmlParserLookup.h"
 #include "HtmlPullParser.h"
 
+#if defined(_M_X64) || defined(_M_IX86)
+// SSE2 is part of the x64 baseline and the compiler emits it freely on
+// x86 as well (/arch:SSE2 is the default), so unlike the SSSE3/AVX2
+// kernels in PixelConvert there's no runtime dispatch needed
+#include <emmintrin.h>
+#include <intrin.h>
+#define HAS_SIMD_SCAN 1
+#endif
+
+#ifdef HAS_SIMD_SCAN
+// bitmask of the bytes in v that are whitespace per str::IsWs()
+// (' ' or '\t'..'\r'; the signed compares also reject bytes >= 0x80,
+// same as the signed char comparison in the scalar version)
+static int WsMask(__m128i v) {
+    __m128i isSpace = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i geTab = _mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1));
+    __m128i leCr = _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1));
+    __m128i ws = _mm_or_si128(isSpace, _mm_and_si128(geTab, leCr));
+    return _mm_movemask_epi8(ws);
+}
+#endif
+
 // returns -1 if didn't find
 int HtmlEntityNameToRune(const char* name, size_t nameLen) {
     return FindHtmlEntityRune(name, nameLen);
@@ -32,25 +54,57 @@ int HtmlEntityNameToRune(const WCHAR* name, size_t nameLen) {
 }
 
 bool SkipUntil(const char*& s, const char* end, char c) {
-    while ((s < end) && (*s != c)) {
-        ++s;
-    }
-    return *s == c;
+    // memchr is a vectorized scan, much faster than a byte-at-a-time
+    // loop on the multi-megabyte documents this parser sees
+    if (s >= end) {
+        return false;
+    }
+    const char* found = (const char*)memchr(s, c, end - s);
+    if (!found) {
+        s = end;
+        return false;
+    }
+    s = found;
+    return true;
 }
 
 bool SkipUntil(const char*& s, const char* end, const char* term) {
     size_t len = str::Len(term);
-    for (; s < end; s++) {
-        if (s + len <= end && str::StartsWith(s, term)) {
+    if (0 == len) {
+        return s < end;
+    }
+    // scan for the first character of term, verify the rest on a hit
+    while (s + len <= end) {
+        const char* found = (const char*)memchr(s, *term, end - s - len + 1);
+        if (!found) {
+            break;
+        }
+        if (str::StartsWith(found, term)) {
+            s = found;
             return true;
         }
+        s = found + 1;
     }
+    s = end;
     return false;
 }
 
 // return true if skipped
 bool SkipWs(const char*& s, const char* end) {
     const char* start = s;
+#ifdef HAS_SIMD_SCAN
+    while (s + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        int nonWs = WsMask(v) ^ 0xffff;
+        if (nonWs) {
+            unsigned long idx;
+            _BitScanForward(&idx, nonWs);
+            s += idx;
+            return start != s;
+        }
+        s += 16;
+    }
+#endif
     while ((s < end) && str::IsWs(*s)) {
         ++s;
     }
@@ -60,6 +114,19 @@ bool SkipWs(const char*& s, const char* end) {
 // return true if skipped
 bool SkipNonWs(const char*& s, const char* end) {
     const char* start = s;
+#ifdef HAS_SIMD_SCAN
+    while (s + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        int ws = WsMask(v);
+        if (ws) {
+            unsigned long idx;
+            _BitScanForward(&idx, ws);
+            s += idx;
+            return start != s;
+        }
+        s += 16;
+    }
+#endif
     while ((s < end) && !str::IsWs(*s)) {
         ++s;
     }
@@ -359,6 +426,27 @@ AttrInfo* HtmlToken::NextAttr() {
 // Returns false if didn't find
 static bool SkipUntilTagEnd(const char*& s, const char* end) {
     while (s < end) {
+#ifdef HAS_SIMD_SCAN
+        // jump straight to the next '>' or quote; everything else
+        // inside a tag is attribute data we don't care about here
+        while (s + 16 <= end) {
+            __m128i v = _mm_loadu_si128((const __m128i*)s);
+            __m128i hit = _mm_cmpeq_epi8(v, _mm_set1_epi8('>'));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask) {
+                unsigned long idx;
+                _BitScanForward(&idx, mask);
+                s += idx;
+                break;
+            }
+            s += 16;
+        }
+        if (s >= end) {
+            break;
+        }
+#endif
         char c = *s++;
         if ('>' == c) {
             --s;
@@ -96,6 +96,9 @@ class HtmlPullParser {
     void SetCurrPosOff(ptrdiff_t off) {
         currPos = start + off;
     }
+    ptrdiff_t CurrPosOff() const {
+        return currPos - start;
+    }
     size_t Len() const {
         return len;
     }
@@ -98,10 +98,122 @@ Error:
     goto Exit;
 }
 
+HttpRangeReader::~HttpRangeReader() {
+    if (hInet) {
+        InternetCloseHandle(hInet);
+    }
+}
+
+int HttpRangeReader::Read(i64 offset, void* buf, int count) {
+    WCHAR* urlW = ToWStrTemp(url);
+    DWORD flags = INTERNET_FLAG_KEEP_CONNECTION | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD |
+                  INTERNET_FLAG_IGNORE_CERT_CN_INVALID;
+    if (str::StartsWithI(url, "https")) {
+        flags |= INTERNET_FLAG_SECURE;
+    }
+    int nRead = 0;
+    DWORD statusCode = 0;
+    DWORD headerBuffSize = sizeof(DWORD);
+    TempStr rangeHdr = str::FormatTemp("Range: bytes=%d-%d", (int)offset, (int)(offset + count - 1));
+    WCHAR* hdrs = ToWStrTemp(rangeHdr);
+    HINTERNET hReq = InternetOpenUrlW(hInet, urlW, hdrs, (DWORD)-1, flags, 0);
+    if (!hReq) {
+        logf("HttpRangeReader::Read: InternetOpenUrl('%s') failed\n", url.Get());
+        LogLastError();
+        return 0;
+    }
+    if (!HttpQueryInfoW(hReq, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &headerBuffSize, nullptr)) {
+        goto Exit;
+    }
+    if (statusCode != 206) {
+        // the server stopped honoring range requests
+        logf("HttpRangeReader::Read: status code %d, expected 206\n", (int)statusCode);
+        goto Exit;
+    }
+    while (nRead < count) {
+        DWORD dwRead = 0;
+        if (!InternetReadFile(hReq, (char*)buf + nRead, (DWORD)(count - nRead), &dwRead)) {
+            LogLastError();
+            break;
+        }
+        if (0 == dwRead) {
+            break;
+        }
+        nRead += (int)dwRead;
+    }
+Exit:
+    InternetCloseHandle(hReq);
+    return nRead;
+}
+
+// probes url with a range request; returns nullptr if it can't be
+// reached or the server doesn't support range requests. The total
+// document size is parsed out of the Content-Range response header
+HttpRangeReader* CreateHttpRangeReader(const char* urlA) {
+    logf("CreateHttpRangeReader: url: '%s'\n", urlA);
+    int rangeStart, rangeEnd, fileSize;
+    WCHAR contentRange[128];
+    DWORD contentRangeSize = sizeof(contentRange);
+    DWORD statusCode = 0;
+    DWORD headerBuffSize = sizeof(DWORD);
+    HttpRangeReader* reader = nullptr;
+    HINTERNET hReq = nullptr;
+    WCHAR* url = ToWStrTemp(urlA);
+    DWORD flags = INTERNET_FLAG_KEEP_CONNECTION | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD |
+                  INTERNET_FLAG_IGNORE_CERT_CN_INVALID;
+    if (str::StartsWithI(urlA, "https")) {
+        flags |= INTERNET_FLAG_SECURE;
+    }
+
+    HINTERNET hInet = InternetOpenW(kUserAgent, INTERNET_OPEN_TYPE_PRECONFIG, nullptr, nullptr, 0);
+    if (!hInet) {
+        logf("CreateHttpRangeReader: InternetOpen failed\n");
+        LogLastError();
+        return nullptr;
+    }
+    hReq = InternetOpenUrlW(hInet, url, L"Range: bytes=0-0", (DWORD)-1, flags, 0);
+    if (!hReq) {
+        logf("CreateHttpRangeReader: InternetOpenUrl failed\n");
+        LogLastError();
+        goto Error;
+    }
+    if (!HttpQueryInfoW(hReq, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &headerBuffSize, nullptr)) {
+        goto Error;
+    }
+    if (statusCode != 206) {
+        logf("CreateHttpRangeReader: status code %d, server doesn't support range requests\n", (int)statusCode);
+        goto Error;
+    }
+    if (!HttpQueryInfoW(hReq, HTTP_QUERY_CONTENT_RANGE, contentRange, &contentRangeSize, nullptr)) {
+        logf("CreateHttpRangeReader: no Content-Range header\n");
+        goto Error;
+    }
+    // e.g. "bytes 0-0/409600000"
+    if (!str::Parse(ToUtf8Temp(contentRange), "bytes %d-%d/%d", &rangeStart, &rangeEnd, &fileSize) || fileSize <= 0) {
+        logf("CreateHttpRangeReader: couldn't parse Content-Range\n");
+        goto Error;
+    }
+    InternetCloseHandle(hReq);
+
+    reader = new HttpRangeReader();
+    reader->url.SetCopy(urlA);
+    reader->hInet = hInet;
+    reader->fileSize = (i64)fileSize;
+    return reader;
+
+Error:
+    if (hReq) {
+        InternetCloseHandle(hReq);
+    }
+    InternetCloseHandle(hInet);
+    return nullptr;
+}
+
 constexpr const int kBufSize = 256 * 1024;
 
 // Download content of a url to a file
-bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpProgress*>& cbProgress) {
+bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpProgress*>& cbProgress,
+                   bool allowResume) {
     logf("HttpGetToFile: url: '%s', file: '%s'\n", urlA, destFilePath);
     bool ok = false;
     HINTERNET hReq = nullptr, hInet = nullptr;
@@ -110,17 +222,25 @@ bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpP
     DWORD statusCode = 0;
     WCHAR* url = ToWStrTemp(urlA);
     char* buf = nullptr;
+    WCHAR* hdrs = nullptr;
+    i64 existingSize = 0;
+    bool resumed = false;
 
     HttpProgress progress{0};
 
     WCHAR* pathW = ToWStrTemp(destFilePath);
-    HANDLE hf =
-        CreateFileW(pathW, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    DWORD disposition = allowResume ? OPEN_ALWAYS : CREATE_ALWAYS;
+    HANDLE hf = CreateFileW(pathW, GENERIC_WRITE, FILE_SHARE_READ, nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (INVALID_HANDLE_VALUE == hf) {
         logf("HttpGetToFile: CreateFileW('%s') failed\n", destFilePath);
         LogLastError();
         goto Exit;
     }
+    if (allowResume) {
+        LARGE_INTEGER size{};
+        GetFileSizeEx(hf, &size);
+        existingSize = size.QuadPart;
+    }
 
     buf = AllocArray<char>(kBufSize);
     if (!buf) {
@@ -132,7 +252,11 @@ bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpP
         goto Exit;
     }
 
-    hReq = InternetOpenUrlW(hInet, url, nullptr, 0, 0, 0);
+    if (existingSize > 0) {
+        // ask the server for just the part we don't have yet
+        hdrs = ToWStrTemp(str::FormatTemp("Range: bytes=%d-", (int)existingSize));
+    }
+    hReq = InternetOpenUrlW(hInet, url, hdrs, hdrs ? (DWORD)-1 : 0, 0, 0);
     if (!hReq) {
         goto Exit;
     }
@@ -141,9 +265,26 @@ bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpP
         goto Exit;
     }
 
-    if (statusCode != 200) {
+    resumed = (statusCode == 206); // 206: partial content
+    if (existingSize > 0 && statusCode == 416) {
+        // 416: range not satisfiable i.e. we already have the whole file
+        ok = true;
         goto Exit;
     }
+    if (statusCode != 200 && !resumed) {
+        goto Exit;
+    }
+
+    if (resumed) {
+        LARGE_INTEGER off{};
+        off.QuadPart = existingSize;
+        SetFilePointerEx(hf, off, nullptr, FILE_BEGIN);
+        progress.nDownloaded = existingSize;
+    } else if (existingSize > 0) {
+        // the server ignored the range request, start over
+        SetFilePointer(hf, 0, nullptr, FILE_BEGIN);
+        SetEndOfFile(hf);
+    }
 
     for (;;) {
         if (!InternetReadFile(hReq, buf, kBufSize, &dwRead)) {
@@ -158,6 +299,8 @@ bool HttpGetToFile(const char* urlA, const char* destFilePath, const Func1<HttpP
             goto Exit;
         }
         progress.nDownloaded += (i64)dwRead;
+        progress.chunk = buf;
+        progress.chunkSize = dwRead;
         cbProgress.Call(&progress);
 
         if (size != dwRead) {
@@ -174,7 +317,8 @@ Exit:
     if (hInet) {
         InternetCloseHandle(hInet);
     }
-    if (!ok) {
+    if (!ok && !allowResume) {
+        // when resuming, keep the partial file so the next attempt picks it up
         file::Delete(destFilePath);
     }
     free(buf);
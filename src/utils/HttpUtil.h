@@ -12,10 +12,33 @@ struct HttpRsp {
 
 struct HttpProgress {
     i64 nDownloaded;
+    // the chunk of data just received, so that the callback can e.g.
+    // hash or scan the payload while the download is still in flight;
+    // the chunk ends at offset nDownloaded
+    const char* chunk = nullptr;
+    DWORD chunkSize = 0;
 };
 
 bool IsHttpRspOk(const HttpRsp*);
 
+// reads byte ranges of a remote document on demand; only created when
+// the server supports http range requests (see CreateHttpRangeReader)
+struct HttpRangeReader {
+    AutoFreeStr url;
+    HINTERNET hInet = nullptr;
+    i64 fileSize = 0;
+
+    ~HttpRangeReader();
+    // reads count bytes starting at offset into buf, returns the
+    // number of bytes actually read
+    int Read(i64 offset, void* buf, int count);
+};
+
+HttpRangeReader* CreateHttpRangeReader(const char* url);
+
 bool HttpPost(const char* server, int port, const char* url, str::Str* headers, str::Str* data);
 bool HttpGet(const char* url, HttpRsp* rspOut);
-bool HttpGetToFile(const char* url, const char* destFilePath, const Func1<HttpProgress*>& cbProgress);
+// allowResume: if destFilePath already has a partial download, ask the
+// server for just the missing tail (and keep the partial file on failure)
+bool HttpGetToFile(const char* url, const char* destFilePath, const Func1<HttpProgress*>& cbProgress,
+                   bool allowResume = false);
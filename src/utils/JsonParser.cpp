@@ -236,6 +236,310 @@ static const char* ParseValue(ParseArgs& args, const char* data) {
     }
 }
 
+enum StreamState {
+    ExpectValue = 0,
+    ExpectKey,
+    ExpectColon,
+    ExpectCommaOrClose,
+    Done,
+};
+
+// validates a number token and returns its end (pointing at the first
+// non-number character, which must exist) or nullptr; same rules as
+// ParseNumber()
+static const char* TokenizeNumber(const char* data) {
+    if ('-' == *data) {
+        data++;
+    }
+    if ('0' == *data) {
+        data++;
+    } else if (str::IsDigit(*data)) {
+        data = SkipDigits(data + 1);
+    } else {
+        return nullptr;
+    }
+    if ('.' == *data) {
+        data = SkipDigits(data + 1);
+    }
+    if ('e' == *data || 'E' == *data) {
+        data++;
+        if ('+' == *data || '-' == *data) {
+            data++;
+        }
+        data = SkipDigits(data);
+    }
+    if (!str::IsDigit(*(data - 1)) || str::IsDigit(*data)) {
+        return nullptr;
+    }
+    return data;
+}
+
+static bool IsNumberChar(char c) {
+    return str::IsDigit(c) || '-' == c || '+' == c || '.' == c || 'e' == c || 'E' == c;
+}
+
+StreamParser::StreamParser(ValueVisitor* visitor) : visitor(visitor) {
+    state = ExpectValue;
+}
+
+// called when a complete value (primitive or closed container) was
+// consumed: restores the path of the enclosing container and decides
+// what must come next
+static void AfterValue(StreamParser* p) {
+    if (p->stack.Size() == 0) {
+        p->state = Done;
+        return;
+    }
+    StreamParser::Ctx& top = p->stack.Last();
+    p->path.RemoveAt(top.pathLen, p->path.size() - top.pathLen);
+    top.elemInPath = false;
+    p->state = ExpectCommaOrClose;
+}
+
+static void EmitValue(StreamParser* p, const char* value, Type type) {
+    p->canceled = !p->visitor->Visit(p->path.Get(), value, type);
+    AfterValue(p);
+}
+
+// returns the index past the closing quote of the string token starting
+// at s[pos] (which must be '"'), or 0 if the token isn't complete yet
+static size_t FindStringTokenEnd(const char* s, size_t pos, size_t n) {
+    size_t i = pos + 1;
+    while (i < n) {
+        if ('"' == s[i]) {
+            return i + 1;
+        }
+        if ('\\' == s[i]) {
+            i += 2;
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+bool StreamParser::Feed(const char* data, size_t len) {
+    if (failed) {
+        return false;
+    }
+    if (canceled) {
+        return true;
+    }
+    buf.Append(data, len);
+    const char* s = buf.Get();
+    size_t n = buf.size();
+    size_t pos = 0;
+    if (!sawStart) {
+        if (n < 3 && str::EqN(s, UTF8_BOM, n)) {
+            // might still become a BOM, wait for more data
+            return true;
+        }
+        if (str::StartsWith(s, UTF8_BOM)) {
+            pos = 3;
+        }
+        sawStart = true;
+    }
+    bool needMore = false;
+    while (pos < n && !needMore && !canceled && !failed) {
+        char c = s[pos];
+        if (str::IsWs(c)) {
+            pos++;
+            continue;
+        }
+        switch (state) {
+            case ExpectValue: {
+                Ctx* top = stack.Size() > 0 ? &stack.Last() : nullptr;
+                if (']' == c) {
+                    // empty array
+                    if (!top || top->kind != '[' || !top->justOpened) {
+                        failed = true;
+                        break;
+                    }
+                    stack.Pop();
+                    pos++;
+                    AfterValue(this);
+                    break;
+                }
+                if (top && '[' == top->kind && !top->elemInPath) {
+                    path.AppendFmt("[%d]", top->arrIdx);
+                    top->elemInPath = true;
+                    top->justOpened = false;
+                }
+                if ('{' == c || '[' == c) {
+                    Ctx ctx;
+                    ctx.kind = c;
+                    ctx.pathLen = path.size();
+                    ctx.justOpened = true;
+                    stack.Append(ctx);
+                    state = ('{' == c) ? ExpectKey : ExpectValue;
+                    pos++;
+                    break;
+                }
+                if ('"' == c) {
+                    size_t end = FindStringTokenEnd(s, pos, n);
+                    if (!end) {
+                        needMore = true;
+                        break;
+                    }
+                    str::Str value;
+                    if (!ExtractString(value, s + pos)) {
+                        failed = true;
+                        break;
+                    }
+                    pos = end;
+                    EmitValue(this, value.Get(), Type::String);
+                    break;
+                }
+                if (str::IsDigit(c) || '-' == c) {
+                    size_t i = pos;
+                    while (i < n && IsNumberChar(s[i])) {
+                        i++;
+                    }
+                    if (i == n) {
+                        // the number might continue in the next chunk;
+                        // Finish() completes a trailing one
+                        needMore = true;
+                        break;
+                    }
+                    const char* end = TokenizeNumber(s + pos);
+                    if (!end) {
+                        failed = true;
+                        break;
+                    }
+                    char* number = str::Dup(s + pos, end - (s + pos));
+                    pos = end - s;
+                    EmitValue(this, number, Type::Number);
+                    free(number);
+                    break;
+                }
+                const char* keyword = nullptr;
+                Type type = Type::Null;
+                if ('t' == c) {
+                    keyword = "true";
+                    type = Type::Bool;
+                } else if ('f' == c) {
+                    keyword = "false";
+                    type = Type::Bool;
+                } else if ('n' == c) {
+                    keyword = "null";
+                }
+                if (!keyword) {
+                    failed = true;
+                    break;
+                }
+                size_t kwLen = str::Len(keyword);
+                if (n - pos < kwLen) {
+                    if (str::EqN(s + pos, keyword, n - pos)) {
+                        needMore = true;
+                    } else {
+                        failed = true;
+                    }
+                    break;
+                }
+                if (!str::StartsWith(s + pos, keyword)) {
+                    failed = true;
+                    break;
+                }
+                pos += kwLen;
+                EmitValue(this, keyword, type);
+                break;
+            }
+            case ExpectKey: {
+                Ctx& top = stack.Last();
+                if ('}' == c && top.justOpened) {
+                    // empty object
+                    stack.Pop();
+                    pos++;
+                    AfterValue(this);
+                    break;
+                }
+                if ('"' != c) {
+                    failed = true;
+                    break;
+                }
+                size_t end = FindStringTokenEnd(s, pos, n);
+                if (!end) {
+                    needMore = true;
+                    break;
+                }
+                path.AppendChar('/');
+                if (!ExtractString(path, s + pos)) {
+                    failed = true;
+                    break;
+                }
+                pos = end;
+                top.justOpened = false;
+                state = ExpectColon;
+                break;
+            }
+            case ExpectColon:
+                if (':' != c) {
+                    failed = true;
+                    break;
+                }
+                pos++;
+                state = ExpectValue;
+                break;
+            case ExpectCommaOrClose: {
+                Ctx& top = stack.Last();
+                if (',' == c) {
+                    pos++;
+                    if ('{' == top.kind) {
+                        state = ExpectKey;
+                    } else {
+                        top.arrIdx++;
+                        state = ExpectValue;
+                    }
+                    break;
+                }
+                char close = ('{' == top.kind) ? '}' : ']';
+                if (close != c) {
+                    failed = true;
+                    break;
+                }
+                stack.Pop();
+                pos++;
+                AfterValue(this);
+                break;
+            }
+            case Done:
+                // trailing non-whitespace after the top-level value
+                failed = true;
+                break;
+        }
+    }
+    if (canceled) {
+        pos = n;
+    }
+    buf.RemoveAt(0, pos);
+    return !failed;
+}
+
+bool StreamParser::Finish() {
+    if (failed) {
+        return false;
+    }
+    if (canceled) {
+        return true;
+    }
+    if (buf.size() > 0) {
+        // only a trailing number token can be completed by end of input
+        char c = buf.at(0);
+        bool isNumber = (ExpectValue == state) && (str::IsDigit(c) || '-' == c);
+        const char* end = isNumber ? TokenizeNumber(buf.Get()) : nullptr;
+        if (!end || 0 != *end) {
+            failed = true;
+            return false;
+        }
+        EmitValue(this, buf.Get(), Type::Number);
+        buf.Reset();
+    }
+    if (Done != state) {
+        failed = true;
+    }
+    return !failed;
+}
+
 // return false if invalid JSON
 bool Parse(const char* data, ValueVisitor* visitor) {
     ParseArgs args(visitor);
@@ -26,4 +26,38 @@ struct ValueVisitor {
 // returns false on error
 bool Parse(const char* data, ValueVisitor* visitor);
 
+// incremental variant of Parse() for input that arrives in chunks
+// (e.g. a multi-MB side file consumed while it downloads): values are
+// reported through the same ValueVisitor as soon as they're complete
+// and only the current (partial) token is buffered, so memory use is
+// bounded by the longest string in the input, not the input size
+struct StreamParser {
+    explicit StreamParser(ValueVisitor* visitor);
+
+    // feed the next chunk; returns false once the input can't be valid
+    // JSON anymore (further calls are ignored)
+    bool Feed(const char* data, size_t len);
+    // signals the end of input; returns false if the input wasn't a
+    // single complete JSON value
+    bool Finish();
+
+    // internal state
+    struct Ctx {
+        char kind = 0; // '{' or '['
+        int arrIdx = 0;
+        size_t pathLen = 0;
+        bool justOpened = false;
+        bool elemInPath = false;
+    };
+
+    ValueVisitor* visitor = nullptr;
+    str::Str path;
+    str::Str buf; // unconsumed input: at most one partial token
+    Vec<Ctx> stack;
+    int state; // json::StreamState
+    bool canceled = false;
+    bool failed = false;
+    bool sawStart = false; // becomes true once a possible BOM was handled
+};
+
 } // namespace json
@@ -117,6 +117,57 @@ static void logToPipe(const char* s, size_t n = 0) {
     }
 }
 
+// lines waiting for the flush thread, appended under gLogMutex so that
+// a hot logf() pays only an in-memory append; the flush thread batches
+// them into a single file append / pipe write per wake-up
+static str::Str* gLogPending = nullptr;
+// only touched by the flush thread (outside of the swap under gLogMutex)
+static str::Str* gLogFlushBuf = nullptr;
+static HANDLE gLogFlushThread = nullptr;
+// auto-reset, signaled when gLogPending is non-empty
+static HANDLE gLogFlushEvent = nullptr;
+static AtomicBool gLogFlushQuit;
+
+static void FlushLogBatch(str::Str* batch) {
+    size_t n = batch->size();
+    if (0 == n) {
+        return;
+    }
+    const char* s = batch->Get();
+    if (gLogFilePath) {
+        auto f = fopen(gLogFilePath, "a");
+        if (f != nullptr) {
+            fwrite(s, 1, n, f);
+            fflush(f);
+            fclose(f);
+        }
+    }
+    logToPipe(s, n);
+    batch->Clear();
+}
+
+static void LogFlushThread() {
+    for (;;) {
+        WaitForSingleObject(gLogFlushEvent, INFINITE);
+        gLogMutex.Lock();
+        str::Str* tmp = gLogPending;
+        gLogPending = gLogFlushBuf;
+        gLogFlushBuf = tmp;
+        gLogMutex.Unlock();
+        FlushLogBatch(gLogFlushBuf);
+        if (gLogFlushQuit.Get()) {
+            // grab anything that raced in after the swap
+            gLogMutex.Lock();
+            tmp = gLogPending;
+            gLogPending = gLogFlushBuf;
+            gLogFlushBuf = tmp;
+            gLogMutex.Unlock();
+            FlushLogBatch(gLogFlushBuf);
+            return;
+        }
+    }
+}
+
 void log(const char* s, bool always) {
     bool skipLog = !always && gSkipDuplicateLines && gLogBuf && gLogBuf->Contains(s);
 
@@ -168,15 +219,31 @@ void log(const char* s, bool always) {
         fflush(stdout);
     }
 
-    if (gLogFilePath) {
-        auto f = fopen(gLogFilePath, "a");
-        if (f != nullptr) {
-            fwrite(s, 1, n, f);
-            fflush(f);
-            fclose(f);
+    // the file append and the pipe write are too slow to do per line
+    // while holding the mutex; hand them to the flush thread
+    if (gLogFilePath || gLogToPipe) {
+        if (!gLogPending) {
+            gLogPending = new str::Str(8 * 1024, gLogAllocator);
+            gLogFlushBuf = new str::Str(8 * 1024, gLogAllocator);
+            gLogFlushEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            gLogFlushThread = StartThread(MkFunc0Void(LogFlushThread), "LogFlushThread");
+        }
+        if (gLogFlushThread) {
+            gLogPending->Append(s, n);
+            SetEvent(gLogFlushEvent);
+        } else {
+            // couldn't start the flush thread, write synchronously
+            if (gLogFilePath) {
+                auto f = fopen(gLogFilePath, "a");
+                if (f != nullptr) {
+                    fwrite(s, 1, n, f);
+                    fflush(f);
+                    fclose(f);
+                }
+            }
+            logToPipe(s, n);
         }
     }
-    logToPipe(s, n);
     gLogMutex.Unlock();
 }
 void loga(const char* s) {
@@ -238,9 +305,23 @@ bool WriteCurrentLogToFile(const char* path) {
 
 void DestroyLogging() {
     gDestroyedLogging = true;
+    if (gLogFlushThread) {
+        // flush whatever is still pending before tearing down the buffers
+        gLogFlushQuit.Set(true);
+        SetEvent(gLogFlushEvent);
+        WaitForSingleObject(gLogFlushThread, INFINITE);
+        CloseHandle(gLogFlushThread);
+        gLogFlushThread = nullptr;
+        CloseHandle(gLogFlushEvent);
+        gLogFlushEvent = nullptr;
+    }
     gLogMutex.Lock();
     delete gLogBuf;
     gLogBuf = nullptr;
+    delete gLogPending;
+    gLogPending = nullptr;
+    delete gLogFlushBuf;
+    gLogFlushBuf = nullptr;
     delete gLogAllocator;
     gLogAllocator = nullptr;
     gLogMutex.Unlock();
@@ -0,0 +1,92 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// bounded lock-free queue after Dmitry Vyukov's MPMC ring design.
+// Any number of threads can Push() and Pop() concurrently; we mostly
+// use it multi-producer single-consumer (hence the name).
+// Push() returns false when the ring is full and Pop() false when it's
+// empty: callers provide their own overflow / blocking (see StrQueue).
+// T must be trivially copyable since it's stored by value in the ring.
+template <typename T>
+struct MpScQueue {
+    struct Cell {
+        volatile LONG seq;
+        T data;
+    };
+
+    Cell* cells = nullptr;
+    LONG posMask = 0;
+    // on separate cache lines so that producers bumping enqueuePos
+    // don't invalidate the line the consumer spins on
+    char pad0[64] = {};
+    volatile LONG enqueuePos = 0;
+    char pad1[64] = {};
+    volatile LONG dequeuePos = 0;
+
+    explicit MpScQueue(int capacity = 1024) {
+        // indexing with & requires a power of 2
+        LONG n = 2;
+        while (n < capacity) {
+            n *= 2;
+        }
+        cells = AllocArray<Cell>(n);
+        for (LONG i = 0; i < n; i++) {
+            cells[i].seq = i;
+        }
+        posMask = n - 1;
+    }
+    MpScQueue(const MpScQueue&) = delete;
+    MpScQueue& operator=(const MpScQueue&) = delete;
+    ~MpScQueue() {
+        free(cells);
+    }
+
+    // returns false if the ring is full
+    bool Push(T v) {
+        LONG pos = enqueuePos;
+        for (;;) {
+            Cell* cell = &cells[pos & posMask];
+            // wraparound-safe distance; a cell is free for this pos when
+            // its seq caught up with it
+            LONG dif = (LONG)((ULONG)cell->seq - (ULONG)pos);
+            if (dif == 0) {
+                if (InterlockedCompareExchange(&enqueuePos, pos + 1, pos) == pos) {
+                    cell->data = v;
+                    // full barrier: publishes the data store above before
+                    // a consumer can observe the new seq
+                    InterlockedExchange(&cell->seq, pos + 1);
+                    return true;
+                }
+                pos = enqueuePos;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = enqueuePos;
+            }
+        }
+    }
+
+    // returns false if the ring is empty
+    bool Pop(T& v) {
+        LONG pos = dequeuePos;
+        for (;;) {
+            Cell* cell = &cells[pos & posMask];
+            LONG dif = (LONG)((ULONG)cell->seq - (ULONG)(pos + 1));
+            if (dif == 0) {
+                // the CAS is a full barrier, so the data read below can't
+                // be speculated ahead of the seq check
+                if (InterlockedCompareExchange(&dequeuePos, pos + 1, pos) == pos) {
+                    v = cell->data;
+                    // mark the cell free for the producer one lap ahead
+                    InterlockedExchange(&cell->seq, pos + posMask + 1);
+                    return true;
+                }
+                pos = dequeuePos;
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = dequeuePos;
+            }
+        }
+    }
+};
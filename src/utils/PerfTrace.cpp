@@ -0,0 +1,114 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/ThreadUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/Timer.h"
+#include "utils/PerfTrace.h"
+
+#include "utils/Log.h"
+
+// cap the buffer so that a recording left running doesn't grow without bounds.
+// 256k events is ~8 MB and more than enough for a profiling session
+constexpr int kMaxTraceEvents = 256 * 1024;
+
+struct PerfTraceEvent {
+    const char* name; // a string literal, not owned
+    DWORD tid;
+    LONGLONG timeStart; // in QPC ticks
+    LONGLONG dur;       // in QPC ticks
+};
+
+bool gPerfTraceEnabled = false;
+
+static Mutex gPerfTraceMutex;
+static Vec<PerfTraceEvent>* gPerfTraceEvents = nullptr;
+static LONGLONG gPerfTraceTimeStart = 0;
+static bool gPerfTraceDroppedEvents = false;
+
+void PerfTraceStart() {
+    gPerfTraceMutex.Lock();
+    delete gPerfTraceEvents;
+    gPerfTraceEvents = new Vec<PerfTraceEvent>();
+    gPerfTraceTimeStart = TimeGet().QuadPart;
+    gPerfTraceDroppedEvents = false;
+    gPerfTraceEnabled = true;
+    gPerfTraceMutex.Unlock();
+}
+
+void PerfTraceStop() {
+    gPerfTraceMutex.Lock();
+    gPerfTraceEnabled = false;
+    gPerfTraceMutex.Unlock();
+}
+
+void PerfTraceRecordEvent(const char* name, LARGE_INTEGER timeStart) {
+    if (!gPerfTraceEnabled) {
+        return;
+    }
+    LONGLONG timeEnd = TimeGet().QuadPart;
+    gPerfTraceMutex.Lock();
+    // re-check under the lock: tracing might have been stopped in the meantime
+    if (gPerfTraceEnabled && gPerfTraceEvents) {
+        if (gPerfTraceEvents->Size() < kMaxTraceEvents) {
+            PerfTraceEvent ev;
+            ev.name = name;
+            ev.tid = GetCurrentThreadId();
+            ev.timeStart = timeStart.QuadPart;
+            ev.dur = timeEnd - timeStart.QuadPart;
+            gPerfTraceEvents->Append(ev);
+        } else {
+            gPerfTraceDroppedEvents = true;
+        }
+    }
+    gPerfTraceMutex.Unlock();
+}
+
+PerfTraceScope::PerfTraceScope(const char* name) {
+    if (!gPerfTraceEnabled) {
+        return;
+    }
+    this->name = name;
+    timeStart = TimeGet();
+}
+
+PerfTraceScope::~PerfTraceScope() {
+    if (!name) {
+        return;
+    }
+    PerfTraceRecordEvent(name, timeStart);
+}
+
+// QPC ticks => microseconds, the unit chrome://tracing expects
+static double TicksToUs(LONGLONG ticks) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)ticks * (double)1000000 / (double)freq.QuadPart;
+}
+
+bool PerfTraceSaveToFile(const char* path) {
+    str::Str out;
+    out.Append("{\"traceEvents\":[");
+    gPerfTraceMutex.Lock();
+    int nEvents = gPerfTraceEvents ? gPerfTraceEvents->Size() : 0;
+    for (int i = 0; i < nEvents; i++) {
+        const PerfTraceEvent& ev = gPerfTraceEvents->At(i);
+        if (i > 0) {
+            out.AppendChar(',');
+        }
+        double ts = TicksToUs(ev.timeStart - gPerfTraceTimeStart);
+        double dur = TicksToUs(ev.dur);
+        out.AppendFmt("\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f}", ev.name,
+                      (int)ev.tid, ts, dur);
+    }
+    bool dropped = gPerfTraceDroppedEvents;
+    gPerfTraceMutex.Unlock();
+    out.Append("\n]}\n");
+    bool ok = file::WriteFile(path, {(u8*)out.Get(), out.size()});
+    if (dropped) {
+        logf("PerfTraceSaveToFile: hit the %d events cap, some events were dropped\n", kMaxTraceEvents);
+    }
+    logf("PerfTraceSaveToFile: %s %d events to '%s'\n", ok ? "wrote" : "failed to write", nEvents, path);
+    return ok;
+}
@@ -0,0 +1,29 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+/*
+Lightweight scoped tracing for known hot paths (rendering, text extraction,
+layout, search). Recording is off by default and is toggled at runtime
+(CmdDebugTogglePerfTrace), so it can be used to look into performance
+issues in release builds without a debugger or profiler attached.
+Captured events are saved in chrome://tracing JSON format.
+*/
+
+extern bool gPerfTraceEnabled;
+
+void PerfTraceStart();
+void PerfTraceStop();
+bool PerfTraceSaveToFile(const char* path);
+
+// name must be a string literal (we don't copy it)
+void PerfTraceRecordEvent(const char* name, LARGE_INTEGER timeStart);
+
+// records a single event covering the lifetime of the scope.
+// when tracing is disabled the cost is a single bool check
+struct PerfTraceScope {
+    const char* name = nullptr;
+    LARGE_INTEGER timeStart{};
+
+    explicit PerfTraceScope(const char* name);
+    ~PerfTraceScope();
+};
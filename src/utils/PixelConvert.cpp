@@ -0,0 +1,139 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/WinUtil.h"
+
+#include "utils/PixelConvert.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#define HAS_SIMD_ROW_KERNELS 1
+#endif
+
+#ifdef HAS_SIMD_ROW_KERNELS
+// resolved from CpuID() on first use. The race on first call is benign:
+// both threads write the same value
+static u32 gRowCpu = (u32)-1;
+
+static bool RowCpuHas(u32 feature) {
+    if (gRowCpu == (u32)-1) {
+        gRowCpu = CpuID();
+    }
+    return (gRowCpu & feature) != 0;
+}
+#endif
+
+static void RowSwapRB24Scalar(u8* row, int nPixels) {
+    for (int i = 0; i < nPixels; i++) {
+        u8 t = row[0];
+        row[0] = row[2];
+        row[2] = t;
+        row += 3;
+    }
+}
+
+// 24bpp rows don't benefit from going wider than 16 bytes: 5 pixels
+// occupy 15 of them and the kernels are memory-bound anyway, so there
+// are no AVX2 versions of the swizzles
+void RowSwapRB24(u8* row, int nPixels) {
+#ifdef HAS_SIMD_ROW_KERNELS
+    if (RowCpuHas(kCpuSSSE3)) {
+        // 5 pixels per step; the load reads one byte past them (stored
+        // back unchanged), so leave at least a pixel for the tail
+        __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+        while (nPixels >= 6) {
+            __m128i v = _mm_loadu_si128((const __m128i*)row);
+            _mm_storeu_si128((__m128i*)row, _mm_shuffle_epi8(v, mask));
+            row += 15;
+            nPixels -= 5;
+        }
+    }
+#endif
+    RowSwapRB24Scalar(row, nPixels);
+}
+
+static void RowGrayToBgr24Scalar(u8* dst, const u8* src, int nPixels) {
+    for (int i = 0; i < nPixels; i++) {
+        dst[0] = dst[1] = dst[2] = src[i];
+        dst += 3;
+    }
+}
+
+void RowGrayToBgr24(u8* dst, const u8* src, int nPixels) {
+#ifdef HAS_SIMD_ROW_KERNELS
+    if (RowCpuHas(kCpuSSSE3)) {
+        // 16 gray bytes expand into 48 output bytes per step,
+        // output byte i is source byte i / 3
+        __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+        while (nPixels >= 16) {
+            __m128i g = _mm_loadu_si128((const __m128i*)src);
+            _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(g, m0));
+            _mm_storeu_si128((__m128i*)(dst + 16), _mm_shuffle_epi8(g, m1));
+            _mm_storeu_si128((__m128i*)(dst + 32), _mm_shuffle_epi8(g, m2));
+            src += 16;
+            dst += 48;
+            nPixels -= 16;
+        }
+    }
+#endif
+    RowGrayToBgr24Scalar(dst, src, nPixels);
+}
+
+static void RowRgbToBgrx32Scalar(u8* dst, const u8* src, int nPixels) {
+    for (int i = 0; i < nPixels; i++) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 0;
+        dst += 4;
+        src += 3;
+    }
+}
+
+void RowRgbToBgrx32(u8* dst, const u8* src, int nPixels) {
+#ifdef HAS_SIMD_ROW_KERNELS
+    if (RowCpuHas(kCpuSSSE3)) {
+        // 4 pixels per step; the load reads 16 source bytes, so leave
+        // at least 6 pixels (18 bytes) for it
+        __m128i mask = _mm_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128);
+        while (nPixels >= 6) {
+            __m128i v = _mm_loadu_si128((const __m128i*)src);
+            _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(v, mask));
+            src += 12;
+            dst += 16;
+            nPixels -= 4;
+        }
+    }
+#endif
+    RowRgbToBgrx32Scalar(dst, src, nPixels);
+}
+
+void RowInvertBytes(u8* row, int nBytes) {
+#ifdef HAS_SIMD_ROW_KERNELS
+    if (RowCpuHas(kCpuAVX2)) {
+        __m256i ones256 = _mm256_set1_epi8(-1);
+        while (nBytes >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)row);
+            _mm256_storeu_si256((__m256i*)row, _mm256_xor_si256(v, ones256));
+            row += 32;
+            nBytes -= 32;
+        }
+    }
+    // SSE2 is a given on both the x64 and x86 builds
+    __m128i ones = _mm_set1_epi8(-1);
+    while (nBytes >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)row);
+        _mm_storeu_si128((__m128i*)row, _mm_xor_si128(v, ones));
+        row += 16;
+        nBytes -= 16;
+    }
+#endif
+    for (int i = 0; i < nBytes; i++) {
+        row[i] = (u8)(row[i] ^ 0xFF);
+    }
+}
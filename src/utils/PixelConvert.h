@@ -0,0 +1,14 @@
+/* Copyright 2022 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// row conversion kernels used when decoding images. Vectorized on
+// x86/x64 (picked at runtime via CpuID()), scalar everywhere else
+
+// in-place: swap R and B in a 24 bits-per-pixel row
+void RowSwapRB24(u8* row, int nPixels);
+// expand 8-bit grayscale into a 24 bits-per-pixel BGR row
+void RowGrayToBgr24(u8* dst, const u8* src, int nPixels);
+// 24 bits-per-pixel RGB into 32 bits-per-pixel BGRX (X set to 0)
+void RowRgbToBgrx32(u8* dst, const u8* src, int nPixels);
+// in-place: invert every byte (CMYK from JPEG is stored inverted)
+void RowInvertBytes(u8* row, int nBytes);
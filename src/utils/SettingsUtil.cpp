@@ -460,17 +460,51 @@ static void SerializeStructRec(str::Str& out, const StructInfo* info, const void
     SerializeUnknownFields(out, prevNode, indent);
 }
 
+// a settings file we serialized ourselves lists the values in the same
+// order as the fields in the schema, so a rolling cursor finds each one
+// right where the previous lookup left off. Without it every lookup
+// re-scanned the node from the top, which made deserialization
+// quadratic in the number of fields (noticeable when parsing the file
+// history with its many per-file states). Hand-edited files with
+// reordered or missing values still work via the wrap-around.
+static const char* GetValueOrdered(SquareTreeNode* node, const char* key, size_t* cursor) {
+    size_t idx = *cursor;
+    const char* value = node->GetValue(key, &idx);
+    if (!value && *cursor > 0) {
+        idx = 0;
+        value = node->GetValue(key, &idx);
+    }
+    if (value) {
+        *cursor = idx;
+    }
+    return value;
+}
+
+static SquareTreeNode* GetChildOrdered(SquareTreeNode* node, const char* key, size_t* cursor) {
+    size_t idx = *cursor;
+    SquareTreeNode* child = node->GetChild(key, &idx);
+    if (!child && *cursor > 0) {
+        idx = 0;
+        child = node->GetChild(key, &idx);
+    }
+    if (child) {
+        *cursor = idx;
+    }
+    return child;
+}
+
 static void* DeserializeStructRec(const StructInfo* info, SquareTreeNode* node, u8* base, bool useDefaults) {
     if (!base) {
         base = AllocArray<u8>(info->structSize);
     }
 
+    size_t cursor = 0;
     const char* fieldName = info->fieldNames;
     for (size_t i = 0; i < info->fieldCount; i++, fieldName += str::Len(fieldName) + 1) {
         const FieldInfo& field = info->fields[i];
         u8* fieldPtr = base + field.offset;
         if (SettingType::Struct == field.type || SettingType::Prerelease == field.type) {
-            SquareTreeNode* child = node ? node->GetChild(fieldName) : nullptr;
+            SquareTreeNode* child = node ? GetChildOrdered(node, fieldName, &cursor) : nullptr;
 #if !(defined(PRE_RELEASE_VER) || defined(DEBUG))
             if (SettingType::Prerelease == field.type) {
                 child = nullptr;
@@ -479,7 +513,7 @@ static void* DeserializeStructRec(const StructInfo* info, SquareTreeNode* node,
             DeserializeStructRec(GetSubstruct(field), child, fieldPtr, useDefaults);
         } else if (SettingType::Array == field.type) {
             SquareTreeNode *parent = node, *child = nullptr;
-            if (parent && (child = parent->GetChild(fieldName)) != nullptr &&
+            if (parent && (child = GetChildOrdered(parent, fieldName, &cursor)) != nullptr &&
                 (0 == child->data.size() || child->GetChild(""))) {
                 parent = child;
                 fieldName += str::Len(fieldName);
@@ -495,7 +529,7 @@ static void* DeserializeStructRec(const StructInfo* info, SquareTreeNode* node,
                 *(Vec<void*>**)fieldPtr = array;
             }
         } else if (field.type != SettingType::Comment) {
-            const char* value = node ? node->GetValue(fieldName) : nullptr;
+            const char* value = node ? GetValueOrdered(node, fieldName, &cursor) : nullptr;
             if (useDefaults || value) {
                 DeserializeField(field, base, value);
             }
@@ -520,6 +554,290 @@ void* DeserializeStruct(const StructInfo* info, const char* data, void* strct) {
     return res;
 }
 
+/* Binary serialization of the same StructInfo-described structs.
+
+The values are written as a flat stream in field order: no field names,
+no escaping, fixed-size primitives and length-prefixed strings. That
+makes deserialization a single sequential decode without any parsing,
+which is what the settings snapshot wants (see AppSettings.cpp).
+
+The stream doesn't describe its own layout, so it can only be decoded
+with the exact StructInfo it was encoded with. Callers must compare
+GetStructInfoFingerprint() of writer and reader and reject mismatches. */
+
+// length prefix used for null string pointers (vs. 0 for empty strings)
+constexpr u32 kBinNullString = 0xffffffff;
+
+static void AppendBinU32(str::Str& out, u32 v) {
+    out.Append((const char*)&v, sizeof(v));
+}
+
+static void AppendBinString(str::Str& out, const char* s) {
+    if (!s) {
+        AppendBinU32(out, kBinNullString);
+        return;
+    }
+    u32 n = (u32)str::Len(s);
+    AppendBinU32(out, n);
+    out.Append(s, n);
+}
+
+static void SerializeStructBinRec(str::Str& out, const StructInfo* info, const void* data);
+
+static void SerializeFieldBin(str::Str& out, const u8* base, const FieldInfo& field) {
+    const u8* fieldPtr = base + field.offset;
+
+    switch (field.type) {
+        case SettingType::Bool:
+            out.AppendChar(*(bool*)fieldPtr ? 1 : 0);
+            break;
+        case SettingType::Int:
+        case SettingType::Float:
+            out.Append((const char*)fieldPtr, 4);
+            break;
+        case SettingType::String:
+        case SettingType::Color:
+            AppendBinString(out, *(const char**)fieldPtr);
+            break;
+        case SettingType::Compact:
+        case SettingType::Struct:
+        case SettingType::Prerelease:
+            SerializeStructBinRec(out, GetSubstruct(field), fieldPtr);
+            break;
+        case SettingType::FloatArray:
+        case SettingType::IntArray: {
+            Vec<int>* v = *(Vec<int>**)fieldPtr;
+            u32 n = v ? (u32)v->size() : 0;
+            AppendBinU32(out, n);
+            if (n > 0) {
+                out.Append((const char*)&v->at(0), n * sizeof(int));
+            }
+            break;
+        }
+        case SettingType::ColorArray:
+        case SettingType::StringArray: {
+            Vec<char*>* v = *(Vec<char*>**)fieldPtr;
+            u32 n = v ? (u32)v->size() : 0;
+            AppendBinU32(out, n);
+            for (u32 i = 0; i < n; i++) {
+                AppendBinString(out, v->at(i));
+            }
+            break;
+        }
+        case SettingType::Array: {
+            Vec<void*>* array = *(Vec<void*>**)fieldPtr;
+            u32 n = array ? (u32)array->size() : 0;
+            AppendBinU32(out, n);
+            for (u32 i = 0; i < n; i++) {
+                SerializeStructBinRec(out, GetSubstruct(field), array->at(i));
+            }
+            break;
+        }
+        case SettingType::Comment:
+            break;
+        default:
+            ReportIf(true);
+    }
+}
+
+static void SerializeStructBinRec(str::Str& out, const StructInfo* info, const void* data) {
+    const u8* base = (const u8*)data;
+    for (size_t i = 0; i < info->fieldCount; i++) {
+        SerializeFieldBin(out, base, info->fields[i]);
+    }
+}
+
+ByteSlice SerializeStructBin(const StructInfo* info, const void* strct) {
+    str::Str out;
+    SerializeStructBinRec(out, info, strct);
+    return out.StealAsByteSlice();
+}
+
+// bounds-checked cursor over the binary stream; once a read fails
+// (truncated or corrupted data) all further reads fail as well
+struct BinReader {
+    const u8* s = nullptr;
+    const u8* end = nullptr;
+    bool ok = true;
+
+    size_t Left() const {
+        return (size_t)(end - s);
+    }
+    bool Bytes(void* dst, size_t n) {
+        if (!ok || Left() < n) {
+            ok = false;
+            return false;
+        }
+        memcpy(dst, s, n);
+        s += n;
+        return true;
+    }
+    u32 U32() {
+        u32 v = 0;
+        Bytes(&v, sizeof(v));
+        return v;
+    }
+};
+
+static char* DeserializeBinString(BinReader& r) {
+    u32 n = r.U32();
+    if (kBinNullString == n) {
+        return nullptr;
+    }
+    if (!r.ok || r.Left() < n) {
+        r.ok = false;
+        return nullptr;
+    }
+    char* res = str::Dup((const char*)r.s, n);
+    r.s += n;
+    return res;
+}
+
+static bool DeserializeStructBinRec(const StructInfo* info, BinReader& r, u8* base);
+
+static void DeserializeFieldBin(const FieldInfo& field, u8* base, BinReader& r) {
+    u8* fieldPtr = base + field.offset;
+
+    switch (field.type) {
+        case SettingType::Bool: {
+            u8 v = 0;
+            r.Bytes(&v, 1);
+            *(bool*)fieldPtr = v != 0;
+            break;
+        }
+        case SettingType::Int:
+        case SettingType::Float:
+            r.Bytes(fieldPtr, 4);
+            break;
+        case SettingType::String:
+        case SettingType::Color: {
+            char** strPtr = (char**)fieldPtr;
+            free(*strPtr);
+            *strPtr = DeserializeBinString(r);
+            break;
+        }
+        case SettingType::Compact:
+        case SettingType::Struct:
+        case SettingType::Prerelease:
+            DeserializeStructBinRec(GetSubstruct(field), r, fieldPtr);
+            break;
+        case SettingType::FloatArray:
+        case SettingType::IntArray: {
+            u32 n = r.U32();
+            if (!r.ok || r.Left() / sizeof(int) < n) {
+                r.ok = false;
+                break;
+            }
+            delete *(Vec<int>**)fieldPtr;
+            Vec<int>* v = new Vec<int>(n);
+            *(Vec<int>**)fieldPtr = v;
+            if (n > 0) {
+                r.Bytes(v->AppendBlanks(n), n * sizeof(int));
+            }
+            break;
+        }
+        case SettingType::ColorArray:
+        case SettingType::StringArray: {
+            u32 n = r.U32();
+            // each string takes at least its length prefix
+            if (!r.ok || r.Left() / sizeof(u32) < n) {
+                r.ok = false;
+                break;
+            }
+            FreeUtf8StringArray(*(Vec<char*>**)fieldPtr);
+            Vec<char*>* v = new Vec<char*>(n);
+            *(Vec<char*>**)fieldPtr = v;
+            for (u32 i = 0; r.ok && i < n; i++) {
+                v->Append(DeserializeBinString(r));
+            }
+            break;
+        }
+        case SettingType::Array: {
+            u32 n = r.U32();
+            // every element encodes at least one byte
+            if (!r.ok || r.Left() < n) {
+                r.ok = false;
+                break;
+            }
+            FreeArray(*(Vec<void*>**)fieldPtr, field);
+            Vec<void*>* array = new Vec<void*>(n);
+            *(Vec<void*>**)fieldPtr = array;
+            const StructInfo* sub = GetSubstruct(field);
+            for (u32 i = 0; r.ok && i < n; i++) {
+                u8* v = AllocArray<u8>(sub->structSize);
+                array->Append(v);
+                DeserializeStructBinRec(sub, r, v);
+            }
+            break;
+        }
+        case SettingType::Comment:
+            break;
+        default:
+            ReportIf(true);
+    }
+}
+
+static bool DeserializeStructBinRec(const StructInfo* info, BinReader& r, u8* base) {
+    for (size_t i = 0; r.ok && i < info->fieldCount; i++) {
+        DeserializeFieldBin(info->fields[i], base, r);
+    }
+    return r.ok;
+}
+
+// returns nullptr if data is truncated or corrupted. In that case a
+// caller-provided strct may have been partially overwritten and should
+// be considered lost (our only caller always passes nullptr)
+void* DeserializeStructBin(const StructInfo* info, const ByteSlice& data, void* strct) {
+    u8* base = (u8*)strct;
+    if (!base) {
+        base = AllocArray<u8>(info->structSize);
+    }
+    BinReader r;
+    r.s = data.data();
+    r.end = r.s + data.size();
+    bool ok = DeserializeStructBinRec(info, r, base) && r.s == r.end;
+    if (!ok) {
+        if (!strct) {
+            FreeStruct(info, base);
+        }
+        return nullptr;
+    }
+    return base;
+}
+
+static u32 FingerprintAdd(u32 h, u32 v) {
+    u32 data[2] = {h, v};
+    return MurmurHash2(data, sizeof(data));
+}
+
+static u32 StructInfoFingerprintRec(const StructInfo* info, u32 h) {
+    h = FingerprintAdd(h, info->structSize);
+    h = FingerprintAdd(h, info->fieldCount);
+    for (size_t i = 0; i < info->fieldCount; i++) {
+        const FieldInfo& field = info->fields[i];
+        h = FingerprintAdd(h, (u32)field.offset);
+        h = FingerprintAdd(h, (u32)field.type);
+        switch (field.type) {
+            case SettingType::Compact:
+            case SettingType::Struct:
+            case SettingType::Prerelease:
+            case SettingType::Array:
+                h = StructInfoFingerprintRec(GetSubstruct(field), h);
+                break;
+            default:
+                break;
+        }
+    }
+    return h;
+}
+
+// hash of the metadata (not of any values): identifies the struct
+// layout so that binary data written with a different schema (e.g. by
+// an older or newer build) is detected and rejected
+u32 GetStructInfoFingerprint(const StructInfo* info) {
+    return StructInfoFingerprintRec(info, 0x5bd1e995);
+}
+
 static void FreeStructData(const StructInfo* info, u8* base) {
     for (size_t i = 0; i < info->fieldCount; i++) {
         const FieldInfo& field = info->fields[i];
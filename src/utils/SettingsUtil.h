@@ -62,3 +62,11 @@ struct StructInfo {
 ByteSlice SerializeStruct(const StructInfo* info, const void* strct, const char* prevData = nullptr);
 void* DeserializeStruct(const StructInfo* info, const char* data, void* strct = nullptr);
 void FreeStruct(const StructInfo* info, void* strct);
+
+// binary serialization, much faster to deserialize than the text format.
+// the format is not self-describing: binary data must only be deserialized
+// with the same StructInfo it was serialized with, which callers verify
+// by comparing GetStructInfoFingerprint() values
+ByteSlice SerializeStructBin(const StructInfo* info, const void* strct);
+void* DeserializeStructBin(const StructInfo* info, const ByteSlice& data, void* strct = nullptr);
+u32 GetStructInfoFingerprint(const StructInfo* info);
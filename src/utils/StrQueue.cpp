@@ -2,6 +2,7 @@
    License: Simplified BSD (see COPYING.BSD) */
 
 #include "BaseUtil.h"
+#include "MpScQueue.h"
 #include "StrQueue.h"
 
 StrQueue::StrQueue() {
@@ -12,6 +13,13 @@ StrQueue::StrQueue() {
 }
 
 StrQueue::~StrQueue() {
+    char* s;
+    while (ring.Pop(s)) {
+        str::Free(s);
+    }
+    for (char* s2 : given) {
+        str::Free(s2);
+    }
     DeleteCriticalSection(&cs);
     CloseHandle(hEvent);
 }
@@ -43,13 +51,24 @@ int StrQueue::Size() {
     Lock();
     auto res = strings.Size();
     Unlock();
-    return res;
+    return res + nInRing.Get();
 }
 
 char* StrQueue::Append(const char* s, int len) {
-    Lock();
-    auto res = strings.Append(s, len);
-    Unlock();
+    char* dup = str::Dup(s, len < 0 ? (size_t)-1 : (size_t)len);
+    char* res;
+    if (ring.Push(dup)) {
+        nInRing.Inc();
+        res = dup;
+    } else {
+        // ring is full: spill into the vector. Strings can get consumed
+        // out of order then, which is fine: with multiple producers the
+        // order was never deterministic to begin with
+        str::Free(dup);
+        Lock();
+        res = strings.Append(s, len);
+        Unlock();
+    }
     SetEvent(hEvent);
     return res;
 }
@@ -65,19 +84,31 @@ bool StrQueue::IsSentinel(char* s) {
 // use IsSentinel() to check if returned value is a sentinel
 char* StrQueue::PopFront() {
 again:
+    char* s;
+    if (ring.Pop(s)) {
+        nInRing.Dec();
+        given.Append(s);
+        return s;
+    }
     Lock();
-    if (strings.Size() == 0) {
-        bool end = isFinished;
+    if (strings.Size() > 0) {
+        s = strings.RemoveAt(0);
         Unlock();
-        if (end) {
-            return (char*)kStrQueueSentinel;
-        }
-        WaitForSingleObject(hEvent, INFINITE);
-        goto again;
+        return s;
     }
-    char* s = strings.RemoveAt(0);
+    bool end = isFinished;
     Unlock();
-    return s;
+    if (end) {
+        // a producer could have pushed between our Pop() and reading isFinished
+        if (ring.Pop(s)) {
+            nInRing.Dec();
+            given.Append(s);
+            return s;
+        }
+        return (char*)kStrQueueSentinel;
+    }
+    WaitForSingleObject(hEvent, INFINITE);
+    goto again;
 }
 
 // is blocking
@@ -87,6 +118,14 @@ again:
 bool StrQueue::Access(const Func1<StrQueue*>& fn) {
 again:
     Lock();
+    // callbacks work on the strings vector directly, so pull
+    // everything out of the ring first
+    char* s;
+    while (ring.Pop(s)) {
+        nInRing.Dec();
+        strings.Append(s);
+        str::Free(s);
+    }
     if (strings.Size() == 0) {
         bool end = isFinished;
         Unlock();
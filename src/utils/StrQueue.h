@@ -2,6 +2,9 @@
    License: Simplified BSD (see COPYING.BSD) */
 
 // multi-threaded queue of strings
+// Append() / PopFront() hand strings over through a lock-free ring;
+// the critical section only guards the overflow vector and the
+// random-access path used by stress testing
 struct StrQueue {
     StrQueue();
     ~StrQueue();
@@ -16,8 +19,20 @@ struct StrQueue {
     bool IsFinished();
     bool Access(const Func1<StrQueue*>& fn);
 
+    // strings in flight between producers and the consumer;
+    // entries are malloc'ed and owned by this queue
+    MpScQueue<char*> ring;
+    // number of strings currently in ring
+    AtomicInt nInRing;
+
+    // overflow for when the ring is full and staging area for
+    // Access() callbacks; guarded by cs
     StrVec strings;
 
+    // keeps strings returned by PopFront() alive for as long as the
+    // queue; only touched by the consumer and the destructor
+    Vec<char*> given;
+
     volatile bool isFinished = false;
     CRITICAL_SECTION cs;
     HANDLE hEvent = nullptr;
@@ -12,6 +12,30 @@
 #define sscanf_s sscanf
 #endif
 
+// SSE2 is part of the x64 ABI and our x86 baseline, so unlike the
+// above-baseline kernels in PixelConvert.cpp this needs no CpuID()
+// runtime dispatch
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#include <intrin.h>
+#define USE_SSE2_STR_PRIMITIVES 1
+#endif
+
+#ifdef USE_SSE2_STR_PRIMITIVES
+// true if a 16-byte load at p can't cross into the next (possibly
+// unmapped) page
+static bool CanLoad16(const void* p) {
+    return ((uintptr_t)p & 0xFFF) <= 0xFF0;
+}
+
+// lower-cases 'A'-'Z' lanes; bytes >= 0x80 are negative in the signed
+// compare and pass through unchanged
+static __m128i LowerAscii(__m128i v) {
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), v));
+    return _mm_add_epi8(v, _mm_and_si128(isUpper, _mm_set1_epi8(32)));
+}
+#endif
+
 // --- copyright for utf8 code below
 
 /*
@@ -334,6 +358,34 @@ bool EqI(const char* s1, const char* s2) {
     if (!s1 || !s2) {
         return false;
     }
+#ifdef USE_SSE2_STR_PRIMITIVES
+    // ASCII fast path: compare 16 bytes per iteration. Bails to the
+    // locale-aware CRT compare on the first non-ASCII byte or when a
+    // load could cross a page boundary (the equal prefix consumed so
+    // far stays consumed)
+    while (CanLoad16(s1) && CanLoad16(s2)) {
+        __m128i a = _mm_loadu_si128((const __m128i*)s1);
+        __m128i b = _mm_loadu_si128((const __m128i*)s2);
+        __m128i zero = _mm_setzero_si128();
+        u32 zeroMask = (u32)(_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) | _mm_movemask_epi8(_mm_cmpeq_epi8(b, zero)));
+        // bytes up to and including the first 0 in either string; the 0
+        // itself is compared so that both strings must end together
+        u32 validMask = zeroMask ? (zeroMask ^ (zeroMask - 1)) : 0xFFFF;
+        u32 nonAscii = (u32)_mm_movemask_epi8(_mm_or_si128(a, b)) & validMask;
+        if (nonAscii) {
+            break;
+        }
+        u32 eqMask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(LowerAscii(a), LowerAscii(b)));
+        if ((eqMask & validMask) != validMask) {
+            return false;
+        }
+        if (zeroMask) {
+            return true;
+        }
+        s1 += 16;
+        s2 += 16;
+    }
+#endif
     return 0 == _stricmp(s1, s2);
 }
 
@@ -459,6 +511,47 @@ const char* FindI(const char* s, const char* toFind) {
     if (!first) {
         return s;
     }
+#ifdef USE_SSE2_STR_PRIMITIVES
+    if ((unsigned char)first < 0x80) {
+        // scan for the first character of toFind (either case) 16 bytes
+        // at a time, same as the anchor scan in TextSearch.cpp
+        char cLo = first;
+        char cUp = (cLo >= 'a' && cLo <= 'z') ? cLo - 32 : cLo;
+        // scalar until 16-byte aligned; aligned loads can't cross a page
+        for (; ((uintptr_t)s & 15) != 0; s++) {
+            if (!*s) {
+                return nullptr;
+            }
+            if ((*s == cLo || *s == cUp) && str::StartsWithI(s, toFind)) {
+                return s;
+            }
+        }
+        __m128i vLo = _mm_set1_epi8(cLo);
+        __m128i vUp = _mm_set1_epi8(cUp);
+        __m128i vZero = _mm_setzero_si128();
+        for (;; s += 16) {
+            __m128i chunk = _mm_load_si128((const __m128i*)s);
+            u32 hitMask = (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, vLo), _mm_cmpeq_epi8(chunk, vUp)));
+            u32 endMask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, vZero));
+            if (endMask) {
+                // ignore candidates at or past the terminating 0
+                hitMask &= (endMask - 1) & ~endMask;
+            }
+            while (hitMask) {
+                DWORD bit;
+                _BitScanForward(&bit, (DWORD)hitMask);
+                const char* cand = s + bit;
+                if (str::StartsWithI(cand, toFind)) {
+                    return cand;
+                }
+                hitMask &= hitMask - 1;
+            }
+            if (endMask) {
+                return nullptr;
+            }
+        }
+    }
+#endif
     while (*s) {
         char c = (char)tolower(*s);
         if (c == first) {
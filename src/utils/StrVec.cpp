@@ -382,6 +382,35 @@ StrVec& StrVec::operator=(const StrVec& that) {
     return *this;
 }
 
+// steals the pages of that instead of copying the strings;
+// that ends up empty
+StrVec::StrVec(StrVec&& that) noexcept {
+    first = that.first;
+    sortIndexes = that.sortIndexes;
+    nextPageSize = that.nextPageSize;
+    size = that.size;
+    dataSize = that.dataSize;
+    that.first = nullptr;
+    that.sortIndexes = nullptr;
+    that.size = 0;
+}
+
+StrVec& StrVec::operator=(StrVec&& that) noexcept {
+    if (this == &that) {
+        return *this;
+    }
+    Reset(nullptr);
+    first = that.first;
+    sortIndexes = that.sortIndexes;
+    nextPageSize = that.nextPageSize;
+    size = that.size;
+    dataSize = that.dataSize;
+    that.first = nullptr;
+    that.sortIndexes = nullptr;
+    that.size = 0;
+    return *this;
+}
+
 int StrVec::Size() const {
     return size;
 }
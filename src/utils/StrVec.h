@@ -24,6 +24,8 @@ struct StrVec {
     StrVec(int dataSize);
     StrVec(const StrVec& that);
     StrVec& operator=(const StrVec& that);
+    StrVec(StrVec&& that) noexcept;
+    StrVec& operator=(StrVec&& that) noexcept;
     ~StrVec();
 
     void Reset(StrVecPage* = nullptr);
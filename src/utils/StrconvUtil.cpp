@@ -16,6 +16,20 @@ WCHAR* Utf8ToWStr(const char* s, size_t cb, Allocator* a) {
     if (cb == 0) {
         return Allocator::AllocArray<WCHAR>(a, 1);
     }
+    // fast path for small strings: convert in a single pass into a
+    // stack buffer and copy out, instead of asking for the needed
+    // size first (which converts everything twice)
+    WCHAR buf[256];
+    if (cb < dimof(buf)) {
+        int cch = MultiByteToWideChar(CP_UTF8, 0, s, (int)cb, buf, (int)dimof(buf));
+        if (cch > 0) {
+            WCHAR* res = Allocator::AllocArray<WCHAR>(a, cch + 1);
+            if (res) {
+                memcpy(res, buf, (size_t)cch * sizeof(WCHAR));
+            }
+            return res;
+        }
+    }
     // ask for the size of buffer needed for converted string
     int cchNeeded = MultiByteToWideChar(CP_UTF8, 0, s, (int)cb, nullptr, 0);
     WCHAR* res = Allocator::AllocArray<WCHAR>(a, cchNeeded + 1); // +1 for terminating 0
@@ -41,6 +55,19 @@ char* WStrToCodePage(uint codePage, const WCHAR* s, size_t cch, Allocator* a) {
     if (cch == 0) {
         return Allocator::AllocArray<char>(a, 1);
     }
+    // single-pass fast path, like in Utf8ToWStr (a WCHAR expands to at
+    // most 3 bytes, so the result is guaranteed to fit)
+    char buf[512];
+    if (cch * 3 < sizeof(buf)) {
+        int cbConv = WideCharToMultiByte(codePage, 0, s, (int)cch, buf, (int)sizeof(buf), nullptr, nullptr);
+        if (cbConv > 0) {
+            char* res = Allocator::AllocArray<char>(a, cbConv + 1);
+            if (res) {
+                memcpy(res, buf, (size_t)cbConv);
+            }
+            return res;
+        }
+    }
     // ask for the size of buffer needed for converted string
     int cbNeeded = WideCharToMultiByte(codePage, 0, s, (int)cch, nullptr, 0, nullptr, nullptr);
     if (cbNeeded == 0) {
@@ -60,6 +87,52 @@ char* WStrToUtf8(const WCHAR* s, size_t cch, Allocator* a) {
     return WStrToCodePage(CP_UTF8, s, cch, a);
 }
 
+// converts into the caller-provided buf if the result fits (no
+// allocation at all), otherwise falls back to allocating from a
+WCHAR* Utf8ToWStrBuf(const char* s, size_t cb, WCHAR* buf, size_t cchBuf, Allocator* a) {
+    if (!s || !buf || cchBuf == 0) {
+        return Utf8ToWStr(s, cb, a);
+    }
+    if (cb == (size_t)-1) {
+        cb = str::Len(s);
+    }
+    if (cb == 0) {
+        buf[0] = 0;
+        return buf;
+    }
+    // a utf8 string never produces more WCHARs than its byte count
+    if (cb < cchBuf) {
+        int cch = MultiByteToWideChar(CP_UTF8, 0, s, (int)cb, buf, (int)cchBuf - 1);
+        if (cch > 0) {
+            buf[cch] = 0;
+            return buf;
+        }
+    }
+    return Utf8ToWStr(s, cb, a);
+}
+
+char* WStrToUtf8Buf(const WCHAR* s, size_t cch, char* buf, size_t cbBuf, Allocator* a) {
+    if (!s || !buf || cbBuf == 0) {
+        return WStrToUtf8(s, cch, a);
+    }
+    if (cch == (size_t)-1) {
+        cch = str::Len(s);
+    }
+    if (cch == 0) {
+        buf[0] = 0;
+        return buf;
+    }
+    // a WCHAR expands to at most 3 utf8 bytes
+    if (cch * 3 < cbBuf) {
+        int cb = WideCharToMultiByte(CP_UTF8, 0, s, (int)cch, buf, (int)cbBuf - 1, nullptr, nullptr);
+        if (cb > 0) {
+            buf[cb] = 0;
+            return buf;
+        }
+    }
+    return WStrToUtf8(s, cch, a);
+}
+
 // caller needs to free() the result
 WCHAR* StrCPToWStr(const char* src, uint codePage, int cbSrc) {
     ReportIf(!src);
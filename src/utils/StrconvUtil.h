@@ -6,6 +6,11 @@ namespace strconv {
 WCHAR* Utf8ToWStr(const char* s, size_t cb = (size_t)-1, Allocator* a = nullptr);
 char* WStrToUtf8(const WCHAR* s, size_t cch = (size_t)-1, Allocator* a = nullptr);
 
+// zero-allocation variants: the result goes into the caller-provided
+// buffer when it fits, with allocation from a only as a fallback
+WCHAR* Utf8ToWStrBuf(const char* s, size_t cb, WCHAR* buf, size_t cchBuf, Allocator* a = nullptr);
+char* WStrToUtf8Buf(const WCHAR* s, size_t cch, char* buf, size_t cbBuf, Allocator* a = nullptr);
+
 char* WStrToCodePage(uint codePage, const WCHAR* s, size_t cch = (size_t)-1, Allocator* a = nullptr);
 TempStr ToMultiByteTemp(const char* src, uint codePageSrc, uint codePageDest);
 WCHAR* StrCPToWStr(const char* src, uint codePage, int cbSrc = -1);
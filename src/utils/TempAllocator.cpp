@@ -10,9 +10,14 @@ It's an alternative to using various AutoFree* classes.
 
 It's a very fast bump allocator.
 
+There's one temp allocator per thread, so worker threads get the same
+cheap allocations as the UI thread.
+
 You must periodically call ResetTempAllocator()
 to free memory used by allocator.
 A good place to do it is at the beginning of window message loop.
+On worker threads that can't easily do that, ScopedTempAllocMark
+rewinds the arena to where it was when the scope was entered.
 */
 
 thread_local static PoolAllocator* gTempAllocator = nullptr;
@@ -40,6 +45,15 @@ void ResetTempAllocator() {
     }
 }
 
+ScopedTempAllocMark::ScopedTempAllocMark() {
+    a = (PoolAllocator*)GetTempAllocator();
+    mark = a->GetMark();
+}
+
+ScopedTempAllocMark::~ScopedTempAllocMark() {
+    a->RewindTo(mark);
+}
+
 namespace str {
 TempStr DupTemp(const char* s, size_t cb) {
     return str::Dup(GetTempAllocator(), s, cb);
@@ -7,6 +7,18 @@ Allocator* GetTempAllocator();
 void DestroyTempAllocator();
 void ResetTempAllocator();
 
+// rewinds the calling thread's temp allocator on scope exit to where
+// it was at construction. For long-running worker-thread loops that
+// create lots of *Temp() values: unlike ResetTempAllocator() it
+// doesn't invalidate temp values created before the scope was entered
+struct ScopedTempAllocMark {
+    PoolAllocator::Mark mark;
+    PoolAllocator* a = nullptr;
+
+    ScopedTempAllocMark();
+    ~ScopedTempAllocMark();
+};
+
 template <typename T>
 FORCEINLINE T* AllocArrayTemp(size_t n) {
     auto a = GetTempAllocator();
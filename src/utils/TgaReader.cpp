@@ -369,8 +369,20 @@ Gdiplus::Bitmap* ImageFromData(const ByteSlice& d) {
     if (ok != Gdiplus::Ok) {
         return nullptr;
     }
+    // uncompressed truecolor is already in the target byte order, so
+    // whole rows can be copied at once instead of pixel by pixel
+    bool canCopyRows = Type_Truecolor == s.type && !invertX && s.n == n;
     for (int y = 0; y < h; y++) {
         u8* rowOut = (u8*)bmpData.Scan0 + bmpData.Stride * (invertY ? y : h - 1 - y);
+        if (canCopyRows) {
+            if (s.data + (size_t)n * w > s.end) {
+                s.failed = true;
+                break;
+            }
+            memcpy(rowOut, s.data, (size_t)n * w);
+            s.data += (size_t)n * w;
+            continue;
+        }
         for (int x = 0; x < w; x++) {
             ReadPixel(s, rowOut + n * (invertX ? w - 1 - x : x));
         }
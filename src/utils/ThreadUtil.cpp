@@ -3,6 +3,7 @@
 
 #include "BaseUtil.h"
 #include "ScopedWin.h"
+#include "Vec.h"
 #include "WinDynCalls.h"
 #include "WinUtil.h"
 
@@ -57,6 +58,36 @@ void SetThreadName(DWORD, const char*) {
 }
 #endif // COMPILER_MSVC
 
+static void SetCurrentThreadMemoryPriority(ULONG prio) {
+    if (!DynSetThreadInformation) {
+        return;
+    }
+    MEMORY_PRIORITY_INFORMATION mpi{};
+    mpi.MemoryPriority = prio;
+    DynSetThreadInformation(GetCurrentThread(), ThreadMemoryPriority, &mpi, sizeof(mpi));
+}
+
+void SetCurrentThreadQoS(ThreadQoS qos) {
+    HANDLE h = GetCurrentThread();
+    switch (qos) {
+        case ThreadQoS::Utility:
+            SetThreadPriority(h, THREAD_PRIORITY_BELOW_NORMAL);
+            SetCurrentThreadMemoryPriority(MEMORY_PRIORITY_BELOW_NORMAL);
+            break;
+        case ThreadQoS::Background:
+            // lowers CPU, I/O and memory priority in a single call so
+            // the work only proceeds when the machine is otherwise idle
+            SetThreadPriority(h, THREAD_MODE_BACKGROUND_BEGIN);
+            break;
+        default:
+            // fails harmlessly when the thread isn't in background mode
+            SetThreadPriority(h, THREAD_MODE_BACKGROUND_END);
+            SetThreadPriority(h, THREAD_PRIORITY_NORMAL);
+            SetCurrentThreadMemoryPriority(MEMORY_PRIORITY_NORMAL);
+            break;
+    }
+}
+
 static DWORD WINAPI ThreadFunc0(void* data) {
     auto* fn = (Func0*)(data);
     fn->Call();
@@ -78,9 +109,104 @@ HANDLE StartThread(const Func0& fn, const char* threadName) {
     return hThread;
 }
 
-void RunAsync(const Func0& fn, const char* threadName) {
-    HANDLE hThread = StartThread(fn, threadName);
-    SafeCloseHandle(&hThread);
+/* Worker pool backing RunAsync(). Workers are created on demand up to
+a limit and then kept around waiting on a semaphore, so frequent async
+tasks don't pay thread-creation latency and the process keeps a
+bounded, warm thread set. Tasks are fire-and-forget so a single shared
+queue is enough; a task can carry a ThreadQoS which the worker applies
+for its duration, there's no scheduler beyond FIFO. Cancellation is up
+to the tasks (long-running ones use their own AtomicBool flags). */
+
+struct PoolTask {
+    Func0 fn;
+    const char* name; // shows up as the thread name while running, can be nullptr
+    ThreadQoS qos = ThreadQoS::Default;
+};
+
+static Mutex gPoolMux; // guards all gPool* state below
+static Vec<PoolTask>* gPoolQueue = nullptr;
+static HANDLE gPoolSem = nullptr; // released once per queued task
+static int gPoolThreadCount = 0;
+static int gPoolThreadsIdle = 0;
+static int gPoolMaxThreads = 0;
+
+static DWORD WINAPI PoolThreadFunc(void*) {
+    for (;;) {
+        gPoolMux.Lock();
+        gPoolThreadsIdle++;
+        gPoolMux.Unlock();
+
+        WaitForSingleObject(gPoolSem, INFINITE);
+
+        gPoolMux.Lock();
+        gPoolThreadsIdle--;
+        if (gPoolQueue->size() == 0) {
+            // can happen if a task was run inline after CreateThread failed
+            gPoolMux.Unlock();
+            continue;
+        }
+        PoolTask task = gPoolQueue->PopAt(0);
+        gPoolMux.Unlock();
+
+        SetThreadName(task.name ? task.name : "AsyncPoolThread");
+        if (task.qos != ThreadQoS::Default) {
+            SetCurrentThreadQoS(task.qos);
+        }
+        {
+            // reclaim the temp allocations the task made while
+            // keeping the arena's first block warm for the next task
+            ScopedTempAllocMark tempMark;
+            task.fn.Call();
+        }
+        if (task.qos != ThreadQoS::Default) {
+            // the worker is shared; don't leak the priority to the next task
+            SetCurrentThreadQoS(ThreadQoS::Default);
+        }
+    }
+}
+
+void RunAsync(const Func0& fn, const char* threadName, ThreadQoS qos) {
+    gPoolMux.Lock();
+    if (!gPoolQueue) {
+        gPoolQueue = new Vec<PoolTask>();
+        gPoolSem = CreateSemaphoreW(nullptr, 0, 0x7fffffff, nullptr);
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        // x2 because some tasks block on i/o for a long time
+        // (e.g. downloads) and shouldn't starve short ones
+        gPoolMaxThreads = limitValue<int>((int)si.dwNumberOfProcessors * 2, 8, 32);
+    }
+    PoolTask task{fn, threadName, qos};
+    gPoolQueue->Append(task);
+    bool startWorker = (0 == gPoolThreadsIdle) && (gPoolThreadCount < gPoolMaxThreads);
+    if (startWorker) {
+        gPoolThreadCount++;
+    }
+    gPoolMux.Unlock();
+    ReleaseSemaphore(gPoolSem, 1, nullptr);
+
+    if (!startWorker) {
+        return;
+    }
+    HANDLE hThread = CreateThread(nullptr, 0, PoolThreadFunc, nullptr, 0, nullptr);
+    if (hThread) {
+        CloseHandle(hThread);
+        return;
+    }
+    // couldn't start a worker; if none exist, run the task inline so
+    // it isn't stuck in the queue forever (the extra semaphore count
+    // wakes a future worker to an empty queue, which is handled)
+    gPoolMux.Lock();
+    gPoolThreadCount--;
+    bool runInline = (0 == gPoolThreadCount) && (gPoolQueue->size() > 0);
+    PoolTask stuck{};
+    if (runInline) {
+        stuck = gPoolQueue->PopAt(0);
+    }
+    gPoolMux.Unlock();
+    if (runInline) {
+        stuck.fn.Call();
+    }
 }
 
 AtomicInt gDangerousThreadCount;
@@ -21,7 +21,20 @@ struct Mutex {
 
 void SetThreadName(const char* threadName, DWORD threadId = 0);
 
-void RunAsync(const Func0&, const char* threadName = nullptr);
+// categories of off-main-thread work, mapped to Windows CPU, I/O and
+// memory priorities so that background work never competes with the UI
+// thread or the visible page's render (matters most on low-core machines)
+enum class ThreadQoS {
+    Default,    // regular priority
+    Utility,    // results show on screen soon (searches, thumbnails)
+    Background, // speculative or housekeeping work; runs when otherwise idle
+};
+// applies to the calling thread; pass Default to undo
+void SetCurrentThreadQoS(ThreadQoS);
+
+// runs fn on a shared pool of warm worker threads (fire-and-forget);
+// use StartThread() when a dedicated, joinable thread is needed
+void RunAsync(const Func0&, const char* threadName = nullptr, ThreadQoS qos = ThreadQoS::Default);
 HANDLE StartThread(const Func0&, const char* threadName = nullptr);
 
 extern AtomicInt gDangerousThreadCount;
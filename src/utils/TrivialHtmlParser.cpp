@@ -119,22 +119,19 @@ HtmlParser::HtmlParser()
 
     = default;
 
-HtmlParser::~HtmlParser() {
-    if (freeHtml) {
-        free(html);
-    }
-}
+HtmlParser::~HtmlParser()
+
+    = default;
 
 void HtmlParser::Reset() {
-    if (freeHtml) {
-        free(html);
-    }
     html = nullptr;
-    freeHtml = false;
     rootElement = currElement = nullptr;
+    lastParent = lastParentChild = nullptr;
     elementsCount = attributesCount = 0;
     error = ErrParsingNoError;
     errorContext = nullptr;
+    // frees the DOM, the strings it points into (if parsed with
+    // Parse()) in one go
     allocator.FreeAll();
 }
 
@@ -209,9 +206,16 @@ void HtmlParser::StartTag(HtmlToken* tok) {
     if (!parent) {
         // if this isn't the root tag, this tag
         // and all its children will be ignored
-    } else if (nullptr == parent->down) {
+        return;
+    }
+    if (nullptr == parent->down) {
         // parent has no children => set as a first child
         parent->down = currElement;
+    } else if (lastParent == parent) {
+        // appending yet another child to the same parent; without
+        // this walking the sibling list below makes parsing long
+        // runs of siblings (e.g. a big CHM ToC) quadratic
+        lastParentChild->next = currElement;
     } else {
         // parent has children => set as a sibling
         HtmlElement* tmp = parent->down;
@@ -220,6 +224,8 @@ void HtmlParser::StartTag(HtmlToken* tok) {
         }
         tmp->next = currElement;
     }
+    lastParent = parent;
+    lastParentChild = currElement;
 }
 
 void HtmlParser::CloseTag(HtmlToken* tok) {
@@ -308,10 +314,16 @@ HtmlElement* HtmlParser::ParseInPlace(const ByteSlice& d, uint codepage) {
 }
 
 HtmlElement* HtmlParser::Parse(const ByteSlice& d, uint codepage) {
-    char* s = str::Dup(d);
-    HtmlElement* root = ParseInPlace(ToByteSlice(s), codepage);
-    freeHtml = true;
-    return root;
+    if (html) {
+        Reset();
+    }
+    // copy into the arena so that the DOM and the text its
+    // names/values point into are freed together
+    size_t n = d.size();
+    char* s = (char*)allocator.Alloc(n + 1);
+    memcpy(s, d.data(), n);
+    s[n] = '\0';
+    return ParseInPlace(ByteSlice((u8*)s, n), codepage);
 }
 
 // Does a depth-first search of element tree, looking for an element with
@@ -38,11 +38,9 @@ struct HtmlElement {
 class HtmlParser {
     PoolAllocator allocator;
 
-    // text to parse. It can be changed.
+    // text to parse. It can be changed. Either owned by the caller
+    // (ParseInPlace) or a copy living in allocator (Parse)
     char* html = nullptr;
-    // true if s was allocated by ourselves, false if managed
-    // by the caller
-    bool freeHtml = false;
     // the codepage used for converting text to Unicode
     uint codepage{CP_ACP};
 
@@ -51,6 +49,10 @@ class HtmlParser {
 
     HtmlElement* rootElement = nullptr;
     HtmlElement* currElement = nullptr;
+    // the last parent StartTag() appended a child to and that child,
+    // so that appending long runs of siblings is O(1)
+    HtmlElement* lastParent = nullptr;
+    HtmlElement* lastParentChild = nullptr;
 
     HtmlElement* AllocElement(HtmlTag tag, char* name, HtmlElement* parent);
     HtmlAttr* AllocAttr(char* name, HtmlAttr* next);
@@ -3,6 +3,7 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/Vec.h"
 #include "utils/WinUtil.h"
 #include "utils/UITask.h"
 
@@ -10,8 +11,22 @@
 
 namespace uitask {
 
+struct UITaskEntry {
+    Func0 fn;
+    Kind kind;
+    void* token; // non-null only for tasks posted with PostCoalesced()
+};
+
 static HWND gTaskDispatchHwnd = nullptr;
 
+// tasks are queued here and executed in one batch per posted wake-up
+// message, so that a storm of tasks (e.g. per-tile render completions)
+// doesn't flood the message queue and starve input
+static CRITICAL_SECTION gQueueCs;
+static Vec<UITaskEntry>* gQueue = nullptr;
+// true if a wake-up message is in flight; guarded by gQueueCs
+static bool gWakeUpPending = false;
+
 static UINT GetExecuteTaskMessage() {
     static UINT gExecuteTaskMessage = 0;
     if (!gExecuteTaskMessage) {
@@ -20,19 +35,30 @@ static UINT GetExecuteTaskMessage() {
     return gExecuteTaskMessage;
 }
 
+static void ExecuteQueuedTasks() {
+    Vec<UITaskEntry> todo;
+    {
+        ScopedCritSec cs(&gQueueCs);
+        todo = *gQueue;
+        gQueue->Reset();
+        // tasks posted from now on need a new wake-up message
+        gWakeUpPending = false;
+    }
+    for (UITaskEntry& t : todo) {
+        if (t.kind != nullptr) {
+            logf("uitask::ExecuteQueuedTasks: will execute '%s'\n", t.kind);
+        }
+        t.fn.Call();
+        if (t.kind != nullptr) {
+            logf("uitask::ExecuteQueuedTasks: did execute '%s'\n", t.kind);
+        }
+    }
+}
+
 static LRESULT CALLBACK WndProcTaskDispatch(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
     UINT wmExecTask = GetExecuteTaskMessage();
     if (wmExecTask == msg) {
-        Kind kind = (Kind)wp;
-        auto func = (Func0*)lp;
-        if (kind != nullptr) {
-            logf("uitask::WndProcTaskDispatch: will execute '%s', func 0x%p\n", kind, (void*)func);
-        }
-        func->Call();
-        if (kind != nullptr) {
-            logf("uitask::WndProcTaskDispatch: did execute, will delete func 0x%p\n", (void*)func);
-        }
-        delete func;
+        ExecuteQueuedTasks();
         return 0;
     }
     return DefWindowProc(hwnd, msg, wp, lp);
@@ -41,6 +67,9 @@ static LRESULT CALLBACK WndProcTaskDispatch(HWND hwnd, UINT msg, WPARAM wp, LPAR
 #define UITASK_CLASS_NAME L"UITask_Wnd_Class"
 
 void Initialize() {
+    InitializeCriticalSection(&gQueueCs);
+    gQueue = new Vec<UITaskEntry>();
+
     WNDCLASSEX wcex;
     FillWndClassEx(wcex, UITASK_CLASS_NAME, WndProcTaskDispatch);
     RegisterClassEx(&wcex);
@@ -66,14 +95,44 @@ void Destroy() {
     DrainQueue();
     DestroyWindow(gTaskDispatchHwnd);
     gTaskDispatchHwnd = nullptr;
+    delete gQueue;
+    gQueue = nullptr;
+    DeleteCriticalSection(&gQueueCs);
+}
+
+// must be called while holding gQueueCs
+static void QueueTaskLocked(const Func0& f, Kind kind, void* token) {
+    UITaskEntry t{f, kind, token};
+    gQueue->Append(t);
+    if (!gWakeUpPending) {
+        gWakeUpPending = true;
+        UINT wmExecTask = GetExecuteTaskMessage();
+        PostMessageW(gTaskDispatchHwnd, wmExecTask, 0, 0);
+    }
 }
 
 void Post(const Func0& f, Kind kind) {
-    auto func = new Func0(f);
-    UINT wmExecTask = GetExecuteTaskMessage();
-    PostMessageW(gTaskDispatchHwnd, wmExecTask, (WPARAM)kind, (LPARAM)func);
+    ScopedCritSec cs(&gQueueCs);
+    QueueTaskLocked(f, kind, nullptr);
 } // NOLINT
 
+// Like Post() but if a not-yet-executed task with the same function and
+// token is already queued, doesn't queue f again and returns false, in
+// which case the caller keeps ownership of whatever data is bound into
+// f. Collapses storms of equivalent tasks (e.g. a repaint per rendered
+// tile) into a single execution
+bool PostCoalesced(const Func0& f, Kind kind, void* token) {
+    ReportIf(!token);
+    ScopedCritSec cs(&gQueueCs);
+    for (UITaskEntry& t : *gQueue) {
+        if (t.token == token && t.fn.fn == f.fn) {
+            return false;
+        }
+    }
+    QueueTaskLocked(f, kind, token);
+    return true;
+}
+
 #if 0
 void PostOptimized(const Func0& f, Kind kind) {
     if (IsGUIThread(FALSE)) {
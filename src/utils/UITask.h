@@ -11,5 +11,8 @@ void Destroy();
 void DrainQueue();
 
 void Post(const Func0& fn, Kind kind = nullptr);
+// returns false (and doesn't queue fn) if an equivalent task is
+// already queued; see UITask.cpp for details
+bool PostCoalesced(const Func0& fn, Kind kind, void* token);
 // void PostOptimized(const Func0& fn, Kind kind = nullptr);
 } // namespace uitask
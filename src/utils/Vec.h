@@ -7,8 +7,11 @@
 store pointer types or POD types
 (http://stackoverflow.com/questions/146452/what-are-pod-types-in-c).
 
+kBufEls is the number of elements stored inline before the first heap
+allocation; bump it for vectors that are known to typically hold more
+than the default 16.
 */
-template <typename T>
+template <typename T, size_t kBufEls = 16>
 class Vec {
   public:
     Allocator* allocator = nullptr;
@@ -16,7 +19,7 @@ class Vec {
     size_t cap = 0;
     size_t capacityHint = 0;
     T* els = nullptr;
-    T buf[16];
+    T buf[kBufEls];
 
     // We always pad the elements with a single 0 value. This makes
     // Vec<char> and Vec<WCHAR> a C-compatible string. Although it's
@@ -136,14 +139,28 @@ class Vec {
         memcpy(els, other.els, kElSize * (other.len));
     }
 
-    // TODO: write Vec(const Vec&& other)
+    // steals the heap buffer of other (or copies its inline buf)
+    // instead of deep-copying the elements; other ends up empty
+    Vec(Vec&& other) noexcept {
+        allocator = other.allocator;
+        capacityHint = other.capacityHint;
+        len = other.len;
+        cap = other.cap;
+        if (other.els == other.buf) {
+            els = buf;
+            memcpy(buf, other.buf, sizeof(buf));
+        } else {
+            els = other.els;
+        }
+        other.els = other.buf;
+        other.Reset();
+    }
 
     Vec& operator=(const Vec& other) {
         if (this == &other) {
             return *this;
         }
 
-        els = buf;
         Reset();
         EnsureCap(other.len);
         // using memcpy, as Vec only supports POD types
@@ -154,6 +171,26 @@ class Vec {
         return *this;
     }
 
+    Vec& operator=(Vec&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        FreeEls();
+        allocator = other.allocator;
+        capacityHint = other.capacityHint;
+        len = other.len;
+        cap = other.cap;
+        if (other.els == other.buf) {
+            els = buf;
+            memcpy(buf, other.buf, sizeof(buf));
+        } else {
+            els = other.els;
+        }
+        other.els = other.buf;
+        other.Reset();
+        return *this;
+    }
+
     ~Vec() {
         FreeEls();
     }
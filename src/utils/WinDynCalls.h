@@ -70,6 +70,7 @@ NORMALIZ_API_LIST(API_DECLARATION)
     V(RtlCaptureContext)        \
     V(RtlCaptureStackBackTrace) \
     V(SetThreadDescription)     \
+    V(SetThreadInformation)     \
     V(SetProcessMitigationPolicy)
 
 // TODO: only available in 20348, not yet present in SDK?
@@ -122,6 +123,7 @@ DWMAPI_API_LIST(API_DECLARATION2)
     V(SymSetOptions)            \
     V(StackWalk64)              \
     V(SymFromAddr)              \
+    V(SymEnumSymbols)           \
     V(SymFunctionTableAccess64) \
     V(SymGetModuleBase64)       \
     V(SymSetSearchPathW)        \
@@ -1401,6 +1401,41 @@ static bool SetClipboardImage(HBITMAP hbmp) {
     if (!hbmp) {
         return false;
     }
+    DIBSECTION ds{};
+    if (GetObject(hbmp, sizeof(ds), &ds) == sizeof(DIBSECTION) && ds.dsBm.bmBits && ds.dsBmih.biBitCount >= 24 &&
+        ds.dsBmih.biCompression == BI_RGB) {
+        // hand the clipboard a packed DIB in a single allocation instead
+        // of having CopyImage() convert the DIB section into a
+        // device-dependent bitmap; the system synthesizes CF_BITMAP from
+        // it on demand
+        int h = ds.dsBm.bmHeight;
+        int stride = ds.dsBm.bmWidthBytes;
+        DWORD sizeImage = (DWORD)stride * (DWORD)h;
+        HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, sizeof(BITMAPINFOHEADER) + sizeImage);
+        if (hMem) {
+            u8* dest = (u8*)GlobalLock(hMem);
+            BITMAPINFOHEADER* bmih = (BITMAPINFOHEADER*)dest;
+            *bmih = ds.dsBmih;
+            // write a bottom-up DIB (reversing the rows if the source is
+            // top-down) for maximum compatibility of paste targets
+            bool topDown = ds.dsBmih.biHeight < 0;
+            bmih->biHeight = h;
+            bmih->biSizeImage = sizeImage;
+            dest += sizeof(BITMAPINFOHEADER);
+            u8* src = (u8*)ds.dsBm.bmBits;
+            for (int y = 0; y < h; y++) {
+                int srcRow = topDown ? h - 1 - y : y;
+                memcpy(dest + (size_t)y * stride, src + (size_t)srcRow * stride, stride);
+            }
+            GlobalUnlock(hMem);
+            if (SetClipboardData(CF_DIB, hMem) != nullptr) {
+                return true;
+            }
+            GlobalFree(hMem);
+        }
+        // fall through to the CopyImage() path on failure
+    }
+
     BITMAP bmpInfo;
     GetObject(hbmp, sizeof(BITMAP), &bmpInfo);
     HANDLE h = nullptr;
@@ -1662,7 +1697,17 @@ DoubleBuffer::DoubleBuffer(HWND hwnd, Rect rect) : hTarget(hwnd), hdcCanvas(::Ge
         return;
     }
 
-    doubleBuffer = CreateCompatibleBitmap(hdcCanvas, rect.dx, rect.dy);
+    // a 32bpp dib section instead of a compatible bitmap so that the
+    // composed pixels can be handed to a GPU presenter directly (see
+    // D2DPresenter::PresentScaled in Canvas.cpp)
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = rect.dx;
+    bmi.bmiHeader.biHeight = -rect.dy; // top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    doubleBuffer = CreateDIBSection(hdcCanvas, &bmi, DIB_RGB_COLORS, (void**)&bits, nullptr, 0);
     if (!doubleBuffer) {
         return;
     }
@@ -2051,6 +2096,43 @@ inline int mul255(int a, int b) {
     return x >> 8;
 }
 
+/* applies v' = base[k] + mul255(v, diff[k]) (k = byte index % 4) in
+place to len bytes of BGRA pixel data, 16 bytes (4 pixels) per
+iteration. This is the per-pixel cost of theming a rendered page, so it
+uses SSE2 (part of the x64 baseline): the products of the widened pixel
+lanes and the per-channel diff are reassembled into 32-bit lanes, where
+((x + 128) * 257) >> 16 computes mul255() bit-identically, including
+for negative diff */
+static void ApplyLinearColorMapBGRA(u8* d, int len, const int base[4], const int diff[4]) {
+    __m128i diffv = _mm_set_epi16((short)diff[3], (short)diff[2], (short)diff[1], (short)diff[0], (short)diff[3],
+                                  (short)diff[2], (short)diff[1], (short)diff[0]);
+    __m128i basev = _mm_set_epi32(base[3], base[2], base[1], base[0]);
+    __m128i c128 = _mm_set1_epi32(128);
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(d + i));
+        __m128i half[2] = {_mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero)};
+        __m128i res16[2];
+        for (int h = 0; h < 2; h++) {
+            __m128i pl = _mm_mullo_epi16(half[h], diffv);
+            __m128i ph = _mm_mulhi_epi16(half[h], diffv);
+            __m128i p0 = _mm_unpacklo_epi16(pl, ph);
+            __m128i p1 = _mm_unpackhi_epi16(pl, ph);
+            p0 = _mm_add_epi32(p0, c128);
+            p0 = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(p0, 8), p0), 16);
+            p1 = _mm_add_epi32(p1, c128);
+            p1 = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(p1, 8), p1), 16);
+            res16[h] = _mm_packs_epi32(_mm_add_epi32(p0, basev), _mm_add_epi32(p1, basev));
+        }
+        _mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(res16[0], res16[1]));
+    }
+    for (; i < len; i++) {
+        int k = i % 4;
+        d[i] = (u8)(base[k] + mul255(d[i], diff[k]));
+    }
+}
+
 void FinalizeBitmapPixels(BitmapPixels* bitmapPixels) {
     HDC hdc = bitmapPixels->hdc;
     if (hdc) {
@@ -2164,10 +2246,7 @@ void UpdateBitmapColors(HBITMAP hbmp, COLORREF textColor, COLORREF bgColor) {
         size.dx * 4 == info.dsBm.bmWidthBytes) {
         int bmpBytes = size.dx * size.dy * 4;
         u8* bmpData = (u8*)info.dsBm.bmBits;
-        for (int i = 0; i < bmpBytes; i++) {
-            int k = i % 4;
-            bmpData[i] = (u8)(base[k] + mul255(bmpData[i], diff[k]));
-        }
+        ApplyLinearColorMapBGRA(bmpData, bmpBytes, base, diff);
         return;
     }
 
@@ -2218,16 +2297,97 @@ void UpdateBitmapColors(HBITMAP hbmp, COLORREF textColor, COLORREF bgColor) {
     ReportIf(!bmpData);
 
     if (GetDIBits(hDC, hbmp, 0, size.dy, bmpData, &bmi, DIB_RGB_COLORS)) {
-        for (int i = 0; i < bmpBytes; i++) {
-            int k = i % 4;
-            bmpData[i] = (u8)(base[k] + mul255(bmpData[i], diff[k]));
-        }
+        ApplyLinearColorMapBGRA(bmpData, bmpBytes, base, diff);
         SetDIBits(hDC, hbmp, 0, size.dy, bmpData, &bmi, DIB_RGB_COLORS);
     }
 
     DeleteDC(hDC);
 }
 
+// re-maps a bitmap colored by UpdateBitmapColors(textColor0, bgColor0)
+// to a different color pair without re-rendering: the original linear
+// map is inverted per channel and the new one applied, via a lookup
+// table per channel. returns false when that isn't possible (degenerate
+// source mapping or unexpected bitmap format); the caller re-renders
+bool RemapBitmapColors(HBITMAP hbmp, COLORREF textColor0, COLORREF bgColor0, COLORREF textColor1, COLORREF bgColor1) {
+    byte rt0, gt0, bt0, rb0, gb0, bb0, rt1, gt1, bt1, rb1, gb1, bb1;
+    UnpackColor(textColor0, rt0, gt0, bt0);
+    UnpackColor(bgColor0, rb0, gb0, bb0);
+    UnpackColor(textColor1, rt1, gt1, bt1);
+    UnpackColor(bgColor1, rb1, gb1, bb1);
+    // color order in DIB is blue-green-red-alpha
+    const int base0[4] = {bt0, gt0, rt0, 0};
+    const int diff0[4] = {(int)bb0 - base0[0], (int)gb0 - base0[1], (int)rb0 - base0[2], 255};
+    const int base1[4] = {bt1, gt1, rt1, 0};
+    const int diff1[4] = {(int)bb1 - base1[0], (int)gb1 - base1[1], (int)rb1 - base1[2], 255};
+
+    // a pixel was mapped to v = base0 + t * diff0 / 255 for document
+    // intensity t; recover t, then map it with the new colors
+    u8 lut[4][256];
+    for (int k = 0; k < 4; k++) {
+        if (0 == diff0[k]) {
+            // the source mapping collapsed this channel, can't invert
+            return false;
+        }
+        for (int v = 0; v < 256; v++) {
+            float t = (float)((v - base0[k]) * 255) / (float)diff0[k];
+            t = limitValue(t, 0.0f, 255.0f);
+            int res = base1[k] + (int)roundf(t * (float)diff1[k] / 255.0f);
+            lut[k][v] = (u8)limitValue(res, 0, 255);
+        }
+    }
+
+    DIBSECTION info{};
+    int ret = GetObject(hbmp, sizeof(info), &info);
+    ReportIf(ret < sizeof(info.dsBm));
+    Size size(info.dsBm.bmWidth, info.dsBm.bmHeight);
+
+    // for mapped 32-bit DI bitmaps: directly access the pixel data
+    if (ret >= sizeof(info.dsBm) && info.dsBm.bmBits && 32 == info.dsBm.bmBitsPixel &&
+        size.dx * 4 == info.dsBm.bmWidthBytes) {
+        int bmpBytes = size.dx * size.dy * 4;
+        u8* bmpData = (u8*)info.dsBm.bmBits;
+        for (int i = 0; i < bmpBytes; i++) {
+            bmpData[i] = lut[i % 4][bmpData[i]];
+        }
+        return true;
+    }
+
+    // for mapped 24-bit DI bitmaps: directly access the pixel data
+    if (ret >= sizeof(info.dsBm) && info.dsBm.bmBits && 24 == info.dsBm.bmBitsPixel &&
+        info.dsBm.bmWidthBytes >= size.dx * 3) {
+        u8* bmpData = (u8*)info.dsBm.bmBits;
+        for (int y = 0; y < size.dy; y++) {
+            for (int x = 0; x < size.dx * 3; x++) {
+                bmpData[x] = lut[x % 3][bmpData[x]];
+            }
+            bmpData += info.dsBm.bmWidthBytes;
+        }
+        return true;
+    }
+
+    // for paletted DI bitmaps: only update the color palette
+    if (sizeof(info) == ret && info.dsBmih.biBitCount && info.dsBmih.biBitCount <= 8) {
+        ReportIf(info.dsBmih.biBitCount != 8);
+        RGBQUAD palette[256];
+        HDC hDC = CreateCompatibleDC(nullptr);
+        DeleteObject(SelectObject(hDC, hbmp));
+        uint num = GetDIBColorTable(hDC, 0, dimof(palette), palette);
+        for (uint i = 0; i < num; i++) {
+            palette[i].rgbRed = lut[2][palette[i].rgbRed];
+            palette[i].rgbGreen = lut[1][palette[i].rgbGreen];
+            palette[i].rgbBlue = lut[0][palette[i].rgbBlue];
+        }
+        if (num > 0) {
+            SetDIBColorTable(hDC, 0, num, palette);
+        }
+        DeleteDC(hDC);
+        return num > 0;
+    }
+
+    return false;
+}
+
 // create data for a .bmp file from this bitmap (if saved to disk, the HBITMAP
 // can be deserialized with LoadImage(nullptr, ..., LD_LOADFROMFILE) and its
 // dimensions determined again with GetBitmapSize(...))
@@ -3113,7 +3273,7 @@ u32 CpuID() {
         res = res | kCpuSSE3;
     }
     if (f_1_ECX_[9]) {
-        res = res | kCpuSSE3;
+        res = res | kCpuSSSE3;
     }
     if (f_1_ECX_[19]) {
         res = res | kCpuSSE41;
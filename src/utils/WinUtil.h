@@ -209,6 +209,9 @@ struct DoubleBuffer {
     HDC hdcCanvas = nullptr;
     HDC hdcBuffer = nullptr;
     HBITMAP doubleBuffer = nullptr;
+    // pixels of doubleBuffer (a top-down 32bpp dib section), so that
+    // presenters can read the composed frame without GetDIBits
+    u8* bits = nullptr;
     Rect rect{};
 
     DoubleBuffer(HWND hwnd, Rect rect);
@@ -277,6 +280,7 @@ BitmapPixels* GetBitmapPixels(HBITMAP hbmp);
 void FinalizeBitmapPixels(BitmapPixels* bitmapPixels);
 COLORREF GetPixel(BitmapPixels* bitmap, int x, int y);
 void UpdateBitmapColors(HBITMAP hbmp, COLORREF textColor, COLORREF bgColor);
+bool RemapBitmapColors(HBITMAP hbmp, COLORREF textColor0, COLORREF bgColor0, COLORREF textColor1, COLORREF bgColor1);
 ByteSlice SerializeBitmap(HBITMAP hbmp);
 HBITMAP CreateMemoryBitmap(Size size, HANDLE* hDataMapping = nullptr);
 bool BlitHBITMAP(HBITMAP hbmp, HDC hdc, Rect target);
@@ -359,12 +363,13 @@ int MsgBox(HWND, const char*, const char*, UINT);
 
 constexpr u32 kCpuMMX = 1 << 1;
 constexpr u32 kCpuSSE = 1 << 2;
-constexpr u32 kCpuSSE2 = 1 << 2;
-constexpr u32 kCpuSSE3 = 1 << 3;
-constexpr u32 kCpuSSE41 = 1 << 4;
-constexpr u32 kCpuSSE42 = 1 << 5;
-constexpr u32 kCpuAVX = 1 << 6;
-constexpr u32 kCpuAVX2 = 1 << 7;
+constexpr u32 kCpuSSE2 = 1 << 3;
+constexpr u32 kCpuSSE3 = 1 << 4;
+constexpr u32 kCpuSSSE3 = 1 << 5;
+constexpr u32 kCpuSSE41 = 1 << 6;
+constexpr u32 kCpuSSE42 = 1 << 7;
+constexpr u32 kCpuAVX = 1 << 8;
+constexpr u32 kCpuAVX2 = 1 << 9;
 
 u32 CpuID();
 
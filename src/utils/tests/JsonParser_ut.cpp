@@ -42,6 +42,18 @@ class JsonVerifier : public json::ValueVisitor {
     }
 };
 
+static bool StreamParse(const char* data, json::ValueVisitor* visitor, size_t chunkSize) {
+    json::StreamParser parser(visitor);
+    size_t len = str::Len(data);
+    for (size_t i = 0; i < len; i += chunkSize) {
+        size_t n = len - i < chunkSize ? len - i : chunkSize;
+        if (!parser.Feed(data + i, n)) {
+            return false;
+        }
+    }
+    return parser.Finish();
+}
+
 void JsonTest() {
     static const struct {
         const char* json;
@@ -140,4 +152,23 @@ void JsonTest() {
 }";
     JsonVerifier sampleVerifier(testData, dimof(testData));
     utassert(json::Parse(jsonSample, &sampleVerifier));
+
+    // the streaming parser must accept/reject the same inputs and
+    // produce the same events as Parse(), no matter how the input is
+    // split into chunks
+    for (size_t chunkSize = 1; chunkSize <= 7; chunkSize += 3) {
+        for (size_t i = 0; i < dimof(validJsonData); i++) {
+            JsonVerifier verifier(&validJsonData[i].value, validJsonData[i].value.value ? 1 : 0);
+            utassert(StreamParse(validJsonData[i].json, &verifier, chunkSize));
+        }
+        for (size_t i = 0; i < dimof(invalidJsonData); i++) {
+            JsonVerifier verifier(&invalidJsonData[i].value, 1);
+            utassert(!StreamParse(invalidJsonData[i].json, &verifier, chunkSize));
+        }
+        for (size_t i = 0; i < dimof(invalidJson); i++) {
+            utassert(!StreamParse(invalidJson[i], &verifyError, chunkSize));
+        }
+        JsonVerifier chunkedVerifier(testData, dimof(testData));
+        utassert(StreamParse(jsonSample, &chunkedVerifier, chunkSize));
+    }
 }
@@ -0,0 +1,111 @@
+/* Copyright 2024 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/Timer.h"
+#include "utils/WinUtil.h"
+
+#include "wingui/FrameBudget.h"
+
+#include "utils/Log.h"
+
+/* Instrumentation for the UI thread's frame budget.
+
+The message loops bracket every dispatched message with
+FrameBudgetMsgBegin() / FrameBudgetMsgEnd(). A handler that overruns a
+60 Hz frame gets logged right away with enough context (window class,
+message, duration) to find it, and per-message totals are accumulated so
+that death-by-a-thousand-cuts handlers still show up in
+FrameBudgetLogStats() at shutdown even if no single run blows the
+budget.
+
+Subsystems that can either do optional work right away or defer it
+(menu rebuilds, settings saves etc.) call FrameBudgetAllows() to only
+stay on-thread while the current frame has room. */
+
+// one 60 Hz frame; intentionally not tied to the actual refresh rate,
+// it's a responsiveness target, not a vsync deadline
+constexpr double kFrameBudgetMs = 16.0;
+
+// messages faster than this are not accumulated, to keep the stats
+// table small and the per-message overhead negligible
+constexpr double kMinTrackedMs = 1.0;
+
+struct MsgTimeStats {
+    UINT msg = 0;
+    int count = 0;
+    double totalMs = 0;
+    double maxMs = 0;
+};
+
+static Vec<MsgTimeStats> gMsgStats;
+static const MSG* gCurrMsg = nullptr;
+static LARGE_INTEGER gMsgStart{};
+
+void FrameBudgetMsgBegin(const MSG* msg) {
+    gCurrMsg = msg;
+    gMsgStart = TimeGet();
+}
+
+double FrameBudgetRemainingMs() {
+    if (!gCurrMsg) {
+        return kFrameBudgetMs;
+    }
+    return kFrameBudgetMs - TimeSinceInMs(gMsgStart);
+}
+
+bool FrameBudgetAllows(double estimatedMs) {
+    return estimatedMs <= FrameBudgetRemainingMs();
+}
+
+void FrameBudgetMsgEnd() {
+    if (!gCurrMsg) {
+        return;
+    }
+    double elapsedMs = TimeSinceInMs(gMsgStart);
+    const MSG* msg = gCurrMsg;
+    gCurrMsg = nullptr;
+    if (elapsedMs < kMinTrackedMs) {
+        return;
+    }
+    MsgTimeStats* stats = nullptr;
+    for (MsgTimeStats& s : gMsgStats) {
+        if (s.msg == msg->message) {
+            stats = &s;
+            break;
+        }
+    }
+    if (!stats) {
+        gMsgStats.Append(MsgTimeStats{msg->message, 0, 0, 0});
+        stats = &gMsgStats.Last();
+    }
+    stats->count++;
+    stats->totalMs += elapsedMs;
+    stats->maxMs = std::max(stats->maxMs, elapsedMs);
+    if (elapsedMs <= kFrameBudgetMs) {
+        return;
+    }
+    // the handler already returned so a callstack is no longer
+    // available; the target window and message are usually enough
+    // to attribute the time
+    TempStr clsName = msg->hwnd ? HwndGetClassName(msg->hwnd) : str::DupTemp("(thread)");
+    logf("FrameBudget: msg 0x%x to '%s' took %.1f ms (budget is %.0f ms)\n", msg->message, clsName, elapsedMs,
+         kFrameBudgetMs);
+}
+
+void FrameBudgetLogStats() {
+    bool didLogHeader = false;
+    for (MsgTimeStats& s : gMsgStats) {
+        // only message handlers that cost at least a frame in total
+        // are worth reporting
+        if (s.totalMs < kFrameBudgetMs) {
+            continue;
+        }
+        if (!didLogHeader) {
+            logf("FrameBudget: most expensive message handlers:\n");
+            didLogHeader = true;
+        }
+        logf("FrameBudget: msg 0x%x dispatched %d times, %.1f ms total, %.1f ms worst\n", s.msg, s.count, s.totalMs,
+             s.maxMs);
+    }
+}
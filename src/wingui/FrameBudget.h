@@ -0,0 +1,19 @@
+/* Copyright 2024 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// bracket every message dispatched on the UI thread with these two;
+// overruns get logged and per-message timings accumulated
+void FrameBudgetMsgBegin(const MSG* msg);
+void FrameBudgetMsgEnd();
+
+// milliseconds the message being dispatched right now has left before
+// it blows the frame budget; returns the full budget when called
+// outside of message dispatch. Can go negative
+double FrameBudgetRemainingMs();
+
+// whether optional work estimated to take estimatedMs still fits into
+// the current frame; when it doesn't, defer it to uitask or a thread
+bool FrameBudgetAllows(double estimatedMs);
+
+// logs the accumulated per-message timings, called once at shutdown
+void FrameBudgetLogStats();
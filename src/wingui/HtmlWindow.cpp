@@ -4,6 +4,7 @@
 #include "utils/BaseUtil.h"
 #include "utils/Dpi.h"
 #include "utils/ScopedWin.h"
+#include "utils/ThreadUtil.h"
 #include "utils/WinUtil.h"
 #include "utils/GuessFileType.h"
 
@@ -300,7 +301,11 @@ class HW_IInternetProtocol : public IInternetProtocol {
     HW_IInternetProtocol() = default;
 
   protected:
-    virtual ~HW_IInternetProtocol() = default;
+    virtual ~HW_IInternetProtocol() {
+        if (protSink) {
+            protSink->Release();
+        }
+    }
 
   public:
     // IUnknown
@@ -313,10 +318,9 @@ class HW_IInternetProtocol : public IInternetProtocol {
     // IInternetProtocol
     STDMETHODIMP Start(LPCWSTR szUrl, IInternetProtocolSink* pIProtSink, IInternetBindInfo* pIBindInfo, DWORD grfSTI,
                        HANDLE_PTR dwReserved) override;
-    STDMETHODIMP Continue(__unused PROTOCOLDATA* pStateInfo) override {
-        return S_OK;
-    }
+    STDMETHODIMP Continue(PROTOCOLDATA* pStateInfo) override;
     STDMETHODIMP Abort(__unused HRESULT hrReason, __unused DWORD dwOptions) override {
+        InterlockedExchange(&aborted, 1);
         return S_OK;
     }
     STDMETHODIMP Terminate(__unused DWORD dwOptions) override {
@@ -344,6 +348,16 @@ class HW_IInternetProtocol : public IInternetProtocol {
     // for a given url
     ByteSlice data{};
     size_t dataCurrPos = 0;
+
+    // for serving asynchronously, see Start() and FetchDataThread()
+    IInternetProtocolSink* protSink = nullptr;
+    HtmlWindowCallback* winCb = nullptr;
+    AutoFreeStr asyncUrl;
+    PROTOCOLDATA protData{};
+    LONG aborted = 0;
+
+    void ReportAvailableData(IInternetProtocolSink* pIProtSink, const char* url);
+    static void FetchDataThread(HW_IInternetProtocol* p);
 };
 
 ULONG STDMETHODCALLTYPE HW_IInternetProtocol::Release() {
@@ -425,9 +439,16 @@ static char* MimeFromUrl(const char* url, const char* imgExt = nullptr) {
     return str::Dup(kDefaultMimeType);
 }
 
+// windows (and with them the protocol bindings) are only created and
+// destroyed on their UI thread, so Start() can't race with window
+// destruction; the fetches in flight here can, which is why
+// ~HtmlWindow() waits for the count to drop to zero before its owner
+// deletes the HtmlWindowCallback they use
+static LONG gInFlightRequests = 0;
+
 // TODO: return an error page html in case of errors?
 STDMETHODIMP HW_IInternetProtocol::Start(LPCWSTR szUrl, IInternetProtocolSink* pIProtSink,
-                                         __unused IInternetBindInfo* pIBindInfo, __unused DWORD grfSTI,
+                                         __unused IInternetBindInfo* pIBindInfo, DWORD grfSTI,
                                          __unused HANDLE_PTR dwReserved) {
     // TODO: others seem to return S_OK even if there is no content
     //       for a URL (unless the PI_PARSE_URL bit is set on grfSTI),
@@ -457,13 +478,56 @@ STDMETHODIMP HW_IInternetProtocol::Start(LPCWSTR szUrl, IInternetProtocolSink* p
         return INET_E_OBJECT_NOT_FOUND;
     }
     char* urlRestA = ToUtf8Temp(urlRest);
+    if (grfSTI & PI_FORCE_ASYNC) {
+        // getting the data can mean LZX-decompressing a large image,
+        // long enough to hitch the UI, so fetch it on the thread pool
+        // and report back through the sink's Switch(), which marshals
+        // to Continue() on this thread
+        winCb = win->htmlWinCb;
+        asyncUrl.SetCopy(urlRestA);
+        protSink = pIProtSink;
+        protSink->AddRef();
+        protData.grfFlags = PD_FORCE_SWITCH;
+        InterlockedIncrement(&gInFlightRequests);
+        AddRef(); // owned by the fetch until it completes
+        RunAsync(MkFunc0(FetchDataThread, this), "HtmlWindowFetch");
+        return E_PENDING;
+    }
     data = win->htmlWinCb->GetDataForUrl(urlRestA);
     if (data.empty()) {
         return INET_E_DATA_NOT_AVAILABLE;
     }
+    ReportAvailableData(pIProtSink, urlRestA);
+    return S_OK;
+}
+
+void HW_IInternetProtocol::FetchDataThread(HW_IInternetProtocol* p) {
+    p->data = p->winCb->GetDataForUrl(p->asyncUrl);
+    // past this point the window and its callback are allowed to die
+    InterlockedDecrement(&gInFlightRequests);
+    p->protSink->Switch(&p->protData);
+    p->Release();
+}
+
+STDMETHODIMP HW_IInternetProtocol::Continue(PROTOCOLDATA* pStateInfo) {
+    if (pStateInfo != &protData || !protSink) {
+        return S_OK;
+    }
+    if (aborted) {
+        protSink->ReportResult(E_ABORT, 0, nullptr);
+        return S_OK;
+    }
+    if (data.empty()) {
+        protSink->ReportResult(INET_E_DATA_NOT_AVAILABLE, 0, nullptr);
+        return S_OK;
+    }
+    ReportAvailableData(protSink, asyncUrl);
+    return S_OK;
+}
 
+void HW_IInternetProtocol::ReportAvailableData(IInternetProtocolSink* pIProtSink, const char* url) {
     const char* imgExt = GfxFileExtFromData({(u8*)data.data(), data.size()});
-    char* mime = MimeFromUrl(urlRestA, imgExt);
+    char* mime = MimeFromUrl(url, imgExt);
     WCHAR* mimeW = ToWStrTemp(mime);
     str::Free(mime);
     pIProtSink->ReportProgress(BINDSTATUS_VERIFIEDMIMETYPEAVAILABLE, mimeW);
@@ -474,7 +538,6 @@ STDMETHODIMP HW_IInternetProtocol::Start(LPCWSTR szUrl, IInternetProtocolSink* p
     pIProtSink->ReportData(BSCF_FIRSTDATANOTIFICATION | BSCF_LASTDATANOTIFICATION | BSCF_DATAFULLYAVAILABLE,
                            (ULONG)data.size(), (ULONG)data.size());
     pIProtSink->ReportResult(S_OK, 200, nullptr);
-    return S_OK;
 }
 
 STDMETHODIMP HW_IInternetProtocol::Read(void* pv, ULONG cb, ULONG* pcbRead) {
@@ -1594,6 +1657,11 @@ HtmlWindow::~HtmlWindow() {
     }
 
     FreeWindowId(windowId);
+    // wait out in-flight async fetches: they use the htmlWinCb that our
+    // owner deletes right after us
+    while (InterlockedCompareExchange(&gInFlightRequests, 0, 0) > 0) {
+        Sleep(1);
+    }
     UnregisterInternetProtocolFactory();
     FreeHtmlSetInProgressData();
 }
@@ -10,6 +10,7 @@
 
 #include "wingui/UIModels.h"
 
+#include "wingui/FrameBudget.h"
 #include "wingui/Layout.h"
 #include "wingui/WinGui.h"
 
@@ -2532,10 +2533,26 @@ TVITEMW* GetTVITEM(TreeView* tree, TreeItem ti) {
     return GetTVITEM(tree, hi);
 }
 
+static void PopulateTreeItemLazy(TreeView* treeView, TreeItem item, HTREEITEM parent);
+static void PopulateMissingTreeItems(TreeView* treeView, TreeItem item);
+
 // expand if collapse, collapse if expanded
 void TreeViewToggle(TreeView* tree, HTREEITEM hItem, bool recursive) {
     HWND hTree = tree->hwnd;
     HTREEITEM child = TreeView_GetChild(hTree, hItem);
+    if (tree->lazyPopulate && tree->treeModel) {
+        // TreeView_Expand() doesn't send TVN_ITEMEXPANDING so insert
+        // the branches we're about to show ourselves
+        TreeItem ti = tree->GetTreeItemByHandle(hItem);
+        if (ti != TreeModel::kNullItem) {
+            if (recursive) {
+                PopulateMissingTreeItems(tree, ti);
+            } else if (!child && tree->treeModel->ChildCount(ti) > 0) {
+                PopulateTreeItemLazy(tree, ti, hItem);
+            }
+            child = TreeView_GetChild(hTree, hItem);
+        }
+    }
     if (!child) {
         // only applies to nodes with children
         return;
@@ -2568,6 +2585,12 @@ static bool HandleKey(TreeView* tree, WPARAM wp) {
     HWND hwnd = tree->hwnd;
     // consistently expand/collapse whole (sub)trees
     if (VK_MULTIPLY == wp) {
+        if (tree->lazyPopulate && tree->treeModel) {
+            TreeItem ti = IsShiftPressed() ? tree->treeModel->Root() : tree->GetSelection();
+            if (ti != TreeModel::kNullItem) {
+                PopulateMissingTreeItems(tree, ti);
+            }
+        }
         if (IsShiftPressed()) {
             TreeViewExpandRecursively(hwnd, TreeView_GetRoot(hwnd), TVE_EXPAND, false);
         } else {
@@ -2621,6 +2644,10 @@ LRESULT TreeView::WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
 }
 
 bool TreeView::IsExpanded(TreeItem ti) {
+    if (lazyPopulate && !GetHandleByTreeItem(ti)) {
+        // a branch that hasn't been materialized yet was never expanded
+        return false;
+    }
     auto state = GetItemState(ti);
     return state.isExpanded;
 }
@@ -2663,6 +2690,9 @@ void TreeView::SetColors(COLORREF textCol, COLORREF bgCol) {
 
 void TreeView::ExpandAll() {
     SuspendRedraw();
+    if (lazyPopulate && treeModel) {
+        PopulateMissingTreeItems(this, treeModel->Root());
+    }
     auto root = TreeView_GetRoot(this->hwnd);
     TreeViewExpandRecursively(this->hwnd, root, TVE_EXPAND, false);
     ResumeRedraw();
@@ -2772,11 +2802,9 @@ void PopulateTreeItem(TreeView* treeView, TreeItem item, HTREEITEM parent) {
     int n = tm->ChildCount(item);
     TreeItem tmp[256];
     TreeItem* a = &tmp[0];
-    void* toFree = nullptr;
     if (n > dimof(tmp)) {
-        size_t nBytes = (size_t)n * sizeof(TreeItem);
-        toFree = malloc(nBytes);
-        a = (TreeItem*)toFree;
+        // the temp allocator is reset by the message loop after the pump
+        a = AllocArrayTemp<TreeItem>(n);
     }
     // ChildAt() is optimized for sequential access and we need to
     // insert backwards, so gather the items in v first
@@ -2795,8 +2823,6 @@ void PopulateTreeItem(TreeView* treeView, TreeItem item, HTREEITEM parent) {
             PopulateTreeItem(treeView, ti, h);
         }
     }
-
-    free(toFree);
 }
 
 static void PopulateTree(TreeView* treeView, TreeModel* tm) {
@@ -2804,7 +2830,82 @@ static void PopulateTree(TreeView* treeView, TreeModel* tm) {
     PopulateTreeItem(treeView, root, nullptr);
 }
 
-void TreeView::SetTreeModel(TreeModel* tm) {
+// like PopulateTreeItem() but only inserts the children of item, not
+// their descendants. Collapsed branches get cChildren set so that the
+// expand button shows up; they are materialized when first expanded
+// (TVN_ITEMEXPANDING in OnNotifyReflect())
+static void PopulateTreeItemLazy(TreeView* treeView, TreeItem item, HTREEITEM parent) {
+    auto tm = treeView->treeModel;
+    int n = tm->ChildCount(item);
+    TreeItem tmp[256];
+    TreeItem* a = &tmp[0];
+    if (n > dimof(tmp)) {
+        a = AllocArrayTemp<TreeItem>(n);
+    }
+    // ChildAt() is optimized for sequential access and we need to
+    // insert backwards, so gather the items in a first
+    for (int i = 0; i < n; i++) {
+        auto ti = tm->ChildAt(item, i);
+        ReportIf(ti == 0);
+        a[n - 1 - i] = ti;
+    }
+
+    for (int i = 0; i < n; i++) {
+        auto ti = a[i];
+        bool hasChildren = tm->ChildCount(ti) > 0;
+        bool deferChildren = hasChildren && !tm->IsExpanded(ti);
+        TVINSERTSTRUCTW toInsert{};
+        toInsert.hParent = parent;
+        toInsert.hInsertAfter = TVI_FIRST;
+        TVITEMEXW* tvitem = &toInsert.itemex;
+        FillTVITEM(tvitem, tm, ti);
+        if (deferChildren) {
+            // show the expand button even though the children are not there yet
+            tvitem->mask |= TVIF_CHILDREN;
+            tvitem->cChildren = 1;
+        }
+        HTREEITEM h = TreeView_InsertItem(treeView->hwnd, &toInsert);
+        tm->SetHandle(ti, h);
+        if (hasChildren && !deferChildren) {
+            // expanded branches must exist for TVIS_EXPANDED to show
+            PopulateTreeItemLazy(treeView, ti, h);
+        }
+    }
+}
+
+// inserts tree view items for the branches below item that have not
+// been materialized yet. Children are inserted a level at a time so
+// either all of them have a handle or none of them does
+static void PopulateMissingTreeItems(TreeView* treeView, TreeItem item) {
+    auto tm = treeView->treeModel;
+    int n = tm->ChildCount(item);
+    if (n <= 0) {
+        return;
+    }
+    TreeItem first = tm->ChildAt(item, 0);
+    if (!tm->GetHandle(first)) {
+        PopulateTreeItem(treeView, item, tm->GetHandle(item));
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        PopulateMissingTreeItems(treeView, tm->ChildAt(item, i));
+    }
+}
+
+static void ClearTreeModelHandles(TreeModel* tm, TreeItem item) {
+    tm->SetHandle(item, nullptr);
+    int n = tm->ChildCount(item);
+    for (int i = 0; i < n; i++) {
+        ClearTreeModelHandles(tm, tm->ChildAt(item, i));
+    }
+}
+
+// if lazy, only top-level items and branches the model reports as
+// expanded are inserted up-front; collapsed branches are materialized
+// when first expanded. Inserting tree view items is by far the most
+// expensive part of showing a tree so for models with many items
+// (e.g. a large table of contents) this makes showing it instant
+void TreeView::SetTreeModel(TreeModel* tm, bool lazy) {
     ReportIf(!tm);
 
     SuspendRedraw();
@@ -2812,7 +2913,14 @@ void TreeView::SetTreeModel(TreeModel* tm) {
     TreeView_DeleteAllItems(hwnd);
 
     treeModel = tm;
-    PopulateTree(this, tm);
+    lazyPopulate = lazy;
+    if (lazy) {
+        // the model might have stale handles from a previous population
+        ClearTreeModelHandles(tm, tm->Root());
+        PopulateTreeItemLazy(this, tm->Root(), nullptr);
+    } else {
+        PopulateTree(this, tm);
+    }
     ResumeRedraw();
 
     uint flags = RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN;
@@ -2892,6 +3000,20 @@ LRESULT TreeView::OnNotifyReflect(WPARAM wp, LPARAM lp) {
     LRESULT res;
 
     auto code = nmtv->hdr.code;
+    // https://docs.microsoft.com/en-us/windows/win32/controls/tvn-itemexpanding
+    if (code == TVN_ITEMEXPANDING) {
+        if (lazyPopulate && treeModel && nmtv->action == TVE_EXPAND) {
+            TreeItem ti = GetTreeItemByHandle(nmtv->itemNew.hItem);
+            if (ti != TreeModel::kNullItem && treeModel->ChildCount(ti) > 0) {
+                TreeItem firstChild = treeModel->ChildAt(ti, 0);
+                if (!treeModel->GetHandle(firstChild)) {
+                    PopulateTreeItemLazy(w, ti, nmtv->itemNew.hItem);
+                }
+            }
+        }
+        return 0; // allow the expansion
+    }
+
     // https://docs.microsoft.com/en-us/windows/win32/controls/tvn-getinfotip
     if (code == TVN_GETINFOTIP) {
         if (!onGetTooltip.IsValid()) {
@@ -3069,7 +3191,9 @@ void TabsCtrl::LayoutTabs() {
     HFONT hfont = GetFont();
     int x = 0;
     int xEnd;
-    TooltipInfo* tools = AllocArray<TooltipInfo>(nTabs);
+    // runs on every resize so the buffer comes from the per-message-pump
+    // temp arena instead of doing a heap round trip per pass
+    TooltipInfo* tools = AllocArrayTemp<TooltipInfo>(nTabs);
     for (int i = 0; i < nTabs; i++) {
         TabInfo* ti = GetTab(i);
         xEnd = x + dx;
@@ -3093,7 +3217,6 @@ void TabsCtrl::LayoutTabs() {
         HWND ttHwnd = GetToolTipsHwnd();
         TooltipAddTools(ttHwnd, hwnd, tools, nTabs);
     }
-    free(tools);
 
     HwndScheduleRepaint(hwnd);
 }
@@ -3851,8 +3974,10 @@ int RunMessageLoop(HACCEL accelTable, HWND hwndDialog) {
         if (hwndDialog && IsDialogMessage(hwndDialog, &msg)) {
             continue;
         }
+        FrameBudgetMsgBegin(&msg);
         TranslateMessage(&msg);
         DispatchMessage(&msg);
+        FrameBudgetMsgEnd();
     }
     return (int)msg.wParam;
 }
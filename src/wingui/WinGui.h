@@ -599,7 +599,7 @@ struct TreeView : Wnd {
     TreeItem GetItemAt(int x, int y);
     TreeItem GetTreeItemByHandle(HTREEITEM item);
     bool UpdateItem(TreeItem ti);
-    void SetTreeModel(TreeModel* tm);
+    void SetTreeModel(TreeModel* tm, bool lazy = false);
     void SetState(TreeItem item, bool enable);
     bool GetState(TreeItem item);
     TreeItemState GetItemState(TreeItem ti);
@@ -608,6 +608,9 @@ struct TreeView : Wnd {
     Size idealSize{};
 
     TreeModel* treeModel = nullptr; // not owned by us
+    // when set, collapsed branches are only materialized as tree view
+    // items when first expanded (see SetTreeModel())
+    bool lazyPopulate = false;
 
     // for WM_NOTIFY with TVN_GETINFOTIP
     GetTooltipHandler onGetTooltip;